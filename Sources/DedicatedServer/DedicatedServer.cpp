@@ -14,7 +14,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA. */
 
 #include "StdAfx.h"
+#include <psapi.h>
 #include <GameMP/Game.h>
+#include <Engine/Base/TickScheduler.h>
+#include <Engine/Network/SessionContext.h>
 #define DECL_DLL
 
 #if 0  /* rcg10042001 Doesn't seem to exist. */
@@ -28,6 +31,8 @@ static BOOL _bForceNextMap = FALSE;
 
 extern CTString _strSamVersion = "no version information";
 extern INDEX ded_iMaxFPS = 100;
+extern INDEX ded_bPreciseTicks = TRUE;
+extern INDEX ded_ctSessions = 1;
 extern CTString ded_strConfig = "";
 extern CTString ded_strLevel = "";
 extern INDEX ded_bRestartWhenEmpty = TRUE;
@@ -39,6 +44,20 @@ extern CTString sam_strGameName = "serioussam";
 
 CTimerValue _tvLastLevelEnd(-1i64);
 
+// demo to time instead of running a server
+static CTString _strTimeDemo = "";
+static INDEX _ctTimeDemoPasses = 1;
+
+// sessions hosted by this process (first one is the engine's own)
+#define MAX_SESSIONS 32
+static CSessionContext *_apscSessions[MAX_SESSIONS];
+static INDEX _ctSessions = 0;
+static CTString _astrSessionLevels[MAX_SESSIONS];
+static CTimerValue _tvNextTick;
+static SLONG _slMemoryOneSession = 0;
+static SLONG _slMemoryAllSessions = 0;
+static void SessionStats(void);
+
 void InitializeGame(void)
 {
   try {
@@ -82,6 +101,28 @@ static void NextMap(void)
   _bForceNextMap = TRUE;
 }
 
+// print histogram of tick lateness
+static void TickStats(void *pArgs)
+{
+  INDEX bReset = NEXTARGUMENT(INDEX);
+  CTString strReport;
+  TickScheduler_Report(strReport);
+  CPrintF("%s", (const char*)strReport);
+  if (bReset) {
+    TickScheduler_ResetStats();
+  }
+}
+
+// measure tick jitter under synthetic load: TickJitterTest(200, 50)
+static void TickJitterTest(void *pArgs)
+{
+  INDEX ctTicks = NEXTARGUMENT(INDEX);
+  INDEX iLoadPercent = NEXTARGUMENT(INDEX);
+  CTString strReport;
+  TickScheduler_JitterTest(ctTicks, iLoadPercent, strReport);
+  CPrintF("%s", (const char*)strReport);
+}
+
 
 void End(void);
 
@@ -97,7 +138,13 @@ void LimitFrameRate(void)
   // limit maximum frame rate
   ded_iMaxFPS = ClampDn( ded_iMaxFPS,   1L);
   TIME tmWantedDelta  = 1.0f / ded_iMaxFPS;
-  if( tmCurrentDelta<tmWantedDelta) Sleep( (tmWantedDelta-tmCurrentDelta)*1000.0f);
+  TIME tmWait = tmWantedDelta-tmCurrentDelta;
+  // with several sessions, their ticks are run from main loop
+  if( _ctSessions>0) tmWait = Min( tmWait, (TIME)(_tvNextTick-tvNow).GetSeconds());
+  if( tmWait>0) {
+    // with precise ticks, wake up right after a tick to process what it has produced
+    TickScheduler_WaitForTick( tmWait*1000.0f);
+  }
   
   // remember new time
   tvLast = _pTimer->GetHighPrecisionTimer();
@@ -183,24 +230,36 @@ BOOL Init(int argc, char* argv[])
 {
   _bDedicatedServer = TRUE;
 
-  if (argc!=1+1 && argc!=2+1) {
+  const BOOL bTimeDemo = (argc==2+1 || argc==3+1) && CTString(argv[1])=="-timedemo";
+  if (!bTimeDemo && argc!=1+1 && argc!=2+1) {
     // NOTE: this cannot be translated - translations are not loaded yet
     printf("Usage: DedicatedServer <configname> [<modname>]\n"
-      "This starts a server reading configs from directory 'Scripts\\Dedicated\\<configname>\\'\n");
+      "This starts a server reading configs from directory 'Scripts\\Dedicated\\<configname>\\'\n"
+      "   or: DedicatedServer -timedemo <demofile> [<passes>]\n"
+      "This replays the demo without rendering and writes tick timings to 'Temp\\TimeDemo.json'\n");
     getch();
     exit(0);
   }
 
-  SetConsoleTitleA(argv[1]);
+  if (bTimeDemo) {
+    _strTimeDemo = argv[2];
+    if (argc==3+1) {
+      _ctTimeDemoPasses = atoi(argv[3]);
+    }
+    SetConsoleTitleA("timedemo");
+    _strLogFile = CTString("Dedicated_TimeDemo");
 
-  ded_strConfig = CTString("Scripts\\Dedicated\\")+argv[1]+"\\";
+  } else {
+    SetConsoleTitleA(argv[1]);
 
-  if (argc==2+1) {
-    _fnmMod = CTString("Mods\\")+argv[2]+"\\";
-  }
+    ded_strConfig = CTString("Scripts\\Dedicated\\")+argv[1]+"\\";
 
+    if (argc==2+1) {
+      _fnmMod = CTString("Mods\\")+argv[2]+"\\";
+    }
 
-  _strLogFile = CTString("Dedicated_")+argv[1];
+    _strLogFile = CTString("Dedicated_")+argv[1];
+  }
 
   // initialize engine
   SE_InitEngine(sam_strGameName);
@@ -232,6 +291,11 @@ BOOL Init(int argc, char* argv[])
 
   // declare shell symbols
   _pShell->DeclareSymbol("persistent user INDEX ded_iMaxFPS;", &ded_iMaxFPS);
+  _pShell->DeclareSymbol("persistent user INDEX ded_bPreciseTicks;", &ded_bPreciseTicks);
+  _pShell->DeclareSymbol("persistent user INDEX ded_ctSessions;", &ded_ctSessions);
+  _pShell->DeclareSymbol("user void SessionStats(void);", &SessionStats);
+  _pShell->DeclareSymbol("user void TickStats(INDEX);", &TickStats);
+  _pShell->DeclareSymbol("user void TickJitterTest(INDEX, INDEX);", &TickJitterTest);
   _pShell->DeclareSymbol("user void Quit(void);", &QuitGame);
   _pShell->DeclareSymbol("user CTString ded_strLevel;", &ded_strLevel);
   _pShell->DeclareSymbol("user FLOAT ded_tmTimeout;", &ded_tmTimeout);
@@ -341,9 +405,169 @@ void RoundEnd(void)
   iRound++;
 }
 
+// private memory of this process in bytes (0 if not available)
+static SLONG GetProcessMemory(void)
+{
+  typedef BOOL WINAPI GetProcessMemoryInfo_t(HANDLE, PROCESS_MEMORY_COUNTERS*, DWORD);
+  static GetProcessMemoryInfo_t *pGetProcessMemoryInfo = NULL;
+  if (pGetProcessMemoryInfo==NULL) {
+    HMODULE hPSAPI = LoadLibraryA("psapi.dll");
+    if (hPSAPI==NULL) {
+      return 0;
+    }
+    pGetProcessMemoryInfo = (GetProcessMemoryInfo_t*)GetProcAddress(hPSAPI, "GetProcessMemoryInfo");
+    if (pGetProcessMemoryInfo==NULL) {
+      return 0;
+    }
+  }
+  PROCESS_MEMORY_COUNTERS pmc;
+  if (!pGetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+    return 0;
+  }
+  return pmc.PagefileUsage;
+}
+
+// start level in an additional session
+static BOOL StartSession(INDEX iSession)
+{
+  _apscSessions[iSession]->Activate();
+  CUniversalSessionProperties sp;
+  _pGame->SetMultiPlayerSession(sp);
+  CTString strSessionName;
+  strSessionName.PrintF("%s #%d", (const char*)_pGame->gam_strSessionName, iSession+1);
+  try {
+    CNetworkProvider npServer;
+    npServer.np_Description = "TCP/IP Server";
+    _pNetwork->StartProvider_t(npServer);
+    _pNetwork->StartPeerToPeer_t(strSessionName, _astrSessionLevels[iSession],
+      sp.sp_ulSpawnFlags, sp.sp_ctMaxPlayers, FALSE, &sp);
+  } catch (char *strError) {
+    _pNetwork->StopProvider();
+    CPrintF(TRANS("Cannot start session %d: %s\n"), iSession+1, strError);
+    _apscSessions[0]->Activate();
+    return FALSE;
+  }
+  CPrintF(TRANS("Session %d is running on port %d.\n"), iSession+1, _apscSessions[iSession]->sc_iPort);
+  _apscSessions[0]->Activate();
+  return TRUE;
+}
+
+// host additional sessions in this process, next to the one that is already running
+static void StartSessions(void)
+{
+  _ctSessions = 1;
+  _apscSessions[0] = new CSessionContext;
+  _slMemoryOneSession = GetProcessMemory();
+
+  const INDEX ctWanted = Clamp(ded_ctSessions, 1L, (INDEX)MAX_SESSIONS);
+  for (INDEX iSession=1; iSession<ctWanted; iSession++) {
+    CSessionContext *psc = new CSessionContext;
+    psc->Create(_apscSessions[0]->sc_iPort+iSession);
+    _apscSessions[iSession] = psc;
+    _astrSessionLevels[iSession] = ded_strLevel;
+    _ctSessions++;
+    if (!StartSession(iSession)) {
+      _ctSessions--;
+      delete psc;
+      break;
+    }
+  }
+  _slMemoryAllSessions = GetProcessMemory();
+  _tvNextTick = _pTimer->GetHighPrecisionTimer();
+}
+
+static void StopSessions(void)
+{
+  for (INDEX iSession=_ctSessions-1; iSession>=1; iSession--) {
+    _apscSessions[iSession]->Activate();
+    _pNetwork->StopGame();
+    _pNetwork->StopProvider();
+    _apscSessions[0]->Activate();
+    delete _apscSessions[iSession];
+  }
+  if (_ctSessions>0) {
+    delete _apscSessions[0];
+  }
+  _ctSessions = 0;
+}
+
+// run due ticks of all sessions, one session after another
+static void RunSessionTicks(void)
+{
+  const CTimerValue tvNow = _pTimer->GetHighPrecisionTimer();
+  const CTimerValue tvPeriod = (DOUBLE)_pTimer->TickQuantum;
+  INDEX ctTicks = 0;
+  while (_tvNextTick<=tvNow && ctTicks<2) {
+    _pTimer->SetRealTimeTick(_pTimer->GetRealTimeTick()+_pTimer->TickQuantum);
+    for (INDEX iSession=0; iSession<_ctSessions; iSession++) {
+      _apscSessions[iSession]->Activate();
+      _apscSessions[iSession]->RunTick();
+    }
+    _tvNextTick += tvPeriod;
+    ctTicks++;
+  }
+  // if too far behind, skip ticks instead of running a burst
+  if (_tvNextTick<=tvNow) {
+    _tvNextTick = tvNow+tvPeriod;
+  }
+  _apscSessions[0]->Activate();
+}
+
+// do main loop of additional sessions
+static void UpdateSessions(void)
+{
+  for (INDEX iSession=1; iSession<_ctSessions; iSession++) {
+    _apscSessions[iSession]->Activate();
+    _pNetwork->MainLoop();
+    // keep the session paused while nobody is playing in it
+    const BOOL bPlayers = _pGame->GetPlayersCount()>0;
+    if (bPlayers==_pNetwork->IsPaused()) {
+      _pNetwork->TogglePause();
+    }
+    // restart the level when it is finished
+    if (_pNetwork->IsGameFinished()) {
+      _pNetwork->StopGame();
+      _pNetwork->StopProvider();
+      StartSession(iSession);
+    }
+  }
+  _apscSessions[0]->Activate();
+}
+
+// compare memory and tick time of this process with running each session in its own process
+static void SessionStats(void)
+{
+  if (_ctSessions<=1) {
+    CPrintF(TRANS("Only one session is running (set ded_ctSessions before start).\n"));
+    return;
+  }
+  CPrintF(TRANS("%d sessions in one process:\n"), _ctSessions);
+  DOUBLE dTotalMS = 0;
+  for (INDEX iSession=0; iSession<_ctSessions; iSession++) {
+    CSessionContext &sc = *_apscSessions[iSession];
+    const DOUBLE dTickMS = sc.sc_ctTicks>0 ? sc.sc_tvTicks.GetSeconds()*1000.0/sc.sc_ctTicks : 0.0;
+    dTotalMS += dTickMS;
+    CPrintF(TRANS("  session %d (port %d): %d ticks, %.3f ms per tick\n"), iSession+1, sc.sc_iPort, sc.sc_ctTicks, dTickMS);
+  }
+  const DOUBLE dTickBudgetMS = _pTimer->TickQuantum*1000.0;
+  CPrintF(TRANS("  all sessions: %.3f ms per tick (%.1f%% of one CPU), room for about %d such sessions\n"),
+    dTotalMS, dTotalMS/dTickBudgetMS*100.0, dTotalMS>0 ? INDEX(dTickBudgetMS/(dTotalMS/_ctSessions)) : 0);
+  // each process would have the footprint of one session, including its own copy of all stocks
+  const DOUBLE dOneMB = _slMemoryOneSession/(1024.0*1024.0);
+  const DOUBLE dAllMB = _slMemoryAllSessions/(1024.0*1024.0);
+  const DOUBLE dNowMB = GetProcessMemory()/(1024.0*1024.0);
+  CPrintF(TRANS("  memory with one session: %.1f MB, after starting all: %.1f MB, now: %.1f MB\n"), dOneMB, dAllMB, dNowMB);
+  CPrintF(TRANS("  %d processes with one session each would take about %.1f MB\n"), _ctSessions, dOneMB*_ctSessions);
+}
+
 // do the main game loop and render screen
 void DoGame(void)
 {
+  // with several sessions, their ticks are run from here
+  if (_ctSessions>0) {
+    RunSessionTicks();
+  }
+
   // do the main game loop
   if( _pGame->gm_bGameOn) {
     _pGame->GameMainLoop();
@@ -379,6 +603,11 @@ void DoGame(void)
     _pNetwork->GameInactive();
   }
 
+  // let additional sessions process their messages
+  if (_ctSessions>1) {
+    UpdateSessions();
+  }
+
   // limit current frame rate if needed
   LimitFrameRate();
 }
@@ -392,6 +621,20 @@ int SubMain(int argc, char* argv[])
     return -1;
   }
 
+  // if only timing a demo, exit code tells if it stayed in sync
+  if (_strTimeDemo!="") {
+    BOOL bInSync = FALSE;
+    try {
+      CTFileName fnDemo = _strTimeDemo;
+      bInSync = _pNetwork->TimeDemo_t(fnDemo, _ctTimeDemoPasses,
+        CTString("Temp\\TimeDemo.json"), fnDemo.NoExt()+".crc");
+    } catch (char *strError) {
+      CPrintF(TRANS("Cannot time demo '%s': %s\n"), (const char *)_strTimeDemo, strError);
+    }
+    End();
+    return bInSync ? 0 : 1;
+  }
+
   // initialy, application is running
   _bRunning = TRUE;
 
@@ -399,8 +642,19 @@ int SubMain(int argc, char* argv[])
   ExecScript(CTFILENAME("Scripts\\Dedicated_startup.ini"));
   // execute startup script for this config
   ExecScript(ded_strConfig+"init.ini");
+  // with several sessions, main loop runs ticks of all of them
+  if (ded_ctSessions>1) {
+    _pTimer->SetInterrupt(FALSE);
+  // run ticks from precise scheduler instead of multimedia timer
+  } else if (ded_bPreciseTicks) {
+    TickScheduler_Start();
+  }
   // start first round
   RoundBegin();
+  // host additional sessions
+  if (ded_ctSessions>1 && _bRunning) {
+    StartSessions();
+  }
 
   // while it is still running
   while( _bRunning)
@@ -445,8 +699,21 @@ int SubMain(int argc, char* argv[])
 
   } // end of main application loop
 
+  // stop additional sessions
+  if (_ctSessions>1) {
+    SessionStats();
+  }
+  StopSessions();
   _pGame->StopGame();
 
+  // log how well ticks kept to time
+  if (TickScheduler_IsRunning()) {
+    CTString strReport;
+    TickScheduler_Report(strReport);
+    CPrintF("%s", (const char*)strReport);
+    TickScheduler_Stop();
+  }
+
   End();
 
   return 0;
@@ -93,8 +93,184 @@ char *GetLineDirective(SType &st)
     return "";
   }
 }
+// IDs of table entries in current class, for generating lookup tables sorted by ID
+struct IDList {
+  unsigned long *il_aulIDs;
+  int il_ctIDs;
+  int il_ctAllocated;
+};
+static IDList _ilProperties = {NULL, 0, 0};
+static IDList _ilHandlers   = {NULL, 0, 0};
+
+void AddID(IDList &il, unsigned long ulID)
+{
+  if (il.il_ctIDs==il.il_ctAllocated) {
+    il.il_ctAllocated = il.il_ctAllocated*2+64;
+    il.il_aulIDs = (unsigned long *)realloc(il.il_aulIDs, il.il_ctAllocated*sizeof(unsigned long));
+  }
+  il.il_aulIDs[il.il_ctIDs++] = ulID;
+}
+
+static unsigned long *_aulSortedIDs;
+static int CompareIDs(const void *p0, const void *p1)
+{
+  const int i0 = *(const int *)p0;
+  const int i1 = *(const int *)p1;
+  if (_aulSortedIDs[i0]<_aulSortedIDs[i1]) return -1;
+  if (_aulSortedIDs[i0]>_aulSortedIDs[i1]) return +1;
+  // keep declaration order for same IDs, so first one is found
+  return i0-i1;
+}
+
+// write indices of table entries in ascending order of their IDs
+void PrintSortedIDs(IDList &il, const char *strTable)
+{
+  fprintf(_fTables, "const INDEX %s_%s[] = {", _strCurrentClass, strTable);
+  if (il.il_ctIDs==0) {
+    fprintf(_fTables, "0");
+  } else {
+    int *aiOrder = (int *)malloc(il.il_ctIDs*sizeof(int));
+    for (int i=0; i<il.il_ctIDs; i++) {
+      aiOrder[i] = i;
+    }
+    _aulSortedIDs = il.il_aulIDs;
+    qsort(aiOrder, il.il_ctIDs, sizeof(int), CompareIDs);
+    for (int i=0; i<il.il_ctIDs; i++) {
+      fprintf(_fTables, "%s%d", (i%16==0) ? "\n " : " ", aiOrder[i]);
+      if (i<il.il_ctIDs-1) fprintf(_fTables, ",");
+    }
+    free(aiOrder);
+  }
+  fprintf(_fTables, "};\n");
+  il.il_ctIDs = 0;
+}
+
+// properties of current class, for generating straight-line serializers
+struct PropertyInfo {
+  unsigned long pi_ulID;   // packed class and property ID
+  const char *pi_strType;  // property type without "CEntityProperty::"
+  char *pi_strMember;      // name of the member variable
+};
+static PropertyInfo *_apiProperties = NULL;
+static int _ctProperties = 0;
+static int _ctPropertiesAllocated = 0;
+
+void AddPropertyInfo(unsigned long ulID, const char *strType, const char *strMember)
+{
+  if (_ctProperties==_ctPropertiesAllocated) {
+    _ctPropertiesAllocated = _ctPropertiesAllocated*2+64;
+    _apiProperties = (PropertyInfo *)realloc(_apiProperties, _ctPropertiesAllocated*sizeof(PropertyInfo));
+  }
+  PropertyInfo &pi = _apiProperties[_ctProperties++];
+  pi.pi_ulID = ulID&0xFFFFFFFFUL;
+  pi.pi_strType = strType+strlen("CEntityProperty::");
+  pi.pi_strMember = strdup(strMember);
+}
+
+// plain data properties are stored in streams exactly as they are in memory
+int IsPlainProperty(const PropertyInfo &pi)
+{
+  static const char *astrPlain[] = {
+    "EPT_BOOL", "EPT_INDEX", "EPT_ENUM", "EPT_FLAGS", "EPT_ANIMATION", "EPT_ILLUMINATIONTYPE",
+    "EPT_COLOR", "EPT_ANGLE", "EPT_FLOAT", "EPT_RANGE", "EPT_FLOATAABBOX3D", "EPT_FLOATMATRIX3D",
+    "EPT_FLOATQUAT3D", "EPT_FLOAT3D", "EPT_ANGLE3D", "EPT_FLOATplane3D", "EPT_PLACEMENT3D",
+  };
+  for (int i=0; i<sizeof(astrPlain)/sizeof(astrPlain[0]); i++) {
+    if (strcmp(pi.pi_strType, astrPlain[i])==0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// find end of a run of plain properties (limited, since a run is buffered on stack)
+#define MAX_PLAINRUN 32
+int PlainRunEnd(int iFirst, int ctMax)
+{
+  int iEnd = iFirst;
+  while (iEnd<_ctProperties && iEnd-iFirst<ctMax && IsPlainProperty(_apiProperties[iEnd])) {
+    iEnd++;
+  }
+  return iEnd;
+}
+
+// write property reader and writer for streams, or reader from a buffer
+void PrintPropertyStreamer(int bRead)
+{
+  if (bRead) {
+    fprintf(_fTables, "BOOL %s_ReadProperties_t(CEntity *pen, CTStream &strm) {\n", _strCurrentClass);
+  } else {
+    fprintf(_fTables, "void %s_WriteProperties_t(CEntity *pen, CTStream &strm) {\n", _strCurrentClass);
+  }
+  if (_ctProperties>0) {
+    fprintf(_fTables, "  %s &en = *(%s *)pen;\n", _strCurrentClass, _strCurrentClass);
+  }
+  for (int i=0; i<_ctProperties; ) {
+    int iEnd = PlainRunEnd(i, MAX_PLAINRUN);
+    // single property that is not plain goes through the engine
+    if (iEnd==i) {
+      PropertyInfo &pi = _apiProperties[i];
+      fprintf(_fTables, "  %s(0x%08lxUL, %s, en.%s)\n",
+        bRead ? "EPS_READONE" : "EPS_WRITEONE", pi.pi_ulID, pi.pi_strType, pi.pi_strMember);
+      i++;
+      continue;
+    }
+    // run of plain properties goes through stack buffer
+    fprintf(_fTables, "  EPS_BEGINRUN(%d*sizeof(ULONG)", iEnd-i);
+    int j;
+    for (j=i; j<iEnd; j++) {
+      fprintf(_fTables, "+sizeof(en.%s)", _apiProperties[j].pi_strMember);
+    }
+    fprintf(_fTables, ")\n");
+    if (bRead) {
+      fprintf(_fTables, "    EPS_READRUN\n");
+    }
+    for (j=i; j<iEnd; j++) {
+      PropertyInfo &pi = _apiProperties[j];
+      fprintf(_fTables, "    %s(0x%08lxUL, %s, en.%s)\n",
+        bRead ? "EPS_GET" : "EPS_PUT", pi.pi_ulID, pi.pi_strType, pi.pi_strMember);
+    }
+    if (!bRead) {
+      fprintf(_fTables, "    EPS_WRITERUN\n");
+    }
+    fprintf(_fTables, "  EPS_ENDRUN\n");
+    i = iEnd;
+  }
+  if (bRead) {
+    fprintf(_fTables, "  return TRUE;\n");
+  }
+  fprintf(_fTables, "}\n");
+}
+
+// write straight-line reader, writer and copier for properties of current class
+void PrintPropertySerializers(void)
+{
+  PrintPropertyStreamer(1);
+  PrintPropertyStreamer(0);
+
+  fprintf(_fTables, "void %s_CopyProperties(CEntity *pen, CEntity *penOther, ULONG ulFlags) {\n", _strCurrentClass);
+  if (_ctProperties>0) {
+    fprintf(_fTables, "  %s &en = *(%s *)pen;\n", _strCurrentClass, _strCurrentClass);
+    fprintf(_fTables, "  %s &enOther = *(%s *)penOther;\n", _strCurrentClass, _strCurrentClass);
+  }
+  for (int i=0; i<_ctProperties; ) {
+    // members of consecutive plain properties are adjacent, so they are copied at once
+    int iEnd = PlainRunEnd(i, _ctProperties);
+    if (iEnd==i) {
+      fprintf(_fTables, "  EPS_COPYONE(%s, %s)\n", _apiProperties[i].pi_strType, _apiProperties[i].pi_strMember);
+      i++;
+    } else {
+      fprintf(_fTables, "  EPS_COPYRUN(%s, %s)\n", _apiProperties[i].pi_strMember, _apiProperties[iEnd-1].pi_strMember);
+      i = iEnd;
+    }
+  }
+  fprintf(_fTables, "}\n");
+  _ctProperties = 0;
+}
+
 void AddHandlerFunction(char *strProcedureName, int iStateID)
 {
+  AddID(_ilHandlers, (unsigned long)iStateID);
   fprintf(_fDeclaration, "  BOOL %s(const CEntityEvent &__eeInput);\n", strProcedureName);
   fprintf(_fTables, " {0x%08x, -1, CEntity::pEventHandler(&%s::%s), "
     "DEBUGSTRING(\"%s::%s\")},\n",
@@ -104,6 +280,7 @@ void AddHandlerFunction(char *strProcedureName, int iStateID)
 
 void AddHandlerFunction(char *strProcedureName, char *strStateID, char *strBaseStateID)
 {
+  AddID(_ilHandlers, strtoul(strStateID, NULL, 0));
   fprintf(_fDeclaration, "  BOOL %s(const CEntityEvent &__eeInput);\n", strProcedureName);
   fprintf(_fTables, " {%s, %s, CEntity::pEventHandler(&%s::%s),"
     "DEBUGSTRING(\"%s::%s\")},\n",
@@ -125,6 +302,8 @@ void CreateInternalHandlerFunction(char *strFunctionName, char *strID)
 void DeclareFeatureProperties(void)
 {
   if (_bFeature_CanBePredictable) {
+    AddID(_ilProperties, (_iCurrentClassID<<8)+255);
+    AddPropertyInfo(((unsigned long)_iCurrentClassID<<8)+255, "CEntityProperty::EPT_ENTITYPTR", "m_penPrediction");
     fprintf(_fTables, " CEntityProperty(CEntityProperty::EPT_ENTITYPTR, NULL, (0x%08x<<8)+%s, offsetof(%s, %s), %s, %s, %s, %s),\n",
       _iCurrentClassID,
       "255",
@@ -336,11 +515,21 @@ event_declaration
       _strCurrentEvent);
     fprintf(_fDeclaration, "%s();\n", _strCurrentEvent );
     fprintf(_fDeclaration, "CEntityEvent *MakeCopy(void);\n");
+    fprintf(_fDeclaration, "SLONG GetSizeOf(void);\n");
+    fprintf(_fDeclaration, "CEntityEvent *MakeCopyAt(void *pvMemory);\n");
     fprintf(_fImplementation, 
       "CEntityEvent *%s::MakeCopy(void) { "
       "CEntityEvent *peeCopy = new %s(*this); "
       "return peeCopy;}\n",
       _strCurrentEvent, _strCurrentEvent);
+    fprintf(_fImplementation, 
+      "SLONG %s::GetSizeOf(void) { "
+      "return sizeof(%s);}\n",
+      _strCurrentEvent, _strCurrentEvent);
+    fprintf(_fImplementation, 
+      "CEntityEvent *%s::MakeCopyAt(void *pvMemory) { "
+      "return CopyEventAt(pvMemory, *this);}\n",
+      _strCurrentEvent);
     fprintf(_fImplementation, "%s::%s() : CEntityEvent(EVENTCODE_%s) {;\n",
       _strCurrentEvent, _strCurrentEvent, _strCurrentEvent);
   } '{' event_members_list opt_comma '}' ';' {
@@ -386,6 +575,9 @@ class_declaration
     _strCurrentThumbnail = $10.strString;
 
     fprintf(_fTables, "#define ENTITYCLASS %s\n\n", _strCurrentClass);
+    _ilProperties.il_ctIDs = 0;
+    _ilHandlers.il_ctIDs = 0;
+    _ctProperties = 0;
     fprintf(_fDeclaration, "extern \"C\" DECL_DLL CDLLEntityClass %s_DLLClass;\n",
       _strCurrentClass);
     fprintf(_fDeclaration, "%s %s : public %s {\npublic:\n",
@@ -414,6 +606,7 @@ class_declaration
   } '}' ';' {
     fprintf(_fTables, "};\n#define %s_handlersct ARRAYCOUNT(%s_handlers)\n", 
       _strCurrentClass, _strCurrentClass);
+    PrintSortedIDs(_ilHandlers, "handlersbystate");
     fprintf(_fTables, "\n");
 
     if (_bFeature_AbstractBaseClass) {
@@ -564,6 +757,10 @@ property_declaration_list
     DeclareFeatureProperties(); // this won't work, but at least it will generate an error!!!!
     fprintf(_fTables, "  CEntityProperty()\n};\n");
     fprintf(_fTables, "#define %s_propertiesct 0\n", _strCurrentClass);
+    _ilProperties.il_ctIDs = 0;
+    PrintSortedIDs(_ilProperties, "propertiesbyid");
+    _ctProperties = 0;
+    PrintPropertySerializers();
     fprintf(_fTables, "\n");
     fprintf(_fTables, "\n");
   }
@@ -572,6 +769,8 @@ property_declaration_list
     fprintf(_fTables, "};\n");
     fprintf(_fTables, "#define %s_propertiesct ARRAYCOUNT(%s_properties)\n", 
       _strCurrentClass, _strCurrentClass);
+    PrintSortedIDs(_ilProperties, "propertiesbyid");
+    PrintPropertySerializers();
     fprintf(_fTables, "\n");
   }
   ;
@@ -585,6 +784,9 @@ empty_property_declaration_list
 
 property_declaration
   : property_id property_type property_identifier property_wed_name_opt property_default_opt property_flags_opt {
+    AddID(_ilProperties, (_iCurrentClassID<<8)+strtoul(_strCurrentPropertyID, NULL, 0));
+    AddPropertyInfo(((unsigned long)_iCurrentClassID<<8)+strtoul(_strCurrentPropertyID, NULL, 0),
+      _strCurrentPropertyPropertyType, _strCurrentPropertyIdentifier);
     fprintf(_fTables, " CEntityProperty(%s, %s, (0x%08x<<8)+%s, offsetof(%s, %s), %s, %s, %s, %s),\n",
       _strCurrentPropertyPropertyType,
       _strCurrentPropertyEnumType,
@@ -0,0 +1,158 @@
+/* Copyright (c) 2002-2012 Croteam Ltd.
+This program is free software; you can redistribute it and/or modify
+it under the terms of version 2 of the GNU General Public License as published by
+the Free Software Foundation
+
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA. */
+
+
+#include "StdH.h"
+
+#include <Engine/Base/BackgroundWrite.h>
+#include <Engine/Base/Stream.h>
+#include <Engine/Base/Console.h>
+#include <Engine/Base/ErrorReporting.h>
+#include <Engine/Base/Timer.h>
+#include <Engine/Base/MemoryPool.h>
+#include <Engine/Base/Trace.h>
+#include <DbgHelp.h>
+
+// pending write
+static HANDLE _hWriter = NULL;
+static CTMemoryStream *_pstrmPending = NULL;
+static CTFileName _fnmPending;          // as given by caller
+static CTFileName _fnmFull;             // expanded path on disk
+static CTFileName _fnmTemporary;
+static const char *_strDone = NULL;    // message to print when written
+static const UBYTE *_pubData = NULL;
+static SLONG _slSize = 0;
+static char _strError[256] = "";
+static DOUBLE _dWriteSeconds = 0;
+
+
+static BOOL WriteAll( HANDLE hFile, const UBYTE *pub, SLONG slSize)
+{
+  while( slSize>0) {
+    DWORD dwWritten = 0;
+    const DWORD dwChunk = Min( slSize, SLONG(1<<20));
+    if( !WriteFile( hFile, pub, dwChunk, &dwWritten, NULL) || dwWritten==0) return FALSE;
+    pub += dwWritten;
+    slSize -= dwWritten;
+  }
+  return TRUE;
+}
+
+
+static void SetError( const char *strWhat)
+{
+  _snprintf( _strError, sizeof(_strError)-1, "%s (error %d)", strWhat, GetLastError());
+  _strError[sizeof(_strError)-1] = 0;
+}
+
+
+static DWORD WINAPI WriterThread( LPVOID lpParameter)
+{
+  Trace_SetThreadName("Background write");
+  const CTimerValue tvStart = _pTimer->GetHighPrecisionTimer();
+  _strError[0] = 0;
+
+  HANDLE hFile = CreateFileA( _fnmTemporary, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+  if( hFile==INVALID_HANDLE_VALUE) {
+    SetError( TRANS("cannot create file"));
+  } else {
+    if( !WriteAll( hFile, _pubData, _slSize)) {
+      SetError( TRANS("cannot write file"));
+    // make sure data is on disk before the old file is replaced
+    } else if( !FlushFileBuffers(hFile)) {
+      SetError( TRANS("cannot flush file"));
+    }
+    CloseHandle(hFile);
+    if( _strError[0]==0 && !MoveFileExA( _fnmTemporary, _fnmFull, MOVEFILE_REPLACE_EXISTING|MOVEFILE_WRITE_THROUGH)) {
+      SetError( TRANS("cannot rename file"));
+    }
+    if( _strError[0]!=0) DeleteFileA(_fnmTemporary);
+  }
+  _dWriteSeconds = (_pTimer->GetHighPrecisionTimer()-tvStart).GetSeconds();
+  MemPool_ReleaseThreadCache();
+  return 0;
+}
+
+
+// free finished write and report its outcome
+static BOOL Finish(void)
+{
+  WaitForSingleObject( _hWriter, INFINITE);
+  CloseHandle(_hWriter);
+  _hWriter = NULL;
+  _pstrmPending->UnlockBuffer();
+  delete _pstrmPending;
+  _pstrmPending = NULL;
+
+  if( _strError[0]!=0) {
+    CPrintF( TRANS("Cannot write '%s': %s\n"), (const char*)_fnmPending, _strError);
+    return FALSE;
+  }
+  if( _strDone!=NULL) CPrintF( _strDone, (const char*)_fnmPending);
+  return TRUE;
+}
+
+
+void BackgroundWrite_Start_t(CTMemoryStream *pstrm, const CTFileName &fnmFile, const char *strDone) // throw char *
+{
+  BackgroundWrite_Wait();
+
+  CTFileName fnmAbsolute = fnmFile;
+  fnmAbsolute.SetAbsolutePath();
+  ExpandFilePath( EFP_WRITE, fnmAbsolute, _fnmFull);
+  MakeSureDirectoryPathExists(_fnmFull);
+  _fnmTemporary = _fnmFull+".tmp";
+  _fnmPending = fnmFile;
+  _strDone = strDone;
+
+  void *pvData;
+  pstrm->LockBuffer( &pvData, &_slSize);
+  _pubData = (const UBYTE*)pvData;
+  _pstrmPending = pstrm;
+
+  DWORD dwThreadID;
+  _hWriter = CreateThread( NULL, 0, WriterThread, NULL, 0, &dwThreadID);
+  if( _hWriter==NULL) {
+    // caller keeps the stream
+    pstrm->UnlockBuffer();
+    _pstrmPending = NULL;
+    ThrowF_t( TRANS("Cannot start background write of '%s'"), (const char*)fnmFile);
+  }
+}
+
+
+BOOL BackgroundWrite_Wait(void)
+{
+  if( _hWriter==NULL) return TRUE;
+  return Finish();
+}
+
+
+void BackgroundWrite_Poll(void)
+{
+  if( _hWriter!=NULL && WaitForSingleObject( _hWriter, 0)==WAIT_OBJECT_0) Finish();
+}
+
+
+BOOL BackgroundWrite_IsPending(void)
+{
+  return _hWriter!=NULL;
+}
+
+
+DOUBLE BackgroundWrite_GetLastSeconds(void)
+{
+  return _dWriteSeconds;
+}
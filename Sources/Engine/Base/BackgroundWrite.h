@@ -0,0 +1,41 @@
+/* Copyright (c) 2002-2012 Croteam Ltd.
+This program is free software; you can redistribute it and/or modify
+it under the terms of version 2 of the GNU General Public License as published by
+the Free Software Foundation
+
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA. */
+
+
+#ifndef SE_INCL_BACKGROUNDWRITE_H
+#define SE_INCL_BACKGROUNDWRITE_H
+#ifdef PRAGMA_ONCE
+  #pragma once
+#endif
+
+// Write contents of a memory stream to a file on a background thread. The file is written
+// under a temporary name, flushed to disk and then renamed, so it is never seen half-written.
+// Only one write is pending at a time; starting another waits for the previous one.
+// NOTE: stream is locked and owned by the writer until the write is finished, and
+// all functions must be called from the thread that creates streams.
+// When the file is written, given message is printed with its name (failures are always reported).
+ENGINE_API extern void BackgroundWrite_Start_t(CTMemoryStream *pstrm, const CTFileName &fnmFile,
+                                               const char *strDone=NULL); // throw char *
+// wait for pending write to finish; returns FALSE if it failed
+ENGINE_API extern BOOL BackgroundWrite_Wait(void);
+// report and clean up finished write, if any (call regularly from main loop)
+ENGINE_API extern void BackgroundWrite_Poll(void);
+ENGINE_API extern BOOL BackgroundWrite_IsPending(void);
+// time it took to write last finished file
+ENGINE_API extern DOUBLE BackgroundWrite_GetLastSeconds(void);
+
+
+#endif  /* include-once check. */
+
@@ -17,6 +17,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include <Engine/Base/Console.h>
 #include <Engine/Base/Console_Internal.h>
+#include <Engine/Base/LogQueue.h>
 
 #include <Engine/Base/Timer.h>
 #include <Engine/Base/ErrorReporting.h>
@@ -206,6 +207,12 @@ void CConsole::ScrollBufferUp(INDEX ctLines)
 
 // Add a line of text to console
 void CConsole::PutString(const char *strString)
+{
+  WriteString(strString, TRUE);
+}
+
+// Add a line of text to console, optionally without flushing the log file
+void CConsole::WriteString(const char *strString, BOOL bFlushLog)
 {
   if (this==NULL) {
     return;
@@ -218,7 +225,9 @@ void CConsole::PutString(const char *strString)
   // first append that string to the console output file
   if (con_fLog!=NULL) {
     fprintf(con_fLog, "%s", strString);
-    fflush(con_fLog);
+    if (bFlushLog) {
+      fflush(con_fLog);
+    }
   }
   // if needed, append to capture string
   if (con_bCapture) {
@@ -262,12 +271,26 @@ void CConsole::PutString(const char *strString)
   }
 }
 
+// Flush log file buffers
+void CConsole::FlushLog(void)
+{
+  if (this==NULL) {
+    return;
+  }
+  CTSingleLock slConsole(&con_csConsole, TRUE);
+  if (con_fLog!=NULL) {
+    fflush(con_fLog);
+  }
+}
+
 // Close console log file buffers (call only when force-exiting!)
 void CConsole::CloseLog(void)
 {
   if (this==NULL) {
     return;
   }
+  // write out lines still waiting in queue
+  LogQueue_Flush();
   if (con_fLog!=NULL) {
     fclose(con_fLog);
   }
@@ -280,14 +303,21 @@ extern void CPrintF(const char *strFormat, ...)
   if (_pConsole==NULL) {
     return;
   }
-  // format the message in buffer
+  // queue the message for the log writer (formatted there if possible)
   va_list arg;
   va_start(arg, strFormat);
-  CTString strBuffer;
-  strBuffer.VPrintF(strFormat, arg);
+  LogQueue_VPrint(LC_GENERAL, LS_INFO, strFormat, arg);
+}
 
-  // print it to the main console
-  _pConsole->PutString(strBuffer);
+// Print formated text to the main console on given channel.
+extern void CLogF(INDEX iChannel, INDEX iSeverity, const char *strFormat, ...)
+{
+  if (_pConsole==NULL) {
+    return;
+  }
+  va_list arg;
+  va_start(arg, strFormat);
+  LogQueue_VPrint(iChannel, iSeverity, strFormat, arg);
 }
 
 // Add a string of text to console
@@ -296,7 +326,7 @@ void CPutString(const char *strString)
   if (_pConsole==NULL) {
     return;
   }
-  _pConsole->PutString(strString);
+  LogQueue_Put(LC_GENERAL, LS_INFO, strString);
 }
 
 // Get number of lines newer than given time
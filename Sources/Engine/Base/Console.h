@@ -24,6 +24,24 @@ ENGINE_API extern void CPrintF(const char *strFormat, ...);
 // Add a string of text to console
 ENGINE_API void CPutString(const char *strString);
 
+// channels and severities of console output, filtered and rate limited per channel
+enum LogChannel {
+  LC_GENERAL = 0,   // CPrintF() and CPutString()
+  LC_NETWORK,       // network errors and resends
+  LC_PREDICTION,    // prediction reports
+  LC_PROFILING,     // profile dumps
+  LC_TEST,          // log stress test (not shown in console)
+  LC_COUNT
+};
+enum LogSeverity {
+  LS_DEBUG = 0,
+  LS_INFO,
+  LS_WARNING,
+  LS_ERROR
+};
+// Print formated text to the main console on given channel.
+ENGINE_API extern void CLogF(INDEX iChannel, INDEX iSeverity, const char *strFormat, ...);
+
 // Get number of lines newer than given time
 ENGINE_API INDEX CON_NumberOfLinesAfter(TIME tmLast);
 // Get one of last lines
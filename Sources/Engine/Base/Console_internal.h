@@ -61,6 +61,10 @@ public:
   ENGINE_API INDEX GetBufferSize(void);
   // Add a string of text to console
   void PutString(const char *strString);
+  // Add a string of text to console, optionally without flushing the log file
+  void WriteString(const char *strString, BOOL bFlushLog);
+  // Flush log file buffers
+  void FlushLog(void);
   // Close console log file buffers (call only when force-exiting!)
   void CloseLog(void);
 
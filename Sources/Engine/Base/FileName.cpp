@@ -55,6 +55,21 @@ CTFileName &CTFileName::operator=(const char *strCharString)
   return *this;
 }
 
+/*
+ * Get interned atom of the file name.
+ */
+ULONG CTFileName::GetAtom(void) const
+{
+  // if the atom is still of the current string
+  if (HasAtom()) {
+    return fnm_ulAtom;
+  }
+  // intern the current string
+  CTFileName &fnmThis = (CTFileName &)*this;
+  fnmThis.fnm_ulAtom = FNA_Intern(str_String);
+  return fnm_ulAtom;
+}
+
 /*
  * Get name part of a filename.
  */
@@ -211,6 +226,7 @@ BOOL CTFileName::RemoveApplicationPath_t(void) // throws char *
     // read the string
     strmStream>>(CTString &)fnmFileName;
     fnmFileName.fnm_pserPreloaded = NULL;
+    fnmFileName.fnm_ulAtom = FNA_NONE;
   }
 
   return strmStream;
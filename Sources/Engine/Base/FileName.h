@@ -20,6 +20,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #endif
 
 #include <Engine/Base/CTString.h>
+#include <Engine/Base/FileNameAtom.h>
 
 /*
  * Special kind of string, dedicated to storing filenames.
@@ -27,22 +28,46 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 class ENGINE_API CTFileName : public CTString {
 public:
   class CSerial *fnm_pserPreloaded;     // pointer to already loaded object if available
+  ULONG fnm_ulAtom;                     // interned name if taken (see FileNameAtom.h)
 private:
   /* Constructor from character string. */
-  inline CTFileName(const char *pString) : CTString(pString), fnm_pserPreloaded(NULL) {};
+  inline CTFileName(const char *pString) : CTString(pString), fnm_pserPreloaded(NULL),
+    fnm_ulAtom(FNA_NONE) {};
 public:
   /* Default constructor. */
-  inline CTFileName(void) : fnm_pserPreloaded(NULL) {};
+  inline CTFileName(void) : fnm_pserPreloaded(NULL), fnm_ulAtom(FNA_NONE) {};
   /* Copy constructor. */
-  inline CTFileName(const CTString &strOriginal) : CTString(strOriginal), fnm_pserPreloaded(NULL) {};
+  inline CTFileName(const CTString &strOriginal) : CTString(strOriginal), fnm_pserPreloaded(NULL),
+    fnm_ulAtom(FNA_NONE) {};
+  inline CTFileName(const CTFileName &fnmOriginal) : CTString(fnmOriginal),
+    fnm_pserPreloaded(fnmOriginal.fnm_pserPreloaded), fnm_ulAtom(fnmOriginal.fnm_ulAtom) {};
   /* Constructor from character string for insertion in exe-file. */
-  inline CTFileName(const char *pString, int i) : CTString(pString+i), fnm_pserPreloaded(NULL) {};
+  inline CTFileName(const char *pString, int i) : CTString(pString+i), fnm_pserPreloaded(NULL),
+    fnm_ulAtom(FNA_NONE) {};
 
   /* Assignment. */
   CTFileName &operator=(const char *strCharString);
   inline void operator=(const CTString &strOther) {
     CTString::operator=(strOther);
     fnm_pserPreloaded = NULL;
+    fnm_ulAtom = FNA_NONE;
+  };
+  inline CTFileName &operator=(const CTFileName &fnmOther) {
+    CTString::operator=(fnmOther);
+    fnm_pserPreloaded = fnmOther.fnm_pserPreloaded;
+    fnm_ulAtom = fnmOther.fnm_ulAtom;
+    return *this;
+  };
+
+  // get interned atom of the file name (taken on first use, and kept while it matches the
+  // string, which can be changed through CTString without the file name knowing it)
+  ULONG GetAtom(void) const;
+  inline void ForgetAtom(void) { fnm_ulAtom = FNA_NONE; };
+  // get hash of the file name (same as FNA_Hash() of the string)
+  inline ULONG GetAtomHash(void) const { return FNA_GetHash(GetAtom()); };
+  // check if the atom is already taken for current string
+  inline BOOL HasAtom(void) const {
+    return fnm_ulAtom!=FNA_NONE && FNA_IsNameOf(fnm_ulAtom, str_String);
   };
 
   /* Get directory part of a filename. */
@@ -69,6 +94,16 @@ public:
   ENGINE_API friend CTStream &operator<<(CTStream &strmStream, const CTFileName &fnmFileName);
 };
 
+// keys and comparison for name tables, where file names are looked up by their atoms
+inline ULONG NameTable_GetKey(const CTString &strName) { return FNA_Hash(strName); };
+inline ULONG NameTable_GetKey(const CTFileName &fnmName) { return fnmName.GetAtomHash(); };
+inline BOOL NameTable_SameName(const CTString &strElement, const CTFileName &fnmName) {
+  return strElement==fnmName;
+};
+inline BOOL NameTable_SameName(const CTFileName &fnmElement, const CTFileName &fnmName) {
+  return fnmElement.GetAtom()==fnmName.GetAtom();
+};
+
 // macro for defining a literal filename in code (EFNM = exe-filename)
 #define CTFILENAME(string) CTFileName("EFNM" string, 4)
 #define DECLARE_CTFILENAME(name, string) CTFileName name("EFNM" string, 4)
@@ -0,0 +1,243 @@
+/* Copyright (c) 2002-2012 Croteam Ltd.
+This program is free software; you can redistribute it and/or modify
+it under the terms of version 2 of the GNU General Public License as published by
+the Free Software Foundation
+
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA. */
+
+#include "StdH.h"
+
+#include <Engine/Base/FileNameAtom.h>
+#include <Engine/Base/Shell.h>
+#include <Engine/Base/Console.h>
+#include <Engine/Base/Memory.h>
+#include <Engine/Base/ErrorReporting.h>
+#include <Engine/Base/Synchronization.h>
+
+/*
+Interned file names.
+
+Atoms index blocks of entries that are never moved nor freed, so hash, length and
+name of an atom can be read without locking. Names are stored in big chunks of memory.
+Interning looks the name up in an open-addressing hash table of atoms under a lock;
+name is normalized only while hashing and comparing, the first spelling is kept.
+*/
+
+#define ATOMS_PER_BLOCK 4096
+#define MAX_ATOMBLOCKS  1024
+#define NAMECHUNK_SIZE  (64*1024)
+
+struct FileNameAtom {
+  ULONG fna_ulHash;
+  INDEX fna_ctLength;
+  const char *fna_strName;
+};
+
+static FileNameAtom *_apfnaBlocks[MAX_ATOMBLOCKS];
+static ULONG _ctAtoms = 0;          // valid atoms are 1.._ctAtoms
+static ULONG *_aulSlots = NULL;     // hash table of atoms (FNA_NONE marks empty slot)
+static ULONG _ctSlots = 0;          // always power of 2
+static char *_pchNameChunk = NULL;  // free part of current chunk for names
+static INDEX _ctNameChunkFree = 0;
+static SLONG _slNameMemory = 0;
+static CTCriticalSection _csAtoms;
+
+// lookup counters
+static ULONG _ctLookups = 0;
+static ULONG _ctLookupsNew = 0;
+static ULONG _ctProbes = 0;
+
+
+// file names are same regardless of case and kind of slashes
+static inline UBYTE NormalizeChar(UBYTE ub)
+{
+  if( ub>='a' && ub<='z') return ub-('a'-'A');
+  if( ub=='/') return '\\';
+  return ub;
+}
+
+
+static inline ULONG HashName(const char *strFileName, INDEX &ctLength)
+{
+  // FNV-1a of normalized characters
+  ULONG ulHash = 2166136261UL;
+  const UBYTE *pub = (const UBYTE*)strFileName;
+  for( ; *pub!=0; pub++) {
+    ulHash = (ulHash^NormalizeChar(*pub))*16777619UL;
+  }
+  ctLength = pub-(const UBYTE*)strFileName;
+  return ulHash;
+}
+
+
+static inline BOOL SameNames(const char *str1, const char *str2, INDEX ctLength)
+{
+  const UBYTE *pub1 = (const UBYTE*)str1;
+  const UBYTE *pub2 = (const UBYTE*)str2;
+  for( INDEX i=0; i<ctLength; i++) {
+    if( NormalizeChar(pub1[i])!=NormalizeChar(pub2[i])) return FALSE;
+  }
+  return TRUE;
+}
+
+
+static inline FileNameAtom &GetEntry(ULONG ulAtom)
+{
+  ASSERT( ulAtom!=FNA_NONE && ulAtom<=_ctAtoms);
+  const ULONG iAtom = ulAtom-1;
+  return _apfnaBlocks[iAtom/ATOMS_PER_BLOCK][iAtom%ATOMS_PER_BLOCK];
+}
+
+
+// double the hash table and rehash all atoms
+static void GrowSlots(void)
+{
+  const ULONG ctSlotsNew = _ctSlots>0 ? _ctSlots*2 : ATOMS_PER_BLOCK;
+  ULONG *aulSlotsNew = (ULONG*)AllocMemory( ctSlotsNew*sizeof(ULONG));
+  memset( aulSlotsNew, 0, ctSlotsNew*sizeof(ULONG));
+  for( ULONG ulAtom=1; ulAtom<=_ctAtoms; ulAtom++) {
+    ULONG iSlot = GetEntry(ulAtom).fna_ulHash&(ctSlotsNew-1);
+    while( aulSlotsNew[iSlot]!=FNA_NONE) iSlot = (iSlot+1)&(ctSlotsNew-1);
+    aulSlotsNew[iSlot] = ulAtom;
+  }
+  if( _aulSlots!=NULL) FreeMemory(_aulSlots);
+  _aulSlots = aulSlotsNew;
+  _ctSlots  = ctSlotsNew;
+}
+
+
+// copy name to chunk memory
+static const char *StoreName(const char *strFileName, INDEX ctLength)
+{
+  const INDEX ctSize = ctLength+1;
+  // very long names get their own memory
+  if( ctSize>NAMECHUNK_SIZE/16) {
+    char *strName = (char*)AllocMemory(ctSize);
+    memcpy( strName, strFileName, ctSize);
+    _slNameMemory += ctSize;
+    return strName;
+  }
+  if( ctSize>_ctNameChunkFree) {
+    _pchNameChunk = (char*)AllocMemory(NAMECHUNK_SIZE);
+    _ctNameChunkFree = NAMECHUNK_SIZE;
+    _slNameMemory += NAMECHUNK_SIZE;
+  }
+  char *strName = _pchNameChunk;
+  memcpy( strName, strFileName, ctSize);
+  _pchNameChunk += ctSize;
+  _ctNameChunkFree -= ctSize;
+  return strName;
+}
+
+
+ULONG FNA_Hash(const char *strFileName)
+{
+  INDEX ctLength;
+  return HashName( strFileName, ctLength);
+}
+
+
+ULONG FNA_Intern(const char *strFileName)
+{
+  ASSERT( strFileName!=NULL);
+  INDEX ctLength;
+  const ULONG ulHash = HashName( strFileName, ctLength);
+
+  CTSingleLock slAtoms(&_csAtoms, TRUE);
+  _ctLookups++;
+  // keep the table at most half full, so that there is always an empty slot to stop at
+  if( (_ctAtoms+1)*2>_ctSlots) GrowSlots();
+
+  ULONG iSlot = ulHash&(_ctSlots-1);
+  FOREVER {
+    _ctProbes++;
+    const ULONG ulAtom = _aulSlots[iSlot];
+    if( ulAtom==FNA_NONE) break;
+    const FileNameAtom &fna = GetEntry(ulAtom);
+    if( fna.fna_ulHash==ulHash && fna.fna_ctLength==ctLength
+     && SameNames( fna.fna_strName, strFileName, ctLength)) {
+      return ulAtom;
+    }
+    iSlot = (iSlot+1)&(_ctSlots-1);
+  }
+
+  // add new atom
+  const ULONG iAtom = _ctAtoms;
+  if( iAtom>=MAX_ATOMBLOCKS*ATOMS_PER_BLOCK) {
+    FatalError( TRANS("Too many different file names (%d)!"), iAtom);
+  }
+  FileNameAtom *&pfnaBlock = _apfnaBlocks[iAtom/ATOMS_PER_BLOCK];
+  if( pfnaBlock==NULL) {
+    pfnaBlock = (FileNameAtom*)AllocMemory( ATOMS_PER_BLOCK*sizeof(FileNameAtom));
+  }
+  FileNameAtom &fna = pfnaBlock[iAtom%ATOMS_PER_BLOCK];
+  fna.fna_ulHash   = ulHash;
+  fna.fna_ctLength = ctLength;
+  fna.fna_strName  = StoreName( strFileName, ctLength);
+  _ctLookupsNew++;
+  _ctAtoms = iAtom+1;
+  _aulSlots[iSlot] = _ctAtoms;
+  return _ctAtoms;
+}
+
+
+ULONG FNA_GetHash(ULONG ulAtom)
+{
+  return GetEntry(ulAtom).fna_ulHash;
+}
+
+
+INDEX FNA_GetLength(ULONG ulAtom)
+{
+  return GetEntry(ulAtom).fna_ctLength;
+}
+
+
+const char *FNA_GetName(ULONG ulAtom)
+{
+  return GetEntry(ulAtom).fna_strName;
+}
+
+
+BOOL FNA_IsNameOf(ULONG ulAtom, const char *strFileName)
+{
+  // stored name has no zeros, so a shorter string stops at its terminator
+  const FileNameAtom &fna = GetEntry(ulAtom);
+  return SameNames( fna.fna_strName, strFileName, fna.fna_ctLength)
+      && strFileName[fna.fna_ctLength]==0;
+}
+
+
+void FNA_Report(CTString &strReport)
+{
+  CTSingleLock slAtoms(&_csAtoms, TRUE);
+  const SLONG slMemory = _slNameMemory + _ctSlots*sizeof(ULONG)
+                       + ((_ctAtoms+ATOMS_PER_BLOCK-1)/ATOMS_PER_BLOCK)*ATOMS_PER_BLOCK*sizeof(FileNameAtom);
+  strReport.PrintF( TRANS("%d file name atoms, %d slots, %.1fk memory\n"
+                          "%d lookups, %d of them new, %.2f probes per lookup\n"),
+    _ctAtoms, _ctSlots, slMemory/1024.0f,
+    _ctLookups, _ctLookupsNew, _ctLookups>0 ? FLOAT(_ctProbes)/_ctLookups : 0.0f);
+}
+
+
+// print stats of the atom table to console
+static void FileNameStats(void)
+{
+  CTString strReport;
+  FNA_Report(strReport);
+  CPrintF( "%s", (const char*)strReport);
+}
+
+
+void FNA_Init(void)
+{
+  _pShell->DeclareSymbol( "user void FileNameStats(void);", &FileNameStats);
+}
@@ -0,0 +1,49 @@
+/* Copyright (c) 2002-2012 Croteam Ltd.
+This program is free software; you can redistribute it and/or modify
+it under the terms of version 2 of the GNU General Public License as published by
+the Free Software Foundation
+
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA. */
+
+#ifndef SE_INCL_FILENAMEATOM_H
+#define SE_INCL_FILENAMEATOM_H
+#ifdef PRAGMA_ONCE
+  #pragma once
+#endif
+
+#include <Engine/Base/Types.h>
+
+// Interned file names: each distinct file name (ignoring case and kind of slashes)
+// gets a 32-bit atom with precomputed hash, so file names can be compared as integers.
+// Atoms are never freed, they stay valid until the engine is shut down.
+#define FNA_NONE 0
+
+// calculate hash of a file name, same as the one stored with its atom
+ENGINE_API extern ULONG FNA_Hash(const char *strFileName);
+// get atom of a file name, adding it to the table if not there yet
+ENGINE_API extern ULONG FNA_Intern(const char *strFileName);
+
+// get hash, length and name of an atom (as it was first interned)
+ENGINE_API extern ULONG FNA_GetHash(ULONG ulAtom);
+ENGINE_API extern INDEX FNA_GetLength(ULONG ulAtom);
+ENGINE_API extern const char *FNA_GetName(ULONG ulAtom);
+// check if atom is of given file name (ignoring case and kind of slashes)
+ENGINE_API extern BOOL FNA_IsNameOf(ULONG ulAtom, const char *strFileName);
+
+// report number of atoms, memory used and lookup counters
+ENGINE_API extern void FNA_Report(CTString &strReport);
+
+// declare console symbols
+extern void FNA_Init(void);
+
+
+#endif  /* include-once check. */
+
@@ -0,0 +1,173 @@
+/* Copyright (c) 2002-2012 Croteam Ltd.
+This program is free software; you can redistribute it and/or modify
+it under the terms of version 2 of the GNU General Public License as published by
+the Free Software Foundation
+
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA. */
+
+#include "StdH.h"
+
+#include <Engine/Base/JobPool.h>
+#include <Engine/Base/Shell.h>
+#include <Engine/Base/Console.h>
+#include <Engine/Base/Synchronization.h>
+#include <Engine/Base/Trace.h>
+#include <Engine/Base/MemoryPool.h>
+#include <Engine/Math/Functions.h>
+
+/*
+Simple pool of worker threads for batches of independent jobs.
+
+Jobs of a batch are claimed through an interlocked counter, so there is no queue
+and no allocation per batch. Calling thread works on the batch as well and then
+waits until the last job has finished. Only one batch runs at a time.
+*/
+
+#define MAX_JOBTHREADS 16
+
+// number of worker threads (-1 for one less than number of CPUs, 0 to run everything serially)
+INDEX sys_iJobThreads = -1;
+
+static HANDLE _ahThreads[MAX_JOBTHREADS];
+static INDEX  _ctThreads = 0;      // currently running worker threads
+static HANDLE _hWakeUp = NULL;     // semaphore for waking up workers
+static HANDLE _hBatchDone = NULL;  // set when last job of the batch is finished
+static BOOL   _bQuit = FALSE;
+
+// current batch
+static JobFunction *_pJobFunction = NULL;
+static void *_pvJobData = NULL;
+static LONG  _ctJobs = 0;
+static volatile LONG _iNextJob = MAX_SLONG/2; // no jobs to claim between batches
+static volatile LONG _ctJobsLeft = 0;
+
+// only one batch at a time
+static CTCriticalSection _csJobPool;
+// set for threads that currently execute jobs
+static _declspec(thread) BOOL _bInsideJob = FALSE;
+
+
+// execute jobs of current batch until none is left to claim
+static void ExecuteJobs(void)
+{
+  _bInsideJob = TRUE;
+  FOREVER {
+    const LONG iJob = InterlockedIncrement( (LONG*)&_iNextJob) -1;
+    if( iJob>=_ctJobs) break;
+    _pJobFunction( iJob, _pvJobData);
+    // last one finished?
+    if( InterlockedDecrement( (LONG*)&_ctJobsLeft)==0) SetEvent(_hBatchDone);
+  }
+  _bInsideJob = FALSE;
+}
+
+
+static DWORD WINAPI JobThread( LPVOID lpParameter)
+{
+  Trace_SetThreadName("Job worker");
+  FOREVER {
+    WaitForSingleObject( _hWakeUp, INFINITE);
+    if( _bQuit) break;
+    ExecuteJobs();
+  }
+  MemPool_ReleaseThreadCache();
+  return 0;
+}
+
+
+static void StopThreads(void)
+{
+  if( _ctThreads==0) return;
+  _bQuit = TRUE;
+  ReleaseSemaphore( _hWakeUp, _ctThreads, NULL);
+  WaitForMultipleObjects( _ctThreads, _ahThreads, TRUE, INFINITE);
+  for( INDEX iThread=0; iThread<_ctThreads; iThread++) CloseHandle( _ahThreads[iThread]);
+  _ctThreads = 0;
+  _bQuit = FALSE;
+}
+
+
+// make sure that wanted number of worker threads is running
+static void UpdateThreads(void)
+{
+  INDEX ctWanted = sys_iJobThreads;
+  if( ctWanted<0) {
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    ctWanted = si.dwNumberOfProcessors-1;
+  }
+  ctWanted = Clamp( ctWanted, 0L, (INDEX)MAX_JOBTHREADS);
+  if( ctWanted==_ctThreads) return;
+
+  StopThreads();
+  for( INDEX iThread=0; iThread<ctWanted; iThread++) {
+    DWORD dwThreadID;
+    _ahThreads[iThread] = CreateThread( NULL, 0, JobThread, NULL, 0, &dwThreadID);
+    if( _ahThreads[iThread]==NULL) break;
+    _ctThreads++;
+  }
+  CPrintF( TRANS("Job pool: %d worker threads\n"), _ctThreads);
+}
+
+
+void JobPool_Init(void)
+{
+  _hWakeUp    = CreateSemaphore( NULL, 0, MAX_SLONG, NULL);
+  _hBatchDone = CreateEvent( NULL, FALSE, FALSE, NULL);
+  _pShell->DeclareSymbol( "persistent user INDEX sys_iJobThreads;", &sys_iJobThreads);
+}
+
+
+void JobPool_End(void)
+{
+  StopThreads();
+  if( _hWakeUp   !=NULL) { CloseHandle(_hWakeUp);     _hWakeUp    = NULL; }
+  if( _hBatchDone!=NULL) { CloseHandle(_hBatchDone);  _hBatchDone = NULL; }
+}
+
+
+INDEX JobPool_GetThreadCount(void)
+{
+  return _ctThreads+1;
+}
+
+
+void JobPool_Run( INDEX ctJobs, JobFunction *pJobFunction, void *pvUserData)
+{
+  if( ctJobs<=0) return;
+  // nested batches or single jobs are not worth waking anyone up
+  if( _bInsideJob || ctJobs==1 || _hWakeUp==NULL) {
+    for( INDEX iJob=0; iJob<ctJobs; iJob++) pJobFunction( iJob, pvUserData);
+    return;
+  }
+
+  CTSingleLock slPool( &_csJobPool, TRUE);
+  UpdateThreads();
+  if( _ctThreads==0) {
+    for( INDEX iJob=0; iJob<ctJobs; iJob++) pJobFunction( iJob, pvUserData);
+    return;
+  }
+
+  // setup batch before opening job counter (late workers from previous batch may be spinning on it)
+  _pJobFunction = pJobFunction;
+  _pvJobData    = pvUserData;
+  _ctJobs       = ctJobs;
+  _ctJobsLeft   = ctJobs;
+  InterlockedExchange( (LONG*)&_iNextJob, 0);
+
+  // wake up workers and join them
+  ReleaseSemaphore( _hWakeUp, Min( _ctThreads, ctJobs-1), NULL);
+  ExecuteJobs();
+  WaitForSingleObject( _hBatchDone, INFINITE);
+
+  // close job counter
+  InterlockedExchange( (LONG*)&_iNextJob, MAX_SLONG/2);
+}
@@ -0,0 +1,40 @@
+/* Copyright (c) 2002-2012 Croteam Ltd.
+This program is free software; you can redistribute it and/or modify
+it under the terms of version 2 of the GNU General Public License as published by
+the Free Software Foundation
+
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA. */
+
+#ifndef SE_INCL_JOBPOOL_H
+#define SE_INCL_JOBPOOL_H
+#ifdef PRAGMA_ONCE
+  #pragma once
+#endif
+
+// function that executes one job of a batch
+// NOTE: jobs run on worker threads, so they must not touch any engine state that isn't
+// private to the job (stats, profilers, console, stocks...); growing arrays that belong
+// only to the job is fine, since memory allocation is thread-safe
+typedef void JobFunction( INDEX iJob, void *pvUserData);
+
+// initialize and shutdown job pool (worker threads are created on first use)
+extern void JobPool_Init(void);
+extern void JobPool_End(void);
+
+// run a batch of independent jobs and wait for all of them to finish;
+// calling thread executes jobs too, and nested batches are executed serially
+ENGINE_API extern void JobPool_Run( INDEX ctJobs, JobFunction *pJobFunction, void *pvUserData);
+// number of threads that execute jobs (including the calling one)
+ENGINE_API extern INDEX JobPool_GetThreadCount(void);
+
+
+#endif  /* include-once check. */
+
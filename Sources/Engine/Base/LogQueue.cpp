@@ -0,0 +1,752 @@
+/* Copyright (c) 2002-2012 Croteam Ltd.
+This program is free software; you can redistribute it and/or modify
+it under the terms of version 2 of the GNU General Public License as published by
+the Free Software Foundation
+
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA. */
+
+
+#include "StdH.h"
+
+#include <Engine/Base/LogQueue.h>
+#include <Engine/Base/Console.h>
+#include <Engine/Base/Console_internal.h>
+#include <Engine/Base/Shell.h>
+#include <Engine/Base/Stream.h>
+#include <Engine/Base/Timer.h>
+#include <Engine/Base/Memory.h>
+#include <Engine/Base/MemoryPool.h>
+#include <Engine/Base/Trace.h>
+#include <Engine/Base/Synchronization.h>
+#include <Engine/Math/Functions.h>
+
+/*
+Queued console output.
+
+Any thread can print without taking a lock: a line is put into a ring of records,
+and a writer thread appends it to the console buffer and the log file. Records are
+claimed by moving the head of the ring with one compare-exchange, and are marked
+ready when fully written; the writer consumes them in order of claiming and clears
+them again, so a record that is claimed but not yet written is never mistaken for
+a ready one. Records never wrap around the end of the ring, a padding record fills
+the gap instead.
+
+Formatting is deferred to the writer. The caller only walks the format string and
+copies the arguments (and contents of strings) into the record; the writer rebuilds
+the argument list and formats it. Formats that cannot be copied this way (wide
+strings, %n, too many arguments) are formatted by the caller.
+
+Every line is filtered by severity and rate of its channel before being queued.
+When the ring is full, general console output waits for the writer, while lines
+of other channels are dropped and counted.
+*/
+
+#define LOG_RINGSIZE   (1<<20)      // bytes in ring (must be power of 2)
+#define LOG_RINGMASK   (LOG_RINGSIZE-1)
+#define LOG_MAXRECORD  (16*1024)    // larger lines are printed synchronously
+#define LOG_MAXARGS    256          // bytes of copied arguments
+#define LOG_MAXSTRINGS 16           // string arguments per line
+
+#define LRF_READY   0x80000000UL    // record is written and can be consumed
+
+#define LRT_TEXT    0   // formatted text
+#define LRT_FORMAT  1   // format string with copied arguments
+#define LRT_PADDING 2   // skip to end of ring
+
+// write console output from a background thread
+INDEX con_bAsyncLog = TRUE;
+
+struct LogRecord {
+  volatile ULONG lr_ulSize;   // size including header, with LRF_READY when written
+  UBYTE lr_ubType;
+  UBYTE lr_ubChannel;
+  UBYTE lr_ctStrings;         // string arguments to relocate
+  UBYTE lr_ubDummy;
+  UWORD lr_ctArgBytes;        // size of copied arguments
+  UWORD lr_ctTextBytes;       // size of format string or text, with terminator
+  // followed by offsets of string arguments within copied arguments (UWORD each),
+  // copied arguments, format string or text and contents of string arguments
+};
+
+// arguments gathered from caller
+struct LogArgs {
+  UBYTE la_aubArgs[LOG_MAXARGS];
+  INDEX la_ctArgBytes;
+  UWORD la_aiStringArgs[LOG_MAXSTRINGS];   // offsets of string pointers in la_aubArgs
+  INDEX la_actStringBytes[LOG_MAXSTRINGS];
+  INDEX la_ctStrings;
+  INDEX la_ctAllStringBytes;
+};
+
+struct LogChannelState {
+  const char *lcs_strName;
+  INDEX lcs_iMinSeverity;       // lines below this severity are filtered out
+  INDEX lcs_ctMaxPerSecond;     // 0 for no limit
+  volatile ULONG lcs_ulSecond;  // second in which lines are counted
+  volatile LONG lcs_ctInSecond;
+  volatile LONG lcs_ctQueued;
+  volatile LONG lcs_ctFiltered;
+  volatile LONG lcs_ctRateLimited;
+  volatile LONG lcs_ctOverflowed; // dropped because ring was full
+};
+
+static LogChannelState _alcsChannels[LC_COUNT] = {
+  { "general",    LS_DEBUG, 0 },
+  { "network",    LS_DEBUG, 100 },
+  { "prediction", LS_DEBUG, 100 },
+  { "profiling",  LS_DEBUG, 0 },
+  { "test",       LS_DEBUG, 0 },
+};
+
+static const char *_astrSeverities[] = { "debug", "info", "warning", "error" };
+
+// ring state
+static UBYTE *_pubRing = NULL;
+static volatile ULONG _ulHead = 0;  // bytes claimed by producers
+static volatile ULONG _ulTail = 0;  // bytes consumed by writer
+
+// writer state
+static HANDLE _hWriter = NULL;
+static DWORD  _dwWriterID = 0;
+static HANDLE _hWakeUp = NULL;
+static volatile LONG _bWriterIdle = FALSE;
+static volatile BOOL _bQuit = FALSE;
+static char *_pchFormatted = NULL;  // writer's formatting buffer
+static INDEX _ctFormatted = 0;
+
+// lines of test channel go to this file instead of console, if open
+static FILE *_fTestSink = NULL;
+
+
+static inline BOOL IsQueueing(void)
+{
+  extern BOOL con_bCapture;
+  // captured output must be complete when the command returns, and the
+  // writer must not wait for itself
+  return _hWriter!=NULL && con_bAsyncLog && !con_bCapture && GetCurrentThreadId()!=_dwWriterID;
+}
+
+
+static inline void WakeWriter(void)
+{
+  if( _bWriterIdle && InterlockedExchange( &_bWriterIdle, FALSE)) SetEvent(_hWakeUp);
+}
+
+
+// claim space for a record, or return NULL if ring is full and caller shouldn't wait
+static LogRecord *ClaimRecord( ULONG ulSize, BOOL bWait)
+{
+  FOREVER {
+    const ULONG ulHead = _ulHead;
+    const ULONG ulOffset = ulHead&LOG_RINGMASK;
+    const ULONG ulPadding = (ulOffset+ulSize>LOG_RINGSIZE) ? LOG_RINGSIZE-ulOffset : 0;
+    const ULONG ulNewHead = ulHead+ulPadding+ulSize;
+    if( ulNewHead-_ulTail>LOG_RINGSIZE) {
+      if( !bWait) return NULL;
+      WakeWriter();
+      Sleep(0);
+      continue;
+    }
+    if( InterlockedCompareExchange( (LONG*)&_ulHead, ulNewHead, ulHead)!=(LONG)ulHead) continue;
+
+    if( ulPadding>0) {
+      LogRecord *plrPadding = (LogRecord*)(_pubRing+ulOffset);
+      plrPadding->lr_ubType = LRT_PADDING;
+      InterlockedExchange( (LONG*)&plrPadding->lr_ulSize, ulPadding|LRF_READY);
+    }
+    return (LogRecord*)(_pubRing+((ulHead+ulPadding)&LOG_RINGMASK));
+  }
+}
+
+
+// mark record as written
+static inline void CommitRecord( LogRecord *plr, ULONG ulSize)
+{
+  // interlocked exchange is a full barrier, so record contents are visible before it is
+  // marked ready, and idle flag is read only after that
+  InterlockedExchange( (LONG*)&plr->lr_ulSize, ulSize|LRF_READY);
+  // busy writer will get to it without being signaled
+  WakeWriter();
+}
+
+
+template<class Type>
+static inline BOOL PushArg( LogArgs &la, Type tArg)
+{
+  if( la.la_ctArgBytes+_INTSIZEOF(Type)>LOG_MAXARGS) return FALSE;
+  *(Type*)(la.la_aubArgs+la.la_ctArgBytes) = tArg;
+  la.la_ctArgBytes += _INTSIZEOF(Type);
+  return TRUE;
+}
+
+
+static inline BOOL PushString( LogArgs &la, const char *str)
+{
+  // NULL is passed on as is, so it is printed as by printf
+  if( str!=NULL) {
+    if( la.la_ctStrings>=LOG_MAXSTRINGS) return FALSE;
+    const INDEX ctBytes = strlen(str)+1;
+    la.la_aiStringArgs[la.la_ctStrings] = (UWORD)la.la_ctArgBytes;
+    la.la_actStringBytes[la.la_ctStrings] = ctBytes;
+    la.la_ctStrings++;
+    la.la_ctAllStringBytes += ctBytes;
+    if( la.la_ctAllStringBytes>LOG_MAXRECORD) return FALSE;
+  }
+  return PushArg( la, str);
+}
+
+
+// copy arguments used by a printf format; returns FALSE if format must be done by caller
+static BOOL GatherArgs( const char *strFormat, va_list arg, LogArgs &la)
+{
+  la.la_ctArgBytes = 0;
+  la.la_ctStrings  = 0;
+  la.la_ctAllStringBytes = 0;
+  if( strlen(strFormat)>=LOG_MAXRECORD) return FALSE;
+
+  for( const char *pch=strFormat; *pch!=0; pch++) {
+    if( *pch!='%') continue;
+    pch++;
+    if( *pch=='%') continue;
+    // flags
+    while( *pch=='-' || *pch=='+' || *pch==' ' || *pch=='#' || *pch=='0') pch++;
+    // width and precision
+    if( *pch=='*') {
+      if( !PushArg( la, va_arg(arg, int))) return FALSE;
+      pch++;
+    } else {
+      while( *pch>='0' && *pch<='9') pch++;
+    }
+    if( *pch=='.') {
+      pch++;
+      if( *pch=='*') {
+        if( !PushArg( la, va_arg(arg, int))) return FALSE;
+        pch++;
+      } else {
+        while( *pch>='0' && *pch<='9') pch++;
+      }
+    }
+    // size
+    BOOL b64 = FALSE;
+    BOOL bWide = FALSE;
+    if( pch[0]=='I' && pch[1]=='6' && pch[2]=='4') {
+      b64 = TRUE;  pch+=3;
+    } else if( pch[0]=='I' && pch[1]=='3' && pch[2]=='2') {
+      pch+=3;
+    } else if( pch[0]=='l' && pch[1]=='l') {
+      b64 = TRUE;  pch+=2;
+    } else if( *pch=='l' || *pch=='w') {
+      bWide = TRUE;  pch++;
+    } else {
+      while( *pch=='h' || *pch=='L') pch++;
+    }
+    // type
+    BOOL bOK;
+    switch( *pch) {
+    case 'c':
+      if( bWide) return FALSE;
+      bOK = PushArg( la, va_arg(arg, int));
+      break;
+    case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+      if( b64) bOK = PushArg( la, va_arg(arg, __int64));
+      else     bOK = PushArg( la, va_arg(arg, int));
+      break;
+    case 'e': case 'E': case 'f': case 'g': case 'G':
+      bOK = PushArg( la, va_arg(arg, double));
+      break;
+    case 'p':
+      bOK = PushArg( la, va_arg(arg, void*));
+      break;
+    case 's':
+      if( bWide) return FALSE;
+      bOK = PushString( la, va_arg(arg, const char*));
+      break;
+    default:
+      // %n, wide %S and %C, and malformed formats
+      return FALSE;
+    }
+    if( !bOK) return FALSE;
+  }
+  return TRUE;
+}
+
+
+// print right away, after everything queued before
+static void PrintNow( const char *strText)
+{
+  LogQueue_Flush();
+  if( _pConsole!=NULL) _pConsole->PutString(strText);
+}
+
+
+static BOOL QueueText( INDEX iChannel, const char *strText, BOOL bWait)
+{
+  const ULONG ctTextBytes = strlen(strText)+1;
+  const ULONG ulSize = (sizeof(LogRecord)+ctTextBytes+7)&~7;
+  LogRecord *plr = ClaimRecord( ulSize, bWait);
+  if( plr==NULL) return FALSE;
+  plr->lr_ubType = LRT_TEXT;
+  plr->lr_ubChannel = (UBYTE)iChannel;
+  plr->lr_ctStrings = 0;
+  plr->lr_ctArgBytes = 0;
+  plr->lr_ctTextBytes = (UWORD)ctTextBytes;
+  memcpy( plr+1, strText, ctTextBytes);
+  CommitRecord( plr, ulSize);
+  return TRUE;
+}
+
+
+static BOOL QueueFormat( INDEX iChannel, const char *strFormat, const LogArgs &la, BOOL bWait)
+{
+  const ULONG ctFormatBytes = strlen(strFormat)+1;
+  const ULONG ctOffsetBytes = (la.la_ctStrings*sizeof(UWORD)+3)&~3;
+  const ULONG ulSize = (sizeof(LogRecord)+ctOffsetBytes+la.la_ctArgBytes+ctFormatBytes+la.la_ctAllStringBytes+7)&~7;
+  LogRecord *plr = ClaimRecord( ulSize, bWait);
+  if( plr==NULL) return FALSE;
+  plr->lr_ubType = LRT_FORMAT;
+  plr->lr_ubChannel = (UBYTE)iChannel;
+  plr->lr_ctStrings = (UBYTE)la.la_ctStrings;
+  plr->lr_ctArgBytes = (UWORD)la.la_ctArgBytes;
+  plr->lr_ctTextBytes = (UWORD)ctFormatBytes;
+
+  UBYTE *pubRecord = (UBYTE*)plr;
+  UWORD *piStringArgs = (UWORD*)(plr+1);
+  UBYTE *pubArgs = (UBYTE*)piStringArgs+ctOffsetBytes;
+  char *pchText = (char*)pubArgs+la.la_ctArgBytes;
+  memcpy( piStringArgs, la.la_aiStringArgs, la.la_ctStrings*sizeof(UWORD));
+  memcpy( pubArgs, la.la_aubArgs, la.la_ctArgBytes);
+  memcpy( pchText, strFormat, ctFormatBytes);
+  // copy strings and store their offsets within record instead of pointers
+  char *pchString = pchText+ctFormatBytes;
+  for( INDEX iString=0; iString<la.la_ctStrings; iString++) {
+    const char **pstrArg = (const char**)(pubArgs+la.la_aiStringArgs[iString]);
+    memcpy( pchString, *pstrArg, la.la_actStringBytes[iString]);
+    *(ULONG*)pstrArg = pchString-(char*)pubRecord;
+    pchString += la.la_actStringBytes[iString];
+  }
+  CommitRecord( plr, ulSize);
+  return TRUE;
+}
+
+
+// check channel filters; returns FALSE if line is to be dropped
+static BOOL PassFilters( INDEX iChannel, INDEX iSeverity)
+{
+  LogChannelState &lcs = _alcsChannels[iChannel];
+  if( iSeverity<lcs.lcs_iMinSeverity) {
+    InterlockedIncrement( &lcs.lcs_ctFiltered);
+    return FALSE;
+  }
+  if( lcs.lcs_ctMaxPerSecond<=0) return TRUE;
+
+  // first line in a new second restarts counting
+  const ULONG ulSecond = GetTickCount()/1000;
+  const ULONG ulCounted = lcs.lcs_ulSecond;
+  if( ulSecond!=ulCounted
+   && InterlockedCompareExchange( (LONG*)&lcs.lcs_ulSecond, ulSecond, ulCounted)==(LONG)ulCounted) {
+    const INDEX ctOver = InterlockedExchange( &lcs.lcs_ctInSecond, 0)-lcs.lcs_ctMaxPerSecond;
+    if( ctOver>0) {
+      CTString strSuppressed(0, TRANS("<%d lines of channel '%s' suppressed>\n"), ctOver, lcs.lcs_strName);
+      if( IsQueueing()) QueueText( iChannel, strSuppressed, FALSE);
+      else PrintNow(strSuppressed);
+    }
+  }
+  if( InterlockedIncrement( &lcs.lcs_ctInSecond)>lcs.lcs_ctMaxPerSecond) {
+    InterlockedIncrement( &lcs.lcs_ctRateLimited);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+
+void LogQueue_VPrint(INDEX iChannel, INDEX iSeverity, const char *strFormat, va_list arg)
+{
+  if( _pConsole==NULL) return;
+  iChannel = Clamp( iChannel, 0L, (INDEX)LC_COUNT-1);
+  if( !PassFilters( iChannel, iSeverity)) return;
+  LogChannelState &lcs = _alcsChannels[iChannel];
+
+  if( IsQueueing()) {
+    const BOOL bWait = iChannel==LC_GENERAL;
+    LogArgs la;
+    BOOL bQueued;
+    if( GatherArgs( strFormat, arg, la)) {
+      bQueued = QueueFormat( iChannel, strFormat, la, bWait);
+    } else {
+      // format here if the writer can't
+      char achLine[1024];
+      const INDEX iLen = _vsnprintf( achLine, sizeof(achLine), strFormat, arg);
+      if( iLen<0 || iLen>=(INDEX)sizeof(achLine)) {
+        CTString strLine;
+        strLine.VPrintF( strFormat, arg);
+        if( strlen(strLine)>=LOG_MAXRECORD) {
+          PrintNow(strLine);
+          return;
+        }
+        bQueued = QueueText( iChannel, strLine, bWait);
+      } else {
+        bQueued = QueueText( iChannel, achLine, bWait);
+      }
+    }
+    InterlockedIncrement( bQueued ? &lcs.lcs_ctQueued : &lcs.lcs_ctOverflowed);
+    return;
+  }
+
+  CTString strLine;
+  strLine.VPrintF( strFormat, arg);
+  PrintNow(strLine);
+}
+
+
+void LogQueue_Put(INDEX iChannel, INDEX iSeverity, const char *strText)
+{
+  if( _pConsole==NULL) return;
+  iChannel = Clamp( iChannel, 0L, (INDEX)LC_COUNT-1);
+  if( !PassFilters( iChannel, iSeverity)) return;
+  if( IsQueueing() && strlen(strText)<LOG_MAXRECORD) {
+    const BOOL bQueued = QueueText( iChannel, strText, iChannel==LC_GENERAL);
+    InterlockedIncrement( bQueued ? &_alcsChannels[iChannel].lcs_ctQueued : &_alcsChannels[iChannel].lcs_ctOverflowed);
+    return;
+  }
+  PrintNow(strText);
+}
+
+
+// format a record on writer side
+static const char *FormatRecord( const LogRecord &lr)
+{
+  const char *pchText = (const char*)(&lr+1);
+  if( lr.lr_ubType==LRT_TEXT) return pchText;
+
+  // rebuild argument list with pointers to strings in the record
+  const UWORD *piStringArgs = (const UWORD*)(&lr+1);
+  const UBYTE *pubArgs = (const UBYTE*)piStringArgs+((lr.lr_ctStrings*sizeof(UWORD)+3)&~3);
+  const char *strFormat = (const char*)pubArgs+lr.lr_ctArgBytes;
+  UBYTE aubArgs[LOG_MAXARGS];
+  memcpy( aubArgs, pubArgs, lr.lr_ctArgBytes);
+  for( INDEX iString=0; iString<lr.lr_ctStrings; iString++) {
+    ULONG *pulArg = (ULONG*)(aubArgs+piStringArgs[iString]);
+    *(const char**)pulArg = (const char*)&lr + *pulArg;
+  }
+
+  FOREVER {
+    const INDEX iLen = _ctFormatted>0 ? _vsnprintf( _pchFormatted, _ctFormatted, strFormat, (va_list)aubArgs) : -1;
+    if( iLen>=0 && iLen<_ctFormatted) break;
+    _ctFormatted = Max( _ctFormatted*2, 1024L);
+    if( _pchFormatted!=NULL) FreeMemory(_pchFormatted);
+    _pchFormatted = (char*)AllocMemory(_ctFormatted);
+  }
+  return _pchFormatted;
+}
+
+
+// write all ready records; returns number of records written
+static INDEX WriteRecords(void)
+{
+  INDEX ctWritten = 0;
+  BOOL bTestSink = FALSE;
+  ULONG ulTail = _ulTail;
+  while( ulTail!=_ulHead) {
+    LogRecord *plr = (LogRecord*)(_pubRing+(ulTail&LOG_RINGMASK));
+    ULONG ulSize = plr->lr_ulSize;
+    // stop at a record that is still being written
+    if( !(ulSize&LRF_READY)) break;
+    ulSize &= ~LRF_READY;
+
+    if( plr->lr_ubType!=LRT_PADDING) {
+      const char *strLine = FormatRecord(*plr);
+      if( plr->lr_ubChannel==LC_TEST) {
+        if( _fTestSink!=NULL) {
+          fputs( strLine, _fTestSink);
+          bTestSink = TRUE;
+        }
+      } else {
+        _pConsole->WriteString( strLine, FALSE);
+      }
+      ctWritten++;
+    }
+    // clear record so it doesn't look ready when the space is claimed again
+    memset( plr, 0, ulSize);
+    ulTail += ulSize;
+    _ulTail = ulTail;
+  }
+  if( ctWritten>0) {
+    _pConsole->FlushLog();
+    if( bTestSink) fflush(_fTestSink);
+  }
+  return ctWritten;
+}
+
+
+static DWORD WINAPI WriterThread( LPVOID lpParameter)
+{
+  Trace_SetThreadName("Log writer");
+  FOREVER {
+    if( WriteRecords()>0) continue;
+    if( _bQuit) break;
+    // announce waiting before checking once more, so no wake up is missed
+    InterlockedExchange( &_bWriterIdle, TRUE);
+    if( WriteRecords()==0) {
+      WaitForSingleObject( _hWakeUp, 50);
+    }
+    InterlockedExchange( &_bWriterIdle, FALSE);
+  }
+  MemPool_ReleaseThreadCache();
+  return 0;
+}
+
+
+void LogQueue_Flush(void)
+{
+  if( _hWriter==NULL || GetCurrentThreadId()==_dwWriterID) return;
+  const ULONG ulHead = _ulHead;
+  const DWORD dwStart = GetTickCount();
+  while( (LONG)(_ulTail-ulHead)<0) {
+    InterlockedExchange( &_bWriterIdle, FALSE);
+    SetEvent(_hWakeUp);
+    Sleep(0);
+    // don't hang if writer is gone (e.g. when called while crashing)
+    if( GetTickCount()-dwStart>2000) break;
+  }
+}
+
+
+void LogQueue_Report(CTString &strReport)
+{
+  strReport += CTString(0, TRANS("Console log is %s, %dk of %dk queued\n"),
+    _hWriter==NULL ? TRANS("synchronous") : (con_bAsyncLog ? TRANS("queued") : TRANS("synchronous (con_bAsyncLog=0)")),
+    (_ulHead-_ulTail)/1024, LOG_RINGSIZE/1024);
+  strReport += TRANS("  # channel     min.severity  lines/s    queued  filtered  limited   dropped\n");
+  for( INDEX iChannel=0; iChannel<LC_COUNT; iChannel++) {
+    const LogChannelState &lcs = _alcsChannels[iChannel];
+    strReport += CTString(0, "  %d %-12s %-12s %7d %9d %9d %8d %9d\n", iChannel, lcs.lcs_strName,
+      _astrSeverities[Clamp( lcs.lcs_iMinSeverity, 0L, 3L)], lcs.lcs_ctMaxPerSecond,
+      lcs.lcs_ctQueued, lcs.lcs_ctFiltered, lcs.lcs_ctRateLimited, lcs.lcs_ctOverflowed);
+  }
+}
+
+
+// list log channels: LogChannels()
+static void LogChannels(void)
+{
+  CTString strReport;
+  LogQueue_Report(strReport);
+  CPutString(strReport);
+}
+
+
+// set channel filters: LogFilter(1, 2, 50) lets through only 50 warnings and errors per second of network
+static void LogFilter(void *pArgs)
+{
+  const INDEX iChannel     = NEXTARGUMENT(INDEX);
+  const INDEX iMinSeverity = NEXTARGUMENT(INDEX);
+  const INDEX ctPerSecond  = NEXTARGUMENT(INDEX);
+  if( iChannel<0 || iChannel>=LC_COUNT) {
+    CPrintF( TRANS("Invalid log channel %d, see LogChannels().\n"), iChannel);
+    return;
+  }
+  LogChannelState &lcs = _alcsChannels[iChannel];
+  lcs.lcs_iMinSeverity   = Clamp( iMinSeverity, (INDEX)LS_DEBUG, (INDEX)LS_ERROR);
+  lcs.lcs_ctMaxPerSecond = ClampDn( ctPerSecond, 0L);
+  CPrintF( TRANS("Log channel '%s': %s and above, %d lines per second\n"), lcs.lcs_strName,
+    _astrSeverities[lcs.lcs_iMinSeverity], lcs.lcs_ctMaxPerSecond);
+}
+
+
+// stress test: threads print lines as fast as they can, and each call is timed
+#define STRESS_BUCKETS 40   // power of 2 buckets of nanoseconds
+
+struct StressThread {
+  INDEX st_iThread;
+  INDEX st_ctLines;
+  BOOL  st_bQueued;
+  __int64 st_llMax;
+  ULONG st_actBuckets[STRESS_BUCKETS];
+};
+
+static CTCriticalSection _csStressSync;
+static DOUBLE _dStressToNanoseconds = 0;
+
+
+// same work as unqueued console output: format, then write and flush file under a lock
+static void StressPrintSync(const char *strFormat, ...)
+{
+  va_list arg;
+  va_start(arg, strFormat);
+  char achLine[256];
+  _vsnprintf( achLine, sizeof(achLine)-1, strFormat, arg);
+  achLine[sizeof(achLine)-1] = 0;
+  CTSingleLock slSync(&_csStressSync, TRUE);
+  fputs( achLine, _fTestSink);
+  fflush(_fTestSink);
+}
+
+
+static DWORD WINAPI StressThreadFunc( LPVOID lpParameter)
+{
+  StressThread &st = *(StressThread*)lpParameter;
+  const char *strName = "stress";
+  for( INDEX iLine=0; iLine<st.st_ctLines; iLine++) {
+    const __int64 llStart = _pTimer->GetHighPrecisionTimer().tv_llValue;
+    if( st.st_bQueued) {
+      CLogF( LC_TEST, LS_INFO, "%s thread %d line %d value %g\n", strName, st.st_iThread, iLine, iLine*0.5);
+    } else {
+      StressPrintSync( "%s thread %d line %d value %g\n", strName, st.st_iThread, iLine, iLine*0.5);
+    }
+    const __int64 llTime = _pTimer->GetHighPrecisionTimer().tv_llValue-llStart;
+    const __int64 llNanoseconds = (__int64)(llTime*_dStressToNanoseconds);
+    INDEX iBucket = 0;
+    while( iBucket<STRESS_BUCKETS-1 && (__int64(2)<<iBucket)<=llNanoseconds) iBucket++;
+    st.st_actBuckets[iBucket]++;
+    st.st_llMax = Max( st.st_llMax, llTime);
+  }
+  MemPool_ReleaseThreadCache();
+  return 0;
+}
+
+
+// upper bound of latency below which given fraction of calls finished
+static DOUBLE StressPercentile( const ULONG *pctBuckets, ULONG ctAll, DOUBLE dFraction)
+{
+  ULONG ctSoFar = 0;
+  for( INDEX iBucket=0; iBucket<STRESS_BUCKETS; iBucket++) {
+    ctSoFar += pctBuckets[iBucket];
+    if( ctSoFar>=ctAll*dFraction) return (DOUBLE)(__int64(2)<<iBucket)/1000.0;
+  }
+  return 0;
+}
+
+
+static void StressRun( INDEX ctThreads, INDEX ctLines, BOOL bQueued, CTString &strReport)
+{
+  StressThread ast[32];
+  HANDLE ahThreads[32];
+  memset( ast, 0, sizeof(ast));
+  const LONG ctOverflowed = _alcsChannels[LC_TEST].lcs_ctOverflowed;
+
+  const CTimerValue tvStart = _pTimer->GetHighPrecisionTimer();
+  INDEX ctStarted = 0;
+  for( ; ctStarted<ctThreads; ctStarted++) {
+    ast[ctStarted].st_iThread = ctStarted;
+    ast[ctStarted].st_ctLines = ctLines/ctThreads;
+    ast[ctStarted].st_bQueued = bQueued;
+    DWORD dwThreadID;
+    ahThreads[ctStarted] = CreateThread( NULL, 0, StressThreadFunc, &ast[ctStarted], 0, &dwThreadID);
+    if( ahThreads[ctStarted]==NULL) break;
+  }
+  if( ctStarted>0) WaitForMultipleObjects( ctStarted, ahThreads, TRUE, INFINITE);
+  const CTimerValue tvCallers = _pTimer->GetHighPrecisionTimer();
+  if( bQueued) LogQueue_Flush();
+  const CTimerValue tvWritten = _pTimer->GetHighPrecisionTimer();
+  for( INDEX iThread=0; iThread<ctStarted; iThread++) CloseHandle(ahThreads[iThread]);
+
+  // merge latencies of all threads
+  ULONG actBuckets[STRESS_BUCKETS];
+  memset( actBuckets, 0, sizeof(actBuckets));
+  __int64 llMax = 0;
+  ULONG ctAll = 0;
+  for( INDEX iThread=0; iThread<ctStarted; iThread++) {
+    for( INDEX iBucket=0; iBucket<STRESS_BUCKETS; iBucket++) {
+      actBuckets[iBucket] += ast[iThread].st_actBuckets[iBucket];
+      ctAll += ast[iThread].st_actBuckets[iBucket];
+    }
+    llMax = Max( llMax, ast[iThread].st_llMax);
+  }
+  const DOUBLE dCallers = (tvCallers-tvStart).GetSeconds();
+  strReport += CTString(0, TRANS("  %s: %d lines in %.3f s (%.0f lines/s), written after %.3f s\n"),
+    bQueued ? TRANS("queued") : TRANS("synchronous"), ctAll, dCallers, ctAll/Max( dCallers, 1E-6),
+    (tvWritten-tvStart).GetSeconds());
+  strReport += CTString(0, TRANS("    caller latency: 50%% <%.2f us, 99%% <%.2f us, 99.9%% <%.2f us, max %.2f us\n"),
+    StressPercentile( actBuckets, ctAll, 0.5), StressPercentile( actBuckets, ctAll, 0.99),
+    StressPercentile( actBuckets, ctAll, 0.999), llMax*_dStressToNanoseconds/1000.0);
+  if( bQueued) {
+    strReport += CTString(0, TRANS("    dropped on full ring: %d\n"), _alcsChannels[LC_TEST].lcs_ctOverflowed-ctOverflowed);
+  }
+}
+
+
+// compare synchronous and queued output: LogStressTest(8, 1000000)
+static void LogStressTest(void *pArgs)
+{
+  INDEX ctThreads = NEXTARGUMENT(INDEX);
+  INDEX ctLines   = NEXTARGUMENT(INDEX);
+  if( ctThreads<=0) ctThreads = 8;
+  if( ctLines<=0) ctLines = 1000000;
+  ctThreads = Clamp( ctThreads, 1L, 32L);
+  if( _hWriter==NULL || !con_bAsyncLog) {
+    CPrintF( TRANS("Log writer is not running (con_bAsyncLog=0), cannot test queued output.\n"));
+    return;
+  }
+  const CTFileName fnmSink = CTString("Temp\\LogStressTest.log");
+  _fTestSink = fopen( _fnmApplicationPath+fnmSink, "wt");
+  if( _fTestSink==NULL) {
+    CPrintF( TRANS("Cannot create '%s': %s\n"), (const char*)fnmSink, strerror(errno));
+    return;
+  }
+  _dStressToNanoseconds = 1E9/_pTimer->tm_llPerformanceCounterFrequency;
+
+  CTString strReport(0, TRANS("Log stress test: %d threads, %d lines, written to '%s'\n"),
+    ctThreads, ctLines, (const char*)fnmSink);
+  StressRun( ctThreads, ctLines, FALSE, strReport);
+  StressRun( ctThreads, ctLines, TRUE,  strReport);
+
+  LogQueue_Flush();
+  fclose(_fTestSink);
+  _fTestSink = NULL;
+  CPutString(strReport);
+}
+
+
+void LogQueue_Init(void)
+{
+  _pShell->DeclareSymbol( "persistent user INDEX con_bAsyncLog;", &con_bAsyncLog);
+  _pShell->DeclareSymbol( "user void LogChannels(void);", &LogChannels);
+  _pShell->DeclareSymbol( "user void LogFilter(INDEX, INDEX, INDEX);", &LogFilter);
+  _pShell->DeclareSymbol( "user void LogStressTest(INDEX, INDEX);", &LogStressTest);
+
+  _pubRing = (UBYTE*)AllocMemory(LOG_RINGSIZE);
+  memset( _pubRing, 0, LOG_RINGSIZE);
+  _ulHead = 0;
+  _ulTail = 0;
+  _bQuit = FALSE;
+  _hWakeUp = CreateEvent( NULL, FALSE, FALSE, NULL);
+  _hWriter = CreateThread( NULL, 0, WriterThread, NULL, 0, &_dwWriterID);
+  if( _hWriter==NULL) {
+    CPrintF( TRANS("Cannot start log writer, console output is synchronous.\n"));
+  }
+}
+
+
+void LogQueue_End(void)
+{
+  if( _hWriter!=NULL) {
+    LogQueue_Flush();
+    _bQuit = TRUE;
+    SetEvent(_hWakeUp);
+    WaitForSingleObject( _hWriter, INFINITE);
+    CloseHandle(_hWriter);
+    _hWriter = NULL;
+    _dwWriterID = 0;
+  }
+  if( _hWakeUp!=NULL) {
+    CloseHandle(_hWakeUp);
+    _hWakeUp = NULL;
+  }
+  if( _pubRing!=NULL) {
+    FreeMemory(_pubRing);
+    _pubRing = NULL;
+  }
+  if( _pchFormatted!=NULL) {
+    FreeMemory(_pchFormatted);
+    _pchFormatted = NULL;
+    _ctFormatted = 0;
+  }
+}
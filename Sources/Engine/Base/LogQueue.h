@@ -0,0 +1,44 @@
+/* Copyright (c) 2002-2012 Croteam Ltd.
+This program is free software; you can redistribute it and/or modify
+it under the terms of version 2 of the GNU General Public License as published by
+the Free Software Foundation
+
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA. */
+
+
+#ifndef SE_INCL_LOGQUEUE_H
+#define SE_INCL_LOGQUEUE_H
+#ifdef PRAGMA_ONCE
+  #pragma once
+#endif
+
+#include <Engine/Base/Console.h>
+
+// set to write console output from a background thread
+ENGINE_API extern INDEX con_bAsyncLog;
+
+// start and stop the background log writer (console output is synchronous while it is stopped)
+extern void LogQueue_Init(void);
+extern void LogQueue_End(void);
+
+// queue a line for the writer, or print it right away if it cannot be queued
+extern void LogQueue_VPrint(INDEX iChannel, INDEX iSeverity, const char *strFormat, va_list arg);
+extern void LogQueue_Put(INDEX iChannel, INDEX iSeverity, const char *strText);
+
+// wait until everything queued so far is written to console and log file
+ENGINE_API extern void LogQueue_Flush(void);
+
+// list channels with their filters and counters
+ENGINE_API extern void LogQueue_Report(CTString &strReport);
+
+
+#endif  /* include-once check. */
+
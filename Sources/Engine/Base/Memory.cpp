@@ -16,6 +16,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "stdh.h"
 
 #include <Engine/Base/Memory.h>
+#include <Engine/Base/MemoryPool.h>
 #include <Engine/Base/Translation.h>
 
 #include <Engine/Base/ErrorReporting.h>
@@ -71,18 +72,29 @@ CMemHandlerInit::CMemHandlerInit(void)
 #undef AllocMemory
 
 void *AllocMemory( SLONG memsize )
+{
+  return AllocMemoryTagged( memsize, MemPool_GetThreadTag());
+}
+
+void *AllocMemoryTagged( SLONG memsize, INDEX iTag)
 {
   void *pmem;
   ASSERTMSG(memsize>0, "AllocMemory: Block size is less or equal zero.");
   if (_bCheckAllAllocations) {
     _CrtCheckMemory();
   }
+  // small blocks come from the pool
+  pmem = MemPool_Alloc( memsize, iTag);
+  if (pmem!=NULL) {
+    return pmem;
+  }
   pmem = malloc( memsize);
   // memory handler asures no null results here?!
   if (pmem==NULL) {
     _CrtCheckMemory();
     FatalError(TRANS("Not enough memory (%d bytes needed)!"), memsize);
   }
+  MemPool_AddLarge(pmem);
   return pmem;
 }
 
@@ -101,6 +113,7 @@ void *_debug_AllocMemory( SLONG memsize, int iType, const char *strFile, int iLi
     _CrtCheckMemory();
     FatalError(TRANS("Not enough memory (%d bytes needed)!"), memsize);
   }
+  MemPool_AddLarge(pmem);
   return pmem;
 }
 #endif
@@ -120,6 +133,10 @@ void FreeMemoryAligned( void *memory)
 void FreeMemory( void *memory )
 {
   ASSERTMSG(memory!=NULL, "FreeMemory: NULL pointer input.");
+  if (MemPool_Free(memory)) {
+    return;
+  }
+  MemPool_RemoveLarge(memory);
   free( (char *)memory);
 }
 
@@ -128,15 +145,58 @@ void ResizeMemory( void **ppv, SLONG slSize )
   if (_bCheckAllAllocations) {
     _CrtCheckMemory();
   }
+  // if it is a pool block
+  INDEX iTag;
+  const SLONG slOldSize = (*ppv!=NULL) ? MemPool_GetSize(*ppv, iTag) : -1;
+  if (slOldSize>=0) {
+    // keep it if new size still fits
+    if (slSize<=slOldSize) {
+      return;
+    }
+    // otherwise move it to a bigger block of same tag
+    void *pv = AllocMemoryTagged(slSize, iTag);
+    memcpy(pv, *ppv, slOldSize);
+    MemPool_Free(*ppv);
+    *ppv = pv;
+    return;
+  }
+
+  if (*ppv!=NULL) {
+    MemPool_RemoveLarge(*ppv);
+  }
   void *pv = realloc(*ppv, slSize);
   // memory handler asures no null results here?!
   if (pv==NULL) {
     _CrtCheckMemory();
     FatalError(TRANS("Not enough memory (%d bytes needed)!"), slSize);
   }
+  MemPool_AddLarge(pv);
   *ppv = pv;
 }
 
+#if MEMORY_POOLED_NEW && defined(NDEBUG)
+void *operator new( size_t size)
+{
+  return AllocMemory( size>0 ? size : 1);
+}
+void *operator new[]( size_t size)
+{
+  return AllocMemory( size>0 ? size : 1);
+}
+void operator delete( void *memory)
+{
+  if (memory!=NULL) {
+    FreeMemory(memory);
+  }
+}
+void operator delete[]( void *memory)
+{
+  if (memory!=NULL) {
+    FreeMemory(memory);
+  }
+}
+#endif
+
 void GrowMemory( void **ppv, SLONG newSize )
 {
   ResizeMemory(ppv, newSize);
@@ -155,7 +215,7 @@ char *StringDuplicate(const char *strOriginal) {
   // get the size
   SLONG slSize = strlen(strOriginal)+1;
   // allocate that much memory
-  char *strCopy = (char *)AllocMemory(slSize);
+  char *strCopy = (char *)AllocMemoryTagged(slSize, MT_STRINGS);
   // copy it there
   memcpy(strCopy, strOriginal, slSize);
   // result is the pointer to the copied string
@@ -28,6 +28,8 @@ ENGINE_API extern SLONG GetFreeMemory( void );
 
 /* Allocate a block of memory - fatal error if not enough memory. */
 ENGINE_API extern void *AllocMemory( SLONG memsize );
+// allocate and account to given subsystem (see MemoryPool.h)
+ENGINE_API extern void *AllocMemoryTagged( SLONG memsize, INDEX iTag);
 ENGINE_API extern void *_debug_AllocMemory( SLONG memsize, int iType, const char *strFile, int iLine);
 ENGINE_API extern void *AllocMemoryAligned( SLONG memsize, SLONG slAlignPow2);
 /* Free a block of memory. */
@@ -47,6 +49,11 @@ ENGINE_API extern BOOL AllMemoryFreed( void );
 // return position (offset) where we encounter zero byte or iBytes
 ENGINE_API extern INDEX FindZero( UBYTE *pubMemory, INDEX iBytes);
 
+// set to route global operator new/delete of the engine through AllocMemory() in release builds
+// NOTE: then any other module that deletes objects that engine has created with 'new' must
+// do the same, because it would free pool blocks on CRT heap otherwise; so it is off by default
+#define MEMORY_POOLED_NEW 0
+
 
 #ifdef _MSC_VER  /* rcg10042001 */
 #ifndef NDEBUG
@@ -0,0 +1,549 @@
+/* Copyright (c) 2002-2012 Croteam Ltd.
+This program is free software; you can redistribute it and/or modify
+it under the terms of version 2 of the GNU General Public License as published by
+the Free Software Foundation
+
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA. */
+
+#include "StdH.h"
+
+#include <Engine/Base/MemoryPool.h>
+#include <Engine/Base/Memory.h>
+#include <Engine/Base/Shell.h>
+#include <Engine/Base/Console.h>
+#include <Engine/Base/Timer.h>
+#include <Engine/Base/JobPool.h>
+#include <Engine/Math/Functions.h>
+#include <psapi.h>
+#include <malloc.h>
+
+// benchmark goes through the pool in debug builds as well
+#undef AllocMemory
+
+/*
+Thread-caching pool for small allocations.
+
+Pool reserves one range of address space and commits it in spans. Each span holds
+blocks of one size class for one tag, so a block needs no header: its span tells its
+size and tag, and a pointer is known to be from the pool just by its address.
+Every thread keeps free lists of its own, and moves blocks from and to the central
+free lists in batches, so most allocations and frees take no lock at all.
+Spans are never given back to the system; free blocks in them are counted as
+fragmentation. Pool may be turned off at any time, since blocks are freed by address.
+
+Statistics are kept per thread as well, and summed only when reported, so a block
+freed by another thread leaves counters of one thread negative, but totals are right.
+*/
+
+#define POOL_RESERVE   (128*1024*1024)
+#define SPAN_SIZE      (16*1024)
+#define MAX_SPANS      (POOL_RESERVE/SPAN_SIZE)
+#define MAX_POOLSIZE   512
+#define CLASS_COUNT    16
+#define MAX_CACHES     64
+
+// serve small allocations from the pool
+INDEX mem_bPool = TRUE;
+
+static const SLONG _aslClassSizes[CLASS_COUNT] = {
+  16, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 448, 512 };
+static UBYTE _aubSizeToClass[MAX_POOLSIZE/16+1];
+
+static const char *_astrTagNames[MT_COUNT] = {
+  "general", "strings", "containers", "network", "entities", "world", "resources", "rendering" };
+
+struct SpanInfo {
+  UBYTE si_iClass;
+  UBYTE si_iTag;
+};
+
+struct FreeList {
+  void *fl_pvHead;    // next block pointer is stored in first bytes of each free block
+  INDEX fl_ctBlocks;
+};
+
+struct ThreadCache {
+  FreeList tc_aflLists[MT_COUNT][CLASS_COUNT];
+  SLONG tc_aslBytes[MT_COUNT];   // bytes allocated minus freed by this thread
+  SLONG tc_actBlocks[MT_COUNT];  // blocks allocated minus freed by this thread
+  ULONG tc_ctAllocs;             // total allocations by this thread
+  BOOL  tc_bFree;                // thread has exited, cache can be taken by another one
+};
+
+// reserved address space; set last, since allocations check it without the lock
+static UBYTE * volatile _pubPool = NULL;
+static BOOL _bPoolFailed = FALSE; // could not reserve, everything goes to CRT heap
+static INDEX _ctSpans = 0;        // spans committed so far
+static SpanInfo _asiSpans[MAX_SPANS];
+static FreeList _aflCentral[MT_COUNT][CLASS_COUNT];
+
+static ThreadCache *_aptcCaches[MAX_CACHES];
+static INDEX _ctCaches = 0;
+static ThreadCache _tcShared;     // stats of threads without own cache (used under lock)
+
+// lock for central lists and cache registry; spin lock, since it must work before
+// any constructors are called and is held only for a few instructions
+static LONG _lPoolLock = 0;
+
+// large blocks (from CRT heap)
+static LONG _slLargeBytes = 0;
+static LONG _ctLargeBlocks = 0;
+static SLONG _slPeakBytes = 0;    // peak of committed spans plus large blocks
+
+static _declspec(thread) ThreadCache *_ptcThread = NULL;
+static _declspec(thread) BOOL _bNoCache = FALSE;
+static _declspec(thread) INDEX _iThreadTag = MT_GENERAL;
+
+// allocation counters at last report, for rates
+static ULONG _ctAllocsLast = 0;
+static __int64 _llLastReport = 0;
+
+
+static inline void LockPool(void)
+{
+  while( InterlockedExchange( &_lPoolLock, 1)!=0) Sleep(0);
+}
+
+static inline void UnlockPool(void)
+{
+  InterlockedExchange( &_lPoolLock, 0);
+}
+
+
+// reserve address space on first use (pool lock must be held)
+static BOOL InitPool_locked(void)
+{
+  if( _pubPool!=NULL) return TRUE;
+  if( _bPoolFailed) return FALSE;
+  UBYTE *pubPool = (UBYTE*)VirtualAlloc( NULL, POOL_RESERVE, MEM_RESERVE, PAGE_READWRITE);
+  if( pubPool==NULL) {
+    _bPoolFailed = TRUE;
+    return FALSE;
+  }
+  INDEX iClass = 0;
+  for( INDEX iSize=0; iSize<=MAX_POOLSIZE/16; iSize++) {
+    while( _aslClassSizes[iClass]<iSize*16) iClass++;
+    _aubSizeToClass[iSize] = iClass;
+  }
+  // publish the pool only when the size table is filled (interlocked write is a full barrier)
+  InterlockedExchange( (LONG volatile*)&_pubPool, (LONG)pubPool);
+  return TRUE;
+}
+
+
+static inline INDEX BatchSize( INDEX iClass)
+{
+  return Clamp( 4096/_aslClassSizes[iClass], 4L, 64L);
+}
+
+
+static inline void UpdatePeak(void)
+{
+  const SLONG slBytes = _ctSpans*SPAN_SIZE + _slLargeBytes;
+  if( slBytes>_slPeakBytes) _slPeakBytes = slBytes;
+}
+
+
+// commit a new span and put all its blocks to central list (pool lock must be held)
+static BOOL NewSpan_locked( INDEX iTag, INDEX iClass)
+{
+  if( _ctSpans>=MAX_SPANS) return FALSE;
+  UBYTE *pubSpan = _pubPool + _ctSpans*SPAN_SIZE;
+  if( VirtualAlloc( pubSpan, SPAN_SIZE, MEM_COMMIT, PAGE_READWRITE)==NULL) return FALSE;
+  _asiSpans[_ctSpans].si_iClass = iClass;
+  _asiSpans[_ctSpans].si_iTag   = iTag;
+  _ctSpans++;
+  UpdatePeak();
+
+  FreeList &fl = _aflCentral[iTag][iClass];
+  const SLONG slSize = _aslClassSizes[iClass];
+  const INDEX ctBlocks = SPAN_SIZE/slSize;
+  for( INDEX iBlock=ctBlocks-1; iBlock>=0; iBlock--) {
+    void *pvBlock = pubSpan + iBlock*slSize;
+    *(void**)pvBlock = fl.fl_pvHead;
+    fl.fl_pvHead = pvBlock;
+  }
+  fl.fl_ctBlocks += ctBlocks;
+  return TRUE;
+}
+
+
+// move up to given number of blocks from one list to another
+static void MoveBlocks( FreeList &flFrom, FreeList &flTo, INDEX ctBlocks)
+{
+  while( ctBlocks>0 && flFrom.fl_pvHead!=NULL) {
+    void *pvBlock = flFrom.fl_pvHead;
+    flFrom.fl_pvHead = *(void**)pvBlock;
+    *(void**)pvBlock = flTo.fl_pvHead;
+    flTo.fl_pvHead = pvBlock;
+    flFrom.fl_ctBlocks--;
+    flTo.fl_ctBlocks++;
+    ctBlocks--;
+  }
+}
+
+
+// get cache of calling thread (NULL if all caches are taken)
+static ThreadCache *GetThreadCache(void)
+{
+  if( _ptcThread!=NULL || _bNoCache) return _ptcThread;
+
+  LockPool();
+  // reuse cache of an exited thread if any
+  ThreadCache *ptc = NULL;
+  for( INDEX iCache=0; iCache<_ctCaches; iCache++) {
+    if( _aptcCaches[iCache]->tc_bFree) {
+      ptc = _aptcCaches[iCache];
+      ptc->tc_bFree = FALSE;
+      break;
+    }
+  }
+  // create a new one
+  if( ptc==NULL && _ctCaches<MAX_CACHES) {
+    // (can't come from the pool itself)
+    ptc = (ThreadCache*)VirtualAlloc( NULL, sizeof(ThreadCache), MEM_COMMIT, PAGE_READWRITE);
+    if( ptc!=NULL) {
+      memset( ptc, 0, sizeof(ThreadCache));
+      _aptcCaches[_ctCaches] = ptc;
+      _ctCaches++;
+    }
+  }
+  UnlockPool();
+
+  if( ptc==NULL) _bNoCache = TRUE;
+  _ptcThread = ptc;
+  return ptc;
+}
+
+
+void *MemPool_Alloc( SLONG slSize, INDEX iTag)
+{
+  if( !mem_bPool || slSize>MAX_POOLSIZE || slSize<=0) return NULL;
+  ASSERT( iTag>=0 && iTag<MT_COUNT);
+  if( _pubPool==NULL) {
+    LockPool();
+    BOOL bReady = InitPool_locked();
+    UnlockPool();
+    if( !bReady) return NULL;
+  }
+  const INDEX iClass = _aubSizeToClass[(slSize+15)>>4];
+  const SLONG slClassSize = _aslClassSizes[iClass];
+
+  ThreadCache *ptc = GetThreadCache();
+  // thread without cache allocates directly from central list
+  if( ptc==NULL) {
+    LockPool();
+    FreeList &fl = _aflCentral[iTag][iClass];
+    if( fl.fl_pvHead==NULL && !NewSpan_locked( iTag, iClass)) {
+      UnlockPool();
+      return NULL;
+    }
+    void *pvBlock = fl.fl_pvHead;
+    fl.fl_pvHead = *(void**)pvBlock;
+    fl.fl_ctBlocks--;
+    _tcShared.tc_aslBytes[iTag] += slClassSize;
+    _tcShared.tc_actBlocks[iTag]++;
+    _tcShared.tc_ctAllocs++;
+    UnlockPool();
+    return pvBlock;
+  }
+
+  FreeList &fl = ptc->tc_aflLists[iTag][iClass];
+  // if no cached blocks, get a batch from central list
+  if( fl.fl_pvHead==NULL) {
+    LockPool();
+    FreeList &flCentral = _aflCentral[iTag][iClass];
+    if( flCentral.fl_pvHead==NULL) NewSpan_locked( iTag, iClass);
+    MoveBlocks( flCentral, fl, BatchSize(iClass));
+    UnlockPool();
+    // pool is exhausted
+    if( fl.fl_pvHead==NULL) return NULL;
+  }
+  void *pvBlock = fl.fl_pvHead;
+  fl.fl_pvHead = *(void**)pvBlock;
+  fl.fl_ctBlocks--;
+  ptc->tc_aslBytes[iTag] += slClassSize;
+  ptc->tc_actBlocks[iTag]++;
+  ptc->tc_ctAllocs++;
+  return pvBlock;
+}
+
+
+static inline INDEX SpanOf( void *pvMemory)
+{
+  const ULONG ulOffset = (UBYTE*)pvMemory-_pubPool;
+  if( _pubPool==NULL || ulOffset>=POOL_RESERVE) return -1;
+  return ulOffset/SPAN_SIZE;
+}
+
+
+BOOL MemPool_Free( void *pvMemory)
+{
+  const INDEX iSpan = SpanOf(pvMemory);
+  if( iSpan<0) return FALSE;
+  ASSERT( iSpan<_ctSpans);
+  const INDEX iTag   = _asiSpans[iSpan].si_iTag;
+  const INDEX iClass = _asiSpans[iSpan].si_iClass;
+  const SLONG slClassSize = _aslClassSizes[iClass];
+
+  ThreadCache *ptc = GetThreadCache();
+  if( ptc==NULL) {
+    LockPool();
+    FreeList &fl = _aflCentral[iTag][iClass];
+    *(void**)pvMemory = fl.fl_pvHead;
+    fl.fl_pvHead = pvMemory;
+    fl.fl_ctBlocks++;
+    _tcShared.tc_aslBytes[iTag] -= slClassSize;
+    _tcShared.tc_actBlocks[iTag]--;
+    UnlockPool();
+    return TRUE;
+  }
+
+  FreeList &fl = ptc->tc_aflLists[iTag][iClass];
+  *(void**)pvMemory = fl.fl_pvHead;
+  fl.fl_pvHead = pvMemory;
+  fl.fl_ctBlocks++;
+  ptc->tc_aslBytes[iTag] -= slClassSize;
+  ptc->tc_actBlocks[iTag]--;
+  // if too many blocks cached, give a batch back to central list
+  const INDEX ctBatch = BatchSize(iClass);
+  if( fl.fl_ctBlocks>ctBatch*2) {
+    LockPool();
+    MoveBlocks( fl, _aflCentral[iTag][iClass], ctBatch);
+    UnlockPool();
+  }
+  return TRUE;
+}
+
+
+SLONG MemPool_GetSize( void *pvMemory, INDEX &iTag)
+{
+  const INDEX iSpan = SpanOf(pvMemory);
+  if( iSpan<0) return -1;
+  iTag = _asiSpans[iSpan].si_iTag;
+  return _aslClassSizes[_asiSpans[iSpan].si_iClass];
+}
+
+
+void MemPool_AddLarge( void *pvMemory)
+{
+  InterlockedExchangeAdd( &_slLargeBytes, _msize(pvMemory));
+  InterlockedIncrement( &_ctLargeBlocks);
+  UpdatePeak();
+}
+
+
+void MemPool_RemoveLarge( void *pvMemory)
+{
+  InterlockedExchangeAdd( &_slLargeBytes, -(LONG)_msize(pvMemory));
+  InterlockedDecrement( &_ctLargeBlocks);
+}
+
+
+INDEX MemPool_SetThreadTag( INDEX iTag)
+{
+  ASSERT( iTag>=0 && iTag<MT_COUNT);
+  const INDEX iOldTag = _iThreadTag;
+  _iThreadTag = iTag;
+  return iOldTag;
+}
+
+
+INDEX MemPool_GetThreadTag(void)
+{
+  return _iThreadTag;
+}
+
+
+void MemPool_ReleaseThreadCache(void)
+{
+  ThreadCache *ptc = _ptcThread;
+  if( ptc==NULL) return;
+  LockPool();
+  for( INDEX iTag=0; iTag<MT_COUNT; iTag++) {
+    for( INDEX iClass=0; iClass<CLASS_COUNT; iClass++) {
+      FreeList &fl = ptc->tc_aflLists[iTag][iClass];
+      MoveBlocks( fl, _aflCentral[iTag][iClass], fl.fl_ctBlocks);
+    }
+  }
+  // counters stay in the cache, so that totals remain right
+  ptc->tc_bFree = TRUE;
+  UnlockPool();
+  _ptcThread = NULL;
+}
+
+
+// working set of this process in bytes (0 if not available)
+static SLONG GetWorkingSet(void)
+{
+  typedef BOOL WINAPI GetProcessMemoryInfo_t(HANDLE, PROCESS_MEMORY_COUNTERS*, DWORD);
+  static GetProcessMemoryInfo_t *pGetProcessMemoryInfo = NULL;
+  if( pGetProcessMemoryInfo==NULL) {
+    HMODULE hPSAPI = LoadLibraryA("psapi.dll");
+    if( hPSAPI==NULL) return 0;
+    pGetProcessMemoryInfo = (GetProcessMemoryInfo_t*)GetProcAddress( hPSAPI, "GetProcessMemoryInfo");
+    if( pGetProcessMemoryInfo==NULL) return 0;
+  }
+  PROCESS_MEMORY_COUNTERS pmc;
+  if( !pGetProcessMemoryInfo( GetCurrentProcess(), &pmc, sizeof(pmc))) return 0;
+  return pmc.WorkingSetSize;
+}
+
+
+void MemPool_Report( CTString &strReport)
+{
+  // sum counters of all threads
+  SLONG aslBytes[MT_COUNT];
+  SLONG actBlocks[MT_COUNT];
+  ULONG ctAllocs = 0;
+  LockPool();
+  for( INDEX iTag=0; iTag<MT_COUNT; iTag++) {
+    aslBytes[iTag]  = _tcShared.tc_aslBytes[iTag];
+    actBlocks[iTag] = _tcShared.tc_actBlocks[iTag];
+  }
+  ctAllocs = _tcShared.tc_ctAllocs;
+  for( INDEX iCache=0; iCache<_ctCaches; iCache++) {
+    const ThreadCache &tc = *_aptcCaches[iCache];
+    for( INDEX iTag=0; iTag<MT_COUNT; iTag++) {
+      aslBytes[iTag]  += tc.tc_aslBytes[iTag];
+      actBlocks[iTag] += tc.tc_actBlocks[iTag];
+    }
+    ctAllocs += tc.tc_ctAllocs;
+  }
+  const SLONG slCommitted = _ctSpans*SPAN_SIZE;
+  const INDEX ctCaches = _ctCaches;
+  UnlockPool();
+
+  const FLOAT fMB = 1.0f/(1024*1024);
+  SLONG slUsed = 0;
+  strReport.PrintF( TRANS("Small block pool (%s):\n"), mem_bPool ? TRANS("on") : TRANS("off"));
+  for( INDEX iTag=0; iTag<MT_COUNT; iTag++) {
+    strReport += CTString( 0, "  %-12s %8.2fMB in %7d blocks\n",
+      _astrTagNames[iTag], aslBytes[iTag]*fMB, actBlocks[iTag]);
+    slUsed += aslBytes[iTag];
+  }
+  const FLOAT fFragmentation = slCommitted>0 ? 100.0f*(slCommitted-slUsed)/slCommitted : 0.0f;
+  strReport += CTString( 0, TRANS("  used %.2fMB of %.2fMB committed (%.1f%% free in spans), %d thread caches\n"),
+    slUsed*fMB, slCommitted*fMB, fFragmentation, ctCaches);
+  strReport += CTString( 0, TRANS("Large blocks: %.2fMB in %d blocks\n"), _slLargeBytes*fMB, _ctLargeBlocks);
+  strReport += CTString( 0, TRANS("Peak (pool + large): %.2fMB, working set: %.2fMB\n"),
+    _slPeakBytes*fMB, GetWorkingSet()*fMB);
+
+  // allocation rate since last report
+  const __int64 llNow = _pTimer->GetHighPrecisionTimer().tv_llValue;
+  if( _llLastReport!=0) {
+    const DOUBLE dSeconds = DOUBLE(llNow-_llLastReport)/_pTimer->tm_llPerformanceCounterFrequency;
+    strReport += CTString( 0, TRANS("Pool allocations: %u, %.0f per second since last report\n"),
+      ctAllocs, (ctAllocs-_ctAllocsLast)/Max( dSeconds, 0.001));
+  } else {
+    strReport += CTString( 0, TRANS("Pool allocations: %u\n"), ctAllocs);
+  }
+  _ctAllocsLast = ctAllocs;
+  _llLastReport = llNow;
+}
+
+
+// synthetic allocation pattern of loading a level and playing it
+struct BenchmarkJob {
+  ULONG bj_ctOps;
+};
+
+static inline SLONG RandomSize( ULONG &ulSeed)
+{
+  ulSeed = ulSeed*1103515245+12345;
+  const ULONG ulRnd = ulSeed>>8;
+  // mostly strings and small objects, some messages and arrays, few big blocks
+  switch( ulRnd%10) {
+  case 0: case 1: case 2: case 3: case 4: case 5: return 8 + (ulRnd>>4)%56;
+  case 6: case 7: case 8: return 64 + (ulRnd>>4)%448;
+  default: return 512 + (ulRnd>>4)%3584;
+  }
+}
+
+#define BENCH_KEPT 20000
+#define BENCH_OPS  200000
+
+static void MemoryBenchmarkJob( INDEX iJob, void *pvUserData)
+{
+  BenchmarkJob &bj = ((BenchmarkJob*)pvUserData)[iJob];
+  ULONG ulSeed = iJob*7919+1;
+  ULONG ctOps = 0;
+  void **apvKept = (void**)VirtualAlloc( NULL, BENCH_KEPT*sizeof(void*), MEM_COMMIT, PAGE_READWRITE);
+  if( apvKept==NULL) return;
+
+  // load: objects that live through the level
+  {for( INDEX i=0; i<BENCH_KEPT; i++) {
+    apvKept[i] = AllocMemory( RandomSize(ulSeed));
+    ctOps++;
+  }}
+  // play: replace some of them, use temporaries and grow buffers
+  {for( INDEX i=0; i<BENCH_OPS; i++) {
+    const INDEX iKept = (ulSeed>>8)%BENCH_KEPT;
+    FreeMemory( apvKept[iKept]);
+    apvKept[iKept] = AllocMemory( RandomSize(ulSeed));
+    void *pvTemp = AllocMemory( RandomSize(ulSeed));
+    GrowMemory( &pvTemp, RandomSize(ulSeed)+64);
+    FreeMemory( pvTemp);
+    ctOps += 5;
+  }}
+  // unload
+  {for( INDEX i=0; i<BENCH_KEPT; i++) {
+    FreeMemory( apvKept[i]);
+    ctOps++;
+  }}
+  VirtualFree( apvKept, 0, MEM_RELEASE);
+  bj.bj_ctOps = ctOps;
+}
+
+
+// run one pass of the benchmark, return operations per second
+static DOUBLE RunBenchmark( INDEX ctJobs, SLONG &slWorkingSetDelta)
+{
+  BenchmarkJob abjJobs[MAX_CACHES];
+  memset( abjJobs, 0, sizeof(abjJobs));
+  const SLONG slWorkingSetBefore = GetWorkingSet();
+  CTimerValue tvStart = _pTimer->GetHighPrecisionTimer();
+  JobPool_Run( ctJobs, MemoryBenchmarkJob, abjJobs);
+  const DOUBLE dSeconds = (_pTimer->GetHighPrecisionTimer()-tvStart).GetSeconds();
+  slWorkingSetDelta = GetWorkingSet()-slWorkingSetBefore;
+  ULONG ctOps = 0;
+  for( INDEX iJob=0; iJob<ctJobs; iJob++) ctOps += abjJobs[iJob].bj_ctOps;
+  return ctOps/Max( dSeconds, 0.000001);
+}
+
+
+// compare CRT heap and pool on same allocation pattern: MemoryBenchmark(4)
+static void MemoryBenchmark( void *pArgs)
+{
+  INDEX ctJobs = NEXTARGUMENT(INDEX);
+  if( ctJobs<=0) ctJobs = JobPool_GetThreadCount();
+  ctJobs = Clamp( ctJobs, 1L, (INDEX)MAX_CACHES);
+  const INDEX bOldPool = mem_bPool;
+  const FLOAT fMB = 1.0f/(1024*1024);
+
+  SLONG slWorkingSetCRT, slWorkingSetPool;
+  mem_bPool = FALSE;
+  const DOUBLE dCRT = RunBenchmark( ctJobs, slWorkingSetCRT);
+  mem_bPool = TRUE;
+  const DOUBLE dPool = RunBenchmark( ctJobs, slWorkingSetPool);
+  mem_bPool = bOldPool;
+
+  CPrintF( TRANS("Load and play pattern, %d jobs on %d threads:\n"), ctJobs, JobPool_GetThreadCount());
+  CPrintF( TRANS("  CRT heap: %6.2fM ops/s, working set %+.2fMB\n"), dCRT/1E6, slWorkingSetCRT*fMB);
+  CPrintF( TRANS("  pool:     %6.2fM ops/s, working set %+.2fMB\n"), dPool/1E6, slWorkingSetPool*fMB);
+}
+
+
+void MemPool_Init(void)
+{
+  _pShell->DeclareSymbol( "user INDEX mem_bPool;", &mem_bPool);
+  _pShell->DeclareSymbol( "user void MemoryBenchmark(INDEX);", &MemoryBenchmark);
+}
@@ -0,0 +1,75 @@
+/* Copyright (c) 2002-2012 Croteam Ltd.
+This program is free software; you can redistribute it and/or modify
+it under the terms of version 2 of the GNU General Public License as published by
+the Free Software Foundation
+
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA. */
+
+#ifndef SE_INCL_MEMORYPOOL_H
+#define SE_INCL_MEMORYPOOL_H
+#ifdef PRAGMA_ONCE
+  #pragma once
+#endif
+
+#include <Engine/Base/Types.h>
+
+// subsystems that memory is accounted to
+enum MemoryTag {
+  MT_GENERAL = 0,
+  MT_STRINGS,
+  MT_CONTAINERS,
+  MT_NETWORK,
+  MT_ENTITIES,
+  MT_WORLD,
+  MT_RESOURCES,
+  MT_RENDERING,
+  MT_COUNT,
+};
+
+// set to serve small allocations from the pool
+ENGINE_API extern INDEX mem_bPool;
+
+// allocate a small block from the pool (returns NULL if too big for the pool or pool is off)
+ENGINE_API extern void *MemPool_Alloc( SLONG slSize, INDEX iTag);
+// free a block if it is from the pool (returns FALSE if it is not)
+ENGINE_API extern BOOL MemPool_Free( void *pvMemory);
+// get usable size and tag of a pool block (returns -1 if not from the pool)
+ENGINE_API extern SLONG MemPool_GetSize( void *pvMemory, INDEX &iTag);
+
+// account large blocks that are not from the pool
+extern void MemPool_AddLarge( void *pvMemory);
+extern void MemPool_RemoveLarge( void *pvMemory);
+
+// set tag for allocations of calling thread (returns previous one)
+ENGINE_API extern INDEX MemPool_SetThreadTag( INDEX iTag);
+ENGINE_API extern INDEX MemPool_GetThreadTag(void);
+// return blocks cached by calling thread to the pool (call before a thread exits)
+ENGINE_API extern void MemPool_ReleaseThreadCache(void);
+
+// report memory used by tags, peak and fragmentation
+ENGINE_API extern void MemPool_Report( CTString &strReport);
+
+// declare console symbols
+extern void MemPool_Init(void);
+
+// accounts allocations of the scope it is declared in to given tag
+class CMemoryTagScope {
+public:
+  INDEX mts_iOldTag;
+  inline CMemoryTagScope( INDEX iTag) { mts_iOldTag = MemPool_SetThreadTag(iTag); };
+  inline ~CMemoryTagScope(void) { MemPool_SetThreadTag(mts_iOldTag); };
+};
+
+#define MEMORY_TAG_SCOPE(tag) CMemoryTagScope _mtsScope(tag)
+
+
+#endif  /* include-once check. */
+
@@ -24,6 +24,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <Engine/Base/CTString.h>
 #include <Engine/Base/Timer.h>
 #include <Engine/Base/Timer.inl>
+#include <Engine/Base/Trace.h>
 
 #include <Engine/Templates/StaticArray.h>
 
@@ -121,11 +122,13 @@ public:
 #if TIMER_PROFILING
   /* Start a timer. */
   inline void StartTimer(INDEX iTimer) {
+    if( dbg_bTrace) Trace_BeginEvent( pf_aptTimers[iTimer].pt_strName, pf_strTitle);
     StartTimer_internal(iTimer);
   };
   /* Stop a timer. */
   inline void StopTimer(INDEX iTimer) {
     StopTimer_internal(iTimer);
+    if( dbg_bTrace) Trace_EndEvent( pf_aptTimers[iTimer].pt_strName);
   };
   /* Increment averaging counter for a timer by given count. */
   inline void IncrementTimerAveragingCounter(INDEX iTimer, INDEX ctAdd=1) {
@@ -146,13 +149,20 @@ public:
   #define SETTIMERNAME(a,b,c) SetTimerName_internal(a,b,c)
 
 #else //TIMER_PROFILING
-  inline void StartTimer(INDEX iTimer) {};
-  inline void StopTimer(INDEX iTimer) {};
+  // timers still feed the tracer, so they keep their names
+  inline void StartTimer(INDEX iTimer) {
+    if( dbg_bTrace) Trace_BeginEvent( pf_aptTimers[iTimer].pt_strName, pf_strTitle);
+  };
+  inline void StopTimer(INDEX iTimer) {
+    if( dbg_bTrace) Trace_EndEvent( pf_aptTimers[iTimer].pt_strName);
+  };
   inline void IncrementTimerAveragingCounter(INDEX iTimer, INDEX ctAdd=1) {};
   inline void SetCounterName_internal(INDEX iCounter, const CTString &strName) {};
-  inline void SetTimerName_internal(INDEX iTimer, const CTString &strName, const CTString &strAveragingName) {};
+  inline void SetTimerName_internal(INDEX iTimer, const CTString &strName, const CTString &strAveragingName) {
+    pf_aptTimers[iTimer].pt_strName = strName;
+  };
   #define SETCOUNTERNAME(a,b) SetCounterName_internal(a,"")
-  #define SETTIMERNAME(a,b,c) SetTimerName_internal(a,"","")
+  #define SETTIMERNAME(a,b,c) SetTimerName_internal(a,b,"")
 #endif
 
   /* Get current value of a timer in seconds or in percentage of module time. */
@@ -52,10 +52,10 @@ void CallProgressHook_t(FLOAT fCompleted)
     if ((tvNow-tvLastUpdate) > CTimerValue(net_fSendRetryWait*1.1)) {
 		  if (_pNetwork->ga_IsServer) {
         // handle server messages
-        _cmiComm.Server_Update();
+        _pcmiComm->Server_Update();
 		  } else {
 			  // handle client messages
-			  _cmiComm.Client_Update();
+			  _pcmiComm->Client_Update();
 		  }
       tvLastUpdate = _pTimer->GetHighPrecisionTimer();
     }    
@@ -926,8 +926,14 @@ void ReadSoundObject_t(CTStream &strm, CSoundObject &so)
 
 void SkipSoundObject_t(CTStream &strm)
 {
-  CSoundObject soDummy;
-  soDummy.Read_t(&strm);
+  // skip fields in same order as CSoundObject::Read_t(), but don't start playing the sound
+  CTFileName fnDummy;
+  SLONG aslDummy[12];
+  SWORD aswDummy[2];
+  strm>>fnDummy;
+  strm.Read_t(aslDummy, 12*sizeof(SLONG));  // flags, parameters, delay and last volumes
+  strm.Read_t(aswDummy, 2*sizeof(SWORD));   // last samples
+  strm.Read_t(aslDummy, 7*sizeof(SLONG));   // offsets and 3D parameters
 }
 
 void WriteSoundObject_t(CTStream &strm, CSoundObject &so)
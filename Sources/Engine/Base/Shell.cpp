@@ -22,6 +22,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <Engine/Templates/DynamicStackArray.h>
 #include <Engine/Base/Console.h>
 #include <Engine/Base/Stream.h>
+#include <Engine/Base/MemoryPool.h>
 
 #include <Engine/Templates/AllocationArray.cpp>
 #include <Engine/Templates/DynamicArray.cpp>
@@ -258,6 +259,10 @@ static void MemoryInfo(void)
    }
    CPrintF( "Total used: %d bytes (%.2f MB) in %d blocks\n", slTotalUsed, slTotalUsed/1024.0f/1024.0f, ctUsed);
    CPrintF( "Total free: %d bytes (%.2f MB) in %d blocks\n", slTotalFree, slTotalFree/1024.0f/1024.0f, ctFree);
+
+   CTString strPool;
+   MemPool_Report(strPool);
+   CPrintF( "\n%s", (const char*)strPool);
 }
 
 // get help for a shell symbol
@@ -719,6 +719,8 @@ void CTStream::ReadDictionary_intenal_t(SLONG slOffset)
     for(INDEX iFileName=ctFileNamesOld; iFileName<ctFileNamesOld+ctFileNamesNew; iFileName++) {
       // read it
       *this>>strm_afnmDictionary[iFileName];
+      // intern it here once, so that all file names read from dictionary carry the atom
+      strm_afnmDictionary[iFileName].GetAtom();
     }
   }
   ExpectID_t("DEND");  // dictionary end
@@ -0,0 +1,365 @@
+/* Copyright (c) 2002-2012 Croteam Ltd.
+This program is free software; you can redistribute it and/or modify
+it under the terms of version 2 of the GNU General Public License as published by
+the Free Software Foundation
+
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA. */
+
+#include "StdH.h"
+
+#include <Engine/Base/TickScheduler.h>
+#include <Engine/Base/Timer.h>
+#include <Engine/Base/Console.h>
+#include <Engine/Base/Trace.h>
+#include <Engine/Base/MemoryPool.h>
+#include <Engine/Base/Translation.h>
+#include <Engine/Math/Functions.h>
+
+/*
+Precise tick scheduler.
+
+The multimedia timer fires ticks with the OS timer granularity, so ticks drift
+and jitter by a millisecond or more. The scheduler runs timer handlers from its
+own thread instead, at deadlines computed from a monotonic clock (QPC). Each
+deadline is one tick period after the previous deadline, not after the previous
+wake-up, so lateness never accumulates. To hit a deadline, the thread sleeps on
+a (high resolution if available) waitable timer until shortly before it, and
+spins for the rest. How long it spins is learned from how much sleeps overshoot.
+*/
+
+#define LATENESS_BUCKETS 9
+// upper limits of lateness histogram buckets in milliseconds (last bucket is open)
+static const DOUBLE _adBucketLimits[LATENESS_BUCKETS-1] = { 0.05, 0.1, 0.25, 0.5, 1.0, 2.0, 5.0, 10.0 };
+
+// ticks that are run back to back when late, before ticks start being skipped
+#define MAX_CATCHUP 2
+
+// bounds for spinning before a deadline
+#define MIN_SPIN_MS 0.1
+#define MAX_SPIN_MS 4.0
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+typedef HANDLE WINAPI CreateWaitableTimerExW_t(LPSECURITY_ATTRIBUTES, LPCWSTR, DWORD, DWORD);
+
+
+static __int64 _llFrequency = 0;
+
+static inline __int64 ReadClock(void)
+{
+  LARGE_INTEGER li;
+  QueryPerformanceCounter(&li);
+  return li.QuadPart;
+}
+
+static void InitClock(void)
+{
+  if( _llFrequency!=0) return;
+  LARGE_INTEGER li;
+  QueryPerformanceFrequency(&li);
+  _llFrequency = li.QuadPart;
+}
+
+
+// histogram of how late ticks were handled
+struct TickStats {
+  INDEX ts_actBuckets[LATENESS_BUCKETS];
+  INDEX ts_ctTicks;
+  INDEX ts_ctSkipped;
+  DOUBLE ts_dSumMS;
+  DOUBLE ts_dMaxMS;
+
+  void Clear(void) {
+    for( INDEX i=0; i<LATENESS_BUCKETS; i++) ts_actBuckets[i] = 0;
+    ts_ctTicks = 0;
+    ts_ctSkipped = 0;
+    ts_dSumMS = 0;
+    ts_dMaxMS = 0;
+  };
+
+  void Add(DOUBLE dLateMS) {
+    INDEX iBucket = 0;
+    while( iBucket<LATENESS_BUCKETS-1 && dLateMS>=_adBucketLimits[iBucket]) iBucket++;
+    ts_actBuckets[iBucket]++;
+    ts_ctTicks++;
+    ts_dSumMS += dLateMS;
+    ts_dMaxMS = Max( ts_dMaxMS, dLateMS);
+  };
+
+  void Report(CTString &strReport, const char *strTitle) {
+    strReport += CTString(0, "%s: %d ticks, %d skipped, %.3f ms late on average, %.3f ms max\n",
+      strTitle, ts_ctTicks, ts_ctSkipped, ts_ctTicks>0 ? ts_dSumMS/ts_ctTicks : 0.0, ts_dMaxMS);
+    const INDEX ctTicks = ClampDn( ts_ctTicks, 1L);
+    for( INDEX i=0; i<LATENESS_BUCKETS; i++) {
+      if( i<LATENESS_BUCKETS-1) {
+        strReport += CTString(0, "  < %5.2f ms: %6d (%5.1f%%)\n", _adBucketLimits[i], ts_actBuckets[i], ts_actBuckets[i]*100.0/ctTicks);
+      } else {
+        strReport += CTString(0, "  >=%5.2f ms: %6d (%5.1f%%)\n", _adBucketLimits[i-1], ts_actBuckets[i], ts_actBuckets[i]*100.0/ctTicks);
+      }
+    }
+  };
+};
+
+
+// sleeps until shortly before a deadline and spins the rest
+class CPreciseWait {
+public:
+  HANDLE pw_hTimer;       // waitable timer (NULL to use Sleep())
+  __int64 pw_llSpin;      // how long before deadline to start spinning
+  BOOL pw_bSpin;          // spinning can be turned off to compare with plain sleep
+
+  void Init(BOOL bSpin) {
+    InitClock();
+    pw_bSpin = bSpin;
+    pw_llSpin = (__int64)(_llFrequency*MAX_SPIN_MS/1000);
+    pw_hTimer = NULL;
+    // high resolution timers wake up close to the deadline, where available
+    CreateWaitableTimerExW_t *pCreateEx = (CreateWaitableTimerExW_t*)
+      GetProcAddress( GetModuleHandleA("kernel32.dll"), "CreateWaitableTimerExW");
+    if( pCreateEx!=NULL) {
+      pw_hTimer = pCreateEx( NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    }
+    if( pw_hTimer==NULL) pw_hTimer = CreateWaitableTimer( NULL, TRUE, NULL);
+  };
+
+  void End(void) {
+    if( pw_hTimer!=NULL) CloseHandle(pw_hTimer);
+    pw_hTimer = NULL;
+  };
+
+  void Sleep_internal(__int64 llSleep) {
+    if( pw_hTimer!=NULL) {
+      // waitable timers take relative time in negative 100ns units
+      LARGE_INTEGER liDue;
+      liDue.QuadPart = -(llSleep*10000000/_llFrequency);
+      if( SetWaitableTimer( pw_hTimer, &liDue, 0, NULL, NULL, FALSE)) {
+        WaitForSingleObject( pw_hTimer, INFINITE);
+        return;
+      }
+    }
+    Sleep( (DWORD)(llSleep*1000/_llFrequency));
+  };
+
+  void WaitUntil(__int64 llDue) {
+    // plain sleep, like the old frame limiter
+    if( !pw_bSpin) {
+      const __int64 llLeft = llDue-ReadClock();
+      if( llLeft>0) Sleep( (DWORD)(llLeft*1000/_llFrequency));
+      return;
+    }
+    // sleep for most of the time
+    __int64 llNow = ReadClock();
+    const __int64 llSleep = llDue-llNow-pw_llSpin;
+    if( llSleep>0) {
+      Sleep_internal(llSleep);
+      llNow = ReadClock();
+      // spin a bit longer than sleeps overshoot, and slowly shorten that again
+      const __int64 llOvershoot = llNow-(llDue-pw_llSpin);
+      const __int64 llMin = (__int64)(_llFrequency*MIN_SPIN_MS/1000);
+      const __int64 llMax = (__int64)(_llFrequency*MAX_SPIN_MS/1000);
+      pw_llSpin = Clamp( Max( llOvershoot+llMin, pw_llSpin-pw_llSpin/16), llMin, llMax);
+    }
+    // spin for the rest
+    while( llNow<llDue) {
+      YieldProcessor();
+      llNow = ReadClock();
+    }
+  };
+};
+
+
+// scheduler state
+static HANDLE _hTickThread = NULL;
+static HANDLE _hTickDone = NULL;    // signaled after each tick
+static volatile BOOL _bQuit = FALSE;
+static __int64 _llPeriod = 0;
+static __int64 _llNextTick = 0;
+static CPreciseWait _pwTick;
+static TickStats _tsTicks;
+
+
+static DWORD WINAPI TickThread( LPVOID lpParameter)
+{
+  Trace_SetThreadName("Tick scheduler");
+  SetThreadPriority( GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+  while( !_bQuit) {
+    _pwTick.WaitUntil(_llNextTick);
+    if( _bQuit) break;
+    _tsTicks.Add( (ReadClock()-_llNextTick)*1000.0/_llFrequency);
+    // receive, run and send tick (see CNetworkLibrary::TimerLoop())
+    _pTimer->HandleTimerHandlers();
+    SetEvent(_hTickDone);
+
+    // next deadline is relative to this one, so it doesn't drift
+    _llNextTick += _llPeriod;
+    // if too far behind (e.g. process was stalled), skip ticks instead of running a burst
+    const __int64 llBehind = ReadClock()-_llNextTick;
+    if( llBehind>_llPeriod*MAX_CATCHUP) {
+      const INDEX ctSkip = (INDEX)(llBehind/_llPeriod);
+      _llNextTick += ctSkip*_llPeriod;
+      _tsTicks.ts_ctSkipped += ctSkip;
+    }
+  }
+  MemPool_ReleaseThreadCache();
+  return 0;
+}
+
+
+void TickScheduler_Start(void)
+{
+  if( _hTickThread!=NULL) return;
+  InitClock();
+  _pwTick.Init(TRUE);
+  _tsTicks.Clear();
+  _hTickDone = CreateEvent( NULL, FALSE, FALSE, NULL);
+  // finer OS timer granularity makes sleeps overshoot less
+  timeBeginPeriod(1);
+
+  // take over from multimedia timer
+  _pTimer->SetInterrupt(FALSE);
+  _llPeriod = (__int64)(_llFrequency*_pTimer->TickQuantum);
+  _llNextTick = ReadClock()+_llPeriod;
+  _bQuit = FALSE;
+  DWORD dwThreadID;
+  _hTickThread = CreateThread( NULL, 0, TickThread, NULL, 0, &dwThreadID);
+  if( _hTickThread==NULL) {
+    CPrintF( TRANS("Cannot start tick scheduler, using multimedia timer.\n"));
+    TickScheduler_Stop();
+    return;
+  }
+  CPrintF( TRANS("Tick scheduler: %s wait timer\n"), _pwTick.pw_hTimer!=NULL ? "waitable" : "no");
+}
+
+
+void TickScheduler_Stop(void)
+{
+  if( _hTickThread!=NULL) {
+    _bQuit = TRUE;
+    WaitForSingleObject( _hTickThread, INFINITE);
+    CloseHandle(_hTickThread);
+    _hTickThread = NULL;
+  }
+  if( _hTickDone!=NULL) {
+    CloseHandle(_hTickDone);
+    _hTickDone = NULL;
+    _pwTick.End();
+    timeEndPeriod(1);
+    _pTimer->SetInterrupt(TRUE);
+  }
+}
+
+
+BOOL TickScheduler_IsRunning(void)
+{
+  return _hTickThread!=NULL;
+}
+
+
+void TickScheduler_WaitForTick(DWORD dwTimeout)
+{
+  if( _hTickDone==NULL) {
+    Sleep(dwTimeout);
+    return;
+  }
+  WaitForSingleObject( _hTickDone, dwTimeout);
+}
+
+
+void TickScheduler_Report(CTString &strReport)
+{
+  if( _hTickThread==NULL) {
+    strReport += TRANS("Tick scheduler is not running.\n");
+    return;
+  }
+  _tsTicks.Report( strReport, TRANS("Tick lateness"));
+  strReport += CTString(0, TRANS("  spinning %.3f ms before each tick\n"), _pwTick.pw_llSpin*1000.0/_llFrequency);
+}
+
+
+void TickScheduler_ResetStats(void)
+{
+  _tsTicks.Clear();
+}
+
+
+// synthetic load for jitter test
+static volatile BOOL _bLoadQuit = FALSE;
+static INDEX _iLoadPercent = 0;
+
+static DWORD WINAPI LoadThread( LPVOID lpParameter)
+{
+  // busy for given percentage of each millisecond
+  const __int64 llSlice = _llFrequency/1000;
+  const __int64 llBusy  = llSlice*_iLoadPercent/100;
+  while( !_bLoadQuit) {
+    const __int64 llStart = ReadClock();
+    while( ReadClock()-llStart<llBusy) YieldProcessor();
+    if( _iLoadPercent<100) Sleep(1);
+  }
+  return 0;
+}
+
+
+// run ticks in this thread with given wait mode
+static void MeasureTicks( INDEX ctTicks, BOOL bSpin, TickStats &ts)
+{
+  CPreciseWait pw;
+  pw.Init(bSpin);
+  ts.Clear();
+  const __int64 llPeriod = (__int64)(_llFrequency*_pTimer->TickQuantum);
+  __int64 llNext = ReadClock()+llPeriod;
+  for( INDEX iTick=0; iTick<ctTicks; iTick++) {
+    pw.WaitUntil(llNext);
+    ts.Add( (ReadClock()-llNext)*1000.0/_llFrequency);
+    llNext += llPeriod;
+  }
+  pw.End();
+}
+
+
+void TickScheduler_JitterTest(INDEX ctTicks, INDEX iLoadPercent, CTString &strReport)
+{
+  InitClock();
+  ctTicks = ClampDn( ctTicks, 1L);
+  _iLoadPercent = Clamp( iLoadPercent, 0L, 100L);
+
+  // load every CPU
+  SYSTEM_INFO si;
+  GetSystemInfo(&si);
+  const INDEX ctLoadThreads = _iLoadPercent>0 ? Clamp( (INDEX)si.dwNumberOfProcessors, 1L, 64L) : 0;
+  HANDLE ahLoad[64];
+  _bLoadQuit = FALSE;
+  INDEX ctStarted = 0;
+  for( ; ctStarted<ctLoadThreads; ctStarted++) {
+    DWORD dwThreadID;
+    ahLoad[ctStarted] = CreateThread( NULL, 0, LoadThread, NULL, 0, &dwThreadID);
+    if( ahLoad[ctStarted]==NULL) break;
+  }
+
+  // measure at same priority as the tick thread
+  const int iOldPriority = GetThreadPriority(GetCurrentThread());
+  SetThreadPriority( GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+  timeBeginPeriod(1);
+  TickStats tsSleep, tsSpin;
+  MeasureTicks( ctTicks, FALSE, tsSleep);
+  MeasureTicks( ctTicks, TRUE,  tsSpin);
+  timeEndPeriod(1);
+  SetThreadPriority( GetCurrentThread(), iOldPriority);
+
+  _bLoadQuit = TRUE;
+  if( ctStarted>0) WaitForMultipleObjects( ctStarted, ahLoad, TRUE, INFINITE);
+  for( INDEX iThread=0; iThread<ctStarted; iThread++) CloseHandle(ahLoad[iThread]);
+
+  strReport = CTString(0, TRANS("Tick jitter with %d load threads at %d%%:\n"), ctStarted, _iLoadPercent);
+  tsSleep.Report( strReport, TRANS("Sleep"));
+  tsSpin.Report( strReport, TRANS("Sleep and spin"));
+}
@@ -0,0 +1,39 @@
+/* Copyright (c) 2002-2012 Croteam Ltd.
+This program is free software; you can redistribute it and/or modify
+it under the terms of version 2 of the GNU General Public License as published by
+the Free Software Foundation
+
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA. */
+
+#ifndef SE_INCL_TICKSCHEDULER_H
+#define SE_INCL_TICKSCHEDULER_H
+#ifdef PRAGMA_ONCE
+  #pragma once
+#endif
+
+// drive timer handlers from a precise tick thread instead of the multimedia timer
+ENGINE_API extern void TickScheduler_Start(void);
+ENGINE_API extern void TickScheduler_Stop(void);
+ENGINE_API extern BOOL TickScheduler_IsRunning(void);
+
+// wait until the next tick has been handled, or until timeout (in milliseconds)
+ENGINE_API extern void TickScheduler_WaitForTick(DWORD dwTimeout);
+
+// report and reset histogram of tick lateness
+ENGINE_API extern void TickScheduler_Report(CTString &strReport);
+ENGINE_API extern void TickScheduler_ResetStats(void);
+
+// measure tick jitter of plain sleeping and of the scheduler while other threads load the CPU
+ENGINE_API extern void TickScheduler_JitterTest(INDEX ctTicks, INDEX iLoadPercent, CTString &strReport);
+
+
+#endif  /* include-once check. */
+
@@ -119,6 +119,7 @@ void CTimer_TimerFunc_internal(void)
 }
 void __stdcall CTimer_TimerFunc(UINT uID, UINT uMsg, ULONG dwUser, ULONG dw1, ULONG dw2)
 {
+  Trace_SetThreadName("Timer");
   // access to the list of handlers must be locked
   CTSingleLock slHooks(&_pTimer->tm_csHooks, TRUE);
   // handle all timers
@@ -328,6 +329,23 @@ void CTimer::HandleTimerHandlers(void)
   CTimer_TimerFunc_internal();
 }
 
+/* Start or stop the timer interrupt (without it, handlers must be handled manually). */
+void CTimer::SetInterrupt(BOOL bInterrupt)
+{
+  if( bInterrupt==tm_bInterrupt) return;
+
+  if( bInterrupt) {
+    tm_TimerID = timeSetEvent( ULONG(TickQuantum*1000.0f), 0, &CTimer_TimerFunc, 0, TIME_PERIODIC);
+    if( tm_TimerID==NULL) FatalError(TRANS("Cannot initialize multimedia timer!"));
+  } else {
+    timeKillEvent(tm_TimerID);
+    // wait for the callback that might be running right now
+    CTSingleLock slHooks(&tm_csHooks, TRUE);
+    tm_TimerID = NULL;
+  }
+  tm_bInterrupt = bInterrupt;
+}
+
 
 /*
  * Set the real time tick value.
@@ -103,6 +103,8 @@ public:
   void RemHandler(CTimerHandler *pthOld);
   /* Handle timer handlers manually. */
   void HandleTimerHandlers(void);
+  /* Start or stop the timer interrupt (without it, handlers must be handled manually). */
+  void SetInterrupt(BOOL bInterrupt);
 
   /* Set the real time tick value. */
   void SetRealTimeTick(TIME tNewRealTimeTick);
@@ -0,0 +1,256 @@
+/* Copyright (c) 2002-2012 Croteam Ltd.
+This program is free software; you can redistribute it and/or modify
+it under the terms of version 2 of the GNU General Public License as published by
+the Free Software Foundation
+
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA. */
+
+#include "StdH.h"
+
+#include <Engine/Base/Trace.h>
+#include <Engine/Base/Shell.h>
+#include <Engine/Base/Console.h>
+#include <Engine/Base/Stream.h>
+#include <Engine/Base/Memory.h>
+#include <Engine/Base/Timer.h>
+#include <Engine/Base/Synchronization.h>
+#include <Engine/Math/Functions.h>
+#include <Engine/Templates/StaticArray.cpp>
+
+/*
+Hierarchical event tracing.
+
+Each thread writes begin/end events into its own ring buffer, so recording takes
+no locks; only the thread that owns a buffer writes into it and advances its counter.
+Dumping copies the rings while threads keep on writing, and then drops the oldest
+events that might have been overwritten during the copy. Events are written as
+Chrome trace JSON, which can be opened in chrome://tracing or ui.perfetto.dev.
+*/
+
+#define TRACE_RINGSIZE (1<<17)  // events per thread (must be power of 2)
+#define TRACE_RINGMASK (TRACE_RINGSIZE-1)
+#define MAX_TRACETHREADS 32
+
+// record begin/end events of profile timers and trace scopes
+INDEX dbg_bTrace = FALSE;
+
+struct TraceEvent {
+  __int64 te_llTime;            // high precision timer value
+  const char *te_strName;
+  const char *te_strCategory;   // NULL for end events
+};
+
+struct TraceBuffer {
+  ULONG tb_ulThreadID;
+  const char *tb_strThreadName;
+  volatile ULONG tb_ctWritten;  // events written so far (only owner thread writes this)
+  TraceEvent tb_ateEvents[TRACE_RINGSIZE];
+};
+
+static TraceBuffer *_aptbBuffers[MAX_TRACETHREADS];
+static volatile LONG _ctBuffers = 0;
+static CTCriticalSection _csTrace;  // guards registering of thread buffers
+
+static _declspec(thread) TraceBuffer *_ptbThread = NULL;
+static _declspec(thread) BOOL _bNoBuffer = FALSE;
+static _declspec(thread) const char *_strThreadName = NULL;
+
+
+// get ring buffer of the calling thread, creating it on first use
+static TraceBuffer *GetThreadBuffer(void)
+{
+  if( _ptbThread!=NULL || _bNoBuffer) return _ptbThread;
+
+  CTSingleLock slTrace(&_csTrace, TRUE);
+  if( _ctBuffers>=MAX_TRACETHREADS) {
+    _bNoBuffer = TRUE;
+    return NULL;
+  }
+  TraceBuffer *ptb = (TraceBuffer*)AllocMemory(sizeof(TraceBuffer));
+  ptb->tb_ulThreadID = GetCurrentThreadId();
+  ptb->tb_strThreadName = _strThreadName;
+  ptb->tb_ctWritten = 0;
+  _aptbBuffers[_ctBuffers] = ptb;
+  _ctBuffers++;
+  _ptbThread = ptb;
+  return ptb;
+}
+
+
+static inline void WriteEvent(const char *strName, const char *strCategory)
+{
+  TraceBuffer *ptb = GetThreadBuffer();
+  if( ptb==NULL) return;
+  const ULONG ctWritten = ptb->tb_ctWritten;
+  TraceEvent &te = ptb->tb_ateEvents[ctWritten&TRACE_RINGMASK];
+  te.te_llTime = _pTimer->GetHighPrecisionTimer().tv_llValue;
+  te.te_strName = strName;
+  te.te_strCategory = strCategory;
+  // publish the event only after it has been written
+  ptb->tb_ctWritten = ctWritten+1;
+}
+
+
+void Trace_BeginEvent(const char *strName, const char *strCategory)
+{
+  WriteEvent( strName, strCategory!=NULL ? strCategory : "");
+}
+
+
+void Trace_EndEvent(const char *strName)
+{
+  WriteEvent( strName, NULL);
+}
+
+
+void Trace_SetThreadName(const char *strName)
+{
+  _strThreadName = strName;
+  if( _ptbThread!=NULL) _ptbThread->tb_strThreadName = strName;
+}
+
+
+// copy events of one thread that are not older than given time
+static INDEX CopyEvents( TraceBuffer &tb, __int64 llFrom, CStaticArray<TraceEvent> &ateEvents)
+{
+  const ULONG ctEnd = tb.tb_ctWritten;
+  const ULONG ctStored = Min( ctEnd, (ULONG)TRACE_RINGSIZE);
+  ULONG iBegin = ctEnd-ctStored;
+  for( ULONG iEvent=iBegin; iEvent!=ctEnd; iEvent++) {
+    ateEvents[iEvent-iBegin] = tb.tb_ateEvents[iEvent&TRACE_RINGMASK];
+  }
+  // events overwritten by the owner thread while copying are not valid
+  // (including the one that might be in the middle of writing)
+  const ULONG ctNow = tb.tb_ctWritten;
+  ULONG ctOverwritten = 0;
+  if( ctNow+1-iBegin > TRACE_RINGSIZE) {
+    ctOverwritten = Min( ctNow+1-iBegin-TRACE_RINGSIZE, ctStored);
+  }
+  // skip events that are too old
+  INDEX iFirst = ctOverwritten;
+  while( iFirst<(INDEX)ctStored && ateEvents[iFirst].te_llTime<llFrom) iFirst++;
+  // move remaining events to start of array
+  const INDEX ctCopied = ctStored-iFirst;
+  if( iFirst>0) {
+    for( INDEX i=0; i<ctCopied; i++) ateEvents[i] = ateEvents[iFirst+i];
+  }
+  return ctCopied;
+}
+
+
+// quote a name as JSON string (names come from code and thread setup, but may contain anything)
+static CTString JsonString( const char *strName)
+{
+  CTString strResult = "\"";
+  if( strName==NULL) strName = "";
+  char achChar[8];
+  for( const UBYTE *pub=(const UBYTE*)strName; *pub!=0; pub++) {
+    if( *pub=='"' || *pub=='\\') {
+      sprintf( achChar, "\\%c", *pub);
+    } else if( *pub<0x20) {
+      sprintf( achChar, "\\u%04x", *pub);
+    } else {
+      achChar[0] = *pub;
+      achChar[1] = 0;
+    }
+    strResult += achChar;
+  }
+  strResult += "\"";
+  return strResult;
+}
+
+
+// write last given number of seconds of events as Chrome trace JSON
+static INDEX DumpTrace_t( const CTFileName &fnmTrace, DOUBLE dSeconds)
+{
+  const __int64 llNow  = _pTimer->GetHighPrecisionTimer().tv_llValue;
+  const __int64 llFrom = llNow - (__int64)(dSeconds*_pTimer->tm_llPerformanceCounterFrequency);
+  const DOUBLE dToMicroseconds = 1E6/_pTimer->tm_llPerformanceCounterFrequency;
+
+  CTFileStream strmTrace;
+  strmTrace.Create_t( fnmTrace, CTStream::CM_TEXT);
+  strmTrace.FPrintF_t("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+  CStaticArray<TraceEvent> ateEvents;
+  ateEvents.New(TRACE_RINGSIZE);
+  INDEX ctWritten = 0;
+  const INDEX ctBuffers = _ctBuffers;
+  for( INDEX iBuffer=0; iBuffer<ctBuffers; iBuffer++) {
+    TraceBuffer &tb = *_aptbBuffers[iBuffer];
+    const INDEX ctEvents = CopyEvents( tb, llFrom, ateEvents);
+
+    CTString strThread;
+    if( tb.tb_strThreadName!=NULL) strThread = tb.tb_strThreadName;
+    else strThread.PrintF( "Thread %d", iBuffer);
+    strmTrace.FPrintF_t( "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":%s}}",
+      ctWritten>0 ? ",\n" : "", tb.tb_ulThreadID, (const char*)JsonString(strThread));
+    ctWritten++;
+
+    // ring may start in the middle of nested events, so skip ends without a begin
+    INDEX iDepth = 0;
+    for( INDEX iEvent=0; iEvent<ctEvents; iEvent++) {
+      const TraceEvent &te = ateEvents[iEvent];
+      const DOUBLE dTime = (te.te_llTime-llFrom)*dToMicroseconds;
+      if( te.te_strCategory!=NULL) {
+        iDepth++;
+        strmTrace.FPrintF_t( ",\n{\"name\":%s,\"cat\":%s,\"ph\":\"B\",\"pid\":1,\"tid\":%u,\"ts\":%.3f}",
+          (const char*)JsonString(te.te_strName), (const char*)JsonString(te.te_strCategory), tb.tb_ulThreadID, dTime);
+      } else if( iDepth>0) {
+        iDepth--;
+        strmTrace.FPrintF_t( ",\n{\"name\":%s,\"ph\":\"E\",\"pid\":1,\"tid\":%u,\"ts\":%.3f}",
+          (const char*)JsonString(te.te_strName), tb.tb_ulThreadID, dTime);
+      } else {
+        continue;
+      }
+      ctWritten++;
+    }
+  }
+  strmTrace.FPrintF_t("\n]}\n");
+  return ctWritten-ctBuffers;
+}
+
+
+// dump last given seconds of trace from console: TraceDump(5)
+static void TraceDump(void *pArgs)
+{
+  FLOAT fSeconds = NEXTARGUMENT(FLOAT);
+  if( fSeconds<=0) fSeconds = 5.0f;
+  const CTFileName fnmTrace = CTString("Temp\\Trace.json");
+  try {
+    const INDEX ctEvents = DumpTrace_t( fnmTrace, fSeconds);
+    CPrintF( TRANS("Trace of last %.1f seconds saved to '%s' (%d events, %d threads)\n"),
+      fSeconds, (const char*)fnmTrace, ctEvents, _ctBuffers);
+    if( !dbg_bTrace) CPrintF( TRANS("Note: tracing is off, set dbg_bTrace=1 to record events.\n"));
+  } catch(char *strError) {
+    CPrintF( TRANS("Cannot save trace: %s\n"), strError);
+  }
+}
+
+
+void Trace_Init(void)
+{
+  Trace_SetThreadName("Main");
+  _pShell->DeclareSymbol( "user INDEX dbg_bTrace;", &dbg_bTrace);
+  _pShell->DeclareSymbol( "user void TraceDump(FLOAT);", &TraceDump);
+}
+
+
+void Trace_End(void)
+{
+  dbg_bTrace = FALSE;
+  CTSingleLock slTrace(&_csTrace, TRUE);
+  for( INDEX iBuffer=0; iBuffer<_ctBuffers; iBuffer++) {
+    FreeMemory(_aptbBuffers[iBuffer]);
+    _aptbBuffers[iBuffer] = NULL;
+  }
+  _ctBuffers = 0;
+  _ptbThread = NULL;
+}
@@ -0,0 +1,56 @@
+/* Copyright (c) 2002-2012 Croteam Ltd.
+This program is free software; you can redistribute it and/or modify
+it under the terms of version 2 of the GNU General Public License as published by
+the Free Software Foundation
+
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA. */
+
+#ifndef SE_INCL_TRACE_H
+#define SE_INCL_TRACE_H
+#ifdef PRAGMA_ONCE
+  #pragma once
+#endif
+
+// set to record begin/end events of profile timers and trace scopes
+ENGINE_API extern INDEX dbg_bTrace;
+
+// initialize and shutdown tracing (thread buffers are created on first event)
+extern void Trace_Init(void);
+extern void Trace_End(void);
+
+// record begin and end of a nested event on the calling thread
+// NOTE: name and category must stay valid until the trace is dumped
+ENGINE_API extern void Trace_BeginEvent(const char *strName, const char *strCategory);
+ENGINE_API extern void Trace_EndEvent(const char *strName);
+// name the calling thread in dumped traces
+ENGINE_API extern void Trace_SetThreadName(const char *strName);
+
+// traces the scope it is declared in
+class CTraceScope {
+public:
+  const char *ts_strName;
+  inline CTraceScope(const char *strName, const char *strCategory="") {
+    ts_strName = NULL;
+    if( dbg_bTrace) {
+      ts_strName = strName;
+      Trace_BeginEvent( strName, strCategory);
+    }
+  };
+  inline ~CTraceScope(void) {
+    if( ts_strName!=NULL) Trace_EndEvent(ts_strName);
+  };
+};
+
+#define TRACE_SCOPE(name) CTraceScope _tsScope(name)
+
+
+#endif  /* include-once check. */
+
@@ -207,7 +207,7 @@ ENGINE_API const char *TranslateConst(const char *str, INDEX iOffset)
   // find translation pair
   CTranslationPair *ptp = NULL;
   if (_atpPairs.Count()>0) {
-    ptp = _nttpPairs.Find(str);
+    ptp = _nttpPairs.Find(CTString(str));
   }
   // if not found
   if (ptp==NULL) {
@@ -217,6 +217,7 @@ class CChangeableRT;
 class CClipMove;
 class CClipTest;
 class CCollisionInfo;
+class CCommunicationInterface;
 class CCompressor;
 class CConsole;
 class CContentType;
@@ -248,6 +249,7 @@ class CModelData;
 class CMovableBrushEntity;
 class CMovableEntity;
 class CMovableModelEntity;
+class CNetworkLibrary;
 class CNetworkMessage;
 class CNetworkNode;
 class CNetworkStream;
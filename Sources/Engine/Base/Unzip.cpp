@@ -204,6 +204,62 @@ static CStaticStackArray<CZipEntry>  _azeFiles;
 static CStaticStackArray<CZipHandle> _azhHandles;
 // filenames of all archives
 static CStaticStackArray<CTFileName> _afnmArchives;
+// hash table of indices of files in all archives, by atoms of their names (-1 for empty slot)
+static CStaticArray<INDEX> _aiFileSlots;
+static INDEX _ctIndexedFiles = 0;
+
+// index files in all archives by their name atoms (first entry of a name wins)
+static void IndexFiles(void)
+{
+  INDEX ctSlots = 1024;
+  while (ctSlots<_azeFiles.Count()*2) ctSlots*=2;
+  _aiFileSlots.Clear();
+  _aiFileSlots.New(ctSlots);
+  for (INDEX iSlot=0; iSlot<ctSlots; iSlot++) {
+    _aiFileSlots[iSlot] = -1;
+  }
+
+  for (INDEX iFile=0; iFile<_azeFiles.Count(); iFile++) {
+    const CTFileName &fnm = _azeFiles[iFile].ze_fnm;
+    INDEX iSlot = fnm.GetAtomHash()&(ctSlots-1);
+    while (_aiFileSlots[iSlot]>=0 && _azeFiles[_aiFileSlots[iSlot]].ze_fnm.GetAtom()!=fnm.GetAtom()) {
+      iSlot = (iSlot+1)&(ctSlots-1);
+    }
+    if (_aiFileSlots[iSlot]<0) {
+      _aiFileSlots[iSlot] = iFile;
+    }
+  }
+  _ctIndexedFiles = _azeFiles.Count();
+}
+
+// find index of a file in archives (-1 for no file)
+static INDEX FindFile(const CTFileName &fnm)
+{
+  const ULONG ulAtom = fnm.GetAtom();
+
+  // if the index is not up to date
+  if (_ctIndexedFiles!=_azeFiles.Count()) {
+    // search all files (with same name matching as the index)
+    for(INDEX iFile=0; iFile<_azeFiles.Count(); iFile++) {
+      if (FNA_IsNameOf(ulAtom, _azeFiles[iFile].ze_fnm)) {
+        return iFile;
+      }
+    }
+    return -1;
+  }
+
+  // look the atom up in the index
+  const INDEX ctSlots = _aiFileSlots.Count();
+  INDEX iSlot = FNA_GetHash(ulAtom)&(ctSlots-1);
+  while (_aiFileSlots[iSlot]>=0) {
+    const INDEX iFile = _aiFileSlots[iSlot];
+    if (_azeFiles[iFile].ze_fnm.GetAtom()==ulAtom) {
+      return iFile;
+    }
+    iSlot = (iSlot+1)&(ctSlots-1);
+  }
+  return -1;
+}
 
 // convert slashes to backslashes in a file path
 void ConvertSlashes(char *p)
@@ -459,6 +515,9 @@ void UNZIPReadDirectoriesReverse_t(void)
     }
   }
 
+  // index all files that were read, for fast lookups
+  IndexFiles();
+
   // if there were errors
   if (strAllErrors!="") {
     // report them
@@ -469,14 +528,7 @@ void UNZIPReadDirectoriesReverse_t(void)
 // check if a zip file entry exists
 BOOL UNZIPFileExists(const CTFileName &fnm)
 {
-  // for each file
-  for(INDEX iFile=0; iFile<_azeFiles.Count(); iFile++) {
-    // if it is that one
-    if (_azeFiles[iFile].ze_fnm == fnm) {
-      return TRUE;
-    }
-  }
-  return FALSE;
+  return FindFile(fnm)>=0;
 }
 
 // enumeration for all files in all zips
@@ -497,14 +549,7 @@ BOOL UNZIPIsFileAtIndexMod(INDEX i)
 // get index of a file (-1 for no file)
 INDEX UNZIPGetFileIndex(const CTFileName &fnm)
 {
-  // for each file
-  for(INDEX iFile=0; iFile<_azeFiles.Count(); iFile++) {
-    // if it is that one
-    if (_azeFiles[iFile].ze_fnm == fnm) {
-      return iFile;
-    }
-  }
-  return -1;
+  return FindFile(fnm);
 }
 
 // get info on a zip file entry
@@ -537,14 +582,10 @@ void UNZIPGetFileInfo(INDEX iHandle, CTFileName &fnmZip,
 INDEX UNZIPOpen_t(const CTFileName &fnm)
 {
   CZipEntry *pze = NULL;
-  // for each file
-  for(INDEX iFile=0; iFile<_azeFiles.Count(); iFile++) {
-    // if it is that one
-    if (_azeFiles[iFile].ze_fnm == fnm) {
-      // stop searching
-      pze = &_azeFiles[iFile];
-      break;
-    }
+  // find the file
+  const INDEX iFile = FindFile(fnm);
+  if (iFile>=0) {
+    pze = &_azeFiles[iFile];
   }
 
   // if not found
@@ -26,6 +26,12 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <Engine/Base/CRC.h>
 #include <Engine/Base/CRCTable.h>
 #include <Engine/Base/ProgressHook.h>
+#include <Engine/Base/JobPool.h>
+#include <Engine/Base/Trace.h>
+#include <Engine/Base/FileNameAtom.h>
+#include <Engine/Base/MemoryPool.h>
+#include <Engine/Base/LogQueue.h>
+#include <Engine/Base/BackgroundWrite.h>
 #include <Engine/Sound/SoundListener.h>
 #include <Engine/Sound/SoundLibrary.h>
 #include <Engine/Graphics/GfxLibrary.h>
@@ -389,6 +395,17 @@ ENGINE_API void SE_InitEngine(CTString strGameID)
   // Timer tick quantum
   _pShell->DeclareSymbol("user const FLOAT fTickQuantum;", (FLOAT*)&_pTimer->TickQuantum);
 
+  // worker threads for parallel jobs
+  JobPool_Init();
+  // hierarchical event tracing
+  Trace_Init();
+  // interned file names
+  FNA_Init();
+  // small block pool
+  MemPool_Init();
+  // background console log writer
+  LogQueue_Init();
+
   // init MODs and stuff ...
   extern void InitStreams(void);
   InitStreams();
@@ -504,6 +521,16 @@ ENGINE_API void SE_EndEngine(void)
   // free all memory used by the crc cache
   CRCT_Clear();
 
+  // finish save game that might still be written
+  BackgroundWrite_Wait();
+
+  // stop worker threads
+  JobPool_End();
+  // free trace buffers
+  Trace_End();
+  // write out queued console output and stop log writer
+  LogQueue_End();
+
   // shutdown
   if( _pNetwork != NULL) { delete _pNetwork;  _pNetwork=NULL; }
   delete _pInput;    _pInput   = NULL;  
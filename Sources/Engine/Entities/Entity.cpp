@@ -32,6 +32,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include <Engine/Base/CRC.h>
 #include <Engine/Base/Console.h>
+#include <Engine/Base/Shell.h>
 #include <Engine/Base/Statistics_Internal.h>
 #include <Engine/Network/Network.h>
 #include <Engine/Network/PlayerTarget.h>
@@ -138,6 +139,7 @@ CEntity::CEntity(void)
   en_ulCollisionFlags = 0;
   en_ctReferences = 0;
   en_ulID = 0;
+  en_ulRangeQueryMark = 0;
   en_RenderType = RT_NONE;
   en_fSpatialClassificationRadius = -1.0f;
   en_penParent = NULL;
@@ -1264,6 +1266,65 @@ void CEntity::Destroy(void)
   RemReference();
 }
 
+/*
+ * Take predictor out of the world, but keep it for reuse in next prediction.
+ * This does what Destroy() does, except that model objects, shading info and last positions
+ * are kept to be refreshed in place by Copy() with COPY_REFRESH.
+ */
+void CEntity::SuspendPredictor(void)
+{
+  ASSERT(GetFPUPrecision()==FPT_24BIT);
+  ASSERT(IsPredictor() && !(en_ulFlags&(ENF_TEMPPREDICTOR|ENF_DELETED)));
+
+  // if it is a light source
+  {CLightSource *pls = GetLightSource();
+  if (pls!=NULL) {
+    // destroy all of its shadow layers
+    pls->DiscardShadowLayers();
+  }}
+  // let derived class clean-up after itself (this removes it from timers and movers)
+  OnEnd();
+
+  // clear spatial classification
+  en_fSpatialClassificationRadius = -1.0f;
+  en_boxSpatialClassification = FLOATaabbox3D();
+  // remove from collision grid (collision info is copied again on refresh)
+  DiscardCollisionInfo();
+  // unlink cached shading from its polygon
+  if (en_psiShadingInfo!=NULL && en_psiShadingInfo->si_lnInPolygon.IsLinked()) {
+    en_psiShadingInfo->si_lnInPolygon.Remove();
+  }
+
+  // clear all entity pointers, except the one to the predicted entity
+  CEntity *penPredicted = GetPredictionPair();
+  {for (CDLLEntityClass *pdec = en_pecClass->ec_pdecDLLClass; pdec!=NULL; pdec=pdec->dec_pdecBase) {
+    for (INDEX iProperty=0; iProperty<pdec->dec_ctProperties; iProperty++) {
+      CEntityProperty &ep = pdec->dec_aepProperties[iProperty];
+      if (ep.ep_eptType==CEntityProperty::EPT_ENTITYPTR) {
+        ENTITYPROPERTY(this, ep.ep_slOffset, CEntityPointer) = NULL;
+      }
+    }
+  }}
+  SetPredictionPair(penPredicted);
+
+  // unlink parent-child links
+  if (en_penParent != NULL) {
+    en_penParent = NULL;
+    en_lnInParent.Remove();
+  }
+  {FORDELETELIST( CEntity, en_lnInParent, en_lhChildren, itenChild) {
+    itenChild->en_penParent = NULL;
+    itenChild->en_lnInParent.Remove();
+  }}
+
+  // remove from all sectors
+  en_rdSectors.Clear();
+  // remove from active entities in the world
+  en_pwoWorld->wo_cenEntities.Remove(this);
+  // new identifier is given on refresh
+  en_ulID = 0;
+}
+
 
 FLOAT3D _vHandle;
 CBrushPolygon *_pbpoNear;
@@ -2029,10 +2090,42 @@ class CSentEvent {
 public:
   CEntityPointer se_penEntity;
   CEntityEvent *se_peeEvent;
+  BOOL se_bInArena;     // event copy is in event arena (otherwise it is on heap)
   inline void Clear(void) { se_penEntity = NULL; }
 };
 
 static CStaticStackArray<CSentEvent> _aseSentEvents;  // delayed events
+
+// copies of sent events are made in an arena that is reset when all sent events are handled
+extern INDEX ent_bEventArena = TRUE;
+#define EVENTARENA_CHUNKSIZE (64*1024)
+static CStaticStackArray<UBYTE *> _apubEventChunks;  // arena chunks (kept allocated)
+static INDEX _iEventChunk = 0;        // chunk that is currently filled
+static SLONG _slEventChunkUsed = 0;   // bytes used in that chunk
+
+// get memory for one event copy from the arena (NULL if it is too large)
+static void *AllocEventMemory(SLONG slSize)
+{
+  // keep copies aligned
+  slSize = (slSize+15)&~15;
+  if (slSize>EVENTARENA_CHUNKSIZE) {
+    return NULL;
+  }
+  // if current chunk is full, go to next one
+  if (_iEventChunk<_apubEventChunks.Count() && _slEventChunkUsed+slSize>EVENTARENA_CHUNKSIZE) {
+    _iEventChunk++;
+    _slEventChunkUsed = 0;
+  }
+  // allocate new chunk if needed
+  if (_iEventChunk>=_apubEventChunks.Count()) {
+    _apubEventChunks.Push() = (UBYTE *)AllocMemoryAligned(EVENTARENA_CHUNKSIZE, 16);
+    _pfPhysicsProfile.IncrementCounter(CPhysicsProfile::PCI_EVENTARENACHUNKS);
+  }
+  void *pvMemory = _apubEventChunks[_iEventChunk]+_slEventChunkUsed;
+  _slEventChunkUsed += slSize;
+  return pvMemory;
+}
+
 /* Send an event to this entity. */
 void CEntity::SendEvent(const CEntityEvent &ee)
 {
@@ -2040,9 +2133,110 @@ void CEntity::SendEvent(const CEntityEvent &ee)
     ASSERT(FALSE);
     return;
   }
+  _pfPhysicsProfile.IncrementCounter(CPhysicsProfile::PCI_SENTEVENTS);
+  CEntityEvent &eeOriginal = (CEntityEvent&)ee;  // discard const qualifier
+
   CSentEvent &se = _aseSentEvents.Push();
   se.se_penEntity = this;
-  se.se_peeEvent = ((CEntityEvent&)ee).MakeCopy();  // discard const qualifier
+  // copy the event to the arena if possible
+  const SLONG slSize = ent_bEventArena ? eeOriginal.GetSizeOf() : 0;
+  void *pvCopy = slSize>0 ? AllocEventMemory(slSize) : NULL;
+  if (pvCopy!=NULL) {
+    se.se_peeEvent = eeOriginal.MakeCopyAt(pvCopy);
+    se.se_bInArena = TRUE;
+  } else {
+    se.se_peeEvent = eeOriginal.MakeCopy();
+    se.se_bInArena = FALSE;
+    _pfPhysicsProfile.IncrementCounter(CPhysicsProfile::PCI_SENTEVENTS_HEAP);
+  }
+}
+
+// use brush archive and query stamps in FindEntitiesInRange() (instead of scanning all entities)
+extern INDEX ent_bIndexedRangeQuery = TRUE;
+
+// add entity found in range query if not already added
+static inline void AddEntityInRange(CEntity *pen, CDynamicContainer<CEntity> &cen, ULONG ulMark)
+{
+  // no stamp means old way of checking
+  if (ulMark==0) {
+    if (!cen.IsMember(pen)) {
+      cen.Add(pen);
+    }
+  } else if (pen->en_ulRangeQueryMark!=ulMark) {
+    pen->en_ulRangeQueryMark = ulMark;
+    cen.Add(pen);
+  }
+}
+
+// find entities of one sector that touch the box
+static void FindSectorEntitiesInRange(CBrushSector &bsc, const FLOATaabbox3D &boxRange,
+  CDynamicContainer<CEntity> &cen, BOOL bCollidingOnly, ULONG ulMark)
+{
+  _pfPhysicsProfile.IncrementCounter(CPhysicsProfile::PCI_RANGEQUERYSECTORS);
+  // for all entities in the sector
+  {FOREACHDSTOFSRC(bsc.bsc_rsEntities, CEntity, en_rdSectors, pen)
+    _pfPhysicsProfile.IncrementCounter(CPhysicsProfile::PCI_RANGEQUERYENTITIES);
+    // if already found in this query
+    if (ulMark!=0 && pen->en_ulRangeQueryMark==ulMark) {
+      // skip it
+      continue;
+    }
+    // if the model entity touches the box
+    if ((pen->en_RenderType==CEntity::RT_MODEL || pen->en_RenderType==CEntity::RT_EDITORMODEL
+      || pen->en_RenderType==CEntity::RT_SKAMODEL || pen->en_RenderType==CEntity::RT_SKAEDITORMODEL)
+      && boxRange.HasContactWith(
+      FLOATaabbox3D(pen->GetPlacement().pl_PositionVector, pen->en_fSpatialClassificationRadius))) {
+
+      // if it has collision box
+      if (pen->en_pciCollisionInfo!=NULL) {
+        // for each sphere
+        FOREACHINSTATICARRAY(pen->en_pciCollisionInfo->ci_absSpheres, CMovingSphere, itms) {
+          // project it
+          itms->ms_vRelativeCenter0 = itms->ms_vCenter*pen->en_mRotation+pen->en_plPlacement.pl_PositionVector;
+          // if the sphere touches the range
+          if (boxRange.HasContactWith(FLOATaabbox3D(itms->ms_vRelativeCenter0, itms->ms_fR))) {
+            // add it to container
+            AddEntityInRange(pen, cen, ulMark);
+            break;
+          }
+        }
+      // if no collision box, but non-colliding are allowed
+      } else if (!bCollidingOnly) {
+        // add it to container
+        AddEntityInRange(pen, cen, ulMark);
+      }
+    // if the brush entity touches the box
+    } else if (pen->en_RenderType==CEntity::RT_BRUSH && 
+      boxRange.HasContactWith(
+      FLOATaabbox3D(pen->GetPlacement().pl_PositionVector, pen->en_fSpatialClassificationRadius))) {
+      // if the brush touches the box
+      if (boxRange.HasContactWith(pen->en_pbrBrush->GetFirstMip()->bm_boxBoundingBox)) {
+        // add it to container
+        AddEntityInRange(pen, cen, ulMark);
+      }
+    }
+  ENDFOR}
+}
+
+// find sectors of one zoning brush that touch the box
+static void FindBrushEntitiesInRange(CBrush3D &br, const FLOATaabbox3D &boxRange,
+  CDynamicContainer<CEntity> &cen, BOOL bCollidingOnly, ULONG ulMark)
+{
+  // get first mip in the brush
+  CBrushMip *pbm = br.GetFirstMip();
+  // if the mip doesn't touch the box
+  if (pbm==NULL || !pbm->bm_boxBoundingBox.HasContactWith(boxRange)) {
+    // skip it
+    return;
+  }
+
+  // for all sectors in this mip
+  FOREACHINDYNAMICARRAY(pbm->bm_abscSectors, CBrushSector, itbsc) {
+    // if the sector touches the box
+    if (itbsc->bsc_boxBoundingBox.HasContactWith(boxRange)) {
+      FindSectorEntitiesInRange(*itbsc, boxRange, cen, bCollidingOnly, ulMark);
+    }
+  }
 }
 
 // find entities in a box (box must be around this entity)
@@ -2050,96 +2244,44 @@ void CEntity::FindEntitiesInRange(
   const FLOATaabbox3D &boxRange, CDynamicContainer<CEntity> &cen, BOOL bCollidingOnly)
 {
   ASSERT(GetFPUPrecision()==FPT_24BIT);
+  _pfPhysicsProfile.IncrementCounter(CPhysicsProfile::PCI_RANGEQUERIES);
 
-  // for each entity in the world of this entity
-  FOREACHINDYNAMICCONTAINER(en_pwoWorld->wo_cenEntities, CEntity, iten) {
-    // if it is zoning brush entity
-    if (iten->en_RenderType == CEntity::RT_BRUSH && (iten->en_ulFlags&ENF_ZONING)) {
-      // get first mip in its brush
-      CBrushMip *pbm = iten->en_pbrBrush->GetFirstMip();
-      // if the mip doesn't touch the box
-      if (!pbm->bm_boxBoundingBox.HasContactWith(boxRange)) {
-        // skip it
-        continue;
+  // old way: look for zoning brushes among all entities and check containment linearly
+  if (!ent_bIndexedRangeQuery) {
+    // for each entity in the world of this entity
+    FOREACHINDYNAMICCONTAINER(en_pwoWorld->wo_cenEntities, CEntity, iten) {
+      // if it is zoning brush entity
+      if (iten->en_RenderType == CEntity::RT_BRUSH && (iten->en_ulFlags&ENF_ZONING)) {
+        FindBrushEntitiesInRange(*iten->en_pbrBrush, boxRange, cen, bCollidingOnly, 0);
       }
+    }
+    return;
+  }
 
-      // for all sectors in this mip
-      FOREACHINDYNAMICARRAY(pbm->bm_abscSectors, CBrushSector, itbsc) {
-        // if the sector doesn't touch the box
-        if (!itbsc->bsc_boxBoundingBox.HasContactWith(boxRange)) {
-          // skip it
-          continue;
-        }
+  // get new stamp for this query
+  CWorld &wo = *en_pwoWorld;
+  wo.wo_ulRangeQueryMark++;
+  // if wrapped around
+  if (wo.wo_ulRangeQueryMark==0) {
+    // clear all stamps and start anew
+    {FOREACHINDYNAMICCONTAINER(wo.wo_cenAllEntities, CEntity, iten) {
+      iten->en_ulRangeQueryMark = 0;
+    }}
+    wo.wo_ulRangeQueryMark = 1;
+  }
+  const ULONG ulMark = wo.wo_ulRangeQueryMark;
+  // entities that are already in container must not be added again
+  {FOREACHINDYNAMICCONTAINER(cen, CEntity, iten) {
+    iten->en_ulRangeQueryMark = ulMark;
+  }}
 
-        // for all entities in the sector
-        {FOREACHDSTOFSRC(itbsc->bsc_rsEntities, CEntity, en_rdSectors, pen)
-          // if the model entity touches the box
-          if ((pen->en_RenderType==RT_MODEL || pen->en_RenderType==RT_EDITORMODEL)
-            && boxRange.HasContactWith(
-            FLOATaabbox3D(pen->GetPlacement().pl_PositionVector, pen->en_fSpatialClassificationRadius))) {
-
-            // if it has collision box
-            if (pen->en_pciCollisionInfo!=NULL) {
-              // for each sphere
-              FOREACHINSTATICARRAY(pen->en_pciCollisionInfo->ci_absSpheres, CMovingSphere, itms) {
-                // project it
-                itms->ms_vRelativeCenter0 = itms->ms_vCenter*pen->en_mRotation+pen->en_plPlacement.pl_PositionVector;
-                // if the sphere touches the range
-                if (boxRange.HasContactWith(FLOATaabbox3D(itms->ms_vRelativeCenter0, itms->ms_fR))) {
-                  // add it to container
-                  if (!cen.IsMember(pen)) {
-                    cen.Add(pen);
-                  }
-                  goto next_entity;
-                }
-              }
-            // if no collision box, but non-colliding are allowed
-            } else if (!bCollidingOnly) {
-              // add it to container
-              if (!cen.IsMember(pen)) {
-                cen.Add(pen);
-              }
-            }
-          // if the brush entity touches the box
-          } else if (pen->en_RenderType==RT_BRUSH && 
-            boxRange.HasContactWith(
-            FLOATaabbox3D(pen->GetPlacement().pl_PositionVector, pen->en_fSpatialClassificationRadius))) {
-            // if the brush touches the box
-            if (boxRange.HasContactWith(pen->en_pbrBrush->GetFirstMip()->bm_boxBoundingBox)) {
-              // add it to container
-              if (!cen.IsMember(pen)) {
-                cen.Add(pen);
-              }
-            }
-          } else if ((pen->en_RenderType==RT_SKAMODEL  || pen->en_RenderType==RT_SKAEDITORMODEL)
-            && boxRange.HasContactWith(
-            FLOATaabbox3D(pen->GetPlacement().pl_PositionVector, pen->en_fSpatialClassificationRadius))) {
-            // if it has collision box
-            if (pen->en_pciCollisionInfo!=NULL) {
-              // for each sphere
-              FOREACHINSTATICARRAY(pen->en_pciCollisionInfo->ci_absSpheres, CMovingSphere, itms) {
-                // project it
-                itms->ms_vRelativeCenter0 = itms->ms_vCenter*pen->en_mRotation+pen->en_plPlacement.pl_PositionVector;
-                // if the sphere touches the range
-                if (boxRange.HasContactWith(FLOATaabbox3D(itms->ms_vRelativeCenter0, itms->ms_fR))) {
-                  // add it to container
-                  if (!cen.IsMember(pen)) {
-                    cen.Add(pen);
-                  }
-                  goto next_entity;
-                }
-              }
-            // if no collision box, but non-colliding are allowed
-            } else if (!bCollidingOnly) {
-              // add it to container
-              if (!cen.IsMember(pen)) {
-                cen.Add(pen);
-              }
-            }
-          }
-          next_entity:;
-        ENDFOR}
-      }
+  // for each brush in the world (same as in sector classification, see FindSectorsAroundEntity())
+  FOREACHINDYNAMICARRAY(wo.wo_baBrushes.ba_abrBrushes, CBrush3D, itbr) {
+    // if the brush entity is zoning
+    CEntity *penBrush = itbr->br_penEntity;
+    if (penBrush!=NULL && penBrush->en_RenderType==CEntity::RT_BRUSH
+      && (penBrush->en_ulFlags&ENF_ZONING) && !(penBrush->en_ulFlags&ENF_DELETED)) {
+      FindBrushEntitiesInRange(*itbr, boxRange, cen, bCollidingOnly, ulMark);
     }
   }
 }
@@ -2158,11 +2300,19 @@ void CEntity::SendEventInRange(const CEntityEvent &ee, const FLOATaabbox3D &boxR
   }
 }
 
+// if set, time spent dispatching sent events is added to it (used for timing demos)
+extern CTimerValue *_ptvEventDispatch = NULL;
+
 /* Handle all sent events. */
 void CEntity::HandleSentEvents(void)
 {
   CSetFPUPrecision FPUPrecision(FPT_24BIT);
 
+  CTimerValue tvStart;
+  if (_ptvEventDispatch!=NULL) {
+    tvStart = _pTimer->GetHighPrecisionTimer();
+  }
+
   // while there are any unhandled events
   INDEX iFirstEvent = 0;
   while (iFirstEvent<_aseSentEvents.Count()) {
@@ -2187,12 +2337,222 @@ void CEntity::HandleSentEvents(void)
     CSentEvent &se = _aseSentEvents[iee];
     // release the entity and destroy the event
     se.se_penEntity = NULL;
-    delete se.se_peeEvent;
+    if (se.se_bInArena) {
+      se.se_peeEvent->~CEntityEvent();
+    } else {
+      delete se.se_peeEvent;
+    }
     se.se_peeEvent = NULL;
   }
 
   // flush all events
   _aseSentEvents.PopAll();
+
+  // no event copies are left in the arena, so it can be reused
+  _pfPhysicsProfile.IncrementCounter(CPhysicsProfile::PCI_EVENTARENABYTES,
+    _iEventChunk*EVENTARENA_CHUNKSIZE+_slEventChunkUsed);
+  _iEventChunk = 0;
+  _slEventChunkUsed = 0;
+
+  if (_ptvEventDispatch!=NULL) {
+    *_ptvEventDispatch += _pTimer->GetHighPrecisionTimer()-tvStart;
+  }
+}
+
+// measure how many events per second can be sent and flushed, with and without the event arena
+void EntityEventsBenchmark(void *pArgs)
+{
+  INDEX ctEvents = NEXTARGUMENT(INDEX);
+  INDEX ctEventsPerTick = NEXTARGUMENT(INDEX);
+  ctEvents = Clamp(ctEvents, INDEX(1), INDEX(10000000));
+  ctEventsPerTick = Clamp(ctEventsPerTick, INDEX(1), ctEvents);
+
+  CWorld &wo = _pNetwork->ga_World;
+  if (wo.wo_cenEntities.Count()==0) {
+    CPrintF(TRANS("No world loaded!\n"));
+    return;
+  }
+  if (_aseSentEvents.Count()>0) {
+    CPrintF(TRANS("There are unhandled events, try again later.\n"));
+    return;
+  }
+  CSetFPUPrecision FPUPrecision(FPT_24BIT);
+
+  // events are sent to a destroyed entity, so only copying is measured and not handling
+  const ULONG ulEntityID = wo.wo_ulNextEntityID;
+  CEntityPointer penTarget = wo.CreateEntity(
+    CPlacement3D(FLOAT3D(0,0,0), ANGLE3D(0,0,0)), wo.wo_cenEntities[0].en_pecClass);
+  penTarget->Destroy();
+
+  // typical events (with and without entity pointers)
+  EDamage eDamage;
+  eDamage.penInflictor = wo.wo_cenEntities.Pointer(0);
+  eDamage.fAmount = 10.0f;
+  ETouch eTouch;
+  eTouch.penOther = wo.wo_cenEntities.Pointer(0);
+  ETimer eTimer;
+
+  const INDEX bArenaOld = ent_bEventArena;
+  DOUBLE atmSeconds[2];
+  for (INDEX iArena=0; iArena<2; iArena++) {
+    ent_bEventArena = iArena;
+    CTimerValue tvStart = _pTimer->GetHighPrecisionTimer();
+    for (INDEX iFirst=0; iFirst<ctEvents; iFirst+=ctEventsPerTick) {
+      const INDEX ctTick = Min(ctEventsPerTick, ctEvents-iFirst);
+      for (INDEX iEvent=0; iEvent<ctTick; iEvent++) {
+        switch (iEvent%3) {
+        case 0: penTarget->SendEvent(eDamage); break;
+        case 1: penTarget->SendEvent(eTouch);  break;
+        case 2: penTarget->SendEvent(eTimer);  break;
+        }
+      }
+      HandleSentEvents();
+    }
+    atmSeconds[iArena] = (_pTimer->GetHighPrecisionTimer()-tvStart).GetSeconds();
+  }
+  ent_bEventArena = bArenaOld;
+
+  penTarget = NULL;
+  wo.wo_ulNextEntityID = ulEntityID;
+
+  CPrintF(TRANS("%d events in ticks of %d:\n"), ctEvents, ctEventsPerTick);
+  CPrintF(TRANS("  heap copies:  %.0f events/s\n"), ctEvents/Max(atmSeconds[0], 1E-6));
+  CPrintF(TRANS("  arena copies: %.0f events/s\n"), ctEvents/Max(atmSeconds[1], 1E-6));
+  CPrintF(TRANS("  arena chunks: %d (%d KB)\n"), _apubEventChunks.Count(),
+    _apubEventChunks.Count()*EVENTARENA_CHUNKSIZE/1024);
+}
+
+// measure range queries with many models in one sector, the old and the new way
+void EntityRangeQueryBenchmark(void *pArgs)
+{
+  INDEX ctModels = NEXTARGUMENT(INDEX);
+  INDEX ctQueries = NEXTARGUMENT(INDEX);
+  ctModels = Clamp(ctModels, INDEX(1), INDEX(100000));
+  ctQueries = Clamp(ctQueries, INDEX(1), INDEX(10000000));
+
+  CWorld &wo = _pNetwork->ga_World;
+  if (wo.wo_cenEntities.Count()==0) {
+    CPrintF(TRANS("No world loaded!\n"));
+    return;
+  }
+  CSetFPUPrecision FPUPrecision(FPT_24BIT);
+
+  // find largest sector of all zoning brushes
+  CBrushSector *pbscLargest = NULL;
+  FLOAT fLargest = -1.0f;
+  {FOREACHINDYNAMICARRAY(wo.wo_baBrushes.ba_abrBrushes, CBrush3D, itbr) {
+    CEntity *penBrush = itbr->br_penEntity;
+    if (penBrush==NULL || !(penBrush->en_ulFlags&ENF_ZONING) || itbr->GetFirstMip()==NULL) {
+      continue;
+    }
+    FOREACHINDYNAMICARRAY(itbr->GetFirstMip()->bm_abscSectors, CBrushSector, itbsc) {
+      const FLOAT3D vSize = itbsc->bsc_boxBoundingBox.Size();
+      const FLOAT fVolume = vSize(1)*vSize(2)*vSize(3);
+      if (fVolume>fLargest) {
+        fLargest = fVolume;
+        pbscLargest = itbsc;
+      }
+    }
+  }}
+  if (pbscLargest==NULL) {
+    CPrintF(TRANS("No zoning sectors in world!\n"));
+    return;
+  }
+  const FLOATaabbox3D boxSector = pbscLargest->bsc_boxBoundingBox;
+  const FLOAT3D vSectorSize = boxSector.Size();
+
+  // pseudo-random numbers that don't touch the game's random seed
+  ULONG ulSeed = 0x12345678;
+  #define BENCH_RND() (ulSeed = ulSeed*1103515245+12345, FLOAT((ulSeed>>8)&0xFFFF)/65535.0f)
+
+  // create temporary model entities in that sector (never initialized, only classified)
+  const ULONG ulEntityID = wo.wo_ulNextEntityID;
+  CDynamicContainer<CEntity> cenModels;
+  for (INDEX iModel=0; iModel<ctModels; iModel++) {
+    const FLOAT3D vPos(
+      boxSector.Min()(1)+vSectorSize(1)*BENCH_RND(),
+      boxSector.Min()(2)+vSectorSize(2)*BENCH_RND(),
+      boxSector.Min()(3)+vSectorSize(3)*BENCH_RND());
+    CEntity *pen = wo.CreateEntity(CPlacement3D(vPos, ANGLE3D(0,0,0)), wo.wo_cenEntities[0].en_pecClass);
+    pen->AddReference();
+    pen->Destroy();
+    pen->en_RenderType = CEntity::RT_EDITORMODEL;
+    pen->en_fSpatialClassificationRadius = 1.0f;
+    AddRelationPairTailTail(pbscLargest->bsc_rsEntities, pen->en_rdSectors);
+    cenModels.Add(pen);
+  }
+
+  // query boxes are an eighth of the sector in size
+  CStaticArray<FLOATaabbox3D> aboxQueries;
+  aboxQueries.New(ctQueries);
+  for (INDEX iQuery=0; iQuery<ctQueries; iQuery++) {
+    const FLOAT3D vCenter(
+      boxSector.Min()(1)+vSectorSize(1)*BENCH_RND(),
+      boxSector.Min()(2)+vSectorSize(2)*BENCH_RND(),
+      boxSector.Min()(3)+vSectorSize(3)*BENCH_RND());
+    aboxQueries[iQuery] = FLOATaabbox3D(vCenter, vSectorSize.Length()/16.0f);
+  }
+  #undef BENCH_RND
+
+  // run all queries both ways, remembering results of the old way for comparison
+  CEntity &enQuerier = cenModels[0];
+  CStaticStackArray<CEntity*> apenOld;
+  CStaticStackArray<INDEX> actOld;
+  CDynamicContainer<CEntity> cenFound;
+  INDEX ctFound = 0;
+  INDEX ctMismatches = 0;
+  const INDEX bIndexedOld = ent_bIndexedRangeQuery;
+  DOUBLE atmSeconds[2];
+  for (INDEX iIndexed=0; iIndexed<2; iIndexed++) {
+    ent_bIndexedRangeQuery = iIndexed;
+    INDEX iOld = 0;
+    CTimerValue tvStart = _pTimer->GetHighPrecisionTimer();
+    for (INDEX iQuery=0; iQuery<ctQueries; iQuery++) {
+      cenFound.Clear();
+      enQuerier.FindEntitiesInRange(aboxQueries[iQuery], cenFound, FALSE);
+      if (!iIndexed) {
+        ctFound += cenFound.Count();
+        actOld.Push() = cenFound.Count();
+        for (INDEX i=0; i<cenFound.Count(); i++) {
+          apenOld.Push() = cenFound.Pointer(i);
+        }
+        continue;
+      }
+      // same entities must be found (order of zoning brushes may differ)
+      BOOL bSame = cenFound.Count()==actOld[iQuery];
+      for (INDEX i=0; bSame && i<actOld[iQuery]; i++) {
+        bSame = cenFound.IsMember(apenOld[iOld+i]);
+      }
+      iOld += actOld[iQuery];
+      if (!bSame) {
+        ctMismatches++;
+      }
+    }
+    atmSeconds[iIndexed] = (_pTimer->GetHighPrecisionTimer()-tvStart).GetSeconds();
+  }
+  ent_bIndexedRangeQuery = bIndexedOld;
+  cenFound.Clear();
+
+  // remove temporary entities
+  {FOREACHINDYNAMICCONTAINER(cenModels, CEntity, iten) {
+    iten->en_rdSectors.Clear();
+    iten->en_RenderType = CEntity::RT_NONE;
+  }}
+  for (INDEX iModel=0; iModel<cenModels.Count(); iModel++) {
+    cenModels.Pointer(iModel)->RemReference();
+  }
+  cenModels.Clear();
+  wo.wo_ulNextEntityID = ulEntityID;
+
+  CPrintF(TRANS("%d range queries with %d models in one sector (%.1f found per query):\n"),
+    ctQueries, ctModels, FLOAT(ctFound)/ctQueries);
+  CPrintF(TRANS("  all entities + IsMember(): %.0f queries/s\n"), ctQueries/Max(atmSeconds[0], 1E-6));
+  CPrintF(TRANS("  brush archive + stamps:    %.0f queries/s\n"), ctQueries/Max(atmSeconds[1], 1E-6));
+  if (ctMismatches>0) {
+    CPrintF(TRANS("  results differ in %d queries!\n"), ctMismatches);
+  } else {
+    CPrintF(TRANS("  results are identical\n"));
+  }
 }
 
 /////////////////////////////////////////////////////////////////////
@@ -181,6 +181,7 @@ public:
   ULONG en_ulSpawnFlags;          // in what game types is this entity active
   INDEX en_ctReferences;          // reference counter for delayed destruction
   ULONG en_ulID;                  // unique entity identifier
+  ULONG en_ulRangeQueryMark;      // stamp of last range query that found this entity
 
   CPlacement3D en_plPlacement;      // placement in world space
   FLOATmatrix3D en_mRotation;       // precalc. matrix for object rotation
@@ -227,6 +228,11 @@ public:
   /* Copy one entity property from property of another entity. */
   void CopyOneProperty( CEntityProperty &epPropertySrc, CEntityProperty &epPropertyDest,
                         CEntity &enOther, ULONG ulFlags);
+  /* Read, write or copy one property value of given type
+     (used by property tables and by serializers generated by Ecc). */
+  void ReadOneProperty_t(CTStream &istrm, ULONG ulType, void *pvProperty);  // throw char *
+  void WriteOneProperty_t(CTStream &ostrm, ULONG ulType, void *pvProperty); // throw char *
+  void CopyOnePropertyValue(ULONG ulType, void *pvDest, void *pvSrc, ULONG ulFlags);
 
   /* Read all properties from a stream. */
   void ReadProperties_t(CTStream &istrm);  // throw char *
@@ -270,6 +276,8 @@ public:
   // make predictor (complete raw copy with all states/variables and 
   // making predictor/predicted links)
 #define COPY_PREDICTOR  (1UL<<2)  
+  // refresh predictor kept from last prediction (reuse its model objects and buffers)
+#define COPY_REFRESH    (1UL<<3)
   virtual void Copy(CEntity &enOther, ULONG ulFlags);
   virtual CEntity &operator=(CEntity &enOther) {ASSERT(FALSE); return *this;};
   // find a pointer to another entity while copying
@@ -455,6 +463,8 @@ public:
 
   /* Destroy this entity (entity must not be targetable). */
   void Destroy(void);
+  /* Take predictor out of the world, but keep it for reuse in next prediction. */
+  void SuspendPredictor(void);
 
   /* Get state transition for given state and event code. */
   virtual CEntity::pEventHandler HandlerForStateAndEvent(SLONG slState, SLONG slEvent);
@@ -22,12 +22,19 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <Engine/Entities/Precaching.h>
 #include <Engine/Base/Translation.h>
 #include <Engine/Base/CRCTable.h>
+#include <Engine/Base/Memory.h>
+#include <Engine/Base/Console.h>
+#include <Engine/Base/Shell.h>
+#include <Engine/Base/Timer.h>
+#include <Engine/Math/Functions.h>
+#include <Engine/World/World.h>
 
 #include <Engine/Templates/Stock_CAnimData.h>
 #include <Engine/Templates/Stock_CTextureData.h>
 #include <Engine/Templates/Stock_CModelData.h>
 #include <Engine/Templates/Stock_CSoundData.h>
 #include <Engine/Templates/Stock_CEntityClass.h>
+#include <Engine/Templates/DynamicContainer.cpp>
 
 #include <Engine/Templates/Stock_CEntityClass.h>
 
@@ -83,6 +90,7 @@ void CEntityClass::Clear(void)
   if (ec_hiClassDLL != NULL) {
     // detach the DLL
     ec_pdecDLLClass->dec_OnEndClass();
+    ec_pdecDLLClass->ClearLookupTables();
 
     // release all components needed by the DLL
     ReleaseComponents();
@@ -388,6 +396,129 @@ const char *CEntityPropertyEnumType::NameForValue(INDEX iValue)
   return "";
 }
 
+/////////////////////////////////////////////////////////////////////
+// Sorted lookup tables
+
+// use sorted tables for finding properties and handlers (instead of scanning class by class)
+extern INDEX ent_bClassLookupTables = TRUE;
+
+// properties and handlers of a class and all of its bases, sorted by ID
+// (entries of derived classes hide entries with same ID in base classes)
+struct CEntityClassLookup {
+  INDEX ecl_ctProperties;
+  CEntityProperty **ecl_apepProperties;
+  INDEX ecl_ctHandlers;
+  CEventHandlerEntry **ecl_apeheHandlers;
+};
+
+static inline ULONG KeyOf(const CEntityProperty *pep)     { return pep->ep_ulID; }
+static inline ULONG KeyOf(const CEventHandlerEntry *pehe) { return (ULONG)pehe->ehe_slState; }
+
+// merge entries of a base class into already sorted entries, skipping the hidden ones
+template<class Type>
+static INDEX MergeByKey( Type **apDst, Type **apDerived, INDEX ctDerived, Type **apBase, INDEX ctBase)
+{
+  INDEX iDerived=0, iBase=0, ctDst=0;
+  while (iDerived<ctDerived || iBase<ctBase) {
+    Type *p;
+    if (iBase>=ctBase || (iDerived<ctDerived && KeyOf(apDerived[iDerived])<=KeyOf(apBase[iBase]))) {
+      p = apDerived[iDerived++];
+    } else {
+      p = apBase[iBase++];
+    }
+    // first of same IDs wins (derived before base, earlier declared before later)
+    if (ctDst>0 && KeyOf(apDst[ctDst-1])==KeyOf(p)) continue;
+    apDst[ctDst++] = p;
+  }
+  return ctDst;
+}
+
+// get entries of one class in order of their IDs
+template<class Type>
+static void SortedEntries( Type **apDst, Type *aEntries, INDEX ctEntries, const INDEX *aiOrder)
+{
+  INDEX i;
+  // if class has order generated by Ecc
+  if (aiOrder!=NULL) {
+    for (i=0; i<ctEntries; i++) apDst[i] = &aEntries[aiOrder[i]];
+    return;
+  }
+  // otherwise sort them here (insertion sort keeps declaration order for same IDs)
+  for (i=0; i<ctEntries; i++) {
+    Type *p = &aEntries[i];
+    INDEX j = i;
+    for (; j>0 && KeyOf(apDst[j-1])>KeyOf(p); j--) apDst[j] = apDst[j-1];
+    apDst[j] = p;
+  }
+}
+
+// build lookup tables for whole inheritance chain
+template<class Type>
+static INDEX MakeChainTable( Type **&apTable, CDLLEntityClass *pdec,
+  Type *CDLLEntityClass::*paEntries, INDEX CDLLEntityClass::*pctEntries, const INDEX *CDLLEntityClass::*paiOrder)
+{
+  // count all entries in chain
+  INDEX ctAll = 0;
+  CDLLEntityClass *pdecChain;
+  for (pdecChain=pdec; pdecChain!=NULL; pdecChain=pdecChain->dec_pdecBase) {
+    ctAll += pdecChain->*pctEntries;
+  }
+  apTable = (Type **)AllocMemory(Max(ctAll,(INDEX)1)*sizeof(Type*));
+  Type **apClass = (Type **)AllocMemory(Max(ctAll,(INDEX)1)*sizeof(Type*));
+  Type **apMerged = (Type **)AllocMemory(Max(ctAll,(INDEX)1)*sizeof(Type*));
+  // merge classes from most derived one to the base one
+  INDEX ctTable = 0;
+  for (pdecChain=pdec; pdecChain!=NULL; pdecChain=pdecChain->dec_pdecBase) {
+    const INDEX ctClass = pdecChain->*pctEntries;
+    if (ctClass==0) continue;
+    SortedEntries(apClass, pdecChain->*paEntries, ctClass, pdecChain->*paiOrder);
+    ctTable = MergeByKey(apMerged, apTable, ctTable, apClass, ctClass);
+    Swap(apTable, apMerged);
+  }
+  FreeMemory(apClass);
+  FreeMemory(apMerged);
+  return ctTable;
+}
+
+static CEntityClassLookup *GetLookup(CDLLEntityClass *pdec)
+{
+  if (pdec->dec_pecl!=NULL) {
+    return pdec->dec_pecl;
+  }
+  CEntityClassLookup *pecl = (CEntityClassLookup *)AllocMemory(sizeof(CEntityClassLookup));
+  pecl->ecl_ctProperties = MakeChainTable(pecl->ecl_apepProperties, pdec,
+    &CDLLEntityClass::dec_aepProperties, &CDLLEntityClass::dec_ctProperties, &CDLLEntityClass::dec_aiPropertiesByID);
+  pecl->ecl_ctHandlers = MakeChainTable(pecl->ecl_apeheHandlers, pdec,
+    &CDLLEntityClass::dec_aeheHandlers, &CDLLEntityClass::dec_ctHandlers, &CDLLEntityClass::dec_aiHandlersByState);
+  pdec->dec_pecl = pecl;
+  return pecl;
+}
+
+// binary search in sorted table
+template<class Type>
+static Type *FindByKey( Type **apTable, INDEX ctTable, ULONG ulKey)
+{
+  INDEX iLow=0, iHigh=ctTable;
+  while (iLow<iHigh) {
+    const INDEX iMid = (iLow+iHigh)/2;
+    const ULONG ulMid = KeyOf(apTable[iMid]);
+    if (ulMid==ulKey) return apTable[iMid];
+    if (ulMid<ulKey) iLow = iMid+1;
+    else             iHigh = iMid;
+  }
+  return NULL;
+}
+
+/* Free lookup tables (they are rebuilt on next use). */
+void CDLLEntityClass::ClearLookupTables(void)
+{
+  if (dec_pecl==NULL) return;
+  FreeMemory(dec_pecl->ecl_apepProperties);
+  FreeMemory(dec_pecl->ecl_apeheHandlers);
+  FreeMemory(dec_pecl);
+  dec_pecl = NULL;
+}
+
 /*
  * Get pointer to entity property from its name.
  */
@@ -418,6 +549,18 @@ class CEntityProperty *CDLLEntityClass::PropertyForName(const CTString &strPrope
 class CEntityProperty *CDLLEntityClass::PropertyForTypeAndID(
   CEntityProperty::PropertyType eptType, ULONG ulID)
 {
+  // if using sorted tables
+  if (ent_bClassLookupTables) {
+    // find property with that identifier in whole inheritance chain
+    CEntityClassLookup *pecl = GetLookup(this);
+    CEntityProperty *pep = FindByKey(pecl->ecl_apepProperties, pecl->ecl_ctProperties, ulID);
+    // it must also have same type, this makes the whole thing much safer
+    if (pep!=NULL && pep->ep_eptType!=eptType) {
+      return NULL;
+    }
+    return pep;
+  }
+
   // for each property
   for (INDEX iProperty=0; iProperty<dec_ctProperties; iProperty++) {
     // if it has that same identifier
@@ -554,6 +697,14 @@ CEntity::pEventHandler CDLLEntityClass::HandlerForStateAndEvent(SLONG slState, S
   // we ignore the event code here
   (void) slEvent;
 
+  // if using sorted tables
+  if (ent_bClassLookupTables) {
+    // find handler for that state in whole inheritance chain
+    CEntityClassLookup *pecl = GetLookup(this);
+    CEventHandlerEntry *pehe = FindByKey(pecl->ecl_apeheHandlers, pecl->ecl_ctHandlers, (ULONG)slState);
+    return pehe!=NULL ? pehe->ehe_pEventHandler : NULL;
+  }
+
   // for each handler
   for (INDEX iHandler=0; iHandler<dec_ctHandlers; iHandler++) {
     // if it has that same state
@@ -576,6 +727,13 @@ CEntity::pEventHandler CDLLEntityClass::HandlerForStateAndEvent(SLONG slState, S
 /* Get event handler name for given state. */
 const char *CDLLEntityClass::HandlerNameForState(SLONG slState)
 {
+  // if using sorted tables
+  if (ent_bClassLookupTables) {
+    CEntityClassLookup *pecl = GetLookup(this);
+    CEventHandlerEntry *pehe = FindByKey(pecl->ecl_apeheHandlers, pecl->ecl_ctHandlers, (ULONG)slState);
+    return pehe!=NULL ? pehe->ehe_strName : "no handler!?";
+  }
+
   // for each handler
   for (INDEX iHandler=0; iHandler<dec_ctHandlers; iHandler++) {
     // if it has that same state
@@ -617,3 +775,69 @@ SLONG CDLLEntityClass::GetOverridenState(SLONG slState)
     return slState;
   }
 }
+
+
+// look up every handler and property of every entity in the world by its ID
+static INDEX LookupAllEntries(CWorld &wo)
+{
+  INDEX ctLookups = 0;
+  FOREACHINDYNAMICCONTAINER(wo.wo_cenEntities, CEntity, iten) {
+    CDLLEntityClass *pdec = iten->en_pecClass->ec_pdecDLLClass;
+    for (CDLLEntityClass *pdecChain=pdec; pdecChain!=NULL; pdecChain=pdecChain->dec_pdecBase) {
+      INDEX i;
+      for (i=0; i<pdecChain->dec_ctHandlers; i++) {
+        pdec->HandlerForStateAndEvent(pdecChain->dec_aeheHandlers[i].ehe_slState, 0);
+      }
+      for (i=0; i<pdecChain->dec_ctProperties; i++) {
+        const CEntityProperty &ep = pdecChain->dec_aepProperties[i];
+        pdec->PropertyForTypeAndID(ep.ep_eptType, ep.ep_ulID);
+      }
+      ctLookups += pdecChain->dec_ctHandlers + pdecChain->dec_ctProperties;
+    }
+  }
+  return ctLookups;
+}
+
+// compare world loading and handler/property lookups with and without sorted tables
+void EntityLookupBenchmark(void *pArgs)
+{
+  CTString strWorld = *NEXTARGUMENT(CTString*);
+  const INDEX bTablesOld = ent_bClassLookupTables;
+
+  // keep one copy loaded so that all resources stay in stocks while measuring
+  CWorld woWarmUp;
+  try {
+    woWarmUp.Load_t(CTFileName(strWorld));
+  } catch (char *strError) {
+    CPrintF("%s\n", strError);
+    return;
+  }
+
+  CPrintF(TRANS("Entity lookup benchmark on '%s' (%d entities):\n"),
+    (const char *)strWorld, woWarmUp.wo_cenEntities.Count());
+  for (INDEX iPass=0; iPass<2; iPass++) {
+    ent_bClassLookupTables = iPass;
+    CWorld wo;
+    CTimerValue tv0 = _pTimer->GetHighPrecisionTimer();
+    try {
+      wo.Load_t(CTFileName(strWorld));
+    } catch (char *strError) {
+      CPrintF("%s\n", strError);
+      break;
+    }
+    const DOUBLE dLoad = (_pTimer->GetHighPrecisionTimer()-tv0).GetSeconds();
+
+    const INDEX ctRepeats = 20;
+    INDEX ctLookups = 0;
+    tv0 = _pTimer->GetHighPrecisionTimer();
+    for (INDEX iRepeat=0; iRepeat<ctRepeats; iRepeat++) {
+      ctLookups += LookupAllEntries(wo);
+    }
+    const DOUBLE dLookups = (_pTimer->GetHighPrecisionTimer()-tv0).GetSeconds();
+    CPrintF(TRANS("  %-14s: world load %8.2f ms, %d lookups in %7.2f ms (%.1f M/s)\n"),
+      iPass ? "sorted tables" : "linear scan", dLoad*1000.0, ctLookups, dLookups*1000.0,
+      ctLookups/Max(dLookups,1E-9)/1E6);
+  }
+  ent_bClassLookupTables = bTablesOld;
+}
+
@@ -28,6 +28,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <Engine/World/World.h>
 #include <Engine/Math/Float.h>
 #include <Engine/Math/Quaternion.h>
+#include <Engine/Math/Geometry.h>
 
 #include <Engine/Brushes/BrushArchive.h>
 #include <Engine/Light/LightSource.h>
@@ -43,6 +44,7 @@ class CPointerRemapping {
 public:
   CEntity *pr_penOriginal;
   CEntity *pr_penCopy;
+  BOOL pr_bRefresh;     // copy is a suspended predictor that is refreshed
 
   inline void Clear(void) {};
 };
@@ -126,6 +128,7 @@ void CEntity::Copy(CEntity &enOther, ULONG ulFlags)
 {
   BOOL bRemapPointers = ulFlags & COPY_REMAP;
   BOOL bMakePredictor = ulFlags & COPY_PREDICTOR;
+  BOOL bRefresh = ulFlags & COPY_REFRESH;
 
   // copy base class data
   en_RenderType     = enOther.en_RenderType;
@@ -165,18 +168,24 @@ void CEntity::Copy(CEntity &enOther, ULONG ulFlags)
   } if ( enOther.en_RenderType == RT_MODEL || en_RenderType == RT_EDITORMODEL) {
     // if will not initialize
     if (!(ulFlags&COPY_REINIT)) {
-      // create a new model object
-      en_pmoModelObject = new CModelObject;
-      en_psiShadingInfo = new CShadingInfo;
+      // create a new model object (unless refreshing one that already has it)
+      if (!bRefresh || en_pmoModelObject==NULL) {
+        ASSERT(en_pmoModelObject==NULL);
+        en_pmoModelObject = new CModelObject;
+        en_psiShadingInfo = new CShadingInfo;
+      }
       en_ulFlags &= ~ENF_VALIDSHADINGINFO;
       // copy it
       en_pmoModelObject->Copy(*enOther.en_pmoModelObject);
     }
   // if this is ska model
   } else if ( enOther.en_RenderType == RT_SKAMODEL || en_RenderType == RT_SKAEDITORMODEL) {
-      en_psiShadingInfo = new CShadingInfo;
+      if (!bRefresh || en_pmiModelInstance==NULL) {
+        ASSERT(en_pmiModelInstance==NULL);
+        en_psiShadingInfo = new CShadingInfo;
+        en_pmiModelInstance = CreateModelInstance("Temp");
+      }
       en_ulFlags &= ~ENF_VALIDSHADINGINFO;
-      en_pmiModelInstance = CreateModelInstance("Temp");
       // copy it
       GetModelInstance()->Copy(*enOther.GetModelInstance());
   }
@@ -208,7 +217,14 @@ void CEntity::Copy(CEntity &enOther, ULONG ulFlags)
     enOther.en_pwoWorld->wo_cenPredictor.Add(this);
     // copy last positions
     if (enOther.en_plpLastPositions!=NULL) {
-      en_plpLastPositions = new CLastPositions(*enOther.en_plpLastPositions);
+      if (en_plpLastPositions!=NULL) {
+        *en_plpLastPositions = *enOther.en_plpLastPositions;
+      } else {
+        en_plpLastPositions = new CLastPositions(*enOther.en_plpLastPositions);
+      }
+    } else if (en_plpLastPositions!=NULL) {
+      delete en_plpLastPositions;
+      en_plpLastPositions = NULL;
     }
   }
 }
@@ -218,14 +234,22 @@ void CEntity::Copy(CEntity &enOther, ULONG ulFlags)
  */
 void CEntity::CopyOneProperty( CEntityProperty &epPropertySrc, CEntityProperty &epPropertyDest,
                                CEntity &enOther, ULONG ulFlags)
+{
+  CopyOnePropertyValue( epPropertySrc.ep_eptType,
+    &ENTITYPROPERTY(this, epPropertyDest.ep_slOffset, UBYTE),
+    &ENTITYPROPERTY(&enOther, epPropertySrc.ep_slOffset, UBYTE), ulFlags);
+}
+
+/*
+ * Copy one property value of given type.
+ */
+void CEntity::CopyOnePropertyValue( ULONG ulType, void *pvDest, void *pvSrc, ULONG ulFlags)
 {
 // a helper macro
-#define COPYPROPERTY(type)                                            \
-  (type &)ENTITYPROPERTY(this, epPropertyDest.ep_slOffset, type)      \
-    = (type &)ENTITYPROPERTY(&enOther, epPropertySrc.ep_slOffset, type)
+#define COPYPROPERTY(type) *(type *)pvDest = *(type *)pvSrc
 
   // depending on the property type
-  switch (epPropertySrc.ep_eptType) {
+  switch (ulType) {
   // if it is BOOL
   case CEntityProperty::EPT_BOOL:
     // copy BOOL
@@ -299,8 +323,7 @@ void CEntity::CopyOneProperty( CEntityProperty &epPropertySrc, CEntityProperty &
   case CEntityProperty::EPT_ENTITYPTR:
     // remap and copy the pointer
     if (ulFlags & COPY_REMAP) {
-      ENTITYPROPERTY(this, epPropertyDest.ep_slOffset, CEntityPointer) =
-        FindRemappedEntityPointer(ENTITYPROPERTY(&enOther, epPropertySrc.ep_slOffset, CEntityPointer));
+      *(CEntityPointer *)pvDest = FindRemappedEntityPointer(*(CEntityPointer *)pvSrc);
     // copy CEntityPointer
     } else {
       COPYPROPERTY(CEntityPointer);
@@ -309,30 +332,27 @@ void CEntity::CopyOneProperty( CEntityProperty &epPropertySrc, CEntityProperty &
   // if it is MODELOBJECT
   case CEntityProperty::EPT_MODELOBJECT:
     // copy CModelObject
-    ENTITYPROPERTY(this, epPropertyDest.ep_slOffset, CModelObject).
-      Copy(ENTITYPROPERTY(&enOther, epPropertySrc.ep_slOffset, CModelObject));
+    ((CModelObject *)pvDest)->Copy(*(CModelObject *)pvSrc);
     // model objects are not copied, but should be initialized in Main()
     break;
   // if it is MODELINSTANCE
   case CEntityProperty::EPT_MODELINSTANCE:
     // copy CModelInstance
-    ENTITYPROPERTY(this, epPropertyDest.ep_slOffset, CModelInstance).
-      Copy(ENTITYPROPERTY(&enOther, epPropertySrc.ep_slOffset, CModelInstance));
+    ((CModelInstance *)pvDest)->Copy(*(CModelInstance *)pvSrc);
     // model objects are not copied, but should be initialized in Main()
     break;
   // if it is ANIMOBJECT
   case CEntityProperty::EPT_ANIMOBJECT:
     // copy CAnimObject
-    ENTITYPROPERTY(this, epPropertyDest.ep_slOffset, CAnimObject).
-      Copy(ENTITYPROPERTY(&enOther, epPropertySrc.ep_slOffset, CAnimObject));
+    ((CAnimObject *)pvDest)->Copy(*(CAnimObject *)pvSrc);
     break;
   // if it is SOUNDOBJECT
   case CEntityProperty::EPT_SOUNDOBJECT:
     {
       if (!(ulFlags & COPY_PREDICTOR)) {
         // copy CSoundObject
-        CSoundObject &so = ENTITYPROPERTY(this, epPropertyDest.ep_slOffset, CSoundObject);
-        so.Copy(ENTITYPROPERTY(&enOther, epPropertySrc.ep_slOffset, CSoundObject));
+        CSoundObject &so = *(CSoundObject *)pvDest;
+        so.Copy(*(CSoundObject *)pvSrc);
         so.so_penEntity = this;
       }
     }
@@ -355,11 +375,17 @@ void CEntity::CopyEntityProperties(CEntity &enOther, ULONG ulFlags)
   // other entity must have same class
   ASSERT(enOther.en_pecClass == en_pecClass);
 
+  extern INDEX ent_bPropertySerializers;
   // for all classes in hierarchy of this entity
   for(CDLLEntityClass *pdecDLLClass = en_pecClass->ec_pdecDLLClass;
       pdecDLLClass!=NULL;
       pdecDLLClass = pdecDLLClass->dec_pdecBase) {
 
+    // if the class has a copier generated by Ecc, use it
+    if (ent_bPropertySerializers && pdecDLLClass->dec_CopyProperties!=NULL) {
+      pdecDLLClass->dec_CopyProperties(this, &enOther, ulFlags);
+      continue;
+    }
     // for all properties
     for(INDEX iProperty=0; iProperty<pdecDLLClass->dec_ctProperties; iProperty++) {
       CEntityProperty &epProperty = pdecDLLClass->dec_aepProperties[iProperty];
@@ -425,6 +451,7 @@ void CWorld::CopyEntities(CWorld &woOther, CDynamicContainer<CEntity> &cenToCopy
     // remember its remap pointer
     _aprRemaps[iRemap].pr_penOriginal = &enToCopy;
     _aprRemaps[iRemap].pr_penCopy = penNew;
+    _aprRemaps[iRemap].pr_bRefresh = FALSE;
     iRemap++;
   }}
 
@@ -628,15 +655,16 @@ void CWorld::CopyEntitiesToPredictors(CDynamicContainer<CEntity> &cenToCopy)
 {
   INDEX ctEntities = cenToCopy.Count();
   if (ctEntities<=0) {
+    DeletePredictorPool();
     return;
   }
 
   extern INDEX cli_bReportPredicted;
   if (cli_bReportPredicted) {
-    CPrintF( TRANS("Predicting %d entities:\n"), ctEntities);
+    CLogF(LC_PREDICTION, LS_DEBUG, TRANS("Predicting %d entities:\n"), ctEntities);
     {FOREACHINDYNAMICCONTAINER(cenToCopy, CEntity, itenToCopy) {
       CEntity &enToCopy = *itenToCopy;
-      CPrintF("  %s:%s\n", enToCopy.GetClass()->ec_pdecDLLClass->dec_strName, (const char*)enToCopy.GetName());
+      CLogF(LC_PREDICTION, LS_DEBUG, "  %s:%s\n", enToCopy.GetClass()->ec_pdecDLLClass->dec_strName, (const char*)enToCopy.GetName());
     }}
   }
 
@@ -650,6 +678,14 @@ void CWorld::CopyEntitiesToPredictors(CDynamicContainer<CEntity> &cenToCopy)
   _aprRemaps.Clear();
   _aprRemaps.New(ctEntities);
 
+  // point entities to their predictors that were suspended after last prediction
+  {FOREACHINDYNAMICCONTAINER(wo_cenPredictorPool, CEntity, itenPool) {
+    CEntity *penPredicted = itenPool->GetPredictionPair();
+    if (penPredicted!=NULL && penPredicted->en_RenderType==itenPool->en_RenderType) {
+      penPredicted->SetPredictionPair(itenPool);
+    }
+  }}
+
   // PASS 1: create entities
 
   // for each entity to copy
@@ -657,17 +693,38 @@ void CWorld::CopyEntitiesToPredictors(CDynamicContainer<CEntity> &cenToCopy)
   {FOREACHINDYNAMICCONTAINER(cenToCopy, CEntity, itenToCopy) {
     CEntity &enToCopy = *itenToCopy;
 
-    CEntity *penNew;
-
-    // create an entity of same class as the one to copy
-    penNew = CreateEntity(enToCopy.en_plPlacement, enToCopy.en_pecClass);
+    CEntity *penNew = enToCopy.GetPredictionPair();
+    const BOOL bRefresh = penNew!=NULL;
+    // if it has a suspended predictor
+    if (bRefresh) {
+      // put it back to the world, as if it was just created
+      ASSERT(penNew->en_pecClass==enToCopy.en_pecClass);
+      wo_cenPredictorPool.Remove(penNew);
+      wo_cenEntities.Add(penNew);
+      penNew->en_ulID = wo_ulNextEntityID++;
+      penNew->en_plPlacement = enToCopy.en_plPlacement;
+      MakeRotationMatrixFast(penNew->en_mRotation, penNew->en_plPlacement.pl_OrientationAngle);
+    } else {
+      // create an entity of same class as the one to copy
+      penNew = CreateEntity(enToCopy.en_plPlacement, enToCopy.en_pecClass);
+    }
 
     // remember its remap pointer
     _aprRemaps[iRemap].pr_penOriginal = &enToCopy;
     _aprRemaps[iRemap].pr_penCopy = penNew;
+    _aprRemaps[iRemap].pr_bRefresh = bRefresh;
     iRemap++;
     _ctPredictorEntities++;
   }}
+
+  // predictors that weren't reused are not needed anymore
+  {FOREACHINDYNAMICCONTAINER(wo_cenPredictorPool, CEntity, itenPool) {
+    CEntity *penPredicted = itenPool->GetPredictionPair();
+    if (penPredicted!=NULL && penPredicted->GetPredictionPair()==itenPool) {
+      penPredicted->SetPredictionPair(NULL);
+    }
+  }}
+  DeletePredictorPool();
   // unfound pointers must be kept unremapped
   _bRemapPointersToNULLs = FALSE;
 
@@ -679,7 +736,7 @@ void CWorld::CopyEntitiesToPredictors(CDynamicContainer<CEntity> &cenToCopy)
     CEntity *penCopy = itpr->pr_penCopy;
 
     // copy the entity from its original
-    penCopy->Copy(*penOriginal, ulCopyFlags);
+    penCopy->Copy(*penOriginal, ulCopyFlags|(itpr->pr_bRefresh?COPY_REFRESH:0));
     // if this is a brush
     if ( penOriginal->en_RenderType == CEntity::RT_BRUSH ||
          penOriginal->en_RenderType == CEntity::RT_FIELDBRUSH) {
@@ -19,6 +19,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
   #pragma once
 #endif
 
+#include <new.h>
+
 // a BOOL that is constructed with value of FALSE (used in some entity initializations)
 class ENGINE_API CBoolDefaultFalse {
 public:
@@ -41,7 +43,27 @@ public:
     CEntityEvent *peeCopy = new CEntityEvent(*this);
     return peeCopy;
   };
+  // size of the event object and copying into given memory (for copies in the event arena);
+  // events that don't report their size are copied with MakeCopy()
+  virtual SLONG GetSizeOf(void) {
+    return 0;
+  };
+  virtual CEntityEvent *MakeCopyAt(void *pvMemory);
 };
+
+// copy an event into given memory (debug operator new can't be used for that)
+#pragma push_macro("new")
+#undef new
+template<class Type>
+inline CEntityEvent *CopyEventAt(void *pvMemory, const Type &eeOriginal) {
+  return new(pvMemory) Type(eeOriginal);
+}
+#pragma pop_macro("new")
+
+inline CEntityEvent *CEntityEvent::MakeCopyAt(void *pvMemory) {
+  return CopyEventAt(pvMemory, *this);
+}
+
 // a reference to a void event for use as default parameter
 ENGINE_API extern const CEntityEvent &_eeVoid;
 
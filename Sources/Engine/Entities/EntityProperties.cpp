@@ -20,10 +20,13 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <Engine/Base/Stream.h>
 #include <Engine/Base/CRCTable.h>
 #include <Engine/Base/Console.h>
+#include <Engine/Base/Shell.h>
+#include <Engine/Base/Timer.h>
 #include <Engine/World/World.h>
 #include <Engine/Base/ReplaceFile.h>
 #include <Engine/Sound/SoundObject.h>
 #include <Engine/Math/Quaternion.h>
+#include <Engine/Math/Functions.h>
 
 #include <Engine/Templates/Stock_CAnimData.h>
 #include <Engine/Templates/Stock_CTextureData.h>
@@ -31,15 +34,237 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <Engine/Templates/Stock_CSoundData.h>
 #include <Engine/Templates/Stock_CEntityClass.h>
 #include <Engine/Templates/StaticArray.cpp>
+#include <Engine/Templates/DynamicContainer.cpp>
+#include <Engine/Templates/DynamicStackArray.cpp>
 
 #define FILTER_ALL            "All files (*.*)\0*.*\0"
 #define FILTER_END            "\0"
 
 #define PROPERTY(offset, type) ENTITYPROPERTY(this, offset, type)
 
+// use property serializers generated by Ecc instead of walking property tables
+extern INDEX ent_bPropertySerializers = TRUE;
+
 /////////////////////////////////////////////////////////////////////
 // Property management functions
 
+// count properties in whole inheritance chain
+static INDEX CountProperties(CDLLEntityClass *pdec)
+{
+  INDEX ctProperties = 0;
+  for (; pdec!=NULL; pdec=pdec->dec_pdecBase) {
+    ctProperties += pdec->dec_ctProperties;
+  }
+  return ctProperties;
+}
+
+// check if all classes in inheritance chain that have properties have generated serializers
+// (reader, writer and copier are always generated together)
+static BOOL HasSerializers(CDLLEntityClass *pdec)
+{
+  for (; pdec!=NULL; pdec=pdec->dec_pdecBase) {
+    if (pdec->dec_ctProperties>0 && pdec->dec_WriteProperties_t==NULL) {
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+// skip one property value of given type in a stream
+static void SkipOneProperty_t(CTStream &istrm, CEntityProperty::PropertyType eptType) // throw char *
+{
+  // depending on the property type
+  switch (eptType) {
+  // if it is BOOL
+  case CEntityProperty::EPT_BOOL: {
+    // skip BOOL
+    BOOL bDummy;
+    istrm>>(INDEX &)bDummy;
+    break;
+                                  }
+  // if it is INDEX
+  case CEntityProperty::EPT_INDEX:
+  case CEntityProperty::EPT_ENUM:
+  case CEntityProperty::EPT_FLAGS:
+  case CEntityProperty::EPT_ANIMATION:
+  case CEntityProperty::EPT_ILLUMINATIONTYPE:
+  case CEntityProperty::EPT_COLOR:
+  case CEntityProperty::EPT_ANGLE: {
+    // skip INDEX
+    INDEX iDummy;
+    istrm>>iDummy;
+
+  } break;
+  // if it is FLOAT
+  case CEntityProperty::EPT_FLOAT:
+  case CEntityProperty::EPT_RANGE: {
+    // skip FLOAT
+    FLOAT fDummy;
+    istrm>>fDummy;
+                                   }
+    break;
+  // if it is STRING
+  case CEntityProperty::EPT_STRING: {
+    // skip STRING
+    CTString strDummy;
+    istrm>>strDummy;
+    break;
+                                    }
+  // if it is STRINGTRANS
+  case CEntityProperty::EPT_STRINGTRANS: {
+    // skip STRINGTRANS
+    istrm.ExpectID_t("DTRS");
+    CTString strDummy;
+    istrm>>strDummy;
+    break;
+                                    }
+  // if it is FILENAME
+  case CEntityProperty::EPT_FILENAME: {
+    // skip FILENAME
+    CTFileName fnmDummy;
+    istrm>>fnmDummy;
+    break;
+                                      }
+  // if it is FILENAMENODEP
+  case CEntityProperty::EPT_FILENAMENODEP: {
+    // skip FILENAMENODEP
+    CTFileNameNoDep fnmDummy;
+    istrm>>fnmDummy;
+    break;
+                                    }
+  // if it is ENTITYPTR
+  case CEntityProperty::EPT_ENTITYPTR: {
+    // skip index
+    INDEX iDummy;
+    istrm>>iDummy;
+                                       }
+    break;
+  // if it is FLOATAABBOX3D
+  case CEntityProperty::EPT_FLOATAABBOX3D: {
+    // skip FLOATAABBOX3D
+    FLOATaabbox3D boxDummy;
+    istrm.Read_t(&boxDummy, sizeof(FLOATaabbox3D));
+                                           }
+    break;
+  // if it is FLOATMATRIX3D
+  case CEntityProperty::EPT_FLOATMATRIX3D: {
+    // skip FLOATMATRIX3D
+    FLOATmatrix3D boxDummy;
+    istrm.Read_t(&boxDummy, sizeof(FLOATmatrix3D));
+                                           }
+    break;
+  // if it is EPT_FLOATQUAT3D
+  case CEntityProperty::EPT_FLOATQUAT3D: {
+    // skip EPT_FLOATQUAT3D
+    FLOATquat3D qDummy;
+    istrm.Read_t(&qDummy, sizeof(FLOATquat3D));
+                                           }
+    break;
+  // if it is FLOAT3D
+  case CEntityProperty::EPT_FLOAT3D: {
+    // skip FLOAT3D
+    FLOAT3D vDummy;
+    istrm>>vDummy;
+                                     }
+    break;
+  // if it is ANGLE3D
+  case CEntityProperty::EPT_ANGLE3D: {
+    // skip ANGLE3D
+    ANGLE3D vDummy;
+    istrm>>vDummy;
+                                     }
+    break;
+  // if it is FLOATplane3D
+  case CEntityProperty::EPT_FLOATplane3D: {
+    // skip FLOATplane3D
+    FLOATplane3D plDummy;
+    istrm.Read_t(&plDummy, sizeof(plDummy));
+                                          }
+    break;
+  // if it is MODELOBJECT
+  case CEntityProperty::EPT_MODELOBJECT:
+    // skip CModelObject
+    SkipModelObject_t(istrm);
+    break;
+  // if it is MODELINSTANCE
+  case CEntityProperty::EPT_MODELINSTANCE:
+    SkipModelInstance_t(istrm);
+    break;
+  // if it is ANIMOBJECT
+  case CEntityProperty::EPT_ANIMOBJECT:
+    // skip CAnimObject
+    SkipAnimObject_t(istrm);
+    break;
+  // if it is SOUNDOBJECT
+  case CEntityProperty::EPT_SOUNDOBJECT:
+    // skip CSoundObject
+    SkipSoundObject_t(istrm);
+    break;
+  default:
+    ASSERTALWAYS("Unknown property type");
+  }
+}
+
+// check if any class in inheritance chain has model instance properties
+static BOOL HasModelInstances(CDLLEntityClass *pdec)
+{
+  for (; pdec!=NULL; pdec=pdec->dec_pdecBase) {
+    for (INDEX iProperty=0; iProperty<pdec->dec_ctProperties; iProperty++) {
+      if (pdec->dec_aepProperties[iProperty].ep_eptType==CEntityProperty::EPT_MODELINSTANCE) {
+        return TRUE;
+      }
+    }
+  }
+  return FALSE;
+}
+
+// check if properties in stream are laid out exactly as generated serializers expect them,
+// without reading anything into the entity (stream is left at its original position)
+static BOOL MatchesSerializers_t(CDLLEntityClass *pdec, CTStream &istrm) // throw char *
+{
+  const SLONG slPos = istrm.GetPos_t();
+  BOOL bMatches = TRUE;
+  try {
+    for (; pdec!=NULL && bMatches; pdec=pdec->dec_pdecBase) {
+      for (INDEX iProperty=0; iProperty<pdec->dec_ctProperties; iProperty++) {
+        CEntityProperty &ep = pdec->dec_aepProperties[iProperty];
+        ULONG ulIDAndType;
+        istrm>>ulIDAndType;
+        if (ulIDAndType!=((ep.ep_ulID<<8)|(ULONG)ep.ep_eptType)) {
+          bMatches = FALSE;
+          break;
+        }
+        SkipOneProperty_t(istrm, ep.ep_eptType);
+      }
+    }
+  // stream saved by a different version of the class might end before all expected properties
+  } catch (char *strError) {
+    (void)strError;
+    bMatches = FALSE;
+  }
+  istrm.SetPos_t(slPos);
+  return bMatches;
+}
+
+// read properties through generated serializers; if stream was saved by a different version of
+// the class, returns FALSE without reading anything, so it can be read through tables
+static BOOL ReadWithSerializers_t(CEntity *pen, CTStream &istrm, INDEX ctProperties) // throw char *
+{
+  CDLLEntityClass *pdec = pen->en_pecClass->ec_pdecDLLClass;
+  // (model instances cannot be skipped without loading their resources, so they are not checked)
+  if (!istrm.IsSeekable() || !HasSerializers(pdec) || ctProperties!=CountProperties(pdec)
+    || HasModelInstances(pdec) || !MatchesSerializers_t(pdec, istrm)) {
+    return FALSE;
+  }
+  for (; pdec!=NULL; pdec=pdec->dec_pdecBase) {
+    if (pdec->dec_ReadProperties_t!=NULL && !pdec->dec_ReadProperties_t(pen, istrm)) {
+      ThrowF_t(TRANS("Generated property reader of class '%s' doesn't match its property table"),
+        pdec->dec_strName);
+    }
+  }
+  return TRUE;
+}
+
 
 /*
  * Set all properties to default values.
@@ -102,6 +327,11 @@ void CEntity::ReadProperties_t(CTStream &istrm) // throw char *
   // of properties in the class (class might have changed))
   istrm>>ctProperties;
 
+  // if the stream matches current version of the class, read it through generated serializers
+  if (ent_bPropertySerializers && ReadWithSerializers_t(this, istrm, ctProperties)) {
+    return;
+  }
+
   // for all saved properties
   for(INDEX iProperty=0; iProperty<ctProperties; iProperty++) {
     pdecDLLClass->dec_ctProperties;
@@ -126,136 +356,8 @@ void CEntity::ReadProperties_t(CTStream &istrm) // throw char *
 
     // if it was not found
     if (pepProperty == NULL) {
-      // depending on the property type
-      switch (eptType) {
-      // if it is BOOL
-      case CEntityProperty::EPT_BOOL: {
-        // skip BOOL
-        BOOL bDummy;
-        istrm>>(INDEX &)bDummy;
-        break;
-                                      }
-      // if it is INDEX
-      case CEntityProperty::EPT_INDEX:
-      case CEntityProperty::EPT_ENUM:
-      case CEntityProperty::EPT_FLAGS:
-      case CEntityProperty::EPT_ANIMATION:
-      case CEntityProperty::EPT_ILLUMINATIONTYPE:
-      case CEntityProperty::EPT_COLOR:
-      case CEntityProperty::EPT_ANGLE: {
-        // skip INDEX
-        INDEX iDummy;
-        istrm>>iDummy;
-
-      } break;
-      // if it is FLOAT
-      case CEntityProperty::EPT_FLOAT:
-      case CEntityProperty::EPT_RANGE: {
-        // skip FLOAT
-        FLOAT fDummy;
-        istrm>>fDummy;
-                                       }
-        break;
-      // if it is STRING
-      case CEntityProperty::EPT_STRING: {
-        // skip STRING
-        CTString strDummy;
-        istrm>>strDummy;
-        break;
-                                        }
-      // if it is STRINGTRANS
-      case CEntityProperty::EPT_STRINGTRANS: {
-        // skip STRINGTRANS
-        istrm.ExpectID_t("DTRS");
-        CTString strDummy;
-        istrm>>strDummy;
-        break;
-                                        }
-      // if it is FILENAME
-      case CEntityProperty::EPT_FILENAME: {
-        // skip FILENAME
-        CTFileName fnmDummy;
-        istrm>>fnmDummy;
-        break;
-                                          }
-      // if it is FILENAMENODEP
-      case CEntityProperty::EPT_FILENAMENODEP: {
-        // skip FILENAMENODEP
-        CTFileNameNoDep fnmDummy;
-        istrm>>fnmDummy;
-        break;
-                                        }
-      // if it is ENTITYPTR
-      case CEntityProperty::EPT_ENTITYPTR: {
-        // skip index
-        INDEX iDummy;
-        istrm>>iDummy;
-                                           }
-        break;
-      // if it is FLOATAABBOX3D
-      case CEntityProperty::EPT_FLOATAABBOX3D: {
-        // skip FLOATAABBOX3D
-        FLOATaabbox3D boxDummy;
-        istrm.Read_t(&boxDummy, sizeof(FLOATaabbox3D));
-                                               }
-        break;
-      // if it is FLOATMATRIX3D
-      case CEntityProperty::EPT_FLOATMATRIX3D: {
-        // skip FLOATMATRIX3D
-        FLOATmatrix3D boxDummy;
-        istrm.Read_t(&boxDummy, sizeof(FLOATmatrix3D));
-                                               }
-        break;
-      // if it is EPT_FLOATQUAT3D
-      case CEntityProperty::EPT_FLOATQUAT3D: {
-        // skip EPT_FLOATQUAT3D
-        FLOATquat3D qDummy;
-        istrm.Read_t(&qDummy, sizeof(FLOATquat3D));
-                                               }
-        break;
-      // if it is FLOAT3D
-      case CEntityProperty::EPT_FLOAT3D: {
-        // skip FLOAT3D
-        FLOAT3D vDummy;
-        istrm>>vDummy;
-                                         }
-        break;
-      // if it is ANGLE3D
-      case CEntityProperty::EPT_ANGLE3D: {
-        // skip ANGLE3D
-        ANGLE3D vDummy;
-        istrm>>vDummy;
-                                         }
-        break;
-      // if it is FLOATplane3D
-      case CEntityProperty::EPT_FLOATplane3D: {
-        // skip FLOATplane3D
-        FLOATplane3D plDummy;
-        istrm.Read_t(&plDummy, sizeof(plDummy));
-                                              }
-        break;
-      // if it is MODELOBJECT
-      case CEntityProperty::EPT_MODELOBJECT:
-        // skip CModelObject
-        SkipModelObject_t(istrm);
-        break;
-      // if it is MODELINSTANCE
-      case CEntityProperty::EPT_MODELINSTANCE:
-        SkipModelInstance_t(istrm);
-        break;
-      // if it is ANIMOBJECT
-      case CEntityProperty::EPT_ANIMOBJECT:
-        // skip CAnimObject
-        SkipAnimObject_t(istrm);
-        break;
-      // if it is SOUNDOBJECT
-      case CEntityProperty::EPT_SOUNDOBJECT:
-        // skip CSoundObject
-        SkipSoundObject_t(istrm);
-        break;
-      default:
-        ASSERTALWAYS("Unknown property type");
-      }
+      // skip its value
+      SkipOneProperty_t(istrm, eptType);
 
     // if it was found
     } else {
@@ -267,143 +369,154 @@ void CEntity::ReadProperties_t(CTStream &istrm) // throw char *
         eptLoad = CEntityProperty::EPT_STRING;
       }
 
-      // depending on the property type
-      switch (eptLoad) {
-      // if it is BOOL
-      case CEntityProperty::EPT_BOOL:
-        // read BOOL
-        istrm>>(INDEX &)PROPERTY(pepProperty->ep_slOffset, BOOL);
-        break;
-      // if it is INDEX
-      case CEntityProperty::EPT_INDEX:
-      case CEntityProperty::EPT_ENUM:
-      case CEntityProperty::EPT_FLAGS:
-      case CEntityProperty::EPT_ANIMATION:
-      case CEntityProperty::EPT_ILLUMINATIONTYPE:
-      case CEntityProperty::EPT_COLOR:
-      case CEntityProperty::EPT_ANGLE:
-        // read INDEX
-        istrm>>PROPERTY(pepProperty->ep_slOffset, INDEX);
-        break;
-      // if it is FLOAT
-      case CEntityProperty::EPT_FLOAT:
-      case CEntityProperty::EPT_RANGE:
-        // read FLOAT
-        istrm>>PROPERTY(pepProperty->ep_slOffset, FLOAT);
-        break;
-      // if it is STRING
-      case CEntityProperty::EPT_STRING:
-        // read STRING
-        istrm>>PROPERTY(pepProperty->ep_slOffset, CTString);
-        break;
-      // if it is STRINGTRANS
-      case CEntityProperty::EPT_STRINGTRANS:
-        // read STRINGTRANS
-        istrm.ExpectID_t("DTRS");
-        istrm>>PROPERTY(pepProperty->ep_slOffset, CTString);
+      // read the value
+      ReadOneProperty_t(istrm, eptLoad, &PROPERTY(pepProperty->ep_slOffset, UBYTE));
+    }
+  }
+}
+
+/*
+ * Read one property value of given type.
+ */
+void CEntity::ReadOneProperty_t(CTStream &istrm, ULONG ulType, void *pvProperty) // throw char *
+{
+  // depending on the property type
+  switch (ulType) {
+  // if it is BOOL
+  case CEntityProperty::EPT_BOOL:
+    // read BOOL
+    istrm>>*(INDEX *)pvProperty;
+    break;
+  // if it is INDEX
+  case CEntityProperty::EPT_INDEX:
+  case CEntityProperty::EPT_ENUM:
+  case CEntityProperty::EPT_FLAGS:
+  case CEntityProperty::EPT_ANIMATION:
+  case CEntityProperty::EPT_ILLUMINATIONTYPE:
+  case CEntityProperty::EPT_COLOR:
+  case CEntityProperty::EPT_ANGLE:
+    // read INDEX
+    istrm>>*(INDEX *)pvProperty;
+    break;
+  // if it is FLOAT
+  case CEntityProperty::EPT_FLOAT:
+  case CEntityProperty::EPT_RANGE:
+    // read FLOAT
+    istrm>>*(FLOAT *)pvProperty;
+    break;
+  // if it is STRING
+  case CEntityProperty::EPT_STRING:
+    // read STRING
+    istrm>>*(CTString *)pvProperty;
+    break;
+  // if it is STRINGTRANS
+  case CEntityProperty::EPT_STRINGTRANS:
+    // read STRINGTRANS
+    istrm.ExpectID_t("DTRS");
+    istrm>>*(CTString *)pvProperty;
+    break;
+  // if it is FILENAME
+  case CEntityProperty::EPT_FILENAME:
+    // read FILENAME
+    {
+      CTFileName &fnm = *(CTFileName *)pvProperty;
+      istrm>>fnm;
+      if (fnm=="") {
         break;
-      // if it is FILENAME
-      case CEntityProperty::EPT_FILENAME:
-        // read FILENAME
-        istrm>>PROPERTY(pepProperty->ep_slOffset, CTFileName);
-        if (PROPERTY(pepProperty->ep_slOffset, CTFileName)=="") {
-          break;
-        }
-        // try to replace file name if it doesn't exist
-        for(;;)
+      }
+      // try to replace file name if it doesn't exist
+      for(;;)
+      {
+        if( !FileExists( fnm))
         {
-          if( !FileExists( PROPERTY(pepProperty->ep_slOffset, CTFileName)))
-          {
-            // if file was not found, ask for replacing file
-            CTFileName fnReplacingFile;
-            if( GetReplacingFile( PROPERTY(pepProperty->ep_slOffset, CTFileName),
-                                  fnReplacingFile, FILTER_ALL FILTER_END))
-            {
-              // replacing file was provided
-              PROPERTY(pepProperty->ep_slOffset, CTFileName) = fnReplacingFile;
-            } else {
-              ThrowF_t(TRANS("File '%s' does not exist"), (const char*)PROPERTY(pepProperty->ep_slOffset, CTFileName));
-            }
-          }
-          else
+          // if file was not found, ask for replacing file
+          CTFileName fnReplacingFile;
+          if( GetReplacingFile( fnm, fnReplacingFile, FILTER_ALL FILTER_END))
           {
-            break;
+            // replacing file was provided
+            fnm = fnReplacingFile;
+          } else {
+            ThrowF_t(TRANS("File '%s' does not exist"), (const char*)fnm);
           }
         }
-        break;
-      // if it is FILENAMENODEP
-      case CEntityProperty::EPT_FILENAMENODEP:
-        // read FILENAMENODEP
-        istrm>>PROPERTY(pepProperty->ep_slOffset, CTFileNameNoDep);
-        break;
-      // if it is ENTITYPTR
-      case CEntityProperty::EPT_ENTITYPTR:
-        // read the entity pointer
-        ReadEntityPointer_t(&istrm, PROPERTY(pepProperty->ep_slOffset, CEntityPointer));
-        break;
-      // if it is FLOATAABBOX3D
-      case CEntityProperty::EPT_FLOATAABBOX3D:
-        // read FLOATAABBOX3D
-        istrm.Read_t(&PROPERTY(pepProperty->ep_slOffset, FLOATaabbox3D), sizeof(FLOATaabbox3D));
-        break;
-      // if it is FLOATMATRIX3D
-      case CEntityProperty::EPT_FLOATMATRIX3D:
-        // read FLOATMATRIX3D
-        istrm.Read_t(&PROPERTY(pepProperty->ep_slOffset, FLOATmatrix3D), sizeof(FLOATmatrix3D));
-        break;
-      // if it is FLOATQUAT3D
-      case CEntityProperty::EPT_FLOATQUAT3D:
-        // read FLOATQUAT3D
-        istrm.Read_t(&PROPERTY(pepProperty->ep_slOffset, FLOATquat3D), sizeof(FLOATquat3D));
-        break;
-      // if it is FLOAT3D
-      case CEntityProperty::EPT_FLOAT3D:
-        // read FLOAT3D
-        istrm.Read_t(&PROPERTY(pepProperty->ep_slOffset, FLOAT3D), sizeof(FLOAT3D));
-        break;
-      // if it is ANGLE3D
-      case CEntityProperty::EPT_ANGLE3D:
-        // read ANGLE3D
-        istrm.Read_t(&PROPERTY(pepProperty->ep_slOffset, ANGLE3D), sizeof(ANGLE3D));
-        break;
-      // if it is FLOATplane3D
-      case CEntityProperty::EPT_FLOATplane3D:
-        // read FLOATplane3D
-        istrm.Read_t(&PROPERTY(pepProperty->ep_slOffset, FLOATplane3D), sizeof(FLOATplane3D));
-        break;
-      // if it is MODELOBJECT
-      case CEntityProperty::EPT_MODELOBJECT:
-        // read CModelObject
-        ReadModelObject_t(istrm, PROPERTY(pepProperty->ep_slOffset, CModelObject));
-        break;
-      // if it is MODELINSTANCE
-      case CEntityProperty::EPT_MODELINSTANCE:
-        // read CModelObject
-        ReadModelInstance_t(istrm, PROPERTY(pepProperty->ep_slOffset, CModelInstance));
-        break;
-      // if it is ANIMOBJECT
-      case CEntityProperty::EPT_ANIMOBJECT:
-        // read CAnimObject
-        ReadAnimObject_t(istrm, PROPERTY(pepProperty->ep_slOffset, CAnimObject));
-        break;
-      // if it is SOUNDOBJECT
-      case CEntityProperty::EPT_SOUNDOBJECT:
-        // read CSoundObject
+        else
         {
-          CSoundObject &so = PROPERTY(pepProperty->ep_slOffset, CSoundObject);
-          ReadSoundObject_t(istrm, so);
-          so.so_penEntity = this;
+          break;
         }
-        break;
-      // if it is CPlacement3D
-      case CEntityProperty::EPT_PLACEMENT3D:
-        // read CPlacement3D
-        istrm.Read_t(&PROPERTY(pepProperty->ep_slOffset, CPlacement3D), sizeof(CPlacement3D));
-        break;
-      default:
-        ASSERTALWAYS("Unknown property type");
       }
     }
+    break;
+  // if it is FILENAMENODEP
+  case CEntityProperty::EPT_FILENAMENODEP:
+    // read FILENAMENODEP
+    istrm>>*(CTFileNameNoDep *)pvProperty;
+    break;
+  // if it is ENTITYPTR
+  case CEntityProperty::EPT_ENTITYPTR:
+    // read the entity pointer
+    ReadEntityPointer_t(&istrm, *(CEntityPointer *)pvProperty);
+    break;
+  // if it is FLOATAABBOX3D
+  case CEntityProperty::EPT_FLOATAABBOX3D:
+    // read FLOATAABBOX3D
+    istrm.Read_t(pvProperty, sizeof(FLOATaabbox3D));
+    break;
+  // if it is FLOATMATRIX3D
+  case CEntityProperty::EPT_FLOATMATRIX3D:
+    // read FLOATMATRIX3D
+    istrm.Read_t(pvProperty, sizeof(FLOATmatrix3D));
+    break;
+  // if it is FLOATQUAT3D
+  case CEntityProperty::EPT_FLOATQUAT3D:
+    // read FLOATQUAT3D
+    istrm.Read_t(pvProperty, sizeof(FLOATquat3D));
+    break;
+  // if it is FLOAT3D
+  case CEntityProperty::EPT_FLOAT3D:
+    // read FLOAT3D
+    istrm.Read_t(pvProperty, sizeof(FLOAT3D));
+    break;
+  // if it is ANGLE3D
+  case CEntityProperty::EPT_ANGLE3D:
+    // read ANGLE3D
+    istrm.Read_t(pvProperty, sizeof(ANGLE3D));
+    break;
+  // if it is FLOATplane3D
+  case CEntityProperty::EPT_FLOATplane3D:
+    // read FLOATplane3D
+    istrm.Read_t(pvProperty, sizeof(FLOATplane3D));
+    break;
+  // if it is MODELOBJECT
+  case CEntityProperty::EPT_MODELOBJECT:
+    // read CModelObject
+    ReadModelObject_t(istrm, *(CModelObject *)pvProperty);
+    break;
+  // if it is MODELINSTANCE
+  case CEntityProperty::EPT_MODELINSTANCE:
+    // read CModelObject
+    ReadModelInstance_t(istrm, *(CModelInstance *)pvProperty);
+    break;
+  // if it is ANIMOBJECT
+  case CEntityProperty::EPT_ANIMOBJECT:
+    // read CAnimObject
+    ReadAnimObject_t(istrm, *(CAnimObject *)pvProperty);
+    break;
+  // if it is SOUNDOBJECT
+  case CEntityProperty::EPT_SOUNDOBJECT:
+    // read CSoundObject
+    {
+      CSoundObject &so = *(CSoundObject *)pvProperty;
+      ReadSoundObject_t(istrm, so);
+      so.so_penEntity = this;
+    }
+    break;
+  // if it is CPlacement3D
+  case CEntityProperty::EPT_PLACEMENT3D:
+    // read CPlacement3D
+    istrm.Read_t(pvProperty, sizeof(CPlacement3D));
+    break;
+  default:
+    ASSERTALWAYS("Unknown property type");
   }
 }
 
@@ -425,6 +538,16 @@ void CEntity::WriteProperties_t(CTStream &ostrm) // throw char *
   // write number of properties
   ostrm<<ctProperties;
 
+  // if all classes have generated serializers, let them write the properties
+  if (ent_bPropertySerializers && HasSerializers(en_pecClass->ec_pdecDLLClass)) {
+    for(CDLLEntityClass *pdec = en_pecClass->ec_pdecDLLClass; pdec!=NULL; pdec = pdec->dec_pdecBase) {
+      if (pdec->dec_WriteProperties_t!=NULL) {
+        pdec->dec_WriteProperties_t(this, ostrm);
+      }
+    }
+    return;
+  }
+
   // for all classes in hierarchy of this entity
   {for(CDLLEntityClass *pdecDLLClass = en_pecClass->ec_pdecDLLClass;
       pdecDLLClass!=NULL;
@@ -440,118 +563,276 @@ void CEntity::WriteProperties_t(CTStream &ostrm) // throw char *
       // write the packed identifier
       ostrm<<ulIDAndType;
 
-      // depending on the property type
-      switch (epProperty.ep_eptType) {
-      // if it is BOOL
-      case CEntityProperty::EPT_BOOL:
-        // write BOOL
-        ostrm<<(INDEX &)PROPERTY(epProperty.ep_slOffset, BOOL);
-        break;
-      // if it is INDEX
-      case CEntityProperty::EPT_INDEX:
-      case CEntityProperty::EPT_ENUM:
-      case CEntityProperty::EPT_FLAGS:
-      case CEntityProperty::EPT_ANIMATION:
-      case CEntityProperty::EPT_ILLUMINATIONTYPE:
-      case CEntityProperty::EPT_COLOR:
-      case CEntityProperty::EPT_ANGLE:
-        // write INDEX
-        ostrm<<PROPERTY(epProperty.ep_slOffset, INDEX);
-        break;
-      // if it is FLOAT
-      case CEntityProperty::EPT_FLOAT:
-      case CEntityProperty::EPT_RANGE:
-        // write FLOAT
-        ostrm<<PROPERTY(epProperty.ep_slOffset, FLOAT);
-        break;
-      // if it is STRING
-      case CEntityProperty::EPT_STRING:
-        // write STRING
-        ostrm<<PROPERTY(epProperty.ep_slOffset, CTString);
-        break;
-      // if it is STRINGTRANS
-      case CEntityProperty::EPT_STRINGTRANS:
-        // write STRINGTRANS
-        ostrm.WriteID_t("DTRS");
-        ostrm<<PROPERTY(epProperty.ep_slOffset, CTString);
-        break;
-      // if it is FILENAME
-      case CEntityProperty::EPT_FILENAME:
-        // write FILENAME
-        ostrm<<PROPERTY(epProperty.ep_slOffset, CTFileName);
-        break;
-      // if it is FILENAMENODEP
-      case CEntityProperty::EPT_FILENAMENODEP:
-        // write FILENAMENODEP
-        ostrm<<PROPERTY(epProperty.ep_slOffset, CTFileNameNoDep);
-        break;
-      // if it is FLOATAABBOX3D
-      case CEntityProperty::EPT_FLOATAABBOX3D:
-        // write FLOATAABBOX3D
-        ostrm.Write_t(&PROPERTY(epProperty.ep_slOffset, FLOATaabbox3D), sizeof(FLOATaabbox3D));
-        break;
-      // if it is FLOATMATRIX3D
-      case CEntityProperty::EPT_FLOATMATRIX3D:
-        // write FLOATMATRIX3D
-        ostrm.Write_t(&PROPERTY(epProperty.ep_slOffset, FLOATmatrix3D), sizeof(FLOATmatrix3D));
-        break;
-      // if it is FLOATQUAT3D
-      case CEntityProperty::EPT_FLOATQUAT3D:
-        // write FLOATQUAT3D
-        ostrm.Write_t(&PROPERTY(epProperty.ep_slOffset, FLOATquat3D), sizeof(FLOATquat3D));
-        break;
-      // if it is ANGLE3D
-      case CEntityProperty::EPT_ANGLE3D:
-        // write ANGLE3D
-        ostrm.Write_t(&PROPERTY(epProperty.ep_slOffset, ANGLE3D), sizeof(ANGLE3D));
-        break;
-      // if it is FLOAT3D
-      case CEntityProperty::EPT_FLOAT3D:
-        // write FLOAT3D
-        ostrm.Write_t(&PROPERTY(epProperty.ep_slOffset, FLOAT3D), sizeof(FLOAT3D));
-        break;
-      // if it is FLOATplane3D
-      case CEntityProperty::EPT_FLOATplane3D:
-        // write FLOATplane3D
-        ostrm.Write_t(&PROPERTY(epProperty.ep_slOffset, FLOATplane3D), sizeof(FLOATplane3D));
-        break;
-      // if it is ENTITYPTR
-      case CEntityProperty::EPT_ENTITYPTR:
-        // write entity pointer
-        WriteEntityPointer_t(&ostrm, PROPERTY(epProperty.ep_slOffset, CEntityPointer));
-        break;
-      // if it is MODELOBJECT
-      case CEntityProperty::EPT_MODELOBJECT:
-        // write CModelObject
-        WriteModelObject_t(ostrm, PROPERTY(epProperty.ep_slOffset, CModelObject));
-        break;
-      // if it is MODELINSTANCE
-      case CEntityProperty::EPT_MODELINSTANCE:
-        // write CModelInstance
-        WriteModelInstance_t(ostrm, PROPERTY(epProperty.ep_slOffset, CModelInstance));
-        break;
-      // if it is ANIMOBJECT
-      case CEntityProperty::EPT_ANIMOBJECT:
-        // write CAnimObject
-        WriteAnimObject_t(ostrm, PROPERTY(epProperty.ep_slOffset, CAnimObject));
-        break;
-      // if it is SOUNDOBJECT
-      case CEntityProperty::EPT_SOUNDOBJECT:
-        // write CSoundObject
-        WriteSoundObject_t(ostrm, PROPERTY(epProperty.ep_slOffset, CSoundObject));
-        break;
-      // if it is CPlacement3D
-      case CEntityProperty::EPT_PLACEMENT3D:
-        // write CPlacement3D
-        ostrm.Write_t(&PROPERTY(epProperty.ep_slOffset, CPlacement3D), sizeof(CPlacement3D));
-        break;
-      default:
-        ASSERTALWAYS("Unknown property type");
-      }
+      // write the value
+      WriteOneProperty_t(ostrm, epProperty.ep_eptType, &PROPERTY(epProperty.ep_slOffset, UBYTE));
     }
   }}
 }
 
+/*
+ * Write one property value of given type.
+ */
+void CEntity::WriteOneProperty_t(CTStream &ostrm, ULONG ulType, void *pvProperty) // throw char *
+{
+  // depending on the property type
+  switch (ulType) {
+  // if it is BOOL
+  case CEntityProperty::EPT_BOOL:
+    // write BOOL
+    ostrm<<*(INDEX *)pvProperty;
+    break;
+  // if it is INDEX
+  case CEntityProperty::EPT_INDEX:
+  case CEntityProperty::EPT_ENUM:
+  case CEntityProperty::EPT_FLAGS:
+  case CEntityProperty::EPT_ANIMATION:
+  case CEntityProperty::EPT_ILLUMINATIONTYPE:
+  case CEntityProperty::EPT_COLOR:
+  case CEntityProperty::EPT_ANGLE:
+    // write INDEX
+    ostrm<<*(INDEX *)pvProperty;
+    break;
+  // if it is FLOAT
+  case CEntityProperty::EPT_FLOAT:
+  case CEntityProperty::EPT_RANGE:
+    // write FLOAT
+    ostrm<<*(FLOAT *)pvProperty;
+    break;
+  // if it is STRING
+  case CEntityProperty::EPT_STRING:
+    // write STRING
+    ostrm<<*(CTString *)pvProperty;
+    break;
+  // if it is STRINGTRANS
+  case CEntityProperty::EPT_STRINGTRANS:
+    // write STRINGTRANS
+    ostrm.WriteID_t("DTRS");
+    ostrm<<*(CTString *)pvProperty;
+    break;
+  // if it is FILENAME
+  case CEntityProperty::EPT_FILENAME:
+    // write FILENAME
+    ostrm<<*(CTFileName *)pvProperty;
+    break;
+  // if it is FILENAMENODEP
+  case CEntityProperty::EPT_FILENAMENODEP:
+    // write FILENAMENODEP
+    ostrm<<*(CTFileNameNoDep *)pvProperty;
+    break;
+  // if it is FLOATAABBOX3D
+  case CEntityProperty::EPT_FLOATAABBOX3D:
+    // write FLOATAABBOX3D
+    ostrm.Write_t(pvProperty, sizeof(FLOATaabbox3D));
+    break;
+  // if it is FLOATMATRIX3D
+  case CEntityProperty::EPT_FLOATMATRIX3D:
+    // write FLOATMATRIX3D
+    ostrm.Write_t(pvProperty, sizeof(FLOATmatrix3D));
+    break;
+  // if it is FLOATQUAT3D
+  case CEntityProperty::EPT_FLOATQUAT3D:
+    // write FLOATQUAT3D
+    ostrm.Write_t(pvProperty, sizeof(FLOATquat3D));
+    break;
+  // if it is ANGLE3D
+  case CEntityProperty::EPT_ANGLE3D:
+    // write ANGLE3D
+    ostrm.Write_t(pvProperty, sizeof(ANGLE3D));
+    break;
+  // if it is FLOAT3D
+  case CEntityProperty::EPT_FLOAT3D:
+    // write FLOAT3D
+    ostrm.Write_t(pvProperty, sizeof(FLOAT3D));
+    break;
+  // if it is FLOATplane3D
+  case CEntityProperty::EPT_FLOATplane3D:
+    // write FLOATplane3D
+    ostrm.Write_t(pvProperty, sizeof(FLOATplane3D));
+    break;
+  // if it is ENTITYPTR
+  case CEntityProperty::EPT_ENTITYPTR:
+    // write entity pointer
+    WriteEntityPointer_t(&ostrm, *(CEntityPointer *)pvProperty);
+    break;
+  // if it is MODELOBJECT
+  case CEntityProperty::EPT_MODELOBJECT:
+    // write CModelObject
+    WriteModelObject_t(ostrm, *(CModelObject *)pvProperty);
+    break;
+  // if it is MODELINSTANCE
+  case CEntityProperty::EPT_MODELINSTANCE:
+    // write CModelInstance
+    WriteModelInstance_t(ostrm, *(CModelInstance *)pvProperty);
+    break;
+  // if it is ANIMOBJECT
+  case CEntityProperty::EPT_ANIMOBJECT:
+    // write CAnimObject
+    WriteAnimObject_t(ostrm, *(CAnimObject *)pvProperty);
+    break;
+  // if it is SOUNDOBJECT
+  case CEntityProperty::EPT_SOUNDOBJECT:
+    // write CSoundObject
+    WriteSoundObject_t(ostrm, *(CSoundObject *)pvProperty);
+    break;
+  // if it is CPlacement3D
+  case CEntityProperty::EPT_PLACEMENT3D:
+    // write CPlacement3D
+    ostrm.Write_t(pvProperty, sizeof(CPlacement3D));
+    break;
+  default:
+    ASSERTALWAYS("Unknown property type");
+  }
+}
+
+// write properties of an entity either through generated serializers or through property tables
+static void WritePropertiesWith_t(CEntity *pen, CTStream &strm, BOOL bSerializers) // throw char *
+{
+  const INDEX bOld = ent_bPropertySerializers;
+  ent_bPropertySerializers = bSerializers;
+  try {
+    pen->WriteProperties_t(strm);
+  } catch (char *) {
+    ent_bPropertySerializers = bOld;
+    throw;
+  }
+  ent_bPropertySerializers = bOld;
+}
+
+static BOOL SameStreams(CTMemoryStream &strm0, CTMemoryStream &strm1)
+{
+  void *pv0, *pv1;
+  SLONG slSize0, slSize1;
+  strm0.LockBuffer(&pv0, &slSize0);
+  strm1.LockBuffer(&pv1, &slSize1);
+  const BOOL bSame = slSize0==slSize1 && memcmp(pv0, pv1, slSize0)==0;
+  strm1.UnlockBuffer();
+  strm0.UnlockBuffer();
+  return bSame;
+}
+
+// check that generated serializers of an entity give exactly the same results as property tables
+static BOOL CheckSerializers_t(CEntity *pen) // throw char *
+{
+  // both writers must produce identical streams
+  CTMemoryStream strmTables, strmGenerated;
+  WritePropertiesWith_t(pen, strmTables, FALSE);
+  WritePropertiesWith_t(pen, strmGenerated, TRUE);
+  if (!SameStreams(strmTables, strmGenerated)) {
+    return FALSE;
+  }
+
+  // generated reader must accept the stream and restore same values
+  // (classes with model instances are always read through tables)
+  if (!HasModelInstances(pen->en_pecClass->ec_pdecDLLClass)) {
+    strmGenerated.SetPos_t(0);
+    strmGenerated.ExpectID_t("PRPS");
+    INDEX ctProperties;
+    strmGenerated>>ctProperties;
+    if (!ReadWithSerializers_t(pen, strmGenerated, ctProperties)) {
+      return FALSE;
+    }
+    CTMemoryStream strmReread;
+    WritePropertiesWith_t(pen, strmReread, FALSE);
+    if (!SameStreams(strmTables, strmReread)) {
+      return FALSE;
+    }
+  }
+
+  // generated copier must copy all values (copy is left in the world until it is cleared)
+  CEntity *penCopy = pen->en_pwoWorld->CreateEntity(pen->en_plPlacement, pen->en_pecClass);
+  const INDEX bOld = ent_bPropertySerializers;
+  ent_bPropertySerializers = TRUE;
+  penCopy->CopyEntityProperties(*pen, 0);
+  ent_bPropertySerializers = bOld;
+  CTMemoryStream strmCopy;
+  WritePropertiesWith_t(penCopy, strmCopy, FALSE);
+  return SameStreams(strmTables, strmCopy);
+}
+
+// check generated serializers of all entity classes and of all entities in a world (if given),
+// then measure property save/load throughput with and without them
+void EntitySerializersTest(void *pArgs)
+{
+  CTString strWorld = *NEXTARGUMENT(CTString*);
+  extern BOOL _bReadEntitiesByID;
+  const BOOL bByIDOld = _bReadEntitiesByID;
+
+  CWorld wo;
+  CDynamicContainer<CEntity> cenTest;
+  CDynamicContainer<CEntityClass> cecTested;
+  INDEX ctFailed = 0;
+  try {
+    if (strWorld!="") {
+      wo.Load_t(CTFileName(strWorld));
+    }
+    // add one entity of each class (abstract classes have no class files)
+    CDynamicStackArray<CTFileName> afnmClasses;
+    MakeDirList(afnmClasses, CTString("Classes\\"), "*.ecl", 0);
+    for (INDEX iClass=0; iClass<afnmClasses.Count(); iClass++) {
+      wo.CreateEntity_t(CPlacement3D(FLOAT3D(0,0,0), ANGLE3D(0,0,0)), afnmClasses[iClass]);
+    }
+    cenTest = wo.wo_cenEntities;
+
+    // entity pointers are written as IDs
+    _bReadEntitiesByID = TRUE;
+    {FOREACHINDYNAMICCONTAINER(cenTest, CEntity, iten) {
+      CEntityClass *pec = iten->en_pecClass;
+      if (!cecTested.IsMember(pec)) {
+        cecTested.Add(pec);
+      }
+      if (!CheckSerializers_t(iten)) {
+        CPrintF(TRANS("  serializers of '%s' don't match property tables\n"),
+          pec->ec_pdecDLLClass->dec_strName);
+        ctFailed++;
+      }
+    }}
+  } catch (char *strError) {
+    CPrintF("%s\n", strError);
+    _bReadEntitiesByID = bByIDOld;
+    return;
+  }
+  CPrintF(TRANS("Entity serializers: %d entities of %d classes checked, %d failed\n"),
+    cenTest.Count(), cecTested.Count(), ctFailed);
+
+  // measure saving and loading of all tested entities
+  const INDEX bSerializersOld = ent_bPropertySerializers;
+  const INDEX ctRepeats = 20;
+  for (INDEX iPass=0; iPass<2; iPass++) {
+    ent_bPropertySerializers = iPass;
+    CTMemoryStream strm;
+    DOUBLE dWrite = 0, dRead = 0;
+    SLONG slSize = 0;
+    try {
+      CTimerValue tv0 = _pTimer->GetHighPrecisionTimer();
+      for (INDEX iRepeat=0; iRepeat<ctRepeats; iRepeat++) {
+        strm.SetPos_t(0);
+        FOREACHINDYNAMICCONTAINER(cenTest, CEntity, iten) {
+          iten->WriteProperties_t(strm);
+        }
+      }
+      dWrite = (_pTimer->GetHighPrecisionTimer()-tv0).GetSeconds();
+      slSize = strm.GetPos_t();
+      tv0 = _pTimer->GetHighPrecisionTimer();
+      for (INDEX iRepeat2=0; iRepeat2<ctRepeats; iRepeat2++) {
+        strm.SetPos_t(0);
+        FOREACHINDYNAMICCONTAINER(cenTest, CEntity, iten) {
+          iten->ReadProperties_t(strm);
+        }
+      }
+      dRead = (_pTimer->GetHighPrecisionTimer()-tv0).GetSeconds();
+    } catch (char *strError) {
+      CPrintF("%s\n", strError);
+      break;
+    }
+    const DOUBLE dMB = slSize*ctRepeats/(1024.0*1024.0);
+    CPrintF(TRANS("  %-16s: %d KB per save, write %7.1f MB/s, read %7.1f MB/s\n"),
+      iPass ? "serializers" : "property tables", slSize/1024,
+      dMB/Max(dWrite,1E-9), dMB/Max(dRead,1E-9));
+  }
+  ent_bPropertySerializers = bSerializersOld;
+  _bReadEntitiesByID = bByIDOld;
+}
+
 /////////////////////////////////////////////////////////////////////
 // Component management functions
 
@@ -207,6 +207,14 @@ public:
   void (*dec_OnWorldRender)(CWorld *pwoWorld);  // function called for each rendering
   void (*dec_OnWorldEnd)(CWorld *pwoWorld);     // function called on world cleanup
 
+  const INDEX *dec_aiPropertiesByID;   // indices of properties sorted by ID (generated by Ecc)
+  const INDEX *dec_aiHandlersByState;  // indices of handlers sorted by state (generated by Ecc)
+  struct CEntityClassLookup *dec_pecl; // sorted tables for whole inheritance chain (made on first use)
+  // straight-line property serializers for properties of this class only (generated by Ecc)
+  BOOL (*dec_ReadProperties_t)(CEntity *pen, CTStream &strm);  // returns FALSE if stream doesn't match the class
+  void (*dec_WriteProperties_t)(CEntity *pen, CTStream &strm);
+  void (*dec_CopyProperties)(CEntity *pen, CEntity *penOther, ULONG ulFlags);
+
   /* Get pointer to entity property from its name. */
   class CEntityProperty *PropertyForName(const CTString &strPropertyName);
   /* Get pointer to entity property from its packed identifier. */
@@ -217,6 +225,8 @@ public:
   const char *HandlerNameForState(SLONG slState);
   /* Get derived class override for given state. */
   SLONG GetOverridenState(SLONG slState);
+  /* Free lookup tables (they are rebuilt on next use). */
+  void ClearLookupTables(void);
   /* Get pointer to component from its type and identifier. */
   class CEntityComponent *ComponentForTypeAndID(EntityComponentType ectType,
     SLONG slID);
@@ -257,7 +267,13 @@ public:
     &classname##_OnWorldInit,                                         \
     &classname##_OnWorldTick,                                         \
     &classname##_OnWorldRender,                                       \
-    &classname##_OnWorldEnd                                           \
+    &classname##_OnWorldEnd,                                          \
+    classname##_propertiesbyid,                                       \
+    classname##_handlersbystate,                                      \
+    NULL,                                                             \
+    &classname##_ReadProperties_t,                                    \
+    &classname##_WriteProperties_t,                                   \
+    &classname##_CopyProperties                                       \
   };\
   SYMBOLLOCATOR(classname##_DLLClass)
 
@@ -265,9 +281,38 @@ public:
   extern "C" DECLSPEC_DLLEXPORT CDLLEntityClass classname##_DLLClass; \
   CDLLEntityClass classname##_DLLClass = {                            \
     NULL,0, NULL,0, NULL,0, "", "", id,                               \
-    NULL, NULL,NULL,NULL,NULL, NULL,NULL,NULL,NULL                    \
+    NULL, NULL,NULL,NULL,NULL, NULL,NULL,NULL,NULL, NULL,NULL,NULL,    \
+    NULL,NULL,NULL                                                    \
   }
 
+// macros used by property serializers that Ecc generates for each class; they produce
+// the same stream as CEntity::WriteProperties_t(), but plain data properties (numbers,
+// vectors, placements...) that follow each other are moved in one block
+#define EPS_IDANDTYPE(ulID, type) (((ULONG)(ulID)<<8)|(ULONG)CEntityProperty::type)
+#define EPS_BEGINRUN(slSize) { UBYTE aubRun[slSize]; UBYTE *pubRun = aubRun;
+#define EPS_ENDRUN }
+#define EPS_PUT(ulID, type, member)                                   \
+  *(ULONG *)pubRun = EPS_IDANDTYPE(ulID, type);                       \
+  memcpy(pubRun+sizeof(ULONG), &(member), sizeof(member));            \
+  pubRun += sizeof(ULONG)+sizeof(member);
+#define EPS_GET(ulID, type, member)                                   \
+  if (*(ULONG *)pubRun!=EPS_IDANDTYPE(ulID, type)) return FALSE;      \
+  memcpy(&(member), pubRun+sizeof(ULONG), sizeof(member));            \
+  pubRun += sizeof(ULONG)+sizeof(member);
+#define EPS_WRITERUN strm.Write_t(aubRun, pubRun-aubRun);
+#define EPS_READRUN  strm.Read_t(aubRun, sizeof(aubRun));
+#define EPS_WRITEONE(ulID, type, member)                              \
+  strm<<(ULONG)EPS_IDANDTYPE(ulID, type);                             \
+  pen->WriteOneProperty_t(strm, CEntityProperty::type, &(member));
+#define EPS_READONE(ulID, type, member) {                             \
+  ULONG ulIDAndType; strm>>ulIDAndType;                               \
+  if (ulIDAndType!=EPS_IDANDTYPE(ulID, type)) return FALSE;           \
+  pen->ReadOneProperty_t(strm, CEntityProperty::type, &(member)); }
+#define EPS_COPYRUN(first, last)                                      \
+  memcpy(&en.first, &enOther.first, ((UBYTE *)&en.last+sizeof(en.last))-(UBYTE *)&en.first);
+#define EPS_COPYONE(type, member)                                     \
+  pen->CopyOnePropertyValue(CEntityProperty::type, &en.member, &enOther.member, ulFlags);
+
 inline ENGINE_API void ClearToDefault(FLOAT &f) { f = 0.0f; };
 inline ENGINE_API void ClearToDefault(INDEX &i) { i = 0; };
 inline ENGINE_API void ClearToDefault(BOOL &b) { b = FALSE; };
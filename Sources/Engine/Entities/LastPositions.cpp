@@ -28,6 +28,23 @@ CLastPositions::CLastPositions(const CLastPositions &lpOrg)
   lp_tmLastAdded = lpOrg.lp_tmLastAdded ;
 }
 
+CLastPositions &CLastPositions::operator=(const CLastPositions &lpOrg)
+{
+  // keep the array if it is of same size
+  const INDEX ctPositions = lpOrg.lp_avPositions.Count();
+  if (lp_avPositions.Count()==ctPositions) {
+    for (INDEX iPos=0; iPos<ctPositions; iPos++) {
+      lp_avPositions[iPos] = lpOrg.lp_avPositions[iPos];
+    }
+  } else {
+    lp_avPositions = lpOrg.lp_avPositions;
+  }
+  lp_iLast       = lpOrg.lp_iLast       ;
+  lp_ctUsed      = lpOrg.lp_ctUsed      ;
+  lp_tmLastAdded = lpOrg.lp_tmLastAdded ;
+  return *this;
+}
+
 // add a new position
 void CLastPositions::AddPosition(const FLOAT3D &vPos)
 {
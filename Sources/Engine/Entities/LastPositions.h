@@ -32,6 +32,7 @@ public:
   
   CLastPositions() {};
   CLastPositions(const CLastPositions &lpOrg);
+  CLastPositions &operator=(const CLastPositions &lpOrg);
 
   // add a new position
   void AddPosition(const FLOAT3D &vPos);
@@ -21,6 +21,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <Engine/Base/Shell.h>
 #include <Engine/Base/Console.h>
 #include <Engine/Base/CTString.h>
+#include <Engine/Base/MemoryPool.h>
 #include <Engine/Network/Server.h>
 #include <Engine/Network/Network.h>
 #include <Engine/Network/SessionState.h>
@@ -1026,6 +1027,7 @@ DWORD WINAPI _MS_Thread(LPVOID lpParam) {
     _sockudp = socket(AF_INET, SOCK_DGRAM, 0);
     if (_sockudp == INVALID_SOCKET){
         WSACleanup();
+        MemPool_ReleaseThreadCache();
         return -1;
     }
 
@@ -1078,6 +1080,7 @@ DWORD WINAPI _MS_Thread(LPVOID lpParam) {
             sPch = strstr(_szBuffer, "\\gamename\\serioussamse\\");
             if(!sPch) {
                 CPrintF("Unknown query server response!\n");
+                MemPool_ReleaseThreadCache();
                 return -1;
             } else {
 
@@ -1208,6 +1211,7 @@ DWORD WINAPI _MS_Thread(LPVOID lpParam) {
     _bInitialized = FALSE;
     _pNetwork->ga_bEnumerationChange = FALSE;
     WSACleanup();
+    MemPool_ReleaseThreadCache();
     return 0;
 }
 
@@ -1229,6 +1233,7 @@ DWORD WINAPI _LocalNet_Thread(LPVOID lpParam) {
 			delete[] _szIPPortBufferLocal;
 		}
 		_szIPPortBufferLocal = NULL;		
+		MemPool_ReleaseThreadCache();
 		return -1;
     }
 
@@ -1286,6 +1291,7 @@ DWORD WINAPI _LocalNet_Thread(LPVOID lpParam) {
 				}
 				_szIPPortBufferLocal = NULL;               
 				WSACleanup();
+				MemPool_ReleaseThreadCache();
 				return -1;
             } else {
 
@@ -1420,5 +1426,6 @@ DWORD WINAPI _LocalNet_Thread(LPVOID lpParam) {
     _pNetwork->ga_bEnumerationChange = FALSE;
 	_pNetwork->ga_strEnumerationStatus = "";
     WSACleanup();
+    MemPool_ReleaseThreadCache();
     return 0;
 }
\ No newline at end of file
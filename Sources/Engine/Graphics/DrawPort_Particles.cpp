@@ -23,6 +23,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <Engine/Graphics/Texture.h>
 #include <Engine/Graphics/Fog_internal.h>
 #include <Engine/Base/Statistics_internal.h>
+#include <Engine/Base/Shell.h>
+#include <Engine/Base/Timer.h>
+#include <Engine/Base/Console.h>
+#include <emmintrin.h>
 
 #include <Engine/Templates/StaticArray.cpp>
 #include <Engine/Templates/StaticStackArray.cpp>
@@ -44,6 +48,7 @@ static MEX _mexTextureWidth, _mexTextureHeight;
 static FLOAT _fTextureCorrectionU, _fTextureCorrectionV;
 static FLOAT _fNearClipDistance;
 static GFXTexCoord _atex[4];
+static GFXTexCoord _atexSquare[4]; // texture coords in order used by particle squares
 static COLOR _colAttMask;
 static BOOL _bTransFogHaze  = FALSE;
 static BOOL _bNeedsClipping = FALSE;
@@ -184,6 +189,10 @@ void Particle_SetTexturePart( MEX mexWidth, MEX mexHeight, INDEX iCol, INDEX iRo
   _atex[2].t = boxTextureClipped.Max()(2) *_fTextureCorrectionV;
   _atex[3].s = boxTextureClipped.Max()(1) *_fTextureCorrectionU;
   _atex[3].t = boxTextureClipped.Min()(2) *_fTextureCorrectionV;
+  _atexSquare[0] = _atex[1];
+  _atexSquare[1] = _atex[0];
+  _atexSquare[2] = _atex[3];
+  _atexSquare[3] = _atex[2];
 }
 
 
@@ -249,38 +258,38 @@ void Particle_RenderSquare( const FLOAT3D &vPos, FLOAT fSize, ANGLE aRotation, C
   GFXTexCoord *ptex = _atexCommon.Push(4);
   GFXColor    *pcol = _acolCommon.Push(4);
 
-  // prepare vertices
+  // prepare offsets of vertices from center
   const FLOAT fRX = fSize;
   const FLOAT fRY = fSize*fYRatio;
+  __m128 mDI, mDJ;
   if( aRotation==0) {
-    const FLOAT fIBeg = fI0-fRX;  const FLOAT fIEnd = fI0+fRX;
-    const FLOAT fJBeg = fJ0-fRY;  const FLOAT fJEnd = fJ0+fRY;
-    pvtx[0].x = fIBeg;  pvtx[0].y = fJBeg;  pvtx[0].z = fOoK;
-    pvtx[1].x = fIBeg;  pvtx[1].y = fJEnd;  pvtx[1].z = fOoK;
-    pvtx[2].x = fIEnd;  pvtx[2].y = fJEnd;  pvtx[2].z = fOoK;
-    pvtx[3].x = fIEnd;  pvtx[3].y = fJBeg;  pvtx[3].z = fOoK;
+    mDI = _mm_setr_ps( -fRX, -fRX, +fRX, +fRX);
+    mDJ = _mm_setr_ps( -fRY, +fRY, +fRY, -fRY);
   } else {
     const INDEX iRot256 = FloatToInt(aRotation*0.7111f) & 255; // *256/360
     const FLOAT fSinA = pfSinTable[iRot256];
     const FLOAT fCosA = pfCosTable[iRot256];
     const FLOAT fSinPCos = fCosA*fRX+fSinA*fRY;
     const FLOAT fSinMCos = fSinA*fRX-fCosA*fRY;
-    pvtx[0].x = fI0-fSinPCos;  pvtx[0].y = fJ0-fSinMCos;  pvtx[0].z = fOoK;
-    pvtx[1].x = fI0+fSinMCos;  pvtx[1].y = fJ0-fSinPCos;  pvtx[1].z = fOoK;
-    pvtx[2].x = fI0+fSinPCos;  pvtx[2].y = fJ0+fSinMCos;  pvtx[2].z = fOoK;
-    pvtx[3].x = fI0-fSinMCos;  pvtx[3].y = fJ0+fSinPCos;  pvtx[3].z = fOoK;
+    mDI = _mm_setr_ps( -fSinPCos, +fSinMCos, +fSinPCos, -fSinMCos);
+    mDJ = _mm_setr_ps( -fSinMCos, -fSinPCos, +fSinMCos, +fSinPCos);
   }
+  // expand to four vertices (x,y,z,shade) at once
+  __m128 mX = _mm_add_ps( _mm_set1_ps(fI0), mDI);
+  __m128 mY = _mm_add_ps( _mm_set1_ps(fJ0), mDJ);
+  __m128 mZ = _mm_set1_ps(fOoK);
+  __m128 mW = _mm_setzero_ps();
+  _MM_TRANSPOSE4_PS( mX, mY, mZ, mW);
+  _mm_storeu_ps( &pvtx[0].x, mX);
+  _mm_storeu_ps( &pvtx[1].x, mY);
+  _mm_storeu_ps( &pvtx[2].x, mZ);
+  _mm_storeu_ps( &pvtx[3].x, mW);
   // prepare texture coords 
-  ptex[0] = _atex[1];
-  ptex[1] = _atex[0];
-  ptex[2] = _atex[3];
-  ptex[3] = _atex[2];
+  _mm_storeu_ps( &ptex[0].s, _mm_loadu_ps( &_atexSquare[0].s));
+  _mm_storeu_ps( &ptex[2].s, _mm_loadu_ps( &_atexSquare[2].s));
   // prepare colors
   const GFXColor glcol( AdjustColor( col, _slTexHueShift, _slTexSaturation));
-  pcol[0] = glcol;
-  pcol[1] = glcol;
-  pcol[2] = glcol;
-  pcol[3] = glcol;
+  _mm_storeu_si128( (__m128i*)pcol, _mm_set1_epi32( glcol.abgr));
 }
 
 
@@ -560,24 +569,77 @@ void Particle_Flush(void)
 
 // SORTING ROUTINES
 
-static int qsort_CompareZ( const void *pI0, const void *pI1) {
-  const INDEX i0 = (*(INDEX*)pI0) *4;
-  const INDEX i1 = (*(INDEX*)pI1) *4;
-  const FLOAT fZ0 = _avtxCommon[i0].z;
-  const FLOAT fZ1 = _avtxCommon[i1].z;
-       if( fZ0<fZ1) return +1;
-  else if( fZ0>fZ1) return -1;
-  else              return  0;
+// sort buffers are kept between frames, so sorting doesn't allocate once they are big enough
+static CStaticStackArray<ULONG> _aulSortKeys;
+static CStaticStackArray<INDEX> _aiSortOrder;
+static CStaticStackArray<GFXVertex4>  _avtxSorted;
+static CStaticStackArray<GFXTexCoord> _atexSorted;
+static CStaticStackArray<GFXColor>    _acolSorted;
+
+// make integer key that sorts in descending order of float value (i.e. farthest particles first)
+static __forceinline ULONG FarthestFirstKey( FLOAT f)
+{
+  const ULONG ul = (ULONG&)f;
+  // flip all bits of negative numbers and only sign of positive ones to get ascending order, then invert
+  return ~(ul ^ ((ULONG)((SLONG)ul>>31) | 0x80000000));
 }
 
-static int qsort_CompareZ3D( const void *pI0, const void *pI1) {
-  const INDEX i0 = (*(INDEX*)pI0) *4;
-  const INDEX i1 = (*(INDEX*)pI1) *4;
-  const FLOAT fZ0 = (_avtxCommon[i0].z + _avtxCommon[i0+1].z + _avtxCommon[i0+2].z + _avtxCommon[i0+3].z) / 4.0f;
-  const FLOAT fZ1 = (_avtxCommon[i1].z + _avtxCommon[i1+1].z + _avtxCommon[i1+2].z + _avtxCommon[i1+3].z) / 4.0f;
-       if( fZ0<fZ1) return +1;
-  else if( fZ0>fZ1) return -1;
-  else              return  0;
+
+// stable LSD radix sort of indices by 32-bit keys (passes where all keys have same byte are skipped);
+// keys and indices must be followed by space for as many elements, returns sorted indices
+static INDEX *RadixSort( ULONG *pulKeys, INDEX *piOrder, INDEX ct)
+{
+  ULONG aulCounts[4][256];
+  memset( aulCounts, 0, sizeof(aulCounts));
+  INDEX i;
+  for( i=0; i<ct; i++) {
+    const ULONG ulKey = pulKeys[i];
+    aulCounts[0][(ulKey    )&255]++;
+    aulCounts[1][(ulKey>> 8)&255]++;
+    aulCounts[2][(ulKey>>16)&255]++;
+    aulCounts[3][(ulKey>>24)    ]++;
+  }
+
+  ULONG *pulSrcKeys = pulKeys;     ULONG *pulDstKeys = pulKeys+ct;
+  INDEX *piSrc      = piOrder;     INDEX *piDst      = piOrder+ct;
+  for( INDEX iPass=0; iPass<4; iPass++) {
+    const INDEX iShift = iPass*8;
+    ULONG *pulCounts = aulCounts[iPass];
+    if( pulCounts[(pulSrcKeys[0]>>iShift)&255]==(ULONG)ct) continue;
+    // convert counts to offsets
+    ULONG ulOffset = 0;
+    for( i=0; i<256; i++) {
+      const ULONG ulCount = pulCounts[i];
+      pulCounts[i] = ulOffset;
+      ulOffset += ulCount;
+    }
+    // scatter
+    for( i=0; i<ct; i++) {
+      const ULONG ulKey = pulSrcKeys[i];
+      const ULONG ulDst = pulCounts[(ulKey>>iShift)&255]++;
+      pulDstKeys[ulDst] = ulKey;
+      piDst[ulDst] = piSrc[i];
+    }
+    Swap( pulSrcKeys, pulDstKeys);
+    Swap( piSrc, piDst);
+  }
+  return piSrc;
+}
+
+
+// reorder 4 elements per particle in given array by sorted indices
+template<class Type>
+static void PermuteQuads( CStaticStackArray<Type> &aSrc, CStaticStackArray<Type> &aTmp, const INDEX *piOrder, INDEX ctParticles)
+{
+  aTmp.PopAll();
+  Type *pDst = aTmp.Push(ctParticles*4);
+  const Type *pSrc = &aSrc[0];
+  for( INDEX i=0; i<ctParticles; i++) {
+    const Type *p = pSrc + piOrder[i]*4;
+    pDst[0] = p[0];  pDst[1] = p[1];  pDst[2] = p[2];  pDst[3] = p[3];
+    pDst += 4;
+  }
+  memcpy( &aSrc[0], &aTmp[0], ctParticles*4*sizeof(Type));
 }
 
 
@@ -586,58 +648,141 @@ void Particle_Sort( BOOL b3D/*=FALSE*/)
 {
   INDEX i;
   const INDEX ctParticles = _avtxCommon.Count()/4; 
-  if( ctParticles<=0) return; // nothing to do!
-
-  // generate sort array
-  CStaticArray<INDEX> aiIndices;
-  aiIndices.New(ctParticles);
-  for( i=0; i<ctParticles; i++) aiIndices[i] = i;
-
-  // bubble sort indices by vertex Z coord
-  if(b3D) qsort( &aiIndices[0], ctParticles, sizeof(INDEX), qsort_CompareZ3D);
-  else    qsort( &aiIndices[0], ctParticles, sizeof(INDEX), qsort_CompareZ);
-
-  // generate inverse table
-  CStaticArray<INDEX> aiInverse;
-  aiInverse.New(ctParticles);
-  for( i=0; i<ctParticles; i++) {
-    const INDEX iOrig = aiIndices[i];
-    aiInverse[iOrig] = i;
+  if( ctParticles<=1) return; // nothing to do!
+
+  // make sort keys from vertex Z coord (or average Z of all four vertices for 3D particles)
+  _aulSortKeys.PopAll();
+  _aiSortOrder.PopAll();
+  ULONG *pulKeys = _aulSortKeys.Push(ctParticles*2);
+  INDEX *piOrder = _aiSortOrder.Push(ctParticles*2);
+  const GFXVertex4 *pvtx = &_avtxCommon[0];
+  if( b3D) {
+    for( i=0; i<ctParticles; i++, pvtx+=4) {
+      pulKeys[i] = FarthestFirstKey( (pvtx[0].z + pvtx[1].z + pvtx[2].z + pvtx[3].z) / 4.0f);
+      piOrder[i] = i;
+    }
+  } else {
+    for( i=0; i<ctParticles; i++, pvtx+=4) {
+      pulKeys[i] = FarthestFirstKey( pvtx[0].z);
+      piOrder[i] = i;
+    }
   }
+  const INDEX *piSorted = RadixSort( pulKeys, piOrder, ctParticles);
 
-  // sort vertices by indices
-  for( i=0; i<ctParticles;) // i is incremented in loop
-  { // fetch destination
-    INDEX &iWhere = aiInverse[i];
-    ASSERT( iWhere<ctParticles);
-    // if current is already in place, advance to next index
-    if( iWhere==i) { i++; continue; }
-    // swap vertices
-    Swap( _avtxCommon[iWhere*4+0], _avtxCommon[i*4+0]);
-    Swap( _avtxCommon[iWhere*4+1], _avtxCommon[i*4+1]);
-    Swap( _avtxCommon[iWhere*4+2], _avtxCommon[i*4+2]);
-    Swap( _avtxCommon[iWhere*4+3], _avtxCommon[i*4+3]);
-    // swap texture coords
-    Swap( _atexCommon[iWhere*4+0], _atexCommon[i*4+0]);
-    Swap( _atexCommon[iWhere*4+1], _atexCommon[i*4+1]);
-    Swap( _atexCommon[iWhere*4+2], _atexCommon[i*4+2]);
-    Swap( _atexCommon[iWhere*4+3], _atexCommon[i*4+3]);
-    // swap colors
-    Swap( _acolCommon[iWhere*4+0], _acolCommon[i*4+0]);
-    Swap( _acolCommon[iWhere*4+1], _acolCommon[i*4+1]);
-    Swap( _acolCommon[iWhere*4+2], _acolCommon[i*4+2]);
-    Swap( _acolCommon[iWhere*4+3], _acolCommon[i*4+3]);
-    // swap indices
-    Swap( aiInverse[iWhere], aiInverse[i]);
+  // reorder vertex arrays (and fog/haze coords that go along with them)
+  PermuteQuads( _avtxCommon, _avtxSorted, piSorted, ctParticles);
+  PermuteQuads( _atexCommon, _atexSorted, piSorted, ctParticles);
+  PermuteQuads( _acolCommon, _acolSorted, piSorted, ctParticles);
+  if( _bTransFogHaze) {
+    ASSERT( _atexFogHaze.Count()==ctParticles*4+4);
+    PermuteQuads( _atexFogHaze, _atexSorted, piSorted, ctParticles);
   }
 
 #ifndef NDEBUG
   // test to see whether the array is sorted
-  INDEX      *pidx = &aiInverse[0];
-  GFXVertex4 *pvtx = &_avtxCommon[0];
-  for( i=0; i<ctParticles-1; i++) {
-    ASSERT( pidx[i] < pidx[i+1]);
-    ASSERT( pvtx[i*4].z >= pvtx[(i+1)*4].z);
+  if( !b3D) {
+    pvtx = &_avtxCommon[0];
+    for( i=0; i<ctParticles-1; i++) ASSERT( pvtx[i*4].z >= pvtx[(i+1)*4].z);
   }
 #endif
 }
+
+
+
+// BENCHMARK
+
+static int qsort_CompareZ( const void *pI0, const void *pI1) {
+  const FLOAT fZ0 = _avtxCommon[(*(INDEX*)pI0)*4].z;
+  const FLOAT fZ1 = _avtxCommon[(*(INDEX*)pI1)*4].z;
+       if( fZ0<fZ1) return +1;
+  else if( fZ0>fZ1) return -1;
+  else              return  0;
+}
+
+// fill particle queue with random squares in front of viewer
+static void AddBenchmarkParticles( INDEX ctParticles)
+{
+  gfxResetArrays();
+  _atexFogHaze.PopAll();
+  _atexFogHaze.Push(4);
+  ULONG ulSeed = 12345;
+  #define RND() ((ulSeed=ulSeed*1103515245+12345, (ulSeed>>8)&0xFFFF) / 65535.0f)
+  for( INDEX i=0; i<ctParticles; i++) {
+    const FLOAT3D vPos( (RND()-0.5f)*100.0f, (RND()-0.5f)*60.0f, -5.0f-RND()*195.0f);
+    const ANGLE aRotation = (i&1) ? RND()*360.0f : 0.0f;
+    Particle_RenderSquare( vPos, 0.1f+RND(), aRotation, C_WHITE|CT_OPAQUE, 1.0f);
+  }
+  #undef RND
+}
+
+// measure queueing and sorting of particle squares without rendering them
+void ParticlesBenchmark(void *pArgs)
+{
+  INDEX ctParticles = NEXTARGUMENT(INDEX);
+  ctParticles = Clamp( ctParticles, (INDEX)100, (INDEX)200000);
+  const INDEX ctRepeats = 20;
+
+  // setup projection and state as if particles were rendered to 640x480 screen
+  CPerspectiveProjection3D pr;
+  pr.FOVL() = AngleDeg(90.0f);
+  pr.ScreenBBoxL() = FLOATaabbox2D( FLOAT2D(0,0), FLOAT2D(640,480));
+  pr.AspectRatioL() = 1.0f;
+  pr.FrontClipDistanceL() = 0.3f;
+  pr.ViewerPlacementL() = CPlacement3D( FLOAT3D(0,0,0), ANGLE3D(0,0,0));
+  pr.ObjectPlacementL() = CPlacement3D( FLOAT3D(0,0,0), ANGLE3D(0,0,0));
+  pr.Prepare();
+  CProjection3D *pprOld = _pprProjection;
+  const BOOL bHasFog = _Particle_bHasFog;
+  const BOOL bHasHaze = _Particle_bHasHaze;
+  _pprProjection = &pr;
+  _fPerspectiveFactor = pr.ppr_PerspectiveRatios(1);
+  _fNearClipDistance = -pr.pr_NearClipDistance;
+  _Particle_bHasFog = _Particle_bHasHaze = _bTransFogHaze = FALSE;
+  _colAttMask = 0xFFFFFF00;
+  _fTextureCorrectionU = _fTextureCorrectionV = 1.0f/256.0f;
+  Particle_SetTexturePart( 256, 256, 0, 0);
+
+  DOUBLE dQueue=0, dSort=0, dSort3D=0, dQSort=0;
+  INDEX ctQueued = 0, ctUnsorted = 0;
+  for( INDEX iRepeat=0; iRepeat<ctRepeats; iRepeat++) {
+    CTimerValue tv0 = _pTimer->GetHighPrecisionTimer();
+    AddBenchmarkParticles(ctParticles);
+    dQueue += (_pTimer->GetHighPrecisionTimer()-tv0).GetSeconds();
+    ctQueued = _avtxCommon.Count()/4;
+
+    // previous sort by comparator callback (indices only)
+    CStaticArray<INDEX> aiIndices;
+    aiIndices.New(ctQueued);
+    for( INDEX i=0; i<ctQueued; i++) aiIndices[i] = i;
+    tv0 = _pTimer->GetHighPrecisionTimer();
+    qsort( &aiIndices[0], ctQueued, sizeof(INDEX), qsort_CompareZ);
+    dQSort += (_pTimer->GetHighPrecisionTimer()-tv0).GetSeconds();
+
+    tv0 = _pTimer->GetHighPrecisionTimer();
+    Particle_Sort(FALSE);
+    dSort += (_pTimer->GetHighPrecisionTimer()-tv0).GetSeconds();
+    for( INDEX iCheck=0; iCheck<ctQueued-1; iCheck++) {
+      if( _avtxCommon[iCheck*4].z < _avtxCommon[(iCheck+1)*4].z) ctUnsorted++;
+    }
+
+    AddBenchmarkParticles(ctParticles);
+    tv0 = _pTimer->GetHighPrecisionTimer();
+    Particle_Sort(TRUE);
+    dSort3D += (_pTimer->GetHighPrecisionTimer()-tv0).GetSeconds();
+  }
+
+  // restore state
+  gfxResetArrays();
+  _atexFogHaze.PopAll();
+  _pprProjection = pprOld;
+  _Particle_bHasFog  = bHasFog;
+  _Particle_bHasHaze = bHasHaze;
+
+  const DOUBLE dToMs = 1000.0/ctRepeats;
+  CPrintF( TRANS("Particles benchmark (%d of %d particles queued, %d repeats):\n"), ctQueued, ctParticles, ctRepeats);
+  CPrintF( TRANS("  queue squares:       %7.3f ms\n"), dQueue *dToMs);
+  CPrintF( TRANS("  qsort indices only:  %7.3f ms\n"), dQSort *dToMs);
+  CPrintF( TRANS("  radix sort + reorder:%7.3f ms\n"), dSort  *dToMs);
+  CPrintF( TRANS("  radix sort 3D:       %7.3f ms\n"), dSort3D*dToMs);
+  if( ctUnsorted>0) CPrintF( TRANS("  WARNING: %d particles out of order!\n"), ctUnsorted);
+}
@@ -22,6 +22,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <Engine/Base/ErrorReporting.h>
 #include <Engine/Base/Console.h>
 #include <Engine/Base/Shell.h>
+#include <Engine/Base/Stream.h>
 #include <Engine/Base/Statistics_internal.h>
 #include <Engine/Base/ListIterator.inl>
 #include <Engine/Math/Functions.h>
@@ -40,9 +41,11 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <Engine/Graphics/Color.h>
 #include <Engine/Graphics/Font.h>
 #include <Engine/Graphics/MultiMonitor.h>
+#include <Engine/Graphics/TextureCompression.h>
 
 #include <Engine/Templates/DynamicStackArray.h>
 #include <Engine/Templates/DynamicStackArray.cpp>
+#include <Engine/Templates/StaticStackArray.cpp>
 #include <Engine/Templates/DynamicContainer.cpp>
 #include <Engine/Templates/Stock_CTextureData.h>
 
@@ -125,6 +128,7 @@ extern INDEX tex_iEffectSize     = 7;
 extern INDEX tex_bDynamicMipmaps = FALSE;     // how many mipmaps will be bilineary filtered (0-15)
 extern INDEX tex_iDithering      = 3;         // 0=none, 1-3=low, 4-7=medium, 8-10=high
 extern INDEX tex_bFineEffect = FALSE;         // 32bit effect? (works only if base texture hasn't been dithered)
+extern INDEX tex_bParallelEffects = TRUE;     // animate effect textures in advance on worker threads
 extern INDEX tex_bFineFog = TRUE;             // should fog be 8/32bit? (or just plain 4/16bit)
 extern INDEX tex_iFogSize = 7;                // limit fog texture size 
 extern INDEX tex_iFiltering = 0;              // -6 - +6; negative = sharpen, positive = blur, 0 = none
@@ -133,6 +137,7 @@ extern INDEX tex_bProgressiveFilter = FALSE;  // filter mipmaps in creation time
 extern INDEX tex_bColorizeMipmaps   = FALSE;  // DEBUG: colorize texture's mipmap levels in various colors
 extern INDEX tex_bCompressAlphaChannel = FALSE;  // for compressed textures, compress alpha channel too   
 extern INDEX tex_bAlternateCompression = FALSE;  // basically, this is fix for GFs (compress opaque texture as translucent)
+extern INDEX tex_bCompressionCache = TRUE;       // keep CPU-compressed textures in derived cache (Temp\TextureCache\)
 
 extern INDEX shd_iStaticSize  = 8;    
 extern INDEX shd_iDynamicSize = 8;    
@@ -176,6 +181,13 @@ extern INDEX d3d_iFinish = 0;
 // Vulkan control
 extern INDEX gfx_vk_iPresentMode = 0;           // what present mode to use: 0=FIFO, 1=Mailbox, 2=Immediate
 extern INDEX gfx_vk_iMSAA = 0;                  // MSAA: 0=1x, 1=2x, 2=4x, 3=8x
+extern INDEX gfx_vk_iTextureCompression = 1;    // CPU texture compression: 0=none, 1=BC1/BC3, 2=BC7
+extern INDEX gfx_vk_bPipelineCache = 1;         // keep pipeline cache on disk and precompile pipelines used in level
+extern INDEX gfx_vk_bBatchDraws = 1;            // merge consecutive draws with the same state
+extern INDEX gfx_vk_bResidentVerts = 1;         // upload vertex arrays only when they change
+extern INDEX gfx_vk_iRecordThreads = 0;         // record frame into this many secondary cmd buffers in parallel (0 = directly)
+extern INDEX gfx_vk_iDefragMoves = 4;           // max textures moved per frame to compact video memory, less uploaded ones (0 = never)
+extern INDEX gfx_vk_bMemoryTrace = 0;           // write texture memory allocations to Temp\VkMemoryTrace.txt
 
 // API common controls
 extern INDEX gap_iUseTextureUnits = 4;
@@ -210,11 +222,16 @@ extern INDEX mdl_iShadowQuality    = 1;
 extern FLOAT mdl_fLODMul           = 1.0f;
 extern FLOAT mdl_fLODAdd           = 0.0f;
 extern INDEX mdl_iLODDisappear     = 1; // 0=never, 1=ignore bias, 2=with bias
+extern INDEX mdl_bPreparedFrames   = TRUE;  // unpack frames from SIMD-friendly copy made at load time (extra memory)
+extern INDEX mdl_bCacheUnpackedFrames = TRUE;  // share unpacked frames between same instances in one frame
 // ska controls
 extern INDEX ska_bShowSkeleton     = FALSE;
 extern INDEX ska_bShowColision     = FALSE;
 extern FLOAT ska_fLODMul           = 1.0f;
 extern FLOAT ska_fLODAdd           = 0.0f;
+extern INDEX ska_bFastAnimSampling = TRUE;  // sample animations from key tables made at load time
+extern INDEX ska_bPoseCache        = TRUE;  // share poses and skinned meshes of same instances in a frame
+extern INDEX ska_iPoseCacheSteps   = 8;     // animation time steps per frame that count as same pose
 // terrain controls
 extern INDEX ter_bShowQuadTree     = FALSE;
 extern INDEX ter_bShowWireframe    = FALSE;
@@ -223,6 +240,7 @@ extern INDEX ter_bShowInfo         = FALSE;
 extern INDEX ter_bOptimizeRendering = TRUE;
 extern INDEX ter_bTempFreezeCast   = FALSE;
 extern INDEX ter_bNoRegeneration   = FALSE;
+extern INDEX ter_bParallelRegen    = TRUE;   // regenerate tiles and shadow map on job threads
 
 // rendering control
 extern INDEX wld_bAlwaysAddAll         = FALSE;
@@ -461,6 +479,76 @@ static void TexturesInfo(void)
 }
 
 
+// compress top mip-maps of all textures in given directory with each block format
+// and report quality and speed of CPU encoder (doesn't need any graphics API)
+static void TextureCompressionTest(void *pArgs)
+{
+  CTString strDir = *NEXTARGUMENT(CTString*);
+  CDynamicStackArray<CTFileName> afnmTextures;
+  MakeDirList( afnmTextures, CTFileName(strDir), "*.tex", DLI_RECURSIVE);
+  if( afnmTextures.Count()==0) {
+    CPrintF( TRANS("No textures found in '%s'.\n"), (const char*)strDir);
+    return;
+  }
+
+  const TexBlockFormat atbf[3] = { TBF_BC1, TBF_BC3, TBF_BC7 };
+  const char *astrNames[3] = { "BC1", "BC3", "BC7" };
+  DOUBLE adPSNRSum[3] = { 0, 0, 0 };
+  DOUBLE adPSNRMin[3] = { 99, 99, 99 };
+  DOUBLE adSeconds[3] = { 0, 0, 0 };
+  PIX pixTotal = 0;
+  INDEX ctTested = 0, ctSkipped = 0;
+  CStaticStackArray<UBYTE> aubCompressed;
+  CStaticStackArray<ULONG> aulDecompressed;
+
+  for( INDEX iTex=0; iTex<afnmTextures.Count(); iTex++)
+  {
+    CTextureData td;
+    try {
+      td.Load_t( afnmTextures[iTex]);
+    } catch( char *strError) {
+      CPrintF( "%s\n", strError);
+      ctSkipped++;
+      continue;
+    }
+    // effect textures and textures that are already uploaded don't have bitmaps
+    if( td.td_pulFrames==NULL || td.td_ptegEffect!=NULL) {
+      ctSkipped++;
+      continue;
+    }
+
+    const PIX pixWidth  = td.GetPixWidth();
+    const PIX pixHeight = td.GetPixHeight();
+    const PIX pixSize   = pixWidth*pixHeight;
+    const BOOL bAlpha   = td.td_ulFlags&TEX_ALPHACHANNEL;
+    aulDecompressed.PopAll();
+    aulDecompressed.Push(pixSize);
+
+    for( INDEX iFmt=0; iFmt<3; iFmt++) {
+      aubCompressed.PopAll();
+      aubCompressed.Push( GetCompressedMipSize( atbf[iFmt], pixWidth, pixHeight));
+      const CTimerValue tvStart = _pTimer->GetHighPrecisionTimer();
+      CompressBitmap( atbf[iFmt], td.td_pulFrames, &aubCompressed[0], pixWidth, pixHeight);
+      adSeconds[iFmt] += (_pTimer->GetHighPrecisionTimer()-tvStart).GetSeconds();
+      DecompressBitmap( atbf[iFmt], &aubCompressed[0], &aulDecompressed[0], pixWidth, pixHeight);
+      // BC1 cannot hold alpha, so it is measured on colors only
+      const DOUBLE dPSNR = GetBitmapPSNR( td.td_pulFrames, &aulDecompressed[0], pixSize, bAlpha && atbf[iFmt]!=TBF_BC1);
+      adPSNRSum[iFmt] += dPSNR;
+      adPSNRMin[iFmt]  = Min( adPSNRMin[iFmt], dPSNR);
+    }
+    pixTotal += pixSize;
+    ctTested++;
+  }
+
+  CPrintF( TRANS("\nTested %d textures (%d skipped), %.1f Mpix:\n"), ctTested, ctSkipped, pixTotal/1000000.0);
+  if( ctTested==0) return;
+  for( INDEX iFmt=0; iFmt<3; iFmt++) {
+    CPrintF( "  %s: avg PSNR %5.2f dB, min PSNR %5.2f dB, %6.2f Mpix/s\n", astrNames[iFmt],
+      adPSNRSum[iFmt]/ctTested, adPSNRMin[iFmt], pixTotal/1000000.0 / Max( adSeconds[iFmt], 0.000001));
+  }
+}
+
+
 
 // reformat an extensions string to cross multiple lines
 extern CTString ReformatExtensionsString( CTString strUnformatted)
@@ -484,6 +572,74 @@ extern CTString ReformatExtensionsString( CTString strUnformatted)
 }
 
 
+// printout pipeline cache and prewarming statistics
+static void PipelineCacheInfo(void)
+{
+#ifdef SE1_VULKAN
+  if( _pGfx->gl_eCurrentAPI==GAT_VK && _pGfx->gl_SvkMain->gl_VkDevice!=VK_NULL_HANDLE) {
+    _pGfx->gl_SvkMain->PrintPipelineStats();
+    return;
+  }
+#endif // SE1_VULKAN
+  CPrintF( TRANS("Pipeline cache is used only by Vulkan.\n"));
+}
+
+
+// time parallel recording of next frame's Vulkan commands with 1-8 threads
+static void RecordThreadsBenchmark(void)
+{
+#ifdef SE1_VULKAN
+  if( _pGfx->gl_eCurrentAPI==GAT_VK && _pGfx->gl_SvkMain->gl_VkDevice!=VK_NULL_HANDLE) {
+    if( gfx_vk_iRecordThreads<=0) {
+      CPrintF( TRANS("Set gfx_vk_iRecordThreads to record frames in parallel first.\n"));
+      return;
+    }
+    _pGfx->gl_SvkMain->gl_VkRecordBenchmark = true;
+    return;
+  }
+#endif // SE1_VULKAN
+  CPrintF( TRANS("Parallel recording is used only by Vulkan.\n"));
+}
+
+
+// print average CPU frame time and bytes uploaded per frame over next frames
+static void VulkanUploadStats(void *pArgs)
+{
+  INDEX ctFrames = NEXTARGUMENT(INDEX);
+#ifdef SE1_VULKAN
+  if( _pGfx->gl_eCurrentAPI==GAT_VK && _pGfx->gl_SvkMain->gl_VkDevice!=VK_NULL_HANDLE) {
+    _pGfx->gl_SvkMain->StartUploadStats( ClampDn( ctFrames, 1L));
+    return;
+  }
+#endif // SE1_VULKAN
+  CPrintF( TRANS("Upload stats are measured only by Vulkan.\n"));
+}
+
+
+// replay texture memory trace (or synthetic one) on fake memory and print fragmentation
+static void VulkanMemorySoak(void *pArgs)
+{
+  INDEX ctPasses = NEXTARGUMENT(INDEX);
+#ifdef SE1_VULKAN
+  SvkMemoryPool::SoakTest( ClampDn( ctPasses, 1L));
+#else
+  CPrintF( TRANS("Vulkan is not supported in this build.\n"));
+#endif // SE1_VULKAN
+}
+
+
+static void VulkanMemoryInfo(void)
+{
+#ifdef SE1_VULKAN
+  if( _pGfx->gl_eCurrentAPI==GAT_VK && _pGfx->gl_SvkMain->gl_VkImageMemPool!=NULL) {
+    _pGfx->gl_SvkMain->PrintTextureMemoryInfo();
+    return;
+  }
+#endif // SE1_VULKAN
+  CPrintF( TRANS("Vulkan is not active.\n"));
+}
+
+
 // printout extensive OpenGL/Direct3D info to console
 static void GAPInfo(void)
 {
@@ -1105,6 +1261,17 @@ void CGfxLibrary::Init(void)
 
   _pShell->DeclareSymbol("user void GAPInfo(void);",      &GAPInfo);
   _pShell->DeclareSymbol("user void TexturesInfo(void);", &TexturesInfo);
+  _pShell->DeclareSymbol("user void TextureCompressionTest(CTString);", &TextureCompressionTest);
+  extern void EffectTextureBenchmark(void *pArgs);
+  _pShell->DeclareSymbol("user void EffectTextureBenchmark(CTString);", &EffectTextureBenchmark);
+  extern void ModelUnpackBenchmark(void *pArgs);
+  _pShell->DeclareSymbol("user void ModelUnpackBenchmark(CTString);", &ModelUnpackBenchmark);
+  extern void SkaAnimBenchmark(void *pArgs);
+  _pShell->DeclareSymbol("user void SkaAnimBenchmark(CTString, INDEX);", &SkaAnimBenchmark);
+  extern void TerrainRegenBenchmark(void *pArgs);
+  extern void ParticlesBenchmark(void *pArgs);
+  _pShell->DeclareSymbol("user void ParticlesBenchmark(INDEX);", &ParticlesBenchmark);
+  _pShell->DeclareSymbol("user void TerrainRegenBenchmark(INDEX);", &TerrainRegenBenchmark);
   _pShell->DeclareSymbol("user void UncacheShadows(void);",  &UncacheShadows);
   _pShell->DeclareSymbol("user void RecacheShadows(void);",  &RecacheShadows);
   _pShell->DeclareSymbol("user void RefreshTextures(void);", &RefreshTextures);
@@ -1133,6 +1300,18 @@ void CGfxLibrary::Init(void)
 
   _pShell->DeclareSymbol("persistent user INDEX gfx_vk_iPresentMode;", &gfx_vk_iPresentMode);
   _pShell->DeclareSymbol("persistent user INDEX gfx_vk_iMSAA;", &gfx_vk_iMSAA);
+  _pShell->DeclareSymbol("persistent user INDEX gfx_vk_iTextureCompression;", &gfx_vk_iTextureCompression);
+  _pShell->DeclareSymbol("persistent user INDEX gfx_vk_bPipelineCache;", &gfx_vk_bPipelineCache);
+  _pShell->DeclareSymbol("persistent user INDEX gfx_vk_bBatchDraws;", &gfx_vk_bBatchDraws);
+  _pShell->DeclareSymbol("persistent user INDEX gfx_vk_bResidentVerts;", &gfx_vk_bResidentVerts);
+  _pShell->DeclareSymbol("persistent user INDEX gfx_vk_iRecordThreads;", &gfx_vk_iRecordThreads);
+  _pShell->DeclareSymbol("persistent user INDEX gfx_vk_iDefragMoves;", &gfx_vk_iDefragMoves);
+  _pShell->DeclareSymbol("user INDEX gfx_vk_bMemoryTrace;", &gfx_vk_bMemoryTrace);
+  _pShell->DeclareSymbol("user void PipelineCacheInfo(void);", &PipelineCacheInfo);
+  _pShell->DeclareSymbol("user void RecordThreadsBenchmark(void);", &RecordThreadsBenchmark);
+  _pShell->DeclareSymbol("user void VulkanMemorySoak(INDEX);", &VulkanMemorySoak);
+  _pShell->DeclareSymbol("user void VulkanUploadStats(INDEX);", &VulkanUploadStats);
+  _pShell->DeclareSymbol("user void VulkanMemoryInfo(void);", &VulkanMemoryInfo);
 
   _pShell->DeclareSymbol("persistent user INDEX gap_iUseTextureUnits;",   &gap_iUseTextureUnits);
   _pShell->DeclareSymbol("persistent user INDEX gap_iTextureFiltering;",  &gap_iTextureFiltering);
@@ -1161,6 +1340,8 @@ void CGfxLibrary::Init(void)
   _pShell->DeclareSymbol("persistent user FLOAT mdl_fLODMul;",       &mdl_fLODMul);
   _pShell->DeclareSymbol("persistent user FLOAT mdl_fLODAdd;",       &mdl_fLODAdd);
   _pShell->DeclareSymbol("persistent user INDEX mdl_iLODDisappear;", &mdl_iLODDisappear);
+  _pShell->DeclareSymbol("persistent user INDEX mdl_bPreparedFrames;",      &mdl_bPreparedFrames);
+  _pShell->DeclareSymbol("persistent user INDEX mdl_bCacheUnpackedFrames;", &mdl_bCacheUnpackedFrames);
   _pShell->DeclareSymbol("persistent user INDEX mdl_bRenderDetail;",     &mdl_bRenderDetail);
   _pShell->DeclareSymbol("persistent user INDEX mdl_bRenderSpecular;",   &mdl_bRenderSpecular);
   _pShell->DeclareSymbol("persistent user INDEX mdl_bRenderReflection;", &mdl_bRenderReflection);
@@ -1174,6 +1355,9 @@ void CGfxLibrary::Init(void)
   _pShell->DeclareSymbol("           user INDEX ska_bShowColision;",   &ska_bShowColision);
   _pShell->DeclareSymbol("persistent user FLOAT ska_fLODMul;",         &ska_fLODMul);
   _pShell->DeclareSymbol("persistent user FLOAT ska_fLODAdd;",         &ska_fLODAdd);
+  _pShell->DeclareSymbol("           user INDEX ska_bFastAnimSampling;", &ska_bFastAnimSampling);
+  _pShell->DeclareSymbol("           user INDEX ska_bPoseCache;",       &ska_bPoseCache);
+  _pShell->DeclareSymbol("           user INDEX ska_iPoseCacheSteps;",  &ska_iPoseCacheSteps);
   
   _pShell->DeclareSymbol("           user INDEX ter_bShowQuadTree;",   &ter_bShowQuadTree);
   _pShell->DeclareSymbol("           user INDEX ter_bShowWireframe;",  &ter_bShowWireframe);
@@ -1182,6 +1366,7 @@ void CGfxLibrary::Init(void)
   _pShell->DeclareSymbol("           user INDEX ter_bOptimizeRendering;", &ter_bOptimizeRendering);
   _pShell->DeclareSymbol("           user INDEX ter_bTempFreezeCast;   ", &ter_bTempFreezeCast);
   _pShell->DeclareSymbol("           user INDEX ter_bNoRegeneration;   ", &ter_bNoRegeneration);
+  _pShell->DeclareSymbol("persistent user INDEX ter_bParallelRegen;    ", &ter_bParallelRegen);
   
   
   
@@ -1198,6 +1383,7 @@ void CGfxLibrary::Init(void)
   _pShell->DeclareSymbol("persistent user INDEX tex_iNormalQuality;",    &tex_iNormalQuality);
   _pShell->DeclareSymbol("persistent user INDEX tex_iAnimationQuality;", &tex_iAnimationQuality);
   _pShell->DeclareSymbol("persistent user INDEX tex_bFineEffect;",       &tex_bFineEffect);
+  _pShell->DeclareSymbol("persistent user INDEX tex_bParallelEffects;",  &tex_bParallelEffects);
   _pShell->DeclareSymbol("persistent user INDEX tex_bFineFog;",          &tex_bFineFog);
   _pShell->DeclareSymbol("persistent user INDEX tex_iNormalSize;",    &tex_iNormalSize);
   _pShell->DeclareSymbol("persistent user INDEX tex_iAnimationSize;", &tex_iAnimationSize);
@@ -1205,6 +1391,7 @@ void CGfxLibrary::Init(void)
   _pShell->DeclareSymbol("persistent user INDEX tex_iFogSize;",       &tex_iFogSize);
   _pShell->DeclareSymbol("persistent user INDEX tex_bCompressAlphaChannel;", &tex_bCompressAlphaChannel);
   _pShell->DeclareSymbol("persistent user INDEX tex_bAlternateCompression;", &tex_bAlternateCompression);
+  _pShell->DeclareSymbol("persistent user INDEX tex_bCompressionCache;", &tex_bCompressionCache);
   _pShell->DeclareSymbol("persistent user INDEX tex_bDynamicMipmaps;", &tex_bDynamicMipmaps);
   _pShell->DeclareSymbol("persistent user INDEX tex_iDithering;",  &tex_iDithering);
   _pShell->DeclareSymbol("persistent user INDEX tex_iFiltering;",  &tex_iFiltering);
@@ -1520,6 +1707,17 @@ BOOL CGfxLibrary::SetCurrentViewport(CViewPort *pvp)
 }
 
 
+// new level is loaded, so driver may prepare render states that the level used last time
+void CGfxLibrary::PrepareForLevel( const CTFileName &fnmLevel)
+{
+#ifdef SE1_VULKAN
+  if( gl_eCurrentAPI==GAT_VK && gl_SvkMain->gl_VkDevice!=VK_NULL_HANDLE) {
+    gl_SvkMain->StartLevelPipelines(fnmLevel);
+  }
+#endif // SE1_VULKAN
+}
+
+
 // Lock a drawport for drawing
 BOOL CGfxLibrary::LockDrawPort( CDrawPort *pdpToLock)
 {
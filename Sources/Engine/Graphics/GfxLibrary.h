@@ -306,6 +306,9 @@ public:
 
   // simple benchmark routine
   void Benchmark( CViewPort *pvp, CDrawPort *pdp);
+
+  // new level is loaded, so driver may prepare render states that the level used last time
+  void PrepareForLevel( const class CTFileName &fnmLevel);
 };
 
 
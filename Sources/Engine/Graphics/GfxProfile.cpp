@@ -37,6 +37,7 @@ CGfxProfile::CGfxProfile(void)
   SETTIMERNAME(PTI_MAKEMIPMAPS,  "MakeMipmaps()", "");
   SETTIMERNAME(PTI_DITHERBITMAP, "DitherBitmap()", "");
   SETTIMERNAME(PTI_FILTERBITMAP, "FilterBitmap()", "");
+  SETTIMERNAME(PTI_COMPRESSBITMAP, "CompressBitmap()", "");
 
   SETTIMERNAME(PTI_RENDERSCENE,       "RenderScene", "");
   SETTIMERNAME(PTI_RENDERSCENE_BCG,   "rs_RenderScene_bcg", "");
@@ -68,8 +69,15 @@ CGfxProfile::CGfxProfile(void)
   SETCOUNTERNAME(PCI_CACHEDSHADOWBYTES,  "shadow bytes cached");
   SETCOUNTERNAME(PCI_DYNAMICSHADOWS,     "number of dynamic shadows cached");
   SETCOUNTERNAME(PCI_DYNAMICSHADOWBYTES, "dynamic shadow bytes cached");
+  SETCOUNTERNAME(PCI_COMPRESSIONCACHEHITS, "compressed textures from cache");
   SETCOUNTERNAME(PCI_RS_TRIANGLES,          "RS: triangles");
   SETCOUNTERNAME(PCI_RS_TRIANGLEPASSESORG,  "RS: triangle*passes");
   SETCOUNTERNAME(PCI_RS_TRIANGLEPASSESOPT,  "RS: triangle*passesMT");
   SETCOUNTERNAME(PCI_RS_POLYGONGROUPS,      "RS: polygon groups");
+  SETCOUNTERNAME(PCI_VK_DRAWS,              "VK: draws");
+  SETCOUNTERNAME(PCI_VK_DRAWCALLS,          "VK: draw calls after batching");
+  SETCOUNTERNAME(PCI_VK_PIPELINEBINDS,      "VK: pipeline binds");
+  SETCOUNTERNAME(PCI_VK_DESCRIPTORBINDS,    "VK: descriptor set binds");
+  SETCOUNTERNAME(PCI_VK_BUFFERBINDS,        "VK: vertex/index buffer binds");
+  SETCOUNTERNAME(PCI_VK_BYTESUPLOADED,      "VK: bytes uploaded");
 }
@@ -38,6 +38,7 @@ public:
     PTI_MAKEMIPMAPS,
     PTI_DITHERBITMAP,
     PTI_FILTERBITMAP,
+    PTI_COMPRESSBITMAP,
 
     PTI_RENDERSCENE,
     PTI_RENDERSCENE_BCG,
@@ -74,11 +75,19 @@ public:
     PCI_CACHEDSHADOWBYTES,  // shadowmap bytes cached
     PCI_DYNAMICSHADOWS,      
     PCI_DYNAMICSHADOWBYTES,  
+    PCI_COMPRESSIONCACHEHITS, // how many compressed textures were taken from derived cache
 
     PCI_RS_TRIANGLES,
     PCI_RS_TRIANGLEPASSESORG,
     PCI_RS_TRIANGLEPASSESOPT,
     PCI_RS_POLYGONGROUPS,
+
+    PCI_VK_DRAWS,           // draws requested from Vulkan
+    PCI_VK_DRAWCALLS,       // indexed draws recorded after batching
+    PCI_VK_PIPELINEBINDS,
+    PCI_VK_DESCRIPTORBINDS,
+    PCI_VK_BUFFERBINDS,
+    PCI_VK_BYTESUPLOADED,   // vertex and index bytes copied to dynamic buffers
     PCI_COUNT,
   };
   // constructor
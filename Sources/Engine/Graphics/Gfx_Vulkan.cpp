@@ -23,6 +23,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <Engine/Graphics/GfxLibrary.h>
 #include <Engine/Graphics/Vulkan/SvkMain.h>
 #include <Engine/Graphics/ViewPort.h>
+#include <Engine/Graphics/GfxProfile.h>
 
 #include <Engine/Templates/StaticStackArray.cpp>
 #include <Engine/Templates/DynamicContainer.cpp>
@@ -47,6 +48,11 @@ extern ULONG _haze_ulTexture;
 static uint32_t _no_ulTexture;
 static uint64_t _no_ulTextureDescSet;
 
+extern INDEX gfx_vk_bBatchDraws;
+extern INDEX gfx_vk_bResidentVerts;
+extern INDEX gfx_vk_iRecordThreads;
+extern INDEX gfx_vk_iDefragMoves;
+
 extern BOOL GFX_abTexture[GFX_MAXTEXUNITS];
 
 extern BOOL GFX_bDepthTest;
@@ -160,13 +166,38 @@ BOOL SvkMain::InitDriver_Vulkan()
   instanceInfo.pApplicationInfo = &appInfo;
 
   // hard coded Windows extensions
-  const char* extensions[] = {
+  const char* extensions[4] = {
     VK_KHR_SURFACE_EXTENSION_NAME,
     VK_KHR_WIN32_SURFACE_EXTENSION_NAME,
+  };
+  uint32_t extensionCount = 2;
 #if SVK_ENABLE_VALIDATION
-    VK_EXT_DEBUG_UTILS_EXTENSION_NAME
+  extensions[extensionCount++] = VK_EXT_DEBUG_UTILS_EXTENSION_NAME;
 #endif
-  };
+
+  // optional, for querying memory budget
+  bool hasProperties2 = false;
+  {
+    uint32_t instanceExtCount;
+    vkEnumerateInstanceExtensionProperties(nullptr, &instanceExtCount, nullptr);
+
+    CStaticArray<VkExtensionProperties> instanceExts;
+    instanceExts.New(instanceExtCount);
+    if (instanceExtCount > 0)
+    {
+      vkEnumerateInstanceExtensionProperties(nullptr, &instanceExtCount, &instanceExts[0]);
+    }
+
+    for (uint32_t i = 0; i < instanceExtCount; i++)
+    {
+      if (CTString(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == instanceExts[i].extensionName)
+      {
+        hasProperties2 = true;
+        extensions[extensionCount++] = VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME;
+        break;
+      }
+    }
+  }
 
 #if SVK_ENABLE_VALIDATION
   VkDebugUtilsMessengerCreateInfoEXT debugMsgInfo = {};
@@ -179,13 +210,13 @@ BOOL SvkMain::InitDriver_Vulkan()
     gl_VkLayers[1] = "VK_LAYER_LUNARG_monitor";
   }
 
-  instanceInfo.enabledExtensionCount = 3;
+  instanceInfo.enabledExtensionCount = extensionCount;
   instanceInfo.ppEnabledExtensionNames = extensions;
   instanceInfo.enabledLayerCount = (uint32_t)gl_VkLayers.Count();
   instanceInfo.ppEnabledLayerNames = &gl_VkLayers[0];
   instanceInfo.pNext = &debugMsgInfo;
 #else
-  instanceInfo.enabledExtensionCount = 2;
+  instanceInfo.enabledExtensionCount = extensionCount;
   instanceInfo.ppEnabledExtensionNames = extensions;
   instanceInfo.enabledLayerCount = 0;
 #endif
@@ -203,6 +234,9 @@ BOOL SvkMain::InitDriver_Vulkan()
     return FALSE;
   }
 
+  gl_VkGetMemoryProperties2 = hasProperties2 ?
+    (PFN_vkGetPhysicalDeviceMemoryProperties2KHR)vkGetInstanceProcAddr(gl_VkInstance, "vkGetPhysicalDeviceMemoryProperties2KHR") : nullptr;
+
 #if SVK_ENABLE_VALIDATION
   auto pfnCreateDUMsg = (PFN_vkCreateDebugUtilsMessengerEXT)vkGetInstanceProcAddr(gl_VkInstance, "vkCreateDebugUtilsMessengerEXT");
   if (pfnCreateDUMsg != nullptr) 
@@ -285,6 +319,9 @@ void SvkMain::EndDriver_Vulkan(void)
   DestroyShaderModules();
   DestroyOcclusionQuerying();
 
+  SaveLevelPipelines();
+  SavePipelineCache();
+
   vkDestroyPipelineCache(gl_VkDevice, gl_VkPipelineCache, nullptr);
   vkDestroyRenderPass(gl_VkDevice, gl_VkRenderPass, nullptr);
   vkDestroySurfaceKHR(gl_VkInstance, gl_VkSurface, nullptr);
@@ -336,6 +373,20 @@ void SvkMain::Reset_Vulkan()
   gl_VkShaderModuleVertOcclusion = VK_NULL_HANDLE;
   gl_VkShaderModuleFragOcclusion = VK_NULL_HANDLE;
   gl_VkPreviousPipeline = nullptr;
+  gl_VkDrawBatch = {};
+  gl_VkLastUniformValid = false;
+  gl_VkLastUniformData = nullptr;
+  gl_VkLastMatrixIndex = 0;
+  gl_VkVertsDirty = true;
+  gl_VkVertsBuffer = VK_NULL_HANDLE;
+  gl_VkVertsOffset = 0;
+  gl_VkBoundState = {};
+  ResetBoundState();
+  gl_VkRecordThreads = 0;
+  gl_VkRecordBenchmark = false;
+  gl_VkFrameBytesUploaded = 0;
+  gl_VkUploadStatsFrames = 0;
+  gl_VkUploadStatsCount = 0;
 
   // reset states to default
   gl_VkGlobalState = SVK_PLS_DEFAULT_FLAGS;
@@ -343,6 +394,10 @@ void SvkMain::Reset_Vulkan()
 
   gl_VkLastTextureId = 1;
   gl_VkImageMemPool = nullptr;
+  gl_VkImageMemBackend = nullptr;
+  gl_VkGetMemoryProperties2 = nullptr;
+  gl_VkMemoryBudgetSupported = false;
+  gl_VkTexturesUploaded = 0;
 
   gl_VkPhysDevice = VK_NULL_HANDLE;
   gl_VkPhMemoryProperties = {};
@@ -359,6 +414,21 @@ void SvkMain::Reset_Vulkan()
 
   gl_VkPipelineOcclusion = VK_NULL_HANDLE;
 
+  gl_VkPrewarmThread = NULL;
+  gl_VkPrewarmReady = 0;
+  gl_VkPrewarmAbort = FALSE;
+  gl_VkPrewarmAdopted = 0;
+  gl_VkLevelName = CTString("");
+  gl_VkLevelIndex = 0;
+  gl_VkLevelRendered = false;
+  gl_VkLevelFirstFrameDone = true;
+  gl_VkPipelineCacheLoaded = 0;
+  gl_VkPipelinesCompiled = 0;
+  gl_VkPipelinesPrewarmed = 0;
+  gl_VkLevelCompiled = 0;
+  gl_VkLevelPrewarmed = 0;
+  gl_VkLevelFirstFrameCompiled = 0;
+
   gl_VkDebugMessenger = VK_NULL_HANDLE;
 
   for (uint32_t i = 0; i < gl_VkMaxCmdBufferCount; i++)
@@ -369,6 +439,12 @@ void SvkMain::Reset_Vulkan()
     gl_VkCmdBuffers[i] = VK_NULL_HANDLE;
     gl_VkCmdBuffers[i + gl_VkMaxCmdBufferCount] = VK_NULL_HANDLE;
     gl_VkImageAvailableSemaphores[i] = VK_NULL_HANDLE;
+
+    for (uint32_t j = 0; j < SVK_MAX_RECORD_THREADS; j++)
+    {
+      gl_VkSecondaryCmdPools[i][j] = VK_NULL_HANDLE;
+      gl_VkSecondaryCmdBuffers[i][j] = VK_NULL_HANDLE;
+    }
     gl_VkRenderFinishedSemaphores[i] = VK_NULL_HANDLE;
     gl_VkCmdFences[i] = VK_NULL_HANDLE;
 
@@ -468,7 +544,15 @@ void SvkMain::InitContext_Vulkan()
   _pGfx->gl_ulFlags |= GLF_HASACCELERATION;
   _pGfx->gl_ulFlags |= GLF_32BITTEXTURES;
   _pGfx->gl_ulFlags |= GLF_VSYNC;
-  _pGfx->gl_ulFlags &= ~GLF_TEXTURECOMPRESSION;
+  // textures are compressed on CPU, so only sampling of BC formats must be supported
+  if (gl_VkPhFeatures.textureCompressionBC)
+  {
+    _pGfx->gl_ulFlags |= GLF_TEXTURECOMPRESSION;
+  }
+  else
+  {
+    _pGfx->gl_ulFlags &= ~GLF_TEXTURECOMPRESSION;
+  }
   _pGfx->gl_ulFlags |= GLF_EXT_EDGECLAMP;
 
   // setup fog and haze textures
@@ -485,7 +569,7 @@ void SvkMain::InitContext_Vulkan()
   uint32_t noTexturePixels[] = { 0xFFFFFFFF, 0xFFFFFFFF };
   VkExtent2D noTextureSize = { 1, 1 };
   _no_ulTexture = CreateTexture();
-  InitTexture32Bit(_no_ulTexture, VK_FORMAT_R8G8B8A8_UNORM, noTexturePixels, &noTextureSize, 1, false);
+  InitTexture(_no_ulTexture, VK_FORMAT_R8G8B8A8_UNORM, noTexturePixels, &noTextureSize, 1, false);
 
   // prepare pattern texture
   extern CTexParams _tpPattern;
@@ -643,9 +727,14 @@ void SvkMain::SetViewport_Vulkan(float leftUpperX, float leftUpperY, float width
   gl_VkCurrentScissor.offset.y = leftUpperY;
 
   ASSERT(gl_VkCmdIsRecording);
-  
-  vkCmdSetViewport(GetCurrentCmdBuffer(), 0, 1, &gl_VkCurrentViewport);
-  vkCmdSetScissor(GetCurrentCmdBuffer(), 0, 1, &gl_VkCurrentScissor);
+
+  FlushDrawBatch();
+
+  SvkRenderCommand rc;
+  rc.src_Type = SRC_VIEWPORT;
+  rc.src_Viewport = gl_VkCurrentViewport;
+  rc.src_Scissor = gl_VkCurrentScissor;
+  AddRenderCommand(rc);
 }
 
 BOOL SvkMain::InitSurface_Win32(HINSTANCE hinstance, HWND hwnd)
@@ -691,14 +780,32 @@ BOOL SvkMain::CreateDevice()
   VkPhysicalDeviceFeatures features = {};
   features.samplerAnisotropy = VK_TRUE;
   features.depthBounds = VK_TRUE;
+  features.textureCompressionBC = gl_VkPhFeatures.textureCompressionBC;
+
+  // memory budget is optional, it's only used to choose chunk sizes
+  CStaticArray<const char *> budgetExtensions;
+  budgetExtensions.New(1);
+  budgetExtensions[0] = VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+  gl_VkMemoryBudgetSupported = gl_VkGetMemoryProperties2 != nullptr && CheckDeviceExtensions(gl_VkPhysDevice, budgetExtensions);
+
+  CStaticArray<const char *> deviceExtensions;
+  deviceExtensions.New(gl_VkPhysDeviceExtensions.Count() + (gl_VkMemoryBudgetSupported ? 1 : 0));
+  for (INDEX i = 0; i < gl_VkPhysDeviceExtensions.Count(); i++)
+  {
+    deviceExtensions[i] = gl_VkPhysDeviceExtensions[i];
+  }
+  if (gl_VkMemoryBudgetSupported)
+  {
+    deviceExtensions[gl_VkPhysDeviceExtensions.Count()] = VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+  }
 
   VkDeviceCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
   createInfo.queueCreateInfoCount = (uint32_t)queueInfos.Count();
   createInfo.pQueueCreateInfos = &queueInfos[0];
   createInfo.pEnabledFeatures = &features;
-  createInfo.enabledExtensionCount = (uint32_t)gl_VkPhysDeviceExtensions.Count();
-  createInfo.ppEnabledExtensionNames = &gl_VkPhysDeviceExtensions[0];
+  createInfo.enabledExtensionCount = (uint32_t)deviceExtensions.Count();
+  createInfo.ppEnabledExtensionNames = &deviceExtensions[0];
 #if SVK_ENABLE_VALIDATION
   createInfo.enabledLayerCount = (uint32_t)gl_VkLayers.Count();
   createInfo.ppEnabledLayerNames = &gl_VkLayers[0];
@@ -833,6 +940,22 @@ void SvkMain::CreateCmdBuffers()
     r = vkAllocateCommandBuffers(gl_VkDevice, &allocInfo, &gl_VkCmdBuffers[i + gl_VkMaxCmdBufferCount]);
     VK_CHECKERROR(r);
   }
+
+  // each recording thread needs its own pool
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+
+  for (uint32_t i = 0; i < gl_VkMaxCmdBufferCount; i++)
+  {
+    for (uint32_t j = 0; j < SVK_MAX_RECORD_THREADS; j++)
+    {
+      r = vkCreateCommandPool(gl_VkDevice, &cmdPoolInfo, nullptr, &gl_VkSecondaryCmdPools[i][j]);
+      VK_CHECKERROR(r);
+
+      allocInfo.commandPool = gl_VkSecondaryCmdPools[i][j];
+      r = vkAllocateCommandBuffers(gl_VkDevice, &allocInfo, &gl_VkSecondaryCmdBuffers[i][j]);
+      VK_CHECKERROR(r);
+    }
+  }
 }
 
 void SvkMain::DestroyCmdBuffers()
@@ -843,6 +966,14 @@ void SvkMain::DestroyCmdBuffers()
 
     gl_VkCmdBuffers[i] = VK_NULL_HANDLE;
     gl_VkCmdPools[i] = VK_NULL_HANDLE;
+
+    for (uint32_t j = 0; j < SVK_MAX_RECORD_THREADS; j++)
+    {
+      vkDestroyCommandPool(gl_VkDevice, gl_VkSecondaryCmdPools[i][j], nullptr);
+
+      gl_VkSecondaryCmdBuffers[i][j] = VK_NULL_HANDLE;
+      gl_VkSecondaryCmdPools[i][j] = VK_NULL_HANDLE;
+    }
   }
 }
 
@@ -882,6 +1013,10 @@ void SvkMain::StartFrame()
   // fences must be set to unsignaled state manually
   vkResetFences(gl_VkDevice, 1, &gl_VkCmdFences[gl_VkCmdBufferCurrent]);
 
+  // GPU work of this cmd buffer is done, so time only what CPU does from now on
+  gl_VkFrameStartTime = _pTimer->GetHighPrecisionTimer();
+  gl_VkFrameBytesUploaded = 0;
+
   // get next image index
   AcquireNextImage();
 
@@ -894,15 +1029,42 @@ void SvkMain::StartFrame()
 
   FreeDeletedTextures(gl_VkCmdBufferCurrent);
 
-  // reset previous pipeline
-  gl_VkPreviousPipeline = nullptr;
+  // move textures out of sparse memory chunks; uploads of previous frame take from
+  // the moves budget, but one texture is still moved, so that streaming can't stall it
+  INDEX defragMoves = 0;
+  if (gfx_vk_iDefragMoves > 0)
+  {
+    defragMoves = Max(gfx_vk_iDefragMoves - (INDEX)gl_VkTexturesUploaded, 1L);
+  }
+  gl_VkTexturesUploaded = 0;
 
-  PrepareDescriptorSets(gl_VkCmdBufferCurrent);
+  // take pipelines that were compiled in background
+  if (gl_VkPrewarmPipelines.Count() > 0)
+  {
+    AdoptPrewarmedPipelines();
+  }
 
-  _no_ulTextureDescSet = GetTextureDescriptor(_no_ulTexture);
+  // nothing is bound in new cmd buffer, and uniforms start anew
+  ResetBoundState();
+  gl_VkDrawBatch.sdw_IndexCount = 0;
+  gl_VkLastUniformValid = false;
+  gl_VkVertsDirty = true;
+
+  PrepareDescriptorSets(gl_VkCmdBufferCurrent);
 
   vkResetCommandPool(gl_VkDevice, gl_VkCmdPools[gl_VkCmdBufferCurrent], VK_COMMAND_POOL_RESET_RELEASE_RESOURCES_BIT);
 
+  // render pass contents must be known when it begins
+  gl_VkRecordThreads = Clamp(gfx_vk_iRecordThreads, 0L, (INDEX)SVK_MAX_RECORD_THREADS);
+  gl_VkRenderCommands.PopAll();
+  if (gl_VkRecordThreads > 0)
+  {
+    for (uint32_t i = 0; i < SVK_MAX_RECORD_THREADS; i++)
+    {
+      vkResetCommandPool(gl_VkDevice, gl_VkSecondaryCmdPools[gl_VkCmdBufferCurrent][i], 0);
+    }
+  }
+
   VkCommandBuffer cmd = gl_VkCmdBuffers[gl_VkCmdBufferCurrent];
 
   VkCommandBufferBeginInfo beginInfo = {};
@@ -917,6 +1079,15 @@ void SvkMain::StartFrame()
   // reset occlusion query pool
   ResetOcclusionQueries(cmd, gl_VkCmdBufferCurrent);
 
+  // texture copies go before the render pass in the same cmd buffer
+  if (defragMoves > 0)
+  {
+    DefragmentTextures(cmd, defragMoves);
+  }
+
+  // descriptors must be made after textures were moved
+  _no_ulTextureDescSet = GetTextureDescriptor(_no_ulTexture);
+
   VkClearValue clearValues[2];
   clearValues[0].color = { 0.25f, 0.25f, 0.25f, 1.0f };
   clearValues[1].depthStencil = { 0.0f, 0 };
@@ -930,7 +1101,8 @@ void SvkMain::StartFrame()
   renderPassInfo.clearValueCount = 2;
   renderPassInfo.pClearValues = clearValues;
 
-  vkCmdBeginRenderPass(cmd, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+  vkCmdBeginRenderPass(cmd, &renderPassInfo,
+    gl_VkRecordThreads > 0 ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
 
   // it is guaranteed that viewport and scissor will be set dynamically
 }
@@ -942,7 +1114,13 @@ void SvkMain::UpdateViewportDepth(float minDepth, float maxDepth)
 
   ASSERT(gl_VkCmdIsRecording);
 
-  vkCmdSetViewport(GetCurrentCmdBuffer(), 0, 1, &gl_VkCurrentViewport);
+  FlushDrawBatch();
+
+  SvkRenderCommand rc;
+  rc.src_Type = SRC_VIEWPORT;
+  rc.src_Viewport = gl_VkCurrentViewport;
+  rc.src_Scissor = gl_VkCurrentScissor;
+  AddRenderCommand(rc);
 }
 
 void SvkMain::EndFrame()
@@ -950,8 +1128,25 @@ void SvkMain::EndFrame()
   VkResult r;
   VkCommandBuffer cmd = gl_VkCmdBuffers[gl_VkCmdBufferCurrent];
 
+  FlushDrawBatch();
   FlushDynamicBuffersMemory();
 
+  if (gl_VkRecordThreads > 0)
+  {
+    if (gl_VkRecordBenchmark)
+    {
+      RunRecordBenchmark();
+      gl_VkRecordBenchmark = false;
+    }
+
+    uint32_t secondaryCount = RecordSecondaryCmdBuffers(gl_VkRecordThreads, true);
+    if (secondaryCount > 0)
+    {
+      vkCmdExecuteCommands(cmd, secondaryCount, gl_VkSecondaryCmdBuffers[gl_VkCmdBufferCurrent]);
+    }
+  }
+  AddBoundStateCounters(gl_VkBoundState);
+
   vkCmdEndRenderPass(cmd);
 
   gl_VkCmdIsRecording = false;
@@ -980,17 +1175,51 @@ void SvkMain::EndFrame()
   // submit cmd buffer; fence will be in signaled state when cmd will be done
   r = vkQueueSubmit(gl_VkQueueGraphics, 1, submitInfo, gl_VkCmdFences[gl_VkCmdBufferCurrent]);
   VK_CHECKERROR(r);
+
+  AddUploadStats();
+  EndLevelFrame();
 }
 
-VkCommandBuffer SvkMain::GetCurrentCmdBuffer()
+void SvkMain::StartUploadStats(INDEX ctFrames)
 {
-  return gl_VkCmdBuffers[gl_VkCmdBufferCurrent];
+  gl_VkUploadStatsFrames = ctFrames;
+  gl_VkUploadStatsCount = 0;
+  gl_VkUploadStatsSeconds = 0;
+  gl_VkUploadStatsMaxSeconds = 0;
+  gl_VkUploadStatsBytes = 0;
+  gl_VkUploadStatsMaxBytes = 0;
 }
 
-void SvkMain::DrawTriangles(uint32_t indexCount, const uint32_t *indices)
+void SvkMain::AddUploadStats()
 {
-  VkCommandBuffer cmd = gl_VkCmdBuffers[gl_VkCmdBufferCurrent];
+  if (gl_VkUploadStatsFrames <= 0)
+  {
+    return;
+  }
+
+  DOUBLE dSeconds = (_pTimer->GetHighPrecisionTimer() - gl_VkFrameStartTime).GetSeconds();
+  gl_VkUploadStatsSeconds += dSeconds;
+  gl_VkUploadStatsMaxSeconds = Max(gl_VkUploadStatsMaxSeconds, dSeconds);
+  gl_VkUploadStatsBytes += gl_VkFrameBytesUploaded;
+  gl_VkUploadStatsMaxBytes = Max(gl_VkUploadStatsMaxBytes, gl_VkFrameBytesUploaded);
+  gl_VkUploadStatsCount++;
+
+  if (gl_VkUploadStatsCount < gl_VkUploadStatsFrames)
+  {
+    return;
+  }
+
+  const INDEX ct = gl_VkUploadStatsCount;
+  CPrintF(TRANS("Vulkan, %d frames (resident verts %s):\n"), ct, gfx_vk_bResidentVerts ? "on" : "off");
+  CPrintF(TRANS("  CPU frame time: %.3f ms average, %.3f ms max\n"),
+    gl_VkUploadStatsSeconds * 1000.0 / ct, gl_VkUploadStatsMaxSeconds * 1000.0);
+  CPrintF(TRANS("  uploaded: %d KB average, %d KB max per frame\n"),
+    (SLONG)(gl_VkUploadStatsBytes / ct / 1024), gl_VkUploadStatsMaxBytes / 1024);
+  gl_VkUploadStatsFrames = 0;
+}
 
+void SvkMain::DrawTriangles(uint32_t indexCount, const uint32_t *indices)
+{
   // prepare data
   CStaticStackArray<SvkVertex> &verts = gl_VkVerts;
   ASSERT(verts.Count() > 0);
@@ -999,6 +1228,8 @@ void SvkMain::DrawTriangles(uint32_t indexCount, const uint32_t *indices)
   uint32_t indicesSize = indexCount * sizeof(UINT);
   uint32_t uniformSize = 16 * sizeof(FLOAT);
 
+  _pfGfxProfile.IncrementCounter(CGfxProfile::PCI_VK_DRAWS);
+
   FLOAT mvp[16];
   if (GFX_bViewMatrix)
   {
@@ -1009,35 +1240,36 @@ void SvkMain::DrawTriangles(uint32_t indexCount, const uint32_t *indices)
     Svk_MatCopy(mvp, VkProjectionMatrix);
   }
 
-  // get buffers
-  SvkDynamicBuffer vertexBuffer, indexBuffer;
-  SvkDynamicUniform uniformBuffer;
-
-  GetVertexBuffer(vertsSize, vertexBuffer);
-  GetIndexBuffer(indicesSize, indexBuffer);
-  GetUniformBuffer(uniformSize, uniformBuffer);
-
-  // copy data
-  memcpy(vertexBuffer.sdb_Data, &verts[0], vertsSize);
-  memcpy(indexBuffer.sdb_Data, indices, indicesSize);
-  memcpy(uniformBuffer.sdb_Data, mvp, uniformSize);
+  // new matrix is needed only if it has changed; it's added to current window of uniform
+  // buffer, so the descriptor set has to be rebound only when a new window is started
+  if (!gl_VkLastUniformValid || memcmp(mvp, gl_VkLastMVP, sizeof(mvp)) != 0)
+  {
+    if (!gl_VkLastUniformValid || gl_VkLastMatrixIndex + 1 >= SVK_MATRICES_PER_WINDOW)
+    {
+      SvkDynamicUniform uniformBuffer;
+      GetUniformBuffer(SVK_DYNAMIC_UNIFORM_MAX_ALLOC_SIZE, uniformBuffer);
 
-  uint32_t descSetOffset = (uint32_t)uniformBuffer.sdb_CurrentOffset;
+      gl_VkLastUniformSet = uniformBuffer.sdu_DescriptorSet;
+      gl_VkLastUniformOffset = (uint32_t)uniformBuffer.sdb_CurrentOffset;
+      gl_VkLastUniformData = (FLOAT *)uniformBuffer.sdb_Data;
+      gl_VkLastMatrixIndex = 0;
+    }
+    else
+    {
+      gl_VkLastMatrixIndex++;
+    }
 
-  // if previously not bound or flags don't match then bind new pipeline
-  if (gl_VkPreviousPipeline == nullptr || (gl_VkPreviousPipeline != nullptr && gl_VkPreviousPipeline->sps_Flags != gl_VkGlobalState))
-  {
-    // bind pipeline
-    SvkPipelineState &ps = GetPipeline(gl_VkGlobalState);
-    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, ps.sps_Pipeline);
-    // save as it's most likely that next will be same
-    gl_VkPreviousPipeline = &ps;
+    memcpy(gl_VkLastUniformData + gl_VkLastMatrixIndex * 16, mvp, uniformSize);
+    memcpy(gl_VkLastMVP, mvp, sizeof(mvp));
+    gl_VkLastUniformValid = true;
+    _pfGfxProfile.IncrementCounter(CGfxProfile::PCI_VK_BYTESUPLOADED, uniformSize);
+    gl_VkFrameBytesUploaded += uniformSize;
   }
 
-  VkDescriptorSet sets[5] = { uniformBuffer.sdu_DescriptorSet };
+  VkDescriptorSet sets[5] = { gl_VkLastUniformSet };
   float textureColorScale = 1.0f;
 
-  // bind texture descriptors
+  // get texture descriptors
   for (uint32_t i = 0; i < GFX_MAXTEXUNITS; i++)
   {
     if (GFX_abTexture[i])
@@ -1057,21 +1289,99 @@ void SvkMain::DrawTriangles(uint32_t indexCount, const uint32_t *indices)
     sets[i + 1] = _no_ulTextureDescSet;
   }
 
-  // set uniform and textures
-  vkCmdBindDescriptorSets(
-    cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, gl_VkPipelineLayout,
-    0, 5, sets,
-    1, &descSetOffset);
+  // upload vertices only if arrays were changed since last draw,
+  // as the same arrays are usually drawn in several chunks (e.g. per texture in RenderScene)
+  if (gl_VkVertsDirty || !gfx_vk_bResidentVerts)
+  {
+    SvkDynamicBuffer vertexBuffer;
+    GetVertexBuffer(vertsSize, vertexBuffer);
+    memcpy(vertexBuffer.sdb_Data, &verts[0], vertsSize);
+
+    gl_VkVertsBuffer = vertexBuffer.sdb_Buffer;
+    gl_VkVertsOffset = vertexBuffer.sdb_CurrentOffset;
+    gl_VkVertsDirty = false;
+    _pfGfxProfile.IncrementCounter(CGfxProfile::PCI_VK_BYTESUPLOADED, vertsSize);
+    gl_VkFrameBytesUploaded += vertsSize;
+  }
+
+  SvkDynamicBuffer indexBuffer;
+  GetIndexBuffer(indicesSize, indexBuffer);
+  _pfGfxProfile.IncrementCounter(CGfxProfile::PCI_VK_BYTESUPLOADED, indicesSize);
+  gl_VkFrameBytesUploaded += indicesSize;
+
+  // append to current batch if state is the same, vertices are in the same buffer
+  // after batch's first vertex and indices continue where batch ends
+  SvkDrawBatch &batch = gl_VkDrawBatch;
+  bool append = gfx_vk_bBatchDraws && batch.sdw_IndexCount > 0
+    && batch.sdw_Flags == gl_VkGlobalState
+    && batch.sdw_UniformOffset == gl_VkLastUniformOffset && batch.sdw_MatrixIndex == gl_VkLastMatrixIndex
+    && batch.sdw_TextureColorScale == textureColorScale
+    && memcmp(batch.sdw_Sets, sets, sizeof(sets)) == 0
+    && batch.sdw_VertexBuffer == gl_VkVertsBuffer && batch.sdw_VertexStart <= gl_VkVertsOffset
+    && (gl_VkVertsOffset - batch.sdw_VertexStart) % SVK_VERT_SIZE == 0
+    && batch.sdw_IndexBuffer == indexBuffer.sdb_Buffer && batch.sdw_IndexEnd == indexBuffer.sdb_CurrentOffset;
+
+  if (!append)
+  {
+    FlushDrawBatch();
+
+    batch.sdw_Flags = gl_VkGlobalState;
+    memcpy(batch.sdw_Sets, sets, sizeof(sets));
+    batch.sdw_UniformOffset = gl_VkLastUniformOffset;
+    batch.sdw_MatrixIndex = gl_VkLastMatrixIndex;
+    batch.sdw_TextureColorScale = textureColorScale;
+    batch.sdw_VertexBuffer = gl_VkVertsBuffer;
+    batch.sdw_VertexStart = gl_VkVertsOffset;
+    batch.sdw_IndexBuffer = indexBuffer.sdb_Buffer;
+    batch.sdw_IndexStart = indexBuffer.sdb_CurrentOffset;
+  }
 
-  // set texture color scales
-  vkCmdPushConstants(cmd, gl_VkPipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 
-    0, sizeof(float), &textureColorScale);
+  // copy indices; they must be relative to first vertex of the batch
+  const uint32_t baseVertex = (uint32_t)((gl_VkVertsOffset - batch.sdw_VertexStart) / SVK_VERT_SIZE);
+  if (baseVertex == 0)
+  {
+    memcpy(indexBuffer.sdb_Data, indices, indicesSize);
+  }
+  else
+  {
+    uint32_t *dst = (uint32_t *)indexBuffer.sdb_Data;
+    for (uint32_t i = 0; i < indexCount; i++)
+    {
+      dst[i] = indices[i] + baseVertex;
+    }
+  }
+
+  batch.sdw_IndexEnd = indexBuffer.sdb_CurrentOffset + indicesSize;
+  batch.sdw_IndexCount += indexCount;
+
+  if (!gfx_vk_bBatchDraws)
+  {
+    FlushDrawBatch();
+  }
+}
+
+void SvkMain::FlushDrawBatch()
+{
+  SvkDrawBatch &batch = gl_VkDrawBatch;
+
+  if (batch.sdw_IndexCount == 0)
+  {
+    return;
+  }
+
+  // find pipeline here, as it can't be created while recording on other threads;
+  // previous one is most likely the same
+  if (gl_VkPreviousPipeline == nullptr || gl_VkPreviousPipeline->sps_Flags != batch.sdw_Flags)
+  {
+    gl_VkPreviousPipeline = &GetPipeline(batch.sdw_Flags);
+  }
 
-  // set mesh
-  vkCmdBindVertexBuffers(cmd, 0, 1, &vertexBuffer.sdb_Buffer, &vertexBuffer.sdb_CurrentOffset);
-  vkCmdBindIndexBuffer(cmd, indexBuffer.sdb_Buffer, indexBuffer.sdb_CurrentOffset, VK_INDEX_TYPE_UINT32);
+  SvkRenderCommand rc;
+  rc.src_Type = SRC_DRAW;
+  rc.src_Pipeline = gl_VkPreviousPipeline->sps_Pipeline;
+  rc.src_Draw = batch;
+  AddRenderCommand(rc);
 
-  // draw
-  vkCmdDrawIndexed(cmd, indexCount, 1, 0, 0, 0);
+  batch.sdw_IndexCount = 0;
 }
 #endif // SE1_VULKAN
\ No newline at end of file
@@ -23,10 +23,26 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <Engine/Graphics/Color.h>
 #include <Engine/Graphics/Texture.h>
 #include <Engine/Graphics/GfxProfile.h>
+#include <Engine/Graphics/TextureCompression.h>
 
 #include <Engine/Base/ListIterator.inl>
+#include <Engine/Templates/StaticStackArray.cpp>
 
 static CTexParams *_tpCurrent;
+// buffer for texture compressed on CPU
+static CStaticStackArray<UBYTE> _aubCompressed;
+
+// get block compression format that CPU encoder must produce for the given format
+static TexBlockFormat GetBlockFormat_Vulkan(VkFormat eFormat)
+{
+  switch (eFormat)
+  {
+  case VK_FORMAT_BC1_RGB_UNORM_BLOCK: return TBF_BC1;
+  case VK_FORMAT_BC3_UNORM_BLOCK:     return TBF_BC3;
+  case VK_FORMAT_BC7_UNORM_BLOCK:     return TBF_BC7;
+  default:                            return TBF_NONE;
+  }
+}
 extern INDEX GFX_iActiveTexUnit;
 
 static SvkSamplerFlags UnpackFilter_Vulkan(INDEX iFilter)
@@ -223,13 +239,25 @@ void UploadTexture_Vulkan(uint32_t *iTexture, ULONG *pulTexture, PIX pixSizeU, P
     }
   }*/
 
-  _pGfx->gl_SvkMain->InitTexture32Bit(*iTexture, eInternalFormat, pulTexture, mipmapSizes, mipmapCount, bUseSubImage == TRUE);
+  SLONG slUploadBytes = pixOffset * 4;
+  const TexBlockFormat tbf = GetBlockFormat_Vulkan(eInternalFormat);
+
+  if (tbf != TBF_NONE)
+  {
+    // compress all mipmaps on CPU and upload blocks instead of pixels
+    slUploadBytes = CompressMipmaps(tbf, pulTexture, mipmapSizes[0].width, mipmapSizes[0].height, mipmapCount, _aubCompressed);
+    _pGfx->gl_SvkMain->InitTexture(*iTexture, eInternalFormat, &_aubCompressed[0], mipmapSizes, mipmapCount, bUseSubImage == TRUE);
+  }
+  else
+  {
+    _pGfx->gl_SvkMain->InitTexture(*iTexture, eInternalFormat, pulTexture, mipmapSizes, mipmapCount, bUseSubImage == TRUE);
+  }
 
   // all done
   _pfGfxProfile.IncrementCounter(CGfxProfile::PCI_TEXTUREUPLOADS, 1);
-  _pfGfxProfile.IncrementCounter(CGfxProfile::PCI_TEXTUREUPLOADBYTES, pixOffset * 4);
+  _pfGfxProfile.IncrementCounter(CGfxProfile::PCI_TEXTUREUPLOADBYTES, slUploadBytes);
   _sfStats.IncrementCounter(CStatForm::SCI_TEXTUREUPLOADS, 1);
-  _sfStats.IncrementCounter(CStatForm::SCI_TEXTUREUPLOADBYTES, pixOffset * 4);
+  _sfStats.IncrementCounter(CStatForm::SCI_TEXTUREUPLOADBYTES, slUploadBytes);
   _pfGfxProfile.StopTimer(CGfxProfile::PTI_TEXTUREUPLOADING);
   _sfStats.StopTimer(CStatForm::STI_BINDTEXTURE);
 }
\ No newline at end of file
@@ -593,8 +593,7 @@ extern INDEX gfxGetTexturePixRatio( ULONG ulTextureObject)
 #ifdef SE1_VULKAN
   else if (eAPI == GAT_VK)
   {
-    // TODO (statistics): Vulkan bytes/pixels ratio for uploaded texture 
-    return 4;
+    return gfxGetFormatPixRatio(_pGfx->gl_SvkMain->GetTextureFormat(ulTextureObject));
   }
 #endif // SE1_VULKAN
   else return 0;
@@ -622,8 +621,17 @@ extern INDEX gfxGetFormatPixRatio( ULONG ulTextureFormat)
 #ifdef SE1_VULKAN
   else if (eAPI == GAT_VK)
   {
-    // TODO (statistics): Vulkan format size for statistics
-    return 4;
+    switch ((VkFormat)ulTextureFormat)
+    {
+    // compressed formats
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+      return 1;
+    // all the others are uploaded as 32-bit
+    default:
+      return 4;
+    }
   }
 #endif // SE1_VULKAN
   else return 0;
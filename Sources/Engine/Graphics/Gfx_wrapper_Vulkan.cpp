@@ -462,6 +462,7 @@ static void svk_SetVertexArray(GFXVertex4* pvtx, INDEX ctVtx)
   _sfStats.StartTimer(CStatForm::STI_GFXAPI);
 
   CStaticStackArray<SvkVertex> &verts = _pGfx->gl_SvkMain->gl_VkVerts;
+  _pGfx->gl_SvkMain->gl_VkVertsDirty = true;
 
   verts.PopAll();
   SvkVertex *pushed = verts.Push(ctVtx);
@@ -487,6 +488,7 @@ static void svk_SetNormalArray(GFXNormal* pnor)
   _sfStats.StartTimer(CStatForm::STI_GFXAPI);
 
   CStaticStackArray<SvkVertex> &verts = _pGfx->gl_SvkMain->gl_VkVerts;
+  _pGfx->gl_SvkMain->gl_VkVertsDirty = true;
   INDEX ctVtx = verts.Count();
   ASSERT(ctVtx > 0);
   ASSERT(ctVtx == GFX_ctVertices);
@@ -510,6 +512,7 @@ static void svk_SetColorArray(GFXColor* pcol)
   _sfStats.StartTimer(CStatForm::STI_GFXAPI);
 
   CStaticStackArray<SvkVertex> &verts = _pGfx->gl_SvkMain->gl_VkVerts;
+  _pGfx->gl_SvkMain->gl_VkVertsDirty = true;
   INDEX ctVtx = verts.Count();
   ASSERT(ctVtx > 0);
   ASSERT(ctVtx == GFX_ctVertices);
@@ -539,6 +542,7 @@ static void svk_SetTexCoordArray(GFXTexCoord* ptex, BOOL b4/*=FALSE*/)
   _sfStats.StartTimer(CStatForm::STI_GFXAPI);
 
   CStaticStackArray<SvkVertex> &verts = _pGfx->gl_SvkMain->gl_VkVerts;
+  _pGfx->gl_SvkMain->gl_VkVertsDirty = true;
   INDEX ctVtx = verts.Count();
   ASSERT(ctVtx > 0);
 
@@ -138,6 +138,16 @@ extern void UpdateTextureSettings(void)
 #ifdef SE1_D3D
   if( eAPI==GAT_D3D && bHasTC) iTCType = 5;
 #endif // SE1_D3D
+#ifdef SE1_VULKAN
+  // Vulkan (textures are block-compressed on CPU)
+  if( eAPI==GAT_VK && bHasTC) {
+    extern INDEX gfx_vk_iTextureCompression;  // 0=none, 1=BC1/BC3, 2=BC7
+    INDEX &iTC = gfx_vk_iTextureCompression;
+    iTC = Clamp( iTC, 0L, 2L);
+    if( iTC==1) iTCType = 6;
+    if( iTC==2) iTCType = 7;
+  }
+#endif // SE1_VULKAN
 
   // clamp and cache cvar
   extern INDEX tex_bCompressAlphaChannel; 
@@ -169,6 +179,16 @@ extern void UpdateTextureSettings(void)
     TS.ts_tfCRGB  = D3DFMT_DXT1;
     break;
 #endif // SE1_D3D
+#ifdef SE1_VULKAN
+  case 6:  // BC1/BC3
+    TS.ts_tfCRGBA = VK_FORMAT_BC3_UNORM_BLOCK;
+    TS.ts_tfCRGB  = VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+    break;
+  case 7:  // BC7
+    TS.ts_tfCRGBA = VK_FORMAT_BC7_UNORM_BLOCK;
+    TS.ts_tfCRGB  = VK_FORMAT_BC7_UNORM_BLOCK;
+    break;
+#endif // SE1_VULKAN
   default: // none
     TS.ts_tfCRGBA = NONE;
     TS.ts_tfCRGB  = NONE;
@@ -444,6 +464,51 @@ void CTextureData::CreateEffectTexture( PIX pixWidth, PIX pixHeight, MEX mexWidt
 }
 
 
+// determine mip level and size in which effect texture will be rendered and (re)allocate its frame
+BOOL CTextureData::PrepareEffectFrame( INDEX &iWantedMipLevel, PIX &pixWidth, PIX &pixHeight)
+{
+  ASSERT( td_ptegEffect!=NULL);
+  pixWidth  = GetPixWidth();
+  pixHeight = GetPixHeight();
+  // get max allowed effect texture dimension
+  PIX pixClampAreaSize = 1L<<16L;
+  tex_iEffectSize = Clamp( tex_iEffectSize, 4L, 8L);
+  if( !(td_ulFlags&TEX_CONSTANT)) pixClampAreaSize = 1L<<(tex_iEffectSize*2);
+  iWantedMipLevel = td_iFirstMipLevel
+                  + ClampTextureSize( pixClampAreaSize, _pGfx->gl_pixMaxTextureDimension, pixWidth, pixHeight);
+  // check whether wanted mip level is beyond last mip-level
+  iWantedMipLevel = ClampMipLevel( iWantedMipLevel);
+
+  // default adjustment for mapping
+  pixWidth  >>= iWantedMipLevel-td_iFirstMipLevel;
+  pixHeight >>= iWantedMipLevel-td_iFirstMipLevel;
+  ASSERT( pixWidth>0 && pixHeight>0);
+
+  // eventually adjust water effect texture size (if larger than base)
+  if( td_ptegEffect->IsWater()) {
+    INDEX iMipDiff = Min( FastLog2(td_ptdBaseTexture->GetPixWidth())  - FastLog2(pixWidth),
+                          FastLog2(td_ptdBaseTexture->GetPixHeight()) - FastLog2(pixHeight));
+    iWantedMipLevel = iMipDiff;
+    if( iMipDiff<0) {
+      pixWidth  >>= (-iMipDiff);
+      pixHeight >>= (-iMipDiff);
+      iWantedMipLevel = 0;
+      ASSERT( pixWidth>0 && pixHeight>0);
+    }
+  }
+  // if current frame size differs from the previous one
+  SLONG slFrameSize = GetMipmapOffset( 15, pixWidth, pixHeight) *BYTES_PER_TEXEL;
+  if( td_pulFrames==NULL || td_slFrameSize!=slFrameSize) {
+    // (re)allocate the frame buffer
+    if( td_pulFrames!=NULL) FreeMemory( td_pulFrames);
+    td_pulFrames = (ULONG*)AllocMemory( slFrameSize);
+    td_slFrameSize = slFrameSize;
+    return TRUE;
+  }
+  return FALSE;
+}
+
+
 // this promotes 16bit internal format to corresponding 32bit
 static ULONG PromoteTo32bitFormat( ULONG ulFormat)
 {
@@ -1231,55 +1296,25 @@ void CTextureData::SetAsCurrent( INDEX iFrameNo/*=0*/, BOOL bForceUpload/*=FALSE
   if( td_ptegEffect!=NULL)
   { 
     ASSERT( iFrameNo==0); // effect texture must have only one frame
-    // get max allowed effect texture dimension
-    PIX pixClampAreaSize = 1L<<16L;
-    tex_iEffectSize = Clamp( tex_iEffectSize, 4L, 8L);
-    if( !(td_ulFlags&TEX_CONSTANT)) pixClampAreaSize = 1L<<(tex_iEffectSize*2);
-    INDEX iWantedMipLevel = td_iFirstMipLevel
-                          + ClampTextureSize( pixClampAreaSize, _pGfx->gl_pixMaxTextureDimension, pixWidth, pixHeight);
-    // check whether wanted mip level is beyond last mip-level
-    iWantedMipLevel = ClampMipLevel( iWantedMipLevel);
-
-    // default adjustment for mapping
-    pixWidth  >>= iWantedMipLevel-td_iFirstMipLevel;
-    pixHeight >>= iWantedMipLevel-td_iFirstMipLevel;
-    ASSERT( pixWidth>0 && pixHeight>0);
-
-    // eventually adjust water effect texture size (if larger than base)
-    if( td_ptegEffect->IsWater()) {
-      INDEX iMipDiff = Min( FastLog2(td_ptdBaseTexture->GetPixWidth())  - FastLog2(pixWidth),
-                            FastLog2(td_ptdBaseTexture->GetPixHeight()) - FastLog2(pixHeight));
-      iWantedMipLevel = iMipDiff;
-      if( iMipDiff<0) {
-        pixWidth  >>= (-iMipDiff);
-        pixHeight >>= (-iMipDiff);
-        iWantedMipLevel = 0;
-        ASSERT( pixWidth>0 && pixHeight>0);
-      }
-    }
-    // if current frame size differs from the previous one
-    SLONG slFrameSize = GetMipmapOffset( 15, pixWidth, pixHeight) *BYTES_PER_TEXEL;
-    if( td_pulFrames==NULL || td_slFrameSize!=slFrameSize) {
-      // (re)allocate the frame buffer
-      if( td_pulFrames!=NULL) FreeMemory( td_pulFrames);
-      td_pulFrames = (ULONG*)AllocMemory( slFrameSize);
-      td_slFrameSize = slFrameSize;
-      bNoDiscard = FALSE;
-    }
+    INDEX iWantedMipLevel;
+    if( PrepareEffectFrame( iWantedMipLevel, pixWidth, pixHeight)) bNoDiscard = FALSE;
 
     // if not calculated for this tick (must be != to test for time rewinding)
     if( td_ptegEffect->teg_updTexture.LastUpdateTime() != _pTimer->CurrentTick()) {
       // discard eventual cached frame and calculate new frame
       MarkChanged();
-      td_ptegEffect->Animate();
       bNeedUpload = TRUE;
       // make sure that effect and base textures are static
       Force(TEX_STATIC);
       td_ptdBaseTexture->Force(TEX_STATIC);
       // copy some flags from base texture to effect texture
       td_ulFlags |= td_ptdBaseTexture->td_ulFlags & (TEX_ALPHACHANNEL|TEX_TRANSPARENT|TEX_GRAY);
-      // render effect texture
-      td_ptegEffect->Render( iWantedMipLevel, pixWidth, pixHeight);
+      // animate and render effect texture (unless already done in advance for this tick)
+      if( !td_ptegEffect->IsPrerendered( iWantedMipLevel, pixWidth, pixHeight)) {
+        td_ptegEffect->Animate();
+        td_ptegEffect->Render( iWantedMipLevel, pixWidth, pixHeight);
+      }
+      td_ptegEffect->teg_updTexture.MarkUpdated();
       // determine internal format
       ULONG ulNewFormat;
       if( td_ulFlags&TEX_GRAY) {
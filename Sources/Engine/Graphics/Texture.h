@@ -122,6 +122,9 @@ public:
   // creates new effect texture with one frame
   void CreateEffectTexture( PIX pixWidth, PIX pixHeight, MEX mexWidth,
                             CTextureData *ptdBaseTexture, ULONG ulGlobalEffect);
+  // determine mip level and size in which effect texture will be rendered and (re)allocate its frame
+  // (returns TRUE if frame had to be reallocated)
+  BOOL PrepareEffectFrame( INDEX &iWantedMipLevel, PIX &pixWidth, PIX &pixHeight);
   // creates new texture with one frame
   void Create_t( const CImageInfo *pII, MEX mexWanted, INDEX ctFineMips, BOOL bForce32bit);
   // adds one frame to created texture
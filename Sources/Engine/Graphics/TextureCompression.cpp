@@ -0,0 +1,525 @@
+/* Copyright (c) 2020 Sultim Tsyrendashiev
+This program is free software; you can redistribute it and/or modify
+it under the terms of version 2 of the GNU General Public License as published by
+the Free Software Foundation
+
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA. */
+
+#include "stdh.h"
+
+#include <Engine/Graphics/TextureCompression.h>
+
+#include <Engine/Base/CRC.h>
+#include <Engine/Base/Stream.h>
+#include <Engine/Base/Console.h>
+#include <Engine/Math/Functions.h>
+#include <Engine/Graphics/Texture.h>
+#include <Engine/Graphics/GfxProfile.h>
+
+#include <Engine/Templates/StaticStackArray.cpp>
+
+extern INDEX tex_bCompressionCache;
+
+// version of derived cache files (increase when encoder output changes!)
+#define TEXCACHE_VERSION 1
+
+// BC7 mode 6 interpolation weights
+static const INDEX _aiBC7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+
+// fetch 4x4 block of pixels (border pixels are replicated for sizes that aren't multiple of 4)
+static void FetchBlock( const ULONG *pulSrc, PIX pixWidth, PIX pixHeight, PIX pixX, PIX pixY, UBYTE aubBlock[16][4])
+{
+  for( INDEX iRow=0; iRow<4; iRow++) {
+    const PIX pixRow = Min( pixY+iRow, pixHeight-1);
+    for( INDEX iCol=0; iCol<4; iCol++) {
+      const PIX pixCol = Min( pixX+iCol, pixWidth-1);
+      const UBYTE *pub = (const UBYTE*)(pulSrc + pixRow*pixWidth + pixCol);
+      UBYTE *pubDst = aubBlock[iRow*4+iCol];
+      pubDst[0] = pub[0];  pubDst[1] = pub[1];  pubDst[2] = pub[2];  pubDst[3] = pub[3];
+    }
+  }
+}
+
+
+// store decoded 4x4 block of pixels (pixels outside of bitmap are skipped)
+static void StoreBlock( ULONG *pulDst, PIX pixWidth, PIX pixHeight, PIX pixX, PIX pixY, const UBYTE aubBlock[16][4])
+{
+  for( INDEX iRow=0; iRow<4 && pixY+iRow<pixHeight; iRow++) {
+    for( INDEX iCol=0; iCol<4 && pixX+iCol<pixWidth; iCol++) {
+      UBYTE *pub = (UBYTE*)(pulDst + (pixY+iRow)*pixWidth + pixX+iCol);
+      const UBYTE *pubSrc = aubBlock[iRow*4+iCol];
+      pub[0] = pubSrc[0];  pub[1] = pubSrc[1];  pub[2] = pubSrc[2];  pub[3] = pubSrc[3];
+    }
+  }
+}
+
+
+static inline UWORD PackRGB565( INDEX iR, INDEX iG, INDEX iB)
+{
+  return (UWORD)( ((iR*31+127)/255)<<11 | ((iG*63+127)/255)<<5 | ((iB*31+127)/255));
+}
+
+
+static inline void UnpackRGB565( UWORD uw, INDEX aiRGB[3])
+{
+  const INDEX iR = (uw>>11)&31;
+  const INDEX iG = (uw>> 5)&63;
+  const INDEX iB = (uw    )&31;
+  aiRGB[0] = (iR<<3) | (iR>>2);
+  aiRGB[1] = (iG<<2) | (iG>>4);
+  aiRGB[2] = (iB<<3) | (iB>>2);
+}
+
+
+// encode color part of BC1/BC3 block (always in 4-color mode)
+static void EncodeColorBlock( const UBYTE aubBlock[16][4], UBYTE *pubDst)
+{
+  // find bounding box of colors
+  INDEX aiMin[3] = { 255, 255, 255 };
+  INDEX aiMax[3] = {   0,   0,   0 };
+  for( INDEX iPix=0; iPix<16; iPix++) {
+    for( INDEX iCh=0; iCh<3; iCh++) {
+      aiMin[iCh] = Min( aiMin[iCh], (INDEX)aubBlock[iPix][iCh]);
+      aiMax[iCh] = Max( aiMax[iCh], (INDEX)aubBlock[iPix][iCh]);
+    }
+  }
+  // inset bounding box a bit to lower the mean error
+  for( INDEX iCh=0; iCh<3; iCh++) {
+    const INDEX iInset = (aiMax[iCh]-aiMin[iCh]) >> 4;
+    aiMin[iCh] += iInset;
+    aiMax[iCh] -= iInset;
+  }
+
+  UWORD uwC0 = PackRGB565( aiMax[0], aiMax[1], aiMax[2]);
+  UWORD uwC1 = PackRGB565( aiMin[0], aiMin[1], aiMin[2]);
+  // 4-color mode requires first endpoint to be larger
+  if( uwC0<uwC1) Swap( uwC0, uwC1);
+
+  ULONG ulIndices = 0;
+  if( uwC0!=uwC1)
+  { // build palette
+    INDEX aaiPalette[4][3];
+    UnpackRGB565( uwC0, aaiPalette[0]);
+    UnpackRGB565( uwC1, aaiPalette[1]);
+    for( INDEX iCh=0; iCh<3; iCh++) {
+      aaiPalette[2][iCh] = (2*aaiPalette[0][iCh] +   aaiPalette[1][iCh] +1) /3;
+      aaiPalette[3][iCh] = (  aaiPalette[0][iCh] + 2*aaiPalette[1][iCh] +1) /3;
+    }
+    // pick closest palette entry for each pixel
+    for( INDEX iPix=0; iPix<16; iPix++) {
+      INDEX iBest = 0;
+      SLONG slBestDist = MAX_SLONG;
+      for( INDEX iPal=0; iPal<4; iPal++) {
+        const SLONG slDR = aubBlock[iPix][0] - aaiPalette[iPal][0];
+        const SLONG slDG = aubBlock[iPix][1] - aaiPalette[iPal][1];
+        const SLONG slDB = aubBlock[iPix][2] - aaiPalette[iPal][2];
+        const SLONG slDist = slDR*slDR + slDG*slDG + slDB*slDB;
+        if( slDist<slBestDist) { slBestDist = slDist;  iBest = iPal; }
+      }
+      ulIndices |= ((ULONG)iBest) << (iPix*2);
+    }
+  }
+
+  pubDst[0] = (UBYTE)(uwC0);  pubDst[1] = (UBYTE)(uwC0>>8);
+  pubDst[2] = (UBYTE)(uwC1);  pubDst[3] = (UBYTE)(uwC1>>8);
+  pubDst[4] = (UBYTE)(ulIndices);      pubDst[5] = (UBYTE)(ulIndices>>8);
+  pubDst[6] = (UBYTE)(ulIndices>>16);  pubDst[7] = (UBYTE)(ulIndices>>24);
+}
+
+
+static void DecodeColorBlock( const UBYTE *pubSrc, UBYTE aubBlock[16][4], BOOL bAllow3Color)
+{
+  const UWORD uwC0 = pubSrc[0] | (pubSrc[1]<<8);
+  const UWORD uwC1 = pubSrc[2] | (pubSrc[3]<<8);
+  const ULONG ulIndices = pubSrc[4] | (pubSrc[5]<<8) | (pubSrc[6]<<16) | (pubSrc[7]<<24);
+
+  INDEX aaiPalette[4][4];
+  UnpackRGB565( uwC0, aaiPalette[0]);
+  UnpackRGB565( uwC1, aaiPalette[1]);
+  aaiPalette[0][3] = aaiPalette[1][3] = aaiPalette[2][3] = aaiPalette[3][3] = 255;
+  for( INDEX iCh=0; iCh<3; iCh++) {
+    if( uwC0>uwC1 || !bAllow3Color) {
+      aaiPalette[2][iCh] = (2*aaiPalette[0][iCh] +   aaiPalette[1][iCh] +1) /3;
+      aaiPalette[3][iCh] = (  aaiPalette[0][iCh] + 2*aaiPalette[1][iCh] +1) /3;
+    } else {
+      aaiPalette[2][iCh] = (aaiPalette[0][iCh] + aaiPalette[1][iCh]) /2;
+      aaiPalette[3][iCh] = 0;
+    }
+  }
+  if( uwC0<=uwC1 && bAllow3Color) aaiPalette[3][3] = 0;
+
+  for( INDEX iPix=0; iPix<16; iPix++) {
+    const INDEX iPal = (ulIndices >> (iPix*2)) & 3;
+    for( INDEX iCh=0; iCh<4; iCh++) aubBlock[iPix][iCh] = (UBYTE)aaiPalette[iPal][iCh];
+  }
+}
+
+
+// encode alpha part of BC3 block (always in 8-value mode)
+static void EncodeAlphaBlock( const UBYTE aubBlock[16][4], UBYTE *pubDst)
+{
+  INDEX iMin = 255, iMax = 0;
+  for( INDEX iPix=0; iPix<16; iPix++) {
+    iMin = Min( iMin, (INDEX)aubBlock[iPix][3]);
+    iMax = Max( iMax, (INDEX)aubBlock[iPix][3]);
+  }
+
+  pubDst[0] = (UBYTE)iMax;
+  pubDst[1] = (UBYTE)iMin;
+  __int64 llIndices = 0;
+  if( iMax!=iMin)
+  { // build palette (indices 0 and 1 are endpoints, the rest are interpolated)
+    INDEX aiPalette[8];
+    aiPalette[0] = iMax;
+    aiPalette[1] = iMin;
+    for( INDEX i=1; i<7; i++) aiPalette[i+1] = ((7-i)*iMax + i*iMin +3) /7;
+    for( INDEX iPix=0; iPix<16; iPix++) {
+      INDEX iBest = 0;
+      INDEX iBestDist = 256;
+      for( INDEX iPal=0; iPal<8; iPal++) {
+        const INDEX iDist = Abs( (INDEX)aubBlock[iPix][3] - aiPalette[iPal]);
+        if( iDist<iBestDist) { iBestDist = iDist;  iBest = iPal; }
+      }
+      llIndices |= ((__int64)iBest) << (iPix*3);
+    }
+  }
+  for( INDEX i=0; i<6; i++) pubDst[2+i] = (UBYTE)(llIndices >> (i*8));
+}
+
+
+static void DecodeAlphaBlock( const UBYTE *pubSrc, UBYTE aubBlock[16][4])
+{
+  const INDEX iA0 = pubSrc[0];
+  const INDEX iA1 = pubSrc[1];
+  __int64 llIndices = 0;
+  for( INDEX i=0; i<6; i++) llIndices |= ((__int64)pubSrc[2+i]) << (i*8);
+
+  INDEX aiPalette[8];
+  aiPalette[0] = iA0;
+  aiPalette[1] = iA1;
+  if( iA0>iA1) {
+    for( INDEX i=1; i<7; i++) aiPalette[i+1] = ((7-i)*iA0 + i*iA1 +3) /7;
+  } else {
+    for( INDEX i=1; i<5; i++) aiPalette[i+1] = ((5-i)*iA0 + i*iA1 +2) /5;
+    aiPalette[6] = 0;
+    aiPalette[7] = 255;
+  }
+  for( INDEX iPix=0; iPix<16; iPix++) {
+    aubBlock[iPix][3] = (UBYTE)aiPalette[(llIndices >> (iPix*3)) & 7];
+  }
+}
+
+
+// BC7 block is a little-endian bit stream
+static void PutBits( UBYTE *pubBlock, INDEX &iBit, ULONG ulValue, INDEX ctBits)
+{
+  for( INDEX i=0; i<ctBits; i++, iBit++) {
+    if( ulValue & (1UL<<i)) pubBlock[iBit>>3] |= (UBYTE)(1 << (iBit&7));
+  }
+}
+
+
+static ULONG GetBits( const UBYTE *pubBlock, INDEX &iBit, INDEX ctBits)
+{
+  ULONG ulValue = 0;
+  for( INDEX i=0; i<ctBits; i++, iBit++) {
+    if( pubBlock[iBit>>3] & (1 << (iBit&7))) ulValue |= 1UL<<i;
+  }
+  return ulValue;
+}
+
+
+// quantize 8-bit RGBA endpoint to 7 bits + shared p-bit, choosing p-bit with lower error
+static void QuantizeBC7Endpoint( const INDEX aiColor[4], INDEX aiQuant[4], INDEX &iPBit)
+{
+  SLONG aslError[2] = { 0, 0 };
+  INDEX aaiQuant[2][4];
+  for( INDEX iP=0; iP<2; iP++) {
+    for( INDEX iCh=0; iCh<4; iCh++) {
+      // closest 7-bit value with this p-bit appended
+      INDEX iQ = Clamp( (aiColor[iCh]-iP+1) >> 1, 0L, 127L);
+      const INDEX iRec = (iQ<<1) | iP;
+      aaiQuant[iP][iCh] = iQ;
+      aslError[iP] += (aiColor[iCh]-iRec) * (aiColor[iCh]-iRec);
+    }
+  }
+  iPBit = aslError[1]<aslError[0] ? 1 : 0;
+  for( INDEX iCh=0; iCh<4; iCh++) aiQuant[iCh] = aaiQuant[iPBit][iCh];
+}
+
+
+// encode BC7 block using mode 6 (single subset, RGBA 7.7.7.7 + p-bit endpoints, 4-bit indices)
+static void EncodeBC7Block( const UBYTE aubBlock[16][4], UBYTE *pubDst)
+{
+  INDEX aiMin[4] = { 255, 255, 255, 255 };
+  INDEX aiMax[4] = {   0,   0,   0,   0 };
+  for( INDEX iPix=0; iPix<16; iPix++) {
+    for( INDEX iCh=0; iCh<4; iCh++) {
+      aiMin[iCh] = Min( aiMin[iCh], (INDEX)aubBlock[iPix][iCh]);
+      aiMax[iCh] = Max( aiMax[iCh], (INDEX)aubBlock[iPix][iCh]);
+    }
+  }
+  // inset by half of the quantization step of 4-bit indices
+  for( INDEX iCh=0; iCh<4; iCh++) {
+    const INDEX iInset = (aiMax[iCh]-aiMin[iCh]) >> 5;
+    aiMin[iCh] += iInset;
+    aiMax[iCh] -= iInset;
+  }
+
+  // quantize endpoints and build palette from actually encoded values
+  INDEX aaiQuant[2][4], aiPBit[2];
+  QuantizeBC7Endpoint( aiMin, aaiQuant[0], aiPBit[0]);
+  QuantizeBC7Endpoint( aiMax, aaiQuant[1], aiPBit[1]);
+  INDEX aaiEnd[2][4];
+  for( INDEX iEnd=0; iEnd<2; iEnd++) {
+    for( INDEX iCh=0; iCh<4; iCh++) aaiEnd[iEnd][iCh] = (aaiQuant[iEnd][iCh]<<1) | aiPBit[iEnd];
+  }
+  INDEX aaiPalette[16][4];
+  for( INDEX iPal=0; iPal<16; iPal++) {
+    const INDEX iW = _aiBC7Weights4[iPal];
+    for( INDEX iCh=0; iCh<4; iCh++) aaiPalette[iPal][iCh] = ((64-iW)*aaiEnd[0][iCh] + iW*aaiEnd[1][iCh] + 32) >> 6;
+  }
+
+  // pick closest palette entry for each pixel
+  INDEX aiIndices[16];
+  for( INDEX iPix=0; iPix<16; iPix++) {
+    INDEX iBest = 0;
+    SLONG slBestDist = MAX_SLONG;
+    for( INDEX iPal=0; iPal<16; iPal++) {
+      SLONG slDist = 0;
+      for( INDEX iCh=0; iCh<4; iCh++) {
+        const SLONG slD = aubBlock[iPix][iCh] - aaiPalette[iPal][iCh];
+        slDist += slD*slD;
+      }
+      if( slDist<slBestDist) { slBestDist = slDist;  iBest = iPal; }
+    }
+    aiIndices[iPix] = iBest;
+  }
+
+  // anchor index must have its highest bit cleared - swap endpoints if it hasn't
+  INDEX iLo = 0, iHi = 1;
+  if( aiIndices[0] & 8) {
+    iLo = 1;  iHi = 0;
+    for( INDEX iPix=0; iPix<16; iPix++) aiIndices[iPix] = 15-aiIndices[iPix];
+  }
+
+  memset( pubDst, 0, 16);
+  INDEX iBit = 0;
+  PutBits( pubDst, iBit, 1UL<<6, 7); // mode 6
+  for( INDEX iCh=0; iCh<4; iCh++) {
+    PutBits( pubDst, iBit, aaiQuant[iLo][iCh], 7);
+    PutBits( pubDst, iBit, aaiQuant[iHi][iCh], 7);
+  }
+  PutBits( pubDst, iBit, aiPBit[iLo], 1);
+  PutBits( pubDst, iBit, aiPBit[iHi], 1);
+  PutBits( pubDst, iBit, aiIndices[0], 3);
+  for( INDEX iPix=1; iPix<16; iPix++) PutBits( pubDst, iBit, aiIndices[iPix], 4);
+  ASSERT( iBit==128);
+}
+
+
+// decode BC7 block (only mode 6 is supported, as that's the only one encoder produces)
+static void DecodeBC7Block( const UBYTE *pubSrc, UBYTE aubBlock[16][4])
+{
+  INDEX iBit = 0;
+  if( GetBits( pubSrc, iBit, 7) != (1UL<<6)) {
+    // unsupported mode - decode as opaque black
+    memset( aubBlock, 0, 16*4);
+    for( INDEX iPix=0; iPix<16; iPix++) aubBlock[iPix][3] = 255;
+    return;
+  }
+  INDEX aaiEnd[2][4];
+  for( INDEX iCh=0; iCh<4; iCh++) {
+    aaiEnd[0][iCh] = GetBits( pubSrc, iBit, 7) << 1;
+    aaiEnd[1][iCh] = GetBits( pubSrc, iBit, 7) << 1;
+  }
+  const INDEX iP0 = GetBits( pubSrc, iBit, 1);
+  const INDEX iP1 = GetBits( pubSrc, iBit, 1);
+  for( INDEX iCh=0; iCh<4; iCh++) { aaiEnd[0][iCh] |= iP0;  aaiEnd[1][iCh] |= iP1; }
+
+  for( INDEX iPix=0; iPix<16; iPix++) {
+    const INDEX iW = _aiBC7Weights4[GetBits( pubSrc, iBit, iPix==0 ? 3 : 4)];
+    for( INDEX iCh=0; iCh<4; iCh++) {
+      aubBlock[iPix][iCh] = (UBYTE)(((64-iW)*aaiEnd[0][iCh] + iW*aaiEnd[1][iCh] + 32) >> 6);
+    }
+  }
+}
+
+
+
+INDEX GetBlockBytes( TexBlockFormat tbf)
+{
+  switch( tbf) {
+  case TBF_BC1:  return 8;
+  case TBF_BC3:  return 16;
+  case TBF_BC7:  return 16;
+  default: ASSERTALWAYS( "Unknown block compression format.");  return 0;
+  }
+}
+
+
+SLONG GetCompressedMipSize( TexBlockFormat tbf, PIX pixWidth, PIX pixHeight)
+{
+  return ((pixWidth+3)/4) * ((pixHeight+3)/4) * GetBlockBytes(tbf);
+}
+
+
+void CompressBitmap( TexBlockFormat tbf, const ULONG *pulSrc, UBYTE *pubDst, PIX pixWidth, PIX pixHeight)
+{
+  ASSERT( pixWidth>0 && pixHeight>0);
+  const INDEX ctBlockBytes = GetBlockBytes(tbf);
+  UBYTE aubBlock[16][4];
+
+  for( PIX pixY=0; pixY<pixHeight; pixY+=4) {
+    for( PIX pixX=0; pixX<pixWidth; pixX+=4) {
+      FetchBlock( pulSrc, pixWidth, pixHeight, pixX, pixY, aubBlock);
+      switch( tbf) {
+      case TBF_BC1:  EncodeColorBlock( aubBlock, pubDst);  break;
+      case TBF_BC3:  EncodeAlphaBlock( aubBlock, pubDst);  EncodeColorBlock( aubBlock, pubDst+8);  break;
+      case TBF_BC7:  EncodeBC7Block( aubBlock, pubDst);    break;
+      default: ASSERTALWAYS( "Unknown block compression format.");  break;
+      }
+      pubDst += ctBlockBytes;
+    }
+  }
+}
+
+
+void DecompressBitmap( TexBlockFormat tbf, const UBYTE *pubSrc, ULONG *pulDst, PIX pixWidth, PIX pixHeight)
+{
+  ASSERT( pixWidth>0 && pixHeight>0);
+  const INDEX ctBlockBytes = GetBlockBytes(tbf);
+  UBYTE aubBlock[16][4];
+
+  for( PIX pixY=0; pixY<pixHeight; pixY+=4) {
+    for( PIX pixX=0; pixX<pixWidth; pixX+=4) {
+      switch( tbf) {
+      case TBF_BC1:  DecodeColorBlock( pubSrc, aubBlock, TRUE);  break;
+      case TBF_BC3:  DecodeColorBlock( pubSrc+8, aubBlock, FALSE);  DecodeAlphaBlock( pubSrc, aubBlock);  break;
+      case TBF_BC7:  DecodeBC7Block( pubSrc, aubBlock);  break;
+      default: ASSERTALWAYS( "Unknown block compression format.");  break;
+      }
+      StoreBlock( pulDst, pixWidth, pixHeight, pixX, pixY, aubBlock);
+      pubSrc += ctBlockBytes;
+    }
+  }
+}
+
+
+DOUBLE GetBitmapPSNR( const ULONG *pulA, const ULONG *pulB, PIX pixSize, BOOL bAlpha)
+{
+  const INDEX ctChannels = bAlpha ? 4 : 3;
+  const UBYTE *pubA = (const UBYTE*)pulA;
+  const UBYTE *pubB = (const UBYTE*)pulB;
+  DOUBLE dSum = 0;
+  for( PIX pix=0; pix<pixSize; pix++) {
+    for( INDEX iCh=0; iCh<ctChannels; iCh++) {
+      const DOUBLE dDiff = (DOUBLE)pubA[pix*4+iCh] - (DOUBLE)pubB[pix*4+iCh];
+      dSum += dDiff*dDiff;
+    }
+  }
+  // identical bitmaps
+  if( dSum==0) return 99.0;
+  const DOUBLE dMSE = dSum / (pixSize*ctChannels);
+  return 10.0 * log10( 255.0*255.0 / dMSE);
+}
+
+
+
+// derived cache file for given source data
+static CTFileName GetCacheFileName( ULONG ulCRC, TexBlockFormat tbf, PIX pixWidth, PIX pixHeight)
+{
+  CTString strName;
+  strName.PrintF( "Temp\\TextureCache\\%08X_%dx%d_%d.btc", ulCRC, pixWidth, pixHeight, (INDEX)tbf);
+  return CTFileName(strName);
+}
+
+
+static BOOL LoadFromCache( const CTFileName &fnm, ULONG ulCRC, SLONG slSize, UBYTE *pubDst)
+{
+  if( !FileExists(fnm)) return FALSE;
+  try {
+    CTFileStream strm;
+    strm.Open_t( fnm);
+    strm.ExpectID_t( "BTCD");
+    ULONG ulVersion, ulFileCRC;
+    SLONG slFileSize;
+    strm >> ulVersion >> ulFileCRC >> slFileSize;
+    if( ulVersion!=TEXCACHE_VERSION || ulFileCRC!=ulCRC || slFileSize!=slSize) return FALSE;
+    strm.Read_t( pubDst, slSize);
+  } catch( char *strError) {
+    (void)strError;
+    return FALSE;
+  }
+  return TRUE;
+}
+
+
+static void SaveToCache( const CTFileName &fnm, ULONG ulCRC, SLONG slSize, const UBYTE *pubSrc)
+{
+  // make sure that cache directory exists
+  CreateDirectoryA( _fnmApplicationPath + "Temp\\TextureCache\\", NULL);
+  try {
+    CTFileStream strm;
+    strm.Create_t( fnm);
+    strm.WriteID_t( "BTCD");
+    strm << (ULONG)TEXCACHE_VERSION << ulCRC << slSize;
+    strm.Write_t( pubSrc, slSize);
+  } catch( char *strError) {
+    // cache is just an optimization
+    CPrintF( TRANS("Cannot write compressed texture cache: %s\n"), strError);
+  }
+}
+
+
+SLONG CompressMipmaps( TexBlockFormat tbf, const ULONG *pulMipmaps, PIX pixWidth, PIX pixHeight,
+                       INDEX ctMipmaps, CStaticStackArray<UBYTE> &aubDst)
+{
+  // determine size of source and compressed data
+  PIX pixSrcSize = 0;
+  SLONG slDstSize = 0;
+  {for( INDEX iMip=0; iMip<ctMipmaps; iMip++) {
+    const PIX pixMipWidth  = Max( pixWidth >>iMip, 1L);
+    const PIX pixMipHeight = Max( pixHeight>>iMip, 1L);
+    pixSrcSize += pixMipWidth*pixMipHeight;
+    slDstSize  += GetCompressedMipSize( tbf, pixMipWidth, pixMipHeight);
+  }}
+  aubDst.PopAll();
+  UBYTE *pubDst = aubDst.Push(slDstSize);
+
+  // try derived cache first
+  ULONG ulCRC = 0;
+  CTFileName fnmCache;
+  if( tex_bCompressionCache) {
+    CRC_Start(ulCRC);
+    CRC_AddBlock( ulCRC, (UBYTE*)pulMipmaps, pixSrcSize*BYTES_PER_TEXEL);
+    CRC_Finish(ulCRC);
+    fnmCache = GetCacheFileName( ulCRC, tbf, pixWidth, pixHeight);
+    if( LoadFromCache( fnmCache, ulCRC, slDstSize, pubDst)) {
+      _pfGfxProfile.IncrementCounter(CGfxProfile::PCI_COMPRESSIONCACHEHITS, 1);
+      return slDstSize;
+    }
+  }
+
+  _pfGfxProfile.StartTimer(CGfxProfile::PTI_COMPRESSBITMAP);
+  {for( INDEX iMip=0; iMip<ctMipmaps; iMip++) {
+    const PIX pixMipWidth  = Max( pixWidth >>iMip, 1L);
+    const PIX pixMipHeight = Max( pixHeight>>iMip, 1L);
+    CompressBitmap( tbf, pulMipmaps, pubDst, pixMipWidth, pixMipHeight);
+    pulMipmaps += pixMipWidth*pixMipHeight;
+    pubDst     += GetCompressedMipSize( tbf, pixMipWidth, pixMipHeight);
+  }}
+  _pfGfxProfile.StopTimer(CGfxProfile::PTI_COMPRESSBITMAP);
+
+  if( tex_bCompressionCache) SaveToCache( fnmCache, ulCRC, slDstSize, &aubDst[0]);
+  return slDstSize;
+}
@@ -0,0 +1,52 @@
+/* Copyright (c) 2020 Sultim Tsyrendashiev
+This program is free software; you can redistribute it and/or modify
+it under the terms of version 2 of the GNU General Public License as published by
+the Free Software Foundation
+
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA. */
+
+#ifndef SE_INCL_TEXTURECOMPRESSION_H
+#define SE_INCL_TEXTURECOMPRESSION_H
+#ifdef PRAGMA_ONCE
+  #pragma once
+#endif
+
+#include <Engine/Templates/StaticStackArray.h>
+
+// CPU block compression of 32-bit RGBA bitmaps (byte order R,G,B,A, as uploaded to APIs);
+// it doesn't depend on any graphics API, so it can be used without a device
+enum TexBlockFormat
+{
+  TBF_NONE = 0,
+  TBF_BC1  = 1,   // opaque RGB, 8 bytes per 4x4 block
+  TBF_BC3  = 2,   // RGB + interpolated alpha, 16 bytes per 4x4 block
+  TBF_BC7  = 3,   // RGBA (mode 6 only), 16 bytes per 4x4 block
+};
+
+// bytes per one 4x4 block
+extern INDEX GetBlockBytes( TexBlockFormat tbf);
+// size of one compressed mip-map in bytes (sizes that aren't multiple of 4 are padded to whole blocks)
+extern SLONG GetCompressedMipSize( TexBlockFormat tbf, PIX pixWidth, PIX pixHeight);
+
+// compress one mip-map
+extern void CompressBitmap( TexBlockFormat tbf, const ULONG *pulSrc, UBYTE *pubDst, PIX pixWidth, PIX pixHeight);
+// decompress one mip-map (for verification and statistics)
+extern void DecompressBitmap( TexBlockFormat tbf, const UBYTE *pubSrc, ULONG *pulDst, PIX pixWidth, PIX pixHeight);
+// peak signal-to-noise ratio between two 32-bit bitmaps in dB (alpha is counted in only if requested)
+extern DOUBLE GetBitmapPSNR( const ULONG *pulA, const ULONG *pulB, PIX pixSize, BOOL bAlpha);
+
+// compress all mip-maps of a texture (as laid out in memory by MakeMipmaps()) and return compressed size;
+// when allowed, compressed data is taken from (or stored to) derived cache in "Temp\TextureCache\"
+extern SLONG CompressMipmaps( TexBlockFormat tbf, const ULONG *pulMipmaps, PIX pixWidth, PIX pixHeight,
+                              INDEX ctMipmaps, CStaticStackArray<UBYTE> &aubDst);
+
+
+#endif  /* include-once check. */
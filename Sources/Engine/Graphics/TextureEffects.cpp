@@ -20,45 +20,36 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include <Engine/Math/Functions.h>
 #include <Engine/Base/Timer.h>
+#include <Engine/Base/CRC.h>
+#include <Engine/Base/Shell.h>
+#include <Engine/Base/Console.h>
+#include <Engine/Base/JobPool.h>
 #include <Engine/Base/Statistics_internal.h>
 #include <Engine/Templates/DynamicArray.cpp>
+#include <Engine/Templates/DynamicContainer.cpp>
 #include <Engine/Templates/Stock_CtextureData.h>
 #include <Engine/Templates/StaticArray.cpp>
+#include <Engine/Templates/StaticStackArray.cpp>
 
-// asm shortcuts
-#define O offset
-#define Q qword ptr
-#define D dword ptr
-#define W  word ptr
-#define B  byte ptr
-
-#define ASMOPT 1
-
-
-static const __int64 mm1LO   = 0x0000000000000001;
-static const __int64 mm1HI   = 0x0000000100000000;
-static const __int64 mm1HILO = 0x0000000100000001;
-static const __int64 mm0001  = 0x0000000000000001;
-static const __int64 mm0010  = 0x0000000000010000;
-static const __int64 mm00M0  = 0x00000000FFFF0000;
-static __int64 mmBaseWidthShift=0, mmBaseWidth=0, mmBaseWidthMask=0, mmBaseHeightMask=0, mmBaseMasks=0, mmShift=0;
-
+extern INDEX tex_iEffectSize;
 
 // speed table
 static SBYTE asbMod3Sub1Table[256];
 static BOOL  bTableSet = FALSE;
 
-static CTextureData *_ptdEffect, *_ptdBase;
-static PIX _pixTexWidth,    _pixTexHeight;
-static PIX _pixBufferWidth, _pixBufferHeight;
-static ULONG _ulBufferMask;
-static INDEX _iWantedMipLevel;
-static UBYTE *_pubDrawBuffer;
-static SWORD *_pswDrawBuffer;
+// state of effect that is currently being animated or rendered
+// (kept per thread, so that different effect textures can be processed in parallel)
+static _declspec(thread) CTextureData *_ptdEffect, *_ptdBase;
+static _declspec(thread) PIX _pixTexWidth,    _pixTexHeight;
+static _declspec(thread) PIX _pixBufferWidth, _pixBufferHeight;
+static _declspec(thread) ULONG _ulBufferMask;
+static _declspec(thread) INDEX _iWantedMipLevel;
+static _declspec(thread) UBYTE *_pubDrawBuffer;
+static _declspec(thread) SWORD *_pswDrawBuffer;
 
 
-// randomizer
-static ULONG ulRNDSeed;
+// randomizer (each effect keeps its own seed in teg_ulRandomSeed, so results don't depend on order of processing)
+static _declspec(thread) ULONG ulRNDSeed;
 
 inline void Randomize( ULONG ulSeed)
 {
@@ -1096,29 +1087,31 @@ void InitializeWater(void)
 ********************************/
 static void AnimateWater( SLONG slDensity)
 {
-  _sfStats.StartTimer(CStatForm::STI_EFFECTRENDER);
-
 /////////////////////////////////// move water
 
   SWORD *pNew = (SWORD*)_ptdEffect->td_pubBuffer1;
   SWORD *pOld = (SWORD*)_ptdEffect->td_pubBuffer2;
 
-  PIX pixV, pixU;
+  PIX pixU;
   PIX pixOffset, iNew;
   SLONG slLineAbove, slLineBelow, slLineLeft, slLineRight;
 
-  // inner rectangle (without 1 pixel top and bottom line)
-  pixOffset = _pixBufferWidth + 1;
-  for( pixV=_pixBufferHeight-2; pixV>0; pixV--) {
-    for( pixU=_pixBufferWidth; pixU>0; pixU--) {
-      iNew = (( (SLONG)pOld[pixOffset - _pixBufferWidth]
-              + (SLONG)pOld[pixOffset + _pixBufferWidth]
-              + (SLONG)pOld[pixOffset - 1]
-              + (SLONG)pOld[pixOffset + 1]
-             ) >> 1)
-              - (SLONG)pNew[pixOffset];
-      pNew[pixOffset] =  iNew - (iNew >> slDensity);
-      pixOffset++;
+  // inner rectangle (without 1 pixel top and bottom line);
+  // it's one straight run with no dependencies between pixels, so keep everything in locals to let it vectorize
+  {
+    const PIX pixRun = (_pixBufferHeight-2)*_pixBufferWidth;
+    const SWORD *pswAbove = pOld + 1;
+    const SWORD *pswBelow = pOld + 1 + _pixBufferWidth*2;
+    const SWORD *pswMid   = pOld + 1 + _pixBufferWidth;
+    SWORD *pswNew = pNew + 1 + _pixBufferWidth;
+    for( PIX pix=0; pix<pixRun; pix++) {
+      const SLONG slNew = (( (SLONG)pswAbove[pix]
+                           + (SLONG)pswBelow[pix]
+                           + (SLONG)pswMid[pix-1]
+                           + (SLONG)pswMid[pix+1]
+                          ) >> 1)
+                           - (SLONG)pswNew[pix];
+      pswNew[pix] = slNew - (slNew >> slDensity);
     }
   }
 
@@ -1197,8 +1190,6 @@ static void AnimateWater( SLONG slDensity)
 
   // swap buffers
   Swap( _ptdEffect->td_pubBuffer1, _ptdEffect->td_pubBuffer2);
-
-  _sfStats.StopTimer(CStatForm::STI_EFFECTRENDER);
 }
 
 
@@ -1206,14 +1197,11 @@ static void AnimateWater( SLONG slDensity)
 //////////////////////////// displace texture
 
 
-#define PIXEL(u,v) pulTextureBase[ ((u)&(SLONG&)mmBaseWidthMask) + ((v)&(SLONG&)mmBaseHeightMask) *pixBaseWidth]
+#define PIXEL(u,v) pulTextureBase[ ((u)&slBaseWidthMask) + ((v)&slBaseHeightMask) *pixBaseWidth]
 
 
-#pragma warning(disable: 4731)
 static void RenderWater(void)
 {
-  _sfStats.StartTimer(CStatForm::STI_EFFECTRENDER);
-
   // get textures' parameters
   ULONG *pulTexture     = _ptdEffect->td_pulFrames;
   PIX pixBaseWidth      = _ptdBase->GetPixWidth();
@@ -1222,8 +1210,8 @@ static void RenderWater(void)
                         + GetMipmapOffset( _iWantedMipLevel, pixBaseWidth, pixBaseHeight);
   pixBaseWidth   >>= _iWantedMipLevel;
   pixBaseHeight  >>= _iWantedMipLevel;
-  mmBaseWidthMask  = pixBaseWidth -1;
-  mmBaseHeightMask = pixBaseHeight-1;
+  const SLONG slBaseWidthMask  = pixBaseWidth -1;
+  const SLONG slBaseHeightMask = pixBaseHeight-1;
 
   ASSERT( _ptdEffect->td_pulFrames!=NULL && _ptdBase->td_pulFrames!=NULL);
   SWORD *pswHeightMap = (SWORD*)_ptdEffect->td_pubBuffer1; // height map pointer
@@ -1235,95 +1223,21 @@ static void RenderWater(void)
   // execute corresponding displace routine
   if( _pixBufferWidth >= _pixTexWidth)
   { // SUB-SAMPLING
-    SLONG slHeightMapStep, slHeightRowStep;
-
-#if ASMOPT == 1
-
-    __asm {
-      push    ebx
-      bsf     ecx,D [_pixTexWidth]
-      dec     ecx
-      mov     eax,D [_pixBufferWidth]
-      sar     eax,cl
-      mov     D [slHeightMapStep],eax
-
-      bsf     edx,eax
-      add     edx,DISTORSION+2-1
-      mov     D [mmShift],edx
-
-      sub     eax,2
-      imul    eax,D [_pixBufferWidth]
-      mov     D [slHeightRowStep],eax
-
-      mov     eax,D [pixBaseWidth]
-      mov     edx,D [pixBaseHeight]
-      shl     edx,16
-      or      eax,edx
-      sub     eax,0x00010001
-      mov     D [mmBaseMasks],eax
-
-      mov     eax,D [pixBaseWidth]
-      shl     eax,16
-      or      eax,1
-      mov     D [mmBaseWidth],eax
-
-      mov     ebx,D [pswHeightMap]
-      mov     esi,D [pulTextureBase]
-      mov     edi,D [pulTexture]
-      pxor    mm6,mm6   // MM5 = 0 | 0 || pixV | pixU
-      mov     eax,D [_pixBufferWidth]
-      mov     edx,D [_pixTexHeight]
-rowLoop:
-      push    edx
-      mov     ecx,D [_pixTexWidth]
-pixLoop:
-      movd    mm1,D [ebx]
-      movd    mm3,D [ebx+ eax*2]
-      movq    mm2,mm1
-      psubw   mm3,mm1
-      pslld   mm1,16
-      psubw   mm2,mm1
-      pand    mm2,Q [mm00M0]
-      por     mm2,mm3
-      psraw   mm2,Q [mmShift]
-
-      paddw   mm2,mm6
-      pand    mm2,Q [mmBaseMasks]
-      pmaddwd mm2,Q [mmBaseWidth]
-      movd    edx,mm2
-      mov     edx,D [esi+ edx*4]
-      mov     D [edi],edx
-      // advance to next texture pixel
-      add     ebx,D [slHeightMapStep]
-      add     edi,4
-      paddd   mm6,Q [mm0001]
-      dec     ecx
-      jnz     pixLoop
-      // advance to next texture row
-      pop     edx
-      add     ebx,D [slHeightRowStep]
-      paddd   mm6,Q [mm0010]
-      dec     edx
-      jnz     rowLoop
-      emms
-      pop     ebx
-    }
-
-#else
+    SLONG slHeightMapStep, slHeightRowStep, slShift;
 
     PIX pixPos, pixDU, pixDV;
-    slHeightMapStep  = _pixBufferWidth/pixBaseWidth
+    slHeightMapStep  = _pixBufferWidth/_pixTexWidth;
     slHeightRowStep  = (slHeightMapStep-1)*_pixBufferWidth;
-    mmShift = DISTORSION+ FastLog2(slHeightMapStep) +2;
+    slShift = DISTORSION+ FastLog2(slHeightMapStep) +2;
     for( PIX pixV=0; pixV<_pixTexHeight; pixV++)
     { // row loop
       for( PIX pixU=0; pixU<_pixTexWidth; pixU++)
       { // texel loop
         pixPos =  pswHeightMap[0];
-        pixDU  = (pswHeightMap[1]               - pixPos) >>(SLONG&)mmShift;
-        pixDV  = (pswHeightMap[_pixBufferWidth] - pixPos) >>(SLONG&)mmShift;
-        pixDU  = (pixU +pixDU) & (SLONG&)mmBaseWidthMask;
-        pixDV  = (pixV +pixDV) & (SLONG&)mmBaseHeightMask;
+        pixDU  = (pswHeightMap[1]               - pixPos) >>slShift;
+        pixDV  = (pswHeightMap[_pixBufferWidth] - pixPos) >>slShift;
+        pixDU  = (pixU +pixDU) & slBaseWidthMask;
+        pixDV  = (pixV +pixDV) & slBaseHeightMask;
         *pulTexture++ = pulTextureBase[pixDV*pixBaseWidth + pixDU];
         // advance to next texel in height map
         pswHeightMap += slHeightMapStep;
@@ -1331,147 +1245,10 @@ pixLoop:
       pswHeightMap += slHeightRowStep;
     }
 
-#endif
-
   }
   else if( _pixBufferWidth*2 == _pixTexWidth)
   { // BILINEAR SUPER-SAMPLING 2
 
-#if ASMOPT == 1
-
-    __asm {
-      push    ebx
-      bsf     eax,D [pixBaseWidth]
-      mov     edx,32
-      sub     edx,eax
-      mov     D [mmBaseWidthShift],edx
-
-      movq    mm0,Q [mmBaseHeightMask]
-      psllq   mm0,32
-      por     mm0,Q [mmBaseWidthMask]
-      movq    Q [mmBaseMasks],mm0
-
-      pxor    mm6,mm6   // MM6 = pixV|pixU
-      mov     ebx,D [pswHeightMap]
-      mov     esi,D [pulTextureBase]
-      mov     edi,D [pulTexture]
-      mov     edx,D [_pixBufferHeight]
-rowLoop2:
-      push    edx
-      mov     edx,D [_pixTexWidth]
-      mov     ecx,D [_pixBufferWidth]
-pixLoop2:
-      mov     eax,D [_pixBufferWidth]
-
-      movd    mm1,D [ebx+ 2]
-      movd    mm0,D [ebx+ eax*2]
-      psllq   mm0,32
-      por     mm1,mm0
-      movd    mm0,D [ebx]
-      punpckldq mm0,mm0
-      psubd   mm1,mm0
-      movq    mm0,mm6
-      pslld   mm0,DISTORSION+1+1
-      paddd   mm1,mm0               // MM1 = slV_00 | slU_00
-
-      movd    mm2,D [ebx+ 4]
-      movd    mm0,D [ebx+ eax*2 +2]
-      psllq   mm0,32
-      por     mm2,mm0
-      movd    mm0,D [ebx+ 2]
-      punpckldq mm0,mm0
-      psubd   mm2,mm0
-      movq    mm0,mm6
-      paddd   mm0,Q [mm1LO]
-      pslld   mm0,DISTORSION+1+1
-      paddd   mm2,mm0               // MM2 = slV_01 | slU_01
-
-      movd    mm3,D [ebx+ eax*2 +2]
-      movd    mm0,D [ebx+ eax*4]
-      psllq   mm0,32
-      por     mm3,mm0
-      movd    mm0,D [ebx+ eax*2]
-      punpckldq mm0,mm0
-      psubd   mm3,mm0
-      movq    mm0,mm6
-      paddd   mm0,Q [mm1HI]
-      pslld   mm0,DISTORSION+1+1
-      paddd   mm3,mm0               // MM3 = slV_10 | slU_10
-
-      movd    mm4,D [ebx+ eax*2 +4]
-      movd    mm0,D [ebx+ eax*4 +2]
-      psllq   mm0,32
-      por     mm4,mm0
-      movd    mm0,D [ebx+ eax*2 +2]
-      punpckldq mm0,mm0
-      psubd   mm4,mm0
-      movq    mm0,mm6
-      paddd   mm0,Q [mm1HILO]
-      pslld   mm0,DISTORSION+1+1
-      paddd   mm4,mm0               // MM4 = slV_11 | slU_11
-
-      movq    mm0,mm1
-      psrad   mm0,DISTORSION+1+0
-      pand    mm0,Q [mmBaseMasks]
-      movq    mm7,mm0
-      psrlq   mm7,Q [mmBaseWidthShift]
-      paddd   mm0,mm7
-      movd    eax,mm0
-      mov     eax,D [esi+ eax*4]
-      mov     D [edi],eax
-
-      movq    mm0,mm1
-      paddd   mm0,mm2
-      psrad   mm0,DISTORSION+1+1
-      pand    mm0,Q [mmBaseMasks]
-      movq    mm7,mm0
-      psrlq   mm7,Q [mmBaseWidthShift]
-      paddd   mm0,mm7
-      movd    eax,mm0
-      mov     eax,D [esi+ eax*4]
-      mov     D [edi+ 4],eax
-
-      movq    mm0,mm1
-      paddd   mm0,mm3
-      psrad   mm0,DISTORSION+1+1
-      pand    mm0,Q [mmBaseMasks]
-      movq    mm7,mm0
-      psrlq   mm7,Q [mmBaseWidthShift]
-      paddd   mm0,mm7
-      movd    eax,mm0
-      mov     eax,D [esi+ eax*4]
-      mov     D [edi+ edx*4],eax
-
-      paddd   mm1,mm2
-      paddd   mm1,mm3
-      paddd   mm1,mm4
-      psrad   mm1,DISTORSION+1+2
-      pand    mm1,Q [mmBaseMasks]
-      movq    mm7,mm1
-      psrlq   mm7,Q [mmBaseWidthShift]
-      paddd   mm1,mm7
-      movd    eax,mm1
-      mov     eax,D [esi+ eax*4]
-      mov     D [edi+ edx*4 +4],eax
-
-      // advance to next texture pixels
-      paddd   mm6,Q [mm1LO]
-      add     edi,8
-      add     ebx,2
-      dec     ecx
-      jnz     pixLoop2
-      // advance to next texture row
-      lea     edi,[edi+ edx*4]
-      pop     edx
-      paddd   mm6,Q [mm1HI]
-      dec     edx
-      jnz     rowLoop2
-      emms
-      pop     ebx
-    }
-
-#else
-
     SLONG slU_00, slU_01, slU_10, slU_11;
     SLONG slV_00, slV_01, slV_10, slV_11;
     for( PIX pixV=0; pixV<_pixBufferHeight; pixV++)
@@ -1499,352 +1276,12 @@ pixLoop2:
       pulTexture+=_pixTexWidth;
     }
 
-#endif
-
   }
   else if( _pixBufferWidth*4 == _pixTexWidth)
   { // BILINEAR SUPER-SAMPLING 4
 
-#if ASMOPT == 1
-
-    __asm {
-      push    ebx
-      bsf     eax,D [pixBaseWidth]
-      mov     edx,32
-      sub     edx,eax
-      mov     D [mmBaseWidthShift],edx
-
-      movq    mm0,Q [mmBaseHeightMask]
-      psllq   mm0,32
-      por     mm0,Q [mmBaseWidthMask]
-      movq    Q [mmBaseMasks],mm0
-
-      pxor    mm6,mm6   // MM6 = pixV|pixU
-      mov     ebx,D [pswHeightMap]
-      mov     esi,D [pulTextureBase]
-      mov     edi,D [pulTexture]
-      mov     edx,D [_pixBufferHeight]
-rowLoop4:
-      push    edx
-      mov     ecx,D [_pixBufferWidth]
-pixLoop4:
-      mov     eax,D [_pixBufferWidth]
-      mov     edx,D [_pixTexWidth]
-
-      movd    mm1,D [ebx+ 2]
-      movd    mm0,D [ebx+ eax*2]
-      psllq   mm0,32
-      por     mm1,mm0
-      movd    mm0,D [ebx]
-      punpckldq mm0,mm0
-      psubd   mm1,mm0
-      movq    mm0,mm6
-      pslld   mm0,DISTORSION+1+1
-      paddd   mm1,mm0               // MM1 = slV_00 | slU_00
-
-      movd    mm2,D [ebx+ 4]
-      movd    mm0,D [ebx+ eax*2 +2]
-      psllq   mm0,32
-      por     mm2,mm0
-      movd    mm0,D [ebx+ 2]
-      punpckldq mm0,mm0
-      psubd   mm2,mm0
-      movq    mm0,mm6
-      paddd   mm0,Q [mm1LO]
-      pslld   mm0,DISTORSION+1+1
-      paddd   mm2,mm0               // MM2 = slV_01 | slU_01
-
-      movd    mm3,D [ebx+ eax*2 +2]
-      movd    mm0,D [ebx+ eax*4]
-      psllq   mm0,32
-      por     mm3,mm0
-      movd    mm0,D [ebx+ eax*2]
-      punpckldq mm0,mm0
-      psubd   mm3,mm0
-      movq    mm0,mm6
-      paddd   mm0,Q [mm1HI]
-      pslld   mm0,DISTORSION+1+1
-      paddd   mm3,mm0               // MM3 = slV_10 | slU_10
-
-      movd    mm4,D [ebx+ eax*2 +4]
-      movd    mm0,D [ebx+ eax*4 +2]
-      psllq   mm0,32
-      por     mm4,mm0
-      movd    mm0,D [ebx+ eax*2 +2]
-      punpckldq mm0,mm0
-      psubd   mm4,mm0
-      movq    mm0,mm6
-      paddd   mm0,Q [mm1HILO]
-      pslld   mm0,DISTORSION+1+1
-      paddd   mm4,mm0               // MM4 = slV_11 | slU_11
-
-      // texel 00
-      movq    mm0,mm1
-      psrad   mm0,DISTORSION
-      pand    mm0,Q [mmBaseMasks]
-      movq    mm7,mm0
-      psrlq   mm7,Q [mmBaseWidthShift]
-      paddd   mm0,mm7
-      movd    eax,mm0
-      mov     eax,D [esi+ eax*4]
-      mov     D [edi],eax
-      // texel 01
-      movq    mm0,mm1
-      paddd   mm0,mm1
-      paddd   mm0,mm1
-      paddd   mm0,mm2
-      psrad   mm0,DISTORSION+2
-      pand    mm0,Q [mmBaseMasks]
-      movq    mm7,mm0
-      psrlq   mm7,Q [mmBaseWidthShift]
-      paddd   mm0,mm7
-      movd    eax,mm0
-      mov     eax,D [esi+ eax*4]
-      mov     D [edi +4],eax
-      // texel 02
-      movq    mm0,mm1
-      paddd   mm0,mm2
-      psrad   mm0,DISTORSION+1
-      pand    mm0,Q [mmBaseMasks]
-      movq    mm7,mm0
-      psrlq   mm7,Q [mmBaseWidthShift]
-      paddd   mm0,mm7
-      movd    eax,mm0
-      mov     eax,D [esi+ eax*4]
-      mov     D [edi +8],eax
-      // texel 03
-      movq    mm0,mm1
-      paddd   mm0,mm2
-      paddd   mm0,mm2
-      paddd   mm0,mm2
-      psrad   mm0,DISTORSION+2
-      pand    mm0,Q [mmBaseMasks]
-      movq    mm7,mm0
-      psrlq   mm7,Q [mmBaseWidthShift]
-      paddd   mm0,mm7
-      movd    eax,mm0
-      mov     eax,D [esi+ eax*4]
-      mov     D [edi +12],eax
-
-      // texel 10
-      movq    mm0,mm1
-      paddd   mm0,mm1
-      paddd   mm0,mm1
-      paddd   mm0,mm3
-      psrad   mm0,DISTORSION+2
-      pand    mm0,Q [mmBaseMasks]
-      movq    mm7,mm0
-      psrlq   mm7,Q [mmBaseWidthShift]
-      paddd   mm0,mm7
-      movd    eax,mm0
-      mov     eax,D [esi+ eax*4]
-      mov     D [edi+ edx*4],eax
-      // texel 11
-      movq    mm0,mm1
-      pslld   mm0,3
-      paddd   mm0,mm1
-      paddd   mm0,mm2
-      paddd   mm0,mm2
-      paddd   mm0,mm2
-      paddd   mm0,mm3
-      paddd   mm0,mm3
-      paddd   mm0,mm3
-      paddd   mm0,mm4
-      psrad   mm0,DISTORSION+4
-      pand    mm0,Q [mmBaseMasks]
-      movq    mm7,mm0
-      psrlq   mm7,Q [mmBaseWidthShift]
-      paddd   mm0,mm7
-      movd    eax,mm0
-      mov     eax,D [esi+ eax*4]
-      mov     D [edi+ edx*4 +4],eax
-      // texel 12
-      movq    mm0,mm1
-      paddd   mm0,mm0
-      paddd   mm0,mm1
-      paddd   mm0,mm2
-      paddd   mm0,mm2
-      paddd   mm0,mm2
-      paddd   mm0,mm3
-      paddd   mm0,mm4
-      psrad   mm0,DISTORSION+3
-      pand    mm0,Q [mmBaseMasks]
-      movq    mm7,mm0
-      psrlq   mm7,Q [mmBaseWidthShift]
-      paddd   mm0,mm7
-      movd    eax,mm0
-      mov     eax,D [esi+ eax*4]
-      mov     D [edi+ edx*4 +8],eax
-      // texel 13
-      movq    mm0,mm2
-      pslld   mm0,3
-      paddd   mm0,mm2
-      paddd   mm0,mm1
-      paddd   mm0,mm1
-      paddd   mm0,mm1
-      paddd   mm0,mm3
-      paddd   mm0,mm4
-      paddd   mm0,mm4
-      paddd   mm0,mm4
-      psrad   mm0,DISTORSION+4
-      pand    mm0,Q [mmBaseMasks]
-      movq    mm7,mm0
-      psrlq   mm7,Q [mmBaseWidthShift]
-      paddd   mm0,mm7
-      movd    eax,mm0
-      mov     eax,D [esi+ eax*4]
-      mov     D [edi+ edx*4 +12],eax
-
-      // texel 20
-      movq    mm0,mm1
-      paddd   mm0,mm3
-      psrad   mm0,DISTORSION+1
-      pand    mm0,Q [mmBaseMasks]
-      movq    mm7,mm0
-      psrlq   mm7,Q [mmBaseWidthShift]
-      paddd   mm0,mm7
-      movd    eax,mm0
-      mov     eax,D [esi+ eax*4]
-      mov     D [edi+ edx*8],eax
-      // texel 21
-      movq    mm0,mm1
-      paddd   mm0,mm1
-      paddd   mm0,mm1
-      paddd   mm0,mm2
-      paddd   mm0,mm3
-      paddd   mm0,mm3
-      paddd   mm0,mm3
-      paddd   mm0,mm4
-      psrad   mm0,DISTORSION+3
-      pand    mm0,Q [mmBaseMasks]
-      movq    mm7,mm0
-      psrlq   mm7,Q [mmBaseWidthShift]
-      paddd   mm0,mm7
-      movd    eax,mm0
-      mov     eax,D [esi+ eax*4]
-      mov     D [edi+ edx*8 +4],eax
-      // texel 22
-      movq    mm0,mm1
-      paddd   mm0,mm2
-      paddd   mm0,mm3
-      paddd   mm0,mm4
-      psrad   mm0,DISTORSION+2
-      pand    mm0,Q [mmBaseMasks]
-      movq    mm7,mm0
-      psrlq   mm7,Q [mmBaseWidthShift]
-      paddd   mm0,mm7
-      movd    eax,mm0
-      mov     eax,D [esi+ eax*4]
-      mov     D [edi+ edx*8 +8],eax
-      // texel 23
-      movq    mm0,mm1
-      paddd   mm0,mm2
-      paddd   mm0,mm2
-      paddd   mm0,mm2
-      paddd   mm0,mm3
-      paddd   mm0,mm4
-      paddd   mm0,mm4
-      paddd   mm0,mm4
-      psrad   mm0,DISTORSION+3
-      pand    mm0,Q [mmBaseMasks]
-      movq    mm7,mm0
-      psrlq   mm7,Q [mmBaseWidthShift]
-      paddd   mm0,mm7
-      movd    eax,mm0
-      mov     eax,D [esi+ eax*4]
-      mov     D [edi+ edx*8 +12],eax
-
-      imul    edx,3 // _pixTexWidth*=3
-      // texel 30
-      movq    mm0,mm1
-      paddd   mm0,mm3
-      paddd   mm0,mm3
-      paddd   mm0,mm3
-      psrad   mm0,DISTORSION+2
-      pand    mm0,Q [mmBaseMasks]
-      movq    mm7,mm0
-      psrlq   mm7,Q [mmBaseWidthShift]
-      paddd   mm0,mm7
-      movd    eax,mm0
-      mov     eax,D [esi+ eax*4]
-      mov     D [edi+ edx*4],eax
-      // texel 31
-      movq    mm0,mm3
-      pslld   mm0,3
-      paddd   mm0,mm3
-      paddd   mm0,mm1
-      paddd   mm0,mm1
-      paddd   mm0,mm1
-      paddd   mm0,mm2
-      paddd   mm0,mm4
-      paddd   mm0,mm4
-      paddd   mm0,mm4
-      psrad   mm0,DISTORSION+4
-      pand    mm0,Q [mmBaseMasks]
-      movq    mm7,mm0
-      psrlq   mm7,Q [mmBaseWidthShift]
-      paddd   mm0,mm7
-      movd    eax,mm0
-      mov     eax,D [esi+ eax*4]
-      mov     D [edi+ edx*4 +4],eax
-      // texel 32
-      movq    mm0,mm4
-      paddd   mm0,mm0
-      paddd   mm0,mm4
-      paddd   mm0,mm3
-      paddd   mm0,mm3
-      paddd   mm0,mm3
-      paddd   mm0,mm2
-      paddd   mm0,mm1
-      psrad   mm0,DISTORSION+3
-      pand    mm0,Q [mmBaseMasks]
-      movq    mm7,mm0
-      psrlq   mm7,Q [mmBaseWidthShift]
-      paddd   mm0,mm7
-      movd    eax,mm0
-      mov     eax,D [esi+ eax*4]
-      mov     D [edi+ edx*4 +8],eax
-      // texel 33
-      movq    mm0,mm4
-      pslld   mm0,3
-      paddd   mm0,mm4
-      paddd   mm0,mm1
-      paddd   mm0,mm2
-      paddd   mm0,mm2
-      paddd   mm0,mm2
-      paddd   mm0,mm3
-      paddd   mm0,mm3
-      paddd   mm0,mm3
-      psrad   mm0,DISTORSION+4
-      pand    mm0,Q [mmBaseMasks]
-      movq    mm7,mm0
-      psrlq   mm7,Q [mmBaseWidthShift]
-      paddd   mm0,mm7
-      movd    eax,mm0
-      mov     eax,D [esi+ eax*4]
-      mov     D [edi+ edx*4 +12],eax
-
-      // advance to next texture pixels
-      paddd   mm6,Q [mm1LO]
-      add     edi,16
-      add     ebx,2
-      dec     ecx
-      jnz     pixLoop4
-      // advance to next texture row
-      lea     edi,[edi+ edx*4] // +=[_pixTexWidth]*3
-      pop     edx
-      paddd   mm6,Q [mm1HI]
-      dec     edx
-      jnz     rowLoop4
-      emms
-      pop     ebx
-    }
-
-#else
-
     SLONG slU_00, slU_01, slU_10, slU_11;
     SLONG slV_00, slV_01, slV_10, slV_11;
-    mmBaseWidthShift = FastLog2( pixBaseWidth);        // faster multiplying with shift
     for( PIX pixV=0; pixV<_pixBufferHeight; pixV++)
     { // row loop
       for( PIX pixU=0; pixU<_pixBufferWidth; pixU++)
@@ -1880,22 +1317,17 @@ pixLoop4:
 
         // advance to next texel
         pulTexture+=4;
-        pHeightMap++;
+        pswHeightMap++;
       }
       pulTexture+=_pixTexWidth*3;
     }
 
-#endif
-
   }
   else
   { // DO NOTHING
     ASSERTALWAYS( "Effect textures larger than 256 pixels aren't supported");
   }
-
-  _sfStats.StopTimer(CStatForm::STI_EFFECTRENDER);
 }
-#pragma warning(default: 4731)
 
 
 
@@ -1918,16 +1350,30 @@ enum PlasmaType {
 /*******************************
        Plasma Animation
 ********************************/
-static void AnimatePlasma( SLONG slDensity, PlasmaType eType)
+// one straight run of plasma inner rectangle
+// (there are no dependencies between pixels, so keep it simple to let it vectorize)
+static void AnimatePlasmaRun( UBYTE *pubDst, const UBYTE *pubSrc, PIX pixRun, PIX pixStride, SLONG slDensity)
 {
-  _sfStats.StartTimer(CStatForm::STI_EFFECTRENDER);
+  for( PIX pix=0; pix<pixRun; pix++) {
+    const ULONG ulNew = ((((ULONG)pubSrc[pix - pixStride] +
+                           (ULONG)pubSrc[pix + pixStride] +
+                           (ULONG)pubSrc[pix - 1] +
+                           (ULONG)pubSrc[pix + 1]
+                          )>>2) +
+                           (ULONG)pubSrc[pix]
+                        )>>1;
+    pubDst[pix] = ulNew - (ulNew >> slDensity);
+  }
+}
 
+static void AnimatePlasma( SLONG slDensity, PlasmaType eType)
+{
 /////////////////////////////////// move plasma
 
   UBYTE *pNew = (UBYTE*)_ptdEffect->td_pubBuffer1;
   UBYTE *pOld = (UBYTE*)_ptdEffect->td_pubBuffer2;
 
-  PIX pixV, pixU;
+  PIX pixU;
   PIX pixOffset;
   SLONG slLineAbove, slLineBelow, slLineLeft, slLineRight;
   ULONG ulNew;
@@ -1937,20 +1383,7 @@ static void AnimatePlasma( SLONG slDensity, PlasmaType eType)
   // --------------------------
   if (eType == ptNormal) {
     // inner rectangle (without 1 pixel border)
-    pixOffset = _pixBufferWidth;
-    for( pixV=1; pixV<_pixBufferHeight-1; pixV++) {
-      for( pixU=0; pixU<_pixBufferWidth; pixU++) {
-        ulNew = ((((ULONG)pOld[pixOffset - _pixBufferWidth] +
-                   (ULONG)pOld[pixOffset + _pixBufferWidth] +
-                   (ULONG)pOld[pixOffset - 1] +
-                   (ULONG)pOld[pixOffset + 1]
-                  )>>2) +
-                   (ULONG)pOld[pixOffset]
-                )>>1;
-        pNew[pixOffset] = ulNew - (ulNew >> slDensity);
-        pixOffset++;
-      }
-    }
+    AnimatePlasmaRun( pNew+_pixBufferWidth, pOld+_pixBufferWidth, (_pixBufferHeight-2)*_pixBufferWidth, _pixBufferWidth, slDensity);
     // upper horizontal border (without corners)
     slLineAbove = ((_pixBufferHeight-1)*_pixBufferWidth) + 1;
     slLineBelow = _pixBufferWidth + 1;
@@ -2036,20 +1469,7 @@ static void AnimatePlasma( SLONG slDensity, PlasmaType eType)
   // --------------------------
   } else if (eType==ptUp || eType==ptUpTile) {
     // inner rectangle (without 1 pixel border)
-    pixOffset = _pixBufferWidth;
-    for( pixV=1; pixV<_pixBufferHeight-1; pixV++) {
-      for( pixU=0; pixU<_pixBufferWidth; pixU++) {
-        ulNew = ((((ULONG)pOld[pixOffset - _pixBufferWidth] +
-                   (ULONG)pOld[pixOffset + _pixBufferWidth] +
-                   (ULONG)pOld[pixOffset - 1] +
-                   (ULONG)pOld[pixOffset + 1]
-                  )>>2) +
-                   (ULONG)pOld[pixOffset]
-                )>>1;
-        pNew[pixOffset-_pixBufferWidth] = ulNew - (ulNew >> slDensity);
-        pixOffset++;
-      }
-    }
+    AnimatePlasmaRun( pNew, pOld+_pixBufferWidth, (_pixBufferHeight-2)*_pixBufferWidth, _pixBufferWidth, slDensity);
     // tile
     if (eType==ptUpTile) {
       // upper horizontal border (without corners)
@@ -2138,20 +1558,7 @@ static void AnimatePlasma( SLONG slDensity, PlasmaType eType)
   // --------------------------
   } else if (eType==ptDown || eType==ptDownTile) {
     // inner rectangle (without 1 pixel border)
-    pixOffset = _pixBufferWidth;
-    for( pixV=1; pixV<_pixBufferHeight-1; pixV++) {
-      for( pixU=0; pixU<_pixBufferWidth; pixU++) {
-        ulNew = ((((ULONG)pOld[pixOffset - _pixBufferWidth] +
-                   (ULONG)pOld[pixOffset + _pixBufferWidth] +
-                   (ULONG)pOld[pixOffset - 1] +
-                   (ULONG)pOld[pixOffset + 1]
-                  )>>2) +
-                   (ULONG)pOld[pixOffset]
-                )>>1;
-        pNew[pixOffset+_pixBufferWidth] = ulNew - (ulNew >> slDensity);
-        pixOffset++;
-      }
-    }
+    AnimatePlasmaRun( pNew+_pixBufferWidth*2, pOld+_pixBufferWidth, (_pixBufferHeight-2)*_pixBufferWidth, _pixBufferWidth, slDensity);
     // tile
     if (eType==ptDownTile) {
       // upper horizontal border (without corners)
@@ -2237,8 +1644,6 @@ static void AnimatePlasma( SLONG slDensity, PlasmaType eType)
 
   // swap buffers
   Swap( _ptdEffect->td_pubBuffer1, _ptdEffect->td_pubBuffer2);
-
-  _sfStats.StopTimer(CStatForm::STI_EFFECTRENDER);
 }
 
 
@@ -2247,67 +1652,11 @@ static void AnimatePlasma( SLONG slDensity, PlasmaType eType)
 ********************************/
 static void AnimateFire( SLONG slDensity)
 {
-//  _sfStats.StartTimer(CStatForm::STI_EFFECTRENDER);
-
 /////////////////////////////////// move fire
 
   // use only one buffer (otherwise it's not working)
   UBYTE *pubNew = (UBYTE*)_ptdEffect->td_pubBuffer2;
   SLONG slBufferMask   = _pixBufferWidth*_pixBufferHeight -1;
-  SLONG slColumnModulo = _pixBufferWidth*(_pixBufferHeight-2) -1;
-
-#if ASMOPT == 1
-
-  __asm {
-    push    ebx
-    mov     edi,D [ulRNDSeed] ;// EDI = randomizer
-    mov     esi,D [pubNew]
-    xor     ebx,ebx
-
-colLoopFM:
-    mov     ecx,D [_pixBufferHeight]
-    sub     ecx,2
-
-rowLoopFM:
-    mov     edx,D [_pixBufferWidth]
-    add     edx,esi
-    movzx   eax,B [ebx+ edx]
-    add     edx,D [_pixBufferWidth]
-    movzx   edx,B [ebx+ edx]
-    add     eax,edx
-    shr     eax,1
-    cmp     eax,D [slDensity]
-    jg      doCalc
-    mov     B [esi+ebx],0
-    jmp     pixDone
-doCalc:
-    mov     edx,edi
-    sar     edx,16
-    and     edx,D [slDensity]
-    sub     eax,edx
-    movsx   edx,B [asbMod3Sub1Table +edx]
-    add     edx,ebx
-    and     edx,D [slBufferMask]
-    mov     B [esi+edx],al
-    imul    edi,262147
-
-pixDone:
-    // advance to next row
-    add     ebx,D [_pixBufferWidth]
-    dec     ecx
-    jnz     rowLoopFM
-
-    // advance to next column
-    sub     ebx,D [slColumnModulo]
-    cmp     ebx,D [_pixBufferWidth]
-    jl      colLoopFM
-
-    // all done
-    mov     D [ulRNDSeed],edi
-    pop     ebx
-  }
-
-#else
 
   // inner rectangle (without 1 pixel border)
   for( PIX pixU=0; pixU<_pixBufferWidth; pixU++)
@@ -2328,18 +1677,12 @@ pixDone:
       slOffset += _pixBufferWidth;
     }
   }
-
-#endif
-
-//  _sfStats.StopTimer(CStatForm::STI_EFFECTRENDER);
 }
 
 //////////////////////////// displace texture
 
 static void RenderPlasmaFire(void)
 {
-//  _sfStats.StartTimer(CStatForm::STI_EFFECTRENDER);
-
   // get and adjust textures' parameters
   PIX    pixBaseWidth   = _ptdBase->GetPixWidth();
   ULONG *pulTextureBase = _ptdBase->td_pulFrames;
@@ -2351,38 +1694,6 @@ static void RenderPlasmaFire(void)
   SLONG slHeatRowStep  = (slHeatMapStep-1)*_pixBufferWidth;
   SLONG slBaseMipShift = 8 - FastLog2(pixBaseWidth);
 
-#if ASMOPT == 1
-
-  __asm {
-    push    ebx
-    mov     ebx,D [pubHeat]
-    mov     esi,D [pulTextureBase]
-    mov     edi,D [pulTexture]
-    mov     ecx,D [_pixTexHeight]
-rowLoopF:
-    push    ecx
-    mov     edx,D [_pixTexWidth]
-    mov     ecx,D [slBaseMipShift]
-pixLoopF:
-    movzx   eax,B [ebx]
-    shr     eax,cl
-    mov     eax,D [esi+ eax*4]
-    mov     D [edi],eax
-    // advance to next pixel
-    add     ebx,D [slHeatMapStep]
-    add     edi,4
-    dec     edx
-    jnz     pixLoopF
-    // advance to next row
-    pop     ecx
-    add     ebx,D [slHeatRowStep]
-    dec     ecx
-    jnz     rowLoopF
-    pop     ebx
-  }
-
-#else
-
   INDEX iPalette;
   for( INDEX pixV=0; pixV<_pixTexHeight; pixV++) {
     // for every pixel in horizontal line
@@ -2393,10 +1704,6 @@ pixLoopF:
     }
     pubHeat += slHeatRowStep;
   }
-
-#endif
-
-//  _sfStats.StopTimer(CStatForm::STI_EFFECTRENDER);
 }
 
 
@@ -2606,16 +1913,82 @@ BOOL CTextureEffectGlobal::IsWater(void)
   return( _ategtTextureEffectGlobalPresets[teg_ulEffectType].tegt_Initialize == InitializeWater);
 }
 
+// make effect current for animating or rendering on calling thread
+static void BeginEffect( CTextureEffectGlobal *pteg)
+{
+  _ptdEffect       = pteg->teg_ptdTexture;
+  _ptdBase         = _ptdEffect->td_ptdBaseTexture;
+  _pixBufferWidth  = _ptdEffect->td_pixBufferWidth;
+  _pixBufferHeight = _ptdEffect->td_pixBufferHeight;
+  _ulBufferMask    = _pixBufferHeight*_pixBufferWidth -1;
+  // remember buffer pointers
+  _pubDrawBuffer = (UBYTE*)_ptdEffect->td_pubBuffer2;
+  _pswDrawBuffer = (SWORD*)_ptdEffect->td_pubBuffer2;
+  // continue with effect's own random sequence
+  ulRNDSeed = pteg->teg_ulRandomSeed;
+}
+
+// remember state of effect that was current on calling thread
+static void EndEffect( CTextureEffectGlobal *pteg)
+{
+  pteg->teg_ulRandomSeed = ulRNDSeed;
+}
+
+// animate effect (safe to call from worker threads for different effects)
+static void AnimateEffect( CTextureEffectGlobal *pteg)
+{
+  BeginEffect(pteg);
+  // for each effect source
+  FOREACHINDYNAMICARRAY( pteg->teg_atesEffectSources, CTextureEffectSource, itEffectSource) {
+    // let it animate itself
+    itEffectSource->Animate();
+  }
+  // use animation function for this global effect type
+  _ategtTextureEffectGlobalPresets[pteg->teg_ulEffectType].tegt_Animate();
+  EndEffect(pteg);
+}
+
+// render effect (safe to call from worker threads for different effects)
+static void RenderEffect( CTextureEffectGlobal *pteg, INDEX iWantedMipLevel, PIX pixTexWidth, PIX pixTexHeight)
+{
+  BeginEffect(pteg);
+  if( pteg->IsWater()) {
+    // use water rendering routine
+    _pixTexWidth  = pixTexWidth;
+    _pixTexHeight = pixTexHeight;
+    _iWantedMipLevel = iWantedMipLevel;
+    RenderWater();
+  } else {
+    // use plasma & fire rendering routine
+    _pixTexWidth  = _ptdEffect->GetWidth()  >>iWantedMipLevel;
+    _pixTexHeight = _ptdEffect->GetHeight() >>iWantedMipLevel;
+    RenderPlasmaFire();
+  }
+  EndEffect(pteg);
+}
+
+
 // default constructor
 CTextureEffectGlobal::CTextureEffectGlobal(CTextureData *ptdTexture, ULONG ulGlobalEffect)
 {
+  // if not set yet (funny word construction:)
+  if( !bTableSet) {
+    // set table for fast modulo 3 minus 1
+    for( INDEX i=0; i<256; i++) asbMod3Sub1Table[i]=(SBYTE)((i%3)-1);
+    bTableSet = TRUE;
+  }
+
   // remember global effect's texture data for cross linking
   teg_ptdTexture = ptdTexture;
   teg_ulEffectType = ulGlobalEffect;
   // init for animating
   _ategtTextureEffectGlobalPresets[teg_ulEffectType].tegt_Initialize();
+  teg_ulRandomSeed = ulRNDSeed;
   // make sure the texture will be updated next time when used
   teg_updTexture.Invalidate();
+  teg_tmPrerendered = -1;
+  teg_iPrerenderedMip = -1;
+  teg_pixPrerenderedWidth = teg_pixPrerenderedHeight = 0;
 }
 
 // add new effect source.
@@ -2623,64 +1996,35 @@ void CTextureEffectGlobal::AddEffectSource( ULONG ulEffectSourceType, PIX pixU0,
                                             PIX pixU1, PIX pixV1)
 {
   CTextureEffectSource* ptesNew = teg_atesEffectSources.New(1);
+  BeginEffect(this);
   ptesNew->Initialize(this, ulEffectSourceType, pixU0, pixV0, pixU1, pixV1);
+  EndEffect(this);
 }
 
 // animate effect texture
 void CTextureEffectGlobal::Animate(void)
 {
-  // if not set yet (funny word construction:)
-  if( !bTableSet) {
-    // set table for fast modulo 3 minus 1
-    for( INDEX i=0; i<256; i++) asbMod3Sub1Table[i]=(SBYTE)((i%3)-1);
-    bTableSet = TRUE;
-  }
-
-  // setup some internal vars
-  _ptdEffect       = teg_ptdTexture;
-  _pixBufferWidth  = _ptdEffect->td_pixBufferWidth;
-  _pixBufferHeight = _ptdEffect->td_pixBufferHeight;
-  _ulBufferMask    = _pixBufferHeight*_pixBufferWidth -1;
-
-  // remember buffer pointers
-  _pubDrawBuffer=(UBYTE*)_ptdEffect->td_pubBuffer2;
-  _pswDrawBuffer=(SWORD*)_ptdEffect->td_pubBuffer2;
-  
-  // for each effect source
-  FOREACHINDYNAMICARRAY( teg_atesEffectSources, CTextureEffectSource, itEffectSource) {
-    // let it animate itself
-    itEffectSource->Animate();
-  }
-  // use animation function for this global effect type
-  _ategtTextureEffectGlobalPresets[teg_ulEffectType].tegt_Animate();
+  _sfStats.StartTimer(CStatForm::STI_EFFECTRENDER);
+  AnimateEffect(this);
+  _sfStats.StopTimer(CStatForm::STI_EFFECTRENDER);
   // remember that it was calculated
   teg_updTexture.MarkUpdated();
 }
 
-#pragma warning(disable: 4731)
 // render effect texture
 void CTextureEffectGlobal::Render( INDEX iWantedMipLevel, PIX pixTexWidth, PIX pixTexHeight)
 {
-  // setup some internal vars
-  _ptdEffect = teg_ptdTexture;
-  _ptdBase   = teg_ptdTexture->td_ptdBaseTexture;
-  _pixBufferWidth  = _ptdEffect->td_pixBufferWidth;
-  _pixBufferHeight = _ptdEffect->td_pixBufferHeight;
+  _sfStats.StartTimer(CStatForm::STI_EFFECTRENDER);
+  RenderEffect( this, iWantedMipLevel, pixTexWidth, pixTexHeight);
+  _sfStats.StopTimer(CStatForm::STI_EFFECTRENDER);
+}
 
-  if( IsWater()) {
-    // use water rendering routine
-    _pixTexWidth  = pixTexWidth;
-    _pixTexHeight = pixTexHeight;
-    _iWantedMipLevel = iWantedMipLevel;
-    RenderWater();
-  } else {
-    // use plasma & fire rendering routine
-    _pixTexWidth  = _ptdEffect->GetWidth()  >>iWantedMipLevel;
-    _pixTexHeight = _ptdEffect->GetHeight() >>iWantedMipLevel;
-    RenderPlasmaFire();
-  }
+// check whether effect texture has been already animated and rendered for this tick in wanted mip level
+BOOL CTextureEffectGlobal::IsPrerendered( INDEX iWantedMipLevel, PIX pixTexWidth, PIX pixTexHeight)
+{
+  return teg_tmPrerendered==_pTimer->CurrentTick() && teg_iPrerenderedMip==iWantedMipLevel
+      && teg_pixPrerenderedWidth==pixTexWidth && teg_pixPrerenderedHeight==pixTexHeight;
 }
-#pragma warning(default: 4731)
 
 // returns number of second it took to render effect texture
 DOUBLE CTextureEffectGlobal::GetRenderingTime(void)
@@ -2689,3 +2033,150 @@ DOUBLE CTextureEffectGlobal::GetRenderingTime(void)
 }
 
 
+
+/////////////////////////////////////////////////////////////////////
+//                   PARALLEL UPDATE OF EFFECTS
+/////////////////////////////////////////////////////////////////////
+
+extern INDEX tex_bParallelEffects;
+
+struct EffectJob {
+  CTextureData *ej_ptdTexture;
+  INDEX ej_iMipLevel;
+  PIX   ej_pixWidth, ej_pixHeight;
+};
+static CStaticStackArray<EffectJob> _aejEffects;
+
+static void EffectJob_AnimateAndRender( INDEX iJob, void *pvUserData)
+{
+  EffectJob &ej = ((EffectJob*)pvUserData)[iJob];
+  CTextureEffectGlobal *pteg = ej.ej_ptdTexture->td_ptegEffect;
+  AnimateEffect(pteg);
+  RenderEffect( pteg, ej.ej_iMipLevel, ej.ej_pixWidth, ej.ej_pixHeight);
+}
+
+// prepare job for effect texture (everything that isn't thread-safe must be done here)
+static void AddEffectJob( CTextureData *ptd)
+{
+  EffectJob &ej = _aejEffects.Push();
+  ej.ej_ptdTexture = ptd;
+  ptd->PrepareEffectFrame( ej.ej_iMipLevel, ej.ej_pixWidth, ej.ej_pixHeight);
+  // make sure that effect and base textures are static
+  ptd->Force(TEX_STATIC);
+  ptd->td_ptdBaseTexture->Force(TEX_STATIC);
+}
+
+// animate and render (in parallel) all effect textures that are going to be drawn in this tick
+void UpdateEffectTextures(void)
+{
+  if( !tex_bParallelEffects || JobPool_GetThreadCount()<2) return;
+  const TIME tmNow = _pTimer->CurrentTick();
+  const CTimerValue tvNow = _pTimer->GetHighPrecisionTimer();
+
+  // gather effect textures that aren't done for this tick, but have been drawn lately
+  _aejEffects.PopAll();
+  {FOREACHINDYNAMICCONTAINER( _pTextureStock->st_ctObjects, CTextureData, ittd) {
+    CTextureData &td = *ittd;
+    CTextureEffectGlobal *pteg = td.td_ptegEffect;
+    if( pteg==NULL || td.td_ptdBaseTexture==NULL) continue;
+    if( pteg->teg_updTexture.LastUpdateTime()==tmNow || pteg->teg_tmPrerendered==tmNow) continue;
+    if( td.td_tvLastDrawn.tv_llValue==0 || (tvNow-td.td_tvLastDrawn).GetSeconds()>1.0) continue;
+    AddEffectJob(&td);
+  }}
+  const INDEX ctEffects = _aejEffects.Count();
+  if( ctEffects<2) return;
+
+  _sfStats.StartTimer(CStatForm::STI_EFFECTRENDER);
+  JobPool_Run( ctEffects, EffectJob_AnimateAndRender, &_aejEffects[0]);
+  _sfStats.StopTimer(CStatForm::STI_EFFECTRENDER);
+
+  // mark that they don't need to be done again when drawn
+  for( INDEX iEffect=0; iEffect<ctEffects; iEffect++) {
+    const EffectJob &ej = _aejEffects[iEffect];
+    CTextureEffectGlobal *pteg = ej.ej_ptdTexture->td_ptegEffect;
+    pteg->teg_tmPrerendered = tmNow;
+    pteg->teg_iPrerenderedMip = ej.ej_iMipLevel;
+    pteg->teg_pixPrerenderedWidth  = ej.ej_pixWidth;
+    pteg->teg_pixPrerenderedHeight = ej.ej_pixHeight;
+  }
+}
+
+
+// animate and render many effect textures at largest effect size, serially and on job pool,
+// and report timings and whether both ways give the same result (doesn't need any graphics API)
+#define BENCHMARK_EFFECTS 64
+#define BENCHMARK_TICKS  100
+
+static ULONG RunEffectBenchmark( CTextureData *ptdBase, BOOL bParallel, DOUBLE &dSeconds)
+{
+  // create effect textures of all types with all of their sources
+  CStaticArray<CTextureData> atdEffects;
+  atdEffects.New(BENCHMARK_EFFECTS);
+  for( INDEX iEffect=0; iEffect<BENCHMARK_EFFECTS; iEffect++) {
+    CTextureData &td = atdEffects[iEffect];
+    const ULONG ulType = iEffect % _ctTextureEffectGlobalPresets;
+    td.CreateEffectTexture( 256, 256, 256, ptdBase, ulType);
+    CTextureEffectGlobal *pteg = td.td_ptegEffect;
+    pteg->teg_ulRandomSeed = iEffect+1;  // same start for both runs
+    const TextureEffectGlobalType &tegt = _ategtTextureEffectGlobalPresets[ulType];
+    for( INDEX iSource=0; iSource<tegt.tet_ctEffectSourceTypes; iSource++) {
+      const PIX pixU = 16 + (iEffect*37+iSource*53) % 224;
+      const PIX pixV = 16 + (iEffect*91+iSource*29) % 224;
+      pteg->AddEffectSource( iSource, pixU, pixV, pixU+16, pixV+16);
+    }
+  }
+
+  const INDEX tex_iOldEffectSize = tex_iEffectSize;
+  tex_iEffectSize = 8;
+  CTimerValue tvStart = _pTimer->GetHighPrecisionTimer();
+  for( INDEX iTick=0; iTick<BENCHMARK_TICKS; iTick++) {
+    _aejEffects.PopAll();
+    for( INDEX iEffect=0; iEffect<BENCHMARK_EFFECTS; iEffect++) AddEffectJob( &atdEffects[iEffect]);
+    if( bParallel) {
+      JobPool_Run( BENCHMARK_EFFECTS, EffectJob_AnimateAndRender, &_aejEffects[0]);
+    } else {
+      for( INDEX iJob=0; iJob<BENCHMARK_EFFECTS; iJob++) EffectJob_AnimateAndRender( iJob, &_aejEffects[0]);
+    }
+  }
+  dSeconds = (_pTimer->GetHighPrecisionTimer()-tvStart).GetSeconds();
+  tex_iEffectSize = tex_iOldEffectSize;
+
+  // checksum of all rendered frames
+  ULONG ulCRC;
+  CRC_Start(ulCRC);
+  for( INDEX iEffect=0; iEffect<BENCHMARK_EFFECTS; iEffect++) {
+    const EffectJob &ej = _aejEffects[iEffect];
+    CRC_AddBlock( ulCRC, (UBYTE*)ej.ej_ptdTexture->td_pulFrames, ej.ej_pixWidth*ej.ej_pixHeight*BYTES_PER_TEXEL);
+  }
+  CRC_Finish(ulCRC);
+  _aejEffects.PopAll();
+  return ulCRC;
+}
+
+void EffectTextureBenchmark(void *pArgs)
+{
+  CTString strBaseTexture = *NEXTARGUMENT(CTString*);
+  CTextureData *ptdBase;
+  try {
+    ptdBase = _pTextureStock->Obtain_t( CTFileName(strBaseTexture));
+  } catch( char *strError) {
+    CPrintF( "%s\n", strError);
+    return;
+  }
+  ptdBase->Force(TEX_STATIC);
+  if( ptdBase->td_pulFrames==NULL || ptdBase->td_ptegEffect!=NULL || ptdBase->GetPixWidth()>256) {
+    CPrintF( TRANS("'%s' cannot be used as base texture.\n"), (const char*)strBaseTexture);
+    _pTextureStock->Release(ptdBase);
+    return;
+  }
+
+  DOUBLE dSerial, dParallel;
+  const ULONG ulSerial   = RunEffectBenchmark( ptdBase, FALSE, dSerial);
+  const ULONG ulParallel = RunEffectBenchmark( ptdBase, TRUE,  dParallel);
+  _pTextureStock->Release(ptdBase);
+
+  CPrintF( TRANS("%d effect textures, %d ticks at 256x256:\n"), BENCHMARK_EFFECTS, BENCHMARK_TICKS);
+  CPrintF( TRANS("  serial:   %6.2f ms per tick (CRC 0x%08X)\n"), dSerial  *1000.0/BENCHMARK_TICKS, ulSerial);
+  CPrintF( TRANS("  parallel: %6.2f ms per tick (CRC 0x%08X) on %d threads\n"), dParallel*1000.0/BENCHMARK_TICKS, ulParallel, JobPool_GetThreadCount());
+  if( ulSerial!=ulParallel) CPrintF( TRANS("  ERROR: results differ!\n"));
+}
@@ -51,6 +51,10 @@ public:
   ULONG teg_ulEffectType;
   CUpdateable teg_updTexture;   // when the texture was last updated
   CDynamicArray<CTextureEffectSource> teg_atesEffectSources;
+  ULONG teg_ulRandomSeed;       // randomizer state of this effect
+  TIME  teg_tmPrerendered;      // tick for which texture was animated and rendered in advance (if any)
+  INDEX teg_iPrerenderedMip;    // mip level and size it was rendered in
+  PIX   teg_pixPrerenderedWidth, teg_pixPrerenderedHeight;
 
   // Constructor.
   CTextureEffectGlobal(CTextureData *ptdTexture, ULONG ulGlobalEffect);
@@ -62,6 +66,8 @@ public:
   void Animate(void);
   // render effect texture in required mip level
   void Render( INDEX iWantedMipLevel, PIX pixTexWidth, PIX pixTexHeight);
+  // check whether effect texture has been already animated and rendered for this tick in wanted mip level
+  BOOL IsPrerendered( INDEX iWantedMipLevel, PIX pixTexWidth, PIX pixTexHeight);
 
   // get effect type (true if water type effect, false if plasma or fire effect)
   BOOL IsWater(void);
@@ -94,6 +100,9 @@ struct TextureEffectGlobalProperties_Fire {
   UBYTE tegpw_ubRising;    // 0 for no rising
 };
 
+// animate and render (in parallel) all effect textures that are going to be drawn in this tick
+extern void UpdateEffectTextures(void);
+
 ENGINE_API extern INDEX _ctTextureEffectGlobalPresets;
 ENGINE_API extern struct TextureEffectGlobalType _ategtTextureEffectGlobalPresets[];
 
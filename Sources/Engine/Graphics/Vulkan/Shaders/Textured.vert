@@ -1,6 +1,7 @@
 #version 400
 #extension GL_ARB_separate_shader_objects : enable
 #extension GL_ARB_shading_language_420pack : enable
+#extension GL_ARB_shader_storage_buffer_object : enable
 
 layout (location = 0) in vec4 inPosition;
 layout (location = 1) in vec4 inColor;
@@ -12,10 +13,11 @@ layout (location = 0) out vec4 outColor;
 layout (location = 1) out vec4 outTexCoord01;
 layout (location = 2) out vec4 outTexCoord23;
 
-layout (std140, set = 0, binding = 0) uniform MainBuffer
+// matrices of draws; each draw selects its own with first instance
+layout (std430, set = 0, binding = 0) readonly buffer MatrixBuffer
 {
-    mat4 MVP;
-} unBuffer;
+    mat4 MVP[];
+} matrices;
 
 void main() 
 {
@@ -23,5 +25,5 @@ void main()
     outTexCoord01 = inTexCoord01;
     outTexCoord23 = inTexCoord23;
 
-    gl_Position = unBuffer.MVP * inPosition;
+    gl_Position = matrices.MVP[gl_InstanceIndex] * inPosition;
 }
\ No newline at end of file
@@ -0,0 +1,283 @@
+/* Copyright (c) 2020 Sultim Tsyrendashiev
+This program is free software; you can redistribute it and/or modify
+it under the terms of version 2 of the GNU General Public License as published by
+the Free Software Foundation
+
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA. */
+
+#include "stdh.h"
+#include <Engine/Graphics/Vulkan/SvkMain.h>
+#include <Engine/Graphics/GfxProfile.h>
+#include <Engine/Base/JobPool.h>
+#include <Engine/Base/Timer.h>
+
+#ifdef SE1_VULKAN
+
+// data for recording one frame on job pool threads
+struct SvkRecordJobs
+{
+  SvkMain                 *srj_Main;
+  uint32_t                srj_ThreadCount;
+  SvkBoundState           srj_States[SVK_MAX_RECORD_THREADS];
+  VkResult                srj_Results[SVK_MAX_RECORD_THREADS];
+};
+
+void SvkMain::InvalidateBoundState(SvkBoundState &bs)
+{
+  bs.sbs_Pipeline = VK_NULL_HANDLE;
+  bs.sbs_SetsValid = false;
+  bs.sbs_ScaleValid = false;
+  bs.sbs_VertexBuffer = VK_NULL_HANDLE;
+  bs.sbs_VertexOffset = 0;
+  bs.sbs_IndexBuffer = VK_NULL_HANDLE;
+}
+
+void SvkMain::ResetBoundState()
+{
+  gl_VkPreviousPipeline = nullptr;
+  InvalidateBoundState(gl_VkBoundState);
+}
+
+void SvkMain::AddBoundStateCounters(SvkBoundState &bs)
+{
+  _pfGfxProfile.IncrementCounter(CGfxProfile::PCI_VK_DRAWCALLS, bs.sbs_ctDrawCalls);
+  _pfGfxProfile.IncrementCounter(CGfxProfile::PCI_VK_PIPELINEBINDS, bs.sbs_ctPipelineBinds);
+  _pfGfxProfile.IncrementCounter(CGfxProfile::PCI_VK_DESCRIPTORBINDS, bs.sbs_ctDescriptorBinds);
+  _pfGfxProfile.IncrementCounter(CGfxProfile::PCI_VK_BUFFERBINDS, bs.sbs_ctBufferBinds);
+
+  bs.sbs_ctDrawCalls = 0;
+  bs.sbs_ctPipelineBinds = 0;
+  bs.sbs_ctDescriptorBinds = 0;
+  bs.sbs_ctBufferBinds = 0;
+}
+
+void SvkMain::AddRenderCommand(const SvkRenderCommand &rc)
+{
+  ASSERT(gl_VkCmdIsRecording);
+
+  if (gl_VkRecordThreads > 0)
+  {
+    gl_VkRenderCommands.Push() = rc;
+  }
+  else
+  {
+    RecordRenderCommand(gl_VkCmdBuffers[gl_VkCmdBufferCurrent], rc, gl_VkBoundState);
+  }
+}
+
+void SvkMain::RecordRenderCommand(VkCommandBuffer cmd, const SvkRenderCommand &rc, SvkBoundState &bs)
+{
+  switch (rc.src_Type)
+  {
+  case SRC_DRAW:
+  {
+    const SvkDrawBatch &batch = rc.src_Draw;
+
+    if (bs.sbs_Pipeline != rc.src_Pipeline)
+    {
+      vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, rc.src_Pipeline);
+      bs.sbs_Pipeline = rc.src_Pipeline;
+      bs.sbs_ctPipelineBinds++;
+    }
+
+    // set uniform and textures
+    if (!bs.sbs_SetsValid || bs.sbs_UniformOffset != batch.sdw_UniformOffset
+      || memcmp(bs.sbs_Sets, batch.sdw_Sets, sizeof(batch.sdw_Sets)) != 0)
+    {
+      vkCmdBindDescriptorSets(
+        cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, gl_VkPipelineLayout,
+        0, 5, batch.sdw_Sets,
+        1, &batch.sdw_UniformOffset);
+
+      memcpy(bs.sbs_Sets, batch.sdw_Sets, sizeof(batch.sdw_Sets));
+      bs.sbs_UniformOffset = batch.sdw_UniformOffset;
+      bs.sbs_SetsValid = true;
+      bs.sbs_ctDescriptorBinds++;
+    }
+
+    // set texture color scales
+    if (!bs.sbs_ScaleValid || bs.sbs_TextureColorScale != batch.sdw_TextureColorScale)
+    {
+      vkCmdPushConstants(cmd, gl_VkPipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT,
+        0, sizeof(float), &batch.sdw_TextureColorScale);
+
+      bs.sbs_TextureColorScale = batch.sdw_TextureColorScale;
+      bs.sbs_ScaleValid = true;
+    }
+
+    // set mesh; buffers are bound at start, so they don't have to be rebound for each batch,
+    // unless vertex data is not aligned to vertex size (e.g. after occlusion queries)
+    VkDeviceSize vertexBindOffset = 0;
+    int32_t vertexOffset = (int32_t)(batch.sdw_VertexStart / SVK_VERT_SIZE);
+    if (batch.sdw_VertexStart % SVK_VERT_SIZE != 0)
+    {
+      vertexBindOffset = batch.sdw_VertexStart;
+      vertexOffset = 0;
+    }
+
+    if (bs.sbs_VertexBuffer != batch.sdw_VertexBuffer || bs.sbs_VertexOffset != vertexBindOffset)
+    {
+      vkCmdBindVertexBuffers(cmd, 0, 1, &batch.sdw_VertexBuffer, &vertexBindOffset);
+      bs.sbs_VertexBuffer = batch.sdw_VertexBuffer;
+      bs.sbs_VertexOffset = vertexBindOffset;
+      bs.sbs_ctBufferBinds++;
+    }
+
+    if (bs.sbs_IndexBuffer != batch.sdw_IndexBuffer)
+    {
+      vkCmdBindIndexBuffer(cmd, batch.sdw_IndexBuffer, 0, VK_INDEX_TYPE_UINT32);
+      bs.sbs_IndexBuffer = batch.sdw_IndexBuffer;
+      bs.sbs_ctBufferBinds++;
+    }
+
+    const uint32_t firstIndex = (uint32_t)(batch.sdw_IndexStart / sizeof(uint32_t));
+    vkCmdDrawIndexed(cmd, batch.sdw_IndexCount, 1, firstIndex, vertexOffset, batch.sdw_MatrixIndex);
+    bs.sbs_ctDrawCalls++;
+    break;
+  }
+  case SRC_VIEWPORT:
+  {
+    vkCmdSetViewport(cmd, 0, 1, &rc.src_Viewport);
+    vkCmdSetScissor(cmd, 0, 1, &rc.src_Scissor);
+    break;
+  }
+  case SRC_CLEAR:
+  {
+    vkCmdClearAttachments(cmd, 1, &rc.src_ClearAttachment, 1, &rc.src_ClearRect);
+    break;
+  }
+  case SRC_OCCLUSIONQUERY:
+  {
+    VkQueryPool queryPool = gl_VkOcclusionQueryPools[gl_VkCmdBufferCurrent];
+
+    vkCmdBeginQuery(cmd, queryPool, rc.src_QueryId, 0);
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, rc.src_Pipeline);
+    vkCmdBindVertexBuffers(cmd, 0, 1, &rc.src_Draw.sdw_VertexBuffer, &rc.src_Draw.sdw_VertexStart);
+    vkCmdBindIndexBuffer(cmd, rc.src_Draw.sdw_IndexBuffer, rc.src_Draw.sdw_IndexStart, VK_INDEX_TYPE_UINT32);
+    vkCmdDrawIndexed(cmd, 6, 1, 0, 0, 0);
+    vkCmdEndQuery(cmd, queryPool, rc.src_QueryId);
+
+    // reset to prevent usage of this pipeline and its bindings for a next object
+    InvalidateBoundState(bs);
+    break;
+  }
+  default:
+    ASSERTALWAYS("Vulkan error: Unknown render command.\n");
+  }
+}
+
+// record one part of kept commands into its secondary cmd buffer
+static void RecordCommandsJob(INDEX iJob, void *pvUserData)
+{
+  SvkRecordJobs &jobs = *(SvkRecordJobs *)pvUserData;
+  SvkMain &svk = *jobs.srj_Main;
+
+  const INDEX ctCommands = svk.gl_VkRenderCommands.Count();
+  const INDEX iFirst = ctCommands * iJob / jobs.srj_ThreadCount;
+  const INDEX iLast = ctCommands * (iJob + 1) / jobs.srj_ThreadCount;
+
+  VkCommandBuffer cmd = svk.gl_VkSecondaryCmdBuffers[svk.gl_VkCmdBufferCurrent][iJob];
+  SvkBoundState &bs = jobs.srj_States[iJob];
+
+  VkCommandBufferInheritanceInfo inheritanceInfo = {};
+  inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+  inheritanceInfo.renderPass = svk.gl_VkRenderPass;
+  inheritanceInfo.subpass = 0;
+  inheritanceInfo.framebuffer = svk.gl_VkFramebuffers[svk.gl_VkCurrentImageIndex];
+
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+  beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+  VkResult r = vkBeginCommandBuffer(cmd, &beginInfo);
+  if (r != VK_SUCCESS)
+  {
+    jobs.srj_Results[iJob] = r;
+    return;
+  }
+
+  // dynamic state is not inherited, so set the viewport that was active before first command
+  for (INDEX iViewport = iFirst - 1; iViewport >= 0; iViewport--)
+  {
+    const SvkRenderCommand &rc = svk.gl_VkRenderCommands[iViewport];
+    if (rc.src_Type == SRC_VIEWPORT)
+    {
+      svk.RecordRenderCommand(cmd, rc, bs);
+      break;
+    }
+  }
+
+  for (INDEX i = iFirst; i < iLast; i++)
+  {
+    svk.RecordRenderCommand(cmd, svk.gl_VkRenderCommands[i], bs);
+  }
+
+  jobs.srj_Results[iJob] = vkEndCommandBuffer(cmd);
+}
+
+uint32_t SvkMain::RecordSecondaryCmdBuffers(uint32_t threadCount, bool countStats)
+{
+  const INDEX ctCommands = gl_VkRenderCommands.Count();
+  if (ctCommands == 0)
+  {
+    return 0;
+  }
+
+  SvkRecordJobs jobs;
+  jobs.srj_Main = this;
+  jobs.srj_ThreadCount = Min(threadCount, (uint32_t)ctCommands);
+
+  for (uint32_t i = 0; i < jobs.srj_ThreadCount; i++)
+  {
+    jobs.srj_States[i] = {};
+    InvalidateBoundState(jobs.srj_States[i]);
+    jobs.srj_Results[i] = VK_SUCCESS;
+  }
+
+  JobPool_Run(jobs.srj_ThreadCount, RecordCommandsJob, &jobs);
+
+  for (uint32_t i = 0; i < jobs.srj_ThreadCount; i++)
+  {
+    VK_CHECKERROR(jobs.srj_Results[i]);
+
+    if (countStats)
+    {
+      AddBoundStateCounters(jobs.srj_States[i]);
+    }
+  }
+
+  return jobs.srj_ThreadCount;
+}
+
+void SvkMain::RunRecordBenchmark()
+{
+  const INDEX ctCommands = gl_VkRenderCommands.Count();
+  const INDEX ctRepeats = 16;
+
+  CPrintF(TRANS("Recording %d Vulkan commands, %d job pool threads:\n"), ctCommands, JobPool_GetThreadCount());
+
+  // secondary cmd buffers of current frame are not submitted yet, so they can be recorded many times
+  for (uint32_t threadCount = 1; threadCount <= SVK_MAX_RECORD_THREADS; threadCount *= 2)
+  {
+    CTimerValue tvStart = _pTimer->GetHighPrecisionTimer();
+    for (INDEX i = 0; i < ctRepeats; i++)
+    {
+      RecordSecondaryCmdBuffers(threadCount, false);
+    }
+    CTimerValue tvEnd = _pTimer->GetHighPrecisionTimer();
+
+    const DOUBLE dMs = (tvEnd - tvStart).GetSeconds() * 1000.0 / ctRepeats;
+    CPrintF(TRANS("  %d threads: %.3f ms\n"), threadCount, dMs);
+  }
+}
+
+#endif
@@ -25,7 +25,7 @@ void SvkMain::CreateDescriptorSetLayouts()
   VkDescriptorSetLayoutBinding uniformBinding = {};
   uniformBinding.binding = 0;
   uniformBinding.descriptorCount = 1;
-  uniformBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+  uniformBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
   uniformBinding.pImmutableSamplers = nullptr;
   uniformBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
@@ -112,7 +112,7 @@ void SvkMain::CreateDescriptorPools()
 
   // one dynamic buffer per command buffer
   VkDescriptorPoolSize unPoolSize;
-  unPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+  unPoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
   unPoolSize.descriptorCount = gl_VkMaxCmdBufferCount;
 
   VkDescriptorPoolCreateInfo unDescPoolInfo = {};
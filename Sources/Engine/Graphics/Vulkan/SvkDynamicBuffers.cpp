@@ -71,7 +71,8 @@ void SvkMain::InitDynamicUniformBuffers(uint32_t newSize)
   SvkDynamicBuffer uniformDynBuffers[gl_VkMaxCmdBufferCount];
 
   gl_VkDynamicUBGlobal.sdg_CurrentDynamicBufferSize = newSize;
-  InitDynamicBuffer(gl_VkDynamicUBGlobal, uniformDynBuffers, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+  // matrices are read from storage buffer, so that each draw can index its own
+  InitDynamicBuffer(gl_VkDynamicUBGlobal, uniformDynBuffers, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
 
 #ifndef NDEBUG
   CPrintF("SVK: Allocated dynamic uniform buffer: %u KB.\n", gl_VkDynamicUBGlobal.sdg_CurrentDynamicBufferSize / 1024);
@@ -103,7 +104,7 @@ void SvkMain::InitDynamicUniformBuffers(uint32_t newSize)
     write.dstBinding = 0;
     write.dstArrayElement = 0;
     write.descriptorCount = 1;
-    write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
     write.pBufferInfo = &bufferInfo;
 
     vkUpdateDescriptorSets(gl_VkDevice, 1, &write, 0, nullptr);
@@ -248,8 +249,8 @@ void SvkMain::GetIndexBuffer(uint32_t size, SvkDynamicBuffer &outDynBuffer)
 
 void SvkMain::GetUniformBuffer(uint32_t size, SvkDynamicUniform &outDynUniform)
 {
-  // size must be aligned by min uniform offset alignment
-  uint32_t alignment = gl_VkPhProperties.limits.minUniformBufferOffsetAlignment;
+  // size must be aligned by min storage buffer offset alignment
+  uint32_t alignment = (uint32_t)gl_VkPhProperties.limits.minStorageBufferOffsetAlignment;
   uint32_t mod = size % alignment;
   uint32_t alignedSize = mod == 0 ? size : size + alignment - mod;
   
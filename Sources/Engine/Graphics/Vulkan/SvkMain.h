@@ -10,6 +10,7 @@
 
 #include <Engine/Base/Timer.h>
 #include <Engine/Base/CTString.h>
+#include <Engine/Base/FileName.h>
 #include <Engine/Base/Lists.h>
 #include <Engine/Math/Functions.h>
 #include <Engine/Graphics/Adapter.h>
@@ -104,6 +105,9 @@ public:
   SvkStaticHashTable<SvkTextureObject>    gl_VkTextures;
   uint32_t                                gl_VkLastTextureId;
   SvkMemoryPool                           *gl_VkImageMemPool;
+  SvkMemoryBackend                        *gl_VkImageMemBackend;
+  // textures uploaded in current frame; defragmentation waits for a frame without them
+  uint32_t                                gl_VkTexturesUploaded;
 
   VkDescriptorPool                        gl_VkTextureDescPools[gl_VkMaxCmdBufferCount];
 
@@ -120,6 +124,28 @@ public:
   SvkVertexLayout                         *gl_VkDefaultVertexLayout;
   VkPipeline                              gl_VkPipelineOcclusion;
 
+  // pipelines that are compiled in background for current level
+  CStaticStackArray<SvkPipelineState>     gl_VkPrewarmPipelines;
+  HANDLE                                  gl_VkPrewarmThread;
+  volatile LONG                           gl_VkPrewarmReady;
+  volatile LONG                           gl_VkPrewarmAbort;
+  INDEX                                   gl_VkPrewarmAdopted;
+
+  // pipeline states used in current level
+  CTFileName                              gl_VkLevelName;
+  uint32_t                                gl_VkLevelIndex;
+  CStaticStackArray<SvkPipelineStateFlags> gl_VkLevelFlags;
+  bool                                    gl_VkLevelRendered;
+  bool                                    gl_VkLevelFirstFrameDone;
+
+  // pipeline statistics
+  uint32_t                                gl_VkPipelineCacheLoaded;
+  uint32_t                                gl_VkPipelinesCompiled;
+  uint32_t                                gl_VkPipelinesPrewarmed;
+  uint32_t                                gl_VkLevelCompiled;
+  uint32_t                                gl_VkLevelPrewarmed;
+  uint32_t                                gl_VkLevelFirstFrameCompiled;
+
   VkPhysicalDevice                        gl_VkPhysDevice;
   VkPhysicalDeviceMemoryProperties        gl_VkPhMemoryProperties;
   VkPhysicalDeviceProperties              gl_VkPhProperties;
@@ -129,6 +155,8 @@ public:
   CStaticArray<VkPresentModeKHR>          gl_VkPhSurfPresentModes;
 
   CStaticArray<const char *>              gl_VkPhysDeviceExtensions;
+  PFN_vkGetPhysicalDeviceMemoryProperties2KHR gl_VkGetMemoryProperties2;
+  bool                                    gl_VkMemoryBudgetSupported;
   CStaticArray<const char *>              gl_VkLayers;
   VkSampleCountFlagBits                   gl_VkMaxSampleCount;
 
@@ -148,6 +176,43 @@ public:
 
   // current mesh
   CStaticStackArray<SvkVertex>    gl_VkVerts;
+  // where current mesh was uploaded; must be set to dirty if any of its arrays is changed
+  bool                            gl_VkVertsDirty;
+  VkBuffer                        gl_VkVertsBuffer;
+  VkDeviceSize                    gl_VkVertsOffset;
+
+  // draws waiting to be recorded
+  SvkDrawBatch                    gl_VkDrawBatch;
+
+  // last uploaded matrix and the window of uniform buffer it's in
+  FLOAT                           gl_VkLastMVP[16];
+  VkDescriptorSet                 gl_VkLastUniformSet;
+  uint32_t                        gl_VkLastUniformOffset;
+  FLOAT                           *gl_VkLastUniformData;
+  uint32_t                        gl_VkLastMatrixIndex;
+  bool                            gl_VkLastUniformValid;
+
+  // what is currently bound in primary cmd buffer
+  SvkBoundState                   gl_VkBoundState;
+
+  // if not 0, render pass is recorded at the end of frame
+  // into this number of secondary cmd buffers by job pool threads
+  uint32_t                        gl_VkRecordThreads;
+  CStaticStackArray<SvkRenderCommand> gl_VkRenderCommands;
+  VkCommandPool                   gl_VkSecondaryCmdPools[gl_VkMaxCmdBufferCount][SVK_MAX_RECORD_THREADS];
+  VkCommandBuffer                 gl_VkSecondaryCmdBuffers[gl_VkMaxCmdBufferCount][SVK_MAX_RECORD_THREADS];
+  bool                            gl_VkRecordBenchmark;
+
+  // CPU time between start and submit of frame, and bytes copied to dynamic buffers;
+  // averaged over gl_VkUploadStatsFrames frames when they are requested
+  CTimerValue                     gl_VkFrameStartTime;
+  SLONG                           gl_VkFrameBytesUploaded;
+  INDEX                           gl_VkUploadStatsFrames;
+  INDEX                           gl_VkUploadStatsCount;
+  DOUBLE                          gl_VkUploadStatsSeconds;
+  DOUBLE                          gl_VkUploadStatsMaxSeconds;
+  __int64                         gl_VkUploadStatsBytes;
+  SLONG                           gl_VkUploadStatsMaxBytes;
 
 public:
   SvkMain();
@@ -188,9 +253,28 @@ public:
   // create new pipeline and add it to list
   SvkPipelineState &CreatePipeline(SvkPipelineStateFlags flags, const SvkVertexLayout &vertLayout,
     VkShaderModule vertShader, VkShaderModule fragShader);
+  // create pipeline object only, can be called from any thread
+  VkPipeline CompilePipeline(SvkPipelineStateFlags flags, const SvkVertexLayout &vertLayout,
+    VkShaderModule vertShader, VkShaderModule fragShader);
+  VkShaderModule GetFragmentShader(SvkPipelineStateFlags flags);
+  // pipeline cache is loaded from disk if it was saved with same device and driver
   void CreatePipelineCache();
+  void SavePipelineCache();
   void DestroyPipelines();
 
+  // save states used in previous level and start compiling states that new level used last time
+  void StartLevelPipelines(const CTFileName &fnmLevel);
+  void SaveLevelPipelines();
+  // executed by background thread
+  void PrewarmPipelines();
+  // move compiled background pipelines to list
+  void AdoptPrewarmedPipelines();
+  void StopPrewarming();
+  void EndLevelFrame();
+  void PrintPipelineStats();
+  // measure CPU frame time and uploaded bytes during next frames
+  void StartUploadStats(INDEX ctFrames);
+
   void CreateOcclusionPipeline();
 
   BOOL CreateSwapchainColor(uint32_t width, uint32_t height, uint32_t imageIndex, VkSampleCountFlagBits sampleCount);
@@ -229,6 +313,10 @@ public:
 
   VkDescriptorSet GetTextureDescriptor(uint32_t textureId);
   void FreeDeletedTextures(uint32_t cmdBufferIndex);
+  // record moves of up to given count of textures to less fragmented memory,
+  // must be called before render pass begins
+  void DefragmentTextures(VkCommandBuffer cmd, INDEX ctMaxMoves);
+  void PrintTextureMemoryInfo();
   static void DestroyTextureObject(SvkTextureObject &sto);
 
   void InitOcclusionQuerying();
@@ -265,9 +353,26 @@ public:
 
   void UpdateViewportDepth(float minDepth, float maxDepth);
 
-  // Get current started cmd buffer to write in
-  VkCommandBuffer GetCurrentCmdBuffer();
+  // draw current mesh; it may be merged with previous draws that have the same state
   void DrawTriangles(uint32_t indexCount, const uint32_t *indices);
+  // record pending draws into cmd buffer
+  void FlushDrawBatch();
+  // forget what is bound in primary cmd buffer
+  void ResetBoundState();
+  static void InvalidateBoundState(SvkBoundState &bs);
+  void AddBoundStateCounters(SvkBoundState &bs);
+
+  // record command into current cmd buffer or keep it for secondary cmd buffers;
+  // pending draws must be flushed before any other command
+  void AddRenderCommand(const SvkRenderCommand &rc);
+  // record one command; can be called from any thread that has its own cmd buffer and bound state
+  void RecordRenderCommand(VkCommandBuffer cmd, const SvkRenderCommand &rc, SvkBoundState &bs);
+  // record kept commands into secondary cmd buffers and return how many of them were used
+  uint32_t RecordSecondaryCmdBuffers(uint32_t threadCount, bool countStats);
+  // time recording of current frame with different thread counts
+  void RunRecordBenchmark();
+  // add current frame to upload stats and print them when enough frames were measured
+  void AddUploadStats();
 
 
   void SetTexture(uint32_t textureUnit, uint32_t textureId, SvkSamplerFlags samplerFlags);
@@ -275,14 +380,16 @@ public:
   uint32_t CreateTexture();
   // create texture handler with specified ID
   uint32_t CreateTexture(uint32_t textureId);
-  // init texture; if onlyUpdate is true, texture will not be allocated
-  void InitTexture32Bit(
+  // init texture; if onlyUpdate is true, texture will not be allocated;
+  // texture data must be 32-bit RGBA or BC blocks, according to format
+  void InitTexture(
     uint32_t &textureId, VkFormat format, void *textureData,
     VkExtent2D *mipLevels, uint32_t mipLevelsCount, bool onlyUpdate);
   // delete texture
   void AddTextureToDeletion(uint32_t textureId);
   // for statistics
   uint32_t GetTexturePixCount(uint32_t textureId);
+  VkFormat GetTextureFormat(uint32_t textureId);
 
 
   void ClearColor(int32_t x, int32_t y, uint32_t width, uint32_t height, float *rgba);
@@ -1,437 +1,1109 @@
 #include "StdH.h"
 #include "SvkMemoryPool.h"
+#include <Engine/Base/Stream.h>
+#include <Engine/Base/Console.h>
 
-SvkMemoryPool::SvkMemoryPool(VkDevice device, uint32_t preferredSize)
-{
-  smp_VkDevice = device;
-  smp_PreferredSize = preferredSize;
+#ifdef SE1_VULKAN
 
-  smp_BlockCount = 0;
-  smp_BlockSize = 0;
-  smp_VkMemory = VK_NULL_HANDLE;
-  smp_pNext = nullptr;
-  smp_FreeListHeadIndex = 0;
-  smp_AllocationCount = 0;
-  smp_VkMemoryTypeIndex = 0;
-  smp_HandleLastIndex = 0;
-  smp_NodeLastIndex = 0;
-}
+// all offsets and sizes are multiples of this
+#define SVK_MEMORY_GRANULARITY    256
 
-SvkMemoryPool::~SvkMemoryPool()
+static inline VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
 {
-  ASSERT(smp_VkDevice != VK_NULL_HANDLE);
+  return (value + alignment - 1) / alignment * alignment;
+}
 
-  if (smp_VkMemory != VK_NULL_HANDLE)
+static inline uint32_t GetLog2(VkDeviceSize value)
+{
+  uint32_t log2 = 0;
+  while (value >>= 1)
   {
-    vkFreeMemory(smp_VkDevice, smp_VkMemory, nullptr);
+    log2++;
   }
+  return log2;
+}
 
-  if (smp_pNext != nullptr)
+static inline uint32_t GetLowestBit(uint32_t mask)
+{
+  ASSERT(mask != 0);
+
+  uint32_t bit = 0;
+  while ((mask & 1) == 0)
   {
-    delete smp_pNext;
+    mask >>= 1;
+    bit++;
   }
+  return bit;
+}
+
+
+SvkDeviceMemoryBackend::SvkDeviceMemoryBackend(VkDevice device, VkPhysicalDevice physDevice,
+  PFN_vkGetPhysicalDeviceMemoryProperties2KHR pGetMemoryProperties2)
+{
+  smb_VkDevice = device;
+  smb_VkPhysDevice = physDevice;
+  smb_pGetMemoryProperties2 = pGetMemoryProperties2;
 
-  smp_Nodes.Clear();
-  smp_Handles.Clear();
+  vkGetPhysicalDeviceMemoryProperties(physDevice, &smb_VkMemoryProperties);
+}
+
+bool SvkDeviceMemoryBackend::AllocateChunk(uint32_t memoryTypeIndex, VkDeviceSize size, VkDeviceMemory &outMemory)
+{
+  VkMemoryAllocateInfo allocInfo = {};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = size;
+  allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+  VkResult r = vkAllocateMemory(smb_VkDevice, &allocInfo, nullptr, &outMemory);
+  return r == VK_SUCCESS;
+}
 
-  smp_PreferredSize = 0;
-  smp_FreeListHeadIndex = 0;
-  smp_BlockCount = 0;
-  smp_BlockSize = 0;
-  smp_AllocationCount = 0;
-  smp_VkMemoryTypeIndex = 0;
-  smp_HandleLastIndex = 0;
-  smp_NodeLastIndex = 0;
+void SvkDeviceMemoryBackend::FreeChunk(uint32_t memoryTypeIndex, VkDeviceSize size, VkDeviceMemory memory)
+{
+  vkFreeMemory(smb_VkDevice, memory, nullptr);
 }
 
-void SvkMemoryPool::Init(uint32_t memoryTypeIndex, uint32_t alignment)
+VkDeviceSize SvkDeviceMemoryBackend::GetBudget(uint32_t memoryTypeIndex)
 {
-  ASSERT(smp_VkMemory == VK_NULL_HANDLE);
+  if (smb_pGetMemoryProperties2 == nullptr)
+  {
+    return 0;
+  }
 
-  smp_BlockSize = alignment;
-  smp_BlockCount = smp_PreferredSize / alignment + 1;
+  VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProps = {};
+  budgetProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
 
-  smp_VkMemoryTypeIndex = memoryTypeIndex;
+  VkPhysicalDeviceMemoryProperties2KHR memProps = {};
+  memProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR;
+  memProps.pNext = &budgetProps;
 
-  VkMemoryAllocateInfo allocInfo = {};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = smp_BlockCount * smp_BlockSize;
-  allocInfo.memoryTypeIndex = smp_VkMemoryTypeIndex;
+  smb_pGetMemoryProperties2(smb_VkPhysDevice, &memProps);
 
-  VkResult r = vkAllocateMemory(smp_VkDevice, &allocInfo, nullptr, &smp_VkMemory);
-  ASSERT(r == VK_SUCCESS);
+  uint32_t heapIndex = smb_VkMemoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+  VkDeviceSize budget = budgetProps.heapBudget[heapIndex];
+  VkDeviceSize usage = budgetProps.heapUsage[heapIndex];
+
+  // 0 would mean unknown
+  return budget > usage ? budget - usage : 1;
+}
 
-  // allocate max node amount which is the same as block count
-  smp_Nodes.New(smp_BlockCount);
 
-  smp_FreeListHeadIndex = AddNode();
-  smp_Nodes[smp_FreeListHeadIndex].blockCount = smp_BlockCount;
-  smp_Nodes[smp_FreeListHeadIndex].blockIndex = 0;
-  smp_Nodes[smp_FreeListHeadIndex].nextNodeIndex = -1;
+SvkMockMemoryBackend::SvkMockMemoryBackend(VkDeviceSize capacity)
+{
+  smm_Capacity = capacity;
+  smm_Allocated = 0;
+  smm_PeakAllocated = 0;
+  smm_ChunkCount = 0;
 }
 
-int32_t SvkMemoryPool::AddNode()
+bool SvkMockMemoryBackend::AllocateChunk(uint32_t memoryTypeIndex, VkDeviceSize size, VkDeviceMemory &outMemory)
 {
-  if (smp_RemovedIndices.Count() > 0)
+  if (smm_Allocated + size > smm_Capacity)
   {
-    return smp_RemovedIndices.Pop();
+    return false;
   }
 
-  // smp_Nodes count is the same as smp_BlockCount
-  ASSERT(smp_NodeLastIndex + 1 < smp_Nodes.Count());
+  smm_Allocated += size;
+  smm_PeakAllocated = Max(smm_PeakAllocated, smm_Allocated);
+  smm_ChunkCount++;
 
-  return smp_NodeLastIndex++;
+  // pool doesn't use the handle
+  outMemory = VK_NULL_HANDLE;
+  return true;
 }
 
-void SvkMemoryPool::RemoveNode(int32_t removed)
+void SvkMockMemoryBackend::FreeChunk(uint32_t memoryTypeIndex, VkDeviceSize size, VkDeviceMemory memory)
 {
-  smp_RemovedIndices.Push() = removed;
+  ASSERT(smm_Allocated >= size && smm_ChunkCount > 0);
+
+  smm_Allocated -= size;
+  smm_ChunkCount--;
 }
 
-uint32_t SvkMemoryPool::Allocate(VkMemoryAllocateInfo allocInfo, VkMemoryRequirements memReqs, VkDeviceMemory &outMemory, uint32_t &outOffset)
+VkDeviceSize SvkMockMemoryBackend::GetBudget(uint32_t memoryTypeIndex)
+{
+  return smm_Capacity > smm_Allocated ? smm_Capacity - smm_Allocated : 1;
+}
+
+
+SvkMemoryPool::SvkMemoryPool(SvkMemoryBackend *pBackend, VkDeviceSize chunkSize)
 {
-  smp_AllocationCount++;
+  ASSERT(pBackend != nullptr);
 
-  ASSERT(allocInfo.sType == VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO);
-  ASSERT(allocInfo.allocationSize > 0);
-  ASSERT(allocInfo.allocationSize % memReqs.alignment == 0);
+  smp_pBackend = pBackend;
+  smp_ChunkSize = AlignUp(chunkSize, SVK_MEMORY_GRANULARITY);
+  smp_pTrace = nullptr;
+
+  smp_Blocks.SetAllocationStep(1024);
+  smp_RemovedBlocks.SetAllocationStep(1024);
+  smp_Chunks.SetAllocationStep(16);
 
-  if (smp_VkMemory == VK_NULL_HANDLE)
+  for (uint32_t t = 0; t < MAX_MEMORY_TYPES; t++)
+  {
+    SizeClasses &sc = smp_Classes[t];
+    sc.flBitmap = 0;
+
+    for (uint32_t fl = 0; fl < FL_COUNT; fl++)
+    {
+      sc.slBitmaps[fl] = 0;
+
+      for (uint32_t sl = 0; sl < SL_COUNT; sl++)
+      {
+        sc.heads[fl][sl] = -1;
+      }
+    }
+  }
+}
+
+SvkMemoryPool::~SvkMemoryPool()
+{
+  for (INDEX i = 0; i < smp_Chunks.Count(); i++)
   {
-    Init(allocInfo.memoryTypeIndex, memReqs.alignment);
+    Chunk &chunk = smp_Chunks[i];
+
+    if (chunk.firstBlock != -1)
+    {
+      smp_pBackend->FreeChunk(chunk.memoryTypeIndex, chunk.size, chunk.memory);
+      chunk.firstBlock = -1;
+    }
   }
 
-  ASSERT(smp_BlockSize > memReqs.alignment ?
-    smp_BlockSize % memReqs.alignment == 0 :
-    memReqs.alignment % smp_BlockSize == 0);
+  smp_Blocks.Clear();
+  smp_RemovedBlocks.Clear();
+  smp_Chunks.Clear();
+}
 
-  // align size
-  uint32_t allocSize = allocInfo.allocationSize;
-  uint32_t alignmentBlockCount = 0;
-  const uint32_t plAlgn = smp_BlockSize;
-  const uint32_t rqAlgn = memReqs.alignment;
+void SvkMemoryPool::GetSizeClass(VkDeviceSize size, uint32_t &fl, uint32_t &sl)
+{
+  ASSERT(size > 0);
 
-  if (plAlgn >= rqAlgn)
+  if (size < (1 << SMALL_LOG2))
   {
-    ASSERT(plAlgn % rqAlgn == 0);
+    fl = 0;
+    sl = (uint32_t)(size / ((1 << SMALL_LOG2) / SL_COUNT));
   }
   else
   {
-    ASSERT(rqAlgn % plAlgn == 0);
-    alignmentBlockCount = rqAlgn / plAlgn;
+    uint32_t log2 = GetLog2(size);
+    sl = (uint32_t)(size >> (log2 - SL_LOG2)) ^ (1 << SL_LOG2);
+    fl = Min(log2 - SMALL_LOG2 + 1, (uint32_t)FL_COUNT - 1);
+  }
+}
+
+int32_t SvkMemoryPool::AddBlock()
+{
+  if (smp_RemovedBlocks.Count() > 0)
+  {
+    return smp_RemovedBlocks.Pop();
   }
 
-  // make sure that memory types are same
-  ASSERTMSG(smp_VkMemoryTypeIndex == allocInfo.memoryTypeIndex, "Create new SvkMemoryPool with another memory type index");
-  // check sizes
-  ASSERT(smp_BlockCount * smp_BlockSize >= allocSize);
+  smp_Blocks.Push();
+  return smp_Blocks.Count() - 1;
+}
+
+void SvkMemoryPool::RemoveBlock(int32_t index)
+{
+  smp_Blocks[index].size = 0;
+  smp_Blocks[index].isFree = false;
+  smp_RemovedBlocks.Push() = index;
+}
+
+void SvkMemoryPool::InsertFree(int32_t index)
+{
+  Block &block = smp_Blocks[index];
+  SizeClasses &sc = smp_Classes[smp_Chunks[block.chunk].memoryTypeIndex];
 
-  uint32_t reqBlockCount = allocSize / smp_BlockSize + (allocSize % smp_BlockSize > 0 ? 1 : 0);
+  uint32_t fl, sl;
+  GetSizeClass(block.size, fl, sl);
 
-  int32_t prevNode = -1;
-  int32_t curNode = smp_FreeListHeadIndex;
+  block.isFree = true;
+  block.prevFree = -1;
+  block.nextFree = sc.heads[fl][sl];
 
-  while (curNode != -1)
+  if (block.nextFree != -1)
   {
-    // find first suitable
-    if (smp_Nodes[curNode].blockCount >= reqBlockCount)
-    {
-      if (alignmentBlockCount > 0)
-      {
-        uint32_t nextAlignment = smp_Nodes[curNode].blockIndex / alignmentBlockCount
-          + (smp_Nodes[curNode].blockIndex % alignmentBlockCount > 0 ? 1 : 0);
+    smp_Blocks[block.nextFree].prevFree = index;
+  }
 
-        nextAlignment *= alignmentBlockCount;
-        uint32_t blocksToAlign = nextAlignment - smp_Nodes[curNode].blockIndex;
+  sc.heads[fl][sl] = index;
+  sc.flBitmap |= 1 << fl;
+  sc.slBitmaps[fl] |= 1 << sl;
+}
 
-        if (blocksToAlign > 0)
-        {
-          uint32_t alignedBlockCount = smp_Nodes[curNode].blockCount - blocksToAlign;
+void SvkMemoryPool::RemoveFree(int32_t index)
+{
+  Block &block = smp_Blocks[index];
+  SizeClasses &sc = smp_Classes[smp_Chunks[block.chunk].memoryTypeIndex];
 
-          if (alignedBlockCount >= reqBlockCount)
-          {
-            // if aligned is suitable, then add new node after cur
-            int32_t alignedNode = AddNode();
-            smp_Nodes[alignedNode].blockIndex = nextAlignment;
-            smp_Nodes[alignedNode].blockCount = alignedBlockCount;
-            smp_Nodes[alignedNode].nextNodeIndex = smp_Nodes[curNode].nextNodeIndex;
+  ASSERT(block.isFree);
 
-            smp_Nodes[curNode].nextNodeIndex = alignedNode;
-            smp_Nodes[curNode].blockCount = blocksToAlign;
+  uint32_t fl, sl;
+  GetSizeClass(block.size, fl, sl);
 
-            prevNode = curNode;
-            curNode = alignedNode;
-          }
-          else
-          {
-            prevNode = curNode;
-            curNode = smp_Nodes[curNode].nextNodeIndex;
+  if (block.prevFree != -1)
+  {
+    smp_Blocks[block.prevFree].nextFree = block.nextFree;
+  }
+  else
+  {
+    ASSERT(sc.heads[fl][sl] == index);
+    sc.heads[fl][sl] = block.nextFree;
+  }
 
-            continue;
-          }
-        }
-      }
+  if (block.nextFree != -1)
+  {
+    smp_Blocks[block.nextFree].prevFree = block.prevFree;
+  }
+
+  if (sc.heads[fl][sl] == -1)
+  {
+    sc.slBitmaps[fl] &= ~(1 << sl);
+    if (sc.slBitmaps[fl] == 0)
+    {
+      sc.flBitmap &= ~(1 << fl);
+    }
+  }
+
+  block.isFree = false;
+  block.prevFree = block.nextFree = -1;
+}
 
-      uint32_t diff = smp_Nodes[curNode].blockCount - reqBlockCount;
+int32_t SvkMemoryPool::FindFree(uint32_t memoryTypeIndex, VkDeviceSize size, int32_t excludedChunk)
+{
+  SizeClasses &sc = smp_Classes[memoryTypeIndex];
+
+  // round up to next class, so any block in found list is big enough
+  if (size >= (1 << SMALL_LOG2))
+  {
+    size += ((VkDeviceSize)1 << (GetLog2(size) - SL_LOG2)) - 1;
+  }
 
-      AllocHandle &handle = smp_Handles.Push();
-      handle.id = smp_HandleLastIndex++;
-      handle.blockIndex = smp_Nodes[curNode].blockIndex;
-      handle.blockCount = reqBlockCount;
+  uint32_t fl, sl;
+  GetSizeClass(size, fl, sl);
 
-      outMemory = smp_VkMemory;
-      outOffset = smp_Nodes[curNode].blockIndex * smp_BlockSize;
+  while (fl < FL_COUNT)
+  {
+    uint32_t slMap = sc.slBitmaps[fl] & (sl < SL_COUNT ? ~0U << sl : 0);
 
-      if (diff != 0)
+    if (slMap == 0)
+    {
+      uint32_t flMap = fl + 1 < FL_COUNT ? sc.flBitmap & (~0U << (fl + 1)) : 0;
+      if (flMap == 0)
       {
-        // shift and reduce node's size
-        smp_Nodes[curNode].blockIndex += reqBlockCount;
-        smp_Nodes[curNode].blockCount -= reqBlockCount;
+        return -1;
       }
-      // if can merge next free range with previous one
-      else
-      {
-        if (prevNode == -1 && smp_Nodes[curNode].nextNodeIndex == -1)
-        {
-          // if only head, destroy it
-          ASSERT(curNode == smp_FreeListHeadIndex);
-          smp_FreeListHeadIndex = -1;
-        }
-        else if (prevNode != -1 && smp_Nodes[curNode].nextNodeIndex == -1)
-        {
-          // if there is prev, but not next
-          smp_Nodes[prevNode].nextNodeIndex = -1;
-        }
-        else if (prevNode == -1 && smp_Nodes[curNode].nextNodeIndex != -1)
-        {
-          // if there is next, but not prev; then it's head
-          ASSERT(curNode == smp_FreeListHeadIndex);
-          smp_FreeListHeadIndex = smp_Nodes[curNode].nextNodeIndex;
-        }
-        else
-        {
-          // if there are prev and next, skip current
-          smp_Nodes[prevNode].nextNodeIndex = smp_Nodes[curNode].nextNodeIndex;
-        }
 
-        RemoveNode(curNode);
+      fl = GetLowestBit(flMap);
+      slMap = sc.slBitmaps[fl];
+    }
+
+    sl = GetLowestBit(slMap);
+
+    for (int32_t i = sc.heads[fl][sl]; i != -1; i = smp_Blocks[i].nextFree)
+    {
+      // last class also has blocks that are smaller than rounded size
+      if ((int32_t)smp_Blocks[i].chunk != excludedChunk && smp_Blocks[i].size >= size)
+      {
+        return i;
       }
+    }
 
-      return handle.id;
+    // continue with next class
+    sl++;
+    if (sl == SL_COUNT)
+    {
+      sl = 0;
+      fl++;
     }
+  }
+
+  return -1;
+}
+
+bool SvkMemoryPool::AddChunk(uint32_t memoryTypeIndex, VkDeviceSize minSize)
+{
+  VkDeviceSize chunkSize = Max(smp_ChunkSize, minSize);
+
+  // don't take more than the heap can give, if it's known
+  VkDeviceSize budget = smp_pBackend->GetBudget(memoryTypeIndex);
+  if (budget != 0 && chunkSize > budget)
+  {
+    chunkSize = minSize;
+  }
 
-    prevNode = curNode;
-    curNode = smp_Nodes[curNode].nextNodeIndex;
+  VkDeviceMemory memory;
+  if (!smp_pBackend->AllocateChunk(memoryTypeIndex, chunkSize, memory))
+  {
+    if (chunkSize == minSize || !smp_pBackend->AllocateChunk(memoryTypeIndex, minSize, memory))
+    {
+      return false;
+    }
+    chunkSize = minSize;
   }
 
-  ASSERTALWAYS("Increase SvkMemoryPool block count or block size");
+  // reuse released chunk slot
+  uint32_t chunkIndex = smp_Chunks.Count();
+  for (INDEX i = 0; i < smp_Chunks.Count(); i++)
+  {
+    if (smp_Chunks[i].firstBlock == -1)
+    {
+      chunkIndex = i;
+      break;
+    }
+  }
 
-  // TODO: memory pool chain
-  // if free list is empty or none is found, create new and slightly bigger
-  //smp_pNext = new SvkMemoryPool(smp_VkDevice, smp_BlockSize, (uint32_t)(smp_BlockCount * 1.25f));
-  //?allocInfo.allocationSize = allocSize;
-  //return smp_pNext->Allocate(allocInfo, outMemory, outOffset);
+  if (chunkIndex == smp_Chunks.Count())
+  {
+    smp_Chunks.Push();
+  }
 
-  return 0;
+  int32_t blockIndex = AddBlock();
+
+  Chunk &chunk = smp_Chunks[chunkIndex];
+  chunk.memory = memory;
+  chunk.memoryTypeIndex = memoryTypeIndex;
+  chunk.size = chunkSize;
+  chunk.used = 0;
+  chunk.allocationCount = 0;
+  chunk.firstBlock = blockIndex;
+
+  Block &block = smp_Blocks[blockIndex];
+  block.offset = 0;
+  block.size = chunkSize;
+  block.alignment = 0;
+  block.chunk = chunkIndex;
+  block.prevPhys = block.nextPhys = -1;
+  block.userData = 0;
+  block.isMoving = false;
+
+  InsertFree(blockIndex);
+  return true;
 }
 
-#ifndef NDEBUG
-struct DebugFreeListNode
+void SvkMemoryPool::ReleaseChunk(uint32_t chunkIndex)
 {
-  int32_t       nextNodeIndex;
-  uint32_t      blockIndex;
-  uint32_t      blockCount;
-};
+  Chunk &chunk = smp_Chunks[chunkIndex];
 
-void CheckConsistency(int32_t smp_FreeListHeadIndex, void *psmp_Nodes)
+  ASSERT(chunk.allocationCount == 0 && chunk.firstBlock != -1);
+  ASSERT(smp_Blocks[chunk.firstBlock].isFree && smp_Blocks[chunk.firstBlock].size == chunk.size);
+
+  RemoveFree(chunk.firstBlock);
+  RemoveBlock(chunk.firstBlock);
+
+  smp_pBackend->FreeChunk(chunk.memoryTypeIndex, chunk.size, chunk.memory);
+
+  chunk.memory = VK_NULL_HANDLE;
+  chunk.size = 0;
+  chunk.firstBlock = -1;
+}
+
+uint32_t SvkMemoryPool::AllocateBlock(uint32_t memoryTypeIndex, VkDeviceSize size, VkDeviceSize alignment, int32_t excludedChunk)
 {
-  CStaticArray<DebugFreeListNode> &smp_Nodes = *((CStaticArray<DebugFreeListNode>*)psmp_Nodes);
+  ASSERT(memoryTypeIndex < MAX_MEMORY_TYPES);
+
+  size = AlignUp(Max(size, (VkDeviceSize)1), SVK_MEMORY_GRANULARITY);
+  alignment = Max(alignment, (VkDeviceSize)SVK_MEMORY_GRANULARITY);
+
+  // enough for any placement of aligned allocation
+  const VkDeviceSize searchSize = size + alignment - SVK_MEMORY_GRANULARITY;
+
+  int32_t found = FindFree(memoryTypeIndex, searchSize, excludedChunk);
+  if (found == -1)
+  {
+    if (!AddChunk(memoryTypeIndex, AlignUp(searchSize, SVK_MEMORY_GRANULARITY)))
+    {
+      return SVK_MEMORY_INVALID_HANDLE;
+    }
+
+    found = FindFree(memoryTypeIndex, searchSize, excludedChunk);
+    ASSERT(found != -1);
+  }
+
+  RemoveFree(found);
+
+  // split front part, if offset isn't aligned; lower block keeps its index
+  VkDeviceSize padding = AlignUp(smp_Blocks[found].offset, alignment) - smp_Blocks[found].offset;
+  if (padding > 0)
+  {
+    int32_t aligned = AddBlock();
+    Block &front = smp_Blocks[found];
+    Block &block = smp_Blocks[aligned];
+
+    block.offset = front.offset + padding;
+    block.size = front.size - padding;
+    block.chunk = front.chunk;
+    block.prevPhys = found;
+    block.nextPhys = front.nextPhys;
+    block.isFree = false;
+
+    if (front.nextPhys != -1)
+    {
+      smp_Blocks[front.nextPhys].prevPhys = aligned;
+    }
 
-  int32_t prevNodeD = -1;
-  int32_t curNodeD = smp_FreeListHeadIndex;
-  while (curNodeD != -1)
+    front.nextPhys = aligned;
+    front.size = padding;
+    InsertFree(found);
+
+    found = aligned;
+  }
+
+  // split back part, if it's left
+  if (smp_Blocks[found].size > size)
   {
-    ASSERT(smp_Nodes[curNodeD].blockCount != 0);
-    if (prevNodeD != -1)
+    int32_t rest = AddBlock();
+    Block &block = smp_Blocks[found];
+    Block &back = smp_Blocks[rest];
+
+    back.offset = block.offset + size;
+    back.size = block.size - size;
+    back.chunk = block.chunk;
+    back.prevPhys = found;
+    back.nextPhys = block.nextPhys;
+    back.userData = 0;
+    back.isMoving = false;
+
+    if (block.nextPhys != -1)
     {
-      ASSERT(smp_Nodes[prevNodeD].blockIndex + smp_Nodes[prevNodeD].blockCount <= smp_Nodes[curNodeD].blockIndex);
+      smp_Blocks[block.nextPhys].prevPhys = rest;
     }
 
-    prevNodeD = curNodeD;
-    curNodeD = smp_Nodes[curNodeD].nextNodeIndex;
+    block.nextPhys = rest;
+    block.size = size;
+    InsertFree(rest);
+  }
+
+  Block &block = smp_Blocks[found];
+  block.alignment = alignment;
+  block.userData = 0;
+  block.isFree = false;
+  block.isMoving = false;
+
+  Chunk &chunk = smp_Chunks[block.chunk];
+  chunk.used += block.size;
+  chunk.allocationCount++;
+
+  return (uint32_t)found;
+}
+
+uint32_t SvkMemoryPool::Allocate(VkMemoryAllocateInfo allocInfo, VkMemoryRequirements memReqs, VkDeviceMemory &outMemory, uint32_t &outOffset)
+{
+  ASSERT(allocInfo.sType == VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO);
+  ASSERT(allocInfo.allocationSize > 0);
+
+  uint32_t handle = AllocateBlock(allocInfo.memoryTypeIndex, allocInfo.allocationSize, memReqs.alignment, -1);
+  if (handle == SVK_MEMORY_INVALID_HANDLE)
+  {
+    outMemory = VK_NULL_HANDLE;
+    outOffset = 0;
+    return handle;
   }
+
+  const Block &block = smp_Blocks[handle];
+  outMemory = smp_Chunks[block.chunk].memory;
+  outOffset = (uint32_t)block.offset;
+
+  WriteTrace("A %u %u %u %u\n", handle, allocInfo.memoryTypeIndex,
+    (uint32_t)allocInfo.allocationSize, (uint32_t)memReqs.alignment);
+
+  return handle;
 }
-#endif // !NDEBUG
 
 void SvkMemoryPool::Free(uint32_t handle)
 {
-  smp_AllocationCount--;
+  ASSERT(handle < (uint32_t)smp_Blocks.Count());
 
-  bool found = false;
-  uint32_t blockIndex, blockCount;
+  WriteTrace("F %u\n", handle);
 
-  for (INDEX i = 0; i < smp_Handles.Count(); i++)
+  int32_t index = (int32_t)handle;
+  Block &block = smp_Blocks[index];
+
+  ASSERT(!block.isFree && block.size > 0);
+
+  uint32_t chunkIndex = block.chunk;
+  Chunk &chunk = smp_Chunks[chunkIndex];
+  chunk.used -= block.size;
+  chunk.allocationCount--;
+
+  // merge with next
+  int32_t next = block.nextPhys;
+  if (next != -1 && smp_Blocks[next].isFree)
   {
-    if (smp_Handles[i].id == handle)
+    RemoveFree(next);
+
+    block.size += smp_Blocks[next].size;
+    block.nextPhys = smp_Blocks[next].nextPhys;
+    if (block.nextPhys != -1)
     {
-      blockIndex = smp_Handles[i].blockIndex;
-      blockCount = smp_Handles[i].blockCount;
+      smp_Blocks[block.nextPhys].prevPhys = index;
+    }
+
+    RemoveBlock(next);
+  }
 
-      // remove handle: just replace this with last and pop to remove duplicate
-      smp_Handles[i] = smp_Handles[smp_Handles.Count() - 1];
-      smp_Handles.Pop();
+  // merge with previous; lower block keeps its index
+  int32_t prev = block.prevPhys;
+  if (prev != -1 && smp_Blocks[prev].isFree)
+  {
+    RemoveFree(prev);
 
-      found = true;
-      break;
+    Block &prevBlock = smp_Blocks[prev];
+    prevBlock.size += block.size;
+    prevBlock.nextPhys = block.nextPhys;
+    if (prevBlock.nextPhys != -1)
+    {
+      smp_Blocks[prevBlock.nextPhys].prevPhys = prev;
     }
+
+    RemoveBlock(index);
+    index = prev;
   }
 
-  ASSERT(found);
+  smp_Blocks[index].isMoving = false;
+  InsertFree(index);
 
-  // if there is no head, then just create it
-  if (smp_FreeListHeadIndex == -1)
+  // release empty chunk, but keep at least one for each memory type
+  if (chunk.allocationCount == 0)
   {
-    smp_FreeListHeadIndex = AddNode();
-    smp_Nodes[smp_FreeListHeadIndex].blockCount = blockCount;
-    smp_Nodes[smp_FreeListHeadIndex].blockIndex = blockIndex;
-    smp_Nodes[smp_FreeListHeadIndex].nextNodeIndex = -1;
+    for (INDEX i = 0; i < smp_Chunks.Count(); i++)
+    {
+      if (i != chunkIndex && smp_Chunks[i].firstBlock != -1 && smp_Chunks[i].memoryTypeIndex == chunk.memoryTypeIndex)
+      {
+        ReleaseChunk(chunkIndex);
+        break;
+      }
+    }
+  }
+}
+
+void SvkMemoryPool::SetUserData(uint32_t handle, uint32_t userData)
+{
+  ASSERT(handle < (uint32_t)smp_Blocks.Count() && !smp_Blocks[handle].isFree);
+  smp_Blocks[handle].userData = userData;
+}
 
-#ifndef NDEBUG
-    CheckConsistency(smp_FreeListHeadIndex, &smp_Nodes);
-#endif // !NDEBUG
+uint32_t SvkMemoryPool::GetUserData(uint32_t handle)
+{
+  ASSERT(handle < (uint32_t)smp_Blocks.Count() && !smp_Blocks[handle].isFree);
+  return smp_Blocks[handle].userData;
+}
 
-    return;
+uint32_t SvkMemoryPool::FindMoveCandidate(uint32_t prevCandidate)
+{
+  if (prevCandidate != SVK_MEMORY_INVALID_HANDLE)
+  {
+    ASSERT(prevCandidate < (uint32_t)smp_Blocks.Count() && !smp_Blocks[prevCandidate].isFree);
+
+    for (int32_t i = smp_Blocks[prevCandidate].nextPhys; i != -1; i = smp_Blocks[i].nextPhys)
+    {
+      if (!smp_Blocks[i].isFree && !smp_Blocks[i].isMoving)
+      {
+        return (uint32_t)i;
+      }
+    }
+
+    return SVK_MEMORY_INVALID_HANDLE;
   }
 
-  // find node that has block index less than given
-  int32_t prevNode = -1;
-  int32_t curNode = smp_FreeListHeadIndex;
+  // find the least used chunk that can be emptied into other chunks of its memory type
+  int32_t bestChunk = -1;
+  float bestUsage = 0.5f;
 
-  while (curNode != -1)
+  for (INDEX i = 0; i < smp_Chunks.Count(); i++)
   {
-    // don't free already freed
-    ASSERT(smp_Nodes[curNode].blockIndex != blockIndex);
+    const Chunk &chunk = smp_Chunks[i];
+    if (chunk.firstBlock == -1 || chunk.allocationCount == 0)
+    {
+      continue;
+    }
 
-    if (smp_Nodes[curNode].blockIndex > blockIndex)
+    float usage = (float)chunk.used / chunk.size;
+    if (usage >= bestUsage)
     {
-      break;
+      continue;
+    }
+
+    VkDeviceSize freeElsewhere = 0;
+    for (INDEX j = 0; j < smp_Chunks.Count(); j++)
+    {
+      const Chunk &other = smp_Chunks[j];
+      if (j != i && other.firstBlock != -1 && other.memoryTypeIndex == chunk.memoryTypeIndex)
+      {
+        freeElsewhere += other.size - other.used;
+      }
+    }
+
+    if (freeElsewhere >= chunk.used)
+    {
+      bestChunk = i;
+      bestUsage = usage;
     }
+  }
+
+  if (bestChunk == -1)
+  {
+    return SVK_MEMORY_INVALID_HANDLE;
+  }
 
-    prevNode = curNode;
-    curNode = smp_Nodes[curNode].nextNodeIndex;
+  for (int32_t i = smp_Chunks[bestChunk].firstBlock; i != -1; i = smp_Blocks[i].nextPhys)
+  {
+    if (!smp_Blocks[i].isFree && !smp_Blocks[i].isMoving)
+    {
+      return (uint32_t)i;
+    }
   }
 
-  // if last is one that must be added to free list
-  if (curNode == -1)
+  // all are being moved already
+  return SVK_MEMORY_INVALID_HANDLE;
+}
+
+uint32_t SvkMemoryPool::AllocateForMove(uint32_t handle, VkDeviceMemory &outMemory, uint32_t &outOffset)
+{
+  ASSERT(handle < (uint32_t)smp_Blocks.Count());
+  ASSERT(!smp_Blocks[handle].isFree && !smp_Blocks[handle].isMoving);
+
+  const uint32_t chunkIndex = smp_Blocks[handle].chunk;
+  const uint32_t memoryTypeIndex = smp_Chunks[chunkIndex].memoryTypeIndex;
+  const VkDeviceSize size = smp_Blocks[handle].size;
+  const VkDeviceSize alignment = smp_Blocks[handle].alignment;
+  const uint32_t userData = smp_Blocks[handle].userData;
+
+  // only existing chunks, new one won't help
+  if (FindFree(memoryTypeIndex, size + alignment - SVK_MEMORY_GRANULARITY, chunkIndex) == -1)
   {
-    ASSERT(prevNode != -1);
+    return SVK_MEMORY_INVALID_HANDLE;
+  }
+
+  uint32_t newHandle = AllocateBlock(memoryTypeIndex, size, alignment, chunkIndex);
+  ASSERT(newHandle != SVK_MEMORY_INVALID_HANDLE);
+
+  smp_Blocks[handle].isMoving = true;
+  smp_Blocks[newHandle].userData = userData;
+
+  const Block &block = smp_Blocks[newHandle];
+  outMemory = smp_Chunks[block.chunk].memory;
+  outOffset = (uint32_t)block.offset;
+
+  WriteTrace("M %u %u\n", handle, newHandle);
+
+  return newHandle;
+}
+
+void SvkMemoryPool::GetStats(SvkMemoryStats &stats)
+{
+  memset(&stats, 0, sizeof(stats));
 
-    // if can merge with previous
-    if (smp_Nodes[prevNode].blockIndex + smp_Nodes[prevNode].blockCount == blockIndex)
+  for (INDEX i = 0; i < smp_Chunks.Count(); i++)
+  {
+    const Chunk &chunk = smp_Chunks[i];
+    if (chunk.firstBlock == -1)
     {
-      smp_Nodes[prevNode].blockCount += blockCount;
+      continue;
+    }
+
+    stats.sms_ChunkCount++;
+    stats.sms_ChunkBytes += chunk.size;
+    stats.sms_UsedBytes += chunk.used;
+    stats.sms_AllocationCount += chunk.allocationCount;
 
-#ifndef NDEBUG
-      CheckConsistency(smp_FreeListHeadIndex, &smp_Nodes);
-#endif // !NDEBUG
-      return;
+    for (int32_t b = chunk.firstBlock; b != -1; b = smp_Blocks[b].nextPhys)
+    {
+      if (smp_Blocks[b].isFree)
+      {
+        stats.sms_FreeBlockCount++;
+        stats.sms_LargestFreeBlock = Max(stats.sms_LargestFreeBlock, smp_Blocks[b].size);
+      }
     }
-    else
+  }
+}
+
+bool SvkMemoryPool::CheckConsistency()
+{
+  INDEX ctFree = 0;
+
+  for (INDEX i = 0; i < smp_Chunks.Count(); i++)
+  {
+    const Chunk &chunk = smp_Chunks[i];
+    if (chunk.firstBlock == -1)
+    {
+      continue;
+    }
+
+    // blocks must cover the whole chunk without gaps and free ones must be merged
+    VkDeviceSize offset = 0, used = 0;
+    uint32_t allocationCount = 0;
+    int32_t prev = -1;
+
+    for (int32_t b = chunk.firstBlock; b != -1; b = smp_Blocks[b].nextPhys)
+    {
+      const Block &block = smp_Blocks[b];
+
+      if (block.chunk != (uint32_t)i || block.offset != offset || block.size == 0 || block.prevPhys != prev)
+      {
+        return false;
+      }
+      if (block.offset % SVK_MEMORY_GRANULARITY != 0 || block.size % SVK_MEMORY_GRANULARITY != 0)
+      {
+        return false;
+      }
+      if (block.isFree && prev != -1 && smp_Blocks[prev].isFree)
+      {
+        return false;
+      }
+
+      if (block.isFree)
+      {
+        ctFree++;
+      }
+      else
+      {
+        if (block.offset % block.alignment != 0)
+        {
+          return false;
+        }
+
+        used += block.size;
+        allocationCount++;
+      }
+
+      offset += block.size;
+      prev = b;
+    }
+
+    if (offset != chunk.size || used != chunk.used || allocationCount != chunk.allocationCount)
+    {
+      return false;
+    }
+  }
+
+  // all free blocks must be in lists of their classes
+  INDEX ctListed = 0;
+  for (uint32_t t = 0; t < MAX_MEMORY_TYPES; t++)
+  {
+    const SizeClasses &sc = smp_Classes[t];
+
+    for (uint32_t fl = 0; fl < FL_COUNT; fl++)
     {
-      // otherwise, create new block and link prev with it
-      int32_t newNode = AddNode();
-      smp_Nodes[newNode].blockIndex = blockIndex;
-      smp_Nodes[newNode].blockCount = blockCount;
-      smp_Nodes[newNode].nextNodeIndex = -1;
+      for (uint32_t sl = 0; sl < SL_COUNT; sl++)
+      {
+        bool hasBit = (sc.slBitmaps[fl] & (1 << sl)) != 0;
+        if (hasBit != (sc.heads[fl][sl] != -1))
+        {
+          return false;
+        }
 
-      smp_Nodes[prevNode].nextNodeIndex = newNode;
+        for (int32_t b = sc.heads[fl][sl]; b != -1; b = smp_Blocks[b].nextFree)
+        {
+          uint32_t bfl, bsl;
+          GetSizeClass(smp_Blocks[b].size, bfl, bsl);
 
+          if (!smp_Blocks[b].isFree || bfl != fl || bsl != sl || smp_Chunks[smp_Blocks[b].chunk].memoryTypeIndex != t)
+          {
+            return false;
+          }
+          ctListed++;
+        }
+      }
 
-#ifndef NDEBUG
-      CheckConsistency(smp_FreeListHeadIndex, &smp_Nodes);
-#endif // !NDEBUG
-      return;
+      if (((sc.flBitmap & (1 << fl)) != 0) != (sc.slBitmaps[fl] != 0))
+      {
+        return false;
+      }
     }
   }
 
-  ASSERT(blockIndex + blockCount <= smp_Nodes[curNode].blockIndex);
+  return ctListed == ctFree;
+}
+
+void SvkMemoryPool::SetTrace(CTFileStream *pstrm)
+{
+  smp_pTrace = pstrm;
+}
 
-  // if head is one that must be added to free list
-  if (prevNode == -1)
+void SvkMemoryPool::WriteTrace(const char *strFormat, ...)
+{
+  if (smp_pTrace == nullptr)
+  {
+    return;
+  }
+
+  CTString strLine;
+  va_list arg;
+  va_start(arg, strFormat);
+  strLine.VPrintF(strFormat, arg);
+  va_end(arg);
+
+  // allocations must not fail because of the trace, so just stop tracing
+  try
+  {
+    smp_pTrace->PutString_t(strLine);
+  }
+  catch (char *strError)
+  {
+    CPrintF("Vulkan error: Can't write memory trace, tracing stopped: %s\n", strError);
+    smp_pTrace->Close();
+    smp_pTrace = nullptr;
+  }
+}
+
+
+// one operation of recorded trace
+struct SvkTraceOp
+{
+  char      sto_Type;       // 'A', 'F' or 'M'
+  uint32_t  sto_Handle;
+  uint32_t  sto_NewHandle;  // for 'M'
+  uint32_t  sto_MemoryType;
+  uint32_t  sto_Size;
+  uint32_t  sto_Alignment;
+};
+
+// make trace similar to texture streaming: levels load many textures,
+// and some of them are freed and replaced while playing
+static void MakeSyntheticTrace(CStaticStackArray<SvkTraceOp> &aOps)
+{
+  ULONG ulSeed = 0x1234567;
+  CStaticStackArray<uint32_t> aLive;
+  uint32_t nextHandle = 0;
+
+  for (INDEX iOp = 0; iOp < 20000; iOp++)
   {
-    ASSERT(curNode == smp_FreeListHeadIndex);
+    ulSeed = ulSeed * 1103515245 + 12345;
+    ULONG ulRnd = ulSeed >> 8;
 
-    // check if can merge
-    if (blockIndex + blockCount == smp_Nodes[curNode].blockIndex)
+    // keep roughly 600 textures alive
+    BOOL bAlloc = aLive.Count() < 100 || (aLive.Count() < 600 ? (ulRnd % 100) < 60 : (ulRnd % 100) < 40);
+
+    if (bAlloc)
     {
-      // then update existing
-      smp_Nodes[curNode].blockIndex = blockIndex;
-      smp_Nodes[curNode].blockCount += blockCount;
+      // 16x16 to 1024x1024 textures with mipmaps; some of them are compressed
+      uint32_t log2 = 4 + (ulRnd >> 4) % 7;
+      uint32_t size = (1 << log2) * (1 << log2) * 4 * 4 / 3;
+      if ((ulRnd >> 12) % 3 == 0)
+      {
+        size /= 4;
+      }
 
-#ifndef NDEBUG
-      CheckConsistency(smp_FreeListHeadIndex, &smp_Nodes);
-#endif // !NDEBUG
+      SvkTraceOp &op = aOps.Push();
+      memset(&op, 0, sizeof(op));
+      op.sto_Type = 'A';
+      op.sto_Handle = nextHandle;
+      op.sto_MemoryType = 0;
+      op.sto_Size = Max(size, (uint32_t)SVK_MEMORY_GRANULARITY);
+      op.sto_Alignment = size >= 64 * 1024 ? 64 * 1024 : 1024;
+
+      aLive.Push() = nextHandle++;
     }
     else
     {
-      // new separate node is required, then update head
-      smp_FreeListHeadIndex = AddNode();
-      smp_Nodes[smp_FreeListHeadIndex].blockIndex = blockIndex;
-      smp_Nodes[smp_FreeListHeadIndex].blockCount = blockCount;
-      smp_Nodes[smp_FreeListHeadIndex].nextNodeIndex = curNode;
+      INDEX iLive = (ulRnd >> 4) % aLive.Count();
+
+      SvkTraceOp &op = aOps.Push();
+      memset(&op, 0, sizeof(op));
+      op.sto_Type = 'F';
+      op.sto_Handle = aLive[iLive];
 
-#ifndef NDEBUG
-      CheckConsistency(smp_FreeListHeadIndex, &smp_Nodes);
-#endif // !NDEBUG
+      aLive[iLive] = aLive[aLive.Count() - 1];
+      aLive.Pop();
     }
   }
-  else
+}
+
+// load trace written by SetTrace(); recorded moves only rename handles, as replay makes its own moves
+static BOOL LoadTrace(const CTFileName &fnmTrace, CStaticStackArray<SvkTraceOp> &aOps)
+{
+  try
   {
-    // if not head and not last;
-    // check if can merge with prev or next (relatively to new node)
-    bool withPrev = smp_Nodes[prevNode].blockIndex + smp_Nodes[prevNode].blockCount == blockIndex;
-    bool withNext = blockIndex + blockCount == smp_Nodes[curNode].blockIndex;
+    CTFileStream strm;
+    strm.Open_t(fnmTrace);
 
-    if (withPrev && withNext)
+    while (!strm.AtEOF())
     {
-      RemoveNode(curNode);
+      CTString strLine;
+      strm.GetLine_t(strLine);
 
-      smp_Nodes[prevNode].blockCount += blockCount + smp_Nodes[curNode].blockCount;
-      smp_Nodes[prevNode].nextNodeIndex = smp_Nodes[curNode].nextNodeIndex;
+      SvkTraceOp op;
+      memset(&op, 0, sizeof(op));
 
-#ifndef NDEBUG
-      CheckConsistency(smp_FreeListHeadIndex, &smp_Nodes);
-#endif // !NDEBUG
+      if (sscanf(strLine, "A %u %u %u %u", &op.sto_Handle, &op.sto_MemoryType, &op.sto_Size, &op.sto_Alignment) == 4)
+      {
+        op.sto_Type = 'A';
+        aOps.Push() = op;
+      }
+      else if (sscanf(strLine, "F %u", &op.sto_Handle) == 1)
+      {
+        op.sto_Type = 'F';
+        aOps.Push() = op;
+      }
+      else if (sscanf(strLine, "M %u %u", &op.sto_Handle, &op.sto_NewHandle) == 2)
+      {
+        // recorded handle was replaced by a new one
+        op.sto_Type = 'M';
+        aOps.Push() = op;
+      }
     }
-    else if (withPrev)
-    {
-      smp_Nodes[prevNode].blockCount += blockCount;
+  }
+  catch (char *strError)
+  {
+    CPrintF(TRANS("Cannot load memory trace: %s\n"), strError);
+    return FALSE;
+  }
 
-#ifndef NDEBUG
-      CheckConsistency(smp_FreeListHeadIndex, &smp_Nodes);
-#endif // !NDEBUG
-    }
-    else if (withNext)
+  return TRUE;
+}
+
+// replay trace on pool; returns false if pool got inconsistent
+static BOOL ReplayTrace(SvkMemoryPool &smp, const CStaticStackArray<SvkTraceOp> &aOps, INDEX ctPasses,
+  INDEX ctMovesPerStep, INDEX &ctFailed, INDEX &ctMoves, SvkMemoryStats &stats)
+{
+  // recorded handle -> current handle
+  CStaticStackArray<uint32_t> aHandles;
+
+  for (INDEX iPass = 0; iPass < ctPasses; iPass++)
+  {
+    for (INDEX iOp = 0; iOp < aOps.Count(); iOp++)
     {
-      smp_Nodes[curNode].blockIndex = blockIndex;
-      smp_Nodes[curNode].blockCount += blockCount;
+      const SvkTraceOp &op = aOps[iOp];
+
+      while (aHandles.Count() <= (INDEX)Max(op.sto_Handle, op.sto_NewHandle))
+      {
+        aHandles.Push() = SVK_MEMORY_INVALID_HANDLE;
+      }
+
+      if (op.sto_Type == 'A')
+      {
+        VkMemoryAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = op.sto_Size;
+        allocInfo.memoryTypeIndex = op.sto_MemoryType;
 
-#ifndef NDEBUG
-      CheckConsistency(smp_FreeListHeadIndex, &smp_Nodes);
-#endif // !NDEBUG
+        VkMemoryRequirements memReqs = {};
+        memReqs.size = op.sto_Size;
+        memReqs.alignment = op.sto_Alignment;
+
+        VkDeviceMemory memory;
+        uint32_t offset;
+        uint32_t handle = smp.Allocate(allocInfo, memReqs, memory, offset);
+
+        aHandles[op.sto_Handle] = handle;
+        if (handle == SVK_MEMORY_INVALID_HANDLE)
+        {
+          ctFailed++;
+          continue;
+        }
+
+        smp.SetUserData(handle, op.sto_Handle);
+      }
+      else if (op.sto_Type == 'F')
+      {
+        if (aHandles[op.sto_Handle] != SVK_MEMORY_INVALID_HANDLE)
+        {
+          smp.Free(aHandles[op.sto_Handle]);
+          aHandles[op.sto_Handle] = SVK_MEMORY_INVALID_HANDLE;
+        }
+      }
+      else
+      {
+        // recorded move: new handle continues the old one
+        const uint32_t handle = aHandles[op.sto_Handle];
+        aHandles[op.sto_NewHandle] = handle;
+        aHandles[op.sto_Handle] = SVK_MEMORY_INVALID_HANDLE;
+        if (handle != SVK_MEMORY_INVALID_HANDLE)
+        {
+          smp.SetUserData(handle, op.sto_NewHandle);
+        }
+      }
+
+      // every few operations make a frame, at whose start textures are moved
+      if (ctMovesPerStep > 0 && iOp % 64 == 63)
+      {
+        for (INDEX iMove = 0; iMove < ctMovesPerStep; iMove++)
+        {
+          uint32_t handle = smp.FindMoveCandidate();
+          if (handle == SVK_MEMORY_INVALID_HANDLE)
+          {
+            break;
+          }
+
+          VkDeviceMemory memory;
+          uint32_t offset;
+          uint32_t newHandle = smp.AllocateForMove(handle, memory, offset);
+          if (newHandle == SVK_MEMORY_INVALID_HANDLE)
+          {
+            break;
+          }
+
+          // with device, data would be copied here and old memory freed when not used anymore
+          aHandles[smp.GetUserData(handle)] = newHandle;
+          smp.Free(handle);
+          ctMoves++;
+        }
+      }
     }
-    else
+
+    if (!smp.CheckConsistency())
     {
-      int32_t newNode = AddNode();
-      smp_Nodes[newNode].blockIndex = blockIndex;
-      smp_Nodes[newNode].blockCount = blockCount;
-      smp_Nodes[newNode].nextNodeIndex = curNode;
+      return FALSE;
+    }
 
-      smp_Nodes[prevNode].nextNodeIndex = newNode;
+    // how the pool looks at the end of the trace
+    smp.GetStats(stats);
 
-#ifndef NDEBUG
-      CheckConsistency(smp_FreeListHeadIndex, &smp_Nodes);
-#endif // !NDEBUG
+    // free whatever is left, so next pass starts from the same state
+    for (INDEX i = 0; i < aHandles.Count(); i++)
+    {
+      if (aHandles[i] != SVK_MEMORY_INVALID_HANDLE)
+      {
+        smp.Free(aHandles[i]);
+        aHandles[i] = SVK_MEMORY_INVALID_HANDLE;
+      }
     }
   }
+
+  return smp.CheckConsistency();
 }
+
+void SvkMemoryPool::SoakTest(INDEX ctPasses)
+{
+  const CTFileName fnmTrace = CTFILENAME("Temp\\VkMemoryTrace.txt");
+  const VkDeviceSize chunkSize = 16 * 1024 * 1024;
+  const VkDeviceSize capacity = 1024 * 1024 * 1024;
+
+  CStaticStackArray<SvkTraceOp> aOps;
+  aOps.SetAllocationStep(4096);
+
+  if (FileExists(fnmTrace) && LoadTrace(fnmTrace, aOps))
+  {
+    CPrintF(TRANS("Replaying %d operations from %s, %d passes\n"), aOps.Count(), (const char *)fnmTrace, ctPasses);
+  }
+  else
+  {
+    aOps.PopAll();
+    MakeSyntheticTrace(aOps);
+    CPrintF(TRANS("Replaying %d synthetic operations, %d passes\n"), aOps.Count(), ctPasses);
+  }
+
+  // without and with defragmentation
+  for (INDEX iRun = 0; iRun < 2; iRun++)
+  {
+    SvkMockMemoryBackend backend(capacity);
+    SvkMemoryPool smp(&backend, chunkSize);
+
+    INDEX ctFailed = 0, ctMoves = 0;
+    SvkMemoryStats stats;
+    memset(&stats, 0, sizeof(stats));
+    BOOL bOK = ReplayTrace(smp, aOps, ctPasses, iRun == 0 ? 0 : 8, ctFailed, ctMoves, stats);
+
+    VkDeviceSize freeBytes = stats.sms_ChunkBytes - stats.sms_UsedBytes;
+    FLOAT fFragmentation = freeBytes > 0 ? 1.0f - (FLOAT)stats.sms_LargestFreeBlock / freeBytes : 0.0f;
+
+    CPrintF(TRANS("%s defragmentation: %s, peak %d KB in chunks, %d failed allocations, %d moves\n"),
+      iRun == 0 ? "Without" : "With", bOK ? "consistent" : "BROKEN",
+      (INDEX)(backend.smm_PeakAllocated / 1024), ctFailed, ctMoves);
+    CPrintF(TRANS("  at the end: %d chunks, %d KB used of %d KB, fragmentation %.1f%%\n"),
+      stats.sms_ChunkCount, (INDEX)(stats.sms_UsedBytes / 1024), (INDEX)(stats.sms_ChunkBytes / 1024),
+      fFragmentation * 100.0f);
+  }
+}
+
+#endif // SE1_VULKAN
@@ -23,77 +23,178 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <Engine/Graphics/Vulkan/VulkanInclude.h>
 #include <Engine/Templates/StaticStackArray.cpp>
 
+#define SVK_MEMORY_INVALID_HANDLE       0xFFFFFFFF
+
+// source of big memory chunks that are sub-allocated by SvkMemoryPool;
+// pool doesn't call Vulkan by itself, so it can be tested with a mock backend
+class SvkMemoryBackend
+{
+public:
+  virtual ~SvkMemoryBackend() {}
+
+  // allocate chunk of memory; return false if it's not possible
+  virtual bool AllocateChunk(uint32_t memoryTypeIndex, VkDeviceSize size, VkDeviceMemory &outMemory) = 0;
+  virtual void FreeChunk(uint32_t memoryTypeIndex, VkDeviceSize size, VkDeviceMemory memory) = 0;
+  // how many bytes can still be allocated from heap of memory type; 0 if unknown
+  virtual VkDeviceSize GetBudget(uint32_t memoryTypeIndex) = 0;
+};
+
+// device memory; budget is known only if VK_EXT_memory_budget is enabled
+class SvkDeviceMemoryBackend : public SvkMemoryBackend
+{
+private:
+  VkDevice                                    smb_VkDevice;
+  VkPhysicalDevice                            smb_VkPhysDevice;
+  PFN_vkGetPhysicalDeviceMemoryProperties2KHR smb_pGetMemoryProperties2;
+  VkPhysicalDeviceMemoryProperties            smb_VkMemoryProperties;
+
+public:
+  SvkDeviceMemoryBackend(VkDevice device, VkPhysicalDevice physDevice,
+    PFN_vkGetPhysicalDeviceMemoryProperties2KHR pGetMemoryProperties2);
+
+  bool AllocateChunk(uint32_t memoryTypeIndex, VkDeviceSize size, VkDeviceMemory &outMemory);
+  void FreeChunk(uint32_t memoryTypeIndex, VkDeviceSize size, VkDeviceMemory memory);
+  VkDeviceSize GetBudget(uint32_t memoryTypeIndex);
+};
+
+// fake memory with fixed capacity, for tests
+class SvkMockMemoryBackend : public SvkMemoryBackend
+{
+public:
+  VkDeviceSize    smm_Capacity;
+  VkDeviceSize    smm_Allocated;
+  VkDeviceSize    smm_PeakAllocated;
+  uint32_t        smm_ChunkCount;
+
+public:
+  SvkMockMemoryBackend(VkDeviceSize capacity);
+
+  bool AllocateChunk(uint32_t memoryTypeIndex, VkDeviceSize size, VkDeviceMemory &outMemory);
+  void FreeChunk(uint32_t memoryTypeIndex, VkDeviceSize size, VkDeviceMemory memory);
+  VkDeviceSize GetBudget(uint32_t memoryTypeIndex);
+};
+
+struct SvkMemoryStats
+{
+  uint32_t        sms_ChunkCount;
+  VkDeviceSize    sms_ChunkBytes;
+  VkDeviceSize    sms_UsedBytes;
+  uint32_t        sms_AllocationCount;
+  uint32_t        sms_FreeBlockCount;
+  VkDeviceSize    sms_LargestFreeBlock;
+};
+
+// Two-level segregated fit allocator over chunks of memory, one set of
+// size classes per memory type. Chunks are added when there's no free block
+// in the memory type and released when they become empty.
 class SvkMemoryPool
 {
 private:
-  struct FreeListNode
+  enum
+  {
+    SL_LOG2     = 4,
+    SL_COUNT    = 1 << SL_LOG2,
+    // sizes below 2^SMALL_LOG2 are divided linearly by granularity
+    SMALL_LOG2  = 12,
+    FL_COUNT    = 32,
+    MAX_MEMORY_TYPES = VK_MAX_MEMORY_TYPES,
+  };
+
+  struct Block
+  {
+    VkDeviceSize  offset;
+    VkDeviceSize  size;
+    VkDeviceSize  alignment;
+    uint32_t      chunk;
+    // neighbours in chunk; -1 if none
+    int32_t       prevPhys;
+    int32_t       nextPhys;
+    // links in size class list, only for free blocks
+    int32_t       prevFree;
+    int32_t       nextFree;
+    uint32_t      userData;
+    bool          isFree;
+    bool          isMoving;
+  };
+
+  struct Chunk
   {
-    // index of the next node; -1 if none
-    int32_t       nextNodeIndex;
-    uint32_t      blockIndex;
-    uint32_t      blockCount;
-
-    FreeListNode()
-    {
-      nextNodeIndex = -1;
-      blockIndex = blockCount = 0;
-    }
+    VkDeviceMemory  memory;
+    uint32_t        memoryTypeIndex;
+    VkDeviceSize    size;
+    VkDeviceSize    used;
+    uint32_t        allocationCount;
+    // block at offset 0, its index never changes; -1 if chunk is released
+    int32_t         firstBlock;
   };
 
-  struct AllocHandle
+  struct SizeClasses
   {
-    uint32_t      id;
-    uint32_t      blockIndex;
-    uint32_t      blockCount;
-
-    AllocHandle()
-    {
-      id = blockIndex = blockCount = 0;
-    }
+    uint32_t        flBitmap;
+    uint32_t        slBitmaps[FL_COUNT];
+    int32_t         heads[FL_COUNT][SL_COUNT];
   };
 
 private:
-  VkDevice        smp_VkDevice;
-  VkDeviceMemory  smp_VkMemory;
-  uint32_t        smp_VkMemoryTypeIndex;
-
-  // next pool, if this became full
-  SvkMemoryPool   *smp_pNext;
-  
-  // all nodes
-  CStaticArray<FreeListNode> smp_Nodes;
-  // head of the free ranges list; -1 if none
-  int32_t         smp_FreeListHeadIndex;
-  int32_t         smp_NodeLastIndex;
-  CStaticStackArray<int32_t> smp_RemovedIndices;
-
-  // handles for freeing
-  CStaticStackArray<AllocHandle> smp_Handles;
-  uint32_t        smp_HandleLastIndex;
-
-  uint32_t        smp_PreferredSize;
-  // overall block count
-  uint32_t        smp_BlockCount;
-  // size of one block in bytes, aligned
-  uint32_t        smp_BlockSize;
-  // current allocation count
-  uint32_t        smp_AllocationCount;
+  SvkMemoryBackend  *smp_pBackend;
+  VkDeviceSize      smp_ChunkSize;
+
+  CStaticStackArray<Block>    smp_Blocks;
+  CStaticStackArray<int32_t>  smp_RemovedBlocks;
+  CStaticStackArray<Chunk>    smp_Chunks;
+  SizeClasses                 smp_Classes[MAX_MEMORY_TYPES];
+
+  // allocations and frees are written here, if set
+  CTFileStream      *smp_pTrace;
 
 private:
-  void Init(uint32_t memoryTypeIndex, uint32_t alignment);
-  int32_t AddNode();
-  void RemoveNode(int32_t removed);
+  static void GetSizeClass(VkDeviceSize size, uint32_t &fl, uint32_t &sl);
+
+  int32_t AddBlock();
+  void RemoveBlock(int32_t index);
+  void InsertFree(int32_t index);
+  void RemoveFree(int32_t index);
+  // find free block that has at least given size; blocks in excluded chunk are skipped
+  int32_t FindFree(uint32_t memoryTypeIndex, VkDeviceSize size, int32_t excludedChunk);
+  bool AddChunk(uint32_t memoryTypeIndex, VkDeviceSize minSize);
+  void ReleaseChunk(uint32_t chunk);
+  // write one line to trace, if tracing
+  void WriteTrace(const char *strFormat, ...);
+  uint32_t AllocateBlock(uint32_t memoryTypeIndex, VkDeviceSize size, VkDeviceSize alignment, int32_t excludedChunk);
 
 public:
-  SvkMemoryPool(VkDevice device, uint32_t preferredSize);
+  SvkMemoryPool(SvkMemoryBackend *pBackend, VkDeviceSize chunkSize);
   ~SvkMemoryPool();
 
   // Allocate memory with specified size, out params are memory and offset in it.
-  // Returns handle which must be used to free memory.
+  // Returns handle which must be used to free memory, or SVK_MEMORY_INVALID_HANDLE if out of memory.
   uint32_t Allocate(VkMemoryAllocateInfo allocInfo, VkMemoryRequirements memReqs, VkDeviceMemory &outMemory, uint32_t &outOffset);
 
   // Free allocated memory. Handle is a number that was returned in Allocate.
   void Free(uint32_t handle);
+
+  // user data can be used to find an owner of allocation that has to be moved
+  void SetUserData(uint32_t handle, uint32_t userData);
+  uint32_t GetUserData(uint32_t handle);
+
+  // Find allocation that should be moved to reduce fragmentation: it's in the least used chunk
+  // of its memory type, and other chunks have enough free space for its allocations.
+  // Returns SVK_MEMORY_INVALID_HANDLE if there's nothing to move. If previous candidate
+  // is given, search continues after it in its chunk (to skip allocations that can't be moved now).
+  uint32_t FindMoveCandidate(uint32_t prevCandidate = SVK_MEMORY_INVALID_HANDLE);
+  // Allocate new place for allocation outside of its chunk; after data was copied,
+  // old handle must be freed by caller.
+  uint32_t AllocateForMove(uint32_t handle, VkDeviceMemory &outMemory, uint32_t &outOffset);
+
+  void GetStats(SvkMemoryStats &stats);
+  // check internal structures, return false if they're broken
+  bool CheckConsistency();
+
+  // write allocations and frees to file (NULL to stop); file is closed if writing fails
+  void SetTrace(CTFileStream *pstrm);
+
+  // replay recorded trace with mock backend many times and print fragmentation statistics
+  static void SoakTest(INDEX ctPasses);
 };
 
 #endif // SE1_VULKAN
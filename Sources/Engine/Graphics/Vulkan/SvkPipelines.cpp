@@ -15,6 +15,9 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "stdh.h"
 #include <Engine/Graphics/Vulkan/SvkMain.h>
+#include <Engine/Base/Stream.h>
+#include <Engine/Base/CRC.h>
+#include <Engine/Base/MemoryPool.h>
 
 #ifdef SE1_VULKAN
 
@@ -30,22 +33,62 @@ SvkPipelineState &SvkMain::GetPipeline(SvkPipelineStateFlags flags)
     gl_VkPipelines.New();
   }
 
+  // depth tested draws mean that the world is being rendered, not just the loading screen
+  if (flags & SVK_PLS_DEPTH_TEST_BOOL)
+  {
+    gl_VkLevelRendered = true;
+  }
+
   SvkPipelineState *sps = gl_VkPipelines.TryGet(flags);
 
   if (sps != nullptr)
   {
+    // remember states that are used in current level
+    if (sps->sps_LevelIndex != gl_VkLevelIndex)
+    {
+      sps->sps_LevelIndex = gl_VkLevelIndex;
+      gl_VkLevelFlags.Push() = flags;
+    }
     return *sps;
   }
 
-  VkShaderModule vert = gl_VkShaderModuleVert;
-  VkShaderModule frag = (flags & SVK_PLS_ALPHA_ENABLE_BOOL) ? gl_VkShaderModuleFragAlpha : gl_VkShaderModuleFrag;
+  // maybe it was compiled in background in the meantime
+  if (gl_VkPrewarmPipelines.Count() > 0)
+  {
+    AdoptPrewarmedPipelines();
+    sps = gl_VkPipelines.TryGet(flags);
+
+    if (sps != nullptr)
+    {
+      return GetPipeline(flags);
+    }
+  }
 
   // if not found, create new pipeline with specified flags
-  return CreatePipeline(flags, *gl_VkDefaultVertexLayout, vert, frag);
+  gl_VkPipelinesCompiled++;
+  gl_VkLevelCompiled++;
+  if (!gl_VkLevelFirstFrameDone)
+  {
+    gl_VkLevelFirstFrameCompiled++;
+  }
+
+  gl_VkLevelFlags.Push() = flags;
+
+  SvkPipelineState &newState = CreatePipeline(flags, *gl_VkDefaultVertexLayout, gl_VkShaderModuleVert, GetFragmentShader(flags));
+  newState.sps_LevelIndex = gl_VkLevelIndex;
+  return newState;
+}
+
+VkShaderModule SvkMain::GetFragmentShader(SvkPipelineStateFlags flags)
+{
+  return (flags & SVK_PLS_ALPHA_ENABLE_BOOL) ? gl_VkShaderModuleFragAlpha : gl_VkShaderModuleFrag;
 }
 
 void SvkMain::DestroyPipelines()
 {
+  // background compilation must not outlive the pipelines
+  StopPrewarming();
+
   gl_VkPipelines.Map([](SvkPipelineState &sps)
     {
       vkDestroyPipeline(sps.sps_Device, sps.sps_Pipeline, nullptr);
@@ -61,6 +104,17 @@ SvkPipelineState &SvkMain::CreatePipeline(
   SvkPipelineState newState = {};
   newState.sps_Device = gl_VkDevice;
   newState.sps_Flags = flags;
+  newState.sps_Pipeline = CompilePipeline(flags, vertLayout, vertShaderModule, fragShaderModule);
+
+  gl_VkPipelines.Add(flags, newState);
+
+  return gl_VkPipelines.Get(flags);
+}
+
+VkPipeline SvkMain::CompilePipeline(
+  SvkPipelineStateFlags flags, const SvkVertexLayout &vertLayout,
+  VkShaderModule vertShaderModule, VkShaderModule fragShaderModule)
+{
 
   // if dynamic depth bounds required, dynamicStatesCount will be incremented
   uint32_t dynamicStatesCount = 2;
@@ -250,14 +304,19 @@ SvkPipelineState &SvkMain::CreatePipeline(
   pipelineInfo.subpass = 0;
   pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-  VkResult r = vkCreateGraphicsPipelines(gl_VkDevice, gl_VkPipelineCache, 1, &pipelineInfo, nullptr, &newState.sps_Pipeline);
+  VkPipeline pipeline = VK_NULL_HANDLE;
+  VkResult r = vkCreateGraphicsPipelines(gl_VkDevice, gl_VkPipelineCache, 1, &pipelineInfo, nullptr, &pipeline);
   VK_CHECKERROR(r);
 
-  gl_VkPipelines.Add(flags, newState);
-
-  return gl_VkPipelines.Get(flags);
+  return pipeline;
 }
 
+// version of pipeline cache files, must be changed when pipeline state flags change
+#define SVK_PIPELINECACHE_VERSION 1
+#define SVK_PIPELINECACHE_DIR     "Temp\\PipelineCache\\"
+
+extern INDEX gfx_vk_bPipelineCache;
+
 void SvkMain::CreatePipelineCache()
 {
   ASSERT(gl_VkPipelineCache == VK_NULL_HANDLE);
@@ -265,7 +324,370 @@ void SvkMain::CreatePipelineCache()
   VkPipelineCacheCreateInfo cacheInfo = {};
   cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
 
+  // try to start with the data saved by last run on the same device and driver
+  CStaticArray<UBYTE> aubData;
+  const CTFileName fnmCache = CTString(SVK_PIPELINECACHE_DIR "Pipelines.bin");
+
+  if (gfx_vk_bPipelineCache && FileExists(fnmCache))
+  {
+    try
+    {
+      CTFileStream strm;
+      strm.Open_t(fnmCache);
+      strm.ExpectID_t("VKPC");
+
+      ULONG ulVersion, ulVendor, ulDevice, ulDriver, ulSize;
+      UBYTE aubUUID[VK_UUID_SIZE];
+      strm >> ulVersion >> ulVendor >> ulDevice >> ulDriver;
+      strm.Read_t(aubUUID, VK_UUID_SIZE);
+      strm >> ulSize;
+
+      if (ulVersion == SVK_PIPELINECACHE_VERSION
+        && ulVendor == gl_VkPhProperties.vendorID && ulDevice == gl_VkPhProperties.deviceID
+        && ulDriver == gl_VkPhProperties.driverVersion
+        && memcmp(aubUUID, gl_VkPhProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0
+        && ulSize > 0)
+      {
+        aubData.New(ulSize);
+        strm.Read_t(&aubData[0], ulSize);
+        cacheInfo.initialDataSize = ulSize;
+        cacheInfo.pInitialData = &aubData[0];
+      }
+      else
+      {
+        CPrintF(TRANS("Vulkan: pipeline cache was made by other device or driver, ignoring it.\n"));
+      }
+    }
+    catch (char *strError)
+    {
+      CPrintF(TRANS("Vulkan: cannot read pipeline cache: %s\n"), strError);
+      cacheInfo.initialDataSize = 0;
+      cacheInfo.pInitialData = nullptr;
+    }
+  }
+
   VkResult r = vkCreatePipelineCache(gl_VkDevice, &cacheInfo, nullptr, &gl_VkPipelineCache);
+
+  // driver may still reject the data
+  if (r != VK_SUCCESS && cacheInfo.initialDataSize > 0)
+  {
+    cacheInfo.initialDataSize = 0;
+    cacheInfo.pInitialData = nullptr;
+    r = vkCreatePipelineCache(gl_VkDevice, &cacheInfo, nullptr, &gl_VkPipelineCache);
+  }
+  VK_CHECKERROR(r);
+
+  gl_VkPipelineCacheLoaded = (uint32_t)cacheInfo.initialDataSize;
+}
+
+void SvkMain::SavePipelineCache()
+{
+  if (!gfx_vk_bPipelineCache || gl_VkPipelineCache == VK_NULL_HANDLE)
+  {
+    return;
+  }
+
+  size_t size = 0;
+  VkResult r = vkGetPipelineCacheData(gl_VkDevice, gl_VkPipelineCache, &size, nullptr);
+  if (r != VK_SUCCESS || size == 0)
+  {
+    return;
+  }
+
+  CStaticArray<UBYTE> aubData;
+  aubData.New(size);
+  r = vkGetPipelineCacheData(gl_VkDevice, gl_VkPipelineCache, &size, &aubData[0]);
+  if (r != VK_SUCCESS)
+  {
+    return;
+  }
+
+  CreateDirectoryA(_fnmApplicationPath + SVK_PIPELINECACHE_DIR, NULL);
+  try
+  {
+    CTFileStream strm;
+    strm.Create_t(CTString(SVK_PIPELINECACHE_DIR "Pipelines.bin"));
+    strm.WriteID_t("VKPC");
+    strm << (ULONG)SVK_PIPELINECACHE_VERSION << (ULONG)gl_VkPhProperties.vendorID
+      << (ULONG)gl_VkPhProperties.deviceID << (ULONG)gl_VkPhProperties.driverVersion;
+    strm.Write_t(gl_VkPhProperties.pipelineCacheUUID, VK_UUID_SIZE);
+    strm << (ULONG)size;
+    strm.Write_t(&aubData[0], size);
+  }
+  catch (char *strError)
+  {
+    // cache is just an optimization
+    CPrintF(TRANS("Vulkan: cannot write pipeline cache: %s\n"), strError);
+  }
+}
+
+// file with pipeline states that were used in a level
+static CTFileName GetLevelPipelinesFileName(const CTFileName &fnmLevel)
+{
+  ULONG ulCRC;
+  CRC_Start(ulCRC);
+  CRC_AddBlock(ulCRC, (UBYTE *)(const char *)fnmLevel, strlen(fnmLevel));
+  CRC_Finish(ulCRC);
+
+  CTString strName;
+  strName.PrintF(SVK_PIPELINECACHE_DIR "%08X.vpl", ulCRC);
+  return CTFileName(strName);
+}
+
+static int qsort_CompareFlags(const void *pv0, const void *pv1)
+{
+  const SvkPipelineStateFlags f0 = *(const SvkPipelineStateFlags *)pv0;
+  const SvkPipelineStateFlags f1 = *(const SvkPipelineStateFlags *)pv1;
+  return f0 < f1 ? -1 : (f0 > f1 ? +1 : 0);
+}
+
+void SvkMain::SaveLevelPipelines()
+{
+  if (!gfx_vk_bPipelineCache || gl_VkLevelName == "" || gl_VkLevelFlags.Count() == 0)
+  {
+    return;
+  }
+
+  // remove duplicates
+  qsort(&gl_VkLevelFlags[0], gl_VkLevelFlags.Count(), sizeof(SvkPipelineStateFlags), qsort_CompareFlags);
+  INDEX ctUnique = 1;
+  for (INDEX i = 1; i < gl_VkLevelFlags.Count(); i++)
+  {
+    if (gl_VkLevelFlags[i] != gl_VkLevelFlags[ctUnique - 1])
+    {
+      gl_VkLevelFlags[ctUnique++] = gl_VkLevelFlags[i];
+    }
+  }
+
+  CreateDirectoryA(_fnmApplicationPath + SVK_PIPELINECACHE_DIR, NULL);
+  try
+  {
+    CTFileStream strm;
+    strm.Create_t(GetLevelPipelinesFileName(gl_VkLevelName));
+    strm.WriteID_t("VKPL");
+    strm << (ULONG)SVK_PIPELINECACHE_VERSION << ctUnique;
+    strm.Write_t(&gl_VkLevelFlags[0], ctUnique * sizeof(SvkPipelineStateFlags));
+  }
+  catch (char *strError)
+  {
+    CPrintF(TRANS("Vulkan: cannot write level pipeline states: %s\n"), strError);
+  }
+}
+
+// background thread that compiles pipelines for current level
+static DWORD WINAPI SvkPrewarmThread(LPVOID lpParameter)
+{
+  ((SvkMain *)lpParameter)->PrewarmPipelines();
+  MemPool_ReleaseThreadCache();
+  return 0;
+}
+
+void SvkMain::PrewarmPipelines()
+{
+  // only fields of prewarm array elements are written here;
+  // pipeline cache is internally synchronized
+  for (INDEX i = 0; i < gl_VkPrewarmPipelines.Count(); i++)
+  {
+    if (gl_VkPrewarmAbort)
+    {
+      break;
+    }
+
+    SvkPipelineState &sps = gl_VkPrewarmPipelines[i];
+    sps.sps_Pipeline = CompilePipeline(sps.sps_Flags, *gl_VkDefaultVertexLayout, gl_VkShaderModuleVert, GetFragmentShader(sps.sps_Flags));
+
+    InterlockedIncrement((LONG *)&gl_VkPrewarmReady);
+  }
+}
+
+void SvkMain::StartLevelPipelines(const CTFileName &fnmLevel)
+{
+  // finish with previous level
+  StopPrewarming();
+  SaveLevelPipelines();
+
+  gl_VkLevelName = fnmLevel;
+  gl_VkLevelIndex++;
+  gl_VkLevelFlags.PopAll();
+  gl_VkLevelCompiled = 0;
+  gl_VkLevelPrewarmed = 0;
+  gl_VkLevelRendered = false;
+  gl_VkLevelFirstFrameDone = false;
+  gl_VkLevelFirstFrameCompiled = 0;
+
+  const CTFileName fnmStates = GetLevelPipelinesFileName(fnmLevel);
+  if (!gfx_vk_bPipelineCache || !FileExists(fnmStates))
+  {
+    return;
+  }
+
+  // load states that the level used last time
+  try
+  {
+    CTFileStream strm;
+    strm.Open_t(fnmStates);
+    strm.ExpectID_t("VKPL");
+
+    ULONG ulVersion;
+    INDEX ctFlags;
+    strm >> ulVersion >> ctFlags;
+    if (ulVersion != SVK_PIPELINECACHE_VERSION || ctFlags <= 0)
+    {
+      return;
+    }
+
+    gl_VkLevelFlags.Push(ctFlags);
+    strm.Read_t(&gl_VkLevelFlags[0], ctFlags * sizeof(SvkPipelineStateFlags));
+  }
+  catch (char *strError)
+  {
+    CPrintF(TRANS("Vulkan: cannot read level pipeline states: %s\n"), strError);
+    gl_VkLevelFlags.PopAll();
+    return;
+  }
+
+  if (!gl_VkPipelines.IsAllocated())
+  {
+    gl_VkPipelines.New();
+  }
+
+  // compile those that don't exist yet
+  for (INDEX i = 0; i < gl_VkLevelFlags.Count(); i++)
+  {
+    const SvkPipelineStateFlags flags = gl_VkLevelFlags[i];
+    SvkPipelineState *sps = gl_VkPipelines.TryGet(flags);
+
+    if (sps != nullptr)
+    {
+      sps->sps_LevelIndex = gl_VkLevelIndex;
+      continue;
+    }
+
+    SvkPipelineState &newState = gl_VkPrewarmPipelines.Push();
+    newState = {};
+    newState.sps_Device = gl_VkDevice;
+    newState.sps_Flags = flags;
+  }
+
+  if (gl_VkPrewarmPipelines.Count() == 0)
+  {
+    return;
+  }
+
+  gl_VkPrewarmReady = 0;
+  gl_VkPrewarmAdopted = 0;
+  gl_VkPrewarmAbort = FALSE;
+
+  DWORD dwThreadID;
+  gl_VkPrewarmThread = CreateThread(NULL, 0, SvkPrewarmThread, this, 0, &dwThreadID);
+
+  // if thread can't be created, just compile them now
+  if (gl_VkPrewarmThread == NULL)
+  {
+    PrewarmPipelines();
+  }
+}
+
+void SvkMain::AdoptPrewarmedPipelines()
+{
+  const INDEX ctReady = gl_VkPrewarmReady;
+
+  for (; gl_VkPrewarmAdopted < ctReady; gl_VkPrewarmAdopted++)
+  {
+    SvkPipelineState &sps = gl_VkPrewarmPipelines[gl_VkPrewarmAdopted];
+
+    // it might have been needed before it was ready
+    if (gl_VkPipelines.TryGet(sps.sps_Flags) != nullptr)
+    {
+      vkDestroyPipeline(sps.sps_Device, sps.sps_Pipeline, nullptr);
+      continue;
+    }
+
+    sps.sps_LevelIndex = gl_VkLevelIndex;
+    gl_VkPipelines.Add(sps.sps_Flags, sps);
+
+    gl_VkPipelinesPrewarmed++;
+    gl_VkLevelPrewarmed++;
+
+    // hash table might have moved its elements
+    gl_VkPreviousPipeline = nullptr;
+  }
+
+  // if all are done
+  if (gl_VkPrewarmAdopted == gl_VkPrewarmPipelines.Count())
+  {
+    if (gl_VkPrewarmThread != NULL)
+    {
+      WaitForSingleObject(gl_VkPrewarmThread, INFINITE);
+      CloseHandle(gl_VkPrewarmThread);
+      gl_VkPrewarmThread = NULL;
+    }
+
+    gl_VkPrewarmPipelines.PopAll();
+    gl_VkPrewarmReady = 0;
+    gl_VkPrewarmAdopted = 0;
+  }
+}
+
+void SvkMain::StopPrewarming()
+{
+  if (gl_VkPrewarmPipelines.Count() == 0)
+  {
+    return;
+  }
+
+  gl_VkPrewarmAbort = TRUE;
+
+  if (gl_VkPrewarmThread != NULL)
+  {
+    WaitForSingleObject(gl_VkPrewarmThread, INFINITE);
+    CloseHandle(gl_VkPrewarmThread);
+    gl_VkPrewarmThread = NULL;
+  }
+
+  // keep the ones that are ready
+  AdoptPrewarmedPipelines();
+
+  gl_VkPrewarmPipelines.PopAll();
+  gl_VkPrewarmReady = 0;
+  gl_VkPrewarmAdopted = 0;
+  gl_VkPrewarmAbort = FALSE;
+}
+
+void SvkMain::EndLevelFrame()
+{
+  // first frame that rendered the world (loading screen doesn't use depth test)
+  if (gl_VkLevelFirstFrameDone || gl_VkLevelName == "")
+  {
+    return;
+  }
+
+  if (!gl_VkLevelRendered)
+  {
+    gl_VkLevelFirstFrameCompiled = 0;
+    return;
+  }
+
+  gl_VkLevelFirstFrameDone = true;
+  CPrintF(TRANS("Vulkan: first frame of level compiled %d pipelines (%d prewarmed, %d compiled while loading)\n"),
+    gl_VkLevelFirstFrameCompiled, gl_VkLevelPrewarmed, gl_VkLevelCompiled - gl_VkLevelFirstFrameCompiled);
+}
+
+void SvkMain::PrintPipelineStats()
+{
+  CPrintF(TRANS("Pipeline cache: %d KB loaded from disk\n"), gl_VkPipelineCacheLoaded / 1024);
+  CPrintF(TRANS("Pipelines: %d compiled while drawing, %d prewarmed\n"), gl_VkPipelinesCompiled, gl_VkPipelinesPrewarmed);
+  if (gl_VkLevelName != "")
+  {
+    CPrintF(TRANS("Level '%s': %d states recorded, %d compiled while drawing (%d in first frame), %d prewarmed"),
+      (const char *)gl_VkLevelName, gl_VkLevelFlags.Count(), gl_VkLevelCompiled,
+      gl_VkLevelFirstFrameDone ? gl_VkLevelFirstFrameCompiled : 0, gl_VkLevelPrewarmed);
+    if (gl_VkPrewarmPipelines.Count() > 0)
+    {
+      CPrintF(TRANS(", %d still compiling"), gl_VkPrewarmPipelines.Count() - gl_VkPrewarmReady);
+    }
+    CPrintF("\n");
+  }
 }
 
 
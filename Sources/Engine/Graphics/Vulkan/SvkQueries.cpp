@@ -58,6 +58,9 @@ uint32_t SvkMain::CreateOcclusionQuery(float fromx, float fromy, float tox, floa
   ASSERT(gl_VkCmdIsRecording);
   ASSERT(fromx <= tox && fromy <= toy);
 
+  // pending draws must be recorded before the query
+  FlushDrawBatch();
+
   uint32_t queryId = gl_VkOcclusionQueryLast[gl_VkCmdBufferCurrent];
   gl_VkOcclusionQueryLast[gl_VkCmdBufferCurrent]++;
 
@@ -82,20 +85,15 @@ uint32_t SvkMain::CreateOcclusionQuery(float fromx, float fromy, float tox, floa
   memcpy(vertexBuffer.sdb_Data, verts, sizeof(verts));
   memcpy(indexBuffer.sdb_Data, indices, sizeof(indices));
 
-  VkCommandBuffer cmd = gl_VkCmdBuffers[gl_VkCmdBufferCurrent];
-
-  // begin new query
-  vkCmdBeginQuery(cmd, gl_VkOcclusionQueryPools[gl_VkCmdBufferCurrent], queryId, 0);
-  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, gl_VkPipelineOcclusion);
-
-  // reset to prevent usage of this pipeline for a next object
-  gl_VkPreviousPipeline = nullptr;
-
-  vkCmdBindVertexBuffers(cmd, 0, 1, &vertexBuffer.sdb_Buffer, &vertexBuffer.sdb_CurrentOffset);
-  vkCmdBindIndexBuffer(cmd, indexBuffer.sdb_Buffer, indexBuffer.sdb_CurrentOffset, VK_INDEX_TYPE_UINT32);
-  vkCmdDrawIndexed(cmd, 6, 1, 0, 0, 0);
-
-  vkCmdEndQuery(cmd, gl_VkOcclusionQueryPools[gl_VkCmdBufferCurrent], queryId);
+  SvkRenderCommand rc;
+  rc.src_Type = SRC_OCCLUSIONQUERY;
+  rc.src_Pipeline = gl_VkPipelineOcclusion;
+  rc.src_QueryId = queryId;
+  rc.src_Draw.sdw_VertexBuffer = vertexBuffer.sdb_Buffer;
+  rc.src_Draw.sdw_VertexStart = vertexBuffer.sdb_CurrentOffset;
+  rc.src_Draw.sdw_IndexBuffer = indexBuffer.sdb_Buffer;
+  rc.src_Draw.sdw_IndexStart = indexBuffer.sdb_CurrentOffset;
+  AddRenderCommand(rc);
 
   return queryId;
 }
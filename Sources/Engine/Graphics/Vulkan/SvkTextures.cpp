@@ -16,9 +16,13 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "stdh.h"
 #include <Engine/Graphics/GfxLibrary.h>
 #include <Engine/Graphics/Vulkan/SvkMain.h>
+#include <Engine/Base/Stream.h>
 
 #ifdef SE1_VULKAN
 
+extern INDEX gfx_vk_bMemoryTrace;
+static CTFileStream *_pstrmMemoryTrace = nullptr;
+
 void SvkMain::CreateTexturesDataStructure()
 {
   ASSERT(!gl_VkTextures.IsAllocated());
@@ -29,7 +33,28 @@ void SvkMain::CreateTexturesDataStructure()
 
   // average texture size with mipmaps in bytes
   const uint32_t AvgTextureSize = 256 * 256 * 4 * 4 / 3;
-  gl_VkImageMemPool = new SvkMemoryPool(gl_VkDevice, AvgTextureSize * 512);
+  gl_VkImageMemBackend = new SvkDeviceMemoryBackend(gl_VkDevice, gl_VkPhysDevice,
+    gl_VkMemoryBudgetSupported ? gl_VkGetMemoryProperties2 : nullptr);
+  // smaller chunks can be released and defragmented sooner
+  gl_VkImageMemPool = new SvkMemoryPool(gl_VkImageMemBackend, AvgTextureSize * 64);
+  gl_VkTexturesUploaded = 0;
+
+  // record allocations to replay them in VulkanMemorySoak()
+  if (gfx_vk_bMemoryTrace)
+  {
+    _pstrmMemoryTrace = new CTFileStream;
+    try
+    {
+      _pstrmMemoryTrace->Create_t(CTFILENAME("Temp\\VkMemoryTrace.txt"), CTStream::CM_TEXT);
+      gl_VkImageMemPool->SetTrace(_pstrmMemoryTrace);
+    }
+    catch (char *strError)
+    {
+      CPrintF("Vulkan error: Can't create memory trace: %s\n", strError);
+      delete _pstrmMemoryTrace;
+      _pstrmMemoryTrace = nullptr;
+    }
+  }
 
   for (uint32_t i = 0; i < gl_VkMaxCmdBufferCount; i++)
   {
@@ -41,6 +66,15 @@ void SvkMain::CreateTexturesDataStructure()
 void SvkMain::DestroyTexturesDataStructure()
 {
   delete gl_VkImageMemPool;
+  delete gl_VkImageMemBackend;
+  gl_VkImageMemPool = nullptr;
+  gl_VkImageMemBackend = nullptr;
+
+  if (_pstrmMemoryTrace != nullptr)
+  {
+    delete _pstrmMemoryTrace;
+    _pstrmMemoryTrace = nullptr;
+  }
 
   // destroy all texture objects; memory handles will be ignored
   // as image memory pool is freed already
@@ -139,6 +173,17 @@ uint32_t SvkMain::GetTexturePixCount(uint32_t textureId)
   return psto->sto_Width * psto->sto_Height;
 }
 
+VkFormat SvkMain::GetTextureFormat(uint32_t textureId)
+{
+  SvkTextureObject *psto = gl_VkTextures.TryGet(textureId);
+  if (psto == nullptr)
+  {
+    return VK_FORMAT_UNDEFINED;
+  }
+
+  return psto->sto_Format;
+}
+
 void SvkMain::FreeDeletedTextures(uint32_t cmdBufferIndex)
 {
   auto &toDelete = *(gl_VkTexturesToDelete[cmdBufferIndex]);
@@ -188,11 +233,26 @@ uint32_t SvkMain::CreateTexture(uint32_t textureId)
   return textureId;
 }
 
-void SvkMain::InitTexture32Bit(
+// size of one mip level in bytes
+static uint32_t GetMipLevelSize(VkFormat format, uint32_t width, uint32_t height)
+{
+  switch (format)
+  {
+  // 4x4 blocks, partial blocks are padded
+  case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    return ((width + 3) / 4) * ((height + 3) / 4) * 8;
+  case VK_FORMAT_BC3_UNORM_BLOCK:
+  case VK_FORMAT_BC7_UNORM_BLOCK:
+    return ((width + 3) / 4) * ((height + 3) / 4) * 16;
+  default:
+    return width * height * 4;
+  }
+}
+
+void SvkMain::InitTexture(
   uint32_t &textureId, VkFormat format, void *textureData,
   VkExtent2D *mipLevels, uint32_t mipLevelsCount, bool onlyUpdate)
 {
-  const uint32_t PixelSize = 4;
   const uint32_t MaxMipLevelsCount = 32;
  
   VkResult r;
@@ -212,7 +272,8 @@ void SvkMain::InitTexture32Bit(
   // if texture is already initialized, it can be only updated
   ASSERT(sto.sto_Image == VK_NULL_HANDLE || (sto.sto_Image != VK_NULL_HANDLE && onlyUpdate));
  
-  if (onlyUpdate && (mipLevels[0].width != sto.sto_Width || mipLevels[0].height != sto.sto_Height))
+  // image must be recreated if size or format changed
+  if (onlyUpdate && (mipLevels[0].width != sto.sto_Width || mipLevels[0].height != sto.sto_Height || format != sto.sto_Format))
   {
     // safely delete and create new with the same id
     AddTextureToDeletion(textureId);
@@ -229,12 +290,15 @@ void SvkMain::InitTexture32Bit(
 
   sto.sto_Width = mipLevels[0].width;
   sto.sto_Height = mipLevels[0].height;
+  sto.sto_MipLevelCount = mipLevelsCount;
+
+  gl_VkTexturesUploaded++;
 
   // size of texture with all mipmaps
   uint32_t textureBufferSize = 0;
   for (uint32_t i = 0; i < mipLevelsCount; i++)
   {
-    textureBufferSize += mipLevels[i].width * mipLevels[i].height * PixelSize;
+    textureBufferSize += GetMipLevelSize(format, mipLevels[i].width, mipLevels[i].height);
   }
 
   // TODO: common staging memory
@@ -288,8 +352,8 @@ void SvkMain::InitTexture32Bit(
     imageInfo.arrayLayers = 1;
     imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
     imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-    // for shaders and loading into
-    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    // for shaders and loading into; and for moving out, when memory is defragmented
+    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
     imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
@@ -308,7 +372,22 @@ void SvkMain::InitTexture32Bit(
 
     uint32_t imageMemoryOffset;
     sto.sto_MemoryHandle = gl_VkImageMemPool->Allocate(imageAllocInfo, imageMemoryReq, sto.sto_Memory, imageMemoryOffset);
-    VK_CHECKERROR(r);
+
+    if (sto.sto_MemoryHandle == SVK_MEMORY_INVALID_HANDLE)
+    {
+      // out of video memory, texture stays not uploaded
+      CPrintF("Vulkan error: Can't allocate memory for %ux%u texture.\n", sto.sto_Width, sto.sto_Height);
+
+      vkDestroyImage(gl_VkDevice, sto.sto_Image, nullptr);
+      sto.sto_Image = VK_NULL_HANDLE;
+
+      vkFreeMemory(gl_VkDevice, stagingMemory, nullptr);
+      vkDestroyBuffer(gl_VkDevice, stagingBuffer, nullptr);
+      return;
+    }
+
+    // to find texture, if its memory is moved
+    gl_VkImageMemPool->SetUserData(sto.sto_MemoryHandle, textureId);
     r = vkBindImageMemory(gl_VkDevice, sto.sto_Image, sto.sto_Memory, imageMemoryOffset);
     VK_CHECKERROR(r);
   }
@@ -332,7 +411,7 @@ void SvkMain::InitTexture32Bit(
     region.imageSubresource.baseArrayLayer = 0;
     region.imageSubresource.layerCount = 1;
 
-    regionOffset += mipLevels[i].width * mipLevels[i].height * PixelSize;
+    regionOffset += GetMipLevelSize(format, mipLevels[i].width, mipLevels[i].height);
   }
 
 
@@ -448,4 +527,184 @@ void SvkMain::InitTexture32Bit(
   ASSERT(sto.sto_Image != VK_NULL_HANDLE);
 }
 
+void SvkMain::DefragmentTextures(VkCommandBuffer cmdBuffer, INDEX ctMaxMoves)
+{
+  VkResult r;
+  uint32_t skipped = SVK_MEMORY_INVALID_HANDLE;
+
+  for (INDEX iMove = 0; iMove < ctMaxMoves; iMove++)
+  {
+    uint32_t handle = gl_VkImageMemPool->FindMoveCandidate(skipped);
+    if (handle == SVK_MEMORY_INVALID_HANDLE)
+    {
+      break;
+    }
+
+    // allocation can belong to a texture that is waiting for deletion,
+    // it will be freed anyway, so try the next one
+    uint32_t textureId = gl_VkImageMemPool->GetUserData(handle);
+    SvkTextureObject *psto = gl_VkTextures.TryGet(textureId);
+    if (psto == nullptr || psto->sto_Image == VK_NULL_HANDLE || psto->sto_MemoryHandle != handle)
+    {
+      skipped = handle;
+      continue;
+    }
+
+    SvkTextureObject &sto = *psto;
+
+    // create the same image
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = sto.sto_Format;
+    imageInfo.extent.width = sto.sto_Width;
+    imageInfo.extent.height = sto.sto_Height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = sto.sto_MipLevelCount;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VkImage newImage;
+    r = vkCreateImage(gl_VkDevice, &imageInfo, nullptr, &newImage);
+    VK_CHECKERROR(r);
+
+    VkDeviceMemory newMemory;
+    uint32_t newOffset;
+    uint32_t newHandle = gl_VkImageMemPool->AllocateForMove(handle, newMemory, newOffset);
+    if (newHandle == SVK_MEMORY_INVALID_HANDLE)
+    {
+      vkDestroyImage(gl_VkDevice, newImage, nullptr);
+      break;
+    }
+
+    r = vkBindImageMemory(gl_VkDevice, newImage, newMemory, newOffset);
+    VK_CHECKERROR(r);
+
+    VkImageMemoryBarrier barriers[2] = {};
+    for (uint32_t i = 0; i < 2; i++)
+    {
+      barriers[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+      barriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barriers[i].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+      barriers[i].subresourceRange.baseMipLevel = 0;
+      barriers[i].subresourceRange.levelCount = sto.sto_MipLevelCount;
+      barriers[i].subresourceRange.baseArrayLayer = 0;
+      barriers[i].subresourceRange.layerCount = 1;
+    }
+
+    // old image is read by shaders
+    barriers[0].image = sto.sto_Image;
+    barriers[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barriers[0].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+    barriers[1].image = newImage;
+    barriers[1].srcAccessMask = 0;
+    barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+
+    vkCmdPipelineBarrier(
+      cmdBuffer,
+      VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      0,
+      0, nullptr,
+      0, nullptr,
+      2, barriers);
+
+    // copy all mipmaps
+    const uint32_t MaxMipLevelsCount = 32;
+    VkImageCopy regions[MaxMipLevelsCount];
+    memset(regions, 0, sto.sto_MipLevelCount * sizeof(VkImageCopy));
+
+    for (uint32_t i = 0; i < sto.sto_MipLevelCount; i++)
+    {
+      VkImageCopy &region = regions[i];
+      region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+      region.srcSubresource.mipLevel = i;
+      region.srcSubresource.layerCount = 1;
+      region.dstSubresource = region.srcSubresource;
+      region.extent.width = Max(sto.sto_Width >> i, 1U);
+      region.extent.height = Max(sto.sto_Height >> i, 1U);
+      region.extent.depth = 1;
+    }
+
+    vkCmdCopyImage(
+      cmdBuffer,
+      sto.sto_Image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+      newImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      sto.sto_MipLevelCount, regions);
+
+    // old one is not read anymore, so its layout doesn't matter
+    barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    vkCmdPipelineBarrier(
+      cmdBuffer,
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+      0,
+      0, nullptr,
+      0, nullptr,
+      1, &barriers[1]);
+
+    VkImageViewCreateInfo viewInfo = {};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = sto.sto_Format;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.baseMipLevel = 0;
+    viewInfo.subresourceRange.levelCount = sto.sto_MipLevelCount;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+    viewInfo.image = newImage;
+
+    VkImageView newImageView;
+    r = vkCreateImageView(gl_VkDevice, &viewInfo, nullptr, &newImageView);
+    VK_CHECKERROR(r);
+
+    // old image and its memory are freed, when current cmd buffer is done
+    gl_VkTexturesToDelete[gl_VkCmdBufferCurrent]->Push() = sto;
+
+    sto.sto_Image = newImage;
+    sto.sto_ImageView = newImageView;
+    sto.sto_Memory = newMemory;
+    sto.sto_MemoryHandle = newHandle;
+  }
+}
+
+void SvkMain::PrintTextureMemoryInfo()
+{
+  SvkMemoryStats stats;
+  gl_VkImageMemPool->GetStats(stats);
+
+  VkDeviceSize freeBytes = stats.sms_ChunkBytes - stats.sms_UsedBytes;
+  float fragmentation = freeBytes > 0 ? 1.0f - (float)stats.sms_LargestFreeBlock / freeBytes : 0.0f;
+
+  CPrintF("Vulkan texture memory:\n");
+  CPrintF("  %u chunks, %u KB\n", stats.sms_ChunkCount, (uint32_t)(stats.sms_ChunkBytes / 1024));
+  CPrintF("  %u allocations, %u KB used\n", stats.sms_AllocationCount, (uint32_t)(stats.sms_UsedBytes / 1024));
+  CPrintF("  %u free blocks, largest is %u KB, fragmentation %.1f%%\n",
+    stats.sms_FreeBlockCount, (uint32_t)(stats.sms_LargestFreeBlock / 1024), fragmentation * 100.0f);
+
+  if (!gl_VkMemoryBudgetSupported)
+  {
+    CPrintF("  budget is unknown (no VK_EXT_memory_budget)\n");
+    return;
+  }
+
+  const uint32_t memoryTypeIndex = GetMemoryTypeIndex(~0U, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  CPrintF("  %u KB left in device local heap budget\n",
+    (uint32_t)(gl_VkImageMemBackend->GetBudget(memoryTypeIndex) / 1024));
+}
+
 #endif
\ No newline at end of file
@@ -487,7 +487,13 @@ void SvkMain::ClearColor(int32_t x, int32_t y, uint32_t width, uint32_t height,
   cr.rect.offset.x = x;
   cr.rect.offset.y = y;
 
-  vkCmdClearAttachments(GetCurrentCmdBuffer(), 1, &ca, 1, &cr);
+  FlushDrawBatch();
+
+  SvkRenderCommand rc;
+  rc.src_Type = SRC_CLEAR;
+  rc.src_ClearAttachment = ca;
+  rc.src_ClearRect = cr;
+  AddRenderCommand(rc);
 }
 
 void SvkMain::ClearDepth(int32_t x, int32_t y, uint32_t width, uint32_t height, float depth)
@@ -534,7 +540,13 @@ void SvkMain::ClearDepth(int32_t x, int32_t y, uint32_t width, uint32_t height,
   cr.rect.offset.x = x;
   cr.rect.offset.y = y;
 
-  vkCmdClearAttachments(GetCurrentCmdBuffer(), 1, &ca, 1, &cr);
+  FlushDrawBatch();
+
+  SvkRenderCommand rc;
+  rc.src_Type = SRC_CLEAR;
+  rc.src_ClearAttachment = ca;
+  rc.src_ClearRect = cr;
+  AddRenderCommand(rc);
 }
 
 void SvkMain::ClearColor(float *rgba)
@@ -41,7 +41,9 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #define SVK_DYNAMIC_VERTEX_BUFFER_START_SIZE	  (8 * 1024 * 1024)
 #define SVK_DYNAMIC_INDEX_BUFFER_START_SIZE	    (2 * 1024 * 1024)
 #define SVK_DYNAMIC_UNIFORM_BUFFER_START_SIZE   (256 * 1024)
-#define SVK_DYNAMIC_UNIFORM_MAX_ALLOC_SIZE      1024
+#define SVK_DYNAMIC_UNIFORM_MAX_ALLOC_SIZE      (16 * 1024)
+// matrices are stored in windows of the uniform buffer, draws select them by first instance
+#define SVK_MATRICES_PER_WINDOW                 (SVK_DYNAMIC_UNIFORM_MAX_ALLOC_SIZE / (16 * sizeof(float)))
 
 #define SVK_RENDERPASS_COLOR_ATTACHMENT_INDEX   0
 #define SVK_RENDERPASS_DEPTH_ATTACHMENT_INDEX   1
@@ -50,11 +52,14 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #define SVK_OCCLUSION_QUERIES_MAX               256
 
+#define SVK_MAX_RECORD_THREADS                  8
+
 struct SvkTextureObject
 {
 public:
   uint32_t          sto_Width;
   uint32_t          sto_Height;
+  uint32_t          sto_MipLevelCount;
   VkFormat          sto_Format;
 
   VkImage           sto_Image;
@@ -77,6 +82,7 @@ public:
   void Reset()
   {
     sto_Width = sto_Height = 0;
+    sto_MipLevelCount = 0;
     sto_Format = VK_FORMAT_UNDEFINED;
     sto_Image = VK_NULL_HANDLE;
     sto_ImageView = VK_NULL_HANDLE;
@@ -120,6 +126,65 @@ struct SvkPipelineState
   VkDevice                sps_Device;
   SvkPipelineStateFlags   sps_Flags;
   VkPipeline              sps_Pipeline;
+  uint32_t                sps_LevelIndex;   // last level that used this pipeline
+};
+
+// consecutive draws with the same state that are recorded as one indexed draw
+struct SvkDrawBatch
+{
+  SvkPipelineStateFlags   sdw_Flags;
+  VkDescriptorSet         sdw_Sets[5];
+  uint32_t                sdw_UniformOffset;
+  uint32_t                sdw_MatrixIndex;
+  float                   sdw_TextureColorScale;
+  VkBuffer                sdw_VertexBuffer;
+  VkDeviceSize            sdw_VertexStart;
+  VkBuffer                sdw_IndexBuffer;
+  VkDeviceSize            sdw_IndexStart;
+  VkDeviceSize            sdw_IndexEnd;
+  uint32_t                sdw_IndexCount;   // 0 if there's no pending batch
+};
+
+enum SvkRenderCommandType
+{
+  SRC_DRAW,
+  SRC_VIEWPORT,
+  SRC_CLEAR,
+  SRC_OCCLUSIONQUERY,
+};
+
+// command inside of render pass; it's either recorded immediately or
+// kept until the end of frame to be recorded into secondary cmd buffers
+struct SvkRenderCommand
+{
+  SvkRenderCommandType    src_Type;
+  VkPipeline              src_Pipeline;       // draw and occlusion query
+  SvkDrawBatch            src_Draw;           // draw and occlusion query (only buffers)
+  VkViewport              src_Viewport;
+  VkRect2D                src_Scissor;
+  VkClearAttachment       src_ClearAttachment;
+  VkClearRect             src_ClearRect;
+  uint32_t                src_QueryId;
+};
+
+// what is bound in one cmd buffer; counters are kept here and not
+// in profile, as cmd buffers can be recorded by worker threads
+struct SvkBoundState
+{
+  VkPipeline              sbs_Pipeline;
+  VkDescriptorSet         sbs_Sets[5];
+  uint32_t                sbs_UniformOffset;
+  bool                    sbs_SetsValid;
+  float                   sbs_TextureColorScale;
+  bool                    sbs_ScaleValid;
+  VkBuffer                sbs_VertexBuffer;
+  VkDeviceSize            sbs_VertexOffset;
+  VkBuffer                sbs_IndexBuffer;
+
+  uint32_t                sbs_ctDrawCalls;
+  uint32_t                sbs_ctPipelineBinds;
+  uint32_t                sbs_ctDescriptorBinds;
+  uint32_t                sbs_ctBufferBinds;
 };
 
 struct SvkSamplerObject
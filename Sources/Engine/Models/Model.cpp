@@ -366,6 +366,7 @@ SLONG CModelData::GetUsedMemory(void)
 	  slUsed += md_MipInfos[i].mmpi_Polygons.Count()*sizeof(struct ModelPolygon);
     slUsed += md_MipInfos[i].mmpi_TextureVertices.Count()*sizeof(struct ModelTextureVertex);
     slUsed += md_MipInfos[i].mmpi_MappingSurfaces.Count()*sizeof(struct MappingSurface);
+    slUsed += md_MipInfos[i].mmpi_aswFrames.Count()*sizeof(SWORD);
   }
 
   return slUsed;
@@ -850,6 +851,7 @@ void CModelData::LinkDataForSurfaces(BOOL bFirstMip)
 ModelMipInfo::ModelMipInfo(void)
 {
   mmpi_ulFlags = MM_PATCHES_VISIBLE | MM_ATTACHED_MODELS_VISIBLE;
+  mmpi_ctFrameStride = 0;
 }
 
 //--------------------------------------------------------------------------------------------
@@ -1802,6 +1804,33 @@ void CModelObject::Copy(CModelObject &moOther)
   mo_toSpecular   .Copy(moOther.mo_toSpecular   );
   mo_toBump       .Copy(moOther.mo_toBump       );
 
+  // if this object already has attachments on same positions (e.g. a refreshed predictor)
+  BOOL bSameAttachments = mo_lhAttachments.Count()==moOther.mo_lhAttachments.Count();
+  if (bSameAttachments) {
+    LISTITER(CAttachmentModelObject, amo_lnInMain) itamoThis(mo_lhAttachments);
+    FOREACHINLIST( CAttachmentModelObject, amo_lnInMain, moOther.mo_lhAttachments, itamo) {
+      if (itamoThis->amo_iAttachedPosition!=itamo->amo_iAttachedPosition) {
+        bSameAttachments = FALSE;
+        break;
+      }
+      itamoThis.MoveToNext();
+    }
+  }
+  if (bSameAttachments) {
+    // copy them in place
+    LISTITER(CAttachmentModelObject, amo_lnInMain) itamoThis(mo_lhAttachments);
+    FOREACHINLIST( CAttachmentModelObject, amo_lnInMain, moOther.mo_lhAttachments, itamo) {
+      CAttachmentModelObject &amoOther = *itamo;
+      CAttachmentModelObject &amo = *itamoThis;
+      amo.amo_plRelative = amoOther.amo_plRelative;
+      amo.amo_moModelObject.Copy(amoOther.amo_moModelObject);
+      itamoThis.MoveToNext();
+    }
+    return;
+  }
+
+  // otherwise make new ones
+  RemoveAllAttachmentModels();
   FOREACHINLIST( CAttachmentModelObject, amo_lnInMain, moOther.mo_lhAttachments, itamo) {
     CAttachmentModelObject &amoOther = *itamo;
     CAttachmentModelObject &amo = *AddAttachmentModel(amoOther.amo_iAttachedPosition);
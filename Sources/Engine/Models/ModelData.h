@@ -68,6 +68,8 @@ struct ENGINE_API ModelMipInfo
   ULONG mmpi_ulLayerFlags;              // all texture layers needed in this mip
   INDEX mmpi_ctTriangles;               // total triangles in this mip
   CStaticStackArray<INDEX> mmpi_aiElements;
+  CStaticArray<SWORD> mmpi_aswFrames;    // all frames of this mip as runs of x,y,z and normal x,y,z (for SIMD unpacking)
+  INDEX mmpi_ctFrameStride;             // number of words per one frame in above array
 
 	void Clear();								 // clears this mip model's arays and their sub-arrays, dealocates memory
 	void Read_t( CTStream *istrFile, BOOL bReadPolygonalPatches, BOOL bReadPolygonsPerSurface,
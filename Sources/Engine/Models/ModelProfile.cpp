@@ -101,6 +101,13 @@ CModelProfile::CModelProfile(void)
   SETCOUNTERNAME(PCI_SHADOWTRIANGLES_USEDMIP,  "ShadowTriangles_usedmip");
 
   SETCOUNTERNAME(PCI_VIEW_TRIANGLES, "View_Triangles");
+  SETCOUNTERNAME(PCI_UNPACK_CACHEHITS,   "Unpack_cache_hits");
+  SETCOUNTERNAME(PCI_UNPACK_CACHEMISSES, "Unpack_cache_misses");
+  SETCOUNTERNAME(PCI_SKA_POSE_CACHEHITS,   "Ska_pose_cache_hits");
+  SETCOUNTERNAME(PCI_SKA_POSE_CACHEMISSES, "Ska_pose_cache_misses");
+  SETCOUNTERNAME(PCI_SKA_SKIN_CACHEHITS,   "Ska_skin_cache_hits");
+  SETCOUNTERNAME(PCI_SKA_SKIN_CACHEMISSES, "Ska_skin_cache_misses");
+  SETCOUNTERNAME(PCI_SKA_CACHE_SAVEDUS,    "Ska_cache_saved_us");
 
   SETCOUNTERNAME(PCI_MASK_TRIANGLES, "Mask_Triangles");
   SETCOUNTERNAME(PCI_MASK_POLYGONS,  "Mask_Polygons");
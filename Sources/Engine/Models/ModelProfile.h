@@ -101,6 +101,13 @@ public:
     PCI_SHADOWTRIANGLES_USEDMIP,
 
     PCI_VIEW_TRIANGLES,
+    PCI_UNPACK_CACHEHITS,
+    PCI_UNPACK_CACHEMISSES,
+    PCI_SKA_POSE_CACHEHITS,
+    PCI_SKA_POSE_CACHEMISSES,
+    PCI_SKA_SKIN_CACHEHITS,
+    PCI_SKA_SKIN_CACHEMISSES,
+    PCI_SKA_CACHE_SAVEDUS,
 
     PCI_MASK_TRIANGLES,
     PCI_MASK_POLYGONS,
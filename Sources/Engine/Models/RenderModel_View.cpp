@@ -15,6 +15,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA. */
 
  #include "StdH.h"
+#include <emmintrin.h>
 
 #include <Engine/Base/Statistics_internal.h>
 #include <Engine/Base/Console.h>
@@ -28,6 +29,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <Engine/Graphics/Fog_internal.h>
 #include <Engine/Base/Lists.inl>
 #include <Engine/World/WorldEditingProfile.h>
+#include <Engine/Base/Timer.h>
+#include <Engine/Templates/Stock_CModelData.h>
 
 #include <Engine/Templates/StaticArray.cpp>
 #include <Engine/Templates/StaticStackArray.cpp>
@@ -44,6 +47,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #define ASMOPT 1
 
 extern INDEX mdl_bRenderBump;
+extern INDEX mdl_bPreparedFrames;
+extern INDEX mdl_bCacheUnpackedFrames;
 
 extern BOOL CVA_bModels;
 extern BOOL GFX_bTruform;
@@ -573,14 +578,79 @@ static void PrepareModelMipForRendering( CModelData &md, INDEX iMip)
 }
 
 
+// scale of normals in prepared frames (1.15 fixed point)
+#define NORMAL_FIX      32767.0f
+#define NORMAL_UNFIX   (1.0f/32767.0f)
+
+
+// prepare all frames of mip model for SIMD unpacking; for each frame, vertices used in this mip
+// are stored in mip order as runs of x, y, z and normal x, y, z (each run padded to 4 vertices)
+static void PrepareModelMipFrames( CModelData &md, INDEX iMip)
+{
+  ModelMipInfo &mmi = md.md_MipInfos[iMip];
+  const INDEX ctMipVx  = mmi.mmpi_ctMipVx;
+  const INDEX ctRun    = (ctMipVx+3) & ~3;
+  const INDEX ctFrames = md.md_FramesCt;
+  const BOOL b16Bit = md.md_Flags & MF_COMPRESSED_16BIT;
+  mmi.mmpi_aswFrames.Clear();
+  mmi.mmpi_ctFrameStride = ctRun*6;
+  if( ctMipVx==0 || ctFrames==0) return;
+  mmi.mmpi_aswFrames.New( ctFrames*mmi.mmpi_ctFrameStride);
+  memset( &mmi.mmpi_aswFrames[0], 0, ctFrames*mmi.mmpi_ctFrameStride*sizeof(SWORD));
+
+  // for each frame
+  for( INDEX iFrame=0; iFrame<ctFrames; iFrame++) {
+    SWORD *pswFrame = &mmi.mmpi_aswFrames[iFrame*mmi.mmpi_ctFrameStride];
+    // for each vertex in mip
+    for( INDEX iMipVx=0; iMipVx<ctMipVx; iMipVx++) {
+      const INDEX iFrameVx = iFrame*md.md_VerticesCt + mmi.mmpi_auwMipToMdl[iMipVx];
+      FLOAT3D vNormal;
+      if( b16Bit) {
+        const ModelFrameVertex16 &mfv = md.md_FrameVertices16[iFrameVx];
+        pswFrame[ctRun*0+iMipVx] = mfv.mfv_SWPoint(1);
+        pswFrame[ctRun*1+iMipVx] = mfv.mfv_SWPoint(2);
+        pswFrame[ctRun*2+iMipVx] = mfv.mfv_SWPoint(3);
+        const FLOAT fSinH = pfSinTable[mfv.mfv_ubNormH];
+        const FLOAT fSinP = pfSinTable[mfv.mfv_ubNormP];
+        const FLOAT fCosH = pfCosTable[mfv.mfv_ubNormH];
+        const FLOAT fCosP = pfCosTable[mfv.mfv_ubNormP];
+        vNormal = FLOAT3D( -fSinH*fCosP, +fSinP, -fCosH*fCosP);
+      } else {
+        const ModelFrameVertex8 &mfv = md.md_FrameVertices8[iFrameVx];
+        pswFrame[ctRun*0+iMipVx] = mfv.mfv_SBPoint(1);
+        pswFrame[ctRun*1+iMipVx] = mfv.mfv_SBPoint(2);
+        pswFrame[ctRun*2+iMipVx] = mfv.mfv_SBPoint(3);
+        vNormal = avGouraudNormals[mfv.mfv_NormIndex];
+      }
+      pswFrame[ctRun*3+iMipVx] = (SWORD)FloatToInt( vNormal(1)*NORMAL_FIX);
+      pswFrame[ctRun*4+iMipVx] = (SWORD)FloatToInt( vNormal(2)*NORMAL_FIX);
+      pswFrame[ctRun*5+iMipVx] = (SWORD)FloatToInt( vNormal(3)*NORMAL_FIX);
+    }
+  }
+}
+
+
 extern void PrepareModelForRendering( CModelData &md)
 {
   // do nothing, if the model has already been initialized for rendering
-  if( md.md_bPreparedForRendering) return;
+  if( md.md_bPreparedForRendering) {
+    // except making prepared frames, if they were turned off when it was prepared
+    if( mdl_bPreparedFrames && md.md_MipCt>0) {
+      const ModelMipInfo &mmi = md.md_MipInfos[0];
+      if( mmi.mmpi_ctFrameStride != ((mmi.mmpi_ctMipVx+3)&~3)*6) {
+        for( INDEX iMip=0; iMip<md.md_MipCt; iMip++) PrepareModelMipFrames( md, iMip);
+      }
+    }
+    return;
+  }
   _pfModelProfile.StartTimer( CModelProfile::PTI_VIEW_PREPAREFORRENDERING);
   _pfWorldEditingProfile.StartTimer(CWorldEditingProfile::PTI_TRISTRIPMODELS);
-  // prepare each mip model
-  for( INDEX iMip=0; iMip<md.md_MipCt; iMip++) PrepareModelMipForRendering( md, iMip);
+  // prepare each mip model (prepared frames are kept besides compressed ones, which are still
+  // needed for collision and shadows, so they are made only if they are going to be used)
+  for( INDEX iMip=0; iMip<md.md_MipCt; iMip++) {
+    PrepareModelMipForRendering( md, iMip);
+    if( mdl_bPreparedFrames) PrepareModelMipFrames( md, iMip);
+  }
   // mark as prepared
   md.md_bPreparedForRendering = TRUE;
   // all done
@@ -1078,25 +1148,21 @@ static void AttenuateColor( const UBYTE *pshdMip, const INDEX ctVertices)
 }
 
 
-// unpack vertices (and eventually normals) of one frame
-static void UnpackFrame( CRenderModel &rm, BOOL bKeepNormals)
+// unpack vertices, shades and eventually normals straight from compressed frames
+static void UnpackCompressedFrame( CRenderModel &rm, BOOL bKeepNormals, SWORD *pswMipCol)
 {
-  _pfModelProfile.StartTimer( CModelProfile::PTI_VIEW_INIT_UNPACK);
-  _pfModelProfile.IncrementTimerAveragingCounter( CModelProfile::PTI_VIEW_INIT_UNPACK, _ctAllMipVx);
-
   // cache lerp ratio, compression, stretch and light factors
-  FLOAT fStretchX = rm.rm_vStretch(1);
-  FLOAT fStretchY = rm.rm_vStretch(2);
-  FLOAT fStretchZ = rm.rm_vStretch(3);
-  FLOAT fOffsetX  = rm.rm_vOffset(1);
-  FLOAT fOffsetY  = rm.rm_vOffset(2);
-  FLOAT fOffsetZ  = rm.rm_vOffset(3);
+  const FLOAT fStretchX = rm.rm_vStretch(1);
+  const FLOAT fStretchY = rm.rm_vStretch(2);
+  const FLOAT fStretchZ = rm.rm_vStretch(3);
+  const FLOAT fOffsetX  = rm.rm_vOffset(1);
+  const FLOAT fOffsetY  = rm.rm_vOffset(2);
+  const FLOAT fOffsetZ  = rm.rm_vOffset(3);
   const FLOAT fLerpRatio = rm.rm_fRatio;
   const FLOAT fLightObjX = rm.rm_vLightObj(1) * -255.0f;  // multiplier is made here, so it doesn't need to be done per-vertex
   const FLOAT fLightObjY = rm.rm_vLightObj(2) * -255.0f;
   const FLOAT fLightObjZ = rm.rm_vLightObj(3) * -255.0f;
   const UWORD *puwMipToMdl = (const UWORD*)&rm.rm_pmmiMip->mmpi_auwMipToMdl[0];
-        SWORD *pswMipCol   = (SWORD*)&pcolMipBase[_ctAllMipVx>>1];
 
   // if 16 bit compression
   if( rm.rm_pmdModelData->md_Flags & MF_COMPRESSED_16BIT)
@@ -1106,90 +1172,6 @@ static void UnpackFrame( CRenderModel &rm, BOOL bKeepNormals)
     const ModelFrameVertex16 *pFrame1 = rm.rm_pFrame16_1;
     if( pFrame0==pFrame1)
     {
-#if ASMOPT == 1
-      // for each vertex in mip
-      const SLONG fixLerpRatio = FloatToInt(fLerpRatio*256.0f); // fix 8:8
-      SLONG slTmp1, slTmp2, slTmp3;
-      __asm {
-        mov     edi,D [pvtxMipBase]
-        mov     ebx,D [pswMipCol]
-        xor     ecx,ecx
-vtxLoop16:
-        push    ecx
-        mov     esi,D [puwMipToMdl]
-        movzx   eax,W [esi+ecx*2]
-        mov     esi,D [pFrame0]
-        lea     esi,[esi+eax*8]
-        // store vertex
-        movsx   eax,W [esi]ModelFrameVertex16.mfv_SWPoint[0]
-        movsx   ecx,W [esi]ModelFrameVertex16.mfv_SWPoint[2]
-        movsx   edx,W [esi]ModelFrameVertex16.mfv_SWPoint[4]
-        mov     D [slTmp1],eax
-        mov     D [slTmp2],ecx
-        mov     D [slTmp3],edx
-        fild    D [slTmp1]
-        fsub    D [fOffsetX]
-        fmul    D [fStretchX]
-        fild    D [slTmp2]
-        fsub    D [fOffsetY]
-        fmul    D [fStretchY]
-        fild    D [slTmp3]
-        fsub    D [fOffsetZ]
-        fmul    D [fStretchZ]
-        fxch    st(2)
-        fstp    D [edi]GFXVertex3.x
-        fstp    D [edi]GFXVertex3.y
-        fstp    D [edi]GFXVertex3.z
-        // determine normal
-        movzx   eax,B [esi]ModelFrameVertex16.mfv_ubNormH
-        movzx   edx,B [esi]ModelFrameVertex16.mfv_ubNormP
-        mov     esi,D [pfSinTable]
-        fld     D [esi+eax*4 +0]
-        fmul    D [esi+edx*4 +64*4]
-        fld     D [esi+eax*4 +64*4]
-        fmul    D [esi+edx*4 +64*4]
-        fxch    st(1)
-        fstp    D [slTmp1]
-        fstp    D [slTmp3]
-        mov     eax,D [slTmp1]
-        mov     ecx,D [slTmp3]
-        xor     eax,0x80000000     
-        xor     ecx,0x80000000     
-        mov     D [slTmp1],eax
-        mov     D [slTmp3],ecx
-        // determine vertex shade
-        fld     D [slTmp1]
-        fmul    D [fLightObjX]
-        fld     D [esi+edx*4 +0]
-        fmul    D [fLightObjY]
-        fld     D [slTmp3]
-        fmul    D [fLightObjZ]
-        fxch    st(2)
-        faddp   st(1),st(0)
-        faddp   st(1),st(0)
-        fistp   D [ebx]
-        // store normal (if needed)
-        cmp     D [bKeepNormals],0
-        je      vtxNext16
-        mov     ecx,D [esp]
-        imul    ecx,3*4
-        add     ecx,D [pnorMipBase]
-        mov     eax,D [slTmp1]
-        mov     edx,D [esi+edx*4 +0]
-        mov     esi,D [slTmp3]
-        mov     D [ecx]GFXNormal.nx, eax
-        mov     D [ecx]GFXNormal.ny, edx
-        mov     D [ecx]GFXNormal.nz, esi
-        // advance to next vertex
-vtxNext16:
-        pop     ecx
-        add     edi,3*4
-        add     ebx,1*2
-        inc     ecx
-        cmp     ecx,D [_ctAllMipVx]
-        jl      vtxLoop16
-      }
-#else
       // for each vertex in mip
       for( INDEX iMipVx=0; iMipVx<_ctAllMipVx; iMipVx++) {
         // get destination for unpacking
@@ -1217,140 +1199,10 @@ vtxNext16:
           pnorMipBase[iMipVx].nz = fNZ;
         }
       }
-#endif
     }
     // if lerping
     else
     {
-#if ASMOPT == 1
-      // for each vertex in mip
-      const SLONG fixLerpRatio = FloatToInt(fLerpRatio*256.0f); // fix 8:8
-      SLONG slTmp1, slTmp2, slTmp3;
-      __asm {
-        mov     edi,D [pvtxMipBase]
-        mov     ebx,D [pswMipCol]
-        xor     ecx,ecx
-vtxLoop16L:
-        push    ecx
-        push    ebx
-        mov     esi,D [puwMipToMdl]
-        movzx   ebx,W [esi+ecx*2]
-        mov     esi,D [pFrame0]
-        mov     ecx,D [pFrame1]
-        // lerp vertex
-        movsx   eax,W [esi+ebx*8]ModelFrameVertex16.mfv_SWPoint[0]
-        movsx   edx,W [ecx+ebx*8]ModelFrameVertex16.mfv_SWPoint[0]
-        sub     edx,eax
-        imul    edx,D [fixLerpRatio]
-        sar     edx,8
-        add     eax,edx
-        mov     D [slTmp1],eax
-        movsx   eax,W [esi+ebx*8]ModelFrameVertex16.mfv_SWPoint[2]
-        movsx   edx,W [ecx+ebx*8]ModelFrameVertex16.mfv_SWPoint[2]
-        sub     edx,eax
-        imul    edx,D [fixLerpRatio]
-        sar     edx,8
-        add     eax,edx
-        mov     D [slTmp2],eax
-        movsx   eax,W [esi+ebx*8]ModelFrameVertex16.mfv_SWPoint[4]
-        movsx   edx,W [ecx+ebx*8]ModelFrameVertex16.mfv_SWPoint[4]
-        sub     edx,eax
-        imul    edx,D [fixLerpRatio]
-        sar     edx,8
-        add     eax,edx
-        mov     D [slTmp3],eax
-        // store vertex
-        fild    D [slTmp1]
-        fsub    D [fOffsetX]
-        fmul    D [fStretchX]
-        fild    D [slTmp2]
-        fsub    D [fOffsetY]
-        fmul    D [fStretchY]
-        fild    D [slTmp3]
-        fsub    D [fOffsetZ]
-        fmul    D [fStretchZ]
-        fxch    st(2)
-        fstp    D [edi]GFXVertex3.x
-        fstp    D [edi]GFXVertex3.y
-        fstp    D [edi]GFXVertex3.z
-        // load normals
-        movzx   eax,B [esi+ebx*8]ModelFrameVertex16.mfv_ubNormH
-        movzx   edx,B [esi+ebx*8]ModelFrameVertex16.mfv_ubNormP
-        mov     esi,D [pfSinTable]
-        fld     D [esi+eax*4 +0]
-        fmul    D [esi+edx*4 +64*4]
-        fld     D [esi+edx*4 +0]
-        fld     D [esi+eax*4 +64*4]
-        fmul    D [esi+edx*4 +64*4]  // fCosH0*fCosP0, fSinP0, fSinH0*fCosP0  
-        movzx   eax,B [ecx+ebx*8]ModelFrameVertex16.mfv_ubNormH
-        movzx   edx,B [ecx+ebx*8]ModelFrameVertex16.mfv_ubNormP
-        fld     D [esi+eax*4 +0]
-        fmul    D [esi+edx*4 +64*4]
-        fld     D [esi+edx*4 +0]
-        fld     D [esi+eax*4 +64*4]
-        fmul    D [esi+edx*4 +64*4]  // fCosH1*fCosP1, fSinP1, fSinH1*fCosP1,  fCosH0*fCosP0, fSinP0, fSinH0*fCosP0
-        // lerp normals
-        fxch    st(5)        // SH0CP0,        SP1,     SH1CP1,        CH0CP0, SP0,    CH1CP1
-        fsub    st(2),st(0)
-        fxch    st(4)        // SP0,           SP1,     SH1CP1-SH0CP0, CH0CP0, SH0CP0, CH1CP1
-        fsub    st(1),st(0)  // SP0,           SP1-SP0, SH1CP1-SH0CP0, CH0CP0, SH0CP0, CH1CP1
-        fxch    st(3)        // CH0CP0,        SP1-SP0, SH1CP1-SH0CP0, SP0,    SH0CP0, CH1CP1
-        fsub    st(5),st(0)  // CH0CP0,        SP1-SP0, SH1CP1-SH0CP0, SP0,    SH0CP0, CH1CP1-CH0CP0
-        fxch    st(2)        // SH1CP1-SH0CP0, SP1-SP0, CH0CP0,        SP0,    SH0CP0, CH1CP1-CH0CP0
-        fmul    D [fLerpRatio]
-        fxch    st(1)        // SP1-SP0,       lSH1CP1, CH0CP0,        SP0,    SH0CP0, CH1CP1-CH0CP0
-        fmul    D [fLerpRatio]
-        fxch    st(5)        // CH1CP1-CH0CP0, lSH1CP1, CH0CP0,        SP0,    SH0CP0, lSP1SP0
-        fmul    D [fLerpRatio]
-        fxch    st(1)        // lSH1CP1, lCH1CP1, CH0CP0,  SP0, SH0CP0, lSP1SP0
-        faddp   st(4),st(0)  // lCH1CP1, CH0CP0,  SP0,     fNX, lSP1SP0
-        fxch    st(2)        // SP0,     CH0CP0,  lCH1CP1, fNX, lSP1SP0
-        faddp   st(4),st(0)  // CH0CP0,  lCH1CP1, fNX,     fNY
-        faddp   st(1),st(0)  // -fNZ, -fNX,  fNY
-        fxch    st(2)        //  fNY, -fNX, -fNZ
-        fstp    D [slTmp2]
-        fstp    D [slTmp1]
-        fstp    D [slTmp3]
-        pop     ebx
-        mov     eax,D [slTmp1]
-        mov     ecx,D [slTmp3]
-        xor     eax,0x80000000     
-        xor     ecx,0x80000000     
-        mov     D [slTmp1],eax
-        mov     D [slTmp3],ecx
-        // determine vertex shade
-        fld     D [slTmp1]
-        fmul    D [fLightObjX]
-        fld     D [slTmp2]
-        fmul    D [fLightObjY]
-        fld     D [slTmp3]
-        fmul    D [fLightObjZ]
-        fxch    st(2)
-        faddp   st(1),st(0)
-        faddp   st(1),st(0)
-        fistp   D [ebx]
-        // store lerped normal (if needed)
-        cmp     D [bKeepNormals],0
-        je      vtxNext16L
-        mov     ecx,D [esp]
-        imul    ecx,3*4
-        add     ecx,D [pnorMipBase]
-        mov     eax,D [slTmp1]
-        mov     edx,D [slTmp2]
-        mov     esi,D [slTmp3]
-        mov     D [ecx]GFXNormal.nx, eax
-        mov     D [ecx]GFXNormal.ny, edx
-        mov     D [ecx]GFXNormal.nz, esi
-        // advance to next vertex
-vtxNext16L:
-        pop     ecx
-        add     edi,3*4
-        add     ebx,1*2
-        inc     ecx
-        cmp     ecx,D [_ctAllMipVx]
-        jl      vtxLoop16L
-      }
-#else
       // for each vertex in mip
       for( INDEX iMipVx=0; iMipVx<_ctAllMipVx; iMipVx++) {
         // get destination for unpacking
@@ -1379,7 +1231,6 @@ vtxNext16L:
           pnorMipBase[iMipVx].nz = fNZ;
         }
       }
-#endif
 
     }
   }
@@ -1391,76 +1242,6 @@ vtxNext16L:
     // if no lerping
     if( pFrame0==pFrame1)
     {
-#if ASMOPT == 1
-      // for each vertex in mip
-      const SLONG fixLerpRatio = FloatToInt(fLerpRatio*256.0f); // fix 8:8
-      SLONG slTmp1, slTmp2, slTmp3;
-      __asm {
-        mov     edi,D [pvtxMipBase]
-        mov     ebx,D [pswMipCol]
-        xor     ecx,ecx
-vtxLoop8:
-        push    ecx
-        mov     esi,D [puwMipToMdl]
-        movzx   eax,W [esi+ecx*2]
-        mov     esi,D [pFrame0]
-        lea     esi,[esi+eax*4]
-        // store vertex
-        movsx   eax,B [esi]ModelFrameVertex8.mfv_SBPoint[0]
-        movsx   ecx,B [esi]ModelFrameVertex8.mfv_SBPoint[1]
-        movsx   edx,B [esi]ModelFrameVertex8.mfv_SBPoint[2]
-        mov     D [slTmp1],eax
-        mov     D [slTmp2],ecx
-        mov     D [slTmp3],edx
-        fild    D [slTmp1]
-        fsub    D [fOffsetX]
-        fmul    D [fStretchX]
-        fild    D [slTmp2]
-        fsub    D [fOffsetY]
-        fmul    D [fStretchY]
-        fild    D [slTmp3]
-        fsub    D [fOffsetZ]
-        fmul    D [fStretchZ]
-        fxch    st(2)
-        fstp    D [edi]GFXVertex3.x
-        fstp    D [edi]GFXVertex3.y
-        fstp    D [edi]GFXVertex3.z
-        // determine normal
-        movzx   eax,B [esi]ModelFrameVertex8.mfv_NormIndex
-        lea     esi,[eax*2+eax]
-        // determine vertex shade
-        fld     D [avGouraudNormals+ esi*4 +0]
-        fmul    D [fLightObjX]
-        fld     D [avGouraudNormals+ esi*4 +4]
-        fmul    D [fLightObjY]
-        fld     D [avGouraudNormals+ esi*4 +8]
-        fmul    D [fLightObjZ]
-        fxch    st(2)
-        faddp   st(1),st(0)
-        faddp   st(1),st(0)
-        fistp   D [ebx]
-        // store lerped normal (if needed)
-        cmp     D [bKeepNormals],0
-        je      vtxNext8
-        mov     ecx,D [esp]
-        imul    ecx,3*4
-        add     ecx,D [pnorMipBase]
-        mov     eax,D [avGouraudNormals+ esi*4 +0]
-        mov     edx,D [avGouraudNormals+ esi*4 +4]
-        mov     esi,D [avGouraudNormals+ esi*4 +8]
-        mov     D [ecx]GFXNormal.nx, eax
-        mov     D [ecx]GFXNormal.ny, edx
-        mov     D [ecx]GFXNormal.nz, esi
-        // advance to next vertex
-vtxNext8:
-        pop     ecx
-        add     edi,3*4
-        add     ebx,1*2
-        inc     ecx
-        cmp     ecx,D [_ctAllMipVx]
-        jl      vtxLoop8
-      }
-#else
       // for each vertex in mip
       for( INDEX iMipVx=0; iMipVx<_ctAllMipVx; iMipVx++) {
         // get destination for unpacking
@@ -1485,126 +1266,10 @@ vtxNext8:
           pnorMipBase[iMipVx].nz = fNZ;
         }
       }
-#endif
     }
     // if lerping
     else
     {
-#if ASMOPT == 1
-      const SLONG fixLerpRatio = FloatToInt(fLerpRatio*256.0f); // fix 8:8
-      SLONG slTmp1, slTmp2, slTmp3;
-      // re-adjust stretching factors because of fixint lerping (divide by 256)
-      fStretchX*=0.00390625f;  fOffsetX*=256.0f;  
-      fStretchY*=0.00390625f;  fOffsetY*=256.0f;
-      fStretchZ*=0.00390625f;  fOffsetZ*=256.0f;
-      // for each vertex in mip
-      __asm {
-        mov     edi,D [pvtxMipBase]
-        mov     ebx,D [pswMipCol]
-        xor     ecx,ecx
-vtxLoop8L:
-        push    ecx
-        push    ebx
-        mov     esi,D [puwMipToMdl]
-        movzx   ebx,W [esi+ecx*2]
-        mov     esi,D [pFrame0]
-        mov     ecx,D [pFrame1]
-        // lerp vertex
-        movsx   eax,B [esi+ebx*4]ModelFrameVertex8.mfv_SBPoint[0]
-        movsx   edx,B [ecx+ebx*4]ModelFrameVertex8.mfv_SBPoint[0]
-        sub     edx,eax
-        imul    edx,D [fixLerpRatio]
-        shl     eax,8
-        add     eax,edx
-        mov     D [slTmp1],eax
-        movsx   eax,B [esi+ebx*4]ModelFrameVertex8.mfv_SBPoint[1]
-        movsx   edx,B [ecx+ebx*4]ModelFrameVertex8.mfv_SBPoint[1]
-        sub     edx,eax
-        imul    edx,D [fixLerpRatio]
-        shl     eax,8
-        add     eax,edx
-        mov     D [slTmp2],eax
-        movsx   eax,B [esi+ebx*4]ModelFrameVertex8.mfv_SBPoint[2]
-        movsx   edx,B [ecx+ebx*4]ModelFrameVertex8.mfv_SBPoint[2]
-        sub     edx,eax
-        imul    edx,D [fixLerpRatio]
-        shl     eax,8
-        add     eax,edx
-        mov     D [slTmp3],eax
-        // store vertex
-        fild    D [slTmp1]
-        fsub    D [fOffsetX]
-        fmul    D [fStretchX]
-        fild    D [slTmp2]
-        fsub    D [fOffsetY]
-        fmul    D [fStretchY]
-        fild    D [slTmp3]
-        fsub    D [fOffsetZ]
-        fmul    D [fStretchZ]
-        fxch    st(2)
-        fstp    D [edi]GFXVertex3.x
-        fstp    D [edi]GFXVertex3.y
-        fstp    D [edi]GFXVertex3.z
-        // load normals
-        movzx   eax,B [esi+ebx*4]ModelFrameVertex8.mfv_NormIndex
-        movzx   edx,B [ecx+ebx*4]ModelFrameVertex8.mfv_NormIndex
-        lea     esi,[eax*2+eax]
-        lea     ecx,[edx*2+edx]
-        // lerp normals
-        fld     D [avGouraudNormals+ ecx*4 +0]
-        fsub    D [avGouraudNormals+ esi*4 +0]
-        fld     D [avGouraudNormals+ ecx*4 +4]
-        fsub    D [avGouraudNormals+ esi*4 +4]
-        fld     D [avGouraudNormals+ ecx*4 +8]
-        fsub    D [avGouraudNormals+ esi*4 +8]
-        fxch    st(2)   // nx1-nx0, ny1-ny0, nz1-nz0
-        fmul    D [fLerpRatio]
-        fxch    st(1)   // ny1-ny0, lnx1, nz1-nz0
-        fmul    D [fLerpRatio]
-        fxch    st(2)   // nz1-nz0, lnx1, lny1
-        fmul    D [fLerpRatio]
-        fxch    st(1)   // lnx1, lnz1, lny1
-        fadd    D [avGouraudNormals+ esi*4 +0]
-        fxch    st(2)   // lny1, lnz1, fNX
-        fadd    D [avGouraudNormals+ esi*4 +4]
-        fxch    st(1)   // lnz1, fNY, fNX
-        fadd    D [avGouraudNormals+ esi*4 +8]
-        fxch    st(2)   // fNX, fNY, fNZ
-        // determine vertex shade
-        fld     D [fLightObjX]
-        fmul    st(0),st(1)     // flnx, fNX, fNY, fNZ 
-        pop     ebx            
-        fld     D [fLightObjY]
-        fmul    st(0),st(3)     // flny, flnx, fNX, fNY, fNZ 
-        fld     D [fLightObjZ]
-        fmul    st(0),st(5)     // flnz, flny, flnx, fNX, fNY, fNXZ
-        fxch    st(2)
-        faddp   st(1),st(0)
-        faddp   st(1),st(0)     // FL, fNX, fNY, fNXZ
-        fistp   D [ebx]
-        // store lerped normal (if needed)
-        cmp     D [bKeepNormals],0
-        je      vtxNext8L
-        mov     ecx,D [esp]
-        imul    ecx,3*4
-        add     ecx,D [pnorMipBase]
-        fstp    D [ecx]GFXNormal.nx
-        fstp    D [ecx]GFXNormal.ny
-        fst     D [ecx]GFXNormal.nz
-        fld     st(0)
-        fld     st(0)
-        // advance to next vertex
-vtxNext8L:
-        fstp    st(0)
-        fcompp
-        pop     ecx
-        add     edi,3*4
-        add     ebx,1*2
-        inc     ecx
-        cmp     ecx,D [_ctAllMipVx]
-        jl      vtxLoop8L
-      }
-#else
       // for each vertex in mip
       for( INDEX iMipVx=0; iMipVx<_ctAllMipVx; iMipVx++) {
         // get destination for unpacking
@@ -1631,113 +1296,408 @@ vtxNext8L:
           pnorMipBase[iMipVx].nz = fNZ;
         }
       }
-#endif
     }
   }
+}
 
-  // generate colors from shades
-#if ASMOPT == 1
-  __asm {
-    pxor    mm0,mm0
-    // construct 64-bit RGBA light
-    mov     eax,D [_slLR]
-    mov     ebx,D [_slLG]
-    mov     ecx,D [_slLB]
-    shl     ebx,16
-    or      eax,ebx
-    or      ecx,0x01FE0000
-    movd    mm5,eax
-    movd    mm7,ecx
-    psllq   mm7,32
-    por     mm5,mm7
-    psllw   mm5,1 // boost for multiply
-    // construct 64-bit RGBA ambient
-    mov     eax,D [_slAR]
-    mov     ebx,D [_slAG]
-    mov     ecx,D [_slAB]
-    shl     ebx,16
-    or      eax,ebx
-    movd    mm6,eax
-    movd    mm7,ecx
-    psllq   mm7,32
-    por     mm6,mm7
-    // init
-    mov     esi,D [pswMipCol]
-    mov     edi,D [pcolMipBase]
-    mov     ecx,D [_ctAllMipVx]
-    shr     ecx,2
-    jz      colRest
-    // 4-colors loop
-colLoop4:
-    movq    mm1,Q [esi]
-    packuswb mm1,mm0
-    punpcklbw mm1,mm1
-    psrlw   mm1,1
-    movq    mm3,mm1
-    punpcklwd mm1,mm1
-    punpckhwd mm3,mm3
-    movq    mm2,mm1
-    movq    mm4,mm3
-    punpckldq mm1,mm1
-    punpckhdq mm2,mm2
-    punpckldq mm3,mm3
-    punpckhdq mm4,mm4
-    pmulhw  mm1,mm5
-    pmulhw  mm2,mm5
-    pmulhw  mm3,mm5
-    pmulhw  mm4,mm5
-    paddsw  mm1,mm6
-    paddsw  mm2,mm6
-    paddsw  mm3,mm6
-    paddsw  mm4,mm6
-    packuswb mm1,mm2
-    packuswb mm3,mm4
-    movq    Q [edi+0],mm1
-    movq    Q [edi+8],mm3
-    add     esi,2*4
-    add     edi,4*4
-    dec     ecx
-    jnz     colLoop4
-    // 1-color loop
-colRest:
-    mov     ecx,D [_ctAllMipVx]
-    and     ecx,3
-    jz      colEnd
-colLoop1:
-    movsx   eax,W [esi]
-    movd    mm1,eax
-    packuswb mm1,mm0
-    punpcklbw mm1,mm1
-    psrlw   mm1,1
-    punpcklwd mm1,mm1
-    punpckldq mm1,mm1
-    pmulhw  mm1,mm5
-    paddsw  mm1,mm6
-    packuswb mm1,mm0
-    movd    D [edi],mm1    
-    add     esi,2
-    add     edi,4
-    dec     ecx
-    jnz     colLoop1
-colEnd:
-    emms
+
+// load four words from each of two prepared frames and lerp them
+static __forceinline __m128 LerpWords( const SWORD *psw0, const SWORD *psw1, const __m128 &fRatio)
+{
+  const __m128i sw0 = _mm_loadl_epi64( (const __m128i*)psw0);
+  const __m128i sw1 = _mm_loadl_epi64( (const __m128i*)psw1);
+  const __m128  f0  = _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpacklo_epi16( sw0, sw0), 16));
+  const __m128  f1  = _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpacklo_epi16( sw1, sw1), 16));
+  return _mm_add_ps( f0, _mm_mul_ps( _mm_sub_ps( f1, f0), fRatio));
+}
+
+// store four x,y,z triplets interleaved (as GFXVertex3 or GFXNormal3)
+static __forceinline void StoreTriplets( FLOAT *pf, const __m128 &x, const __m128 &y, const __m128 &z)
+{
+  const __m128 xy01 = _mm_shuffle_ps( x, y, _MM_SHUFFLE(1,0,1,0));  // x0 x1 y0 y1
+  const __m128 zx01 = _mm_shuffle_ps( z, x, _MM_SHUFFLE(1,1,0,0));  // z0 z0 x1 x1
+  const __m128 yz12 = _mm_shuffle_ps( y, z, _MM_SHUFFLE(2,1,2,1));  // y1 y2 z1 z2
+  const __m128 xy22 = _mm_shuffle_ps( x, y, _MM_SHUFFLE(2,2,2,2));  // x2 x2 y2 y2
+  const __m128 zx23 = _mm_shuffle_ps( z, x, _MM_SHUFFLE(3,3,2,2));  // z2 z2 x3 x3
+  const __m128 yz33 = _mm_shuffle_ps( y, z, _MM_SHUFFLE(3,3,3,3));  // y3 y3 z3 z3
+  _mm_storeu_ps( pf+0, _mm_shuffle_ps( xy01, zx01, _MM_SHUFFLE(2,0,2,0)));  // x0 y0 z0 x1
+  _mm_storeu_ps( pf+4, _mm_shuffle_ps( yz12, xy22, _MM_SHUFFLE(2,0,2,0)));  // y1 z1 x2 y2
+  _mm_storeu_ps( pf+8, _mm_shuffle_ps( zx23, yz33, _MM_SHUFFLE(2,0,2,0)));  // z2 x3 y3 z3
+}
+
+
+// unpack vertices, shades and eventually normals from prepared frames, four vertices at a time
+// (normals can also be stored as separate runs of x, y and z, for unpacked frames cache)
+static void UnpackPreparedFrame( CRenderModel &rm, BOOL bKeepNormals, SWORD *pswMipCol, FLOAT *pfNormalRuns)
+{
+  const ModelMipInfo &mmi = *rm.rm_pmmiMip;
+  const INDEX ctRun = mmi.mmpi_ctFrameStride/6;
+  const SWORD *psw0 = &mmi.mmpi_aswFrames[rm.rm_iFrame0*mmi.mmpi_ctFrameStride];
+  const SWORD *psw1 = &mmi.mmpi_aswFrames[rm.rm_iFrame1*mmi.mmpi_ctFrameStride];
+  const FLOAT fRatio = (rm.rm_iFrame0==rm.rm_iFrame1) ? 0.0f : rm.rm_fRatio;
+
+  const __m128 vRatio    = _mm_set1_ps( fRatio);
+  const __m128 vOffsetX  = _mm_set1_ps( rm.rm_vOffset(1));
+  const __m128 vOffsetY  = _mm_set1_ps( rm.rm_vOffset(2));
+  const __m128 vOffsetZ  = _mm_set1_ps( rm.rm_vOffset(3));
+  const __m128 vStretchX = _mm_set1_ps( rm.rm_vStretch(1));
+  const __m128 vStretchY = _mm_set1_ps( rm.rm_vStretch(2));
+  const __m128 vStretchZ = _mm_set1_ps( rm.rm_vStretch(3));
+  const __m128 vLightX   = _mm_set1_ps( rm.rm_vLightObj(1) * -255.0f);
+  const __m128 vLightY   = _mm_set1_ps( rm.rm_vLightObj(2) * -255.0f);
+  const __m128 vLightZ   = _mm_set1_ps( rm.rm_vLightObj(3) * -255.0f);
+  const __m128 vUnfix    = _mm_set1_ps( NORMAL_UNFIX);
+
+  // for each four vertices in mip (runs are padded, so last four may be partially valid)
+  for( INDEX iMipVx=0; iMipVx<_ctAllMipVx; iMipVx+=4)
+  {
+    // lerp and stretch vertices
+    const __m128 vX = _mm_mul_ps( _mm_sub_ps( LerpWords( psw0+ctRun*0+iMipVx, psw1+ctRun*0+iMipVx, vRatio), vOffsetX), vStretchX);
+    const __m128 vY = _mm_mul_ps( _mm_sub_ps( LerpWords( psw0+ctRun*1+iMipVx, psw1+ctRun*1+iMipVx, vRatio), vOffsetY), vStretchY);
+    const __m128 vZ = _mm_mul_ps( _mm_sub_ps( LerpWords( psw0+ctRun*2+iMipVx, psw1+ctRun*2+iMipVx, vRatio), vOffsetZ), vStretchZ);
+    // lerp normals
+    const __m128 vNX = _mm_mul_ps( LerpWords( psw0+ctRun*3+iMipVx, psw1+ctRun*3+iMipVx, vRatio), vUnfix);
+    const __m128 vNY = _mm_mul_ps( LerpWords( psw0+ctRun*4+iMipVx, psw1+ctRun*4+iMipVx, vRatio), vUnfix);
+    const __m128 vNZ = _mm_mul_ps( LerpWords( psw0+ctRun*5+iMipVx, psw1+ctRun*5+iMipVx, vRatio), vUnfix);
+    // determine shades (rounded to nearest, as FloatToInt() does)
+    const __m128 vShade = _mm_add_ps( _mm_add_ps( _mm_mul_ps( vNX, vLightX), _mm_mul_ps( vNY, vLightY)), _mm_mul_ps( vNZ, vLightZ));
+    const __m128i swShades = _mm_packs_epi32( _mm_cvtps_epi32(vShade), _mm_setzero_si128());
+
+    // if whole four vertices are valid
+    const INDEX ctLeft = _ctAllMipVx-iMipVx;
+    if( ctLeft>=4) {
+      // store directly
+      StoreTriplets( &pvtxMipBase[iMipVx].x, vX, vY, vZ);
+      _mm_storel_epi64( (__m128i*)&pswMipCol[iMipVx], swShades);
+      if( bKeepNormals) StoreTriplets( &pnorMipBase[iMipVx].nx, vNX, vNY, vNZ);
+    // if only some are valid
+    } else {
+      // store through temporary buffers
+      FLOAT afVtx[4*3], afNor[4*3];
+      SWORD aswShades[8];
+      StoreTriplets( afVtx, vX, vY, vZ);
+      StoreTriplets( afNor, vNX, vNY, vNZ);
+      _mm_storeu_si128( (__m128i*)aswShades, swShades);
+      memcpy( &pvtxMipBase[iMipVx], afVtx, ctLeft*sizeof(GFXVertex3));
+      memcpy( &pswMipCol[iMipVx], aswShades, ctLeft*sizeof(SWORD));
+      if( bKeepNormals) memcpy( &pnorMipBase[iMipVx], afNor, ctLeft*sizeof(GFXNormal3));
+    }
+    // store normal runs for cache (these are padded)
+    if( pfNormalRuns!=NULL) {
+      _mm_storeu_ps( pfNormalRuns+ctRun*0+iMipVx, vNX);
+      _mm_storeu_ps( pfNormalRuns+ctRun*1+iMipVx, vNY);
+      _mm_storeu_ps( pfNormalRuns+ctRun*2+iMipVx, vNZ);
+    }
   }
-#else
-    // generate colors from shades
-    for( INDEX iMipVx=0; iMipVx<_ctAllMipVx; iMipVx++) {
-      GFXColor &col = pcolMipBase[iMipVx];
-      const SLONG slShade = Clamp( (SLONG)pswMipCol[iMipVx], 0L, 255L);
-      col.r = pubClipByte[_slAR + ((_slLR*slShade)>>8)];
-      col.g = pubClipByte[_slAG + ((_slLG*slShade)>>8)];
-      col.b = pubClipByte[_slAB + ((_slLB*slShade)>>8)];
-      col.a = slShade;
+}
+
+
+// determine shades and eventually normals from cached runs of unpacked normals
+static void ShadeCachedNormals( CRenderModel &rm, BOOL bKeepNormals, SWORD *pswMipCol, const FLOAT *pfNormalRuns)
+{
+  const INDEX ctRun = (_ctAllMipVx+3) & ~3;
+  const __m128 vLightX = _mm_set1_ps( rm.rm_vLightObj(1) * -255.0f);
+  const __m128 vLightY = _mm_set1_ps( rm.rm_vLightObj(2) * -255.0f);
+  const __m128 vLightZ = _mm_set1_ps( rm.rm_vLightObj(3) * -255.0f);
+
+  for( INDEX iMipVx=0; iMipVx<_ctAllMipVx; iMipVx+=4)
+  {
+    const __m128 vNX = _mm_loadu_ps( pfNormalRuns+ctRun*0+iMipVx);
+    const __m128 vNY = _mm_loadu_ps( pfNormalRuns+ctRun*1+iMipVx);
+    const __m128 vNZ = _mm_loadu_ps( pfNormalRuns+ctRun*2+iMipVx);
+    const __m128 vShade = _mm_add_ps( _mm_add_ps( _mm_mul_ps( vNX, vLightX), _mm_mul_ps( vNY, vLightY)), _mm_mul_ps( vNZ, vLightZ));
+    const __m128i swShades = _mm_packs_epi32( _mm_cvtps_epi32(vShade), _mm_setzero_si128());
+    const INDEX ctLeft = _ctAllMipVx-iMipVx;
+    if( ctLeft>=4) {
+      _mm_storel_epi64( (__m128i*)&pswMipCol[iMipVx], swShades);
+      if( bKeepNormals) StoreTriplets( &pnorMipBase[iMipVx].nx, vNX, vNY, vNZ);
+    } else {
+      FLOAT afNor[4*3];
+      SWORD aswShades[8];
+      StoreTriplets( afNor, vNX, vNY, vNZ);
+      _mm_storeu_si128( (__m128i*)aswShades, swShades);
+      memcpy( &pswMipCol[iMipVx], aswShades, ctLeft*sizeof(SWORD));
+      if( bKeepNormals) memcpy( &pnorMipBase[iMipVx], afNor, ctLeft*sizeof(GFXNormal3));
     }
-#endif
+  }
+}
+
+
+// generate colors from shades, four vertices at a time
+// (shades are in upper half of color buffer, so colors can be written over them as they go)
+static void ShadesToColors( const SWORD *pswMipCol)
+{
+  // light is pre-shifted so that high word of multiply gives (light*shade)>>8
+  const __m128i vLight   = _mm_set_epi16( 0, (SWORD)(_slLB<<7), (SWORD)(_slLG<<7), (SWORD)(_slLR<<7),
+                                           0, (SWORD)(_slLB<<7), (SWORD)(_slLG<<7), (SWORD)(_slLR<<7));
+  const __m128i vAmbient = _mm_set_epi16( 0, (SWORD)_slAB, (SWORD)_slAG, (SWORD)_slAR, 0, (SWORD)_slAB, (SWORD)_slAG, (SWORD)_slAR);
+  const __m128i vAlpha   = _mm_set_epi16( -1, 0, 0, 0, -1, 0, 0, 0);
+  const __m128i v255     = _mm_set1_epi16( 255);
+
+  INDEX iMipVx=0;
+  for( ; iMipVx<=_ctAllMipVx-4; iMipVx+=4) {
+    // clamp shades and spread them over all four color components
+    __m128i swShades = _mm_loadl_epi64( (const __m128i*)&pswMipCol[iMipVx]);
+    swShades = _mm_max_epi16( _mm_min_epi16( swShades, v255), _mm_setzero_si128());
+    swShades = _mm_unpacklo_epi16( swShades, swShades);
+    const __m128i swShades01 = _mm_unpacklo_epi32( swShades, swShades);
+    const __m128i swShades23 = _mm_unpackhi_epi32( swShades, swShades);
+    // ambient + light*shade, with shade itself as alpha
+    const __m128i swColors01 = _mm_add_epi16( _mm_add_epi16( vAmbient, _mm_mulhi_epu16( vLight, _mm_slli_epi16( swShades01, 1))),
+                                              _mm_and_si128( swShades01, vAlpha));
+    const __m128i swColors23 = _mm_add_epi16( _mm_add_epi16( vAmbient, _mm_mulhi_epu16( vLight, _mm_slli_epi16( swShades23, 1))),
+                                              _mm_and_si128( swShades23, vAlpha));
+    // saturate to bytes (as clip table does) and store
+    _mm_storeu_si128( (__m128i*)&pcolMipBase[iMipVx], _mm_packus_epi16( swColors01, swColors23));
+  }
+  // rest of vertices
+  for( ; iMipVx<_ctAllMipVx; iMipVx++) {
+    GFXColor &col = pcolMipBase[iMipVx];
+    const SLONG slShade = Clamp( (SLONG)pswMipCol[iMipVx], 0L, 255L);
+    col.r = pubClipByte[_slAR + ((_slLR*slShade)>>8)];
+    col.g = pubClipByte[_slAG + ((_slLG*slShade)>>8)];
+    col.b = pubClipByte[_slAB + ((_slLB*slShade)>>8)];
+    col.a = slShade;
+  }
+}
+
+
+// cache of frames unpacked in current rendering frame, so that many instances of same model in
+// same animation phase (crowds of enemies, static props) need to be unpacked only once
+#define UNPACKCACHE_ENTRIES   64
+#define UNPACKCACHE_MAXFLOATS (1024*1024)
+
+struct UnpackCacheEntry {
+  const ModelMipInfo *uce_pmmi;
+  INDEX uce_iFrame0, uce_iFrame1;
+  FLOAT uce_fRatio;
+  FLOAT3D uce_vStretch, uce_vOffset;
+  INDEX uce_ctUses; // how many times this frame was needed so far
+  INDEX uce_iData;  // vertices followed by normal runs in cache data (-1 if not cached yet)
+};
+
+static UnpackCacheEntry _auceUnpackCache[UNPACKCACHE_ENTRIES];
+static INDEX _ctUnpackCacheEntries = 0;
+static INDEX _iUnpackCacheFrame = -1;
+static CStaticStackArray<FLOAT> _afUnpackCache;
+
+// forget all unpacked frames
+static void ResetUnpackCache(void)
+{
+  _ctUnpackCacheEntries = 0;
+  _afUnpackCache.PopAll();
+}
+
+// find or add cache entry for frame that is to be unpacked for this model
+static UnpackCacheEntry *FindUnpackCacheEntry( CRenderModel &rm)
+{
+  // flush for each new rendering frame
+  if( _iUnpackCacheFrame != _pGfx->gl_iFrameNumber) {
+    _iUnpackCacheFrame = _pGfx->gl_iFrameNumber;
+    ResetUnpackCache();
+  }
+  const FLOAT fRatio = (rm.rm_iFrame0==rm.rm_iFrame1) ? 0.0f : rm.rm_fRatio;
+  for( INDEX iEntry=0; iEntry<_ctUnpackCacheEntries; iEntry++) {
+    UnpackCacheEntry &uce = _auceUnpackCache[iEntry];
+    if( uce.uce_pmmi==rm.rm_pmmiMip && uce.uce_iFrame0==rm.rm_iFrame0 && uce.uce_iFrame1==rm.rm_iFrame1
+     && uce.uce_fRatio==fRatio && uce.uce_vStretch==rm.rm_vStretch && uce.uce_vOffset==rm.rm_vOffset) {
+      uce.uce_ctUses++;
+      return &uce;
+    }
+  }
+  if( _ctUnpackCacheEntries==UNPACKCACHE_ENTRIES) return NULL;
+  UnpackCacheEntry &uce = _auceUnpackCache[_ctUnpackCacheEntries++];
+  uce.uce_pmmi     = rm.rm_pmmiMip;
+  uce.uce_iFrame0  = rm.rm_iFrame0;
+  uce.uce_iFrame1  = rm.rm_iFrame1;
+  uce.uce_fRatio   = fRatio;
+  uce.uce_vStretch = rm.rm_vStretch;
+  uce.uce_vOffset  = rm.rm_vOffset;
+  uce.uce_ctUses   = 1;
+  uce.uce_iData    = -1;
+  return &uce;
+}
+
+
+// unpack vertices (and eventually normals) of one frame
+static void UnpackFrame( CRenderModel &rm, BOOL bKeepNormals)
+{
+  _pfModelProfile.StartTimer( CModelProfile::PTI_VIEW_INIT_UNPACK);
+  _pfModelProfile.IncrementTimerAveragingCounter( CModelProfile::PTI_VIEW_INIT_UNPACK, _ctAllMipVx);
+  SWORD *pswMipCol = (SWORD*)&pcolMipBase[_ctAllMipVx>>1];
+
+  // use prepared frames if they are up to date
+  const ModelMipInfo &mmi = *rm.rm_pmmiMip;
+  const INDEX ctFrameWords = (Max( rm.rm_iFrame0, rm.rm_iFrame1)+1) * mmi.mmpi_ctFrameStride;
+  const BOOL bPrepared = mdl_bPreparedFrames && mmi.mmpi_ctFrameStride==((_ctAllMipVx+3)&~3)*6
+                      && mmi.mmpi_aswFrames.Count()>=ctFrameWords;
+  if( !bPrepared) {
+    UnpackCompressedFrame( rm, bKeepNormals, pswMipCol);
+  } else {
+    // if this frame was already unpacked for another instance
+    const INDEX ctRun = mmi.mmpi_ctFrameStride/6;
+    UnpackCacheEntry *puce = mdl_bCacheUnpackedFrames ? FindUnpackCacheEntry(rm) : NULL;
+    if( puce!=NULL && puce->uce_iData>=0) {
+      // copy vertices and just shade normals
+      _pfModelProfile.IncrementCounter( CModelProfile::PCI_UNPACK_CACHEHITS);
+      const FLOAT *pfData = &_afUnpackCache[puce->uce_iData];
+      memcpy( pvtxMipBase, pfData, _ctAllMipVx*sizeof(GFXVertex3));
+      ShadeCachedNormals( rm, bKeepNormals, pswMipCol, pfData + _ctAllMipVx*3);
+    // if this is the second time it's needed (and there's some room left)
+    } else if( puce!=NULL && puce->uce_ctUses>=2 && _afUnpackCache.Count() + _ctAllMipVx*3 + ctRun*3 <= UNPACKCACHE_MAXFLOATS) {
+      // unpack and keep the result
+      _pfModelProfile.IncrementCounter( CModelProfile::PCI_UNPACK_CACHEMISSES);
+      puce->uce_iData = _afUnpackCache.Count();
+      FLOAT *pfData = _afUnpackCache.Push( _ctAllMipVx*3 + ctRun*3);
+      UnpackPreparedFrame( rm, bKeepNormals, pswMipCol, pfData + _ctAllMipVx*3);
+      memcpy( pfData, pvtxMipBase, _ctAllMipVx*sizeof(GFXVertex3));
+    // if seen for the first time (or cache is full)
+    } else {
+      if( puce!=NULL) _pfModelProfile.IncrementCounter( CModelProfile::PCI_UNPACK_CACHEMISSES);
+      UnpackPreparedFrame( rm, bKeepNormals, pswMipCol, NULL);
+    }
+  }
+
+  // generate colors from shades
+  ShadesToColors( pswMipCol);
 
   // all done
   _pfModelProfile.StopTimer( CModelProfile::PTI_VIEW_INIT_UNPACK);
 }
 
+
+// unpack frames of a crowd of instances of one model with each unpacking method, and report
+// timings and largest difference from unpacking straight from compressed frames (doesn't need any graphics API)
+#define BENCHMARK_INSTANCES 40
+#define BENCHMARK_PHASES     4  // instances are split into this many groups with different animation phase
+#define BENCHMARK_FRAMES   100
+
+static DOUBLE RunUnpackBenchmark( CRenderModel &rm, BOOL bPrepared, BOOL bCache,
+                                  CStaticArray<GFXVertex3> &avtxResult, CStaticArray<GFXColor> &acolResult)
+{
+  CModelData &md = *rm.rm_pmdModelData;
+  const INDEX ctFrames = md.md_FramesCt;
+  const INDEX ctVertices = md.md_VerticesCt;
+  const INDEX mdl_bOldPreparedFrames = mdl_bPreparedFrames;
+  const INDEX mdl_bOldCacheUnpackedFrames = mdl_bCacheUnpackedFrames;
+  mdl_bPreparedFrames = bPrepared;
+  mdl_bCacheUnpackedFrames = bCache;
+
+  CTimerValue tvStart = _pTimer->GetHighPrecisionTimer();
+  for( INDEX iFrame=0; iFrame<BENCHMARK_FRAMES; iFrame++) {
+    ResetUnpackCache();
+    for( INDEX iInstance=0; iInstance<BENCHMARK_INSTANCES; iInstance++) {
+      // instances in same group share animation, but each has its own lighting
+      const INDEX iPhase = iInstance % BENCHMARK_PHASES;
+      rm.rm_iFrame0 = (iFrame + iPhase*7) % ctFrames;
+      rm.rm_iFrame1 = (rm.rm_iFrame0+1) % ctFrames;
+      rm.rm_fRatio  = 0.25f + 0.5f*iPhase/BENCHMARK_PHASES;
+      if( md.md_Flags & MF_COMPRESSED_16BIT) {
+        rm.rm_pFrame16_0 = &md.md_FrameVertices16[rm.rm_iFrame0 *ctVertices];
+        rm.rm_pFrame16_1 = &md.md_FrameVertices16[rm.rm_iFrame1 *ctVertices];
+      } else {
+        rm.rm_pFrame8_0 = &md.md_FrameVertices8[rm.rm_iFrame0 *ctVertices];
+        rm.rm_pFrame8_1 = &md.md_FrameVertices8[rm.rm_iFrame1 *ctVertices];
+      }
+      rm.rm_vLightObj = FLOAT3D( Sin(iInstance*37.0f), -1.0f, Cos(iInstance*37.0f)).Normalize();
+      UnpackFrame( rm, TRUE);
+      // remember results of last frame
+      if( iFrame==BENCHMARK_FRAMES-1) {
+        memcpy( &avtxResult[iInstance*_ctAllMipVx], pvtxMipBase, _ctAllMipVx*sizeof(GFXVertex3));
+        memcpy( &acolResult[iInstance*_ctAllMipVx], pcolMipBase, _ctAllMipVx*sizeof(GFXColor));
+      }
+    }
+  }
+  const DOUBLE dSeconds = (_pTimer->GetHighPrecisionTimer()-tvStart).GetSeconds();
+
+  ResetUnpackCache();
+  mdl_bPreparedFrames = mdl_bOldPreparedFrames;
+  mdl_bCacheUnpackedFrames = mdl_bOldCacheUnpackedFrames;
+  return dSeconds;
+}
+
+void ModelUnpackBenchmark(void *pArgs)
+{
+  CTString strModel = *NEXTARGUMENT(CTString*);
+  CModelData *pmd;
+  try {
+    pmd = _pModelStock->Obtain_t( CTFileName(strModel));
+  } catch( char *strError) {
+    CPrintF( "%s\n", strError);
+    return;
+  }
+  CModelData &md = *pmd;
+  if( md.md_FramesCt==0 || md.md_MipCt==0) {
+    CPrintF( TRANS("'%s' has no frames to unpack.\n"), (const char*)strModel);
+    _pModelStock->Release(pmd);
+    return;
+  }
+  // prepared frames are needed even if they are turned off
+  const INDEX mdl_bOldPreparedFrames = mdl_bPreparedFrames;
+  mdl_bPreparedFrames = TRUE;
+  PrepareModelForRendering(md);
+  mdl_bPreparedFrames = mdl_bOldPreparedFrames;
+
+  // setup rendering of first mip with white light and some ambient
+  CRenderModel rm;
+  rm.rm_pmdModelData = pmd;
+  rm.rm_iMipLevel = 0;
+  rm.rm_pmmiMip   = &md.md_MipInfos[0];
+  rm.rm_vStretch  = md.md_Stretch;
+  rm.rm_vOffset   = md.md_vCompressedCenter;
+  _slLR = _slLG = _slLB = 255;
+  _slAR = _slAG = _slAB = 32;
+  _ctAllMipVx = rm.rm_pmmiMip->mmpi_ctMipVx;
+  ResetVertexArrays();
+  pvtxMipBase = _avtxMipBase.Push(_ctAllMipVx);
+  pcolMipBase = _acolMipBase.Push(_ctAllMipVx);
+  pnorMipBase = _anorMipBase.Push(_ctAllMipVx);
+
+  const INDEX ctResults = BENCHMARK_INSTANCES*_ctAllMipVx;
+  CStaticArray<GFXVertex3> avtxReference, avtxPrepared, avtxCached;
+  CStaticArray<GFXColor>   acolReference, acolPrepared, acolCached;
+  avtxReference.New(ctResults);  avtxPrepared.New(ctResults);  avtxCached.New(ctResults);
+  acolReference.New(ctResults);  acolPrepared.New(ctResults);  acolCached.New(ctResults);
+  const DOUBLE dReference = RunUnpackBenchmark( rm, FALSE, FALSE, avtxReference, acolReference);
+  const DOUBLE dPrepared  = RunUnpackBenchmark( rm, TRUE,  FALSE, avtxPrepared,  acolPrepared);
+  const DOUBLE dCached    = RunUnpackBenchmark( rm, TRUE,  TRUE,  avtxCached,    acolCached);
+  ResetVertexArrays();
+
+  // memory taken by frames in both layouts
+  const SLONG slCompressed = md.md_FrameVertices16.Count()*sizeof(ModelFrameVertex16)
+                           + md.md_FrameVertices8.Count()*sizeof(ModelFrameVertex8);
+  SLONG slPrepared = 0;
+  for( INDEX iMip=0; iMip<md.md_MipCt; iMip++) {
+    slPrepared += md.md_MipInfos[iMip].mmpi_aswFrames.Count()*sizeof(SWORD);
+  }
+  _pModelStock->Release(pmd);
+
+  // find largest differences from reference
+  FLOAT fMaxVtxDiff = 0.0f;
+  SLONG slMaxColDiff = 0;
+  for( INDEX i=0; i<ctResults; i++) {
+    for( INDEX iMethod=0; iMethod<2; iMethod++) {
+      const GFXVertex3 &vtx = (iMethod==0) ? avtxPrepared[i] : avtxCached[i];
+      const GFXColor   &col = (iMethod==0) ? acolPrepared[i] : acolCached[i];
+      const GFXVertex3 &vtxRef = avtxReference[i];
+      const GFXColor   &colRef = acolReference[i];
+      fMaxVtxDiff  = Max( fMaxVtxDiff, Max( Abs(vtx.x-vtxRef.x), Max( Abs(vtx.y-vtxRef.y), Abs(vtx.z-vtxRef.z))));
+      slMaxColDiff = Max( slMaxColDiff, Max( Abs( (SLONG)col.r-colRef.r), Abs( (SLONG)col.g-colRef.g)));
+      slMaxColDiff = Max( slMaxColDiff, Max( Abs( (SLONG)col.b-colRef.b), Abs( (SLONG)col.a-colRef.a)));
+    }
+  }
+
+  const DOUBLE dUnpacks = BENCHMARK_FRAMES*BENCHMARK_INSTANCES;
+  CPrintF( TRANS("%d instances of %d vertices in %d animation phases, %d frames:\n"),
+           BENCHMARK_INSTANCES, _ctAllMipVx, BENCHMARK_PHASES, BENCHMARK_FRAMES);
+  CPrintF( TRANS("  compressed:        %6.2f us per instance\n"), dReference*1000000.0/dUnpacks);
+  CPrintF( TRANS("  prepared (SSE2):   %6.2f us per instance\n"), dPrepared *1000000.0/dUnpacks);
+  CPrintF( TRANS("  prepared + cache:  %6.2f us per instance\n"), dCached   *1000000.0/dUnpacks);
+  CPrintF( TRANS("  max difference: %g in position, %d in color\n"), fMaxVtxDiff, slMaxColDiff);
+  CPrintF( TRANS("  frames take %dk compressed and %dk more prepared\n"), slCompressed/1024, slPrepared/1024);
+}
+
+
 // BEGIN MODEL RENDERING *******************************************************************************
 
 
@@ -103,19 +103,10 @@ CTString cm_strName;			// local address
 
 CTCriticalSection cm_csComm;  // critical section for access to communication data
 
-BOOL cm_bNetworkInitialized;
-
-// index 0 is the server's local client, this is an array used by server only
-CClientInterface cm_aciClients[SERVER_CLIENTS];
-
-// Broadcast interface - i.e. interface for 'nonconnected' communication
-CClientInterface cm_ciBroadcast;
-
-// this is used by client only
-CClientInterface cm_ciLocalClient;
-
-// global communication interface object (there is only one for the entire engine)
-CCommunicationInterface _cmiComm;
+// communication interface of the engine's own session
+static CCommunicationInterface _cmiMain;
+// current communication interface (dedicated server switches it for each hosted session)
+CCommunicationInterface *_pcmiComm = &_cmiMain;
 
 
 /*
@@ -181,7 +172,7 @@ CCommunicationInterface::CCommunicationInterface(void)
 
   cci_bServerInitialized = FALSE;
   cci_bClientInitialized = FALSE;
-  cm_ciLocalClient.ci_bClientLocal = FALSE;
+  cci_ciLocalClient.ci_bClientLocal = FALSE;
 
 	cci_hSocket=INVALID_SOCKET;
 
@@ -197,7 +188,7 @@ void CCommunicationInterface::Init(void)
 	cci_bInitialized = TRUE;
 
   // mark as initialized
-  cm_bNetworkInitialized = FALSE;
+  cci_bNetworkInitialized = FALSE;
 
 	cci_pbMasterInput.Clear();
 	cci_pbMasterOutput.Clear();
@@ -214,9 +205,9 @@ void CCommunicationInterface::Close(void)
   ASSERT(!cci_bClientInitialized);
 
   // mark as closed
-  cm_bNetworkInitialized = FALSE;
+  cci_bNetworkInitialized = FALSE;
   cci_bInitialized = FALSE;
-	cm_ciLocalClient.ci_bClientLocal = FALSE;
+	cci_ciLocalClient.ci_bClientLocal = FALSE;
 
 	cci_pbMasterInput.Clear();
 	cci_pbMasterOutput.Clear();
@@ -263,7 +254,7 @@ void CCommunicationInterface::PrepareForUse(BOOL bUseNetwork, BOOL bClient)
   _pbsRecv.Clear();
 
 	// if the network is already initialized, shut it down before proceeding
-  if (cm_bNetworkInitialized) {
+  if (cci_bNetworkInitialized) {
     Unprepare();
   }
 
@@ -326,14 +317,14 @@ void CCommunicationInterface::PrepareForUse(BOOL bUseNetwork, BOOL bClient)
       OpenSocket_t(cm_ulLocalHost, bClient?0:net_iPort);
 			cci_pbMasterInput.pb_ppbsStats = NULL;
 			cci_pbMasterOutput.pb_ppbsStats = NULL;
-      cm_ciBroadcast.SetLocal(NULL);
+      cci_ciBroadcast.SetLocal(NULL);
       CPrintF(TRANS("  opened socket: \n"));
     } catch (char *strError) {
       CPrintF(TRANS("  cannot open UDP socket: %s\n"), strError);
     }
   }
   
-  cm_bNetworkInitialized = cci_bWinSockOpen;
+  cci_bNetworkInitialized = cci_bWinSockOpen;
 };
 
 
@@ -349,7 +340,7 @@ void CCommunicationInterface::Unprepare(void)
 			cci_hSocket = INVALID_SOCKET;
 		}
 
-    cm_ciBroadcast.Clear();
+    cci_ciBroadcast.Clear();
     EndWinsock();
 		cci_bBound=FALSE;
   }
@@ -358,14 +349,14 @@ void CCommunicationInterface::Unprepare(void)
 	cci_pbMasterOutput.Clear();
 
 
-  cm_bNetworkInitialized = cci_bWinSockOpen;
+  cci_bNetworkInitialized = cci_bWinSockOpen;
 	
 };
 
 
 BOOL CCommunicationInterface::IsNetworkEnabled(void)
 {
-  return cm_bNetworkInitialized;
+  return cci_bNetworkInitialized;
 };
 
 // get address of local machine
@@ -516,17 +507,17 @@ void CCommunicationInterface::Broadcast_Send(const void *pvSend, SLONG slSendSiz
 {
   CTSingleLock slComm(&cm_csComm, TRUE);
 
-  cm_ciBroadcast.ci_adrAddress.adr_ulAddress = adrDestination.adr_ulAddress;
-  cm_ciBroadcast.ci_adrAddress.adr_uwPort = adrDestination.adr_uwPort;
-  cm_ciBroadcast.ci_adrAddress.adr_uwID = adrDestination.adr_uwID;
+  cci_ciBroadcast.ci_adrAddress.adr_ulAddress = adrDestination.adr_ulAddress;
+  cci_ciBroadcast.ci_adrAddress.adr_uwPort = adrDestination.adr_uwPort;
+  cci_ciBroadcast.ci_adrAddress.adr_uwID = adrDestination.adr_uwID;
 
-  cm_ciBroadcast.Send(pvSend, slSendSize,FALSE);
+  cci_ciBroadcast.Send(pvSend, slSendSize,FALSE);
 }
 
 BOOL CCommunicationInterface::Broadcast_Receive(void *pvReceive, SLONG &slReceiveSize,CAddress &adrAddress)
 {
   CTSingleLock slComm(&cm_csComm, TRUE);
-  return cm_ciBroadcast.ReceiveFrom(pvReceive, slReceiveSize,&adrAddress,FALSE);
+  return cci_ciBroadcast.ReceiveFrom(pvReceive, slReceiveSize,&adrAddress,FALSE);
 }
 
 
@@ -540,12 +531,12 @@ void CCommunicationInterface::Broadcast_Update_t() {
 
 	
 	// while there is a connection request packet in the input buffer
-	while ((ppaConnectionRequest = cm_ciBroadcast.ci_pbReliableInputBuffer.GetConnectRequestPacket()) != NULL) {
+	while ((ppaConnectionRequest = cci_ciBroadcast.ci_pbReliableInputBuffer.GetConnectRequestPacket()) != NULL) {
 		// see if there is a client already connected at that address and port
 		bIsAlready = FALSE;
 		for (iClient=1;iClient<SERVER_CLIENTS;iClient++) {
-			if (cm_aciClients[iClient].ci_adrAddress.adr_ulAddress == ppaConnectionRequest->pa_adrAddress.adr_ulAddress &&
-					cm_aciClients[iClient].ci_adrAddress.adr_uwPort == ppaConnectionRequest->pa_adrAddress.adr_uwPort) {
+			if (cci_aciClients[iClient].ci_adrAddress.adr_ulAddress == ppaConnectionRequest->pa_adrAddress.adr_ulAddress &&
+					cci_aciClients[iClient].ci_adrAddress.adr_uwPort == ppaConnectionRequest->pa_adrAddress.adr_uwPort) {
 					bIsAlready = TRUE;
 					break;
 			}
@@ -555,24 +546,24 @@ void CCommunicationInterface::Broadcast_Update_t() {
 			// find an empty client structure
 			bFoundEmpty = FALSE;
 			for (iClient=1;iClient<SERVER_CLIENTS;iClient++) {
-				if (cm_aciClients[iClient].ci_bUsed == FALSE) {
+				if (cci_aciClients[iClient].ci_bUsed == FALSE) {
 					bFoundEmpty = TRUE;
 					// we have an empty slot, so fill it for the client
-					cm_aciClients[iClient].ci_adrAddress.adr_ulAddress = ppaConnectionRequest->pa_adrAddress.adr_ulAddress;
-					cm_aciClients[iClient].ci_adrAddress.adr_uwPort = ppaConnectionRequest->pa_adrAddress.adr_uwPort;
+					cci_aciClients[iClient].ci_adrAddress.adr_ulAddress = ppaConnectionRequest->pa_adrAddress.adr_ulAddress;
+					cci_aciClients[iClient].ci_adrAddress.adr_uwPort = ppaConnectionRequest->pa_adrAddress.adr_uwPort;
 					// generate the ID
 					UWORD uwID = _pTimer->GetHighPrecisionTimer().tv_llValue&0x0FFF;
 					if (uwID==0 || uwID=='//') {
 						uwID+=1;
 					}										
-					cm_aciClients[iClient].ci_adrAddress.adr_uwID = (uwID<<4)+iClient;
+					cci_aciClients[iClient].ci_adrAddress.adr_uwID = (uwID<<4)+iClient;
 					// form the connection response packet
 					ppaConnectionRequest->pa_adrAddress.adr_uwID = '//';
 					ppaConnectionRequest->pa_ubReliable = UDP_PACKET_RELIABLE | UDP_PACKET_RELIABLE_HEAD | UDP_PACKET_RELIABLE_TAIL | UDP_PACKET_CONNECT_RESPONSE;
 					// return it to the client
-					ppaConnectionRequest->WriteToPacket(&(cm_aciClients[iClient].ci_adrAddress.adr_uwID),sizeof(cm_aciClients[iClient].ci_adrAddress.adr_uwID),ppaConnectionRequest->pa_ubReliable,cm_ciBroadcast.ci_ulSequence++,ppaConnectionRequest->pa_adrAddress.adr_uwID,sizeof(cm_aciClients[iClient].ci_adrAddress.adr_uwID));
-					cm_ciBroadcast.ci_pbOutputBuffer.AppendPacket(*ppaConnectionRequest,TRUE);
-					cm_aciClients[iClient].ci_bUsed = TRUE;
+					ppaConnectionRequest->WriteToPacket(&(cci_aciClients[iClient].ci_adrAddress.adr_uwID),sizeof(cci_aciClients[iClient].ci_adrAddress.adr_uwID),ppaConnectionRequest->pa_ubReliable,cci_ciBroadcast.ci_ulSequence++,ppaConnectionRequest->pa_adrAddress.adr_uwID,sizeof(cci_aciClients[iClient].ci_adrAddress.adr_uwID));
+					cci_ciBroadcast.ci_pbOutputBuffer.AppendPacket(*ppaConnectionRequest,TRUE);
+					cci_aciClients[iClient].ci_bUsed = TRUE;
 					return;
 				}
 			}
@@ -609,21 +600,21 @@ void CCommunicationInterface::Server_Init_t(void)
   // for each client
   for(INDEX iClient=0; iClient<SERVER_CLIENTS; iClient++) {
     // clear its status
-    cm_aciClients[iClient].Clear();
-		cm_aciClients[iClient].ci_pbOutputBuffer.pb_ppbsStats = &_pbsSend;
-		cm_aciClients[iClient].ci_pbInputBuffer.pb_ppbsStats = &_pbsRecv;
+    cci_aciClients[iClient].Clear();
+		cci_aciClients[iClient].ci_pbOutputBuffer.pb_ppbsStats = &_pbsSend;
+		cci_aciClients[iClient].ci_pbInputBuffer.pb_ppbsStats = &_pbsRecv;
   }
 
 	// mark the server's instance of the local client as such
-	cm_aciClients[SERVER_LOCAL_CLIENT].ci_bClientLocal = TRUE;
-	cm_aciClients[SERVER_LOCAL_CLIENT].ci_bUsed = TRUE;
+	cci_aciClients[SERVER_LOCAL_CLIENT].ci_bClientLocal = TRUE;
+	cci_aciClients[SERVER_LOCAL_CLIENT].ci_bUsed = TRUE;
 
 	// prepare the client part of the local client 
-	cm_ciLocalClient.Clear();
-	cm_ciLocalClient.ci_bUsed = TRUE;
-	cm_ciLocalClient.ci_bClientLocal = TRUE;
-	cm_ciLocalClient.ci_pbOutputBuffer.pb_ppbsStats = &_pbsSend;
-	cm_ciLocalClient.ci_pbInputBuffer.pb_ppbsStats = &_pbsRecv;
+	cci_ciLocalClient.Clear();
+	cci_ciLocalClient.ci_bUsed = TRUE;
+	cci_ciLocalClient.ci_bClientLocal = TRUE;
+	cci_ciLocalClient.ci_pbOutputBuffer.pb_ppbsStats = &_pbsSend;
+	cci_ciLocalClient.ci_pbInputBuffer.pb_ppbsStats = &_pbsRecv;
 
 
 
@@ -640,7 +631,7 @@ void CCommunicationInterface::Server_Close(void)
 
   // close all clients
   for (INDEX iClient=0; iClient<SERVER_CLIENTS; iClient++) {
-    cm_aciClients[iClient].Clear();
+    cci_aciClients[iClient].Clear();
   }
 
   // mark that the server is uninitialized
@@ -658,7 +649,7 @@ void CCommunicationInterface::Server_ClearClient(INDEX iClient)
   CTSingleLock slComm(&cm_csComm, TRUE);
 
   ASSERT(iClient>=0 && iClient<SERVER_CLIENTS);
-  cm_aciClients[iClient].Clear();
+  cci_aciClients[iClient].Clear();
 };
 
 BOOL CCommunicationInterface::Server_IsClientLocal(INDEX iClient)
@@ -673,7 +664,7 @@ BOOL CCommunicationInterface::Server_IsClientUsed(INDEX iClient)
   CTSingleLock slComm(&cm_csComm, TRUE);
 
   ASSERT(iClient>=0 && iClient<SERVER_CLIENTS);
-  return cm_aciClients[iClient].ci_bUsed;
+  return cci_aciClients[iClient].ci_bUsed;
 };
 
 CTString CCommunicationInterface::Server_GetClientName(INDEX iClient)
@@ -685,9 +676,9 @@ CTString CCommunicationInterface::Server_GetClientName(INDEX iClient)
     return TRANS("Local machine");
   }
 
-  cm_aciClients[iClient].ci_strAddress = AddressToString(cm_aciClients[iClient].ci_adrAddress.adr_ulAddress);
+  cci_aciClients[iClient].ci_strAddress = AddressToString(cci_aciClients[iClient].ci_adrAddress.adr_ulAddress);
 
-  return cm_aciClients[iClient].ci_strAddress;
+  return cci_aciClients[iClient].ci_strAddress;
 };
 
 /*
@@ -697,14 +688,14 @@ void CCommunicationInterface::Server_Send_Reliable(INDEX iClient, const void *pv
 {
   CTSingleLock slComm(&cm_csComm, TRUE);
   ASSERT(iClient>=0 && iClient<SERVER_CLIENTS);
-  cm_aciClients[iClient].Send(pvSend, slSendSize,TRUE);
+  cci_aciClients[iClient].Send(pvSend, slSendSize,TRUE);
 };
 
 BOOL CCommunicationInterface::Server_Receive_Reliable(INDEX iClient, void *pvReceive, SLONG &slReceiveSize)
 {
   CTSingleLock slComm(&cm_csComm, TRUE);
   ASSERT(iClient>=0 && iClient<SERVER_CLIENTS);
-  return cm_aciClients[iClient].Receive(pvReceive, slReceiveSize,TRUE);
+  return cci_aciClients[iClient].Receive(pvReceive, slReceiveSize,TRUE);
 };
 
 /*
@@ -714,14 +705,14 @@ void CCommunicationInterface::Server_Send_Unreliable(INDEX iClient, const void *
 {
   CTSingleLock slComm(&cm_csComm, TRUE);
   ASSERT(iClient>=0 && iClient<SERVER_CLIENTS);
-  cm_aciClients[iClient].Send(pvSend, slSendSize,FALSE);
+  cci_aciClients[iClient].Send(pvSend, slSendSize,FALSE);
 };
 
 BOOL CCommunicationInterface::Server_Receive_Unreliable(INDEX iClient, void *pvReceive, SLONG &slReceiveSize)
 {
   CTSingleLock slComm(&cm_csComm, TRUE);
   ASSERT(iClient>=0 && iClient<SERVER_CLIENTS);
-  return cm_aciClients[iClient].Receive(pvReceive, slReceiveSize,FALSE);
+  return cci_aciClients[iClient].Receive(pvReceive, slReceiveSize,FALSE);
 };
 
 
@@ -735,18 +726,18 @@ BOOL CCommunicationInterface::Server_Update()
 	INDEX iClient;
 
 	// transfer packets for the local client
-	if (cm_ciLocalClient.ci_bUsed && cm_ciLocalClient.ci_pciOther != NULL) {
-		cm_ciLocalClient.ExchangeBuffers();
+	if (cci_ciLocalClient.ci_bUsed && cci_ciLocalClient.ci_pciOther != NULL) {
+		cci_ciLocalClient.ExchangeBuffers();
 	};
 
-	cm_aciClients[0].UpdateOutputBuffers();
+	cci_aciClients[0].UpdateOutputBuffers();
 
 	// if not just playing single player
 	if (cci_bServerInitialized) {
 		Broadcast_Update_t();
 		// for each client transfer packets from the output buffer to the master output buffer
 		for (iClient=1; iClient<SERVER_CLIENTS; iClient++) {
-			CClientInterface &ci = cm_aciClients[iClient];
+			CClientInterface &ci = cci_aciClients[iClient];
 			// if not connected
 			if (!ci.ci_bUsed) {
 				// skip it
@@ -771,7 +762,7 @@ BOOL CCommunicationInterface::Server_Update()
 					}
 				}
 			} else {
-        CPrintF(TRANS("Unable to deliver data to client '%s', disconnecting.\n"),AddressToString(cm_aciClients[iClient].ci_adrAddress.adr_ulAddress));
+        CPrintF(TRANS("Unable to deliver data to client '%s', disconnecting.\n"),AddressToString(cci_aciClients[iClient].ci_adrAddress.adr_ulAddress));
         Server_ClearClient(iClient);
         _pNetwork->ga_srvServer.HandleClientDisconected(iClient);
 
@@ -780,12 +771,12 @@ BOOL CCommunicationInterface::Server_Update()
 
 		// update broadcast output buffers
 		// update its buffers
-		cm_ciBroadcast.UpdateOutputBuffers();
+		cci_ciBroadcast.UpdateOutputBuffers();
 		// transfer packets ready to be sent out to the master output buffer
-		while (cm_ciBroadcast.ci_pbOutputBuffer.pb_ulNumOfPackets > 0) {
-			ppaPacket = cm_ciBroadcast.ci_pbOutputBuffer.PeekFirstPacket();
+		while (cci_ciBroadcast.ci_pbOutputBuffer.pb_ulNumOfPackets > 0) {
+			ppaPacket = cci_ciBroadcast.ci_pbOutputBuffer.PeekFirstPacket();
 			if (ppaPacket->pa_tvSendWhen < tvNow) {
-				cm_ciBroadcast.ci_pbOutputBuffer.RemoveFirstPacket(FALSE);
+				cci_ciBroadcast.ci_pbOutputBuffer.RemoveFirstPacket(FALSE);
 				cci_pbMasterOutput.AppendPacket(*ppaPacket,FALSE);
 			} else {
 				break;
@@ -801,12 +792,12 @@ BOOL CCommunicationInterface::Server_Update()
 			ppaPacket = cci_pbMasterInput.GetFirstPacket();
 			bClientFound = FALSE;
 			if (ppaPacket->pa_adrAddress.adr_uwID=='//' || ppaPacket->pa_adrAddress.adr_uwID==0) {
-				cm_ciBroadcast.ci_pbInputBuffer.AppendPacket(*ppaPacket,FALSE);
+				cci_ciBroadcast.ci_pbInputBuffer.AppendPacket(*ppaPacket,FALSE);
 				bClientFound = TRUE;
 			} else {
 				for (iClient=0; iClient<SERVER_CLIENTS; iClient++) {
-					if (ppaPacket->pa_adrAddress.adr_uwID == cm_aciClients[iClient].ci_adrAddress.adr_uwID) {
-						cm_aciClients[iClient].ci_pbInputBuffer.AppendPacket(*ppaPacket,FALSE);
+					if (ppaPacket->pa_adrAddress.adr_uwID == cci_aciClients[iClient].ci_adrAddress.adr_uwID) {
+						cci_aciClients[iClient].ci_pbInputBuffer.AppendPacket(*ppaPacket,FALSE);
 						bClientFound = TRUE;
 						break;
 					}
@@ -816,20 +807,20 @@ BOOL CCommunicationInterface::Server_Update()
 				// warn about possible attack
 				extern INDEX net_bReportMiscErrors;
 				if (net_bReportMiscErrors) {
-					CPrintF(TRANS("WARNING: Invalid message from: %s\n"), AddressToString(ppaPacket->pa_adrAddress.adr_ulAddress));
+					CLogF(LC_NETWORK, LS_WARNING, TRANS("WARNING: Invalid message from: %s\n"), AddressToString(ppaPacket->pa_adrAddress.adr_ulAddress));
 				}
 			}
  		}
 
 		for (iClient=1; iClient<SERVER_CLIENTS; iClient++) {
-			cm_aciClients[iClient].UpdateInputBuffers();
+			cci_aciClients[iClient].UpdateInputBuffers();
 		}
 
 		
 	}
-	cm_aciClients[0].UpdateInputBuffers();
-	cm_ciLocalClient.UpdateInputBuffers();
-	cm_ciBroadcast.UpdateInputBuffersBroadcast();
+	cci_aciClients[0].UpdateInputBuffers();
+	cci_ciLocalClient.UpdateInputBuffers();
+	cci_ciBroadcast.UpdateInputBuffersBroadcast();
 	Broadcast_Update_t();
 
 	return TRUE;
@@ -868,20 +859,20 @@ void CCommunicationInterface::Client_Init_t(ULONG ulServerAddress)
   ASSERT(cci_bInitialized);
   ASSERT(!cci_bClientInitialized);
 
-  cm_ciLocalClient.Clear();
-	cm_ciLocalClient.ci_pbOutputBuffer.pb_ppbsStats = &_pbsSend;
-	cm_ciLocalClient.ci_pbInputBuffer.pb_ppbsStats = &_pbsRecv;
+  cci_ciLocalClient.Clear();
+	cci_ciLocalClient.ci_pbOutputBuffer.pb_ppbsStats = &_pbsSend;
+	cci_ciLocalClient.ci_pbInputBuffer.pb_ppbsStats = &_pbsRecv;
 
   // if this computer is not the server
   if (!cci_bServerInitialized) {
     // open with connecting to remote server
-    cm_ciLocalClient.ci_bClientLocal= FALSE;
+    cci_ciLocalClient.ci_bClientLocal= FALSE;
     Client_OpenNet_t(ulServerAddress);
 
   // if this computer is server
   } else {
     // open local client
-    cm_ciLocalClient.ci_bClientLocal = TRUE;
+    cci_ciLocalClient.ci_bClientLocal = TRUE;
     Client_OpenLocal();
   }
 
@@ -901,8 +892,8 @@ void CCommunicationInterface::Client_Close(void)
   for(TIME tmWait=0; tmWait<500;
     Sleep(NET_WAITMESSAGE_DELAY), tmWait+=NET_WAITMESSAGE_DELAY) {
     // if all packets are successfully sent, exit loop
-		if  ((cm_ciLocalClient.ci_pbOutputBuffer.pb_ulNumOfPackets == 0) 
-			&& (cm_ciLocalClient.ci_pbWaitAckBuffer.pb_ulNumOfPackets == 0)) {
+		if  ((cci_ciLocalClient.ci_pbOutputBuffer.pb_ulNumOfPackets == 0) 
+			&& (cci_ciLocalClient.ci_pbWaitAckBuffer.pb_ulNumOfPackets == 0)) {
 				break;
 			}
     if (Client_Update() == FALSE) {
@@ -910,9 +901,9 @@ void CCommunicationInterface::Client_Close(void)
 		}
 	}
 
-  cm_ciLocalClient.Clear();
+  cci_ciLocalClient.Clear();
 
-  cm_ciLocalClient.ci_bClientLocal= FALSE;
+  cci_ciLocalClient.ci_bClientLocal= FALSE;
   cci_bClientInitialized = FALSE;
 };
 
@@ -924,8 +915,8 @@ void CCommunicationInterface::Client_OpenLocal(void)
 {
   CTSingleLock slComm(&cm_csComm, TRUE);
 
-  CClientInterface &ci0 = cm_ciLocalClient;
-  CClientInterface &ci1 = cm_aciClients[SERVER_LOCAL_CLIENT];
+  CClientInterface &ci0 = cci_ciLocalClient;
+  CClientInterface &ci1 = cci_aciClients[SERVER_LOCAL_CLIENT];
     
   ci0.ci_bUsed = TRUE;
   ci0.SetLocal(&ci1);
@@ -968,13 +959,13 @@ void CCommunicationInterface::Client_OpenNet_t(ULONG ulServerAddress)
 	ppaInfoPacket->pa_adrAddress.adr_ulAddress = ulServerAddress;
 	ppaInfoPacket->pa_adrAddress.adr_uwPort = net_iPort;
 	ppaInfoPacket->pa_ubRetryNumber = 0;
-	ppaInfoPacket->WriteToPacket(&ubDummy,1,ubReliable,cm_ciLocalClient.ci_ulSequence++,'//',1);
+	ppaInfoPacket->WriteToPacket(&ubDummy,1,ubReliable,cci_ciLocalClient.ci_ulSequence++,'//',1);
 
-	cm_ciLocalClient.ci_pbOutputBuffer.AppendPacket(*ppaInfoPacket,TRUE);
+	cci_ciLocalClient.ci_pbOutputBuffer.AppendPacket(*ppaInfoPacket,TRUE);
 
 	// set client destination address to server address
-	cm_ciLocalClient.ci_adrAddress.adr_ulAddress = ulServerAddress;
-	cm_ciLocalClient.ci_adrAddress.adr_uwPort = net_iPort;
+	cci_ciLocalClient.ci_adrAddress.adr_ulAddress = ulServerAddress;
+	cci_ciLocalClient.ci_adrAddress.adr_uwPort = net_iPort;
 	
   // for each retry
   for(INDEX iRetry=0; iRetry<ctRetries; iRetry++) {
@@ -984,19 +975,19 @@ void CCommunicationInterface::Client_OpenNet_t(ULONG ulServerAddress)
 		}
 
 		// if there is something in the input buffer
-		if (cm_ciLocalClient.ci_pbReliableInputBuffer.pb_ulNumOfPackets > 0) {
-			ppaReadPacket = cm_ciLocalClient.ci_pbReliableInputBuffer.GetFirstPacket();
+		if (cci_ciLocalClient.ci_pbReliableInputBuffer.pb_ulNumOfPackets > 0) {
+			ppaReadPacket = cci_ciLocalClient.ci_pbReliableInputBuffer.GetFirstPacket();
 			// and it is a connection confirmation
 			if (ppaReadPacket->pa_ubReliable &&  UDP_PACKET_CONNECT_RESPONSE) {
 				// the client has succedeed to connect, so read the uwID from the packet
-				cm_ciLocalClient.ci_adrAddress.adr_ulAddress = ulServerAddress;
-				cm_ciLocalClient.ci_adrAddress.adr_uwPort = net_iPort;
-				cm_ciLocalClient.ci_adrAddress.adr_uwID = *((UWORD*) (ppaReadPacket->pa_pubPacketData + MAX_HEADER_SIZE));
-				cm_ciLocalClient.ci_bUsed = TRUE;
-				cm_ciLocalClient.ci_bClientLocal = FALSE;
-				cm_ciLocalClient.ci_pciOther = NULL;
+				cci_ciLocalClient.ci_adrAddress.adr_ulAddress = ulServerAddress;
+				cci_ciLocalClient.ci_adrAddress.adr_uwPort = net_iPort;
+				cci_ciLocalClient.ci_adrAddress.adr_uwID = *((UWORD*) (ppaReadPacket->pa_pubPacketData + MAX_HEADER_SIZE));
+				cci_ciLocalClient.ci_bUsed = TRUE;
+				cci_ciLocalClient.ci_bClientLocal = FALSE;
+				cci_ciLocalClient.ci_pciOther = NULL;
 
-				cm_ciLocalClient.ci_pbReliableInputBuffer.RemoveConnectResponsePackets();
+				cci_ciLocalClient.ci_pbReliableInputBuffer.RemoveConnectResponsePackets();
 
 				delete ppaReadPacket;
 
@@ -1024,7 +1015,7 @@ void CCommunicationInterface::Client_Clear(void)
   // synchronize access to communication data
   CTSingleLock slComm(&cm_csComm, TRUE);
 
-  cm_ciLocalClient.Clear();
+  cci_ciLocalClient.Clear();
 };
 
 /*
@@ -1035,7 +1026,7 @@ BOOL CCommunicationInterface::Client_IsConnected(void)
   // synchronize access to communication data
   CTSingleLock slComm(&cm_csComm, TRUE);
 
-  return cm_ciLocalClient.ci_bUsed;
+  return cci_ciLocalClient.ci_bUsed;
 };
 
 /*
@@ -1044,25 +1035,25 @@ BOOL CCommunicationInterface::Client_IsConnected(void)
 void CCommunicationInterface::Client_Send_Reliable(const void *pvSend, SLONG slSendSize)
 {
   CTSingleLock slComm(&cm_csComm, TRUE);
-  cm_ciLocalClient.Send(pvSend, slSendSize,TRUE);
+  cci_ciLocalClient.Send(pvSend, slSendSize,TRUE);
 };
 
 BOOL CCommunicationInterface::Client_Receive_Reliable(void *pvReceive, SLONG &slReceiveSize)
 {
   CTSingleLock slComm(&cm_csComm, TRUE);
-  return cm_ciLocalClient.Receive(pvReceive, slReceiveSize,TRUE);
+  return cci_ciLocalClient.Receive(pvReceive, slReceiveSize,TRUE);
 };
 
 BOOL CCommunicationInterface::Client_Receive_Reliable(CTStream &strmReceive)
 {
   CTSingleLock slComm(&cm_csComm, TRUE);
-  return cm_ciLocalClient.Receive(strmReceive,TRUE);
+  return cci_ciLocalClient.Receive(strmReceive,TRUE);
 };
 
 void CCommunicationInterface::Client_PeekSize_Reliable(SLONG &slExpectedSize,SLONG &slReceivedSize)
 {
-  slExpectedSize = cm_ciLocalClient.GetExpectedReliableSize();
-  slReceivedSize = cm_ciLocalClient.GetCurrentReliableSize();
+  slExpectedSize = cci_ciLocalClient.GetExpectedReliableSize();
+  slReceivedSize = cci_ciLocalClient.GetCurrentReliableSize();
 }
 
 
@@ -1072,13 +1063,13 @@ void CCommunicationInterface::Client_PeekSize_Reliable(SLONG &slExpectedSize,SLO
 void CCommunicationInterface::Client_Send_Unreliable(const void *pvSend, SLONG slSendSize)
 {
   CTSingleLock slComm(&cm_csComm, TRUE);
-  cm_ciLocalClient.Send(pvSend, slSendSize,FALSE);
+  cci_ciLocalClient.Send(pvSend, slSendSize,FALSE);
 };
 
 BOOL CCommunicationInterface::Client_Receive_Unreliable(void *pvReceive, SLONG &slReceiveSize)
 {
   CTSingleLock slComm(&cm_csComm, TRUE);
-  return cm_ciLocalClient.Receive(pvReceive, slReceiveSize,FALSE);
+  return cci_ciLocalClient.Receive(pvReceive, slReceiveSize,FALSE);
 };
 
 
@@ -1091,21 +1082,21 @@ BOOL CCommunicationInterface::Client_Update(void)
 	CTimerValue tvNow = _pTimer->GetHighPrecisionTimer();
 
 	// update local client's output buffers
-	if (cm_ciLocalClient.UpdateOutputBuffers() == FALSE) {
+	if (cci_ciLocalClient.UpdateOutputBuffers() == FALSE) {
 		return FALSE;
 	}
 
 	// if not playing on the server (i.e. connectet to a remote server)
 	if (!cci_bServerInitialized) {
 		// put all pending packets in the master output buffer
-		while (cm_ciLocalClient.ci_pbOutputBuffer.pb_ulNumOfPackets > 0) {
-			ppaPacket = cm_ciLocalClient.ci_pbOutputBuffer.PeekFirstPacket();
+		while (cci_ciLocalClient.ci_pbOutputBuffer.pb_ulNumOfPackets > 0) {
+			ppaPacket = cci_ciLocalClient.ci_pbOutputBuffer.PeekFirstPacket();
 			if (ppaPacket->pa_tvSendWhen < tvNow) {
-				cm_ciLocalClient.ci_pbOutputBuffer.RemoveFirstPacket(FALSE);
+				cci_ciLocalClient.ci_pbOutputBuffer.RemoveFirstPacket(FALSE);
 				if (ppaPacket->pa_ubReliable & UDP_PACKET_RELIABLE) {
 					ppaPacketCopy = new CPacket;
 					*ppaPacketCopy = *ppaPacket;
-					cm_ciLocalClient.ci_pbWaitAckBuffer.AppendPacket(*ppaPacketCopy,FALSE);
+					cci_ciLocalClient.ci_pbWaitAckBuffer.AppendPacket(*ppaPacketCopy,FALSE);
 				}
 				cci_pbMasterOutput.AppendPacket(*ppaPacket,FALSE);
 
@@ -1116,12 +1107,12 @@ BOOL CCommunicationInterface::Client_Update(void)
 
 		// update broadcast output buffers
 		// update its buffers
-		cm_ciBroadcast.UpdateOutputBuffers();
+		cci_ciBroadcast.UpdateOutputBuffers();
 		// transfer packets ready to be sent out to the master output buffer
-		while (cm_ciBroadcast.ci_pbOutputBuffer.pb_ulNumOfPackets > 0) {
-			ppaPacket = cm_ciBroadcast.ci_pbOutputBuffer.PeekFirstPacket();
+		while (cci_ciBroadcast.ci_pbOutputBuffer.pb_ulNumOfPackets > 0) {
+			ppaPacket = cci_ciBroadcast.ci_pbOutputBuffer.PeekFirstPacket();
 			if (ppaPacket->pa_tvSendWhen < tvNow) {
-				cm_ciBroadcast.ci_pbOutputBuffer.RemoveFirstPacket(FALSE);
+				cci_ciBroadcast.ci_pbOutputBuffer.RemoveFirstPacket(FALSE);
 				cci_pbMasterOutput.AppendPacket(*ppaPacket,FALSE);
 			} else {
 				break;
@@ -1140,27 +1131,27 @@ BOOL CCommunicationInterface::Client_Update(void)
       // if the packet address is broadcast and it's an unreliable transfer, put it in the broadcast buffer
       if ((ppaPacket->pa_adrAddress.adr_uwID=='//' || ppaPacket->pa_adrAddress.adr_uwID==0) && 
            ppaPacket->pa_ubReliable == UDP_PACKET_UNRELIABLE) {
-        cm_ciBroadcast.ci_pbInputBuffer.AppendPacket(*ppaPacket,FALSE);
+        cci_ciBroadcast.ci_pbInputBuffer.AppendPacket(*ppaPacket,FALSE);
 				bClientFound = TRUE;
       // if the packet is for this client, accept it
-      } else if ((ppaPacket->pa_adrAddress.adr_uwID == cm_ciLocalClient.ci_adrAddress.adr_uwID) || 
+      } else if ((ppaPacket->pa_adrAddress.adr_uwID == cci_ciLocalClient.ci_adrAddress.adr_uwID) || 
 				          ppaPacket->pa_adrAddress.adr_uwID=='//' || ppaPacket->pa_adrAddress.adr_uwID==0) { 
-				cm_ciLocalClient.ci_pbInputBuffer.AppendPacket(*ppaPacket,FALSE);
+				cci_ciLocalClient.ci_pbInputBuffer.AppendPacket(*ppaPacket,FALSE);
 				bClientFound = TRUE;
 			}
 			if (!bClientFound) {
 				// warn about possible attack
 				extern INDEX net_bReportMiscErrors;
 				if (net_bReportMiscErrors) {
-					CPrintF(TRANS("WARNING: Invalid message from: %s\n"), AddressToString(ppaPacket->pa_adrAddress.adr_ulAddress));
+					CLogF(LC_NETWORK, LS_WARNING, TRANS("WARNING: Invalid message from: %s\n"), AddressToString(ppaPacket->pa_adrAddress.adr_ulAddress));
 				}
 			}
  		}
 
 	}
 
-	cm_ciLocalClient.UpdateInputBuffers();
-	cm_ciBroadcast.UpdateInputBuffersBroadcast();
+	cci_ciLocalClient.UpdateInputBuffers();
+	cci_ciBroadcast.UpdateInputBuffersBroadcast();
 
 	return TRUE;
 };
@@ -1212,7 +1203,7 @@ void CCommunicationInterface::UpdateMasterBuffers()
 					// the packet is in error
           extern INDEX net_bReportMiscErrors;          
           if (net_bReportMiscErrors) {
-					  CPrintF(TRANS("WARNING: Bad UDP packet from '%s'\n"), AddressToString(adrIncomingAddress.adr_ulAddress));
+					  CLogF(LC_NETWORK, LS_WARNING, TRANS("WARNING: Bad UDP packet from '%s'\n"), AddressToString(adrIncomingAddress.adr_ulAddress));
           }
 					// there might be more to do
 					bSomethingDone = TRUE;
@@ -24,6 +24,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #define SERVER_CLIENTS 16
 
 #include <Engine/Network/CPacket.h>
+#include <Engine/Network/ClientInterface.h>
 
 // Communication class
 class ENGINE_API CCommunicationInterface {
@@ -40,6 +41,14 @@ public:
 
   SOCKET cci_hSocket;						// the socket handle itself
 
+  BOOL cci_bNetworkInitialized;
+  // index 0 is the server's local client, this is an array used by server only
+  CClientInterface cci_aciClients[SERVER_CLIENTS];
+  // broadcast interface - i.e. interface for 'nonconnected' communication
+  CClientInterface cci_ciBroadcast;
+  // this is used by client only
+  CClientInterface cci_ciLocalClient;
+
 public:
   // client
   void Client_OpenLocal(void);
@@ -119,7 +128,8 @@ public:
   BOOL Client_Update(void);
 };
 
-extern ENGINE_API CCommunicationInterface _cmiComm;
+// current communication interface (there is one for each hosted session)
+extern ENGINE_API CCommunicationInterface *_pcmiComm;
 extern CPacketBufferStats _pbsSend;
 extern CPacketBufferStats _pbsRecv;
 
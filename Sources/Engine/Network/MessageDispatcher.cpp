@@ -126,7 +126,7 @@ void CNetworkSession::Copy(const CNetworkSession &nsOriginal)
  */
 CMessageDispatcher::CMessageDispatcher(void) {
   if (!_bTempNetwork) {
-    _cmiComm.Init();
+    _pcmiComm->Init();
   }
   // enumerate network providers
   EnumNetworkProviders_startup(md_lhProviders);
@@ -138,7 +138,7 @@ CMessageDispatcher::CMessageDispatcher(void) {
 CMessageDispatcher::~CMessageDispatcher(void)
 {
   if (!_bTempNetwork) {
-    _cmiComm.Close();
+    _pcmiComm->Close();
   }
   // destroy the list of network providers
   FORDELETELIST(CNetworkProvider, np_Node, md_lhProviders, litProviders) {
@@ -196,11 +196,11 @@ void CMessageDispatcher::EnumNetworkProviders(CListHead &lh)
 void CMessageDispatcher::StartProvider_t(const CNetworkProvider &npProvider)
 {
   if (npProvider.np_Description=="Local") {
-    _cmiComm.PrepareForUse(FALSE, FALSE);
+    _pcmiComm->PrepareForUse(FALSE, FALSE);
   } else if (npProvider.np_Description=="TCP/IP Server") {
-    _cmiComm.PrepareForUse(TRUE, FALSE);
+    _pcmiComm->PrepareForUse(TRUE, FALSE);
   } else {
-    _cmiComm.PrepareForUse(TRUE, TRUE);
+    _pcmiComm->PrepareForUse(TRUE, TRUE);
   }
 }
 
@@ -209,7 +209,7 @@ void CMessageDispatcher::StartProvider_t(const CNetworkProvider &npProvider)
  */
 void CMessageDispatcher::StopProvider(void)
 {
-  _cmiComm.Unprepare();
+  _pcmiComm->Unprepare();
 }
 
 /////////////////////////////////////////////////////////////////////
@@ -275,7 +275,7 @@ void CMessageDispatcher::SendToClient(INDEX iClient, const CNetworkMessage &nmMe
 
   _pfNetworkProfile.StartTimer(CNetworkProfile::PTI_SENDMESSAGE);
   // send the message
-  _cmiComm.Server_Send_Unreliable(iClient, (void*)nmMessage.nm_pubMessage, nmMessage.nm_slSize);
+  _pcmiComm->Server_Send_Unreliable(iClient, (void*)nmMessage.nm_pubMessage, nmMessage.nm_slSize);
 	
   UpdateSentMessageStats(nmMessage);
   _pfNetworkProfile.StopTimer(CNetworkProfile::PTI_SENDMESSAGE);
@@ -285,7 +285,7 @@ void CMessageDispatcher::SendToClientReliable(INDEX iClient, const CNetworkMessa
   _pfNetworkProfile.StartTimer(CNetworkProfile::PTI_SENDMESSAGE);
 	
   // send the message
-  _cmiComm.Server_Send_Reliable(iClient, (void*)nmMessage.nm_pubMessage, nmMessage.nm_slSize);
+  _pcmiComm->Server_Send_Reliable(iClient, (void*)nmMessage.nm_pubMessage, nmMessage.nm_slSize);
   UpdateSentMessageStats(nmMessage);
   _pfNetworkProfile.StopTimer(CNetworkProfile::PTI_SENDMESSAGE);
 }
@@ -298,7 +298,7 @@ void CMessageDispatcher::SendToClientReliable(INDEX iClient, CTMemoryStream &str
   SLONG slSize;
   strmMessage.LockBuffer(&pvBuffer, &slSize);
   // send the message
-  _cmiComm.Server_Send_Reliable(iClient, pvBuffer, slSize);
+  _pcmiComm->Server_Send_Reliable(iClient, pvBuffer, slSize);
   strmMessage.UnlockBuffer();
   UpdateSentStreamStats(slSize);
   _pfNetworkProfile.StopTimer(CNetworkProfile::PTI_SENDMESSAGE);
@@ -309,7 +309,7 @@ void CMessageDispatcher::SendToServer(const CNetworkMessage &nmMessage)
 {
   _pfNetworkProfile.StartTimer(CNetworkProfile::PTI_SENDMESSAGE);
   // send the message
-  _cmiComm.Client_Send_Unreliable((void*)nmMessage.nm_pubMessage, nmMessage.nm_slSize);
+  _pcmiComm->Client_Send_Unreliable((void*)nmMessage.nm_pubMessage, nmMessage.nm_slSize);
 	UpdateSentMessageStats(nmMessage);
   _pfNetworkProfile.StopTimer(CNetworkProfile::PTI_SENDMESSAGE);
 }
@@ -318,7 +318,7 @@ void CMessageDispatcher::SendToServerReliable(const CNetworkMessage &nmMessage)
 {
   _pfNetworkProfile.StartTimer(CNetworkProfile::PTI_SENDMESSAGE);
   // send the message
-  _cmiComm.Client_Send_Reliable((void*)nmMessage.nm_pubMessage, nmMessage.nm_slSize);
+  _pcmiComm->Client_Send_Reliable((void*)nmMessage.nm_pubMessage, nmMessage.nm_slSize);
   UpdateSentMessageStats(nmMessage);
   _pfNetworkProfile.StopTimer(CNetworkProfile::PTI_SENDMESSAGE);
 }
@@ -329,7 +329,7 @@ BOOL CMessageDispatcher::ReceiveFromServer(CNetworkMessage &nmMessage)
   _pfNetworkProfile.StartTimer(CNetworkProfile::PTI_RECEIVEMESSAGE);
   // receive message in static buffer
   nmMessage.nm_slSize = nmMessage.nm_slMaxSize;
-  BOOL bReceived = _cmiComm.Client_Receive_Unreliable(
+  BOOL bReceived = _pcmiComm->Client_Receive_Unreliable(
     (void*)nmMessage.nm_pubMessage, nmMessage.nm_slSize);
 
   // if there is message
@@ -352,7 +352,7 @@ BOOL CMessageDispatcher::ReceiveFromServerReliable(CNetworkMessage &nmMessage)
   _pfNetworkProfile.StartTimer(CNetworkProfile::PTI_RECEIVEMESSAGE);
   // receive message in static buffer
   nmMessage.nm_slSize = nmMessage.nm_slMaxSize;
-  BOOL bReceived = _cmiComm.Client_Receive_Reliable(
+  BOOL bReceived = _pcmiComm->Client_Receive_Reliable(
     (void*)nmMessage.nm_pubMessage, nmMessage.nm_slSize);
 
   // if there is message
@@ -374,7 +374,7 @@ BOOL CMessageDispatcher::ReceiveFromServerReliable(CTMemoryStream &strmMessage)
 {
   _pfNetworkProfile.StartTimer(CNetworkProfile::PTI_RECEIVEMESSAGE);
   // receive message in stream
-  BOOL bReceived = _cmiComm.Client_Receive_Reliable(strmMessage);
+  BOOL bReceived = _pcmiComm->Client_Receive_Reliable(strmMessage);
 	
   // if there is message
   if (bReceived) {
@@ -393,7 +393,7 @@ BOOL CMessageDispatcher::ReceiveFromClient(INDEX iClient, CNetworkMessage &nmMes
   _pfNetworkProfile.StartTimer(CNetworkProfile::PTI_RECEIVEMESSAGE);
   // receive message in static buffer
   nmMessage.nm_slSize = nmMessage.nm_slMaxSize;
-  BOOL bReceived = _cmiComm.Server_Receive_Unreliable(iClient,
+  BOOL bReceived = _pcmiComm->Server_Receive_Unreliable(iClient,
     (void*)nmMessage.nm_pubMessage, nmMessage.nm_slSize);
 
   // if there is message
@@ -416,7 +416,7 @@ BOOL CMessageDispatcher::ReceiveFromClientReliable(INDEX iClient, CNetworkMessag
 //  _pfNetworkProfile.StartTimer(CNetworkProfile::PTI_RECEIVEMESSAGE);  // profile this!!!!
   // receive message in static buffer
   nmMessage.nm_slSize = nmMessage.nm_slMaxSize;
-  BOOL bReceived = _cmiComm.Server_Receive_Reliable(iClient,
+  BOOL bReceived = _pcmiComm->Server_Receive_Reliable(iClient,
     (void*)nmMessage.nm_pubMessage, nmMessage.nm_slSize);
 
   // if there is a message
@@ -442,7 +442,7 @@ void CMessageDispatcher::SendBroadcast(const CNetworkMessage &nmMessage, ULONG u
   adrDestination.adr_uwPort = uwPort;
   adrDestination.adr_uwID = '//';
   // send the message
-  _cmiComm.Broadcast_Send((void*)nmMessage.nm_pubMessage, nmMessage.nm_slSize,adrDestination);
+  _pcmiComm->Broadcast_Send((void*)nmMessage.nm_pubMessage, nmMessage.nm_slSize,adrDestination);
 
   UpdateSentMessageStats(nmMessage);
 }
@@ -452,7 +452,7 @@ BOOL CMessageDispatcher::ReceiveBroadcast(CNetworkMessage &nmMessage, ULONG &ulA
   CAddress adrSource = {0,0,0};
   // receive message in static buffer
   nmMessage.nm_slSize = nmMessage.nm_slMaxSize;
-  BOOL bReceived = _cmiComm.Broadcast_Receive(
+  BOOL bReceived = _pcmiComm->Broadcast_Receive(
     (void*)nmMessage.nm_pubMessage, nmMessage.nm_slSize,adrSource);
 
   // if there is message
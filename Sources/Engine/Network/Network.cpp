@@ -17,9 +17,13 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include <Engine/Build.h>
 #include <Engine/Base/Console.h>
+#include <Engine/Base/CRC.h>
 #include <Engine/Base/CRCTable.h>
 #include <Engine/Base/Shell.h>
 #include <Engine/Base/ProgressHook.h>
+#include <Engine/Base/Unzip.h>
+#include <Engine/Base/MemoryPool.h>
+#include <Engine/Base/BackgroundWrite.h>
 #include <Engine/Network/Server.h>
 #include <Engine/Network/SessionState.h>
 #include <Engine/Network/Network.h>
@@ -129,6 +133,7 @@ extern INDEX cli_bPredictRemotePlayers = FALSE;
 extern FLOAT cli_fPredictEntitiesRange = 20.0f;
 extern INDEX cli_bLerpActions = FALSE;
 extern INDEX cli_bReportPredicted = FALSE;
+extern INDEX cli_bReusePredictors = TRUE;
 extern INDEX cli_iSendBehind = 3;
 extern INDEX cli_iPredictionFlushing = 1;
 
@@ -144,6 +149,7 @@ extern FLOAT net_fSendRetryWait = 0.5f;
 extern INDEX net_bReportTraffic = FALSE;
 extern INDEX net_bReportICMPErrors = FALSE;
 extern INDEX net_bReportMiscErrors = FALSE;
+extern INDEX net_bAsyncSave = TRUE;
 extern INDEX net_bLerping       = TRUE;
 extern INDEX net_iGraphBuffer = 100;
 extern INDEX net_iExactTimer = 2;
@@ -340,7 +346,7 @@ static void NetworkInfo(void)
     for(INDEX iSession=0; iSession<_pNetwork->ga_srvServer.srv_assoSessions.Count(); iSession++) {
       CSessionSocket &sso = _pNetwork->ga_srvServer.srv_assoSessions[iSession];
       if (sso.sso_bActive) {
-        CPrintF("  %2d:'%s'\n", iSession, _cmiComm.Server_GetClientName(iSession)),
+        CPrintF("  %2d:'%s'\n", iSession, _pcmiComm->Server_GetClientName(iSession)),
         CPrintF("    buffer: %dblk=%dk\n",
           sso.sso_nsBuffer.GetUsedBlocks(),
           sso.sso_nsBuffer.GetUsedMemory()/1024);
@@ -380,7 +386,7 @@ static void NetworkInfo(void)
     if (TIMER_PROFILING) {
         CTString strNetProfile;
         _pfNetworkProfile.Report(strNetProfile);
-        CPrintF(strNetProfile);
+        CLogF(LC_PROFILING, LS_INFO, "%s", (const char*)strNetProfile);
     }
 }
 
@@ -651,6 +657,157 @@ extern void FreeUnusedStock(void)
 }
 
 
+#define GATHER_STOCK_NAMES(pstStock, iStock) \
+  {for (INDEX i=0; i<pstStock->st_ctObjects.Count(); i++) { \
+    astrNames.Push() = pstStock->st_ctObjects[i].GetName(); \
+    aiStocks.Push() = iStock; \
+  }}
+
+#define FIND_IN_STOCK(iStock, name) \
+  switch (iStock) { \
+  case 0: return _pEntityClassStock->st_ntObjects.Find(name)!=NULL; \
+  case 1: return _pModelStock->st_ntObjects.Find(name)!=NULL; \
+  case 2: return _pTextureStock->st_ntObjects.Find(name)!=NULL; \
+  case 3: return _pSoundStock->st_ntObjects.Find(name)!=NULL; \
+  case 4: return _pAnimStock->st_ntObjects.Find(name)!=NULL; \
+  case 5: return _pMeshStock->st_ntObjects.Find(name)!=NULL; \
+  case 6: return _pSkeletonStock->st_ntObjects.Find(name)!=NULL; \
+  case 7: return _pAnimSetStock->st_ntObjects.Find(name)!=NULL; \
+  default: return _pShaderStock->st_ntObjects.Find(name)!=NULL; \
+  }
+
+static BOOL FindInStock(INDEX iStock, const CTString &strName) { FIND_IN_STOCK(iStock, strName); }
+static BOOL FindInStock(INDEX iStock, const CTFileName &fnmName) { FIND_IN_STOCK(iStock, fnmName); }
+
+// time lookups that precaching does for all currently stocked objects, with plain strings,
+// with file names that must be interned first and with ones that already carry atoms
+static void FileNameBenchmark(void *pArgs)
+{
+  INDEX ctRepeats = NEXTARGUMENT(INDEX);
+  if (ctRepeats<1) {
+    ctRepeats = 100;
+  }
+
+  // gather names of all stocked objects
+  CStaticStackArray<CTString> astrNames;
+  CStaticStackArray<INDEX> aiStocks;
+  GATHER_STOCK_NAMES(_pEntityClassStock, 0);
+  GATHER_STOCK_NAMES(_pModelStock,       1);
+  GATHER_STOCK_NAMES(_pTextureStock,     2);
+  GATHER_STOCK_NAMES(_pSoundStock,       3);
+  GATHER_STOCK_NAMES(_pAnimStock,        4);
+  GATHER_STOCK_NAMES(_pMeshStock,        5);
+  GATHER_STOCK_NAMES(_pSkeletonStock,    6);
+  GATHER_STOCK_NAMES(_pAnimSetStock,     7);
+  GATHER_STOCK_NAMES(_pShaderStock,      8);
+  const INDEX ctNames = astrNames.Count();
+  if (ctNames==0) {
+    CPrintF(TRANS("Nothing is stocked, start a level first.\n"));
+    return;
+  }
+  CStaticArray<CTFileName> afnmNames;
+  afnmNames.New(ctNames);
+  for (INDEX iName=0; iName<ctNames; iName++) {
+    afnmNames[iName] = astrNames[iName];
+  }
+
+  INDEX ctFound = 0;
+  INDEX ctInZips = 0;
+  // plain strings, hashed and compared by characters in stocks
+  CTimerValue tvStart = _pTimer->GetHighPrecisionTimer();
+  {for (INDEX iRepeat=0; iRepeat<ctRepeats; iRepeat++) {
+    for (INDEX iName=0; iName<ctNames; iName++) {
+      ctFound += FindInStock(aiStocks[iName], astrNames[iName]);
+    }
+  }}
+  const DOUBLE dStrings = (_pTimer->GetHighPrecisionTimer()-tvStart).GetSeconds();
+
+  // file names without atoms, as in code and in files without dictionary (cold)
+  DOUBLE dCold = 0.0;
+  {for (INDEX iRepeat=0; iRepeat<ctRepeats; iRepeat++) {
+    for (INDEX iName=0; iName<ctNames; iName++) {
+      afnmNames[iName].ForgetAtom();
+    }
+    tvStart = _pTimer->GetHighPrecisionTimer();
+    for (INDEX iName=0; iName<ctNames; iName++) {
+      ctFound += FindInStock(aiStocks[iName], afnmNames[iName]);
+      ctInZips += UNZIPGetFileIndex(afnmNames[iName])>=0;
+    }
+    dCold += (_pTimer->GetHighPrecisionTimer()-tvStart).GetSeconds();
+  }}
+
+  // file names that carry their atoms, as read from world dictionary (warm)
+  tvStart = _pTimer->GetHighPrecisionTimer();
+  {for (INDEX iRepeat=0; iRepeat<ctRepeats; iRepeat++) {
+    for (INDEX iName=0; iName<ctNames; iName++) {
+      ctFound += FindInStock(aiStocks[iName], afnmNames[iName]);
+      ctInZips += UNZIPGetFileIndex(afnmNames[iName])>=0;
+    }
+  }}
+  const DOUBLE dWarm = (_pTimer->GetHighPrecisionTimer()-tvStart).GetSeconds();
+
+  const DOUBLE dToNanoseconds = 1E9/(ctNames*ctRepeats);
+  CPrintF(TRANS("%d stocked file names (%d in archives), %d repeats, %d found:\n"),
+    ctNames, ctInZips/(2*ctRepeats), ctRepeats, ctFound/(3*ctRepeats));
+  CPrintF(TRANS("  plain strings (stocks only):  %6.0f ns per name\n"), dStrings*dToNanoseconds);
+  CPrintF(TRANS("  names without atoms (cold):   %6.0f ns per name\n"), dCold*dToNanoseconds);
+  CPrintF(TRANS("  names with atoms (warm):      %6.0f ns per name\n"), dWarm*dToNanoseconds);
+  CTString strReport;
+  FNA_Report(strReport);
+  CPrintF("%s", (const char*)strReport);
+}
+
+// size of last saved game
+static SLONG _slLastSaveSize = 0;
+static BOOL _bQuietSave = FALSE;  // don't report saved games (while benchmarking)
+
+// measure how long saving stops the game, synchronously and in background
+static void SaveBenchmark(void *pArgs)
+{
+  INDEX ctSaves = NEXTARGUMENT(INDEX);
+  if (ctSaves<1) {
+    ctSaves = 5;
+  }
+  if (!_pNetwork->IsServer()) {
+    CPrintF(TRANS("Cannot measure saving - not a server!\n"));
+    return;
+  }
+
+  const CTFileName fnmSave = CTString("Temp\\SaveBenchmark.sav");
+  const INDEX bOldAsync = net_bAsyncSave;
+  _bQuietSave = TRUE;
+  DOUBLE adStall[2] = {0.0, 0.0};
+  DOUBLE adMaxStall[2] = {0.0, 0.0};
+  DOUBLE dWrite = 0.0;
+  try {
+    for (INDEX iMode=0; iMode<2; iMode++) {
+      net_bAsyncSave = iMode;
+      for (INDEX iSave=0; iSave<ctSaves; iSave++) {
+        const CTimerValue tvStart = _pTimer->GetHighPrecisionTimer();
+        _pNetwork->Save_t(fnmSave);
+        const DOUBLE dStall = (_pTimer->GetHighPrecisionTimer()-tvStart).GetSeconds();
+        adStall[iMode] += dStall;
+        adMaxStall[iMode] = Max(adMaxStall[iMode], dStall);
+        if (BackgroundWrite_IsPending()) {
+          BackgroundWrite_Wait();
+          dWrite += BackgroundWrite_GetLastSeconds();
+        }
+      }
+    }
+  } catch (char *strError) {
+    CPrintF(TRANS("Cannot save game: %s\n"), strError);
+  }
+  net_bAsyncSave = bOldAsync;
+  _bQuietSave = FALSE;
+
+  CPrintF(TRANS("Saved '%s' (%dk) %d times:\n"), (const char*)_pNetwork->ga_fnmWorld, _slLastSaveSize/1024, ctSaves);
+  CPrintF(TRANS("  synchronous:   game stopped for %6.1f ms average, %6.1f ms max\n"),
+    adStall[0]*1000.0/ctSaves, adMaxStall[0]*1000.0);
+  CPrintF(TRANS("  in background: game stopped for %6.1f ms average, %6.1f ms max, written in %.1f ms\n"),
+    adStall[1]*1000.0/ctSaves, adMaxStall[1]*1000.0, dWrite*1000.0/ctSaves);
+}
+
+
 /*
  * This is called every TickQuantum seconds.
  */
@@ -716,6 +873,24 @@ CNetworkLibrary::~CNetworkLibrary(void)
   delete &ga_srvServer;
 }
 
+// time a demo from console: TimeDemo("Demos\\Demo1.dem", 2)
+static void TimeDemo(void *pArgs)
+{
+  CTString strDemo = *NEXTARGUMENT(CTString*);
+  INDEX ctPasses = NEXTARGUMENT(INDEX);
+
+  if (_pNetwork->ga_strSessionName!="") {
+    CPrintF(TRANS("Stop the game before timing a demo.\n"));
+    return;
+  }
+  CTFileName fnDemo = strDemo;
+  try {
+    _pNetwork->TimeDemo_t(fnDemo, ctPasses, CTString("Temp\\TimeDemo.json"), fnDemo.NoExt()+".crc");
+  } catch(char *strError) {
+    CPrintF(TRANS("Cannot time demo '%s': %s\n"), (const char*)fnDemo, strError);
+  }
+}
+
 
 /*
  * Initialize game management.
@@ -727,6 +902,8 @@ void CNetworkLibrary::Init(const CTString &strGameID)
 
   // add shell symbols
   _pShell->DeclareSymbol("user INDEX dbg_bBreak;", &dbg_bBreak);
+  _pShell->DeclareSymbol("user void FileNameBenchmark(INDEX);", &FileNameBenchmark);
+  _pShell->DeclareSymbol("user void SaveBenchmark(INDEX);", &SaveBenchmark);
   _pShell->DeclareSymbol("persistent user INDEX gam_bPretouch;", &gam_bPretouch);
 
   _pShell->DeclareSymbol("user INDEX dem_iRecordedNumber;",     &dem_iRecordedNumber);
@@ -749,6 +926,7 @@ void CNetworkLibrary::Init(const CTString &strGameID)
   _pShell->DeclareSymbol("user void RemNameMask(CTString);", &RemNameMask);
 
 
+  _pShell->DeclareSymbol("user void TimeDemo(CTString, INDEX);", &TimeDemo);
   _pShell->DeclareSymbol("user FLOAT dem_tmTimer;",         &ga_fDemoTimer);
   _pShell->DeclareSymbol("user FLOAT dem_fSyncRate;",       &ga_fDemoSyncRate);
   _pShell->DeclareSymbol("user FLOAT dem_fRealTimeFactor;", &ga_fDemoRealTimeFactor);
@@ -764,6 +942,22 @@ void CNetworkLibrary::Init(const CTString &strGameID)
   _pShell->DeclareSymbol("user INDEX net_ctChatMessages;", &net_ctChatMessages);
 
   _pShell->DeclareSymbol("persistent user INDEX ent_bReportSpawnInWall;", &ent_bReportSpawnInWall);
+  extern INDEX ent_bClassLookupTables;
+  extern void EntityLookupBenchmark(void *pArgs);
+  _pShell->DeclareSymbol("user INDEX ent_bClassLookupTables;", &ent_bClassLookupTables);
+  _pShell->DeclareSymbol("user void EntityLookupBenchmark(CTString);", &EntityLookupBenchmark);
+  extern INDEX ent_bPropertySerializers;
+  extern void EntitySerializersTest(void *pArgs);
+  _pShell->DeclareSymbol("user INDEX ent_bPropertySerializers;", &ent_bPropertySerializers);
+  _pShell->DeclareSymbol("user void EntitySerializersTest(CTString);", &EntitySerializersTest);
+  extern INDEX ent_bEventArena;
+  extern void EntityEventsBenchmark(void *pArgs);
+  _pShell->DeclareSymbol("user INDEX ent_bEventArena;", &ent_bEventArena);
+  _pShell->DeclareSymbol("user void EntityEventsBenchmark(INDEX, INDEX);", &EntityEventsBenchmark);
+  extern INDEX ent_bIndexedRangeQuery;
+  extern void EntityRangeQueryBenchmark(void *pArgs);
+  _pShell->DeclareSymbol("user INDEX ent_bIndexedRangeQuery;", &ent_bIndexedRangeQuery);
+  _pShell->DeclareSymbol("user void EntityRangeQueryBenchmark(INDEX, INDEX);", &EntityRangeQueryBenchmark);
 
   _pShell->DeclareSymbol("user INDEX ser_bReportSyncOK;",    &ser_bReportSyncOK);
   _pShell->DeclareSymbol("user INDEX ser_bReportSyncBad;",   &ser_bReportSyncBad);
@@ -776,6 +970,9 @@ void CNetworkLibrary::Init(const CTString &strGameID)
   _pShell->DeclareSymbol("persistent user INDEX ser_iSyncCheckBuffer;", &ser_iSyncCheckBuffer);
   _pShell->DeclareSymbol("persistent user INDEX cli_bLerpActions;", &cli_bLerpActions);
   _pShell->DeclareSymbol("persistent user INDEX cli_bReportPredicted;", &cli_bReportPredicted);
+  _pShell->DeclareSymbol("user INDEX cli_bReusePredictors;", &cli_bReusePredictors);
+  extern void PredictionBenchmark(void *pArgs);
+  _pShell->DeclareSymbol("user void PredictionBenchmark(INDEX, INDEX);", &PredictionBenchmark);
   _pShell->DeclareSymbol("persistent user INDEX net_iExactTimer;", &net_iExactTimer);
   _pShell->DeclareSymbol("user INDEX net_bDumpStreamBlocks;",   &net_bDumpStreamBlocks);
   _pShell->DeclareSymbol("user INDEX net_bDumpConnectionInfo;", &net_bDumpConnectionInfo);
@@ -806,6 +1003,7 @@ void CNetworkLibrary::Init(const CTString &strGameID)
   _pShell->DeclareSymbol("persistent user INDEX net_bReportTraffic;", &net_bReportTraffic);
   _pShell->DeclareSymbol("persistent user INDEX net_bReportICMPErrors;", &net_bReportICMPErrors);
   _pShell->DeclareSymbol("persistent user INDEX net_bReportMiscErrors;", &net_bReportMiscErrors);
+  _pShell->DeclareSymbol("persistent user INDEX net_bAsyncSave;", &net_bAsyncSave);
   _pShell->DeclareSymbol("persistent user INDEX net_bLerping;",       &net_bLerping);
   _pShell->DeclareSymbol("persistent user INDEX ser_bClientsMayPause;", &ser_bClientsMayPause);
   _pShell->DeclareSymbol("persistent user INDEX ser_bEnumeration;",      &ser_bEnumeration);
@@ -990,7 +1188,7 @@ void CNetworkLibrary::StartPeerToPeer_t(const CTString &strSessionName,
   CGatherCRC gc;
 
   // if starting in network
-  if (_cmiComm.IsNetworkEnabled()) {
+  if (_pcmiComm->IsNetworkEnabled()) {
     CPrintF( TRANS("  network is on\n"));
     // start gathering CRCs
     InitCRCGather();
@@ -1027,8 +1225,8 @@ void CNetworkLibrary::StartPeerToPeer_t(const CTString &strSessionName,
     ga_World.FilterEntitiesBySpawnFlags(ga_sesSessionState.ses_ulSpawnFlags);
   } catch(char *) {
     ga_fnmWorld = CTString("");
-    _cmiComm.Server_Close();
-    _cmiComm.Client_Close();
+    _pcmiComm->Server_Close();
+    _pcmiComm->Client_Close();
     throw;
   }
   // remember the world pointer
@@ -1099,6 +1297,27 @@ void CNetworkLibrary::Save_t(const CTFileName &fnmGame) // throw char *
     throw TRANS("Cannot save game - not a server!\n");
   }
 
+  // if saving in background
+  if (net_bAsyncSave) {
+    // only take a snapshot of the game into memory here
+    CTMemoryStream *pstrmGame = new CTMemoryStream;
+    try {
+      pstrmGame->WriteID_t("GAME");
+      ga_sesSessionState.Write_t(pstrmGame);
+      pstrmGame->WriteID_t("GEND");   // game end
+      _slLastSaveSize = pstrmGame->GetPos_t();
+      // writer takes over the stream, and reports when the game is saved
+      BackgroundWrite_Start_t(pstrmGame, fnmGame, _bQuietSave ? NULL : TRANS("Saved game: %s\n"));
+    } catch (char *) {
+      delete pstrmGame;
+      throw;
+    }
+    return;
+  }
+
+  // previous save might still be writing the same file
+  BackgroundWrite_Wait();
+
   // create the file
   CTFileStream strmFile;
   strmFile.Create_t(fnmGame);
@@ -1107,6 +1326,7 @@ void CNetworkLibrary::Save_t(const CTFileName &fnmGame) // throw char *
   strmFile.WriteID_t("GAME");
   ga_sesSessionState.Write_t(&strmFile);
   strmFile.WriteID_t("GEND");   // game end
+  _slLastSaveSize = strmFile.GetPos_t();
 }
 
 /*
@@ -1116,6 +1336,9 @@ void CNetworkLibrary::Save_t(const CTFileName &fnmGame) // throw char *
  */
 void CNetworkLibrary::Load_t(const CTFileName &fnmGame) // throw char *
 {
+  // the game might still be being saved
+  BackgroundWrite_Wait();
+
   // mute all sounds
   _pSound->Mute();
 
@@ -1133,7 +1356,7 @@ void CNetworkLibrary::Load_t(const CTFileName &fnmGame) // throw char *
   strmFile.Open_t(fnmGame);
 
   // if starting in network
-  if (_cmiComm.IsNetworkEnabled()) {
+  if (_pcmiComm->IsNetworkEnabled()) {
     // start gathering CRCs
     InitCRCGather();
   }
@@ -1154,7 +1377,7 @@ void CNetworkLibrary::Load_t(const CTFileName &fnmGame) // throw char *
     ga_sesSessionState.Start_t(-1);
     ga_sesSessionState.Read_t(&strmFile);
     // if starting in network
-    if (_cmiComm.IsNetworkEnabled()) {
+    if (_pcmiComm->IsNetworkEnabled()) {
       // make default state data for creating deltas
       MakeDefaultState(ga_fnmWorld, ga_sesSessionState.ses_ulSpawnFlags,
         ga_aubProperties);
@@ -1216,8 +1439,8 @@ void CNetworkLibrary::EnumSessions(BOOL bInternet)
   }
 
   // make sure network is on
-  if (!_cmiComm.IsNetworkEnabled()) {
-    _cmiComm.PrepareForUse(/*network*/TRUE, /*client*/FALSE); // have to enumerate as server
+  if (!_pcmiComm->IsNetworkEnabled()) {
+    _pcmiComm->PrepareForUse(/*network*/TRUE, /*client*/FALSE); // have to enumerate as server
   }
 
   // request enumeration
@@ -1288,6 +1511,19 @@ void CNetworkLibrary::JoinSession_t(const CNetworkSession &nsSesssion, INDEX ctL
   CPrintF("  joined\n");
 }
 
+// read demo header and session state at its start
+static void ReadDemoStart_t(CNetworkLibrary &nl) // throw char *
+{
+  nl.ga_strmDemoPlay.ExpectID_t("DEMO");
+  if (nl.ga_strmDemoPlay.PeekID_t()==CChunkID("MVER")) {
+    nl.ga_strmDemoPlay.ExpectID_t("MVER");
+    nl.ga_strmDemoPlay>>nl.ga_ulDemoMinorVersion;
+  } else {
+    nl.ga_ulDemoMinorVersion = 2;
+  }
+  nl.ga_sesSessionState.Read_t(&nl.ga_strmDemoPlay);
+}
+
 /* Start playing a demo. */
 void CNetworkLibrary::StartDemoPlay_t(const CTFileName &fnDemo)  // throw char *
 {
@@ -1318,14 +1554,7 @@ void CNetworkLibrary::StartDemoPlay_t(const CTFileName &fnDemo)  // throw char *
   // initialize server
   try {
     // read initial info to stream
-    ga_strmDemoPlay.ExpectID_t("DEMO");
-    if (ga_strmDemoPlay.PeekID_t()==CChunkID("MVER")) {
-      ga_strmDemoPlay.ExpectID_t("MVER");
-      ga_strmDemoPlay>>ga_ulDemoMinorVersion;
-    } else {
-      ga_ulDemoMinorVersion = 2;
-    }
-    ga_sesSessionState.Read_t(&ga_strmDemoPlay);
+    ReadDemoStart_t(*this);
   } catch(char *) {
     RemoveTimerHandler();
     ga_strmDemoPlay.Close();
@@ -1356,6 +1585,191 @@ void CNetworkLibrary::StartDemoPlay_t(const CTFileName &fnDemo)  // throw char *
   ga_ctTimersPending = 0;
 }
 
+// string as JSON string literal
+static CTString JSONString(const CTString &str)
+{
+  CTString strJSON = "\"";
+  for (const char *pch = str; *pch!=0; pch++) {
+    if (*pch=='\\' || *pch=='"') {
+      strJSON += "\\";
+    }
+    char achChar[2] = { *pch, 0 };
+    strJSON += achChar;
+  }
+  return strJSON+"\"";
+}
+
+extern CTimerValue *_ptvEventDispatch;
+
+static DOUBLE TimeMs(const CTimerValue &tv)
+{
+  return tv.GetSeconds()*1000.0;
+}
+
+/* Replay a demo as fast as possible without rendering, writing tick timings to a JSON report. */
+BOOL CNetworkLibrary::TimeDemo_t(const CTFileName &fnDemo, INDEX ctPasses,
+  const CTFileName &fnmReport, const CTFileName &fnmReference) // throw char *
+{
+  ASSERT(ga_strSessionName=="" && !ga_bDemoPlay);
+  ctPasses = ClampDn(ctPasses, INDEX(1));
+
+  // nothing is rendered or heard, since this doesn't return until the demo ends
+  _pSound->Mute();
+
+  // checksums from an earlier run, if there is one
+  CStaticStackArray<ULONG> aulReference;
+  const BOOL bHasReference = fnmReference!="" && FileExists(fnmReference);
+  if (bHasReference) {
+    CTFileStream strmReference;
+    strmReference.Open_t(fnmReference);
+    while (!strmReference.AtEOF()) {
+      CTString strLine;
+      strmReference.GetLine_t(strLine);
+      ULONG ulCRC;
+      if (sscanf(strLine, "%08X", &ulCRC)==1) {
+        aulReference.Push() = ulCRC;
+      }
+    }
+  }
+
+  CTFileStream strmReport;
+  strmReport.Create_t(fnmReport, CTStream::CM_TEXT);
+  strmReport.FPrintF_t("{\n  \"demo\": %s,\n  \"passes\": [\n", (const char*)JSONString(fnDemo));
+
+  CStaticStackArray<ULONG> aulCRCs;   // checksums of first pass
+  INDEX iFirstDesync = -1;            // first tick that is out of sync
+
+  for (INDEX iPass=0; iPass<ctPasses; iPass++) {
+    // start the demo like StartDemoPlay_t(), but without the timer loop
+    ga_ctTimersPending = -1;
+    ga_bLocalPause = FALSE;
+    ga_strmDemoPlay.Open_t(fnDemo);
+    ga_bDemoPlay = TRUE;
+    ga_bDemoPlayFinished = FALSE;
+    ga_IsServer = FALSE;
+    ga_strSessionName = CTString("Timedemo: ")+fnDemo;
+
+    CTickTimings tt;
+    CTimerValue tvPass, tvMaxTick;
+    tvPass.Clear();
+    tvMaxTick.Clear();
+    INDEX ctTicks = 0;
+
+    try {
+      ReadDemoStart_t(*this);
+      FreeUnusedStock();
+
+      CPrintF(TRANS("Timing demo '%s', pass %d...\n"), (const char*)fnDemo, iPass+1);
+      strmReport.FPrintF_t("    {\n      \"pass\": %d,\n      \"ticks\": [\n", iPass+1);
+
+      // must be in 24bit mode when managing entities
+      CSetFPUPrecision FPUPrecision(FPT_24BIT);
+      ga_sesSessionState.ses_pttTimings = &tt;
+      _ptvEventDispatch = &tt.tt_tvEvents;
+
+      FOREVER {
+        if (ga_strmDemoPlay.PeekID_t()!=CChunkID("DTCK")) {
+          ga_strmDemoPlay.ExpectID_t("DEND"); // demo end
+          break;
+        }
+        ga_strmDemoPlay.ExpectID_t("DTCK");   // demo tick
+        CNetworkStreamBlock nsbBlock;
+        nsbBlock.Read_t(ga_strmDemoPlay);
+
+        // process the block just like ProcessGameStream() would
+        ga_sesSessionState.ses_iLastProcessedSequence = nsbBlock.nsb_iSequenceNumber;
+        const BOOL bTick = nsbBlock.GetType()==MSG_SEQ_ALLACTIONS;
+        tt.Clear();
+        const CTimerValue tvStart = _pTimer->GetHighPrecisionTimer();
+        ga_sesSessionState.ProcessGameStreamBlock(nsbBlock);
+        const CTimerValue tvProcessed = _pTimer->GetHighPrecisionTimer();
+        // other blocks (players joining etc.) are not ticks
+        if (!bTick) {
+          continue;
+        }
+
+        ULONG ulCRC;
+        CRC_Start(ulCRC);
+        ga_sesSessionState.ChecksumForSync(ulCRC, ga_sesSessionState.ses_iExtensiveSyncCheck);
+        CRC_Finish(ulCRC);
+        const CTimerValue tvSynced = _pTimer->GetHighPrecisionTimer();
+
+        // every pass must give same checksums as the first one and the reference
+        BOOL bInSync = TRUE;
+        if (iPass==0) {
+          aulCRCs.Push() = ulCRC;
+        } else if (ctTicks>=aulCRCs.Count() || aulCRCs[ctTicks]!=ulCRC) {
+          bInSync = FALSE;
+        }
+        if (bHasReference && (ctTicks>=aulReference.Count() || aulReference[ctTicks]!=ulCRC)) {
+          bInSync = FALSE;
+        }
+        if (!bInSync && iFirstDesync<0) {
+          iFirstDesync = ctTicks;
+          CPrintF(TRANS("Timedemo: sync checksum differs at tick %d (%.2fs)\n"),
+            ctTicks, ga_sesSessionState.ses_tmLastProcessedTick);
+        }
+
+        const CTimerValue tvTick = tvSynced-tvStart;
+        tvPass += tvTick;
+        if (tvTick>tvMaxTick) {
+          tvMaxTick = tvTick;
+        }
+
+        strmReport.FPrintF_t("%s        { \"tick\": %d, \"time\": %.2f, \"total_ms\": %.4f, \"timers_ms\": %.4f, "
+          "\"movers_ms\": %.4f, \"events_ms\": %.4f, \"sync_ms\": %.4f, \"crc\": \"%08X\" }",
+          ctTicks>0 ? ",\n" : "", ctTicks, ga_sesSessionState.ses_tmLastProcessedTick,
+          TimeMs(tvTick), TimeMs(tt.tt_tvTimers), TimeMs(tt.tt_tvMovers), TimeMs(tt.tt_tvEvents),
+          TimeMs(tvSynced-tvProcessed), ulCRC);
+        ctTicks++;
+      }
+
+      // pass must not end before the first one
+      if (iPass>0 && ctTicks!=aulCRCs.Count() && iFirstDesync<0) {
+        iFirstDesync = ctTicks;
+      }
+      if (bHasReference && ctTicks!=aulReference.Count() && iFirstDesync<0) {
+        iFirstDesync = ctTicks;
+      }
+
+    } catch(char *) {
+      ga_sesSessionState.ses_pttTimings = NULL;
+      _ptvEventDispatch = NULL;
+      StopGame();
+      throw;
+    }
+
+    ga_sesSessionState.ses_pttTimings = NULL;
+    _ptvEventDispatch = NULL;
+
+    const DOUBLE dAvgMs = TimeMs(tvPass)/ClampDn(ctTicks, INDEX(1));
+    strmReport.FPrintF_t("\n      ],\n      \"tick_count\": %d, \"total_ms\": %.3f, \"average_ms\": %.4f, \"max_ms\": %.4f\n    }%s\n",
+      ctTicks, TimeMs(tvPass), dAvgMs, TimeMs(tvMaxTick), iPass<ctPasses-1 ? "," : "");
+    CPrintF(TRANS("  %d ticks in %.3fs, %.4f ms per tick, longest %.4f ms\n"),
+      ctTicks, tvPass.GetSeconds(), dAvgMs, TimeMs(tvMaxTick));
+
+    StopGame();
+  }
+
+  strmReport.FPrintF_t("  ],\n  \"in_sync\": %s,\n  \"first_desync_tick\": %d\n}\n",
+    iFirstDesync<0 ? "true" : "false", iFirstDesync);
+  strmReport.Close();
+
+  // first run of a demo makes the reference for later ones
+  if (fnmReference!="" && !bHasReference) {
+    CTFileStream strmReference;
+    strmReference.Create_t(fnmReference, CTStream::CM_TEXT);
+    for (INDEX iTick=0; iTick<aulCRCs.Count(); iTick++) {
+      strmReference.FPrintF_t("%08X\n", aulCRCs[iTick]);
+    }
+    CPrintF(TRANS("Timedemo: reference checksums written to '%s'\n"), (const char*)fnmReference);
+  }
+
+  CPrintF(TRANS("Timedemo: %s, report written to '%s'\n"),
+    iFirstDesync<0 ? TRANS("in sync") : TRANS("OUT OF SYNC"), (const char*)fnmReport);
+  return iFirstDesync<0;
+}
+
 /* Test if currently playing demo has finished. */
 BOOL CNetworkLibrary::IsDemoPlayFinished(void)
 {
@@ -1375,7 +1789,7 @@ BOOL CNetworkLibrary::IsRecordingDemo(void)
 }
 BOOL CNetworkLibrary::IsNetworkEnabled(void)
 {
-  return _cmiComm.IsNetworkEnabled();
+  return _pcmiComm->IsNetworkEnabled();
 }
 // pause/unpause game
 void CNetworkLibrary::TogglePause(void)
@@ -1396,7 +1810,7 @@ BOOL CNetworkLibrary::IsPaused(void)
 BOOL CNetworkLibrary::IsConnectionStable(void)
 {
   // if network is not enabled
-  if (!_cmiComm.IsNetworkEnabled()) {
+  if (!_pcmiComm->IsNetworkEnabled()) {
     // it is always stable
     return TRUE;
   }
@@ -1432,7 +1846,7 @@ BOOL CNetworkLibrary::GetLocalPause(void)
 // get server/client name and address
 void CNetworkLibrary::GetHostName(CTString &strName, CTString &strAddress)
 {
-  _cmiComm.GetHostName(strName, strAddress);
+  _pcmiComm->GetHostName(strName, strAddress);
 }
 
 // mark that the game has finished -- called from AI
@@ -1631,7 +2045,7 @@ void CNetworkLibrary::ChangeLevel_internal(void)
   CGatherCRC gc;
 
   // if starting in network
-  if (_cmiComm.IsNetworkEnabled()) {
+  if (_pcmiComm->IsNetworkEnabled()) {
     // start gathering CRCs
     InitCRCGather();
 
@@ -1818,12 +2232,16 @@ static void SendAdminResponse(ULONG ulAdr, UWORD uwPort, ULONG ulCode, const CTS
  */
 void CNetworkLibrary::MainLoop(void)
 {
+  MEMORY_TAG_SCOPE(MT_NETWORK);
   // synchronize access to network
   CTSingleLock slNetwork(&ga_csNetwork, TRUE);
 
   // update network state variable (to control usage of some cvars that cannot be altered in mulit-player mode)
   _bMultiPlayer = (_pNetwork->ga_sesSessionState.GetPlayersCount() > 1);
 
+  // clean up after save game written in background, and report if it was saved
+  BackgroundWrite_Poll();
+
   // if should change world
   if (_lphCurrent==LCP_SIGNALLED) {
     // really do the level change here
@@ -1856,12 +2274,12 @@ void CNetworkLibrary::MainLoop(void)
 
   // handle messages for session state
   if (!ga_bDemoPlay) {
-    if (_cmiComm.Client_Update() == FALSE) {
+    if (_pcmiComm->Client_Update() == FALSE) {
       ga_sesSessionState.Stop();
       return;
     }
     ga_sesSessionState.SessionStateLoop();
-    if (_cmiComm.Client_Update() == FALSE) {
+    if (_pcmiComm->Client_Update() == FALSE) {
       ga_sesSessionState.Stop();
       return;
     }
@@ -1869,7 +2287,7 @@ void CNetworkLibrary::MainLoop(void)
   // if this is server computer
   if (ga_IsServer) {
     // handle server messages
-    _cmiComm.Server_Update();
+    _pcmiComm->Server_Update();
   }
 
   // let server process game stream
@@ -1943,18 +2361,18 @@ void CNetworkLibrary::MainLoop(void)
   ga_tvDemoTimerLastTime = tvNow;
 
   // if network
-  if (_cmiComm.IsNetworkEnabled()) {
+  if (_pcmiComm->IsNetworkEnabled()) {
 
     // do services for gameagent querying
     GameAgent_ServerUpdate();
 
-//    _cmiComm.Broadcast_Update();
+//    _pcmiComm->Broadcast_Update();
 
     // repeat
     FOREVER {
       CNetworkMessage nmReceived;
 
-//      _cmiComm.Broadcast_Update();
+//      _pcmiComm->Broadcast_Update();
       ULONG ulFrom;
       UWORD uwPort;
       BOOL bHasMsg = ReceiveBroadcast(nmReceived, ulFrom, uwPort);
@@ -2033,6 +2451,7 @@ void CNetworkLibrary::TimerLoop(void)
     return; // this can happen during NET_MakeDefaultState_t()!
   }
   _pfNetworkProfile.StartTimer(CNetworkProfile::PTI_TIMERLOOP);
+  MEMORY_TAG_SCOPE(MT_NETWORK);
 
   // count number of timer interrupts that happened
   if (ga_ctTimersPending>=0) {
@@ -2070,18 +2489,18 @@ void CNetworkLibrary::TimerLoop(void)
     ga_ctTimersPending--;
     // if not disconnected
 //    if (!IsDisconnected()) {
-    if (_cmiComm.cci_bClientInitialized) {
+    if (_pcmiComm->cci_bClientInitialized) {
       // make actions packet for all local players and send to server
       SendActionsToServer();
-      _cmiComm.Client_Update();
+      _pcmiComm->Client_Update();
     }
 
     // if this is server computer
     if (ga_IsServer) {
       // handle server messages
-      _cmiComm.Server_Update();
+      _pcmiComm->Server_Update();
       ga_srvServer.ServerLoop();
-      _cmiComm.Server_Update();
+      _pcmiComm->Server_Update();
     }
   }
 
@@ -2418,18 +2837,18 @@ void CNetworkLibrary::GameInactive(void)
   GameAgent_EnumUpdate();
 
   // if no network
-  if (!_cmiComm.IsNetworkEnabled()) {
+  if (!_pcmiComm->IsNetworkEnabled()) {
     // do not handle
     return;
   }
 
-//  _cmiComm.Broadcast_Update();
+//  _pcmiComm->Broadcast_Update();
 
   // repeat
   FOREVER {
     CNetworkMessage nmReceived;
 
-//  _cmiComm.Broadcast_Update();
+//  _pcmiComm->Broadcast_Update();
     ULONG ulFrom;
     UWORD uwPort;
     BOOL bHasMsg = ReceiveBroadcast(nmReceived, ulFrom, uwPort);
@@ -201,6 +201,10 @@ public:
   void JoinSession_t(const CNetworkSession &nsSesssion, INDEX ctLocalPlayers); // throw char *
   /* Start playing a demo. */
   void StartDemoPlay_t(const CTFileName &fnDemo); // throw char *
+  /* Replay a demo as fast as possible without rendering, writing tick timings to a JSON report.
+     Returns FALSE if sync checksums differ between passes or from the reference file. */
+  BOOL TimeDemo_t(const CTFileName &fnDemo, INDEX ctPasses,
+    const CTFileName &fnmReport, const CTFileName &fnmReference); // throw char *
   /* Test if currently playing a demo. */
   BOOL IsPlayingDemo(void);
   /* Test if currently recording a demo. */
@@ -73,7 +73,7 @@ void CPlayerSource::Start_t(CPlayerCharacter &pcCharacter) // throw char *
       _pNetwork->TimerLoop();
     }
 
-    if (_cmiComm.Client_Update() == FALSE) {
+    if (_pcmiComm->Client_Update() == FALSE) {
 			break;
 		}
     // wait for message to come
@@ -108,7 +108,7 @@ void CPlayerSource::Start_t(CPlayerCharacter &pcCharacter) // throw char *
     }
 
     // if client is disconnected
-    if (!_cmiComm.Client_IsConnected()) {
+    if (!_pcmiComm->Client_IsConnected()) {
       // quit
       ThrowF_t(TRANS("Client disconnected"));
     }
@@ -47,7 +47,6 @@ extern CTString ser_strIPMask;
 extern CTString ser_strNameMask;
 extern INDEX ser_bInverseBanning;
 extern BOOL MatchesBanMask(const CTString &strString, const CTString &strMask);
-extern CClientInterface cm_aciClients[SERVER_CLIENTS];
 
 CSessionSocket::CSessionSocket(void)
 {
@@ -231,14 +230,14 @@ void CServer::Stop(void)
     if (bFound == FALSE) {
       break;
     } else {
-      _cmiComm.Server_Update();
+      _pcmiComm->Server_Update();
       Sleep(100);
     }
   }
 
 
   // stop network driver server
-  _cmiComm.Server_Close();
+  _pcmiComm->Server_Close();
 
   // clear all session
   srv_assoSessions.Clear();
@@ -276,10 +275,10 @@ void CServer::Start_t(void)
   srv_fServerStep = 0.0f;
 
   // init network driver server
-  _cmiComm.Server_Init_t();
+  _pcmiComm->Server_Init_t();
 
   // init gameagent
-  if (_cmiComm.IsNetworkEnabled()) {
+  if (_pcmiComm->IsNetworkEnabled()) {
     GameAgent_ServerInit();
   }
 }
@@ -307,7 +306,7 @@ void CServer::SendDisconnectMessage(INDEX iClient, const char *strExplanation, B
   }
   // report that it has gone away
   CPrintF(TRANS("Client '%s' ordered to disconnect: %s\n"), 
-    _cmiComm.Server_GetClientName(iClient), strExplanation);
+    _pcmiComm->Server_GetClientName(iClient), strExplanation);
   // if not disconnected before
   if (sso.sso_iDisconnectedState==0) {
     // mark the disconnection
@@ -316,7 +315,7 @@ void CServer::SendDisconnectMessage(INDEX iClient, const char *strExplanation, B
   } else {
     // force the disconnection
     CPrintF(TRANS("Forcing client '%s' to disconnect\n"), 
-      _cmiComm.Server_GetClientName(iClient));
+      _pcmiComm->Server_GetClientName(iClient));
     sso.sso_iDisconnectedState = 2;
   }
 }
@@ -527,8 +526,8 @@ void CServer::ResendGameStreamBlocks(INDEX iClient, INDEX iSequence0, INDEX ctSe
 {
   extern INDEX net_bReportMiscErrors;
   if (net_bReportMiscErrors) {
-    CPrintF(TRANS("Server: Resending sequences %d-%d(%d) to '%s'..."), 
-      iSequence0, iSequence0+ctSequences-1, ctSequences, _cmiComm.Server_GetClientName(iClient));
+    CLogF(LC_NETWORK, LS_INFO, TRANS("Server: Resending sequences %d-%d(%d) to '%s'..."), 
+      iSequence0, iSequence0+ctSequences-1, ctSequences, _pcmiComm->Server_GetClientName(iClient));
   }
 
   // get corresponding session socket
@@ -569,7 +568,7 @@ void CServer::ResendGameStreamBlocks(INDEX iClient, INDEX iSequence0, INDEX ctSe
   _pNetwork->SendToClient(iClient, nmPackedBlocks);
   extern INDEX net_bReportMiscErrors;
   if (net_bReportMiscErrors) {
-    CPrintF(TRANS(" sent %d-%d(%d - %db)\n"), 
+    CLogF(LC_NETWORK, LS_INFO, TRANS(" sent %d-%d(%d - %db)\n"), 
       iSequence0, iSequence, iSequence-iSequence0-1, nmPackedBlocks.nm_slSize);
   }
 }
@@ -721,7 +720,7 @@ void CServer::ServerLoop(void)
   _pfNetworkProfile.StartTimer(CNetworkProfile::PTI_SERVER_LOOP);
 
 //  try {
-//    _cmiComm.Server_Accept_t();
+//    _pcmiComm->Server_Accept_t();
 //  } catch (char *strError) {
 //    CPrintF(TRANS("Accepting failed, no more clients can connect: %s\n"), strError);
 //  }
@@ -855,7 +854,7 @@ void CServer::ConnectRemoteSessionState(INDEX iClient, CNetworkMessage &nm)
   CSessionSocket &sso = srv_assoSessions[iClient];
   
   // if the IP is banned
-  if (!MatchesBanMask(_cmiComm.Server_GetClientName(iClient), ser_strIPMask) != !ser_bInverseBanning) {
+  if (!MatchesBanMask(_pcmiComm->Server_GetClientName(iClient), ser_strIPMask) != !ser_bInverseBanning) {
     // disconnect the client
     SendDisconnectMessage(iClient, TRANS("You are banned from this server"), /*bStream=*/TRUE);
     return;
@@ -1005,7 +1004,7 @@ void CServer::ConnectRemoteSessionState(INDEX iClient, CNetworkMessage &nm)
     _pNetwork->SendToClientReliable(iClient, strmInfo);
   
     CPrintF(TRANS("Server: Sent initialization info to '%s' (%dk)\n"),
-      (const char*)_cmiComm.Server_GetClientName(iClient), slSize/1024);
+      (const char*)_pcmiComm->Server_GetClientName(iClient), slSize/1024);
   // if failed
   } catch (char *strError) {
     // deactivate it
@@ -1073,7 +1072,7 @@ void CServer::SendSessionStateData(INDEX iClient)
     _pNetwork->SendToClientReliable(iClient, strmInfo);
   
     CPrintF(TRANS("Server: Sent connection data to '%s' (%dk->%dk->%dk)\n"),
-      (const char*)_cmiComm.Server_GetClientName(iClient), 
+      (const char*)_pcmiComm->Server_GetClientName(iClient), 
       slFullSize/1024, slDeltaSize/1024, slSize/1024);
     if (net_bDumpConnectionInfo) {
       CPrintF(TRANS("Server: Connection data dumped.\n"));
@@ -1094,9 +1093,9 @@ void CServer::HandleAll()
 {
   // clear last accepted client info
   INDEX iClient = -1;
-/*  if (_cmiComm.GetLastAccepted(iClient)) {
+/*  if (_pcmiComm->GetLastAccepted(iClient)) {
     CPrintF(TRANS("Server: Accepted session connection by '%s'\n"),
-      _cmiComm.Server_GetClientName(iClient));
+      _pcmiComm->Server_GetClientName(iClient));
   }
 	*/
 
@@ -1113,13 +1112,13 @@ void CServer::HandleAll()
 void CServer::HandleAllForAClient(INDEX iClient)
 {
   // if the client is not connected
-  if (!_cmiComm.Server_IsClientUsed(iClient)) {
+  if (!_pcmiComm->Server_IsClientUsed(iClient)) {
     // skip it
     return;
   }
 
 	// update the client's max BPS limit from the session socket parameters
-	cm_aciClients[iClient].ci_pbOutputBuffer.pb_pbsLimits.pbs_fBandwidthLimit = srv_assoSessions[iClient].sso_sspParams.ssp_iMaxBPS*8;
+	_pcmiComm->cci_aciClients[iClient].ci_pbOutputBuffer.pb_pbsLimits.pbs_fBandwidthLimit = srv_assoSessions[iClient].sso_sspParams.ssp_iMaxBPS*8;
 
   // find session of this client
   CSessionSocket &sso = srv_assoSessions[iClient];
@@ -1138,10 +1137,10 @@ void CServer::HandleAllForAClient(INDEX iClient)
   }
 
   // if the client is disconnected
-  if (!_cmiComm.Server_IsClientUsed(iClient) || sso.sso_iDisconnectedState>1) {
-    CPrintF(TRANS("Server: Client '%s' disconnected.\n"), _cmiComm.Server_GetClientName(iClient));
+  if (!_pcmiComm->Server_IsClientUsed(iClient) || sso.sso_iDisconnectedState>1) {
+    CPrintF(TRANS("Server: Client '%s' disconnected.\n"), _pcmiComm->Server_GetClientName(iClient));
     // clear it
-    _cmiComm.Server_ClearClient(iClient);
+    _pcmiComm->Server_ClearClient(iClient);
     // free all that data that was allocated for the client
     HandleClientDisconected(iClient);
   }
@@ -1162,10 +1161,10 @@ void CServer::HandleAllForAClient(INDEX iClient)
   }
 
 	// if the client has confirmed disconnect in this loop
-  if (!_cmiComm.Server_IsClientUsed(iClient) || sso.sso_iDisconnectedState>1) {
-    CPrintF(TRANS("Server: Client '%s' disconnected.\n"), _cmiComm.Server_GetClientName(iClient));
+  if (!_pcmiComm->Server_IsClientUsed(iClient) || sso.sso_iDisconnectedState>1) {
+    CPrintF(TRANS("Server: Client '%s' disconnected.\n"), _pcmiComm->Server_GetClientName(iClient));
     // clear it
-    _cmiComm.Server_ClearClient(iClient);
+    _pcmiComm->Server_ClearClient(iClient);
     // free all that data that was allocated for the client
     HandleClientDisconected(iClient);
   }
@@ -1410,7 +1409,7 @@ void CServer::Handle(INDEX iClient, CNetworkMessage &nmMessage)
           sso.sso_ctBadSyncs++;
           if( ser_bReportSyncBad) {
             CPrintF( TRANS("SYNCBAD: Client '%s', Sequence %d Tick %.2f - bad %d\n"), 
-              _cmiComm.Server_GetClientName(iClient), scRemote.sc_iSequence , scRemote.sc_tmTick, sso.sso_ctBadSyncs);
+              _pcmiComm->Server_GetClientName(iClient), scRemote.sc_iSequence , scRemote.sc_tmTick, sso.sso_ctBadSyncs);
           }
           if (ser_iKickOnSyncBad>0) {
             if (sso.sso_ctBadSyncs>=ser_iKickOnSyncBad) {
@@ -1423,7 +1422,7 @@ void CServer::Handle(INDEX iClient, CNetworkMessage &nmMessage)
           sso.sso_ctBadSyncs = 0;
           if (ser_bReportSyncOK) {
             CPrintF( TRANS("SYNCOK: Client '%s', Tick %.2f\n"), 
-              _cmiComm.Server_GetClientName(iClient), scRemote.sc_tmTick);
+              _pcmiComm->Server_GetClientName(iClient), scRemote.sc_tmTick);
           }
         }
         
@@ -1437,13 +1436,13 @@ void CServer::Handle(INDEX iClient, CNetworkMessage &nmMessage)
         // report only if syncs are ok now (so that we don't report a bunch of late syncs on level change
         if( ser_bReportSyncLate && srv_assoSessions[iClient].sso_tmLastSyncReceived>0) {
           CPrintF( TRANS("SYNCLATE: Client '%s', Tick %.2f\n"), 
-            _cmiComm.Server_GetClientName(iClient), scRemote.sc_tmTick);
+            _pcmiComm->Server_GetClientName(iClient), scRemote.sc_tmTick);
         }
       // if too new
       } else {
         if( ser_bReportSyncEarly) {
           CPrintF( TRANS("SYNCEARLY: Client '%s', Tick %.2f\n"), 
-            _cmiComm.Server_GetClientName(iClient), scRemote.sc_tmTick);
+            _pcmiComm->Server_GetClientName(iClient), scRemote.sc_tmTick);
         }
         // remember that this client has sent sync for that tick
         // (even though we cannot really check that it is valid)
@@ -1472,13 +1471,13 @@ void CServer::Handle(INDEX iClient, CNetworkMessage &nmMessage)
 
       // if the client may pause
       extern INDEX ser_bClientsMayPause;
-      if (_cmiComm.Server_IsClientLocal(iClient) || ser_bClientsMayPause) {
+      if (_pcmiComm->Server_IsClientLocal(iClient) || ser_bClientsMayPause) {
         // change it
         srv_bPause = bWantPause;
         // add the pause state block to the buffer to be sent to all clients
         CNetworkStreamBlock nsbPause(MSG_SEQ_PAUSE, ++srv_iLastProcessedSequence);
         nsbPause<<(INDEX&)srv_bPause;
-        nsbPause<<_cmiComm.Server_GetClientName(iClient);
+        nsbPause<<_pcmiComm->Server_GetClientName(iClient);
         AddBlockToAllSessions(nsbPause);
       }
     }
@@ -1544,7 +1543,7 @@ void CServer::Handle(INDEX iClient, CNetworkMessage &nmMessage)
     // send the stream to the remote session state
     _pNetwork->SendToClientReliable(iClient, strmCRC);
     CPrintF(TRANS("Server: Sent CRC challenge to '%s' (%dk)\n"),
-      (const char*)_cmiComm.Server_GetClientName(iClient), slSize/1024);
+      (const char*)_pcmiComm->Server_GetClientName(iClient), slSize/1024);
 
   } break;
   // if a crc response is received
@@ -1560,7 +1559,7 @@ void CServer::Handle(INDEX iClient, CNetworkMessage &nmMessage)
     // if same
     } else {
       CPrintF(TRANS("Server: Client '%s', CRC check OK\n"), 
-        (const char*)_cmiComm.Server_GetClientName(iClient));
+        (const char*)_pcmiComm->Server_GetClientName(iClient));
       // use the piggybacked sequence number to initiate sending stream to it
       CSessionSocket &sso = srv_assoSessions[iClient];
       sso.sso_bSendStream = TRUE;
@@ -1579,17 +1578,17 @@ void CServer::Handle(INDEX iClient, CNetworkMessage &nmMessage)
       CNetworkMessage nmRes(MSG_ADMIN_RESPONSE);
       nmRes<<CTString(TRANS("Remote administration not allowed on this server.\n"));
       CPrintF(TRANS("Server: Client '%s', Tried to use remote administration.\n"), 
-        (const char*)_cmiComm.Server_GetClientName(iClient));
+        (const char*)_pcmiComm->Server_GetClientName(iClient));
       _pNetwork->SendToClientReliable(iClient, nmRes);
     } else if (net_strAdminPassword!=strPassword) {
       CPrintF(TRANS("Server: Client '%s', Wrong password for remote administration.\n"), 
-        (const char*)_cmiComm.Server_GetClientName(iClient));
+        (const char*)_pcmiComm->Server_GetClientName(iClient));
       SendDisconnectMessage(iClient, TRANS("Wrong admin password. The attempt was logged."));
       break;
     } else {
 
       CPrintF(TRANS("Server: Client '%s', Admin cmd: %s\n"), 
-        (const char*)_cmiComm.Server_GetClientName(iClient), strCommand);
+        (const char*)_pcmiComm->Server_GetClientName(iClient), strCommand);
 
       con_bCapture = TRUE;
       con_strCapture = "";
@@ -0,0 +1,100 @@
+/* Copyright (c) 2002-2012 Croteam Ltd.
+This program is free software; you can redistribute it and/or modify
+it under the terms of version 2 of the GNU General Public License as published by
+the Free Software Foundation
+
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA. */
+
+#include "stdh.h"
+
+#include <Engine/Network/SessionContext.h>
+#include <Engine/Network/Network.h>
+#include <Engine/Network/CommunicationInterface.h>
+#include <Engine/Base/Shell.h>
+
+/*
+Everything the simulation of a session touches through globals is reached via
+_pNetwork (world, session state, server, entity timers and events) and _pcmiComm
+(socket and client buffers), so switching those two switches the session. Stocks,
+entity classes and shell are shared by all sessions. Sessions are switched only
+from the main thread, so ticks of different sessions never run at the same time.
+*/
+
+extern INDEX net_iPort;
+
+
+CSessionContext::CSessionContext(void)
+{
+  sc_pnlNetwork = _pNetwork;
+  sc_pcmiComm = _pcmiComm;
+  sc_iPort = net_iPort;
+  sc_bOwned = FALSE;
+  sc_ctTicks = 0;
+  sc_tvTicks.Clear();
+}
+
+
+CSessionContext::~CSessionContext(void)
+{
+  if( !sc_bOwned) return;
+
+  // session must be current while it is destroyed
+  CNetworkLibrary *pnlOld = _pNetwork;
+  CCommunicationInterface *pcmiOld = _pcmiComm;
+  const INDEX iOldPort = net_iPort;
+  Activate();
+  delete sc_pnlNetwork;
+  delete sc_pcmiComm;
+  sc_pnlNetwork = NULL;
+  sc_pcmiComm = NULL;
+  _pNetwork = pnlOld;
+  _pcmiComm = pcmiOld;
+  net_iPort = iOldPort;
+  if( _pNetwork!=NULL) _pShell->SetINDEX("pwoCurrentWorld", (INDEX)&_pNetwork->ga_World);
+}
+
+
+void CSessionContext::Create(INDEX iPort)
+{
+  ASSERT(!sc_bOwned);
+  CNetworkLibrary *pnlOld = _pNetwork;
+  CCommunicationInterface *pcmiOld = _pcmiComm;
+
+  // new network object initializes the current communication interface
+  sc_pcmiComm = new CCommunicationInterface;
+  _pcmiComm = sc_pcmiComm;
+  sc_pnlNetwork = new CNetworkLibrary;
+  sc_pnlNetwork->md_strGameID = pnlOld->md_strGameID;
+  sc_iPort = iPort;
+  sc_bOwned = TRUE;
+
+  _pNetwork = pnlOld;
+  _pcmiComm = pcmiOld;
+}
+
+
+void CSessionContext::Activate(void)
+{
+  _pNetwork = sc_pnlNetwork;
+  _pcmiComm = sc_pcmiComm;
+  net_iPort = sc_iPort;
+  _pShell->SetINDEX("pwoCurrentWorld", (INDEX)&_pNetwork->ga_World);
+}
+
+
+void CSessionContext::RunTick(void)
+{
+  ASSERT(_pNetwork==sc_pnlNetwork);
+  CTimerValue tvStart = _pTimer->GetHighPrecisionTimer();
+  _pNetwork->TimerLoop();
+  sc_tvTicks += _pTimer->GetHighPrecisionTimer()-tvStart;
+  sc_ctTicks++;
+}
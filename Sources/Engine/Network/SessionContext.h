@@ -0,0 +1,53 @@
+/* Copyright (c) 2002-2012 Croteam Ltd.
+This program is free software; you can redistribute it and/or modify
+it under the terms of version 2 of the GNU General Public License as published by
+the Free Software Foundation
+
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA. */
+
+#ifndef SE_INCL_SESSIONCONTEXT_H
+#define SE_INCL_SESSIONCONTEXT_H
+#ifdef PRAGMA_ONCE
+  #pragma once
+#endif
+
+#include <Engine/Base/Timer.h>
+
+/*
+ * Simulation state of one hosted game (world, session state, server and sockets).
+ * A process can host several sessions, sharing all stocks, by activating them in turn.
+ */
+class ENGINE_API CSessionContext {
+public:
+  CNetworkLibrary *sc_pnlNetwork;         // world, session state and server
+  CCommunicationInterface *sc_pcmiComm;   // socket and client buffers
+  INDEX sc_iPort;                         // port that server of this session listens on
+  BOOL sc_bOwned;                         // set if objects were created by this context
+
+  INDEX sc_ctTicks;         // ticks run in this session
+  CTimerValue sc_tvTicks;   // time spent running them
+
+  /* Constructor wraps the current session. */
+  CSessionContext(void);
+  /* Destructor deletes the session if it was created by this context. */
+  ~CSessionContext(void);
+
+  /* Create objects for a new session that will be hosted at given port. */
+  void Create(INDEX iPort);
+  /* Make this the current session (sets _pNetwork and _pcmiComm). */
+  void Activate(void);
+  /* Run one timer tick of the session (it must be current). */
+  void RunTick(void);
+};
+
+
+#endif  /* include-once check. */
+
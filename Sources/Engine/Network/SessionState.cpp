@@ -25,6 +25,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <Engine/Base/ProgressHook.h>
 #include <Engine/Base/CRCTable.h>
 #include <Engine/Base/Shell.h>
+#include <Engine/Base/MemoryPool.h>
 #include <Engine/Network/SessionState.h>
 #include <Engine/Network/PlayerSource.h>
 #include <Engine/Entities/EntityClass.h>
@@ -114,6 +115,7 @@ CSessionState::CSessionState(void)
   ses_fRealTimeFactor = 1.0f;
 
   ses_pstrm = NULL;
+  ses_pttTimings = NULL;
   // reset random number generator
   ResetRND();
 
@@ -175,10 +177,10 @@ void CSessionState::Stop(void)
 #endif // DEBUG_LERPING
 
 	CNetworkMessage nmConfirmDisconnect(MSG_REP_DISCONNECTED);
-  if (_cmiComm.cci_bClientInitialized) {
+  if (_pcmiComm->cci_bClientInitialized) {
 	  _pNetwork->SendToServerReliable(nmConfirmDisconnect);
   }
-  _cmiComm.Client_Close();
+  _pcmiComm->Client_Close();
 
   // clear all old levels
   ForgetOldLevels();
@@ -231,19 +233,19 @@ void CSessionState::Start_t(INDEX ctLocalPlayers)
   // if this computer is server
   if (_pNetwork->IsServer()) {
     // initialize local client
-    _cmiComm.Client_Init_t(0UL);
+    _pcmiComm->Client_Init_t(0UL);
     // connect as main session state
     try {
       Start_AtServer_t();
     } catch(char *) {
-      _cmiComm.Client_Close();
+      _pcmiComm->Client_Close();
       throw;
     }
 
   // if this computer is client
   } else {
     // connect client to server computer
-    _cmiComm.Client_Init_t((char*)(const char*)_pNetwork->ga_strServerAddress);
+    _pcmiComm->Client_Init_t((char*)(const char*)_pNetwork->ga_strServerAddress);
     // connect as remote session state
     try {
       Start_AtClient_t(ctLocalPlayers);
@@ -257,7 +259,7 @@ void CSessionState::Start_t(INDEX ctLocalPlayers)
           _pNetwork->ga_strRequiredMod=" ";
         }
       }
-      _cmiComm.Client_Close();
+      _pcmiComm->Client_Close();
       throw;
     }
   }
@@ -274,7 +276,7 @@ void CSessionState::Start_AtServer_t(void)     // throw char *
   for(TIME tmWait=0; tmWait<net_tmConnectionTimeout*1000; 
       Sleep(NET_WAITMESSAGE_DELAY), tmWait+=NET_WAITMESSAGE_DELAY) {
     _pNetwork->TimerLoop();
-    if (_cmiComm.Client_Update() == FALSE) {
+    if (_pcmiComm->Client_Update() == FALSE) {
 			break;
 		}
 
@@ -299,7 +301,7 @@ void CSessionState::Start_AtServer_t(void)     // throw char *
     }
 
     // if client is disconnected
-    if (!_cmiComm.Client_IsConnected()) {
+    if (!_pcmiComm->Client_IsConnected()) {
       // quit
       ThrowF_t(TRANS("Client disconnected"));
     }
@@ -438,14 +440,14 @@ void CSessionState::WaitStream_t(CTMemoryStream &strmMessage, const CTString &st
   for(TIME tmWait=0; tmWait<net_tmConnectionTimeout*1000;
     Sleep(NET_WAITMESSAGE_DELAY), tmWait+=NET_WAITMESSAGE_DELAY) {
     // update network connection sockets
-    if (_cmiComm.Client_Update() == FALSE) {
+    if (_pcmiComm->Client_Update() == FALSE) {
 			break;
 		}
 
     // check how much is received so far
     SLONG slExpectedSize; // slReceivedSoFar;
     SLONG slReceivedSize;
-    _cmiComm.Client_PeekSize_Reliable(slExpectedSize,slReceivedSize);
+    _pcmiComm->Client_PeekSize_Reliable(slExpectedSize,slReceivedSize);
     // if nothing received yet
     if (slExpectedSize==0) {
       // progress with waiting
@@ -501,7 +503,7 @@ void CSessionState::WaitStream_t(CTMemoryStream &strmMessage, const CTString &st
     }
 
     // if client is disconnected
-    if (!_cmiComm.Client_IsConnected()) {
+    if (!_pcmiComm->Client_IsConnected()) {
       // no more client/server updates in the progres hook
       _bRunNetUpdates = FALSE;
       // quit
@@ -579,6 +581,10 @@ guarantee that they are not freed from memory.
 void CSessionState::HandleMovers(void)
 {
   _pfPhysicsProfile.StartTimer(CPhysicsProfile::PTI_HANDLEMOVERS);
+  CTimerValue tvStart;
+  if (ses_pttTimings!=NULL) {
+    tvStart = _pTimer->GetHighPrecisionTimer();
+  }
 
 //  CPrintF("---- tick %g\n", _pTimer->CurrentTick());
 
@@ -687,6 +693,9 @@ void CSessionState::HandleMovers(void)
   // handle all the sent events
   CEntity::HandleSentEvents();
 
+  if (ses_pttTimings!=NULL) {
+    ses_pttTimings->tt_tvMovers += _pTimer->GetHighPrecisionTimer()-tvStart;
+  }
   _pfPhysicsProfile.StopTimer(CPhysicsProfile::PTI_HANDLEMOVERS);
 }
 
@@ -697,6 +706,10 @@ void CSessionState::HandleTimers(TIME tmCurrentTick)
   IFDEBUG(TIME tmLast = 0.0f);
 
   _pfPhysicsProfile.StartTimer(CPhysicsProfile::PTI_HANDLETIMERS);
+  CTimerValue tvStart;
+  if (ses_pttTimings!=NULL) {
+    tvStart = _pTimer->GetHighPrecisionTimer();
+  }
   // repeat
   CListHead &lhTimers = _pNetwork->ga_World.wo_lhTimers;
   FOREVER {
@@ -739,6 +752,10 @@ void CSessionState::HandleTimers(TIME tmCurrentTick)
 
   // handle all the sent events
   CEntity::HandleSentEvents();
+
+  if (ses_pttTimings!=NULL) {
+    ses_pttTimings->tt_tvTimers += _pTimer->GetHighPrecisionTimer()-tvStart;
+  }
   _pfPhysicsProfile.StopTimer(CPhysicsProfile::PTI_HANDLETIMERS);
 }
 
@@ -903,6 +920,7 @@ void ClearDumpStream(void)
 extern INDEX cli_bEmulateDesync;
 void CSessionState::ProcessGameTick(CNetworkMessage &nmMessage, TIME tmCurrentTick)
 {
+  MEMORY_TAG_SCOPE(MT_ENTITIES);
   ses_tmLastPredictionProcessed = -1;
 
   _pfPhysicsProfile.StartTimer(CPhysicsProfile::PTI_PROCESSGAMETICK);
@@ -1221,7 +1239,7 @@ void CSessionState::ProcessGameStream(void)
 
         extern INDEX net_bReportMiscErrors;
         if (net_bReportMiscErrors) {
-          CPrintF(TRANS("Session State: Missing sequences %d-%d(%d) timeout %g\n"), 
+          CLogF(LC_NETWORK, LS_WARNING, TRANS("Session State: Missing sequences %d-%d(%d) timeout %g\n"), 
             iSequence, iSequence+ctSequences-1, ctSequences, ses_tmResendTimeout);
         }
 
@@ -1293,9 +1311,9 @@ void CSessionState::ProcessPrediction(void)
   ULONG ulOldRandom = ses_ulRandomSeed;
   ULONG ulEntityID = _pNetwork->ga_World.wo_ulNextEntityID;
 
-  // delete all predictors (if any left from last time)
-  _pNetwork->ga_World.DeletePredictors();
-  // create new predictors
+  // suspend all predictors (if any left from last time)
+  _pNetwork->ga_World.SuspendPredictors();
+  // create new predictors (refreshing suspended ones where possible)
   _pNetwork->ga_World.CreatePredictors();
 
   // for each step
@@ -1311,6 +1329,146 @@ void CSessionState::ProcessPrediction(void)
   _pNetwork->ga_World.wo_ulNextEntityID = ulEntityID;
 }
 
+// mark given number of predictable entities for prediction (players first)
+static void MarkForPredictionBenchmark(CWorld &wo, INDEX ctEntities)
+{
+  for (INDEX iPlayer=0; iPlayer<CEntity::GetMaxPlayers(); iPlayer++) {
+    if (wo.wo_cenWillBePredicted.Count()>=ctEntities) {
+      return;
+    }
+    CEntity *penPlayer = CEntity::GetPlayerEntity(iPlayer);
+    if (penPlayer!=NULL) {
+      penPlayer->AddToPrediction();
+    }
+  }
+  {FOREACHINDYNAMICCONTAINER(wo.wo_cenPredictable, CEntity, iten) {
+    if (wo.wo_cenWillBePredicted.Count()>=ctEntities) {
+      return;
+    }
+    iten->AddToPrediction();
+  }}
+}
+
+// make predictors for marked entities, reusing suspended ones or not
+static void MakePredictorsForBenchmark(CWorld &wo, INDEX ctEntities, BOOL bReuse)
+{
+  extern INDEX cli_bReusePredictors;
+  cli_bReusePredictors = bReuse;
+  wo.SuspendPredictors();
+  MarkForPredictionBenchmark(wo, ctEntities);
+  wo.CreatePredictors();
+}
+
+// write state of all predictors so that it can be compared between different ways of making them
+static void WritePredictorsState_t(CWorld &wo, CTStream &strm) // throw char *
+{
+  {FOREACHINDYNAMICCONTAINER(wo.wo_cenPredictor, CEntity, iten) {
+    CEntity &en = *iten;
+    strm<<en.en_ulID<<en.en_ulFlags<<INDEX(en.en_RenderType);
+    strm.Write_t(&en.en_plPlacement, sizeof(en.en_plPlacement));
+    // for each property
+    for (CDLLEntityClass *pdec = en.en_pecClass->ec_pdecDLLClass; pdec!=NULL; pdec=pdec->dec_pdecBase) {
+      for (INDEX iProperty=0; iProperty<pdec->dec_ctProperties; iProperty++) {
+        CEntityProperty &ep = pdec->dec_aepProperties[iProperty];
+        void *pvProperty = &ENTITYPROPERTY(&en, ep.ep_slOffset, UBYTE);
+        // entity pointers are compared by IDs, since indices of predictors differ
+        if (ep.ep_eptType==CEntityProperty::EPT_ENTITYPTR) {
+          CEntity *penPointed = *(CEntityPointer *)pvProperty;
+          strm<<(penPointed!=NULL ? penPointed->en_ulID : ULONG(-1));
+        } else {
+          en.WriteOneProperty_t(strm, ep.ep_eptType, pvProperty);
+        }
+      }
+    }
+  }}
+}
+
+// measure making of predictors for given number of predictable entities with and without reusing
+// predictors from last prediction, and check that both ways give the same predictors
+void PredictionBenchmark(void *pArgs)
+{
+  INDEX ctEntities = NEXTARGUMENT(INDEX);
+  INDEX ctCycles = NEXTARGUMENT(INDEX);
+  ctCycles = Clamp(ctCycles, INDEX(1), INDEX(10000));
+
+  CSessionState &ses = _pNetwork->ga_sesSessionState;
+  CWorld &wo = _pNetwork->ga_World;
+  if (wo.wo_cenPredictable.Count()==0) {
+    CPrintF(TRANS("No predictable entities in the world!\n"));
+    return;
+  }
+  CSetFPUPrecision FPUPrecision(FPT_24BIT);
+
+  // predict as many ticks as there are buffered actions
+  extern INDEX cli_bReusePredictors;
+  extern INDEX cli_iMaxPredictionSteps;
+  const INDEX bReuseOld = cli_bReusePredictors;
+  const INDEX ctSteps = ClampUp(ses.GetPredictionStepsCount(), cli_iMaxPredictionSteps);
+  const ULONG ulOldRandom = ses.ses_ulRandomSeed;
+  const ULONG ulEntityID = wo.wo_ulNextEntityID;
+  const TIME tmOldTick = _pTimer->CurrentTick();
+  const TIME tmOldHeadTick = ses.ses_tmPredictionHeadTick;
+
+  wo.DeletePredictors();
+  wo.UnmarkForPrediction();
+
+  // time making of predictors both ways
+  DOUBLE atmMake[2] = { 0, 0 };
+  INDEX ctPredictors = 0;
+  for (INDEX iReuse=0; iReuse<2; iReuse++) {
+    for (INDEX iCycle=0; iCycle<ctCycles; iCycle++) {
+      CTimerValue tvStart = _pTimer->GetHighPrecisionTimer();
+      MakePredictorsForBenchmark(wo, ctEntities, iReuse);
+      atmMake[iReuse] += (_pTimer->GetHighPrecisionTimer()-tvStart).GetSeconds();
+      ctPredictors = wo.wo_cenPredictor.Count();
+      // move predictors away from their originals
+      TIME tmPredictedTick = ses.ses_tmLastProcessedTick;
+      for (INDEX iStep=0; iStep<ctSteps; iStep++) {
+        tmPredictedTick += _pTimer->TickQuantum;
+        ses.ProcessPredictedGameTick(iStep, FLOAT(iStep)/ctSteps, tmPredictedTick);
+      }
+      ses.ses_ulRandomSeed = ulOldRandom;
+      wo.wo_ulNextEntityID = ulEntityID;
+    }
+  }
+
+  // refreshed predictors must be the same as newly created ones
+  BOOL bSame = FALSE;
+  try {
+    CTMemoryStream strmRefreshed, strmCreated;
+    MakePredictorsForBenchmark(wo, ctEntities, TRUE);
+    WritePredictorsState_t(wo, strmRefreshed);
+    wo.wo_ulNextEntityID = ulEntityID;
+    MakePredictorsForBenchmark(wo, ctEntities, FALSE);
+    WritePredictorsState_t(wo, strmCreated);
+
+    void *pv0, *pv1;
+    SLONG slSize0, slSize1;
+    strmRefreshed.LockBuffer(&pv0, &slSize0);
+    strmCreated.LockBuffer(&pv1, &slSize1);
+    bSame = slSize0==slSize1 && memcmp(pv0, pv1, slSize0)==0;
+    strmCreated.UnlockBuffer();
+    strmRefreshed.UnlockBuffer();
+  } catch (char *strError) {
+    CPrintF(TRANS("Cannot compare predictors: %s\n"), strError);
+  }
+
+  // restore everything
+  wo.DeletePredictors();
+  wo.UnmarkForPrediction();
+  cli_bReusePredictors = bReuseOld;
+  ses.ses_ulRandomSeed = ulOldRandom;
+  wo.wo_ulNextEntityID = ulEntityID;
+  ses.ses_tmPredictionHeadTick = tmOldHeadTick;
+  _pTimer->SetCurrentTick(tmOldTick);
+
+  CPrintF(TRANS("Prediction of %d entities (%d predictors), %d ticks ahead, %d cycles:\n"),
+    ctEntities, ctPredictors, ctSteps, ctCycles);
+  CPrintF(TRANS("  new predictors:       %.3f ms per prediction\n"), atmMake[0]*1000.0/ctCycles);
+  CPrintF(TRANS("  refreshed predictors: %.3f ms per prediction\n"), atmMake[1]*1000.0/ctCycles);
+  CPrintF(TRANS("  refreshed predictors are %s\n"), bSame ? TRANS("identical") : TRANS("DIFFERENT"));
+}
+
 /*
  * Process a gamestream block.
  */
@@ -1430,8 +1588,8 @@ void CSessionState::ProcessGameStreamBlock(CNetworkMessage &nmMessage)
       // don't wait for new players any more
       ses_bWaitAllPlayers = FALSE;
 
-      // delete all predictors
-      _pNetwork->ga_World.DeletePredictors();
+      // suspend all predictors, they are refreshed in next prediction
+      _pNetwork->ga_World.SuspendPredictors();
       // process the tick
       ProcessGameTick(nmMessage, tmPacket);
 
@@ -1879,7 +2037,7 @@ void CSessionState::RestoreOldLevel(const CTString &strFileName)
 // make synchronization test message and send it to server (if client), or add to buffer (if server)
 void CSessionState::MakeSynchronisationCheck(void)
 {
-  if (!_cmiComm.cci_bClientInitialized) return;
+  if (!_pcmiComm->cci_bClientInitialized) return;
   // not yet time
   if(ses_tmLastSyncCheck+ses_tmSyncCheckFrequency > ses_tmLastProcessedTick) {
     // don't check yet
@@ -1965,7 +2123,7 @@ void CSessionState::SessionStateLoop(void)
     bSomethingToDo = FALSE;
 
     // if client was disconnected without a notice
-    if (!_cmiComm.Client_IsConnected()) {
+    if (!_pcmiComm->Client_IsConnected()) {
       // quit
       ses_strDisconnected = TRANS("Link or server is down");
     }
@@ -2045,7 +2203,7 @@ void CSessionState::SessionStateLoop(void)
         ses_strDisconnected = strReason;
         CPrintF(TRANS("Disconnected: %s\n"), strReason);
         // disconnect
-        _cmiComm.Client_Close();
+        _pcmiComm->Client_Close();
       // if this is recon response
       } else if (nmReliable.GetType() == MSG_ADMIN_RESPONSE) {
         // just print it
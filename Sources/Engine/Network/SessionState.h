@@ -50,6 +50,15 @@ public:
   void Clear(void) { sc_tmTick = -1.0f; sc_iSequence = -1; sc_ulCRC = 0; sc_iLevel = 0; }
 };
 
+// simulation time spent in phases of one game tick (only collected while timing a demo)
+class CTickTimings {
+public:
+  CTimerValue tt_tvMovers;    // in HandleMovers()
+  CTimerValue tt_tvTimers;    // in HandleTimers()
+  CTimerValue tt_tvEvents;    // dispatching sent events (also those inside movers and timers)
+  void Clear(void) { tt_tvMovers.Clear(); tt_tvTimers.Clear(); tt_tvEvents.Clear(); }
+};
+
 // info about an event that was predicted to happen
 class CPredictedEvent {
 public:
@@ -114,6 +123,7 @@ public:
   BOOL ses_bWaitAllPlayers; // if set, wait for all players to join before starting
   FLOAT ses_fRealTimeFactor;  // enables slower or faster time for special effects
   CTMemoryStream *ses_pstrm;  // debug stream for sync check examination
+  CTickTimings *ses_pttTimings; // if set, phases of processed ticks are timed into it
   
   CSessionSocketParams ses_sspParams; // local copy of server-side parameters
 public:
@@ -15,6 +15,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "stdh.h"
 
+#include <Engine/Base/MemoryPool.h>
 #include <Engine/Brushes/Brush.h>
 #include <Engine/Brushes/BrushTransformed.h>
 #include <Engine/Rendering/Render.h>
@@ -50,6 +51,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <Engine/Graphics/DrawPort.h>
 #include <Engine/Graphics/GfxLibrary.h>
 #include <Engine/Graphics/Fog_internal.h>
+#include <Engine/Graphics/TextureEffects.h>
 
 #include <Engine/Base/Statistics_internal.h>
 #include <Engine/Rendering/RenderProfile.h>
@@ -948,6 +950,7 @@ void CRenderer::InitClippingRectangle(PIX pixMinI, PIX pixMinJ, PIX pixSizeI, PI
 void RenderView(CWorld &woWorld, CEntity &enViewer,
   CAnyProjection3D &prProjection, CDrawPort &dpDrawport)
 {
+  MEMORY_TAG_SCOPE(MT_RENDERING);
   // let the worldbase execute its render function
   if (woWorld.wo_pecWorldBaseClass!=NULL
     &&woWorld.wo_pecWorldBaseClass->ec_pdecDLLClass!=NULL
@@ -961,6 +964,9 @@ void RenderView(CWorld &woWorld, CEntity &enViewer,
     woWorld.CalculateNonDirectionalShadows();
   }
 
+  // animate effect textures that are due for this tick all at once
+  UpdateEffectTextures();
+
   // take first renderer object
   CRenderer &re = _areRenderers[0];
   // set it up for rendering
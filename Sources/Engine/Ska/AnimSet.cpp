@@ -76,6 +76,76 @@ static void CompressAxis(const FLOAT3D &vNormal, UWORD &ubH, UWORD &ubP)
   ubH = UWORD(h*65535);
   ubP = UWORD(p*65535);
 }
+// decompres axis for quaternion if animations are optimized
+void DecompressAxis(FLOAT3D &vNormal, UWORD ubH, UWORD ubP)
+{
+  ANGLE h = (ubH/65535.0f)*360.0f-180.0f;
+  ANGLE p = (ubP/65535.0f)*360.0f-180.0f;
+
+  FLOAT &x = vNormal(1);
+  FLOAT &y = vNormal(2);
+  FLOAT &z = vNormal(3);
+
+  x = -Sin(h)*Cos(p);
+  y = Sin(p);
+  z = -Cos(h)*Cos(p);
+}
+// get frame number of key in array of rotations, positions or opt_rotations
+static inline INDEX GetKeyFrameNum(const UBYTE *pFirstMember, INDEX iKey, UINT uiSize)
+{
+  return *(const UWORD*)(pFirstMember+(uiSize*iKey));
+}
+// fill table with index of last key at or before each frame (same key that binary search would find)
+static void FillKeyTable(CStaticArray<UWORD> &aiKeys, const UBYTE *pFirstMember, INDEX ctKeys, UINT uiSize, INDEX ctFrames)
+{
+  aiKeys.Clear();
+  // no table needed if each frame has its own key
+  BOOL bEachFrame = (ctKeys==ctFrames);
+  for(INDEX iKey=0;bEachFrame && iKey<ctKeys;iKey++) {
+    bEachFrame = (GetKeyFrameNum(pFirstMember,iKey,uiSize)==iKey);
+  }
+  if(bEachFrame) return;
+
+  aiKeys.New(ctFrames);
+  INDEX iKey=0;
+  for(INDEX iFrame=0;iFrame<ctFrames;iFrame++) {
+    while(iKey+1<ctKeys && GetKeyFrameNum(pFirstMember,iKey+1,uiSize)<=iFrame) iKey++;
+    aiKeys[iFrame] = iKey;
+  }
+}
+// (re)build sampling tables for bone envelopes of animation
+void PrepareAnimationTracks(Animation &an)
+{
+  INDEX ctbe = an.an_abeBones.Count();
+  an.an_abtTracks.Clear();
+  if(ctbe==0) return;
+  an.an_abtTracks.New(ctbe);
+  for(INDEX ibe=0;ibe<ctbe;ibe++) {
+    BoneEnvelope &be = an.an_abeBones[ibe];
+    BoneTrack &bt = an.an_abtTracks[ibe];
+    // position keys
+    INDEX ctp = be.be_apPos.Count();
+    if(ctp>0) FillKeyTable(bt.bt_aiPosKeys,(UBYTE*)&be.be_apPos[0],ctp,sizeof(AnimPos),an.an_iFrames);
+    // rotation keys
+    if(!an.an_bCompresed) {
+      INDEX ctr = be.be_arRot.Count();
+      if(ctr>0) FillKeyTable(bt.bt_aiRotKeys,(UBYTE*)&be.be_arRot[0],ctr,sizeof(AnimRot),an.an_iFrames);
+    } else {
+      INDEX ctr = be.be_arRotOpt.Count();
+      if(ctr==0) continue;
+      FillKeyTable(bt.bt_aiRotKeys,(UBYTE*)&be.be_arRotOpt[0],ctr,sizeof(AnimRotOpt),an.an_iFrames);
+      // decompress rotations once, instead of two keys for each bone in each frame
+      bt.bt_aqRot.New(ctr);
+      for(INDEX ir=0;ir<ctr;ir++) {
+        AnimRotOpt &aroRot = be.be_arRotOpt[ir];
+        FLOAT3D vAxis;
+        ANGLE aAngle = aroRot.aro_aAngle / ANG_COMPRESIONMUL;
+        DecompressAxis(vAxis,aroRot.aro_ubH,aroRot.aro_ubP);
+        bt.bt_aqRot[ir].FromAxisAngle(vAxis,aAngle);
+      }
+    }
+  }
+}
 // try to remove 2. keyframe in rotation
 BOOL RemoveRotFrame(AnimRot &ar1,AnimRot &ar2,AnimRot &ar3,FLOAT fTreshold)
 {
@@ -321,6 +391,8 @@ void CAnimSet::OptimizeAnimation(Animation &an, FLOAT fTreshold)
   {
     an.an_ameMorphs[imeNew] = aMorphs[imeNew];
   }
+  // keys have changed
+  PrepareAnimationTracks(an);
 }
 // add animation to animset
 void CAnimSet::AddAnimation(Animation *pan)
@@ -582,6 +654,8 @@ void CAnimSet::Read_t(CTStream *istrFile)
       // read morph factors
       istrFile->Read_t(&me.me_aFactors[0],sizeof(FLOAT)*ctmf);
     }
+    // prepare tables for sampling
+    PrepareAnimationTracks(an);
   }
 }
 // clear animset
@@ -607,6 +681,7 @@ void CAnimSet::Clear(void)
     }
     an.an_abeBones.Clear();
     an.an_ameMorphs.Clear();
+    an.an_abtTracks.Clear();
   }
   as_Anims.Clear();
 }
@@ -628,6 +703,14 @@ SLONG CAnimSet::GetUsedMemory(void)
       slMemoryUsed+=be.be_arRot.Count() * sizeof(AnimRot);
       slMemoryUsed+=be.be_arRotOpt.Count() * sizeof(AnimRotOpt);
     }
+    // for each bone track
+    INDEX ctbt = an.an_abtTracks.Count();
+    for(INDEX ibt=0;ibt<ctbt;ibt++) {
+      BoneTrack &bt = an.an_abtTracks[ibt];
+      slMemoryUsed+=sizeof(bt);
+      slMemoryUsed+=(bt.bt_aiRotKeys.Count()+bt.bt_aiPosKeys.Count()) * sizeof(UWORD);
+      slMemoryUsed+=bt.bt_aqRot.Count() * sizeof(FLOATquat3D);
+    }
     // for each morph envelope
     INDEX ctme = an.an_ameMorphs.Count();
     for(INDEX ime=0;ime<ctme;ime++) {
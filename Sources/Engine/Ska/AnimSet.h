@@ -63,6 +63,7 @@ struct Animation
   BOOL an_bCompresed;// are quaternions in animation compresed
   CStaticArray<struct MorphEnvelope> an_ameMorphs;
   CStaticArray<struct BoneEnvelope> an_abeBones;
+  CStaticArray<struct BoneTrack> an_abtTracks; // sampling tables for each bone envelope
   CTString an_fnSourceFile;// name of ascii aa file, used in Ska studio
   BOOL an_bCustomSpeed; // animation has custom speed set in animset list file, witch override speed from anim file
 };
@@ -83,6 +84,14 @@ struct BoneEnvelope
   FLOAT be_OffSetLen;
 };
 
+// keys of a bone envelope repacked for sampling, so no search is needed per frame
+struct BoneTrack
+{
+  CStaticArray<UWORD> bt_aiRotKeys;     // index of last rotation key at or before each frame (empty if each frame is a key)
+  CStaticArray<UWORD> bt_aiPosKeys;     // index of last position key at or before each frame (empty if each frame is a key)
+  CStaticArray<FLOATquat3D> bt_aqRot;   // decompressed rotation keys (only for compresed animations)
+};
+
 class ENGINE_API CAnimSet : public CSerial
 {
 public:
@@ -103,4 +112,8 @@ public:
 
 // if rotations are compresed does loader also fills array of uncompresed rotations
 ENGINE_API void RememberUnCompresedRotatations(BOOL bRemember);
+// (re)build sampling tables for bone envelopes of animation
+ENGINE_API void PrepareAnimationTracks(Animation &an);
+// decompres axis for quaternion if animations are optimized
+ENGINE_API void DecompressAxis(FLOAT3D &vNormal, UWORD ubH, UWORD ubP);
 #endif  /* include-once check. */
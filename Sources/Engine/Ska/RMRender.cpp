@@ -15,6 +15,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "StdH.h"
 #include <Engine/Base/Console.h>
+#include <Engine/Base/Shell.h>
+#include <Engine/Base/Timer.h>
 #include <Engine/Math/Projection.h>
 #include <Engine/Math/Float.h>
 #include <Engine/Math/Vector.h>
@@ -29,9 +31,13 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <Engine/Ska/StringTable.h>
 #include <Engine/Templates/DynamicContainer.cpp>
 #include <Engine/Graphics/Drawport.h>
+#include <Engine/Graphics/GfxLibrary.h>
+#include <Engine/Models/ModelProfile.h>
 #include <Engine/Graphics/Fog_internal.h>
 #include <Engine/Base/Statistics_internal.h>
 
+#include <xmmintrin.h>
+
 static CAnyProjection3D _aprProjection;
 static CDrawPort *_pdp = NULL;
 static enum FPUPrecisionType _fpuOldPrecision;
@@ -53,6 +59,9 @@ static FLOAT _fCustomMlodDistance=-1; // custom distance for mesh lods
 static FLOAT _fCustomSlodDistance=-1; // custom distance for skeleton lods
 extern FLOAT ska_fLODMul;
 extern FLOAT ska_fLODAdd;
+extern INDEX ska_bFastAnimSampling;
+extern INDEX ska_bPoseCache;
+extern INDEX ska_iPoseCacheSteps;
 
 // mask shader (for rendering models' shadows to shadowmaps)
 static CShader _shMaskShader;
@@ -84,7 +93,7 @@ static void (*_pAdjustShaderParams)(void *pData, INDEX iSurfaceID, CShader *pSha
 static void *_pAdjustShaderData = NULL;
 
 static BOOL FindRenBone(RenModel &rm,int iBoneID,INDEX *piBoneIndex);
-static void PrepareMeshForRendering(RenMesh &rmsh, INDEX iSkeletonlod);
+static void PrepareMeshForRendering(RenMesh &rmsh, INDEX iSkeletonlod, BOOL bShareSkin=FALSE);
 static void CalculateRenderingData(CModelInstance &mi);
 static void ClearRenArrays();
 
@@ -1253,6 +1262,17 @@ static BOOL FindRenBone(RenModel &rm,int iBoneID,INDEX *piBoneIndex)
   return FALSE;
 }
 
+// Find renbone in given renmodel, starting from renbone where it is expected to be
+static BOOL FindRenBone(RenModel &rm,int iBoneID,INDEX *piBoneIndex,INDEX iHint)
+{
+  int ctb = rm.rm_iFirstBone + rm.rm_ctBones;
+  if(iHint>=rm.rm_iFirstBone && iHint<ctb && iBoneID == _aRenBones[iHint].rb_psbBone->sb_iID) {
+    *piBoneIndex = iHint;
+    return TRUE;
+  }
+  return FindRenBone(rm,iBoneID,piBoneIndex);
+}
+
 // Find renbone in whole array on renbones
 RenBone *RM_FindRenBone(INDEX iBoneID)
 {
@@ -1342,21 +1362,6 @@ static BOOL FindBone(int iBoneID, INDEX *piBoneIndex, CModelInstance *pmi,INDEX
   return FALSE;
 }
 
-// decompres axis for quaternion if animations are optimized
-static void DecompressAxis(FLOAT3D &vNormal, UWORD ubH, UWORD ubP)
-{
-  ANGLE h = (ubH/65535.0f)*360.0f-180.0f;
-  ANGLE p = (ubP/65535.0f)*360.0f-180.0f;
-
-  FLOAT &x = vNormal(1);
-  FLOAT &y = vNormal(2);
-  FLOAT &z = vNormal(3);
-
-  x = -Sin(h)*Cos(p);
-  y = Sin(p);
-  z = -Cos(h)*Cos(p);
-}
-
 // initialize batch model rendering
 void RM_BeginRenderingView(CAnyProjection3D &apr, CDrawPort *pdp)
 {
@@ -1578,6 +1583,7 @@ void MakeRootModel(void)
   rm.rm_ctBones = 1;
   rm.rm_iParentBoneIndex = -1;
   rm.rm_iParentModelIndex = -1;
+  rm.rm_iPoseEntry = -1;
   
   // add the default bone
   RenBone &rb = _aRenBones.Push();
@@ -1598,6 +1604,7 @@ static INDEX BuildHierarchy(CModelInstance *pmiModel, INDEX irmParent)
   rm.rm_pmiModel = pmiModel;
   rm.rm_iParentModelIndex = irmParent;
   rm.rm_iNextSiblingModel = -1;
+  rm.rm_iPoseEntry = -1;
   rm.rm_iFirstBone = _aRenBones.Count();
   rm.rm_ctBones = 0;
 
@@ -1830,6 +1837,283 @@ static void CalculateBoneTransforms()
   }
 }
 
+// approximate acos() for 4 values in [0,1] (Abramowitz & Stegun 4.4.46, error below 2e-8)
+static inline __m128 ACos4(__m128 mX)
+{
+  __m128 mP = _mm_set1_ps(-0.0012624911f);
+  mP = _mm_add_ps(_mm_mul_ps(mP,mX), _mm_set1_ps( 0.0066700901f));
+  mP = _mm_add_ps(_mm_mul_ps(mP,mX), _mm_set1_ps(-0.0170881256f));
+  mP = _mm_add_ps(_mm_mul_ps(mP,mX), _mm_set1_ps( 0.0308918810f));
+  mP = _mm_add_ps(_mm_mul_ps(mP,mX), _mm_set1_ps(-0.0501743046f));
+  mP = _mm_add_ps(_mm_mul_ps(mP,mX), _mm_set1_ps( 0.0889789874f));
+  mP = _mm_add_ps(_mm_mul_ps(mP,mX), _mm_set1_ps(-0.2145988016f));
+  mP = _mm_add_ps(_mm_mul_ps(mP,mX), _mm_set1_ps( 1.5707963050f));
+  return _mm_mul_ps(mP, _mm_sqrt_ps(_mm_sub_ps(_mm_set1_ps(1.0f),mX)));
+}
+
+// approximate sin() for 4 angles in [0,PI/2] (taylor series up to x^11)
+static inline __m128 Sin4(__m128 mX)
+{
+  const __m128 mX2 = _mm_mul_ps(mX,mX);
+  __m128 mP = _mm_set1_ps(-1.0f/39916800.0f);
+  mP = _mm_add_ps(_mm_mul_ps(mP,mX2), _mm_set1_ps( 1.0f/362880.0f));
+  mP = _mm_add_ps(_mm_mul_ps(mP,mX2), _mm_set1_ps(-1.0f/5040.0f));
+  mP = _mm_add_ps(_mm_mul_ps(mP,mX2), _mm_set1_ps( 1.0f/120.0f));
+  mP = _mm_add_ps(_mm_mul_ps(mP,mX2), _mm_set1_ps(-1.0f/6.0f));
+  mP = _mm_add_ps(_mm_mul_ps(mP,mX2), _mm_set1_ps( 1.0f));
+  return _mm_mul_ps(mP,mX);
+}
+
+// select from first value where mask is set and from second elsewhere
+static inline __m128 Select4(__m128 mMask, __m128 mA, __m128 mB)
+{
+  return _mm_or_ps(_mm_and_ps(mMask,mA), _mm_andnot_ps(mMask,mB));
+}
+
+// slerp 4 pairs of quaternions at once, same as Slerp() does for factors in [0,1]
+static void Slerp4(const FLOATquat3D *apq1[4], const FLOATquat3D *apq2[4], const FLOAT afFactor[4], FLOATquat3D aqResult[4])
+{
+  // load quaternions and transpose them to one register for each component
+  __m128 mA0 = _mm_loadu_ps(&apq1[0]->q_w);
+  __m128 mA1 = _mm_loadu_ps(&apq1[1]->q_w);
+  __m128 mA2 = _mm_loadu_ps(&apq1[2]->q_w);
+  __m128 mA3 = _mm_loadu_ps(&apq1[3]->q_w);
+  __m128 mB0 = _mm_loadu_ps(&apq2[0]->q_w);
+  __m128 mB1 = _mm_loadu_ps(&apq2[1]->q_w);
+  __m128 mB2 = _mm_loadu_ps(&apq2[2]->q_w);
+  __m128 mB3 = _mm_loadu_ps(&apq2[3]->q_w);
+  _MM_TRANSPOSE4_PS(mA0,mA1,mA2,mA3);
+  _MM_TRANSPOSE4_PS(mB0,mB1,mB2,mB3);
+  const __m128 mT = _mm_loadu_ps(afFactor);
+  const __m128 mOne = _mm_set1_ps(1.0f);
+
+  // cosine of angle between quaternions
+  __m128 mCos = _mm_add_ps(_mm_add_ps(_mm_mul_ps(mA0,mB0), _mm_mul_ps(mA1,mB1)),
+                           _mm_add_ps(_mm_mul_ps(mA2,mB2), _mm_mul_ps(mA3,mB3)));
+  // take shorter way around if cosine is negative
+  const __m128 mSign = _mm_and_ps(mCos, _mm_set1_ps(-0.0f));
+  mCos = _mm_xor_ps(mCos,mSign);
+  mB0 = _mm_xor_ps(mB0,mSign);
+  mB1 = _mm_xor_ps(mB1,mSign);
+  mB2 = _mm_xor_ps(mB2,mSign);
+  mB3 = _mm_xor_ps(mB3,mSign);
+
+  // linear interpolation for near quaternions
+  __m128 mF1 = _mm_sub_ps(mOne,mT);
+  __m128 mF2 = mT;
+  // spherical for others
+  const __m128 mSlerp = _mm_cmpgt_ps(_mm_sub_ps(mOne,mCos), _mm_set1_ps(0.001f));
+  if(_mm_movemask_ps(mSlerp)) {
+    const __m128 mAngle = ACos4(mCos);
+    const __m128 mSin = _mm_sqrt_ps(_mm_sub_ps(mOne,_mm_mul_ps(mCos,mCos)));
+    const __m128 mS1 = _mm_div_ps(Sin4(_mm_mul_ps(mF1,mAngle)), mSin);
+    const __m128 mS2 = _mm_div_ps(Sin4(_mm_mul_ps(mT, mAngle)), mSin);
+    mF1 = Select4(mSlerp,mS1,mF1);
+    mF2 = Select4(mSlerp,mS2,mF2);
+  }
+
+  __m128 mR0 = _mm_add_ps(_mm_mul_ps(mA0,mF1), _mm_mul_ps(mB0,mF2));
+  __m128 mR1 = _mm_add_ps(_mm_mul_ps(mA1,mF1), _mm_mul_ps(mB1,mF2));
+  __m128 mR2 = _mm_add_ps(_mm_mul_ps(mA2,mF1), _mm_mul_ps(mB2,mF2));
+  __m128 mR3 = _mm_add_ps(_mm_mul_ps(mA3,mF1), _mm_mul_ps(mB3,mF2));
+  _MM_TRANSPOSE4_PS(mR0,mR1,mR2,mR3);
+  _mm_storeu_ps(&aqResult[0].q_w,mR0);
+  _mm_storeu_ps(&aqResult[1].q_w,mR1);
+  _mm_storeu_ps(&aqResult[2].q_w,mR2);
+  _mm_storeu_ps(&aqResult[3].q_w,mR3);
+}
+
+// bone rotations waiting to be slerped 4 at a time
+struct SlerpBatch {
+  const FLOATquat3D *slb_apqFrom[4];  // keys around current frame
+  const FLOATquat3D *slb_apqTo[4];
+  FLOAT slb_afFactor[4];              // factor between keys
+  FLOAT slb_afStrength[4];            // strength of animation
+  FLOATquat3D *slb_apqBone[4];        // bone rotation to blend result into
+  INDEX slb_ctBones;
+};
+
+// slerp all bones in batch
+static void FlushSlerpBatch(SlerpBatch &slb)
+{
+  const INDEX ctBones = slb.slb_ctBones;
+  if(ctBones==0) return;
+  // fill unused lanes with first bone
+  const FLOATquat3D *apqBone[4];
+  for(INDEX i=0;i<4;i++) {
+    if(i>=ctBones) {
+      slb.slb_apqFrom[i]    = slb.slb_apqFrom[0];
+      slb.slb_apqTo[i]      = slb.slb_apqTo[0];
+      slb.slb_afFactor[i]   = slb.slb_afFactor[0];
+      slb.slb_afStrength[i] = slb.slb_afStrength[0];
+      slb.slb_apqBone[i]    = slb.slb_apqBone[0];
+    }
+    apqBone[i] = slb.slb_apqBone[i];
+  }
+  // rotation between current and next frame in animation
+  FLOATquat3D aqAnim[4];
+  Slerp4(slb.slb_apqFrom,slb.slb_apqTo,slb.slb_afFactor,aqAnim);
+  // and currently playing animation
+  const FLOATquat3D *apqAnim[4] = { &aqAnim[0], &aqAnim[1], &aqAnim[2], &aqAnim[3] };
+  FLOATquat3D aqResult[4];
+  Slerp4(apqBone,apqAnim,slb.slb_afStrength,aqResult);
+  for(INDEX ib=0;ib<ctBones;ib++) {
+    *slb.slb_apqBone[ib] = aqResult[ib];
+  }
+  slb.slb_ctBones = 0;
+}
+
+// add bone rotation to batch
+static inline void AddToSlerpBatch(SlerpBatch &slb, const FLOATquat3D *pqFrom, const FLOATquat3D *pqTo,
+                                   FLOAT fFactor, FLOAT fStrength, FLOATquat3D *pqBone)
+{
+  // bone can be blended only once per batch
+  for(INDEX ib=0;ib<slb.slb_ctBones;ib++) {
+    if(slb.slb_apqBone[ib]==pqBone) {
+      FlushSlerpBatch(slb);
+      break;
+    }
+  }
+  // factors outside of [0,1] are rare, so do them as before
+  if(fFactor<0 || fFactor>1 || fStrength<0 || fStrength>1) {
+    FLOATquat3D qRot = Slerp<FLOAT>(fFactor,*pqFrom,*pqTo);
+    *pqBone = Slerp<FLOAT>(fStrength,*pqBone,qRot);
+    return;
+  }
+  const INDEX ib = slb.slb_ctBones;
+  slb.slb_apqFrom[ib]    = pqFrom;
+  slb.slb_apqTo[ib]      = pqTo;
+  slb.slb_afFactor[ib]   = fFactor;
+  slb.slb_afStrength[ib] = fStrength;
+  slb.slb_apqBone[ib]    = pqBone;
+  slb.slb_ctBones++;
+  if(slb.slb_ctBones==4) FlushSlerpBatch(slb);
+}
+
+// Match bone envelopes of one animation for bones, using key tables instead of searching
+static void MatchBoneTracks(RenModel &rm, Animation &an, FLOAT f, INDEX iAnimFrame, BOOL bAnimLooping, FLOAT fStrength)
+{
+  INDEX ctbe = an.an_abeBones.Count();
+  // animations made in Ska studio don't go through loading
+  if(an.an_abtTracks.Count()!=ctbe) PrepareAnimationTracks(an);
+
+  SlerpBatch slb;
+  slb.slb_ctBones = 0;
+  // bone envelopes are usually in same order as bones
+  INDEX iBoneHint = rm.rm_iFirstBone;
+  // for each bone envelope
+  for(INDEX ibe=0;ibe<ctbe;ibe++) {
+    BoneEnvelope &be = an.an_abeBones[ibe];
+    BoneTrack &bt = an.an_abtTracks[ibe];
+    INDEX iBoneIndex;
+    // find its renbone in array of renbones
+    if(!FindRenBone(rm,be.be_iBoneID,&iBoneIndex,iBoneHint)) continue;
+    iBoneHint = iBoneIndex+1;
+    RenBone &rb = _aRenBones[iBoneIndex];
+
+    // get keys for rotation from table
+    INDEX iRotFrameIndex = bt.bt_aiRotKeys.Count()>0 ? bt.bt_aiRotKeys[iAnimFrame] : iAnimFrame;
+    INDEX iNextRotFrameIndex;
+    INDEX iRotFrameNum;
+    INDEX iNextRotFrameNum;
+    const FLOATquat3D *pqRotCurrent;
+    const FLOATquat3D *pqRotNext;
+    if(!an.an_bCompresed) {
+      INDEX ctr = be.be_arRot.Count();
+      iNextRotFrameIndex = bAnimLooping ? (iRotFrameIndex+1)%ctr : ClampUp(iRotFrameIndex+1L,ctr-1L);
+      iRotFrameNum = be.be_arRot[iRotFrameIndex].ar_iFrameNum;
+      iNextRotFrameNum = be.be_arRot[iNextRotFrameIndex].ar_iFrameNum;
+      pqRotCurrent = &be.be_arRot[iRotFrameIndex].ar_qRot;
+      pqRotNext = &be.be_arRot[iNextRotFrameIndex].ar_qRot;
+    // compresed rotations were decompressed at load time
+    } else {
+      INDEX ctr = be.be_arRotOpt.Count();
+      iNextRotFrameIndex = bAnimLooping ? (iRotFrameIndex+1)%ctr : ClampUp(iRotFrameIndex+1L,ctr-1L);
+      iRotFrameNum = be.be_arRotOpt[iRotFrameIndex].aro_iFrameNum;
+      iNextRotFrameNum = be.be_arRotOpt[iNextRotFrameIndex].aro_iFrameNum;
+      pqRotCurrent = &bt.bt_aqRot[iRotFrameIndex];
+      pqRotNext = &bt.bt_aqRot[iNextRotFrameIndex];
+    }
+
+    FLOAT fSlerpFactor;
+    if(iNextRotFrameNum<=iRotFrameNum) fSlerpFactor = (f-iRotFrameNum) / (an.an_iFrames-iRotFrameNum);
+    else fSlerpFactor = (f-iRotFrameNum) / (iNextRotFrameNum-iRotFrameNum);
+    AddToSlerpBatch(slb,pqRotCurrent,pqRotNext,fSlerpFactor,fStrength,&rb.rb_arRot.ar_qRot);
+
+    // get keys for position from table
+    INDEX ctp = be.be_apPos.Count();
+    INDEX iPosFrameIndex = bt.bt_aiPosKeys.Count()>0 ? bt.bt_aiPosKeys[iAnimFrame] : iAnimFrame;
+    INDEX iNextPosFrameIndex = bAnimLooping ? (iPosFrameIndex+1)%ctp : ClampUp(iPosFrameIndex+1L,ctp-1L);
+    INDEX iPosFrameNum = be.be_apPos[iPosFrameIndex].ap_iFrameNum;
+    INDEX iNextPosFrameNum = be.be_apPos[iNextPosFrameIndex].ap_iFrameNum;
+
+    FLOAT fLerpFactor;
+    if(iNextPosFrameNum<=iPosFrameNum) fLerpFactor = (f-iPosFrameNum) / (an.an_iFrames-iPosFrameNum);
+    else fLerpFactor = (f-iPosFrameNum) / (iNextPosFrameNum-iPosFrameNum);
+
+    FLOAT3D vBonePosCurrent = be.be_apPos[iPosFrameIndex].ap_vPos;
+    FLOAT3D vBonePosNext = be.be_apPos[iNextPosFrameIndex].ap_vPos;
+    // if bone envelope and bone have some length 
+    if((be.be_OffSetLen > 0) && (rb.rb_psbBone->sb_fOffSetLen > 0)) {
+      // size bone to fit bone envelope
+      vBonePosCurrent *= (rb.rb_psbBone->sb_fOffSetLen / be.be_OffSetLen);
+      vBonePosNext *= (rb.rb_psbBone->sb_fOffSetLen / be.be_OffSetLen);
+    }
+    // calculate position for bone beetwen current and next frame in animation
+    FLOAT3D vPos = Lerp(vBonePosCurrent,vBonePosNext,fLerpFactor);
+    // and currently playing animation 
+    rb.rb_apPos.ap_vPos = Lerp(rb.rb_apPos.ap_vPos,vPos,fStrength);
+  }
+  FlushSlerpBatch(slb);
+}
+
+// find newest animlist that has fully faded in (older ones don't affect pose)
+static INDEX FindFirstAnimList(CModelInstance &mi)
+{
+  INDEX ctal = mi.mi_aqAnims.aq_Lists.Count();
+  // loop from newer to older
+  for(INDEX ial=ctal-1;ial>=0;ial--) {
+    AnimList &alList = mi.mi_aqAnims.aq_Lists[ial];
+    // calculate fade factor
+    FLOAT fFadeFactor = CalculateFadeFactor(alList);
+    if(fFadeFactor >= 1.0f) {
+      return ial;
+    }
+  }
+  return 0;
+}
+
+// calculate current frame of played animation (with fraction)
+static FLOAT GetPlayedAnimFrame(const Animation &an, const PlayedAnim &pa, const AnimList &alList,
+                                const AnimList *palListNext, FLOAT fLerpedTick)
+{
+  FLOAT fTime = fLerpedTick;
+  // calculate end time for this animation list
+  FLOAT fFadeInEndTime = alList.al_fStartTime + alList.al_fFadeTime;
+
+  // if there is a newer anmimation list
+  if(palListNext!=NULL) {
+    // freeze time of this one to never overlap with the newer list
+    fTime = ClampUp(fTime, palListNext->al_fStartTime);
+  }
+
+  // calculate time passed since the animation started
+  FLOAT fTimeOffset = fTime - pa.pa_fStartTime;
+  // if this animation list is fading in
+  if (fLerpedTick < fFadeInEndTime) {
+    // offset the time so that it is paused at the end of fadein interval
+    fTimeOffset += fFadeInEndTime - fLerpedTick;
+  }
+
+  FLOAT f = fTimeOffset / (an.an_fSecPerFrame*pa.pa_fSpeedMul);
+  if(pa.pa_ulFlags & AN_LOOPING) {
+    f = fmod(f,an.an_iFrames);
+  } else {
+    if(f>an.an_iFrames) f = an.an_iFrames-1;
+  }
+  return f;
+}
+
 // Match animations in anim queue for bones
 static void MatchAnims(RenModel &rm)
 {
@@ -1841,21 +2125,10 @@ static void MatchAnims(RenModel &rm)
   // count animlists
   INDEX ctal = rm.rm_pmiModel->mi_aqAnims.aq_Lists.Count();
   // find newes animlist that has fully faded in
-  INDEX iFirstAnimList = 0;
-  // loop from newer to older
-  INDEX ial=ctal-1;
-  for(;ial>=0;ial--) {
-    AnimList &alList = rm.rm_pmiModel->mi_aqAnims.aq_Lists[ial];
-    // calculate fade factor
-    FLOAT fFadeFactor = CalculateFadeFactor(alList);
-    if(fFadeFactor >= 1.0f) {
-      iFirstAnimList = ial;
-      break;
-    }
-  }
+  INDEX iFirstAnimList = FindFirstAnimList(*rm.rm_pmiModel);
 
   // for each anim list after iFirstAnimList
-  for(ial=iFirstAnimList;ial<ctal;ial++) {
+  for(INDEX ial=iFirstAnimList;ial<ctal;ial++) {
     AnimList &alList = rm.rm_pmiModel->mi_aqAnims.aq_Lists[ial];
     AnimList *palListNext=NULL;
     if(ial+1<ctal) palListNext = &rm.rm_pmiModel->mi_aqAnims.aq_Lists[ial+1];
@@ -1866,7 +2139,6 @@ static void MatchAnims(RenModel &rm)
     INDEX ctpa = alList.al_PlayedAnims.Count();
     // for each played anim in played anim list
     for(int ipa=0;ipa<ctpa;ipa++) {
-      FLOAT fTime = fLerpedTick;
       PlayedAnim &pa = alList.al_PlayedAnims[ipa];
       BOOL bAnimLooping = pa.pa_ulFlags & AN_LOOPING;
 
@@ -1876,158 +2148,144 @@ static void MatchAnims(RenModel &rm)
       if(rm.rm_pmiModel->FindAnimationByID(pa.pa_iAnimID,&iAnimSetIndex,&iAnimIndex)) {
         // if found, animate bones
         Animation &an = rm.rm_pmiModel->mi_aAnimSet[iAnimSetIndex].as_Anims[iAnimIndex];
-        
-        // calculate end time for this animation list
-        FLOAT fFadeInEndTime = alList.al_fStartTime + alList.al_fFadeTime;
-
-        // if there is a newer anmimation list
-        if(palListNext!=NULL) {
-          // freeze time of this one to never overlap with the newer list
-          fTime = ClampUp(fTime, palListNext->al_fStartTime);
-        }
-
-        // calculate time passed since the animation started
-        FLOAT fTimeOffset = fTime - pa.pa_fStartTime;
-        // if this animation list is fading in
-        if (fLerpedTick < fFadeInEndTime) {
-          // offset the time so that it is paused at the end of fadein interval
-          fTimeOffset += fFadeInEndTime - fLerpedTick;
-        }
-
-        FLOAT f = fTimeOffset / (an.an_fSecPerFrame*pa.pa_fSpeedMul);
+        FLOAT f = GetPlayedAnimFrame(an,pa,alList,palListNext,fLerpedTick);
 
         INDEX iCurentFrame;
         INDEX iAnimFrame,iNextAnimFrame;
         
         if(bAnimLooping) {
-          f = fmod(f,an.an_iFrames);
           iCurentFrame = INDEX(f);
           iAnimFrame = iCurentFrame % an.an_iFrames;
           iNextAnimFrame = (iCurentFrame+1) % an.an_iFrames;
         } else {
-          if(f>an.an_iFrames) f = an.an_iFrames-1;
           iCurentFrame = INDEX(f);
           iAnimFrame = ClampUp(iCurentFrame,an.an_iFrames-1L);
           iNextAnimFrame = ClampUp(iCurentFrame+1L,an.an_iFrames-1L);
         }
         
-        // for each bone envelope
-        INDEX ctbe = an.an_abeBones.Count();
-        for(int ibe=0;ibe<ctbe;ibe++) {
-          INDEX iBoneIndex;
-          // find its renbone in array of renbones
-          if(FindRenBone(rm,an.an_abeBones[ibe].be_iBoneID, &iBoneIndex)) {
-            RenBone &rb = _aRenBones[iBoneIndex];
-            BoneEnvelope &be = an.an_abeBones[ibe];
-
-            INDEX iRotFrameIndex;
-            INDEX iNextRotFrameIndex;
-            INDEX iRotFrameNum;
-            INDEX iNextRotFrameNum;
-            FLOAT fSlerpFactor;
-            FLOATquat3D qRot;
-            FLOATquat3D qRotCurrent;
-            FLOATquat3D qRotNext;
-            FLOATquat3D *pqRotCurrent;
-            FLOATquat3D *pqRotNext;
+        // sample bone envelopes from tables prepared at load time
+        if(ska_bFastAnimSampling) {
+          MatchBoneTracks(rm,an,f,iAnimFrame,bAnimLooping,fFadeFactor*pa.pa_Strength);
+        // or search for keys of each bone envelope
+        } else {
+          // for each bone envelope
+          INDEX ctbe = an.an_abeBones.Count();
+          for(int ibe=0;ibe<ctbe;ibe++) {
+            INDEX iBoneIndex;
+            // find its renbone in array of renbones
+            if(FindRenBone(rm,an.an_abeBones[ibe].be_iBoneID, &iBoneIndex)) {
+              RenBone &rb = _aRenBones[iBoneIndex];
+              BoneEnvelope &be = an.an_abeBones[ibe];
+
+              INDEX iRotFrameIndex;
+              INDEX iNextRotFrameIndex;
+              INDEX iRotFrameNum;
+              INDEX iNextRotFrameNum;
+              FLOAT fSlerpFactor;
+              FLOATquat3D qRot;
+              FLOATquat3D qRotCurrent;
+              FLOATquat3D qRotNext;
+              FLOATquat3D *pqRotCurrent;
+              FLOATquat3D *pqRotNext;
             
-            // if animation is not compresed
-            if(!an.an_bCompresed) {
-              AnimRot *arFirst = &be.be_arRot[0];
-              INDEX ctfn = be.be_arRot.Count();
-              // find index of closest frame
-              iRotFrameIndex = FindFrame((UBYTE*)arFirst,iAnimFrame,ctfn,sizeof(AnimRot));
+              // if animation is not compresed
+              if(!an.an_bCompresed) {
+                AnimRot *arFirst = &be.be_arRot[0];
+                INDEX ctfn = be.be_arRot.Count();
+                // find index of closest frame
+                iRotFrameIndex = FindFrame((UBYTE*)arFirst,iAnimFrame,ctfn,sizeof(AnimRot));
+              
+                // get index of next frame
+                if(bAnimLooping) {
+                  iNextRotFrameIndex = (iRotFrameIndex+1) % be.be_arRot.Count();
+                } else {
+                  iNextRotFrameIndex = ClampUp(iRotFrameIndex+1L,be.be_arRot.Count() - 1L);
+                }
               
-              // get index of next frame
-              if(bAnimLooping) {
-                iNextRotFrameIndex = (iRotFrameIndex+1) % be.be_arRot.Count();
+                iRotFrameNum = be.be_arRot[iRotFrameIndex].ar_iFrameNum;
+                iNextRotFrameNum = be.be_arRot[iNextRotFrameIndex].ar_iFrameNum;
+                pqRotCurrent = &be.be_arRot[iRotFrameIndex].ar_qRot;
+                pqRotNext = &be.be_arRot[iNextRotFrameIndex].ar_qRot;
+              // animation is not compresed
               } else {
-                iNextRotFrameIndex = ClampUp(iRotFrameIndex+1L,be.be_arRot.Count() - 1L);
+                AnimRotOpt *aroFirst = &be.be_arRotOpt[0];
+                INDEX ctfn = be.be_arRotOpt.Count();
+                iRotFrameIndex = FindFrame((UBYTE*)aroFirst,iAnimFrame,ctfn,sizeof(AnimRotOpt));
+
+                // get index of next frame
+                if(bAnimLooping) { 
+                  iNextRotFrameIndex = (iRotFrameIndex+1L) % be.be_arRotOpt.Count();
+                } else {
+                  iNextRotFrameIndex = ClampUp(iRotFrameIndex+1L,be.be_arRotOpt.Count() - 1L);
+                }
+
+                AnimRotOpt &aroRot = be.be_arRotOpt[iRotFrameIndex];
+                AnimRotOpt &aroRotNext = be.be_arRotOpt[iNextRotFrameIndex];
+                iRotFrameNum = aroRot.aro_iFrameNum;
+                iNextRotFrameNum = aroRotNext.aro_iFrameNum;
+                FLOAT3D vAxis;
+                ANGLE aAngle;
+
+                // decompress angle
+                aAngle = aroRot.aro_aAngle / ANG_COMPRESIONMUL;
+                DecompressAxis(vAxis,aroRot.aro_ubH,aroRot.aro_ubP);
+                qRotCurrent.FromAxisAngle(vAxis,aAngle);
+
+                aAngle = aroRotNext.aro_aAngle / ANG_COMPRESIONMUL;
+                DecompressAxis(vAxis,aroRotNext.aro_ubH,aroRotNext.aro_ubP);
+                qRotNext.FromAxisAngle(vAxis,aAngle);
+                pqRotCurrent = &qRotCurrent;
+                pqRotNext = &qRotNext;
               }
-              
-              iRotFrameNum = be.be_arRot[iRotFrameIndex].ar_iFrameNum;
-              iNextRotFrameNum = be.be_arRot[iNextRotFrameIndex].ar_iFrameNum;
-              pqRotCurrent = &be.be_arRot[iRotFrameIndex].ar_qRot;
-              pqRotNext = &be.be_arRot[iNextRotFrameIndex].ar_qRot;
-            // animation is not compresed
-            } else {
-              AnimRotOpt *aroFirst = &be.be_arRotOpt[0];
-              INDEX ctfn = be.be_arRotOpt.Count();
-              iRotFrameIndex = FindFrame((UBYTE*)aroFirst,iAnimFrame,ctfn,sizeof(AnimRotOpt));
-
-              // get index of next frame
-              if(bAnimLooping) { 
-                iNextRotFrameIndex = (iRotFrameIndex+1L) % be.be_arRotOpt.Count();
+
+              if(iNextRotFrameNum<=iRotFrameNum) {
+                // calculate slerp factor for rotations
+                fSlerpFactor = (f-iRotFrameNum) / (an.an_iFrames-iRotFrameNum);
               } else {
-                iNextRotFrameIndex = ClampUp(iRotFrameIndex+1L,be.be_arRotOpt.Count() - 1L);
+                // calculate slerp factor for rotations
+                fSlerpFactor = (f-iRotFrameNum) / (iNextRotFrameNum-iRotFrameNum);
               }
+            
+              // calculate rotation for bone beetwen current and next frame in animation
+              qRot = Slerp<FLOAT>(fSlerpFactor,*pqRotCurrent,*pqRotNext);
+              // and currently playing animation 
+              rb.rb_arRot.ar_qRot = Slerp<FLOAT>(fFadeFactor*pa.pa_Strength,rb.rb_arRot.ar_qRot,qRot);
 
-              AnimRotOpt &aroRot = be.be_arRotOpt[iRotFrameIndex];
-              AnimRotOpt &aroRotNext = be.be_arRotOpt[iNextRotFrameIndex];
-              iRotFrameNum = aroRot.aro_iFrameNum;
-              iNextRotFrameNum = aroRotNext.aro_iFrameNum;
-              FLOAT3D vAxis;
-              ANGLE aAngle;
-
-              // decompress angle
-              aAngle = aroRot.aro_aAngle / ANG_COMPRESIONMUL;
-              DecompressAxis(vAxis,aroRot.aro_ubH,aroRot.aro_ubP);
-              qRotCurrent.FromAxisAngle(vAxis,aAngle);
-
-              aAngle = aroRotNext.aro_aAngle / ANG_COMPRESIONMUL;
-              DecompressAxis(vAxis,aroRotNext.aro_ubH,aroRotNext.aro_ubP);
-              qRotNext.FromAxisAngle(vAxis,aAngle);
-              pqRotCurrent = &qRotCurrent;
-              pqRotNext = &qRotNext;
-            }
+              AnimPos *apFirst = &be.be_apPos[0];
+              INDEX ctfn = be.be_apPos.Count();
+              INDEX iPosFrameIndex = FindFrame((UBYTE*)apFirst,iAnimFrame,ctfn,sizeof(AnimPos));
 
-            if(iNextRotFrameNum<=iRotFrameNum) {
-              // calculate slerp factor for rotations
-              fSlerpFactor = (f-iRotFrameNum) / (an.an_iFrames-iRotFrameNum);
-            } else {
-              // calculate slerp factor for rotations
-              fSlerpFactor = (f-iRotFrameNum) / (iNextRotFrameNum-iRotFrameNum);
-            }
-            
-            // calculate rotation for bone beetwen current and next frame in animation
-            qRot = Slerp<FLOAT>(fSlerpFactor,*pqRotCurrent,*pqRotNext);
-            // and currently playing animation 
-            rb.rb_arRot.ar_qRot = Slerp<FLOAT>(fFadeFactor*pa.pa_Strength,rb.rb_arRot.ar_qRot,qRot);
-
-            AnimPos *apFirst = &be.be_apPos[0];
-            INDEX ctfn = be.be_apPos.Count();
-            INDEX iPosFrameIndex = FindFrame((UBYTE*)apFirst,iAnimFrame,ctfn,sizeof(AnimPos));
-
-            INDEX iNextPosFrameIndex;
-            // is animation looping
-            if(bAnimLooping) { 
-              iNextPosFrameIndex = (iPosFrameIndex+1) % be.be_apPos.Count();
-            } else {
-              iNextPosFrameIndex = ClampUp(iPosFrameIndex+1L,be.be_apPos.Count()-1L);
-            }
+              INDEX iNextPosFrameIndex;
+              // is animation looping
+              if(bAnimLooping) { 
+                iNextPosFrameIndex = (iPosFrameIndex+1) % be.be_apPos.Count();
+              } else {
+                iNextPosFrameIndex = ClampUp(iPosFrameIndex+1L,be.be_apPos.Count()-1L);
+              }
 
-            INDEX iPosFrameNum = be.be_apPos[iPosFrameIndex].ap_iFrameNum;
-            INDEX iNextPosFrameNum = be.be_apPos[iNextPosFrameIndex].ap_iFrameNum;
+              INDEX iPosFrameNum = be.be_apPos[iPosFrameIndex].ap_iFrameNum;
+              INDEX iNextPosFrameNum = be.be_apPos[iNextPosFrameIndex].ap_iFrameNum;
 
-            FLOAT fLerpFactor;
-            if(iNextPosFrameNum<=iPosFrameNum) fLerpFactor = (f-iPosFrameNum) / (an.an_iFrames-iPosFrameNum);
-            else fLerpFactor = (f-iPosFrameNum) / (iNextPosFrameNum-iPosFrameNum);
+              FLOAT fLerpFactor;
+              if(iNextPosFrameNum<=iPosFrameNum) fLerpFactor = (f-iPosFrameNum) / (an.an_iFrames-iPosFrameNum);
+              else fLerpFactor = (f-iPosFrameNum) / (iNextPosFrameNum-iPosFrameNum);
             
-            FLOAT3D vPos;
-            FLOAT3D vBonePosCurrent = be.be_apPos[iPosFrameIndex].ap_vPos;
-            FLOAT3D vBonePosNext = be.be_apPos[iNextPosFrameIndex].ap_vPos;
-
-            // if bone envelope and bone have some length 
-            if((be.be_OffSetLen > 0) && (rb.rb_psbBone->sb_fOffSetLen > 0)) {
-              // size bone to fit bone envelope
-              vBonePosCurrent *= (rb.rb_psbBone->sb_fOffSetLen / be.be_OffSetLen);
-              vBonePosNext *= (rb.rb_psbBone->sb_fOffSetLen / be.be_OffSetLen);
-            }
+              FLOAT3D vPos;
+              FLOAT3D vBonePosCurrent = be.be_apPos[iPosFrameIndex].ap_vPos;
+              FLOAT3D vBonePosNext = be.be_apPos[iNextPosFrameIndex].ap_vPos;
+
+              // if bone envelope and bone have some length 
+              if((be.be_OffSetLen > 0) && (rb.rb_psbBone->sb_fOffSetLen > 0)) {
+                // size bone to fit bone envelope
+                vBonePosCurrent *= (rb.rb_psbBone->sb_fOffSetLen / be.be_OffSetLen);
+                vBonePosNext *= (rb.rb_psbBone->sb_fOffSetLen / be.be_OffSetLen);
+              }
 
-            // calculate position for bone beetwen current and next frame in animation
-            vPos = Lerp(vBonePosCurrent,vBonePosNext,fLerpFactor);
-            // and currently playing animation 
-            rb.rb_apPos.ap_vPos = Lerp(rb.rb_apPos.ap_vPos,vPos,fFadeFactor * pa.pa_Strength);
+              // calculate position for bone beetwen current and next frame in animation
+              vPos = Lerp(vBonePosCurrent,vBonePosNext,fLerpFactor);
+              // and currently playing animation 
+              rb.rb_apPos.ap_vPos = Lerp(rb.rb_apPos.ap_vPos,vPos,fFadeFactor * pa.pa_Strength);
+            }
           }
         }
 
@@ -2051,6 +2309,321 @@ static void MatchAnims(RenModel &rm)
   }
 }
 
+// cache of poses and skinned meshes computed in current rendering frame, so that many instances of same
+// model in same animation phase (crowds of enemies, decorations) need to match animations and skin only once
+#define POSECACHE_ENTRIES    256
+#define POSECACHE_MAXFLOATS  (256*1024)
+#define SKINCACHE_ENTRIES    64
+#define SKINCACHE_MAXFLOATS  (1024*1024)
+
+struct PoseCacheEntry {
+  ULONG pce_ulHash;
+  INDEX pce_iKey, pce_ctKey;        // key in array of pose keys
+  INDEX pce_ctBones, pce_ctMorphs;
+  INDEX pce_iData;                  // bone placements followed by morph factors in pose data
+};
+
+struct SkinCacheEntry {
+  INDEX sce_iPose;                  // pose of root model this mesh is skinned in
+  const MeshLOD *sce_pmlod;
+  FLOAT3D sce_vStretch;
+  QVect sce_qvOffset;
+  INDEX sce_iMorphs, sce_ctMorphs;  // morph factors in skin data
+  INDEX sce_ctUses;                 // how many times this mesh was needed so far
+  INDEX sce_iData;                  // vertices followed by normals in skin data (-1 if not cached yet)
+};
+
+static PoseCacheEntry _apcePoseCache[POSECACHE_ENTRIES];
+static SkinCacheEntry _asceSkinCache[SKINCACHE_ENTRIES];
+static INDEX _ctPoseCacheEntries = 0;
+static INDEX _ctSkinCacheEntries = 0;
+static INDEX _iPoseCacheFrame = -1;
+static CStaticStackArray<ULONG> _aulPoseKeys;
+static CStaticStackArray<FLOAT> _afPoseData;
+static CStaticStackArray<FLOAT> _afSkinData;
+
+// average cost of matching one bone and of skinning one vertex, for estimating time saved by cache
+static DOUBLE _dMatchSecondsPerBone = 0;
+static DOUBLE _dSkinSecondsPerVertex = 0;
+static DOUBLE _dSavedSeconds = 0;
+
+// forget all cached poses and meshes
+static void ResetPoseCache(void)
+{
+  _ctPoseCacheEntries = 0;
+  _ctSkinCacheEntries = 0;
+  _aulPoseKeys.PopAll();
+  _afPoseData.PopAll();
+  _afSkinData.PopAll();
+}
+
+// add time that would be spent without cache to model profile
+static void AddSavedTime(DOUBLE dSeconds)
+{
+  _dSavedSeconds += dSeconds;
+  const INDEX ctMicroseconds = INDEX(_dSavedSeconds*1000000.0);
+  if(ctMicroseconds!=0) {
+    _pfModelProfile.IncrementCounter(CModelProfile::PCI_SKA_CACHE_SAVEDUS, ctMicroseconds);
+    _dSavedSeconds -= ctMicroseconds/1000000.0;
+  }
+}
+
+// update running average of some cost
+static void AverageCost(DOUBLE &dAverage, DOUBLE dCost)
+{
+  if(dAverage==0) dAverage = dCost;
+  else dAverage = dAverage*0.95 + dCost*0.05;
+}
+
+// get key for pose of renmodel: everything that matching of animations depends on
+static BOOL GetPoseKey(RenModel &rm, CStaticStackArray<ULONG> &aulKey)
+{
+  CModelInstance &mi = *rm.rm_pmiModel;
+  if(mi.mi_psklSkeleton==NULL || rm.rm_iSkeletonLODIndex<0 || rm.rm_ctBones==0) return FALSE;
+
+  aulKey.PopAll();
+  aulKey.Push() = (ULONG)(size_t)mi.mi_psklSkeleton;
+  aulKey.Push() = rm.rm_iSkeletonLODIndex;
+  // meshes (for morphs)
+  INDEX ctmsh = rm.rm_iFirstMesh + rm.rm_ctMeshes;
+  for(INDEX imsh=rm.rm_iFirstMesh;imsh<ctmsh;imsh++) {
+    aulKey.Push() = (ULONG)(size_t)_aRenMesh[imsh].rmsh_pMeshInst->mi_pMesh;
+    aulKey.Push() = _aRenMesh[imsh].rmsh_iMeshLODIndex;
+  }
+  // animsets
+  INDEX ctas = mi.mi_aAnimSet.Count();
+  for(INDEX ias=0;ias<ctas;ias++) {
+    aulKey.Push() = (ULONG)(size_t)&mi.mi_aAnimSet[ias];
+  }
+  if(ctas==0) return TRUE;
+
+  // played animations, with time quantised to some steps per frame
+  const FLOAT fLerpedTick = _pTimer->GetLerpedCurrentTick();
+  const FLOAT fSteps = ClampDn(ska_iPoseCacheSteps,1L);
+  INDEX ctal = mi.mi_aqAnims.aq_Lists.Count();
+  for(INDEX ial=FindFirstAnimList(mi);ial<ctal;ial++) {
+    AnimList &alList = mi.mi_aqAnims.aq_Lists[ial];
+    AnimList *palListNext = (ial+1<ctal) ? &mi.mi_aqAnims.aq_Lists[ial+1] : NULL;
+    const FLOAT fFadeFactor = CalculateFadeFactor(alList);
+    INDEX ctpa = alList.al_PlayedAnims.Count();
+    for(INDEX ipa=0;ipa<ctpa;ipa++) {
+      PlayedAnim &pa = alList.al_PlayedAnims[ipa];
+      INDEX iAnimSetIndex, iAnimIndex;
+      if(!mi.FindAnimationByID(pa.pa_iAnimID,&iAnimSetIndex,&iAnimIndex)) continue;
+      Animation &an = mi.mi_aAnimSet[iAnimSetIndex].as_Anims[iAnimIndex];
+      const FLOAT f = GetPlayedAnimFrame(an,pa,alList,palListNext,fLerpedTick);
+      aulKey.Push() = pa.pa_iAnimID;
+      aulKey.Push() = pa.pa_ulFlags & AN_LOOPING;
+      aulKey.Push() = (ULONG)FloatToInt(fFadeFactor*pa.pa_Strength*255.0f);
+      aulKey.Push() = (ULONG)FloatToInt(f*fSteps);
+    }
+  }
+  return TRUE;
+}
+
+// Match animations for bones, or take them from another instance in same pose
+static void MatchAnimsCached(RenModel &rm)
+{
+  rm.rm_iPoseEntry = -1;
+  static CStaticStackArray<ULONG> aulKey;
+  if(!ska_bPoseCache || !GetPoseKey(rm,aulKey)) {
+    MatchAnims(rm);
+    return;
+  }
+  // flush for each new rendering frame
+  if(_iPoseCacheFrame != _pGfx->gl_iFrameNumber) {
+    _iPoseCacheFrame = _pGfx->gl_iFrameNumber;
+    ResetPoseCache();
+  }
+
+  const INDEX ctKey = aulKey.Count();
+  ULONG ulHash = ctKey;
+  for(INDEX iKey=0;iKey<ctKey;iKey++) {
+    ulHash = ulHash*31 + aulKey[iKey];
+  }
+  INDEX ctmsh = rm.rm_iFirstMesh + rm.rm_ctMeshes;
+
+  // if same pose was already matched for another instance
+  for(INDEX ipce=0;ipce<_ctPoseCacheEntries;ipce++) {
+    PoseCacheEntry &pce = _apcePoseCache[ipce];
+    if(pce.pce_ulHash!=ulHash || pce.pce_ctKey!=ctKey
+     || memcmp(&_aulPoseKeys[pce.pce_iKey],&aulKey[0],ctKey*sizeof(ULONG))!=0) continue;
+    // copy bone placements and morph factors
+    CTimerValue tvStart = _pTimer->GetHighPrecisionTimer();
+    _pfModelProfile.IncrementCounter(CModelProfile::PCI_SKA_POSE_CACHEHITS);
+    const FLOAT *pfData = &_afPoseData[pce.pce_iData];
+    for(INDEX irb=rm.rm_iFirstBone;irb<rm.rm_iFirstBone+rm.rm_ctBones;irb++) {
+      RenBone &rb = _aRenBones[irb];
+      memcpy(&rb.rb_apPos.ap_vPos,pfData,sizeof(FLOAT3D));     pfData+=3;
+      memcpy(&rb.rb_arRot.ar_qRot,pfData,sizeof(FLOATquat3D)); pfData+=4;
+    }
+    for(INDEX imsh=rm.rm_iFirstMesh;imsh<ctmsh;imsh++) {
+      RenMesh &rmsh = _aRenMesh[imsh];
+      for(INDEX irmp=rmsh.rmsh_iFirstMorph;irmp<rmsh.rmsh_iFirstMorph+rmsh.rmsh_ctMorphs;irmp++) {
+        _aRenMorph[irmp].rmp_fFactor = *pfData++;
+      }
+    }
+    rm.rm_iPoseEntry = ipce;
+    const DOUBLE dHit = (_pTimer->GetHighPrecisionTimer()-tvStart).GetSeconds();
+    AddSavedTime(rm.rm_ctBones*_dMatchSecondsPerBone - dHit);
+    return;
+  }
+
+  // match animations
+  _pfModelProfile.IncrementCounter(CModelProfile::PCI_SKA_POSE_CACHEMISSES);
+  CTimerValue tvStart = _pTimer->GetHighPrecisionTimer();
+  MatchAnims(rm);
+  AverageCost(_dMatchSecondsPerBone, (_pTimer->GetHighPrecisionTimer()-tvStart).GetSeconds()/rm.rm_ctBones);
+
+  // remember the pose if there's some room left
+  INDEX ctMorphs = 0;
+  for(INDEX imsh=rm.rm_iFirstMesh;imsh<ctmsh;imsh++) {
+    ctMorphs += _aRenMesh[imsh].rmsh_ctMorphs;
+  }
+  const INDEX ctFloats = rm.rm_ctBones*7 + ctMorphs;
+  if(_ctPoseCacheEntries==POSECACHE_ENTRIES || _afPoseData.Count()+ctFloats > POSECACHE_MAXFLOATS) return;
+  PoseCacheEntry &pce = _apcePoseCache[_ctPoseCacheEntries];
+  pce.pce_ulHash = ulHash;
+  pce.pce_ctKey = ctKey;
+  pce.pce_iKey = _aulPoseKeys.Count();
+  memcpy(_aulPoseKeys.Push(ctKey),&aulKey[0],ctKey*sizeof(ULONG));
+  pce.pce_ctBones = rm.rm_ctBones;
+  pce.pce_ctMorphs = ctMorphs;
+  pce.pce_iData = _afPoseData.Count();
+  FLOAT *pfData = _afPoseData.Push(ctFloats);
+  for(INDEX irb=rm.rm_iFirstBone;irb<rm.rm_iFirstBone+rm.rm_ctBones;irb++) {
+    RenBone &rb = _aRenBones[irb];
+    memcpy(pfData,&rb.rb_apPos.ap_vPos,sizeof(FLOAT3D));     pfData+=3;
+    memcpy(pfData,&rb.rb_arRot.ar_qRot,sizeof(FLOATquat3D)); pfData+=4;
+  }
+  for(INDEX imsh=rm.rm_iFirstMesh;imsh<ctmsh;imsh++) {
+    RenMesh &rmsh = _aRenMesh[imsh];
+    for(INDEX irmp=rmsh.rmsh_iFirstMorph;irmp<rmsh.rmsh_iFirstMorph+rmsh.rmsh_ctMorphs;irmp++) {
+      *pfData++ = _aRenMorph[irmp].rmp_fFactor;
+    }
+  }
+  rm.rm_iPoseEntry = _ctPoseCacheEntries;
+  _ctPoseCacheEntries++;
+}
+
+// find or add skin cache entry for skinned mesh of root model in cached pose
+static SkinCacheEntry *FindSkinCacheEntry(RenMesh &rmsh, const MeshLOD &mlod)
+{
+  RenModel &rm = _aRenModels[rmsh.rmsh_iRenModelIndex];
+  // only root model is in object space relative to view, and bones must not be adjusted after matching
+  if(!ska_bPoseCache || rm.rm_iPoseEntry<0 || rm.rm_iParentBoneIndex!=0 || _pAdjustBonesCallback!=NULL) return NULL;
+  // face forward meshes depend on view
+  if(mlod.mlod_ulFlags & ML_FULL_FACE_FORWARD) return NULL;
+  if(rmsh.rmsh_ctWeights==0 || _iPoseCacheFrame != _pGfx->gl_iFrameNumber) return NULL;
+
+  const CModelInstance &mi = *rm.rm_pmiModel;
+  for(INDEX isce=0;isce<_ctSkinCacheEntries;isce++) {
+    SkinCacheEntry &sce = _asceSkinCache[isce];
+    if(sce.sce_iPose!=rm.rm_iPoseEntry || sce.sce_pmlod!=&mlod || !(sce.sce_vStretch==mi.mi_vStretch)
+     || memcmp(&sce.sce_qvOffset,&mi.mi_qvOffset,sizeof(QVect))!=0) continue;
+    // morph weights must match too
+    BOOL bSameMorphs = TRUE;
+    for(INDEX irmp=0;irmp<sce.sce_ctMorphs && bSameMorphs;irmp++) {
+      bSameMorphs = (_afSkinData[sce.sce_iMorphs+irmp] == _aRenMorph[rmsh.rmsh_iFirstMorph+irmp].rmp_fFactor);
+    }
+    if(!bSameMorphs) continue;
+    sce.sce_ctUses++;
+    return &sce;
+  }
+  if(_ctSkinCacheEntries==SKINCACHE_ENTRIES || _afSkinData.Count()+rmsh.rmsh_ctMorphs > SKINCACHE_MAXFLOATS) return NULL;
+  SkinCacheEntry &sce = _asceSkinCache[_ctSkinCacheEntries++];
+  sce.sce_iPose    = rm.rm_iPoseEntry;
+  sce.sce_pmlod    = &mlod;
+  sce.sce_vStretch = mi.mi_vStretch;
+  sce.sce_qvOffset = mi.mi_qvOffset;
+  sce.sce_ctMorphs = rmsh.rmsh_ctMorphs;
+  sce.sce_iMorphs  = _afSkinData.Count();
+  if(sce.sce_ctMorphs>0) {
+    FLOAT *pfData = _afSkinData.Push(sce.sce_ctMorphs);
+    for(INDEX irmp=0;irmp<sce.sce_ctMorphs;irmp++) {
+      pfData[irmp] = _aRenMorph[rmsh.rmsh_iFirstMorph+irmp].rmp_fFactor;
+    }
+  }
+  sce.sce_ctUses = 1;
+  sce.sce_iData  = -1;
+  return &sce;
+}
+
+// move mesh skinned in object space to view space
+static void UseCachedSkin(RenMesh &rmsh, const SkinCacheEntry &sce)
+{
+  const FLOAT *pfVertices = &_afSkinData[sce.sce_iData];
+  const FLOAT *pfNormals  = pfVertices + _ctFinalVertices*3;
+  for(INDEX ivx=0;ivx<_ctFinalVertices;ivx++) {
+    FLOAT3 &v = (FLOAT3&)_aFinalVtxs[ivx];
+    FLOAT3 &n = (FLOAT3&)_aFinalNormals[ivx];
+    v[0] = pfVertices[ivx*3+0];  v[1] = pfVertices[ivx*3+1];  v[2] = pfVertices[ivx*3+2];
+    n[0] = pfNormals [ivx*3+0];  n[1] = pfNormals [ivx*3+1];  n[2] = pfNormals [ivx*3+2];
+    TransformVector(v,_mObjToView);
+    RotateVector(n,_mObjToView);
+  }
+  _pavFinalVertices = &_aFinalVtxs[0];
+  _panFinalNormals  = &_aFinalNormals[0];
+  // mesh is in view space so transform light to view space
+  RotateVector(_vLightDirInView.vector,_mObjToView);
+  // set flag that mesh is in view space
+  rmsh.rmsh_bTransToViewSpace = TRUE;
+  // reset view matrix bacause model is allready transformed in view space
+  gfxSetViewMatrix(NULL);
+}
+
+// skin morphed mesh in object space and keep it in cache (returns FALSE if there's no room)
+static BOOL SkinMeshToCache(RenMesh &rmsh, SkinCacheEntry &sce)
+{
+  const INDEX ctFloats = _ctFinalVertices*6;
+  if(_afSkinData.Count()+ctFloats > SKINCACHE_MAXFLOATS) return FALSE;
+  sce.sce_iData = _afSkinData.Count();
+  FLOAT *pfVertices = _afSkinData.Push(ctFloats);
+  FLOAT *pfNormals  = pfVertices + _ctFinalVertices*3;
+  memset(pfVertices,0,ctFloats*sizeof(FLOAT));
+
+  // bone transforms are in view space, so take the view out of them
+  Matrix12 mViewToObj;
+  MatrixTranspose(mViewToObj,_mObjToView);
+
+  INDEX ctrw = rmsh.rmsh_iFirstWeight + rmsh.rmsh_ctWeights;
+  for(INDEX irw=rmsh.rmsh_iFirstWeight;irw<ctrw;irw++) {
+    RenWeight &rw = _aRenWeights[irw];
+    Matrix12 mTransform;
+    Matrix12 mStrTransform;
+    // if no bone for this weight 
+    if(rw.rw_iBoneIndex == (-1)) {
+      // transform vertex using default model transform matrix (for boneless models)
+      MatrixMultiply(mStrTransform,mViewToObj,_aRenModels[rmsh.rmsh_iRenModelIndex].rm_mStrTransform);
+      MatrixMultiply(mTransform,   mViewToObj,_aRenModels[rmsh.rmsh_iRenModelIndex].rm_mTransform);
+    } else {
+      // use bone transform matrix
+      MatrixMultiply(mStrTransform,mViewToObj,_aRenBones[rw.rw_iBoneIndex].rb_mStrTransform);
+      MatrixMultiply(mTransform,   mViewToObj,_aRenBones[rw.rw_iBoneIndex].rb_mTransform);
+    }
+    // for each vertex in this weight
+    INDEX ctvw = rw.rw_pwmWeightMap->mwm_aVertexWeight.Count();
+    for(INDEX ivw=0;ivw<ctvw;ivw++) {
+      MeshVertexWeight &vw = rw.rw_pwmWeightMap->mwm_aVertexWeight[ivw];
+      INDEX ivx = vw.mww_iVertex;
+      MeshVertex mv = _aMorphedVtxs[ivx];
+      MeshNormal mn = _aMorphedNormals[ivx];
+      // transform vertex and normal with this weight transform matrix
+      TransformVector((FLOAT3&)mv,mStrTransform);
+      RotateVector((FLOAT3&)mn,mTransform); // Don't stretch normals
+      // Add new values to skinned vertices
+      pfVertices[ivx*3+0] += mv.x * vw.mww_fWeight;
+      pfVertices[ivx*3+1] += mv.y * vw.mww_fWeight;
+      pfVertices[ivx*3+2] += mv.z * vw.mww_fWeight;
+      pfNormals [ivx*3+0] += mn.nx * vw.mww_fWeight;
+      pfNormals [ivx*3+1] += mn.ny * vw.mww_fWeight;
+      pfNormals [ivx*3+2] += mn.nz * vw.mww_fWeight;
+    }
+  }
+  UseCachedSkin(rmsh,sce);
+  return TRUE;
+}
+
 // array of pointers to texure data for shader
 static CStaticStackArray<class CTextureObject*> _patoTextures;
 static CStaticStackArray<struct GFXTexCoord*> _paTexCoords;
@@ -2190,7 +2763,7 @@ static void RenderMesh(RenMesh &rmsh,RenModel &rm)
 }
 
 // Prepare ren mesh for rendering
-static void PrepareMeshForRendering(RenMesh &rmsh, INDEX iSkeletonlod)
+static void PrepareMeshForRendering(RenMesh &rmsh, INDEX iSkeletonlod, BOOL bShareSkin)
 {
   // set curent mesh lod
   MeshLOD &mlod = rmsh.rmsh_pMeshInst->mi_pMesh->msh_aMeshLODs[rmsh.rmsh_iMeshLODIndex];
@@ -2214,6 +2787,18 @@ static void PrepareMeshForRendering(RenMesh &rmsh, INDEX iSkeletonlod)
   _aFinalNormals.Push(ctVertices);
   // Remember final vertex count
   _ctFinalVertices = ctVertices;
+
+  // if same mesh was already skinned in same pose for another instance
+  SkinCacheEntry *psce = bShareSkin ? FindSkinCacheEntry(rmsh,mlod) : NULL;
+  CTimerValue tvStart = _pTimer->GetHighPrecisionTimer();
+  if(psce!=NULL && psce->sce_iData>=0) {
+    _pfModelProfile.IncrementCounter(CModelProfile::PCI_SKA_SKIN_CACHEHITS);
+    UseCachedSkin(rmsh,*psce);
+    const DOUBLE dHit = (_pTimer->GetHighPrecisionTimer()-tvStart).GetSeconds();
+    AddSavedTime(ctVertices*_dSkinSecondsPerVertex - dHit);
+    return;
+  }
+  if(psce!=NULL) _pfModelProfile.IncrementCounter(CModelProfile::PCI_SKA_SKIN_CACHEMISSES);
   
   // Copy original vertices and normals to _aMorphedVtxs
   memcpy(&_aMorphedVtxs[0],&mlod.mlod_aVertices[0],sizeof(mlod.mlod_aVertices[0]) * ctVertices);
@@ -2276,6 +2861,11 @@ static void PrepareMeshForRendering(RenMesh &rmsh, INDEX iSkeletonlod)
 
   // if there is skeleton attached to this mesh transfrom all vertices
   if(ctbones > 0 && ctrw>0) {
+    // if mesh is needed for more instances, skin it once and keep it
+    if(psce!=NULL && psce->sce_ctUses>1 && SkinMeshToCache(rmsh,*psce)) {
+      AverageCost(_dSkinSecondsPerVertex, (_pTimer->GetHighPrecisionTimer()-tvStart).GetSeconds()/ctVertices);
+      return;
+    }
     // for each renweight
     for(int irw=rmsh.rmsh_iFirstWeight; irw<ctrw; irw++) {
       RenWeight &rw = _aRenWeights[irw];
@@ -2326,6 +2916,9 @@ static void PrepareMeshForRendering(RenMesh &rmsh, INDEX iSkeletonlod)
     rmsh.rmsh_bTransToViewSpace = TRUE;
     // reset view matrix bacause model is allready transformed in view space
     gfxSetViewMatrix(NULL);
+    if(psce!=NULL) {
+      AverageCost(_dSkinSecondsPerVertex, (_pTimer->GetHighPrecisionTimer()-tvStart).GetSeconds()/ctVertices);
+    }
   // if no skeleton
   } else {
     // if flag is set to transform all vertices to view space
@@ -2398,8 +2991,8 @@ static void RenderModel_View(RenModel &rm)
   INDEX ctmsh = rm.rm_iFirstMesh + rm.rm_ctMeshes;
   for( int imsh=rm.rm_iFirstMesh;imsh<ctmsh;imsh++) {
     RenMesh &rmsh = _aRenMesh[imsh];
-    // prepare mesh for rendering
-    PrepareMeshForRendering(rmsh,rm.rm_iSkeletonLODIndex);
+    // prepare mesh for rendering (skinned meshes may be shared with same instances)
+    PrepareMeshForRendering(rmsh,rm.rm_iSkeletonLODIndex,TRUE);
     // render mesh
     RenderMesh(rmsh,rm);
     // show normals in required
@@ -2494,7 +3087,7 @@ static void CalculateRenderingData(CModelInstance &mi)
   // for each renmodel 
   for(int irm=1;irm<ctrm;irm++) {
     // match model animations
-    MatchAnims(_aRenModels[irm]);
+    MatchAnimsCached(_aRenModels[irm]);
   }
   // Calculate transformations for all bones on already built hierarchy
   CalculateBoneTransforms();
@@ -2602,3 +3195,131 @@ static void ClearRenArrays()
   _fCustomSlodDistance = -1;
 }
 
+
+// evaluate animations of all instances for some frames, and remember bone placements from last one
+static DOUBLE RunAnimBenchmark(CStaticArray<CModelInstance*> &apmi, INDEX ctFrames, BOOL bFast,
+                               BOOL bPoseCache, INDEX ctPhases, CStaticStackArray<FLOAT> &afResult, INDEX &ctBones)
+{
+  const INDEX ska_bOldFastAnimSampling = ska_bFastAnimSampling;
+  const INDEX ska_bOldPoseCache = ska_bPoseCache;
+  ska_bFastAnimSampling = bFast;
+  ska_bPoseCache = bPoseCache;
+  const FLOAT fNow = _pTimer->GetLerpedCurrentTick();
+  MakeIdentityMatrix(_mAbsToViewer);
+  MakeIdentityMatrix(_mObjectToAbs);
+  afResult.PopAll();
+  ctBones = 0;
+
+  CTimerValue tvStart = _pTimer->GetHighPrecisionTimer();
+  for(INDEX iFrame=0;iFrame<ctFrames;iFrame++) {
+    // each benchmark frame is a new rendering frame for the pose cache
+    _iPoseCacheFrame = _pGfx->gl_iFrameNumber;
+    ResetPoseCache();
+    for(INDEX imi=0;imi<apmi.Count();imi++) {
+      CModelInstance &mi = *apmi[imi];
+      // each phase group and layer in its own phase, moving at 60 fps
+      const INDEX iPhase = imi%ctPhases;
+      AnimList &al = mi.mi_aqAnims.aq_Lists[mi.mi_aqAnims.aq_Lists.Count()-1];
+      for(INDEX ipa=0;ipa<al.al_PlayedAnims.Count();ipa++) {
+        al.al_PlayedAnims[ipa].pa_fStartTime = fNow - (iPhase*0.37f + ipa*0.11f + iFrame/60.0f);
+      }
+      CalculateRenderingData(mi);
+      ctBones += _aRenBones.Count()-1;
+      if(iFrame==ctFrames-1) {
+        for(INDEX irb=1;irb<_aRenBones.Count();irb++) {
+          memcpy(afResult.Push(12),&_aRenBones[irb].rb_mBonePlacement[0],sizeof(Matrix12));
+        }
+      }
+      ClearRenArrays();
+    }
+  }
+  const DOUBLE dSeconds = (_pTimer->GetHighPrecisionTimer()-tvStart).GetSeconds();
+  ska_bFastAnimSampling = ska_bOldFastAnimSampling;
+  ska_bPoseCache = ska_bOldPoseCache;
+  ResetPoseCache();
+  return dSeconds;
+}
+
+// compare sampling of animations with key search and with key tables, and sharing of poses
+// in a horde of instances: SkaAnimBenchmark("Models\\...\\x.smc", 500)
+void SkaAnimBenchmark(void *pArgs)
+{
+  const CTString strSmc = *NEXTARGUMENT(CTString*);
+  INDEX ctInstances = NEXTARGUMENT(INDEX);
+  if(ctInstances<=0) ctInstances = 500;
+  const INDEX ctFrames = 100;
+  const INDEX ctLayers = 3;
+  const INDEX ctHordePhases = 8;
+  const FLOAT afStrength[ctLayers] = { 1.0f, 0.6f, 0.3f };
+
+  CModelInstance *pmiSource;
+  try {
+    pmiSource = ParseSmcFile_t(strSmc);
+  } catch(char *strError) {
+    CPrintF("%s\n", strError);
+    return;
+  }
+  // take first few animations from animsets of the model
+  CStaticStackArray<INDEX> aiAnimIDs;
+  for(INDEX ias=0;ias<pmiSource->mi_aAnimSet.Count();ias++) {
+    CAnimSet &as = pmiSource->mi_aAnimSet[ias];
+    for(INDEX ian=0;ian<as.as_Anims.Count() && aiAnimIDs.Count()<ctLayers;ian++) {
+      aiAnimIDs.Push() = as.as_Anims[ian].an_iID;
+    }
+  }
+  if(aiAnimIDs.Count()==0) {
+    CPrintF(TRANS("'%s' has no animations.\n"), (const char*)strSmc);
+    DeleteModelInstance(pmiSource);
+    return;
+  }
+
+  // create instances that blend 3 looping animations
+  CStaticArray<CModelInstance*> apmi;
+  apmi.New(ctInstances);
+  for(INDEX imi=0;imi<ctInstances;imi++) {
+    apmi[imi] = CreateModelInstance("Benchmark");
+    apmi[imi]->Copy(*pmiSource);
+    apmi[imi]->NewClearState(0);
+    for(INDEX iLayer=0;iLayer<ctLayers;iLayer++) {
+      apmi[imi]->AddAnimation(aiAnimIDs[iLayer%aiAnimIDs.Count()], AN_LOOPING|AN_NOGROUP_SORT, afStrength[iLayer], 0);
+    }
+  }
+
+  CStaticStackArray<FLOAT> afSearch, afTables, afHorde, afShared;
+  INDEX ctBones;
+  const DOUBLE dSearch = RunAnimBenchmark(apmi, ctFrames, FALSE, FALSE, ctInstances, afSearch, ctBones);
+  const DOUBLE dTables = RunAnimBenchmark(apmi, ctFrames, TRUE,  FALSE, ctInstances, afTables, ctBones);
+  // horde where instances walk in few groups of same phase
+  const DOUBLE dHorde  = RunAnimBenchmark(apmi, ctFrames, TRUE,  FALSE, ctHordePhases, afHorde, ctBones);
+  const INDEX ctHits0   = _pfModelProfile.GetCounterCount(CModelProfile::PCI_SKA_POSE_CACHEHITS);
+  const INDEX ctMisses0 = _pfModelProfile.GetCounterCount(CModelProfile::PCI_SKA_POSE_CACHEMISSES);
+  const DOUBLE dShared = RunAnimBenchmark(apmi, ctFrames, TRUE,  TRUE,  ctHordePhases, afShared, ctBones);
+  const INDEX ctHits   = _pfModelProfile.GetCounterCount(CModelProfile::PCI_SKA_POSE_CACHEHITS)  -ctHits0;
+  const INDEX ctMisses = _pfModelProfile.GetCounterCount(CModelProfile::PCI_SKA_POSE_CACHEMISSES)-ctMisses0;
+
+  // find largest difference in bone placements
+  FLOAT fMaxDiff = 0.0f;
+  for(INDEX i=0;i<afSearch.Count() && i<afTables.Count();i++) {
+    fMaxDiff = Max(fMaxDiff, Abs(afSearch[i]-afTables[i]));
+  }
+  FLOAT fMaxSharedDiff = 0.0f;
+  for(INDEX i=0;i<afHorde.Count() && i<afShared.Count();i++) {
+    fMaxSharedDiff = Max(fMaxSharedDiff, Abs(afHorde[i]-afShared[i]));
+  }
+
+  for(INDEX imi=0;imi<ctInstances;imi++) {
+    DeleteModelInstance(apmi[imi]);
+  }
+  DeleteModelInstance(pmiSource);
+
+  CPrintF(TRANS("%d instances blending %d animations, %d frames, %d bones:\n"),
+          ctInstances, ctLayers, ctFrames, ctBones);
+  CPrintF(TRANS("  key search:        %8.2f Mbones/s\n"), ctBones/dSearch/1000000.0);
+  CPrintF(TRANS("  key tables (SSE):  %8.2f Mbones/s\n"), ctBones/dTables/1000000.0);
+  CPrintF(TRANS("  max difference in bone placement: %g\n"), fMaxDiff);
+  CPrintF(TRANS("horde in %d phase groups:\n"), ctHordePhases);
+  CPrintF(TRANS("  no pose cache:     %8.2f Mbones/s\n"), ctBones/dHorde/1000000.0);
+  CPrintF(TRANS("  pose cache:        %8.2f Mbones/s (%.1f%% hits)\n"), ctBones/dShared/1000000.0,
+          ctHits*100.0/ClampDn(ctHits+ctMisses,1L));
+  CPrintF(TRANS("  max difference in bone placement: %g\n"), fMaxSharedDiff);
+}
@@ -59,6 +59,7 @@ struct RenModel
   INDEX rm_ctMeshes;          // meshes count for this renmodel
   INDEX rm_iFirstChildModel;
   INDEX rm_iNextSiblingModel;
+  INDEX rm_iPoseEntry;        // entry in pose cache this model is matched to (-1 if none)
 };
 
 struct RenBone
@@ -20,6 +20,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #endif
 
 #include <Engine/Base/Memory.h>
+#include <Engine/Base/MemoryPool.h>
 #include <Engine/Base/ListIterator.inl>
 
 #include <Engine/Templates/DynamicArray.h>
@@ -135,7 +136,7 @@ void CDynamicArray<Type>::GrowPointers(INDEX iCount) {
     ASSERT(da_Pointers==NULL);
     // allocate
     da_Count=iCount;
-    da_Pointers = (Type **)AllocMemory(da_Count*sizeof(Type*));
+    da_Pointers = (Type **)AllocMemoryTagged(da_Count*sizeof(Type*), MT_CONTAINERS);
   // if allocated
   } else {
     // grow to new size
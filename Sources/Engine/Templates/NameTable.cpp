@@ -77,6 +77,30 @@ CNameTableSlot_TYPE *CNameTable_TYPE::FindSlot(ULONG ulKey, const CTString &strN
   return NULL;
 }
 
+CNameTableSlot_TYPE *CNameTable_TYPE::FindSlot(ULONG ulKey, const CTFileName &fnmName)
+{
+  ASSERT(nt_ctCompartments>0 && nt_ctSlotsPerComp>0);
+
+  // find compartment number
+  INDEX iComp = ulKey%nt_ctCompartments;
+
+  // for each used slot in the compartment
+  INDEX iSlot = iComp*nt_ctSlotsPerComp;
+  for(INDEX iSlotInComp=0; iSlotInComp<nt_ctSlotsPerComp; iSlotInComp++, iSlot++) {
+    CNameTableSlot_TYPE *pnts = &nt_antsSlots[iSlot];
+    if (pnts->nts_ptElement==NULL) {
+      continue;
+    }
+    // if it has same key and same name atom
+    if (pnts->nts_ulKey==ulKey && NameTable_SameName(pnts->nts_ptElement->GetName(), fnmName)) {
+      return pnts;
+    }
+  }
+
+  // not found
+  return NULL;
+}
+
 /* Set allocation parameters. */
 void CNameTable_TYPE::SetAllocationParameters(
   INDEX ctCompartments, INDEX ctSlotsPerComp, INDEX ctSlotsPerCompStep)
@@ -96,7 +120,16 @@ TYPE *CNameTable_TYPE::Find(const CTString &strName)
 {
   ASSERT(nt_ctCompartments>0 && nt_ctSlotsPerComp>0);
 
-  CNameTableSlot_TYPE *pnts = FindSlot(strName.GetHash(), strName);
+  CNameTableSlot_TYPE *pnts = FindSlot(NameTable_GetKey(strName), strName);
+  if (pnts==NULL) return NULL;
+  return pnts->nts_ptElement;
+}
+
+TYPE *CNameTable_TYPE::Find(const CTFileName &fnmName)
+{
+  ASSERT(nt_ctCompartments>0 && nt_ctSlotsPerComp>0);
+
+  CNameTableSlot_TYPE *pnts = FindSlot(NameTable_GetKey(fnmName), fnmName);
   if (pnts==NULL) return NULL;
   return pnts->nts_ptElement;
 }
@@ -141,7 +174,7 @@ void CNameTable_TYPE::Add(TYPE *ptNew)
 {
   ASSERT(nt_ctCompartments>0 && nt_ctSlotsPerComp>0);
 
-  ULONG ulKey = ptNew->GetName().GetHash();
+  ULONG ulKey = NameTable_GetKey(ptNew->GetName());
 
   // find compartment number
   INDEX iComp = ulKey%nt_ctCompartments;
@@ -178,8 +211,7 @@ void CNameTable_TYPE::Remove(TYPE *ptOld)
 {
   ASSERT(nt_ctCompartments>0 && nt_ctSlotsPerComp>0);
   // find its slot
-  const CTString &strName = ptOld->GetName();
-  CNameTableSlot_TYPE *pnts = FindSlot(strName.GetHash(), strName);
+  CNameTableSlot_TYPE *pnts = FindSlot(NameTable_GetKey(ptOld->GetName()), ptOld->GetName());
   if( pnts!=NULL) {
     // mark slot as unused
     ASSERT( pnts->nts_ptElement==ptOld);
@@ -18,6 +18,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #error
 #endif
 
+#include <Engine/Base/FileName.h>
 #include <Engine/Templates/StaticArray.h>
 
 class CNameTableSlot_TYPE {
@@ -41,6 +42,7 @@ public:
 
   // internal finding
   CNameTableSlot_TYPE *FindSlot(ULONG ulKey, const CTString &strName);
+  CNameTableSlot_TYPE *FindSlot(ULONG ulKey, const CTFileName &fnmName);
   // expand the name table to next step
   void Expand(void);
 
@@ -57,8 +59,9 @@ public:
   void SetAllocationParameters(
     INDEX ctCompartments, INDEX ctSlotsPerComp, INDEX ctSlotsPerCompStep);
 
-  // find an object by name
+  // find an object by name (file names are compared by their atoms)
   TYPE *Find(const CTString &strName);
+  TYPE *Find(const CTFileName &fnmName);
   // add a new object
   void Add(TYPE *ptNew);
   // remove an object
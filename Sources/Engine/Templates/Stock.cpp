@@ -14,6 +14,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA. */
 
 #include <Engine/Base/Stream.h>
+#include <Engine/Base/MemoryPool.h>
 
 #include <Engine/Templates/DynamicContainer.cpp>
 
@@ -54,6 +55,7 @@ TYPE *CStock_TYPE::Obtain_t(const CTFileName &fnmFileName)
   }
 
   /* if not found, */
+  MEMORY_TAG_SCOPE(MT_RESOURCES);
 
   // create new stock object
   TYPE *ptNew = new TYPE;
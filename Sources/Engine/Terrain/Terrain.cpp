@@ -30,7 +30,12 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <Engine/Entities/ShadingInfo.h>
 #include <Engine/Graphics/Font.h>
 #include <Engine/Base/Console.h>
+#include <Engine/Base/JobPool.h>
+#include <Engine/Base/Shell.h>
+#include <Engine/Base/Timer.h>
 #include <Engine/Rendering/Render.h>
+#include <Engine/World/World.h>
+#include <Engine/Network/Network.h>
 
 extern CTerrain *_ptrTerrain;
 
@@ -1669,6 +1674,15 @@ void CTerrain::UpdateQuadTree()
  * Generation
  */ 
 
+// tiles that are regenerated in current frame
+static CStaticStackArray<INDEX> _aiTilesToRegen;
+
+static void ReGenerateTileGeometryJob( INDEX iJob, void *pvTerrain)
+{
+  CTerrain *ptrTerrain = (CTerrain*)pvTerrain;
+  ptrTerrain->tr_attTiles[_aiTilesToRegen[iJob]].ReGenerateGeometry();
+}
+
 void CTerrain::ReGenerate(void)
 {
   // for each tile in terrain
@@ -1688,16 +1702,44 @@ void CTerrain::ReGenerate(void)
     tt.AddFlag(TT_REGENERATE);
   }
 
-  // for each tile that is waiting in regen queue
-  for(irt=0;irt<ctrt;irt++) {
-    INDEX iTileIndex = tr_auiRegenList[irt];
-    CTerrainTile &tt = tr_attTiles[iTileIndex];
-    // if tile needs to be regenerated
-    if(tt.GetFlags() & TT_REGENERATE) {
-      // Regenerate it now
-      ReGenerateTile(tt.tt_iIndex);
-      // remove flag for regeneration
-      tt.RemoveFlag(TT_REGENERATE);
+  // if tiles are regenerated one by one
+  extern INDEX ter_bParallelRegen;
+  if(!ter_bParallelRegen) {
+    // for each tile that is waiting in regen queue
+    for(irt=0;irt<ctrt;irt++) {
+      INDEX iTileIndex = tr_auiRegenList[irt];
+      CTerrainTile &tt = tr_attTiles[iTileIndex];
+      // if tile needs to be regenerated
+      if(tt.GetFlags() & TT_REGENERATE) {
+        // Regenerate it now
+        ReGenerateTile(tt.tt_iIndex);
+        // remove flag for regeneration
+        tt.RemoveFlag(TT_REGENERATE);
+      }
+    }
+  } else {
+    // collect tiles from regen queue (it can hold same tile more than once)
+    _aiTilesToRegen.PopAll();
+    for(irt=0;irt<ctrt;irt++) {
+      INDEX iTileIndex = tr_auiRegenList[irt];
+      CTerrainTile &tt = tr_attTiles[iTileIndex];
+      if(tt.GetFlags() & TT_REGENERATE) {
+        _aiTilesToRegen.Push() = iTileIndex;
+        tt.RemoveFlag(TT_REGENERATE);
+      }
+    }
+    const INDEX ctTiles = _aiTilesToRegen.Count();
+    // allocate arrays for new lods (array holders are shared between tiles)
+    INDEX itt=0;
+    for(;itt<ctTiles;itt++) {
+      tr_attTiles[_aiTilesToRegen[itt]].BeginReGenerate();
+    }
+    // fill tile geometry in parallel; tiles are rendered only after all of them are done,
+    // so nothing ever sees a half-built tile and no extra buffers are needed
+    JobPool_Run( ctTiles, ReGenerateTileGeometryJob, this);
+    // update top maps and quad tree
+    for(itt=0;itt<ctTiles;itt++) {
+      tr_attTiles[_aiTilesToRegen[itt]].EndReGenerate();
     }
   }
 
@@ -2155,3 +2197,63 @@ void CTerrain::Clear(void)
 }
 
 
+
+
+// fly over first terrain in current world and measure time spent in tile regeneration
+void TerrainRegenBenchmark(void *pArgs)
+{
+  INDEX ctFrames = NEXTARGUMENT(INDEX);
+  ctFrames = Clamp( ctFrames, (INDEX)10, (INDEX)10000);
+
+  // find terrain to fly over
+  CTerrain *ptrTerrain = NULL;
+  {FOREACHINDYNAMICCONTAINER(_pNetwork->ga_World.wo_cenEntities, CEntity, iten) {
+    if( iten->GetRenderType()==CEntity::RT_TERRAIN && iten->GetTerrain()!=NULL) {
+      ptrTerrain = iten->GetTerrain();
+      break;
+    }
+  }}
+  if( ptrTerrain==NULL || ptrTerrain->tr_ctTiles==0) {
+    CPrintF( TRANS("No terrain in current world.\n"));
+    return;
+  }
+
+  extern FLOAT3D _vViewerAbs;
+  extern INDEX ter_bParallelRegen;
+  CTerrain *ptrOld = _ptrTerrain;
+  const FLOAT3D vViewerOld = _vViewerAbs;
+  const INDEX bParallelOld = ter_bParallelRegen;
+  _ptrTerrain = ptrTerrain;
+
+  // viewer flies diagonally across terrain, a bit above its highest point
+  const FLOAT3D vSize = ptrTerrain->tr_vTerrainSize;
+  const FLOAT3D vStart = FLOAT3D( 0, vSize(2)*1.1f, 0);
+  const FLOAT3D vDelta = FLOAT3D( vSize(1), 0, vSize(3)) / (FLOAT)(ctFrames-1);
+
+  CPrintF( TRANS("Flying over terrain (%d tiles) in %d frames, %d job threads:\n"),
+           ptrTerrain->tr_ctTiles, ctFrames, JobPool_GetThreadCount());
+  for( INDEX iPass=0; iPass<2; iPass++) {
+    ter_bParallelRegen = iPass;
+    // start every pass from same lods
+    _vViewerAbs = vStart;
+    ptrTerrain->ReGenerate();
+
+    DOUBLE dTotal = 0, dWorst = 0;
+    INDEX iWorstFrame = 0;
+    for( INDEX iFrame=0; iFrame<ctFrames; iFrame++) {
+      _vViewerAbs = vStart + vDelta*(FLOAT)iFrame;
+      CTimerValue tvStart = _pTimer->GetHighPrecisionTimer();
+      ptrTerrain->ReGenerate();
+      const DOUBLE dFrame = (_pTimer->GetHighPrecisionTimer()-tvStart).GetSeconds();
+      dTotal += dFrame;
+      if( dFrame>dWorst) { dWorst = dFrame;  iWorstFrame = iFrame; }
+    }
+    CPrintF( TRANS("  %-8s: average %6.3f ms, worst %6.3f ms (frame %d)\n"), iPass ? "parallel" : "serial",
+             dTotal*1000.0/ctFrames, dWorst*1000.0, iWorstFrame);
+  }
+
+  // restore state; terrain will pick lods for real viewer on next render
+  ter_bParallelRegen = bParallelOld;
+  _vViewerAbs = vViewerOld;
+  _ptrTerrain = ptrOld;
+}
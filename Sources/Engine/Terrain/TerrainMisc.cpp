@@ -27,6 +27,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <Engine/Light/LightSource.h>
 #include <Engine/Rendering/Render.h>
 #include <Engine/Terrain/TerrainRayCasting.h>
+#include <Engine/Base/JobPool.h>
 
 /*
  * Terrain raycasting and colision 
@@ -891,6 +892,45 @@ static FLOATaabbox3D AbsoluteToRelative(const CTerrain *ptrTerrain, const FLOATa
 
 static ULONG ulTemp = 0xFFFFFFFF;
 
+// light that will be applied to part of shadow map
+struct ShadowMapLight {
+  CPlacement3D sml_plLight;   // light placement in terrain space
+  CLightSource *sml_pls;
+  Rect sml_rcUpdate;          // part of shadow map that light updates
+};
+static CStaticStackArray<ShadowMapLight> _asmlLights;
+static Rect _rcShadowMapUpdate;
+
+#define SHADOWMAP_BAND_ROWS 16  // shadow map rows updated in one job
+
+// clear and light one band of rows in shadow map update rect
+static void UpdateShadowMapBand(INDEX iBand, void *pvUnused)
+{
+  const PIX pixTop    = _rcShadowMapUpdate.rc_iTop + iBand*SHADOWMAP_BAND_ROWS;
+  const PIX pixBottom = Min( pixTop+SHADOWMAP_BAND_ROWS, (PIX)_rcShadowMapUpdate.rc_iBottom);
+
+  Rect rcBand = _rcShadowMapUpdate;
+  rcBand.rc_iTop    = pixTop;
+  rcBand.rc_iBottom = pixBottom;
+  ClearPartOfShadowMap(_ptrTerrain,rcBand);
+
+  // apply lights in same order as they were found, so result doesn't depend on number of bands
+  const INDEX ctLights = _asmlLights.Count();
+  for(INDEX il=0;il<ctLights;il++) {
+    ShadowMapLight &sml = _asmlLights[il];
+    Rect rcLight = sml.sml_rcUpdate;
+    rcLight.rc_iTop    = Max( (PIX)rcLight.rc_iTop,    pixTop);
+    rcLight.rc_iBottom = Min( (PIX)rcLight.rc_iBottom, pixBottom);
+    if(rcLight.rc_iTop>=rcLight.rc_iBottom) continue;
+
+    if(sml.sml_pls->ls_ulFlags &LSF_DIRECTIONAL) {
+      CalcDirectionalLight(sml.sml_plLight,sml.sml_pls,rcLight);
+    } else {
+      CalcPointLight(sml.sml_plLight,sml.sml_pls,rcLight);
+    }
+  }
+}
+
 void UpdateTerrainShadowMap(CTerrain *ptrTerrain, FLOATaabbox3D *pboxUpdate/*=NULL*/, BOOL bAbsoluteSpace/*=FALSE*/)
 {
   // if this is not world editor app 
@@ -945,8 +985,7 @@ void UpdateTerrainShadowMap(CTerrain *ptrTerrain, FLOATaabbox3D *pboxUpdate/*=NU
   ASSERT(tdShadowMap.td_pulFrames!=NULL);
 
   Rect rcUpdate = GetUpdateRectFromBox(ptrTerrain, boxUpdate);
-  // Clear part of shadow map that will be updated
-  ClearPartOfShadowMap(ptrTerrain,rcUpdate);
+  _asmlLights.PopAll();
 
   // for each entity in the world
   FOREACHINDYNAMICCONTAINER(pwldWorld->wo_cenEntities, CEntity, iten) {
@@ -964,7 +1003,10 @@ void UpdateTerrainShadowMap(CTerrain *ptrTerrain, FLOATaabbox3D *pboxUpdate/*=NU
       // if light is directional
       if(pls->ls_ulFlags &LSF_DIRECTIONAL) {
         // Calculate lightning
-        CalcDirectionalLight(plLight,pls,rcUpdate);
+        ShadowMapLight &sml = _asmlLights.Push();
+        sml.sml_plLight  = plLight;
+        sml.sml_pls      = pls;
+        sml.sml_rcUpdate = rcUpdate;
       // if it is point light
       } else {
         _bboxDrawOne = boxLight;
@@ -973,22 +1015,34 @@ void UpdateTerrainShadowMap(CTerrain *ptrTerrain, FLOATaabbox3D *pboxUpdate/*=NU
         if(boxLight.HasContactWith(boxUpdate)) {
           _ctShadowMapUpdates++;
 
+          ShadowMapLight &sml = _asmlLights.Push();
+          sml.sml_plLight = plLight;
+          sml.sml_pls     = pls;
           // if light box is inside update box
           if(boxLight.minvect(1)>=boxUpdate.minvect(1) && boxLight.minvect(3)>boxUpdate.minvect(3) && 
             boxLight.maxvect(1)<=boxUpdate.maxvect(1) && boxLight.maxvect(3)<=boxUpdate.maxvect(3)) {
             // Recalculate only light box
-            Rect rcLightUpdate = GetUpdateRectFromBox(ptrTerrain,boxLight);
-            CalcPointLight(plLight,pls,rcLightUpdate);
+            sml.sml_rcUpdate = GetUpdateRectFromBox(ptrTerrain,boxLight);
           // else 
           } else {
             // Recalculate update box
-            CalcPointLight(plLight,pls,rcUpdate);
+            sml.sml_rcUpdate = rcUpdate;
           }
         }
       }
     }
   }
 
+  // clear and light update rect in bands of rows
+  _rcShadowMapUpdate = rcUpdate;
+  const INDEX ctBands = (rcUpdate.rc_iBottom-rcUpdate.rc_iTop+SHADOWMAP_BAND_ROWS-1) / SHADOWMAP_BAND_ROWS;
+  extern INDEX ter_bParallelRegen;
+  if(ter_bParallelRegen) {
+    JobPool_Run( ctBands, UpdateShadowMapBand, NULL);
+  } else {
+    for(INDEX iBand=0;iBand<ctBands;iBand++) UpdateShadowMapBand( iBand, NULL);
+  }
+
   // Create shadow map mipmaps 
   INDEX ctMipMaps = GetNoOfMipmaps(tdShadowMap.td_mexWidth,tdShadowMap.td_mexHeight);
   MakeMipmaps(ctMipMaps, tdShadowMap.td_pulFrames, tdShadowMap.td_mexWidth, tdShadowMap.td_mexHeight);
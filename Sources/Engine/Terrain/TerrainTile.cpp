@@ -31,6 +31,7 @@ CTerrainTile::CTerrainTile()
   tt_iIndex = -1;
   tt_iArrayIndex = -1;
   tt_iLod = -1;
+  tt_iRegenOldLod = -1;
   tt_iRequestedLod = 0;
   tt_ulTileFlags   = 0;
 }
@@ -399,12 +400,24 @@ void CTerrainTile::ReGenerateTileLayer(INDEX iTileLayer)
 
 // Regenerate tile
 void CTerrainTile::ReGenerate()
+{
+  BeginReGenerate();
+  ReGenerateGeometry();
+  EndReGenerate();
+}
+
+// Prepare tile arrays for regeneration
+void CTerrainTile::BeginReGenerate()
 {
   // remember lod before regen
-  INDEX iOldLod = tt_iLod;
+  tt_iRegenOldLod = tt_iLod;
   // Allocate arrays for requested lod
   tt_iLod = ChangeTileArrays(tt_iRequestedLod);
+}
 
+// Fill tile arrays (uses only arrays of this tile, so tiles can be filled in parallel)
+void CTerrainTile::ReGenerateGeometry()
+{
   // for each vertex in row
   INDEX iStep = 1<<tt_iLod;
   INDEX ir=0;
@@ -456,7 +469,12 @@ void CTerrainTile::ReGenerate()
       }
     }
   }
+}
 
+// Update everything that depends on tile geometry
+void CTerrainTile::EndReGenerate()
+{
+  INDEX iOldLod = tt_iRegenOldLod;
   BOOL bAllowTopMapRegen = !(GetFlags()&TT_NO_TOPMAP_REGEN);
   // if top map is allowed to be regenerated
   if(bAllowTopMapRegen) {
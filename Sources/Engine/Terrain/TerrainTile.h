@@ -44,6 +44,11 @@ public:
   void Render(void);
   // Regenerate tile
   void ReGenerate(void);
+  // Regenerate tile in three steps; only geometry step may run on job threads,
+  // since begin and end steps use shared array holders, top maps and quad tree
+  void BeginReGenerate(void);
+  void ReGenerateGeometry(void);
+  void EndReGenerate(void);
   // Regenerate tile layer 
   void ReGenerateTileLayer(INDEX iTileLayer);
   // Release tile
@@ -101,6 +106,7 @@ public:
   INDEX tt_iLod;      // Current lod of tile
   INDEX tt_iRequestedLod;   // Requested lod for tile
   INDEX tt_iArrayIndex;     // Index of array holder this tile uses
+  INDEX tt_iRegenOldLod;    // Lod of tile before regeneration started
   INDEX tt_aiNeighbours[4]; // Array of tile neighbours
 
   INDEX tt_iFirstBorderVertex[4];// Index of first border vertex inserted
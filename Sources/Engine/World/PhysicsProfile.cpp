@@ -109,5 +109,14 @@ CPhysicsProfile::CPhysicsProfile(void)
   SETCOUNTERNAME(PCI_NEARCELLSFOUND,  "cells found in FindEntitiesNearBox()");
   SETCOUNTERNAME(PCI_NEAROCCUPIEDCELLSFOUND, "occupied cells found in FindEntitiesNearBox()");
   SETCOUNTERNAME(PCI_NEARENTITIESFOUND,  "entities found in FindEntitiesNearBox()");
+
+  SETCOUNTERNAME(PCI_RANGEQUERIES,       "how many times FindEntitiesInRange() was called");
+  SETCOUNTERNAME(PCI_RANGEQUERYSECTORS,  "sectors visited in FindEntitiesInRange()");
+  SETCOUNTERNAME(PCI_RANGEQUERYENTITIES, "entities tested in FindEntitiesInRange()");
+
+  SETCOUNTERNAME(PCI_SENTEVENTS,       "sent events");
+  SETCOUNTERNAME(PCI_SENTEVENTS_HEAP,  " copied on heap");
+  SETCOUNTERNAME(PCI_EVENTARENABYTES,  "event arena bytes used");
+  SETCOUNTERNAME(PCI_EVENTARENACHUNKS, "event arena chunks allocated");
 }
 
@@ -116,6 +116,15 @@ public:
     PCI_NEARCELLSFOUND,           // cells found in FindEntitiesNearBox()
     PCI_NEAROCCUPIEDCELLSFOUND,   // occupied cells found in FindEntitiesNearBox()
     PCI_NEARENTITIESFOUND,        // near entities found in FindEntitiesNearBox()
+
+    PCI_RANGEQUERIES,             // how many times FindEntitiesInRange() was called
+    PCI_RANGEQUERYSECTORS,        // sectors visited in FindEntitiesInRange()
+    PCI_RANGEQUERYENTITIES,       // entities tested in FindEntitiesInRange()
+
+    PCI_SENTEVENTS,               // events sent to entities
+    PCI_SENTEVENTS_HEAP,          // sent events copied on heap (instead of in event arena)
+    PCI_EVENTARENABYTES,          // bytes of event arena used
+    PCI_EVENTARENACHUNKS,         // event arena chunks allocated
     PCI_COUNT
   };
   // constructor
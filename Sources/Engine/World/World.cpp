@@ -115,6 +115,7 @@ CWorld::CWorld(void)
   wo_fRtL = wo_fRtH = 1.0f; wo_fRtCZ = wo_fRtCY = 0.0f;
 
   wo_ulNextEntityID = 1;
+  wo_ulRangeQueryMark = 0;
 
   // set default placement
   wo_plFocus = CPlacement3D( FLOAT3D(3.0f, 4.0f, 10.0f),
@@ -161,6 +162,8 @@ void CWorld::Clear(void)
 
     // clear background viewer
     SetBackgroundViewer(NULL);
+    // destroy predictors that were kept for reuse
+    DeletePredictorPool();
     // make a new container of entities
     CDynamicContainer<CEntity> cenToDestroy = wo_cenEntities;
     // for each of the entities
@@ -1093,6 +1096,9 @@ void CWorld::DeletePredictors(void)
   wo_cenPredictor.Clear();
   wo_cenPredicted.Clear();
 
+  // predictors kept for reuse are not needed anymore either
+  DeletePredictorPool();
+
   // for each entity in the world
   FOREACHINDYNAMICCONTAINER(wo_cenEntities, CEntity, iten) {
     CEntity &en = *iten;
@@ -1100,6 +1106,87 @@ void CWorld::DeletePredictors(void)
   }
 }
 
+// take predictors out of the world, keeping them for refresh in next prediction
+void CWorld::SuspendPredictors(void)
+{
+  extern INDEX cli_bReusePredictors;
+  if (!cli_bReusePredictors) {
+    DeletePredictors();
+    return;
+  }
+
+  // must be in 24bit mode when managing entities
+  CSetFPUPrecision FPUPrecision(FPT_24BIT);
+
+  // first remember eventual predicted player positions
+  _pNetwork->ga_sesSessionState.RememberPlayerPredictorPositions();
+
+  // make a copy of predictor container (for safe iteration)
+  CDynamicContainer<CEntity> cenPredictor = wo_cenPredictor;
+  // for each predictor of an existing entity
+  {FOREACHINDYNAMICCONTAINER( cenPredictor, CEntity, iten){
+    // (deleted predictors are released when others clear their pointers)
+    if (!wo_cenPredictor.IsMember(iten)) {
+      continue;
+    }
+    CEntity &en = *iten;
+    ASSERT(en.IsPredictor());
+    if (en.en_ulFlags&(ENF_TEMPPREDICTOR|ENF_DELETED)) {
+      continue;
+    }
+    CEntity *penPredicted = en.GetPredictionPair();
+    if (penPredicted==NULL || (penPredicted->en_ulFlags&ENF_DELETED)) {
+      continue;
+    }
+    // suspend it and keep it in the pool
+    wo_cenPredictor.Remove(&en);
+    _ctPredictorEntities--;
+    en.SuspendPredictor();
+    wo_cenPredictorPool.Add(&en);
+  }}
+  // destroy all other (temporary) predictors
+  {FOREACHINDYNAMICCONTAINER( cenPredictor, CEntity, iten){
+    if (wo_cenPredictor.IsMember(iten)) {
+      iten->Destroy();
+    }
+  }}
+
+  // for each predicted
+  {FOREACHINDYNAMICCONTAINER( wo_cenPredicted, CEntity, iten){
+    CEntity &en = *iten;
+    ASSERT(en.IsPredicted());
+    // kill its pointer to predictor
+    en.SetPredictionPair(NULL);
+    // mark as not predicted
+    en.en_ulFlags&=~ENF_PREDICTED;
+  }}
+
+  ASSERT(_ctPredictorEntities==0);
+
+  wo_cenPredictor.Clear();
+  wo_cenPredicted.Clear();
+}
+
+// destroy all suspended predictors
+void CWorld::DeletePredictorPool(void)
+{
+  if (wo_cenPredictorPool.Count()==0) {
+    return;
+  }
+  // must be in 24bit mode when managing entities
+  CSetFPUPrecision FPUPrecision(FPT_24BIT);
+
+  CDynamicContainer<CEntity> cenPool = wo_cenPredictorPool;
+  wo_cenPredictorPool.Clear();
+  // for each suspended predictor
+  {FOREACHINDYNAMICCONTAINER( cenPool, CEntity, iten){
+    CEntity &en = *iten;
+    // put it back among active entities and destroy it as usual
+    wo_cenEntities.Add(&en);
+    en.Destroy();
+  }}
+}
+
 // get entity by its ID
 CEntity *CWorld::EntityFromID(ULONG ulID)
 {
@@ -68,6 +68,7 @@ public:
   CDynamicContainer<CEntity> wo_cenWillBePredicted;  // entities that will be predicted
   CDynamicContainer<CEntity> wo_cenPredicted;  // predicted entities
   CDynamicContainer<CEntity> wo_cenPredictor;  // predictor entities
+  CDynamicContainer<CEntity> wo_cenPredictorPool;  // suspended predictors kept for next prediction
 
   class CCollisionGrid *wo_pcgCollisionGrid;
 
@@ -94,6 +95,7 @@ public:
   CTString wo_strDescription; // description of the level (intro, mission, etc.)
 
   ULONG wo_ulNextEntityID;    // next free ID for entities
+  ULONG wo_ulRangeQueryMark;  // stamp of last range query (see CEntity::FindEntitiesInRange())
   CListHead wo_lhTimers;      // timer scheduled entities
   CListHead wo_lhMovers;        // entities that want to/have to move
   BOOL wo_bPortalLinksUpToDate; // set if portal-sector links are up to date
@@ -176,6 +178,10 @@ public:
   void CreatePredictors(void);
   // delete all predictor entities
   void DeletePredictors(void);
+  // take predictors out of the world, keeping them for refresh in next prediction
+  void SuspendPredictors(void);
+  // destroy all suspended predictors
+  void DeletePredictorPool(void);
 
   // get entity by its ID
   CEntity *EntityFromID(ULONG ulID);
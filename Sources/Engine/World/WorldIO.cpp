@@ -16,6 +16,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "stdh.h"
 
 #include <Engine/Base/Stream.h>
+#include <Engine/Base/MemoryPool.h>
 #include <Engine/Math/Float.h>
 #include <Engine/World/World.h>
 #include <Engine/World/WorldEditingProfile.h>
@@ -27,6 +28,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <Engine/Terrain/TerrainArchive.h>
 #include <Engine/Base/ProgressHook.h>
 #include <Engine/Network/Network.h>
+#include <Engine/Graphics/GfxLibrary.h>
 #include <Engine/Templates/StaticArray.cpp>
 #include <Engine/Terrain/Terrain.h>
 
@@ -61,6 +63,7 @@ void CWorld::Save_t(const CTFileName &fnmWorld) // throw char *
  */
 void CWorld::Load_t(const CTFileName &fnmWorld) // throw char *
 {
+  MEMORY_TAG_SCOPE(MT_WORLD);
   // remember the file
   wo_fnmFileName = fnmWorld;
   // open the file
@@ -77,6 +80,9 @@ void CWorld::Load_t(const CTFileName &fnmWorld) // throw char *
   // close the file
   strmFile.Close();
 
+  // let the driver prepare render states this level used last time, while rest is being loaded
+  _pGfx->PrepareForLevel(fnmWorld);
+
   // if reinit is needed
   if (bNeedsReinit) {
     // reinitialize
@@ -710,6 +716,7 @@ void CWorld::WriteState_t( CTStream *ostr, BOOL bImportDictionary /* = FALSE */)
   ASSERT(
     wo_cenPredicted.Count()==0 && 
     wo_cenPredictor.Count()==0 && 
+    wo_cenPredictorPool.Count()==0 && 
     wo_cenWillBePredicted.Count()==0);
 
   if (bImportDictionary) {
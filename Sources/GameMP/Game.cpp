@@ -25,6 +25,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <io.h>
 #include <Engine/Base/Profiling.h>
 #include <Engine/Base/Statistics.h>
+#include <Engine/Base/BackgroundWrite.h>
 #include <Engine/CurrentVersion.h>
 #include "Camera.h"
 #include "LCDDrawing.h"
@@ -1355,7 +1356,10 @@ BOOL CGame::SaveGame(const CTFileName &fnGame)
   // save new session
   try {
     _pNetwork->Save_t( fnGame);
-    CPrintF(TRANS("Saved game: %s\n"), fnGame);
+    // game written in background is reported when the file is done
+    if (!BackgroundWrite_IsPending()) {
+      CPrintF(TRANS("Saved game: %s\n"), fnGame);
+    }
     SaveThumbnail(fnGame.NoExt()+"Tbn.tex");
     return TRUE;
   } catch (char *strError) {
@@ -142,7 +142,7 @@ BOOL CRConDlg::PreTranslateMessage(MSG* pMsg)
         CNetworkMessage nm(MSG_EXTRA);
         nm<<CTString(0, "rcmd %u \"%s\" %s\n", theApp.m_ulCode, (const char*)theApp.m_strPass, (const char*)CStringA(strCommand));
         _pNetwork->SendBroadcast(nm, theApp.m_ulHost, theApp.m_uwPort);
-        _cmiComm.Client_Update();
+        _pcmiComm->Client_Update();
       }
     }
   }
@@ -172,7 +172,7 @@ void CRConDlg::OnTimer(UINT nIDEvent)
   FOREVER {
     CNetworkMessage nmReceived;
 
-    _cmiComm.Client_Update();
+    _pcmiComm->Client_Update();
     ULONG ulFrom;
     UWORD uwPort;
     BOOL bHasMsg = _pNetwork->ReceiveBroadcast(nmReceived, ulFrom, uwPort);